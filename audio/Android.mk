@@ -495,6 +495,7 @@ ifeq ($(strip $(MTK_AURISYS_FRAMEWORK_SUPPORT)),yes)
         $(AUDIO_COMMON_DIR)/aurisys/utility/audio_pool_buf_handler.c \
         $(AUDIO_COMMON_DIR)/aurisys/utility/AudioAurisysPcmDump.c \
         $(AUDIO_COMMON_DIR)/aurisys/framework/aurisys_config_parser.c \
+        $(AUDIO_COMMON_DIR)/aurisys/framework/aurisys_config_cache.c \
         $(AUDIO_COMMON_DIR)/aurisys/framework/aurisys_controller.c \
         $(AUDIO_COMMON_DIR)/aurisys/framework/aurisys_lib_manager.c \
         $(AUDIO_COMMON_DIR)/aurisys/framework/aurisys_lib_handler.c \
@@ -640,12 +641,14 @@ endif
 LOCAL_SRC_FILES += \
     $(AUDIO_COMMON_DIR)/utility/audio_lock.c \
     $(AUDIO_COMMON_DIR)/utility/audio_time.c \
+    $(AUDIO_COMMON_DIR)/utility/audio_polyphase_src.c \
     $(AUDIO_COMMON_DIR)/utility/audio_ringbuf.c \
     $(AUDIO_COMMON_DIR)/utility/audio_sample_rate.c \
     $(AUDIO_COMMON_DIR)/aud_drv/audio_hw_hal.cpp \
     $(AUDIO_COMMON_DIR)/aud_drv/AudioMTKFilter.cpp \
     $(AUDIO_COMMON_DIR)/aud_drv/AudioMTKHeadsetMessager.cpp \
     $(AUDIO_COMMON_DIR)/aud_drv/AudioUtility.cpp \
+    $(AUDIO_COMMON_DIR)/aud_drv/AudioPCMDumpWriter.cpp \
     $(AUDIO_COMMON_DIR)/aud_drv/AudioFtmBase.cpp \
     $(AUDIO_COMMON_DIR)/aud_drv/WCNChipController.cpp \
     $(AUDIO_COMMON_DIR)/speech_driver/AudioALSASpeechPhoneCallController.cpp \
@@ -8,6 +8,8 @@
 
 #include "AudioMTKFilter.h"
 
+#include <audio_polyphase_src.h>
+
 #if (defined(MTK_AUDIO_HIERARCHICAL_PARAM_SUPPORT) && (MTK_AUDIO_TUNING_TOOL_V2_PHASE >= 2))
 #include "AudioParamParser.h"
 #endif
@@ -46,6 +48,8 @@ static const uint32_t kMaxPcmDriverBufferSize = 0x20000;  // 128k
 static const uint32_t kBliSrcOutputBufferSize = 0x10000;  // 64k
 static const uint32_t kPcmDriverBufferSize    = 0x20000;  // 128k
 
+static const char *kPolyphaseSrcPropty = "streamout.src.polyphase";
+
 static const uint32_t kAurisysBufSizeDlIn     = 0x10000;  // 64k
 static const uint32_t kAurisysBufSizeDlOut    = 0x40000;  // 256k
 
@@ -77,6 +81,10 @@ AudioALSAPlaybackHandlerBase::AudioALSAPlaybackHandlerBase(const stream_attribut
     mDcRemoveBufferSize(0),
     mBliSrc(NULL),
     mBliSrcOutputBuffer(NULL),
+    mPolyphaseSrc(NULL),
+    mPolyphaseSrcEnable(false),
+    mPolyphaseSrcOutputFormat(AUDIO_FORMAT_DEFAULT),
+    mPolyphaseSrcOutputBufferSize(0),
     mBitConverter(NULL),
     mBitConverterOutputBuffer(NULL),
     mdataPendingOutputBuffer(NULL),
@@ -111,6 +119,10 @@ AudioALSAPlaybackHandlerBase::AudioALSAPlaybackHandlerBase(const stream_attribut
     memset(&mConfig, 0, sizeof(mConfig));
     memset(&mStreamAttributeTarget, 0, sizeof(mStreamAttributeTarget));
     memset(&mComprConfig, 0, sizeof(mComprConfig));
+
+    char value[PROPERTY_VALUE_MAX];
+    property_get(kPolyphaseSrcPropty, value, "0");
+    mPolyphaseSrcEnable = (atoi(value) != 0);
 }
 
 
@@ -539,6 +551,10 @@ status_t AudioALSAPlaybackHandlerBase::initBliSrc() {
               mStreamAttributeSource->num_channels, mStreamAttributeTarget.num_channels,
               mStreamAttributeSource->audio_format);
 
+        if (mPolyphaseSrcEnable && initPolyphaseSrc() == NO_ERROR) {
+            return NO_ERROR;
+        }
+
         SRC_PCM_FORMAT src_pcm_format = SRC_IN_Q1P15_OUT_Q1P15;
         if (mStreamAttributeSource->audio_format == AUDIO_FORMAT_PCM_32_BIT) {
             src_pcm_format = SRC_IN_Q1P31_OUT_Q1P31;
@@ -571,6 +587,11 @@ status_t AudioALSAPlaybackHandlerBase::deinitBliSrc() {
         mBliSrc = NULL;
     }
 
+    if (mPolyphaseSrc != NULL) {
+        audio_polyphase_src_destroy(mPolyphaseSrc);
+        mPolyphaseSrc = NULL;
+    }
+
     if (mBliSrcOutputBuffer != NULL) {
         delete[] mBliSrcOutputBuffer;
         mBliSrcOutputBuffer = NULL;
@@ -581,7 +602,20 @@ status_t AudioALSAPlaybackHandlerBase::deinitBliSrc() {
 
 
 status_t AudioALSAPlaybackHandlerBase::doBliSrc(void *pInBuffer, uint32_t inBytes, void **ppOutBuffer, uint32_t *pOutBytes) {
-    if (mBliSrc == NULL) { // No need SRC
+    if (mPolyphaseSrc != NULL) {
+        uint32_t num_raw_data_left = inBytes;
+        uint32_t num_converted_data = mPolyphaseSrcOutputBufferSize;
+
+        audio_polyphase_src_process(mPolyphaseSrc, pInBuffer, &num_raw_data_left,
+                                    mBliSrcOutputBuffer, &num_converted_data);
+        if (num_raw_data_left > 0) {
+            ALOGW("%s(), num_raw_data_left(%u) > 0", __FUNCTION__, num_raw_data_left);
+            ASSERT(num_raw_data_left == 0);
+        }
+
+        *ppOutBuffer = mBliSrcOutputBuffer;
+        *pOutBytes = num_converted_data;
+    } else if (mBliSrc == NULL) { // No need SRC
         *ppOutBuffer = pInBuffer;
         *pOutBytes = inBytes;
     } else {
@@ -612,6 +646,57 @@ status_t AudioALSAPlaybackHandlerBase::doBliSrc(void *pInBuffer, uint32_t inByte
 }
 
 
+static audio_src_sample_format_t transferAudioFormatToSrcFormat(const audio_format_t audio_format) {
+    switch (audio_format) {
+    case AUDIO_FORMAT_PCM_16_BIT:
+        return AUDIO_SRC_SAMPLE_Q1P15;
+    case AUDIO_FORMAT_PCM_8_24_BIT:
+        return AUDIO_SRC_SAMPLE_Q9P23;
+    case AUDIO_FORMAT_PCM_32_BIT:
+        return AUDIO_SRC_SAMPLE_Q1P31;
+    default:
+        return AUDIO_SRC_SAMPLE_INVALID;
+    }
+}
+
+
+status_t AudioALSAPlaybackHandlerBase::initPolyphaseSrc() {
+    // convert to target format in the same pass if bit converter is not created yet
+    audio_format_t output_format = (mBitConverter == NULL) ?
+                                   mStreamAttributeTarget.audio_format :
+                                   mStreamAttributeSource->audio_format;
+    audio_src_sample_format_t src_input_format = transferAudioFormatToSrcFormat(mStreamAttributeSource->audio_format);
+    audio_src_sample_format_t src_output_format = transferAudioFormatToSrcFormat(output_format);
+
+    if (mStreamAttributeSource->sample_rate == mStreamAttributeTarget.sample_rate ||
+        src_input_format == AUDIO_SRC_SAMPLE_INVALID ||
+        src_output_format == AUDIO_SRC_SAMPLE_INVALID) {
+        return INVALID_OPERATION;
+    }
+
+    mPolyphaseSrc = audio_polyphase_src_create(
+                        mStreamAttributeSource->sample_rate, mStreamAttributeSource->num_channels,
+                        mStreamAttributeTarget.sample_rate,  mStreamAttributeTarget.num_channels,
+                        src_input_format, src_output_format);
+    if (mPolyphaseSrc == NULL) {
+        ALOGW("%s(), not support, use Bli SRC", __FUNCTION__);
+        return INVALID_OPERATION;
+    }
+    mPolyphaseSrcOutputFormat = output_format;
+
+    mPolyphaseSrcOutputBufferSize = kBliSrcOutputBufferSize;
+    if (audio_src_sample_format_size(src_output_format) > audio_src_sample_format_size(src_input_format)) {
+        mPolyphaseSrcOutputBufferSize *= 2;
+    }
+    mBliSrcOutputBuffer = new char[mPolyphaseSrcOutputBufferSize];
+    ASSERT(mBliSrcOutputBuffer != NULL);
+
+    ALOGD("%s(), audio_format: 0x%x => 0x%x", __FUNCTION__,
+          mStreamAttributeSource->audio_format, mPolyphaseSrcOutputFormat);
+    return NO_ERROR;
+}
+
+
 pcm_format AudioALSAPlaybackHandlerBase::transferAudioFormatToPcmFormat(const audio_format_t audio_format) const {
     pcm_format retval = PCM_FORMAT_S16_LE;
 
@@ -645,6 +730,12 @@ pcm_format AudioALSAPlaybackHandlerBase::transferAudioFormatToPcmFormat(const au
 
 
 status_t AudioALSAPlaybackHandlerBase::initBitConverter() {
+    // polyphase SRC already outputs target format
+    if (mPolyphaseSrc != NULL && mPolyphaseSrcOutputFormat == mStreamAttributeTarget.audio_format) {
+        ALOGD("%s(), done by polyphase SRC", __FUNCTION__);
+        return NO_ERROR;
+    }
+
     // init bit converter if need
     if (mStreamAttributeSource->audio_format != mStreamAttributeTarget.audio_format) {
         BCV_PCM_FORMAT bcv_pcm_format;
@@ -745,8 +836,8 @@ status_t AudioALSAPlaybackHandlerBase::doBitConversion(void *pInBuffer, uint32_t
 // we assue that buufer should write as 64 bytes align , so only src handler is create,
 // will cause output buffer is not 64 bytes align
 status_t AudioALSAPlaybackHandlerBase::initDataPending() {
-    ALOGV("mBliSrc = %p", mBliSrc);
-    if (mBliSrc != NULL || mDataPendingForceUse) {
+    ALOGV("mBliSrc = %p, mPolyphaseSrc = %p", mBliSrc, mPolyphaseSrc);
+    if (mBliSrc != NULL || mPolyphaseSrc != NULL || mDataPendingForceUse) {
         mdataPendingOutputBufferSize = (1024 * 128) + mDataAlignedSize; // here nned to cover max write buffer size
         mdataPendingOutputBuffer = new char[mdataPendingOutputBufferSize];
         mdataPendingTempBuffer  = new char[mDataAlignedSize];
@@ -779,7 +870,7 @@ status_t AudioALSAPlaybackHandlerBase::dodataPending(void *pInBuffer, uint32_t i
     uint32 tempRemind = TotalBufferSize % mDataAlignedSize;
     uint32 TotalOutputSize = TotalBufferSize - tempRemind;
     uint32 TotalOutputCount = TotalOutputSize;
-    if (mBliSrc != NULL || mDataPendingForceUse) { // do data pending
+    if (mBliSrc != NULL || mPolyphaseSrc != NULL || mDataPendingForceUse) { // do data pending
         //ALOGD("inBytes = %d mdataPendingRemindBufferSize = %d TotalOutputSize = %d",inBytes,mdataPendingRemindBufferSize,TotalOutputSize);
 
         if (TotalOutputSize != 0) {
@@ -20,6 +20,8 @@ struct arsi_task_config_t;
 struct audio_pool_buf_t;
 #endif
 
+struct audio_polyphase_src_t;
+
 typedef int (*audio_pcm_write_wrapper_fp_t)(struct pcm *pcm, const void *data, unsigned int count);
 
 namespace android {
@@ -69,6 +71,12 @@ public:
     virtual status_t setFilterMng(AudioMTKFilterManager *pFilterMng);
 
 
+    /**
+     * use in-tree polyphase SRC instead of Bli SRC (set before open)
+     */
+    inline void         setPolyphaseSrcEnable(const bool enable) { mPolyphaseSrcEnable = enable; }
+
+
     /**
      * low latency
      */
@@ -158,6 +166,7 @@ protected:
     status_t         initBliSrc();
     status_t         deinitBliSrc();
     status_t         doBliSrc(void *pInBuffer, uint32_t inBytes, void **ppOutBuffer, uint32_t *pOutBytes);
+    status_t         initPolyphaseSrc();
 
 
     /**
@@ -215,6 +224,14 @@ protected:
     MtkAudioSrcBase *mBliSrc;
     char        *mBliSrcOutputBuffer;
 
+    /**
+     * Polyphase SRC, also converts to target format so bit converter is skipped
+     */
+    struct audio_polyphase_src_t *mPolyphaseSrc;
+    bool         mPolyphaseSrcEnable;
+    audio_format_t mPolyphaseSrcOutputFormat;
+    uint32_t     mPolyphaseSrcOutputBufferSize;
+
 
     /**
      * Bit Converter
@@ -0,0 +1,445 @@
+#include <AudioPCMDumpWriter.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/prctl.h>
+#include <sys/resource.h>
+
+#include <utils/threads.h> // for ANDROID_PRIORITY_BACKGROUND
+
+#include <cutils/properties.h>
+
+#include <audio_time.h>
+
+#include <AudioLock.h>
+
+
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+#define LOG_TAG "AudioPCMDumpWriter"
+
+
+
+namespace android {
+
+/*
+ * =============================================================================
+ *                     MACRO
+ * =============================================================================
+ */
+
+#define DEFAULT_PCM_DUMP_RING_KB (512)
+#define MIN_PCM_DUMP_RING_KB (16)
+#define MAX_PCM_DUMP_RING_KB (8192)
+
+#define PCM_DUMP_WRITER_PERIOD_MS (20)
+
+#define MAX_PCM_DUMP_ROTATE_SEGMENT (4) /* keep latest N segments + current */
+
+static const char kPropertyKeyRingKb[PROPERTY_KEY_MAX] = "pcm.dump.ring_kb";
+static const char kPropertyKeyRotateMb[PROPERTY_KEY_MAX] = "pcm.dump.rotate_mb";
+
+
+/*
+ * =============================================================================
+ *                     private function
+ * =============================================================================
+ */
+
+static uint32_t roundUpPowerOf2(uint32_t value) {
+    uint32_t result = 1;
+
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+
+static uint32_t getPropertyValue(const char *key, const uint32_t default_value) {
+    char value[PROPERTY_VALUE_MAX];
+
+    property_get(key, value, "");
+    if (value[0] == '\0') {
+        return default_value;
+    }
+    return (uint32_t)atoi(value);
+}
+
+
+/*
+ * =============================================================================
+ *                     create/destroy/init/deinit functions
+ * =============================================================================
+ */
+
+AudioPCMDumpWriter *AudioPCMDumpWriter::getInstance() {
+    static AudioPCMDumpWriter *writer = new AudioPCMDumpWriter();
+    return writer;
+}
+
+
+AudioPCMDumpWriter::AudioPCMDumpWriter() :
+    mRingSize(0),
+    mRotateBytes(0),
+    mThreadCreated(false),
+    hWriterThread(0),
+    mWriterSleeping(false) {
+    uint32_t ring_kb = getPropertyValue(kPropertyKeyRingKb, DEFAULT_PCM_DUMP_RING_KB);
+
+    if (ring_kb < MIN_PCM_DUMP_RING_KB) {
+        ring_kb = MIN_PCM_DUMP_RING_KB;
+    } else if (ring_kb > MAX_PCM_DUMP_RING_KB) {
+        ring_kb = MAX_PCM_DUMP_RING_KB;
+    }
+    mRingSize = roundUpPowerOf2(ring_kb * 1024);
+    mRotateBytes = (uint64_t)getPropertyValue(kPropertyKeyRotateMb, 0) * 1024 * 1024;
+
+    for (uint32_t i = 0; i < MAX_PCM_DUMP_FILE_NUM; i++) {
+        mSlots[i].file.store(NULL, std::memory_order_relaxed);
+        mSlots[i].users.store(0, std::memory_order_relaxed);
+        mSlots[i].ring = NULL;
+        mSlots[i].ringSize = 0;
+        mSlots[i].head.store(0, std::memory_order_relaxed);
+        mSlots[i].tail.store(0, std::memory_order_relaxed);
+        mSlots[i].dropPeriods.store(0, std::memory_order_relaxed);
+        mSlots[i].dropBytes.store(0, std::memory_order_relaxed);
+        mSlots[i].reportedDropPeriods = 0;
+        mSlots[i].path[0] = '\0';
+        mSlots[i].segmentBytes = 0;
+        mSlots[i].segmentIndex = 0;
+    }
+
+    pthread_mutex_init(&mWakeMutex, NULL);
+    pthread_cond_init(&mWakeCond, NULL);
+
+    ALOGD("%s(), ring size %u, rotate bytes %llu", __FUNCTION__,
+          mRingSize, (unsigned long long)mRotateBytes);
+}
+
+
+AudioPCMDumpWriter::~AudioPCMDumpWriter() {
+    /* singleton, never deleted */
+}
+
+
+/*
+ * =============================================================================
+ *                     public function
+ * =============================================================================
+ */
+
+int AudioPCMDumpWriter::registerFile(FILE *file, const char *filepath) {
+    PCMDumpSlot *slot = NULL;
+
+    if (file == NULL) {
+        return -EINVAL;
+    }
+
+    AL_AUTOLOCK(mLock);
+
+    if (!mThreadCreated && createWriterThread() != 0) {
+        return -ENOSYS;
+    }
+
+    for (uint32_t i = 0; i < MAX_PCM_DUMP_FILE_NUM; i++) {
+        if (mSlots[i].file.load(std::memory_order_relaxed) != NULL) {
+            continue;
+        }
+        /* skip a slot which unregisterFile() is still tearing down */
+        if (AL_TRYLOCK(mSlots[i].ioLock) != 0) {
+            continue;
+        }
+        if (mSlots[i].ring == NULL) {
+            slot = &mSlots[i];
+            break;
+        }
+        AL_UNLOCK(mSlots[i].ioLock);
+    }
+    if (slot == NULL) {
+        ALOGW("%s(), no free slot for %s", __FUNCTION__, filepath);
+        return -ENOSPC;
+    }
+
+    slot->ring = (char *)malloc(mRingSize);
+    if (slot->ring == NULL) {
+        ALOGE("%s(), malloc %u fail!!", __FUNCTION__, mRingSize);
+        AL_UNLOCK(slot->ioLock);
+        return -ENOMEM;
+    }
+    slot->ringSize = mRingSize;
+    slot->head.store(0, std::memory_order_relaxed);
+    slot->tail.store(0, std::memory_order_relaxed);
+    slot->dropPeriods.store(0, std::memory_order_relaxed);
+    slot->dropBytes.store(0, std::memory_order_relaxed);
+    slot->reportedDropPeriods = 0;
+    strncpy(slot->path, (filepath != NULL) ? filepath : "", MAX_PCM_DUMP_PATH_LEN - 1);
+    slot->path[MAX_PCM_DUMP_PATH_LEN - 1] = '\0';
+    slot->segmentBytes = 0;
+    slot->segmentIndex = 0;
+
+    /* publish after the ring is ready */
+    slot->file.store(file, std::memory_order_release);
+    AL_UNLOCK(slot->ioLock);
+    return 0;
+}
+
+
+void AudioPCMDumpWriter::unregisterFile(FILE *file) {
+    PCMDumpSlot *slot = NULL;
+
+    if (file == NULL) {
+        return;
+    }
+
+    /* no mLock, the drain below only holds up this slot */
+    slot = findSlot(file);
+    if (slot == NULL) {
+        return;
+    }
+
+    AL_AUTOLOCK(slot->ioLock);
+    if (slot->file.load(std::memory_order_relaxed) != file) {
+        return; /* unregistered by another thread meanwhile */
+    }
+
+    /* no new push() enters the ring; wait for the ones already inside */
+    slot->file.store(NULL, std::memory_order_seq_cst);
+    while (slot->users.load(std::memory_order_seq_cst) != 0) {
+        sched_yield();
+    }
+
+    drainSlot(slot, file);
+    reportDrop(slot);
+
+    free(slot->ring);
+    slot->ring = NULL;
+    slot->ringSize = 0;
+}
+
+
+bool AudioPCMDumpWriter::push(FILE *file, const void *buffer, const uint32_t bytes) {
+    PCMDumpSlot *slot = findSlot(file);
+    uint32_t head = 0;
+    uint32_t used = 0;
+    uint32_t offset = 0;
+    uint32_t first = 0;
+    bool half_full = false;
+
+    if (slot == NULL) {
+        return false;
+    }
+    if (bytes == 0 || buffer == NULL) {
+        return true;
+    }
+
+    /* hold the ring, unregisterFile() may have cleared the slot meanwhile */
+    slot->users.fetch_add(1, std::memory_order_seq_cst);
+    if (slot->file.load(std::memory_order_seq_cst) != file) {
+        slot->users.fetch_sub(1, std::memory_order_release);
+        return false;
+    }
+
+    head = slot->head.load(std::memory_order_relaxed);
+    used = head - slot->tail.load(std::memory_order_acquire);
+    if (bytes > slot->ringSize - used) {
+        slot->dropPeriods.fetch_add(1, std::memory_order_relaxed);
+        slot->dropBytes.fetch_add(bytes, std::memory_order_relaxed);
+        slot->users.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    offset = head & (slot->ringSize - 1);
+    first = slot->ringSize - offset;
+    if (first >= bytes) {
+        memcpy(slot->ring + offset, buffer, bytes);
+    } else {
+        memcpy(slot->ring + offset, buffer, first);
+        memcpy(slot->ring, (const char *)buffer + first, bytes - first);
+    }
+    slot->head.store(head + bytes, std::memory_order_release);
+    half_full = used + bytes >= (slot->ringSize >> 1);
+    slot->users.fetch_sub(1, std::memory_order_release);
+
+    /* only kick the writer when half full; otherwise it wakes up by period */
+    if (half_full && mWriterSleeping.load(std::memory_order_relaxed)) {
+        pthread_cond_signal(&mWakeCond);
+    }
+    return true;
+}
+
+
+uint32_t AudioPCMDumpWriter::getDropPeriods(FILE *file) {
+    PCMDumpSlot *slot = findSlot(file);
+
+    return (slot != NULL) ? slot->dropPeriods.load(std::memory_order_relaxed) : 0;
+}
+
+
+/*
+ * =============================================================================
+ *                     private function
+ * =============================================================================
+ */
+
+PCMDumpSlot *AudioPCMDumpWriter::findSlot(FILE *file) {
+    if (file == NULL) {
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < MAX_PCM_DUMP_FILE_NUM; i++) {
+        if (mSlots[i].file.load(std::memory_order_acquire) == file) {
+            return &mSlots[i];
+        }
+    }
+    return NULL;
+}
+
+
+/* called with slot->ioLock */
+bool AudioPCMDumpWriter::drainSlot(PCMDumpSlot *slot, FILE *file) {
+    uint32_t tail = slot->tail.load(std::memory_order_relaxed);
+    uint32_t head = slot->head.load(std::memory_order_acquire);
+    uint32_t avail = head - tail;
+    uint32_t offset = 0;
+    uint32_t first = 0;
+
+    if (avail == 0 || file == NULL) {
+        return false;
+    }
+
+    /* write all pending periods at once, at most 2 chunks due to wrap */
+    offset = tail & (slot->ringSize - 1);
+    first = slot->ringSize - offset;
+    if (first >= avail) {
+        fwrite(slot->ring + offset, 1, avail, file);
+    } else {
+        fwrite(slot->ring + offset, 1, first, file);
+        fwrite(slot->ring, 1, avail - first, file);
+    }
+    slot->tail.store(head, std::memory_order_release);
+
+    slot->segmentBytes += avail;
+    if (mRotateBytes != 0 && slot->segmentBytes >= mRotateBytes) {
+        rotateSlot(slot, file);
+    }
+    return true;
+}
+
+
+/* called with slot->ioLock. keep the FILE pointer for the caller & swap the fd below */
+void AudioPCMDumpWriter::rotateSlot(PCMDumpSlot *slot, FILE *file) {
+    char segment_path[MAX_PCM_DUMP_PATH_LEN + 16];
+    int fd = -1;
+
+    if (slot->path[0] == '\0') {
+        return;
+    }
+
+    fflush(file);
+
+    snprintf(segment_path, sizeof(segment_path), "%s.%u", slot->path, slot->segmentIndex);
+    if (rename(slot->path, segment_path) != 0) {
+        ALOGW("%s(), rename %s fail, errno %d", __FUNCTION__, slot->path, errno);
+        return;
+    }
+
+    fd = open(slot->path, O_WRONLY | O_CREAT | O_TRUNC, 0660);
+    if (fd < 0) {
+        ALOGW("%s(), open %s fail, errno %d", __FUNCTION__, slot->path, errno);
+        return; /* keep writing to the renamed segment */
+    }
+    if (dup2(fd, fileno(file)) < 0) {
+        ALOGW("%s(), dup2 fail, errno %d", __FUNCTION__, errno);
+    }
+    close(fd);
+
+    if (slot->segmentIndex >= MAX_PCM_DUMP_ROTATE_SEGMENT) {
+        snprintf(segment_path, sizeof(segment_path), "%s.%u", slot->path,
+                 slot->segmentIndex - MAX_PCM_DUMP_ROTATE_SEGMENT);
+        unlink(segment_path);
+    }
+
+    ALOGD("%s(), %s segment %u done", __FUNCTION__, slot->path, slot->segmentIndex);
+    slot->segmentIndex++;
+    slot->segmentBytes = 0;
+}
+
+
+void AudioPCMDumpWriter::reportDrop(PCMDumpSlot *slot) {
+    uint32_t drop_periods = slot->dropPeriods.load(std::memory_order_relaxed);
+
+    if (drop_periods != slot->reportedDropPeriods) {
+        ALOGW("%s(), %s drop %u periods, total %u periods %u bytes", __FUNCTION__,
+              slot->path,
+              drop_periods - slot->reportedDropPeriods,
+              drop_periods,
+              slot->dropBytes.load(std::memory_order_relaxed));
+        slot->reportedDropPeriods = drop_periods;
+    }
+}
+
+
+/* called with mLock */
+int AudioPCMDumpWriter::createWriterThread() {
+    int ret = pthread_create(&hWriterThread, NULL,
+                             AudioPCMDumpWriter::writerThread,
+                             (void *)this);
+    if (ret != 0) {
+        ALOGE("%s(), pthread_create fail!! ret %d", __FUNCTION__, ret);
+        return ret;
+    }
+
+    mThreadCreated = true;
+    return 0;
+}
+
+
+void *AudioPCMDumpWriter::writerThread(void *arg) {
+    AudioPCMDumpWriter *writer = static_cast<AudioPCMDumpWriter *>(arg);
+    struct timespec ts;
+
+    prctl(PR_SET_NAME, (unsigned long)"PCMDumpWriter", 0, 0, 0);
+    if (setpriority(PRIO_PROCESS, 0, ANDROID_PRIORITY_BACKGROUND) != 0) {
+        ALOGW("%s(), setpriority fail, errno %d", __FUNCTION__, errno);
+    }
+
+    while (1) {
+        /* no mLock: a slot being registered or unregistered is skipped */
+        for (uint32_t i = 0; i < MAX_PCM_DUMP_FILE_NUM; i++) {
+            PCMDumpSlot *slot = &writer->mSlots[i];
+            if (slot->file.load(std::memory_order_acquire) == NULL) {
+                continue;
+            }
+            AL_LOCK(slot->ioLock);
+            FILE *file = slot->file.load(std::memory_order_acquire);
+            if (file != NULL) {
+                writer->drainSlot(slot, file);
+                writer->reportDrop(slot);
+            }
+            AL_UNLOCK(slot->ioLock);
+        }
+
+        /* batch: sleep a period or until some ring is half full */
+        pthread_mutex_lock(&writer->mWakeMutex);
+        writer->mWriterSleeping.store(true, std::memory_order_relaxed);
+        audio_get_timespec_timeout(&ts, PCM_DUMP_WRITER_PERIOD_MS);
+        pthread_cond_timedwait(&writer->mWakeCond, &writer->mWakeMutex, &ts);
+        writer->mWriterSleeping.store(false, std::memory_order_relaxed);
+        pthread_mutex_unlock(&writer->mWakeMutex);
+    }
+
+    pthread_exit(NULL);
+    return NULL;
+}
+
+
+} /* end of namespace android */
+
@@ -10,6 +10,7 @@
 #include <dlfcn.h>
 
 #include <audio_ringbuf.h>
+#include <AudioPCMDumpWriter.h>
 
 #if defined(MTK_POWERHAL_AUDIO_LATENCY) || defined(MTK_POWERHAL_AUDIO_POWER)
 #include <vendor/mediatek/hardware/power/1.1/IPower.h>
@@ -456,27 +457,6 @@ uint32_t getBufferLatencyMs(const stream_attribute_t *attribute, uint32_t bytes)
 
 //--------pc dump operation
 
-struct BufferDump {
-    void *pBufBase;
-    int ssize_t;
-};
-
-#if defined(PC_EMULATION)
-HANDLE hPCMDumpThread = NULL;
-HANDLE PCMDataNotifyEvent = NULL;
-#else
-pthread_t hPCMDumpThread = 0;
-pthread_cond_t  PCMDataNotifyEvent;
-pthread_mutex_t PCMDataNotifyMutex;
-#endif
-bool pcmDumpThreadCreated = false;
-
-AudioLock mPCMDumpMutex; // use for PCM buffer dump
-KeyedVector<FILE *, Vector<BufferDump *> *> mDumpFileHandleVector; // vector to save current recording client
-int mSleepTime = 2;
-
-void *PCMDumpThread(void *arg);
-
 int AudiocheckAndCreateDirectory(const char *pC) {
     char tmp[PATH_MAX];
     int i = 0;
@@ -522,49 +502,11 @@ FILE *AudioOpendumpPCMFile(const char *filepath, const char *propty) {
         } else {
             FILE *fp = fopen(filepath, "wb");
             if (fp != NULL) {
-
-                AL_LOCK(mPCMDumpMutex);
-
-                Vector<BufferDump *> *pBD = new Vector<BufferDump *>;
-                //ALOGD("AudioOpendumpPCMFile file=%p, pBD=%p",fp, pBD);
-                mDumpFileHandleVector.add(fp, pBD);
-                /*for (size_t i = 0; i < mDumpFileHandleVector.size() ; i++)
-                {
-                    ALOGD("AudioOpendumpPCMFile i=%d, handle=%p, %p",i,mDumpFileHandleVector.keyAt(i),mDumpFileHandleVector.valueAt(i));
-                }*/
-
-                if (!pcmDumpThreadCreated) {
-#if defined(PC_EMULATION)
-                    PCMDataNotifyEvent = CreateEvent(NULL, TRUE, FALSE, "PCMDataNotifyEvent");
-                    hPCMDumpThread = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)PCMDumpThread, NULL, 0, 0);
-                    if (hPCMDumpThread == 0) {
-                        ALOGE("hPCMDumpThread create fail!!!");
-                    } else {
-                        ALOGD("hPCMDumpThread=%lu created", hPCMDumpThread);
-                        pcmDumpThreadCreated = true;
-                    }
-#else
-                    //create PCM data dump thread here
-                    int ret;
-                    ret = pthread_create(&hPCMDumpThread, NULL, PCMDumpThread, NULL);
-                    if (ret != 0) {
-                        ALOGE("hPCMDumpThread create fail!!!");
-                    } else {
-                        ALOGD("hPCMDumpThread created");
-                        pcmDumpThreadCreated = true;
-                    }
-                    ret = pthread_cond_init(&PCMDataNotifyEvent, NULL);
-                    if (ret != 0) {
-                        ALOGE("PCMDataNotifyEvent create fail!!!");
-                    }
-
-                    ret = pthread_mutex_init(&PCMDataNotifyMutex, NULL);
-                    if (ret != 0) {
-                        ALOGE("PCMDataNotifyMutex create fail!!!");
-                    }
-#endif
+                // data is written by AudioPCMDumpWriter thread, fallback to sync fwrite if fail
+                ret = AudioPCMDumpWriter::getInstance()->registerFile(fp, filepath);
+                if (ret != 0) {
+                    ALOGW("AudioOpendumpPCMFile %s registerFile fail %d, write directly", filepath, ret);
                 }
-                AL_UNLOCK(mPCMDumpMutex);
                 return fp;
             } else {
                 ALOGE("AudioFlinger AudioOpendumpPCMFile %s fail", propty);
@@ -576,25 +518,7 @@ FILE *AudioOpendumpPCMFile(const char *filepath, const char *propty) {
 
 void AudioCloseDumpPCMFile(FILE  *file) {
     if (file != NULL) {
-        AL_LOCK(mPCMDumpMutex);
-        //ALOGD("AudioCloseDumpPCMFile file=%p, HandleCount=%d",file,mDumpFileHandleVector.size());
-        if (mDumpFileHandleVector.size()) {
-            for (size_t i = 0; i < mDumpFileHandleVector.size() ; i++) {
-                //ALOGD("AudioCloseDumpPCMFile i=%d, handle=%p",i,mDumpFileHandleVector.keyAt(i));
-                if (file == mDumpFileHandleVector.keyAt(i)) {
-                    FILE *key = mDumpFileHandleVector.keyAt(i);
-                    while ((* mDumpFileHandleVector.valueAt(i)).size() != 0) {
-                        free((* mDumpFileHandleVector.valueAt(i))[0]->pBufBase);
-                        delete (* mDumpFileHandleVector.valueAt(i))[0];
-                        (* mDumpFileHandleVector.valueAt(i)).removeAt(0);
-                    }
-                    delete mDumpFileHandleVector.valueAt(i);
-                    mDumpFileHandleVector.removeItem(key);
-                }
-            }
-        }
-
-        AL_UNLOCK(mPCMDumpMutex);
+        AudioPCMDumpWriter::getInstance()->unregisterFile(file);
         fclose(file);
         file = NULL;
     } else {
@@ -603,95 +527,10 @@ void AudioCloseDumpPCMFile(FILE  *file) {
 }
 
 void AudioDumpPCMData(void *buffer, uint32_t bytes, FILE  *file) {
-    if (pcmDumpThreadCreated) {
-        AL_LOCK(mPCMDumpMutex);
-        if (mDumpFileHandleVector.size()) {
-            for (size_t i = 0; i < mDumpFileHandleVector.size() ; i++) {
-                if (file == mDumpFileHandleVector.keyAt(i)) {
-                    FILE *key = mDumpFileHandleVector.keyAt(i);
-                    //ALOGD("AudioDumpPCMData find!! i=%d, key=%p, value=%p",i,mDumpFileHandleVector.keyAt(i),mDumpFileHandleVector.valueAt(i));
-                    BufferDump *newInBuffer = new BufferDump;
-                    newInBuffer->pBufBase = (short *) malloc(bytes);
-                    memcpy(newInBuffer->pBufBase, buffer, bytes);
-                    newInBuffer->ssize_t = bytes;
-                    (* mDumpFileHandleVector.valueAt(i)).add(newInBuffer);
-
-                    if (mSleepTime == -1) { //need to send event
-#if defined(PC_EMULATION)
-                        SetEvent(PCMDataNotifyEvent);
-#else
-                        pthread_mutex_lock(&PCMDataNotifyMutex);
-                        pthread_cond_signal(&PCMDataNotifyEvent);
-                        pthread_mutex_unlock(&PCMDataNotifyMutex);
-#endif
-                    }
-                }
-            }
-        }
-        AL_UNLOCK(mPCMDumpMutex);
-    } else { //if no dump thread, just write the data
+    // never block the audio thread: copy to ring, drop the period if ring full
+    if (!AudioPCMDumpWriter::getInstance()->push(file, buffer, bytes)) {
         fwrite((void *)buffer, sizeof(char), bytes, file);
     }
-
-}
-
-void *PCMDumpThread(void *arg __unused) {
-    ALOGD("PCMDumpThread");
-    bool bHasdata = false;
-    int iNoDataCount = 0;
-    while (1) {
-        AL_LOCK(mPCMDumpMutex);
-        bHasdata = false;
-        //ALOGV( "PCMDumpThread mDumpFileHandleVector.size()=%d",mDumpFileHandleVector.size());
-        for (size_t i = 0; i < mDumpFileHandleVector.size() ; i++) {
-
-            if ((* mDumpFileHandleVector.valueAt(i)).size() > 0) {
-                bHasdata = true;
-                fwrite((* mDumpFileHandleVector.valueAt(i))[0]->pBufBase, (* mDumpFileHandleVector.valueAt(i))[0]->ssize_t, 1, mDumpFileHandleVector.keyAt(i));
-                free((* mDumpFileHandleVector.valueAt(i))[0]->pBufBase);
-                delete (* mDumpFileHandleVector.valueAt(i))[0];
-                (* mDumpFileHandleVector.valueAt(i)).removeAt(0);
-            }
-        }
-        AL_UNLOCK(mPCMDumpMutex);
-        if (!bHasdata) {
-            iNoDataCount++;
-            if (iNoDataCount >= 1000) {
-                mSleepTime = -1;
-                ALOGD("PCMDumpThread, wait for new data dump\n");
-#if defined(PC_EMULATION)
-                WaitForSingleObject(PCMDataNotifyEvent, INFINITE);
-                ResetEvent(PCMDataNotifyEvent);
-#else
-                pthread_mutex_lock(&PCMDataNotifyMutex);
-                pthread_cond_wait(&PCMDataNotifyEvent, &PCMDataNotifyMutex);
-                pthread_mutex_unlock(&PCMDataNotifyMutex);
-                ALOGD("PCMDumpThread, PCM data dump again\n");
-#endif
-            } else {
-                mSleepTime = 10;
-                usleep(mSleepTime * 1000);
-            }
-        } else {
-            iNoDataCount = 0;
-            mSleepTime = 2;
-            usleep(mSleepTime * 1000);
-        }
-        /*
-                if(mDumpFileHandleVector.size()==0)
-                {
-                    ALOGD( "PCMDumpThread exit, no dump handle real");
-                    hPCMDumpThread = NULL;
-                    pthread_exit(NULL);
-                    return 0;
-                }*/
-
-    }
-
-    ALOGD("PCMDumpThread exit");
-    pcmDumpThreadCreated = false;
-    pthread_exit(NULL);
-    return 0;
 }
 
 #define CVSD_LOOPBACK_BUFFER_SIZE (960 * 10)//BTSCO_CVSD_RX_FRAME*SCO_RX_PCM8K_BUF_SIZE * 10
@@ -0,0 +1,30 @@
+LOCAL_PATH := $(call my-dir)
+
+#
+# pcm dump writer benchmark
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    pcm_dump_bench.cpp \
+    ../AudioPCMDumpWriter.cpp \
+    ../../utility/audio_lock.c \
+    ../../utility/audio_time.c
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/../../include \
+    $(LOCAL_PATH)/../../utility
+
+LOCAL_SHARED_LIBRARIES := \
+    liblog \
+    libcutils \
+    libutils
+
+LOCAL_MODULE := pcm_dump_bench
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,127 @@
+/*
+ * pcm_dump_bench: audio thread cost of AudioDumpPCMData()
+ *
+ *  - sync  : fwrite + fflush in caller thread (the old no-dump-thread path)
+ *  - async : AudioPCMDumpWriter::push()
+ *
+ * usage: pcm_dump_bench [period_bytes] [period_us] [num_periods]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <audio_time.h>
+
+#include <AudioPCMDumpWriter.h>
+
+
+using namespace android;
+
+
+#define DUMP_PATH_SYNC  "/data/vendor/audiohal/audio_dump/pcm_dump_bench_sync.pcm"
+#define DUMP_PATH_ASYNC "/data/vendor/audiohal/audio_dump/pcm_dump_bench_async.pcm"
+
+
+struct BenchResult {
+    uint64_t total_ns;
+    uint64_t max_ns;
+};
+
+
+static void runBench(FILE *file, const bool async, char *period, const uint32_t period_bytes,
+                     const uint32_t period_us, const uint32_t num_periods, BenchResult *result) {
+    struct timespec ts_start;
+    struct timespec ts_stop;
+    uint64_t diff_ns = 0;
+
+    memset(result, 0, sizeof(BenchResult));
+
+    for (uint32_t i = 0; i < num_periods; i++) {
+        memset(period, i & 0xFF, period_bytes);
+
+        audio_get_timespec_monotonic(&ts_start);
+        if (async) {
+            AudioPCMDumpWriter::getInstance()->push(file, period, period_bytes);
+        } else {
+            fwrite(period, 1, period_bytes, file);
+            fflush(file);
+        }
+        audio_get_timespec_monotonic(&ts_stop);
+
+        diff_ns = get_time_diff_ns(&ts_start, &ts_stop);
+        result->total_ns += diff_ns;
+        if (diff_ns > result->max_ns) {
+            result->max_ns = diff_ns;
+        }
+
+        if (period_us != 0) {
+            usleep(period_us);
+        }
+    }
+}
+
+
+int main(int argc, char **argv) {
+    uint32_t period_bytes = 3840;   /* 20ms, 48k, stereo, 16 bit */
+    uint32_t period_us = 1000;      /* faster than realtime */
+    uint32_t num_periods = 5000;
+    BenchResult sync_result;
+    BenchResult async_result;
+    FILE *file = NULL;
+    char *period = NULL;
+
+    if (argc > 1) {
+        period_bytes = (uint32_t)atoi(argv[1]);
+    }
+    if (argc > 2) {
+        period_us = (uint32_t)atoi(argv[2]);
+    }
+    if (argc > 3) {
+        num_periods = (uint32_t)atoi(argv[3]);
+    }
+    if (period_bytes == 0 || num_periods == 0) {
+        printf("invalid args\n");
+        return -1;
+    }
+
+    period = (char *)malloc(period_bytes);
+    if (period == NULL) {
+        return -1;
+    }
+
+    file = fopen(DUMP_PATH_SYNC, "wb");
+    if (file == NULL) {
+        printf("fopen %s fail\n", DUMP_PATH_SYNC);
+        free(period);
+        return -1;
+    }
+    runBench(file, false, period, period_bytes, period_us, num_periods, &sync_result);
+    fclose(file);
+
+    file = fopen(DUMP_PATH_ASYNC, "wb");
+    if (file == NULL) {
+        printf("fopen %s fail\n", DUMP_PATH_ASYNC);
+        free(period);
+        return -1;
+    }
+    AudioPCMDumpWriter::getInstance()->registerFile(file, DUMP_PATH_ASYNC);
+    runBench(file, true, period, period_bytes, period_us, num_periods, &async_result);
+    printf("async drop periods: %u\n", AudioPCMDumpWriter::getInstance()->getDropPeriods(file));
+    AudioPCMDumpWriter::getInstance()->unregisterFile(file);
+    fclose(file);
+
+    printf("period %u bytes, %u periods, interval %u us\n", period_bytes, num_periods, period_us);
+    printf("sync  avg %6llu ns, max %8llu ns\n",
+           (unsigned long long)(sync_result.total_ns / num_periods),
+           (unsigned long long)sync_result.max_ns);
+    printf("async avg %6llu ns, max %8llu ns\n",
+           (unsigned long long)(async_result.total_ns / num_periods),
+           (unsigned long long)async_result.max_ns);
+
+    unlink(DUMP_PATH_SYNC);
+    unlink(DUMP_PATH_ASYNC);
+    free(period);
+    return 0;
+}
@@ -25,6 +25,7 @@ extern "C" {
 
 struct aurisys_lib_handler_t;
 struct AurisysLibInterface;
+struct aurisys_param_cache_t;
 
 /*
  * =============================================================================
@@ -92,6 +93,8 @@ typedef struct aurisys_library_config_t {
 
     aurisys_component_t *component_hh;
 
+    struct aurisys_param_cache_t *param_cache_list; /* parsed param bufs, keyed by config */
+
     UT_hash_handle hh; /* makes this structure hashable */
 } aurisys_library_config_t;
 /* <-- for <hal_librarys> */
@@ -100,6 +103,9 @@ typedef struct aurisys_library_config_t {
 typedef struct aurisys_config_t {
     aurisys_scene_lib_table_t *scene_lib_table_hh;
     aurisys_library_config_t  *library_config_hh;
+
+    void     *cache_blob;      /* mmap of aurisys_config.bin; NULL when parsed from xml */
+    uint32_t  cache_blob_size;
 } aurisys_config_t;
 
 
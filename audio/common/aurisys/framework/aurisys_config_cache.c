@@ -0,0 +1,958 @@
+#include "aurisys_config_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <uthash.h> /* uthash */
+#include <utlist.h> /* linked list */
+
+#include <wrapped_audio.h>
+
+#include <audio_log.h>
+#include <audio_assert.h>
+#include <audio_memory_control.h>
+
+#include <arsi_type.h>
+#include <aurisys_config.h>
+
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+#define LOG_TAG "aurisys_config_cache"
+
+
+/*
+ * =============================================================================
+ *                     MACRO
+ * =============================================================================
+ */
+
+#define AURISYS_CONFIG_CACHE_MAGIC   (0x41524353) /* "ARCS" */
+
+/* NOTE: bump it whenever the layout of the structs in aurisys_config.h changes */
+#define AURISYS_CONFIG_CACHE_VERSION (1)
+
+#define AURISYS_CONFIG_CACHE_ALIGN   (8)
+
+#define MAX_PARAM_PATH_LEN      (256)
+
+#define FNV1A_64_OFFSET_BASIS (0xcbf29ce484222325ULL)
+#define FNV1A_64_PRIME        (0x100000001b3ULL)
+
+#define ALIGN_CACHE_OFFSET(offset) \
+    (((offset) + (AURISYS_CONFIG_CACHE_ALIGN - 1)) & ~(AURISYS_CONFIG_CACHE_ALIGN - 1))
+
+/* pointer fields keep the blob offset in file; 0 means NULL */
+#define OFFSET_TO_PTR(offset) ((void *)(uintptr_t)(offset))
+
+
+/*
+ * =============================================================================
+ *                     typedef
+ * =============================================================================
+ */
+
+typedef struct aurisys_config_cache_header_t {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t abi_signature;
+    uint32_t blob_size;
+
+    uint64_t xml_hash;
+    uint32_t xml_size;
+
+    uint32_t num_scene_lib_table;
+    uint32_t scene_lib_table_offset;  /* aurisys_cache_scene_t[] */
+
+    uint32_t num_library_config;
+    uint32_t library_config_offset;   /* aurisys_cache_library_t[] */
+
+    uint32_t __reserved;
+} aurisys_config_cache_header_t;
+
+
+typedef struct aurisys_cache_scene_t {
+    aurisys_scene_lib_table_t scene_lib_table; /* name lists -> aurisys_library_name_t[] */
+    uint32_t num_uplink_library_name;
+    uint32_t num_downlink_library_name;
+} aurisys_cache_scene_t;
+
+
+typedef struct aurisys_cache_library_t {
+    aurisys_library_config_t library_config;   /* component_hh -> aurisys_component_t[] */
+    uint32_t num_component;
+    uint32_t __reserved;
+} aurisys_cache_library_t;
+
+
+typedef struct aurisys_param_cache_key_t {
+    arsi_task_config_t task_config;
+
+    uint32_t sample_rate;
+    uint32_t audio_format;
+    uint32_t frame_size_ms;
+    uint32_t b_interleave;
+    uint32_t num_ul_ref_buf_array;
+    uint32_t num_dl_ref_buf_array;
+    uint32_t num_channels_ul_in;
+    uint32_t num_channels_ul_out;
+    uint32_t num_channels_dl_in;
+    uint32_t num_channels_dl_out;
+
+    int32_t  enhancement_mode;
+
+    /* the param file is re-tuned in place by tools */
+    int64_t  param_file_size;
+    int64_t  param_file_mtime_sec;
+    int64_t  param_file_mtime_nsec;
+} aurisys_param_cache_key_t;
+
+
+typedef struct aurisys_param_cache_t {
+    aurisys_param_cache_key_t key;
+
+    uint32_t data_size;
+    char    *p_param;
+
+    struct aurisys_param_cache_t *prev;
+    struct aurisys_param_cache_t *next;
+} aurisys_param_cache_t;
+
+
+/* pass 1 (base == NULL) only counts the blob size, pass 2 fills the blob */
+typedef struct aurisys_cache_writer_t {
+    char     *base;
+    uint32_t  used;
+} aurisys_cache_writer_t;
+
+
+/*
+ * =============================================================================
+ *                     private function declaration
+ * =============================================================================
+ */
+
+static uint32_t get_abi_signature(void);
+
+static uint32_t cache_put(aurisys_cache_writer_t *writer, const void *src, const uint32_t size);
+static uint32_t cache_put_string(aurisys_cache_writer_t *writer, const char *string);
+static uint32_t cache_put_string_with_size(aurisys_cache_writer_t *writer, const char *string, const uint32_t size);
+static uint32_t cache_put_audio_bufs(aurisys_cache_writer_t *writer, const audio_buf_t *bufs, const uint32_t num_bufs);
+static uint32_t cache_put_name_list(aurisys_cache_writer_t *writer, aurisys_library_name_t *name_list, uint32_t *num_name);
+static uint32_t cache_put_components(aurisys_cache_writer_t *writer, aurisys_component_t *component_hh, uint32_t *num_component);
+static void serialize_aurisys_config(aurisys_cache_writer_t *writer, const aurisys_config_t *aurisys_config, const uint64_t xml_hash, const uint32_t xml_size);
+
+static void *relocate(char *base, const uint32_t blob_size, void *offset_ptr, const uint32_t size);
+static char *relocate_string(char *base, const uint32_t blob_size, char *offset_ptr);
+static int relocate_lib_config(char *base, const uint32_t blob_size, arsi_lib_config_t *lib_config);
+static int rebuild_aurisys_config(char *base, const uint32_t blob_size, aurisys_config_t *aurisys_config);
+static void clear_rebuilt_hash(aurisys_config_t *aurisys_config);
+
+static void make_param_cache_key(
+    aurisys_param_cache_key_t *key,
+    const arsi_task_config_t *arsi_task_config,
+    const arsi_lib_config_t  *arsi_lib_config,
+    const char               *param_file_path,
+    const int32_t             enhancement_mode);
+static aurisys_param_cache_t *find_param_cache(
+    aurisys_param_cache_t *param_cache_list,
+    const aurisys_param_cache_key_t *key);
+
+
+/*
+ * =============================================================================
+ *                     private global members
+ * =============================================================================
+ */
+
+static pthread_mutex_t g_param_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/*
+ * =============================================================================
+ *                     public function implementation
+ * =============================================================================
+ */
+
+uint64_t aurisys_config_cache_hash(const void *data, const uint32_t size) {
+    const uint8_t *p = (const uint8_t *)data;
+    uint64_t hash = FNV1A_64_OFFSET_BASIS;
+    uint32_t i = 0;
+
+    if (data == NULL) {
+        return 0;
+    }
+
+    for (i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= FNV1A_64_PRIME;
+    }
+
+    return hash;
+}
+
+
+aurisys_config_t *aurisys_config_cache_load(
+    const char *cache_path,
+    const uint64_t xml_hash,
+    const uint32_t xml_size) {
+    aurisys_config_t *aurisys_config = NULL;
+    aurisys_config_cache_header_t *header = NULL;
+
+    struct stat st;
+    void *blob = MAP_FAILED;
+    int fd = -1;
+
+    if (cache_path == NULL) {
+        return NULL;
+    }
+
+    fd = open(cache_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        AUD_LOG_D("%s(), no cache %s, errno %d", __FUNCTION__, cache_path, errno);
+        return NULL;
+    }
+
+    if (fstat(fd, &st) != 0 ||
+        st.st_size < (off_t)sizeof(aurisys_config_cache_header_t) ||
+        st.st_size > (off_t)UINT32_MAX) {
+        AUD_LOG_W("%s(), bad cache size", __FUNCTION__);
+        close(fd);
+        return NULL;
+    }
+
+    /* private & writable: relocation and hash handles only touch COW pages */
+    blob = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (blob == MAP_FAILED) {
+        AUD_LOG_W("%s(), mmap fail, errno %d", __FUNCTION__, errno);
+        return NULL;
+    }
+
+    header = (aurisys_config_cache_header_t *)blob;
+    if (header->magic != AURISYS_CONFIG_CACHE_MAGIC ||
+        header->version != AURISYS_CONFIG_CACHE_VERSION ||
+        header->abi_signature != get_abi_signature() ||
+        header->blob_size != (uint32_t)st.st_size) {
+        AUD_LOG_D("%s(), cache format mismatch", __FUNCTION__);
+        munmap(blob, st.st_size);
+        return NULL;
+    }
+
+    if (header->xml_hash != xml_hash || header->xml_size != xml_size) {
+        AUD_LOG_D("%s(), xml changed, hash 0x%llx => 0x%llx", __FUNCTION__,
+                  (unsigned long long)header->xml_hash, (unsigned long long)xml_hash);
+        munmap(blob, st.st_size);
+        return NULL;
+    }
+
+    AUDIO_ALLOC_STRUCT(aurisys_config_t, aurisys_config);
+    aurisys_config->cache_blob = blob;
+    aurisys_config->cache_blob_size = (uint32_t)st.st_size;
+
+    if (rebuild_aurisys_config((char *)blob, (uint32_t)st.st_size, aurisys_config) != 0) {
+        AUD_LOG_W("%s(), cache corrupted!! ignore it", __FUNCTION__);
+        clear_rebuilt_hash(aurisys_config);
+        munmap(blob, st.st_size);
+        AUDIO_FREE_POINTER(aurisys_config);
+        return NULL;
+    }
+
+    AUD_LOG_D("%s(), hit %s, blob_size %u", __FUNCTION__, cache_path, header->blob_size);
+    return aurisys_config;
+}
+
+
+int aurisys_config_cache_store(
+    const char *cache_path,
+    const aurisys_config_t *aurisys_config,
+    const uint64_t xml_hash,
+    const uint32_t xml_size) {
+    aurisys_cache_writer_t writer;
+    char tmp_path[256];
+
+    ssize_t write_size = 0;
+    int fd = -1;
+    int retval = 0;
+
+    if (cache_path == NULL || aurisys_config == NULL) {
+        return -EINVAL;
+    }
+
+    /* pass 1: count */
+    memset(&writer, 0, sizeof(writer));
+    serialize_aurisys_config(&writer, aurisys_config, xml_hash, xml_size);
+
+    /* pass 2: fill */
+    AUDIO_ALLOC_CHAR_BUFFER(writer.base, writer.used);
+    writer.used = 0;
+    serialize_aurisys_config(&writer, aurisys_config, xml_hash, xml_size);
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", cache_path);
+    fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+    if (fd < 0) {
+        AUD_LOG_W("%s(), open %s fail, errno %d", __FUNCTION__, tmp_path, errno);
+        AUDIO_FREE_POINTER(writer.base);
+        return -errno;
+    }
+
+    write_size = write(fd, writer.base, writer.used);
+    if (write_size != (ssize_t)writer.used || fsync(fd) != 0) {
+        AUD_LOG_W("%s(), write %s fail, errno %d", __FUNCTION__, tmp_path, errno);
+        retval = -EIO;
+    }
+    close(fd);
+
+    if (retval == 0 && rename(tmp_path, cache_path) != 0) {
+        AUD_LOG_W("%s(), rename to %s fail, errno %d", __FUNCTION__, cache_path, errno);
+        retval = -errno;
+    }
+    if (retval != 0) {
+        unlink(tmp_path);
+    }
+
+    AUD_LOG_D("%s(), %s blob_size %u, retval %d", __FUNCTION__, cache_path, writer.used, retval);
+    AUDIO_FREE_POINTER(writer.base);
+    return retval;
+}
+
+
+void aurisys_config_cache_unmap(aurisys_config_t *aurisys_config) {
+    if (aurisys_config == NULL || aurisys_config->cache_blob == NULL) {
+        return;
+    }
+
+    munmap(aurisys_config->cache_blob, aurisys_config->cache_blob_size);
+    aurisys_config->cache_blob = NULL;
+    aurisys_config->cache_blob_size = 0;
+}
+
+
+bool aurisys_config_is_cache_backed(const aurisys_config_t *aurisys_config) {
+    return (aurisys_config != NULL && aurisys_config->cache_blob != NULL);
+}
+
+
+void aurisys_config_cache_invalidate(const char *cache_path) {
+    if (cache_path == NULL) {
+        return;
+    }
+
+    if (unlink(cache_path) != 0 && errno != ENOENT) {
+        AUD_LOG_W("%s(), unlink %s fail, errno %d", __FUNCTION__, cache_path, errno);
+    }
+}
+
+
+int aurisys_param_cache_fetch(
+    aurisys_param_cache_t **param_cache_list,
+    const arsi_task_config_t *arsi_task_config,
+    const arsi_lib_config_t  *arsi_lib_config,
+    const char               *param_file_path,
+    const int32_t             enhancement_mode,
+    data_buf_t               *param_buf) {
+    aurisys_param_cache_key_t key;
+    aurisys_param_cache_t *entry = NULL;
+    int retval = -ENOENT;
+
+    if (param_cache_list == NULL || param_buf == NULL || param_buf->p_buffer == NULL) {
+        return -EINVAL;
+    }
+
+    make_param_cache_key(&key, arsi_task_config, arsi_lib_config, param_file_path, enhancement_mode);
+
+    pthread_mutex_lock(&g_param_cache_lock);
+    entry = find_param_cache(*param_cache_list, &key);
+    if (entry != NULL && entry->data_size <= param_buf->memory_size) {
+        memset(param_buf->p_buffer, 0, param_buf->memory_size);
+        memcpy(param_buf->p_buffer, entry->p_param, entry->data_size);
+        param_buf->data_size = entry->data_size;
+
+        /* LRU: move to head */
+        DL_DELETE(*param_cache_list, entry);
+        DL_PREPEND(*param_cache_list, entry);
+        retval = 0;
+    }
+    pthread_mutex_unlock(&g_param_cache_lock);
+
+    AUD_LOG_V("%s(), \"%s\" mode %d, %s", __FUNCTION__, param_file_path,
+              enhancement_mode, (retval == 0) ? "hit" : "miss");
+    return retval;
+}
+
+
+void aurisys_param_cache_update(
+    aurisys_param_cache_t **param_cache_list,
+    const arsi_task_config_t *arsi_task_config,
+    const arsi_lib_config_t  *arsi_lib_config,
+    const char               *param_file_path,
+    const int32_t             enhancement_mode,
+    const data_buf_t         *param_buf) {
+    aurisys_param_cache_key_t key;
+    aurisys_param_cache_t *entry = NULL;
+    aurisys_param_cache_t *itor = NULL;
+    uint32_t num_entry = 0;
+
+    if (param_cache_list == NULL || param_buf == NULL || param_buf->p_buffer == NULL ||
+        param_buf->data_size == 0 || param_buf->data_size > param_buf->memory_size) {
+        return;
+    }
+
+    make_param_cache_key(&key, arsi_task_config, arsi_lib_config, param_file_path, enhancement_mode);
+
+    pthread_mutex_lock(&g_param_cache_lock);
+    entry = find_param_cache(*param_cache_list, &key);
+    if (entry != NULL) {
+        DL_DELETE(*param_cache_list, entry);
+        AUDIO_FREE_POINTER(entry->p_param);
+    } else {
+        DL_COUNT(*param_cache_list, itor, num_entry);
+        if (num_entry >= AURISYS_PARAM_CACHE_MAX_ENTRY) {
+            entry = (*param_cache_list)->prev; /* tail */
+            DL_DELETE(*param_cache_list, entry);
+            AUDIO_FREE_POINTER(entry->p_param);
+        } else {
+            AUDIO_ALLOC_STRUCT(aurisys_param_cache_t, entry);
+        }
+    }
+
+    memcpy(&entry->key, &key, sizeof(key));
+    entry->data_size = param_buf->data_size;
+    AUDIO_ALLOC_CHAR_BUFFER(entry->p_param, entry->data_size);
+    memcpy(entry->p_param, param_buf->p_buffer, entry->data_size);
+    DL_PREPEND(*param_cache_list, entry);
+    pthread_mutex_unlock(&g_param_cache_lock);
+}
+
+
+void aurisys_param_cache_clear(aurisys_param_cache_t **param_cache_list) {
+    aurisys_param_cache_t *itor = NULL;
+    aurisys_param_cache_t *tmp = NULL;
+
+    if (param_cache_list == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&g_param_cache_lock);
+    DL_FOREACH_SAFE(*param_cache_list, itor, tmp) {
+        DL_DELETE(*param_cache_list, itor);
+        AUDIO_FREE_POINTER(itor->p_param);
+        AUDIO_FREE_POINTER(itor);
+    }
+    pthread_mutex_unlock(&g_param_cache_lock);
+}
+
+
+/*
+ * =============================================================================
+ *                     private function implementation
+ * =============================================================================
+ */
+
+static void make_param_cache_key(
+    aurisys_param_cache_key_t *key,
+    const arsi_task_config_t *arsi_task_config,
+    const arsi_lib_config_t  *arsi_lib_config,
+    const char               *param_file_path,
+    const int32_t             enhancement_mode) {
+    struct stat st;
+
+    memset(key, 0, sizeof(aurisys_param_cache_key_t));
+
+    if (arsi_task_config != NULL) {
+        memcpy(&key->task_config, arsi_task_config, sizeof(arsi_task_config_t));
+    }
+
+    if (arsi_lib_config != NULL) {
+        key->sample_rate = arsi_lib_config->sample_rate;
+        key->audio_format = arsi_lib_config->audio_format;
+        key->frame_size_ms = arsi_lib_config->frame_size_ms;
+        key->b_interleave = arsi_lib_config->b_interleave;
+        key->num_ul_ref_buf_array = arsi_lib_config->num_ul_ref_buf_array;
+        key->num_dl_ref_buf_array = arsi_lib_config->num_dl_ref_buf_array;
+        if (arsi_lib_config->p_ul_buf_in != NULL) {
+            key->num_channels_ul_in = arsi_lib_config->p_ul_buf_in->num_channels;
+        }
+        if (arsi_lib_config->p_ul_buf_out != NULL) {
+            key->num_channels_ul_out = arsi_lib_config->p_ul_buf_out->num_channels;
+        }
+        if (arsi_lib_config->p_dl_buf_in != NULL) {
+            key->num_channels_dl_in = arsi_lib_config->p_dl_buf_in->num_channels;
+        }
+        if (arsi_lib_config->p_dl_buf_out != NULL) {
+            key->num_channels_dl_out = arsi_lib_config->p_dl_buf_out->num_channels;
+        }
+    }
+
+    key->enhancement_mode = enhancement_mode;
+
+    if (param_file_path != NULL && stat(param_file_path, &st) == 0) {
+        key->param_file_size = st.st_size;
+        key->param_file_mtime_sec = st.st_mtim.tv_sec;
+        key->param_file_mtime_nsec = st.st_mtim.tv_nsec;
+    }
+}
+
+
+static aurisys_param_cache_t *find_param_cache(
+    aurisys_param_cache_t *param_cache_list,
+    const aurisys_param_cache_key_t *key) {
+    aurisys_param_cache_t *itor = NULL;
+
+    DL_FOREACH(param_cache_list, itor) {
+        if (memcmp(&itor->key, key, sizeof(aurisys_param_cache_key_t)) == 0) {
+            return itor;
+        }
+    }
+
+    return NULL;
+}
+
+
+static uint32_t get_abi_signature(void) {
+    uint32_t signature = 0;
+
+    signature = (signature * 31) + (uint32_t)sizeof(void *);
+    signature = (signature * 31) + (uint32_t)sizeof(aurisys_scene_lib_table_t);
+    signature = (signature * 31) + (uint32_t)sizeof(aurisys_library_name_t);
+    signature = (signature * 31) + (uint32_t)sizeof(aurisys_library_config_t);
+    signature = (signature * 31) + (uint32_t)sizeof(aurisys_component_t);
+    signature = (signature * 31) + (uint32_t)sizeof(arsi_lib_config_t);
+    signature = (signature * 31) + (uint32_t)sizeof(audio_buf_t);
+    signature = (signature * 31) + (uint32_t)NUM_DATA_BUF_TYPE;
+
+    return signature;
+}
+
+
+static uint32_t cache_put(aurisys_cache_writer_t *writer, const void *src, const uint32_t size) {
+    uint32_t offset = ALIGN_CACHE_OFFSET(writer->used);
+
+    if (writer->base != NULL && src != NULL) {
+        memcpy(writer->base + offset, src, size);
+    }
+    writer->used = offset + size;
+
+    return offset;
+}
+
+
+static uint32_t cache_put_string(aurisys_cache_writer_t *writer, const char *string) {
+    if (string == NULL) {
+        return 0;
+    }
+
+    return cache_put(writer, string, (uint32_t)strlen(string) + 1);
+}
+
+
+static uint32_t cache_put_string_with_size(aurisys_cache_writer_t *writer, const char *string, const uint32_t size) {
+    uint32_t offset = 0;
+    uint32_t string_size = 0;
+
+    if (string == NULL) {
+        return 0;
+    }
+
+    /* keep the whole buffer: adb cmd strncpy new paths into it in place */
+    offset = cache_put(writer, NULL, size);
+    if (writer->base != NULL) {
+        string_size = (uint32_t)strnlen(string, size - 1);
+        memset(writer->base + offset, 0, size);
+        memcpy(writer->base + offset, string, string_size);
+    }
+
+    return offset;
+}
+
+
+static uint32_t cache_put_audio_bufs(aurisys_cache_writer_t *writer, const audio_buf_t *bufs, const uint32_t num_bufs) {
+    audio_buf_t *des = NULL;
+    uint32_t offset = 0;
+    uint32_t i = 0;
+
+    if (bufs == NULL || num_bufs == 0) {
+        return 0;
+    }
+
+    offset = cache_put(writer, bufs, num_bufs * sizeof(audio_buf_t));
+    if (writer->base != NULL) {
+        des = (audio_buf_t *)(writer->base + offset);
+        for (i = 0; i < num_bufs; i++) {
+            memset(&des[i].data_buf, 0, sizeof(des[i].data_buf));
+        }
+    }
+
+    return offset;
+}
+
+
+static uint32_t cache_put_name_list(aurisys_cache_writer_t *writer, aurisys_library_name_t *name_list, uint32_t *num_name) {
+    aurisys_library_name_t *itor_library_name = NULL;
+    aurisys_library_name_t *tmp_library_name = NULL;
+    aurisys_library_name_t *des = NULL;
+
+    uint32_t array_offset = 0;
+    uint32_t i = 0;
+
+    *num_name = HASH_COUNT(name_list);
+    if (*num_name == 0) {
+        return 0;
+    }
+
+    /* NOTE: keep the insertion order. it is the processing order of libs */
+    array_offset = cache_put(writer, NULL, (*num_name) * sizeof(aurisys_library_name_t));
+    HASH_ITER(hh, name_list, itor_library_name, tmp_library_name) {
+        uint32_t name_offset = cache_put_string(writer, itor_library_name->name);
+        if (writer->base != NULL) {
+            des = (aurisys_library_name_t *)(writer->base + array_offset) + i;
+            memset(des, 0, sizeof(aurisys_library_name_t));
+            des->name = (char *)OFFSET_TO_PTR(name_offset);
+        }
+        i++;
+    }
+
+    return array_offset;
+}
+
+
+static uint32_t cache_put_components(aurisys_cache_writer_t *writer, aurisys_component_t *component_hh, uint32_t *num_component) {
+    aurisys_component_t *itor_comp = NULL;
+    aurisys_component_t *tmp_comp = NULL;
+    aurisys_component_t *des = NULL;
+    arsi_lib_config_t *src_cfg = NULL;
+
+    uint32_t array_offset = 0;
+    uint32_t ul_in = 0, ul_out = 0, ul_refs = 0;
+    uint32_t dl_in = 0, dl_out = 0, dl_refs = 0;
+    uint32_t i = 0;
+
+    *num_component = HASH_COUNT(component_hh);
+    if (*num_component == 0) {
+        return 0;
+    }
+
+    array_offset = cache_put(writer, NULL, (*num_component) * sizeof(aurisys_component_t));
+    HASH_ITER(hh, component_hh, itor_comp, tmp_comp) {
+        src_cfg = &itor_comp->lib_config;
+
+        ul_in   = cache_put_audio_bufs(writer, src_cfg->p_ul_buf_in, 1);
+        ul_out  = cache_put_audio_bufs(writer, src_cfg->p_ul_buf_out, 1);
+        ul_refs = cache_put_audio_bufs(writer, src_cfg->p_ul_ref_bufs, src_cfg->num_ul_ref_buf_array);
+        dl_in   = cache_put_audio_bufs(writer, src_cfg->p_dl_buf_in, 1);
+        dl_out  = cache_put_audio_bufs(writer, src_cfg->p_dl_buf_out, 1);
+        dl_refs = cache_put_audio_bufs(writer, src_cfg->p_dl_ref_bufs, src_cfg->num_dl_ref_buf_array);
+
+        if (writer->base != NULL) {
+            des = (aurisys_component_t *)(writer->base + array_offset) + i;
+            memcpy(des, itor_comp, sizeof(aurisys_component_t));
+            memset(&des->hh, 0, sizeof(des->hh));
+            des->lib_handler_list_for_adb_cmd = NULL;
+
+            des->lib_config.p_ul_buf_in   = (audio_buf_t *)OFFSET_TO_PTR(ul_in);
+            des->lib_config.p_ul_buf_out  = (audio_buf_t *)OFFSET_TO_PTR(ul_out);
+            des->lib_config.p_ul_ref_bufs = (audio_buf_t *)OFFSET_TO_PTR(ul_refs);
+            des->lib_config.p_dl_buf_in   = (audio_buf_t *)OFFSET_TO_PTR(dl_in);
+            des->lib_config.p_dl_buf_out  = (audio_buf_t *)OFFSET_TO_PTR(dl_out);
+            des->lib_config.p_dl_ref_bufs = (audio_buf_t *)OFFSET_TO_PTR(dl_refs);
+        }
+        i++;
+    }
+
+    return array_offset;
+}
+
+
+static void serialize_aurisys_config(
+    aurisys_cache_writer_t *writer,
+    const aurisys_config_t *aurisys_config,
+    const uint64_t xml_hash,
+    const uint32_t xml_size) {
+    aurisys_config_cache_header_t *header = NULL;
+
+    aurisys_scene_lib_table_t *itor_scene_lib_table = NULL;
+    aurisys_scene_lib_table_t *tmp_scene_lib_table = NULL;
+    aurisys_cache_scene_t *des_scene = NULL;
+
+    aurisys_library_config_t *itor_lib = NULL;
+    aurisys_library_config_t *tmp_lib = NULL;
+    aurisys_cache_library_t *des_lib = NULL;
+
+    uint32_t header_offset = 0;
+    uint32_t scene_offset = 0;
+    uint32_t library_offset = 0;
+    uint32_t num_scene = 0;
+    uint32_t num_library = 0;
+    uint32_t i = 0;
+
+    header_offset = cache_put(writer, NULL, sizeof(aurisys_config_cache_header_t));
+
+
+    /* <aurisys_scenarios> */
+    num_scene = HASH_COUNT(aurisys_config->scene_lib_table_hh);
+    scene_offset = cache_put(writer, NULL, num_scene * sizeof(aurisys_cache_scene_t));
+
+    i = 0;
+    HASH_ITER(hh, aurisys_config->scene_lib_table_hh, itor_scene_lib_table, tmp_scene_lib_table) {
+        uint32_t num_ul = 0, num_dl = 0;
+        uint32_t ul_list = cache_put_name_list(writer, itor_scene_lib_table->uplink_library_name_list, &num_ul);
+        uint32_t dl_list = cache_put_name_list(writer, itor_scene_lib_table->downlink_library_name_list, &num_dl);
+        uint32_t ul_gain = cache_put_string(writer, itor_scene_lib_table->uplink_digital_gain_lib_name);
+        uint32_t dl_gain = cache_put_string(writer, itor_scene_lib_table->downlink_digital_gain_lib_name);
+
+        if (writer->base != NULL) {
+            des_scene = (aurisys_cache_scene_t *)(writer->base + scene_offset) + i;
+            memset(des_scene, 0, sizeof(aurisys_cache_scene_t));
+            des_scene->scene_lib_table.aurisys_scenario = itor_scene_lib_table->aurisys_scenario;
+            des_scene->scene_lib_table.uplink_library_name_list = (aurisys_library_name_t *)OFFSET_TO_PTR(ul_list);
+            des_scene->scene_lib_table.downlink_library_name_list = (aurisys_library_name_t *)OFFSET_TO_PTR(dl_list);
+            des_scene->scene_lib_table.uplink_digital_gain_lib_name = (char *)OFFSET_TO_PTR(ul_gain);
+            des_scene->scene_lib_table.downlink_digital_gain_lib_name = (char *)OFFSET_TO_PTR(dl_gain);
+            des_scene->num_uplink_library_name = num_ul;
+            des_scene->num_downlink_library_name = num_dl;
+        }
+        i++;
+    }
+
+
+    /* <hal_librarys> */
+    num_library = HASH_COUNT(aurisys_config->library_config_hh);
+    library_offset = cache_put(writer, NULL, num_library * sizeof(aurisys_cache_library_t));
+
+    i = 0;
+    HASH_ITER(hh, aurisys_config->library_config_hh, itor_lib, tmp_lib) {
+        uint32_t num_comp = 0;
+        uint32_t name = cache_put_string(writer, itor_lib->name);
+        uint32_t lib_path = cache_put_string(writer, itor_lib->lib_path);
+        uint32_t lib64_path = cache_put_string(writer, itor_lib->lib64_path);
+        uint32_t param_path = cache_put_string_with_size(writer, itor_lib->param_path, MAX_PARAM_PATH_LEN);
+        uint32_t lib_dump_path = cache_put_string_with_size(writer, itor_lib->lib_dump_path, MAX_PARAM_PATH_LEN);
+        uint32_t adb_cmd_key = cache_put_string(writer, itor_lib->adb_cmd_key);
+        uint32_t components = cache_put_components(writer, itor_lib->component_hh, &num_comp);
+
+        if (writer->base != NULL) {
+            des_lib = (aurisys_cache_library_t *)(writer->base + library_offset) + i;
+            memset(des_lib, 0, sizeof(aurisys_cache_library_t));
+            des_lib->library_config.name = (char *)OFFSET_TO_PTR(name);
+            des_lib->library_config.lib_path = (char *)OFFSET_TO_PTR(lib_path);
+            des_lib->library_config.lib64_path = (char *)OFFSET_TO_PTR(lib64_path);
+            des_lib->library_config.param_path = (char *)OFFSET_TO_PTR(param_path);
+            des_lib->library_config.lib_dump_path = (char *)OFFSET_TO_PTR(lib_dump_path);
+            des_lib->library_config.adb_cmd_key = (char *)OFFSET_TO_PTR(adb_cmd_key);
+            des_lib->library_config.component_hh = (aurisys_component_t *)OFFSET_TO_PTR(components);
+            des_lib->num_component = num_comp;
+        }
+        i++;
+    }
+
+    writer->used = ALIGN_CACHE_OFFSET(writer->used);
+
+
+    if (writer->base != NULL) {
+        header = (aurisys_config_cache_header_t *)(writer->base + header_offset);
+        header->magic = AURISYS_CONFIG_CACHE_MAGIC;
+        header->version = AURISYS_CONFIG_CACHE_VERSION;
+        header->abi_signature = get_abi_signature();
+        header->blob_size = writer->used;
+        header->xml_hash = xml_hash;
+        header->xml_size = xml_size;
+        header->num_scene_lib_table = num_scene;
+        header->scene_lib_table_offset = scene_offset;
+        header->num_library_config = num_library;
+        header->library_config_offset = library_offset;
+    }
+}
+
+
+static void *relocate(char *base, const uint32_t blob_size, void *offset_ptr, const uint32_t size) {
+    uintptr_t offset = (uintptr_t)offset_ptr;
+
+    if (offset == 0 || offset >= blob_size || size > blob_size - offset) {
+        return NULL;
+    }
+
+    return base + offset;
+}
+
+
+static char *relocate_string(char *base, const uint32_t blob_size, char *offset_ptr) {
+    char *string = (char *)relocate(base, blob_size, offset_ptr, 1);
+
+    if (string == NULL) {
+        return NULL;
+    }
+    if (memchr(string, '\0', blob_size - (string - base)) == NULL) {
+        return NULL;
+    }
+
+    return string;
+}
+
+
+static int relocate_lib_config(char *base, const uint32_t blob_size, arsi_lib_config_t *lib_config) {
+#define RELOCATE_AUDIO_BUF(field, num) \
+    do { \
+        if (lib_config->field != NULL) { \
+            lib_config->field = (audio_buf_t *)relocate( \
+                                    base, blob_size, lib_config->field, (num) * sizeof(audio_buf_t)); \
+            if (lib_config->field == NULL) { \
+                return -1; \
+            } \
+        } \
+    } while (0)
+
+    RELOCATE_AUDIO_BUF(p_ul_buf_in, 1);
+    RELOCATE_AUDIO_BUF(p_ul_buf_out, 1);
+    RELOCATE_AUDIO_BUF(p_ul_ref_bufs, lib_config->num_ul_ref_buf_array);
+    RELOCATE_AUDIO_BUF(p_dl_buf_in, 1);
+    RELOCATE_AUDIO_BUF(p_dl_buf_out, 1);
+    RELOCATE_AUDIO_BUF(p_dl_ref_bufs, lib_config->num_dl_ref_buf_array);
+
+#undef RELOCATE_AUDIO_BUF
+    return 0;
+}
+
+
+static int rebuild_aurisys_config(char *base, const uint32_t blob_size, aurisys_config_t *aurisys_config) {
+    aurisys_config_cache_header_t *header = (aurisys_config_cache_header_t *)base;
+
+    aurisys_cache_scene_t *scenes = NULL;
+    aurisys_cache_library_t *libs = NULL;
+
+    aurisys_scene_lib_table_t *scene = NULL;
+    aurisys_library_config_t *lib = NULL;
+    aurisys_library_name_t *names = NULL;
+    aurisys_component_t *comps = NULL;
+
+    uint32_t i = 0;
+    uint32_t j = 0;
+
+    scenes = (aurisys_cache_scene_t *)relocate(
+                 base, blob_size, OFFSET_TO_PTR(header->scene_lib_table_offset),
+                 header->num_scene_lib_table * sizeof(aurisys_cache_scene_t));
+    libs = (aurisys_cache_library_t *)relocate(
+               base, blob_size, OFFSET_TO_PTR(header->library_config_offset),
+               header->num_library_config * sizeof(aurisys_cache_library_t));
+    if (scenes == NULL || libs == NULL) {
+        return -1;
+    }
+
+
+    /* <aurisys_scenarios> */
+    for (i = 0; i < header->num_scene_lib_table; i++) {
+        scene = &scenes[i].scene_lib_table;
+
+        scene->uplink_digital_gain_lib_name =
+            relocate_string(base, blob_size, scene->uplink_digital_gain_lib_name);
+        scene->downlink_digital_gain_lib_name =
+            relocate_string(base, blob_size, scene->downlink_digital_gain_lib_name);
+
+        /* add first, so that clear_rebuilt_hash() sees the partial lists */
+        HASH_ADD_INT(aurisys_config->scene_lib_table_hh, aurisys_scenario, scene);
+
+        names = (aurisys_library_name_t *)relocate(
+                    base, blob_size, scene->uplink_library_name_list,
+                    scenes[i].num_uplink_library_name * sizeof(aurisys_library_name_t));
+        scene->uplink_library_name_list = NULL;
+        for (j = 0; names != NULL && j < scenes[i].num_uplink_library_name; j++) {
+            names[j].name = relocate_string(base, blob_size, names[j].name);
+            if (names[j].name == NULL) {
+                return -1;
+            }
+            HASH_ADD_KEYPTR(hh, scene->uplink_library_name_list,
+                            names[j].name, strlen(names[j].name), &names[j]);
+        }
+
+        names = (aurisys_library_name_t *)relocate(
+                    base, blob_size, scene->downlink_library_name_list,
+                    scenes[i].num_downlink_library_name * sizeof(aurisys_library_name_t));
+        scene->downlink_library_name_list = NULL;
+        for (j = 0; names != NULL && j < scenes[i].num_downlink_library_name; j++) {
+            names[j].name = relocate_string(base, blob_size, names[j].name);
+            if (names[j].name == NULL) {
+                return -1;
+            }
+            HASH_ADD_KEYPTR(hh, scene->downlink_library_name_list,
+                            names[j].name, strlen(names[j].name), &names[j]);
+        }
+    }
+
+
+    /* <hal_librarys> */
+    for (i = 0; i < header->num_library_config; i++) {
+        lib = &libs[i].library_config;
+
+        lib->name = relocate_string(base, blob_size, lib->name);
+        lib->lib_path = relocate_string(base, blob_size, lib->lib_path);
+        lib->lib64_path = relocate_string(base, blob_size, lib->lib64_path);
+        lib->param_path = (char *)relocate(base, blob_size, lib->param_path, MAX_PARAM_PATH_LEN);
+        lib->lib_dump_path = (char *)relocate(base, blob_size, lib->lib_dump_path, MAX_PARAM_PATH_LEN);
+        lib->adb_cmd_key = relocate_string(base, blob_size, lib->adb_cmd_key);
+        if (lib->name == NULL || lib->param_path == NULL || lib->lib_dump_path == NULL) {
+            return -1;
+        }
+        lib->param_path[MAX_PARAM_PATH_LEN - 1] = '\0';
+        lib->lib_dump_path[MAX_PARAM_PATH_LEN - 1] = '\0';
+
+        lib->dlopen_handle = NULL;
+        lib->api = NULL;
+        lib->param_cache_list = NULL;
+
+        HASH_ADD_KEYPTR(hh, aurisys_config->library_config_hh,
+                        lib->name, strlen(lib->name), lib);
+
+        comps = (aurisys_component_t *)relocate(
+                    base, blob_size, lib->component_hh,
+                    libs[i].num_component * sizeof(aurisys_component_t));
+        lib->component_hh = NULL;
+        for (j = 0; comps != NULL && j < libs[i].num_component; j++) {
+            if (relocate_lib_config(base, blob_size, &comps[j].lib_config) != 0) {
+                return -1;
+            }
+            comps[j].lib_handler_list_for_adb_cmd = NULL;
+            HASH_ADD_INT(lib->component_hh, aurisys_scenario, &comps[j]);
+        }
+    }
+
+    return 0;
+}
+
+
+static void clear_rebuilt_hash(aurisys_config_t *aurisys_config) {
+    aurisys_scene_lib_table_t *itor_scene_lib_table = NULL;
+    aurisys_scene_lib_table_t *tmp_scene_lib_table = NULL;
+
+    aurisys_library_config_t *itor_lib = NULL;
+    aurisys_library_config_t *tmp_lib = NULL;
+
+    /* all records live in the blob. only free the uthash tables */
+    HASH_ITER(hh, aurisys_config->scene_lib_table_hh, itor_scene_lib_table, tmp_scene_lib_table) {
+        HASH_CLEAR(hh, itor_scene_lib_table->uplink_library_name_list);
+        HASH_CLEAR(hh, itor_scene_lib_table->downlink_library_name_list);
+    }
+    HASH_CLEAR(hh, aurisys_config->scene_lib_table_hh);
+
+    HASH_ITER(hh, aurisys_config->library_config_hh, itor_lib, tmp_lib) {
+        HASH_CLEAR(hh, itor_lib->component_hh);
+    }
+    HASH_CLEAR(hh, aurisys_config->library_config_hh);
+}
+
+
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
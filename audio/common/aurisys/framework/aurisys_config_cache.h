@@ -0,0 +1,103 @@
+#ifndef MTK_AURISYS_CONFIG_CACHE_H
+#define MTK_AURISYS_CONFIG_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <arsi_type.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * =============================================================================
+ *                     ref struct
+ * =============================================================================
+ */
+
+struct aurisys_config_t;
+struct aurisys_param_cache_t;
+
+
+/*
+ * =============================================================================
+ *                     MACRO
+ * =============================================================================
+ */
+
+#define AURISYS_CONFIG_CACHE_PATH "/data/vendor/audiohal/aurisys_config.bin"
+
+#define AURISYS_PARAM_CACHE_MAX_ENTRY (8) /* per library, LRU */
+
+
+/*
+ * =============================================================================
+ *                     public function
+ * =============================================================================
+ */
+
+/* FNV-1a 64 of the whole xml content. used as the cache key */
+uint64_t aurisys_config_cache_hash(const void *data, const uint32_t size);
+
+/*
+ * mmap the binary cache and rebuild the hash tables on top of it.
+ * return NULL when the cache is absent, stale (hash/abi miss) or corrupted,
+ * and the caller should fall back to the xml parser.
+ *
+ * NOTE: the library api & dlopen_handle are left NULL for the caller.
+ */
+struct aurisys_config_t *aurisys_config_cache_load(
+    const char *cache_path,
+    const uint64_t xml_hash,
+    const uint32_t xml_size);
+
+/* serialize a config parsed from xml. written to a tmp file & renamed */
+int aurisys_config_cache_store(
+    const char *cache_path,
+    const struct aurisys_config_t *aurisys_config,
+    const uint64_t xml_hash,
+    const uint32_t xml_size);
+
+/* munmap the blob backing aurisys_config (no-op for xml parsed config) */
+void aurisys_config_cache_unmap(struct aurisys_config_t *aurisys_config);
+
+bool aurisys_config_is_cache_backed(const struct aurisys_config_t *aurisys_config);
+
+/* force next parse_aurisys_config() to go through xml */
+void aurisys_config_cache_invalidate(const char *cache_path);
+
+
+/*
+ * param buf cache: arsi_parsing_param_file() result of a library, keyed by
+ * task config, lib config, enhancement mode and the param file stat.
+ * return 0 and fill param_buf on hit.
+ */
+int aurisys_param_cache_fetch(
+    struct aurisys_param_cache_t **param_cache_list,
+    const arsi_task_config_t *arsi_task_config,
+    const arsi_lib_config_t  *arsi_lib_config,
+    const char               *param_file_path,
+    const int32_t             enhancement_mode,
+    data_buf_t               *param_buf);
+
+void aurisys_param_cache_update(
+    struct aurisys_param_cache_t **param_cache_list,
+    const arsi_task_config_t *arsi_task_config,
+    const arsi_lib_config_t  *arsi_lib_config,
+    const char               *param_file_path,
+    const int32_t             enhancement_mode,
+    const data_buf_t         *param_buf);
+
+void aurisys_param_cache_clear(struct aurisys_param_cache_t **param_cache_list);
+
+
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif /* end of MTK_AURISYS_CONFIG_CACHE_H */
+
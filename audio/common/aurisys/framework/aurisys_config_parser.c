@@ -1,9 +1,15 @@
 #include "aurisys_config_parser.h"
 
 #include <tree.h> /* libxml */
+#include <parser.h> /* libxml */
 #include <uthash.h> /* uthash */
 #include <dlfcn.h> /* dlopen & dlsym */
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include <wrapped_audio.h>
 
 #include <audio_log.h>
@@ -21,6 +27,8 @@
 
 #include <aurisys_utility.h>
 
+#include <aurisys_config_cache.h>
+
 
 
 #ifdef __cplusplus
@@ -91,6 +99,8 @@ static void dump_scene_lib_table(aurisys_scene_lib_table_t *scene_lib_table);
 static int parse_xlink_libs(xmlNodePtr node_xlink_libs, aurisys_library_name_t **xlink_libraries);
 
 static aurisys_library_config_t *parse_library_config(xmlNodePtr node_librarys);
+static int link_library_api(aurisys_library_config_t *library_config);
+static int link_all_library_api(aurisys_library_config_t *library_config_hh);
 static void dump_library_config(aurisys_library_config_t *library_config);
 static int parse_components(xmlNodePtr node_components, aurisys_library_config_t *library_config);
 static int parse_xlink_bufs(
@@ -121,11 +131,24 @@ static char *get_prop_string_by_prop(xmlNodePtr node, const char *prop);
 static char *clone_string_by_prop(xmlNodePtr node, const char *prop);
 static char *clone_string_by_prop_with_size(xmlNodePtr node, const char *prop, uint32_t size);
 
+static void *map_xml_file(const char *path, uint32_t *size);
+
+
 
 
 #define GET_PROP(node, prop) ((char *)xmlGetProp(node, XML_CHAR_CAST(prop)))
 #define GET_INT_BY_PROP(int_type, node, prop) ((int_type)atol(get_prop_string_by_prop(node, prop)))
 
+/* strings & structs of a cache backed config live in the mmap blob */
+#define FREE_CONFIG_POINTER(aurisys_config, ptr) \
+    do { \
+        if ((aurisys_config)->cache_blob == NULL) { \
+            AUDIO_FREE_POINTER(ptr); \
+        } else { \
+            ptr = NULL; \
+        } \
+    } while (0)
+
 
 /*
  * =============================================================================
@@ -145,6 +168,10 @@ aurisys_config_t *parse_aurisys_config(void) {
 
     xmlNodePtr cur = NULL;
 
+    void *xml_buf = NULL;
+    uint32_t xml_size = 0;
+    uint64_t xml_hash = 0;
+
     if (init_flag == true) {
         AUD_LOG_E("already parsing done. return!");
         return NULL;
@@ -156,9 +183,33 @@ aurisys_config_t *parse_aurisys_config(void) {
 
 
     /* read aurisys_config_new.xml */
-    doc = xmlParseFile(AURISYS_CONFIG_PATH);
+    xml_buf = map_xml_file(AURISYS_CONFIG_PATH, &xml_size);
+    if (xml_buf == NULL) {
+        AUD_LOG_E("map_xml_file %s fail", AURISYS_CONFIG_PATH);
+        return NULL;
+    }
+    xml_hash = aurisys_config_cache_hash(xml_buf, xml_size);
+
+
+    /* fast path: the binary cache of the same xml content */
+    aurisys_config = aurisys_config_cache_load(AURISYS_CONFIG_CACHE_PATH, xml_hash, xml_size);
+    if (aurisys_config != NULL) {
+        munmap(xml_buf, xml_size);
+        if (link_all_library_api(aurisys_config->library_config_hh) != 0) {
+            AUD_LOG_E("%s() link lib fail!!", __FUNCTION__);
+            delete_aurisys_config(aurisys_config);
+            return NULL;
+        }
+        dump_scene_lib_table(aurisys_config->scene_lib_table_hh);
+        dump_library_config(aurisys_config->library_config_hh);
+        return aurisys_config;
+    }
+
+
+    doc = xmlParseMemory((const char *)xml_buf, (int)xml_size);
     if (doc == NULL) {
-        AUD_LOG_E("xmlParseFile %s fail", AURISYS_CONFIG_PATH);
+        AUD_LOG_E("xmlParseMemory %s fail", AURISYS_CONFIG_PATH);
+        munmap(xml_buf, xml_size);
         return NULL;
     }
 
@@ -218,10 +269,15 @@ aurisys_config_t *parse_aurisys_config(void) {
 PARSE_AURISYS_CONFIG_EXIT:
     xmlFreeDoc(doc);
     doc = NULL;
+    munmap(xml_buf, xml_size);
     if (retval != 0) {
         AUD_LOG_E("%s() fail!!", __FUNCTION__);
         delete_aurisys_config(aurisys_config);
         aurisys_config = NULL;
+    } else if (aurisys_config != NULL &&
+               aurisys_config->scene_lib_table_hh != NULL &&
+               aurisys_config->library_config_hh != NULL) {
+        aurisys_config_cache_store(AURISYS_CONFIG_CACHE_PATH, aurisys_config, xml_hash, xml_size);
     }
 
     return aurisys_config;
@@ -254,12 +310,12 @@ void delete_aurisys_config(aurisys_config_t *aurisys_config) {
     HASH_ITER(hh, aurisys_config->library_config_hh, itor_lib, tmp_lib) {
         HASH_DEL(aurisys_config->library_config_hh, itor_lib);
 
-        AUDIO_FREE_POINTER(itor_lib->name);
-        AUDIO_FREE_POINTER(itor_lib->lib_path);
-        AUDIO_FREE_POINTER(itor_lib->lib64_path);
-        AUDIO_FREE_POINTER(itor_lib->param_path);
-        AUDIO_FREE_POINTER(itor_lib->lib_dump_path);
-        AUDIO_FREE_POINTER(itor_lib->adb_cmd_key);
+        FREE_CONFIG_POINTER(aurisys_config, itor_lib->name);
+        FREE_CONFIG_POINTER(aurisys_config, itor_lib->lib_path);
+        FREE_CONFIG_POINTER(aurisys_config, itor_lib->lib64_path);
+        FREE_CONFIG_POINTER(aurisys_config, itor_lib->param_path);
+        FREE_CONFIG_POINTER(aurisys_config, itor_lib->lib_dump_path);
+        FREE_CONFIG_POINTER(aurisys_config, itor_lib->adb_cmd_key);
 
         if (itor_lib->dlopen_handle != NULL) {
             dlclose(itor_lib->dlopen_handle);
@@ -268,6 +324,8 @@ void delete_aurisys_config(aurisys_config_t *aurisys_config) {
 
         AUDIO_FREE_POINTER(itor_lib->api);
 
+        aurisys_param_cache_clear(&itor_lib->param_cache_list);
+
 
         /* delete component */
         HASH_ITER(hh, itor_lib->component_hh, itor_comp, tmp_comp) {
@@ -276,44 +334,44 @@ void delete_aurisys_config(aurisys_config_t *aurisys_config) {
             /* UL */
             if (itor_comp->lib_config.p_ul_buf_in != NULL) {
                 //AUDIO_FREE_POINTER(itor_comp->lib_config.p_ul_buf_in->data_buf.p_buffer);
-                AUDIO_FREE_POINTER(itor_comp->lib_config.p_ul_buf_in);
+                FREE_CONFIG_POINTER(aurisys_config, itor_comp->lib_config.p_ul_buf_in);
             }
 
             if (itor_comp->lib_config.p_ul_buf_out != NULL) {
                 //AUDIO_FREE_POINTER(itor_comp->lib_config.p_ul_buf_out->data_buf.p_buffer);
-                AUDIO_FREE_POINTER(itor_comp->lib_config.p_ul_buf_out);
+                FREE_CONFIG_POINTER(aurisys_config, itor_comp->lib_config.p_ul_buf_out);
             }
 
             if (itor_comp->lib_config.p_ul_ref_bufs != NULL) {
                 for (i = 0; i < itor_comp->lib_config.num_ul_ref_buf_array; i++) {
                     //AUDIO_FREE_POINTER(itor_comp->lib_config.p_ul_ref_bufs[i].data_buf.p_buffer);
                 }
-                AUDIO_FREE_POINTER(itor_comp->lib_config.p_ul_ref_bufs);
+                FREE_CONFIG_POINTER(aurisys_config, itor_comp->lib_config.p_ul_ref_bufs);
             }
 
 
             /* DL */
             if (itor_comp->lib_config.p_dl_buf_in != NULL) {
                 //AUDIO_FREE_POINTER(itor_comp->lib_config.p_dl_buf_in->data_buf.p_buffer);
-                AUDIO_FREE_POINTER(itor_comp->lib_config.p_dl_buf_in);
+                FREE_CONFIG_POINTER(aurisys_config, itor_comp->lib_config.p_dl_buf_in);
             }
 
             if (itor_comp->lib_config.p_dl_buf_out != NULL) {
                 //AUDIO_FREE_POINTER(itor_comp->lib_config.p_dl_buf_out->data_buf.p_buffer);
-                AUDIO_FREE_POINTER(itor_comp->lib_config.p_dl_buf_out);
+                FREE_CONFIG_POINTER(aurisys_config, itor_comp->lib_config.p_dl_buf_out);
             }
 
             if (itor_comp->lib_config.p_dl_ref_bufs != NULL) {
                 for (i = 0; i < itor_comp->lib_config.num_dl_ref_buf_array; i++) {
                     //AUDIO_FREE_POINTER(itor_comp->lib_config.p_dl_ref_bufs[i].data_buf.p_buffer);
                 }
-                AUDIO_FREE_POINTER(itor_comp->lib_config.p_dl_ref_bufs);
+                FREE_CONFIG_POINTER(aurisys_config, itor_comp->lib_config.p_dl_ref_bufs);
             }
 
-            AUDIO_FREE_POINTER(itor_comp);
+            FREE_CONFIG_POINTER(aurisys_config, itor_comp);
         }
 
-        AUDIO_FREE_POINTER(itor_lib);
+        FREE_CONFIG_POINTER(aurisys_config, itor_lib);
     }
 
 
@@ -324,20 +382,21 @@ void delete_aurisys_config(aurisys_config_t *aurisys_config) {
         /* delete uplink_library_name */
         HASH_ITER(hh, itor_scene_lib_table->uplink_library_name_list, itor_library_name, tmp_library_name) {
             HASH_DEL(itor_scene_lib_table->uplink_library_name_list, itor_library_name);
-            AUDIO_FREE_POINTER(itor_library_name->name);
-            AUDIO_FREE_POINTER(itor_library_name);
+            FREE_CONFIG_POINTER(aurisys_config, itor_library_name->name);
+            FREE_CONFIG_POINTER(aurisys_config, itor_library_name);
         }
 
         /* delete downlink_library_name */
         HASH_ITER(hh, itor_scene_lib_table->downlink_library_name_list, itor_library_name, tmp_library_name) {
             HASH_DEL(itor_scene_lib_table->downlink_library_name_list, itor_library_name);
-            AUDIO_FREE_POINTER(itor_library_name->name);
-            AUDIO_FREE_POINTER(itor_library_name);
+            FREE_CONFIG_POINTER(aurisys_config, itor_library_name->name);
+            FREE_CONFIG_POINTER(aurisys_config, itor_library_name);
         }
 
-        AUDIO_FREE_POINTER(itor_scene_lib_table);
+        FREE_CONFIG_POINTER(aurisys_config, itor_scene_lib_table);
     }
 
+    aurisys_config_cache_unmap(aurisys_config);
     AUDIO_FREE_POINTER(aurisys_config);
 }
 
@@ -472,14 +531,9 @@ static aurisys_library_config_t *parse_library_config(xmlNodePtr node_librarys)
     xmlNodePtr node_library;
     xmlNodePtr node_components;
 
-    char *dlopen_lib_path = NULL;
-
-
     aurisys_library_config_t *library_config = NULL;
     aurisys_library_config_t *new_library_config = NULL;
 
-    dynamic_link_arsi_assign_lib_fp_t dynamic_link_arsi_assign_lib_fp = NULL;
-
 
     if (node_librarys == NULL) {
         AUD_LOG_E("%s node_librarys is NULL", __FUNCTION__);
@@ -512,33 +566,11 @@ static aurisys_library_config_t *parse_library_config(xmlNodePtr node_librarys)
         new_library_config->component_hh = NULL;
 
         /* dlopen */
-#if defined(__LP64__)
-        dlopen_lib_path = new_library_config->lib64_path;
-#else
-        dlopen_lib_path = new_library_config->lib_path;
-#endif
-        new_library_config->dlopen_handle = dlopen(dlopen_lib_path, RTLD_NOW);
-        if (new_library_config->dlopen_handle == NULL) {
-            AUD_LOG_E("dlopen(%s) fail!!", dlopen_lib_path);
-            AUD_ASSERT(new_library_config->dlopen_handle != NULL);
+        if (link_library_api(new_library_config) != 0) {
             AUDIO_FREE_POINTER(new_library_config);
             return NULL;
         }
 
-        dynamic_link_arsi_assign_lib_fp = (dynamic_link_arsi_assign_lib_fp_t)dlsym(
-                                              new_library_config->dlopen_handle,
-                                              "dynamic_link_arsi_assign_lib_fp");
-        if (dynamic_link_arsi_assign_lib_fp == NULL) {
-            AUD_LOG_E("dlsym(%s) for %s fail!!", dlopen_lib_path, "dynamic_link_arsi_assign_lib_fp");
-            AUD_ASSERT(dynamic_link_arsi_assign_lib_fp != NULL);
-            AUDIO_FREE_POINTER(new_library_config);
-            return NULL;
-        }
-
-        AUDIO_ALLOC_STRUCT(AurisysLibInterface, new_library_config->api);
-        dynamic_link_arsi_assign_lib_fp(new_library_config->api);
-        AUD_ASSERT(new_library_config->api->arsi_create_handler != NULL); /* TODO: check all api */
-
 
         /* parsing component for the library */
         node_components = get_neighbor_node_by_name(node_library->children, "components");
@@ -559,6 +591,56 @@ static aurisys_library_config_t *parse_library_config(xmlNodePtr node_librarys)
 }
 
 
+static int link_library_api(aurisys_library_config_t *library_config) {
+    char *dlopen_lib_path = NULL;
+
+    dynamic_link_arsi_assign_lib_fp_t dynamic_link_arsi_assign_lib_fp = NULL;
+
+#if defined(__LP64__)
+    dlopen_lib_path = library_config->lib64_path;
+#else
+    dlopen_lib_path = library_config->lib_path;
+#endif
+    library_config->dlopen_handle = dlopen(dlopen_lib_path, RTLD_NOW);
+    if (library_config->dlopen_handle == NULL) {
+        AUD_LOG_E("dlopen(%s) fail!!", dlopen_lib_path);
+        AUD_ASSERT(library_config->dlopen_handle != NULL);
+        return -1;
+    }
+
+    dynamic_link_arsi_assign_lib_fp = (dynamic_link_arsi_assign_lib_fp_t)dlsym(
+                                          library_config->dlopen_handle,
+                                          "dynamic_link_arsi_assign_lib_fp");
+    if (dynamic_link_arsi_assign_lib_fp == NULL) {
+        AUD_LOG_E("dlsym(%s) for %s fail!!", dlopen_lib_path, "dynamic_link_arsi_assign_lib_fp");
+        AUD_ASSERT(dynamic_link_arsi_assign_lib_fp != NULL);
+        dlclose(library_config->dlopen_handle);
+        library_config->dlopen_handle = NULL;
+        return -1;
+    }
+
+    AUDIO_ALLOC_STRUCT(AurisysLibInterface, library_config->api);
+    dynamic_link_arsi_assign_lib_fp(library_config->api);
+    AUD_ASSERT(library_config->api->arsi_create_handler != NULL); /* TODO: check all api */
+
+    return 0;
+}
+
+
+static int link_all_library_api(aurisys_library_config_t *library_config_hh) {
+    aurisys_library_config_t *itor_lib = NULL;
+    aurisys_library_config_t *tmp_lib = NULL;
+
+    HASH_ITER(hh, library_config_hh, itor_lib, tmp_lib) {
+        if (link_library_api(itor_lib) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
 static void dump_library_config(aurisys_library_config_t *library_config) {
     aurisys_library_config_t *itor_lib = NULL;
     aurisys_library_config_t *tmp_lib = NULL;
@@ -1019,6 +1101,35 @@ static xmlNodePtr get_neighbor_node_by_name(xmlNodePtr node, const char *name) {
 }
 
 
+static void *map_xml_file(const char *path, uint32_t *size) {
+    struct stat st;
+    void *xml_buf = NULL;
+    int fd = -1;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        AUD_LOG_E("%s(), open %s fail", __FUNCTION__, path);
+        return NULL;
+    }
+
+    if (fstat(fd, &st) != 0 || st.st_size <= 0 || st.st_size > INT32_MAX) {
+        AUD_LOG_E("%s(), fstat %s fail", __FUNCTION__, path);
+        close(fd);
+        return NULL;
+    }
+
+    xml_buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (xml_buf == MAP_FAILED) {
+        AUD_LOG_E("%s(), mmap %s fail", __FUNCTION__, path);
+        return NULL;
+    }
+
+    *size = (uint32_t)st.st_size;
+    return xml_buf;
+}
+
+
 static char *get_prop_string_by_prop(xmlNodePtr node, const char *prop) {
     char *prop_string = NULL;
 
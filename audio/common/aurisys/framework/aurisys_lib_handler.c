@@ -23,6 +23,7 @@
 
 #include <arsi_type.h>
 #include <aurisys_config.h>
+#include <aurisys_config_cache.h>
 
 #include <audio_pool_buf_handler.h>
 
@@ -226,6 +227,8 @@ static void clone_lib_config(
     const aurisys_component_t *the_component,
     const struct aurisys_user_prefer_configs_t *p_prefer_configs);
 static void release_lib_config(arsi_lib_config_t *lib_config);
+static uint32_t get_num_lib_config_bufs(const arsi_lib_config_t *lib_config);
+static audio_buf_t *get_lib_config_buf_block(const arsi_lib_config_t *lib_config);
 
 static void init_pool_buf(aurisys_lib_handler_t *lib_handler);
 static void deinit_pool_buf(aurisys_lib_handler_t *lib_handler);
@@ -254,6 +257,11 @@ static status_t aurisys_parsing_param_file(
     data_buf_t               *param_buf,
     const debug_log_fp_t      debug_log_fp);
 
+static status_t aurisys_load_param_buf(
+    aurisys_lib_handler_t    *lib_handler,
+    const arsi_task_config_t *arsi_task_config,
+    const bool                force_parsing);
+
 
 /*
  * =============================================================================
@@ -393,15 +401,7 @@ void aurisys_arsi_create_handler(
     working_buf = &lib_handler->working_buf;
     param_buf = &lib_handler->param_buf;
 
-    aurisys_parsing_param_file(
-        arsi_api,
-        arsi_task_config,
-        arsi_lib_config,
-        gPhoneProductName,
-        lib_handler->param_path,
-        *lib_handler->enhancement_mode,
-        param_buf,
-        lib_handler->debug_log_fp);
+    aurisys_load_param_buf(lib_handler, arsi_task_config, false);
 
 
     retval = arsi_api->arsi_query_working_buf_size(arsi_task_config, arsi_lib_config, &working_buf->memory_size, lib_handler->debug_log_fp);
@@ -1131,15 +1131,7 @@ status_t aurisys_arsi_apply_param(aurisys_lib_handler_t *lib_handler) {
     /* TODO: add try lock here */
 
     AUD_ASSERT(lib_handler->arsi_handler != NULL);
-    retval = aurisys_parsing_param_file(
-                 lib_handler->api,
-                 lib_handler->task_config,
-                 &lib_handler->lib_config,
-                 gPhoneProductName,
-                 lib_handler->param_path,
-                 *lib_handler->enhancement_mode,
-                 &lib_handler->param_buf,
-                 lib_handler->debug_log_fp);
+    retval = aurisys_load_param_buf(lib_handler, lib_handler->task_config, true);
     if (retval != NO_ERROR) {
         AUD_LOG_E("%s(-) %p, aurisys_parsing_param_file fail", __FUNCTION__, lib_handler);
         return retval;
@@ -1391,6 +1383,8 @@ static void clone_lib_config(
     arsi_lib_config_t *src,
     const aurisys_component_t *the_component,
     const struct aurisys_user_prefer_configs_t *p_prefer_configs) {
+    audio_buf_t *buf_block = NULL;
+    uint32_t num_bufs = 0;
     int i = 0;
 
     des->sample_rate = audio_sample_rate_get_match_rate(
@@ -1408,9 +1402,15 @@ static void clone_lib_config(
     des->num_dl_ref_buf_array = src->num_dl_ref_buf_array;
 
 
+    /* all audio_buf_t of the lib_config share one block (freed by release_lib_config) */
+    num_bufs = get_num_lib_config_bufs(src);
+    if (num_bufs != 0) {
+        AUDIO_ALLOC_STRUCT_ARRAY(audio_buf_t, num_bufs, buf_block);
+    }
+
     /* ul in */
     if (src->p_ul_buf_in != NULL) {
-        AUDIO_ALLOC_STRUCT(audio_buf_t, des->p_ul_buf_in);
+        des->p_ul_buf_in = buf_block++;
 
         /* data_buf_type & num_channels */
         memcpy(des->p_ul_buf_in, src->p_ul_buf_in, sizeof(audio_buf_t));
@@ -1424,7 +1424,7 @@ static void clone_lib_config(
 
     /* ul out */
     if (src->p_ul_buf_out != NULL) {
-        AUDIO_ALLOC_STRUCT(audio_buf_t, des->p_ul_buf_out);
+        des->p_ul_buf_out = buf_block++;
 
         /* data_buf_type & num_channels */
         memcpy(des->p_ul_buf_out, src->p_ul_buf_out, sizeof(audio_buf_t));
@@ -1438,7 +1438,8 @@ static void clone_lib_config(
 
     /* ul refs */
     if (src->num_ul_ref_buf_array != 0) {
-        AUDIO_ALLOC_STRUCT_ARRAY(audio_buf_t, src->num_ul_ref_buf_array, des->p_ul_ref_bufs);
+        des->p_ul_ref_bufs = buf_block;
+        buf_block += src->num_ul_ref_buf_array;
         for (i = 0; i < src->num_ul_ref_buf_array; i++) {
             /* data_buf_type & num_channels */
             memcpy(&des->p_ul_ref_bufs[i], &src->p_ul_ref_bufs[i], sizeof(audio_buf_t));
@@ -1449,7 +1450,7 @@ static void clone_lib_config(
 
     /* dl in */
     if (src->p_dl_buf_in != NULL) {
-        AUDIO_ALLOC_STRUCT(audio_buf_t, des->p_dl_buf_in);
+        des->p_dl_buf_in = buf_block++;
 
         /* data_buf_type & num_channels */
         memcpy(des->p_dl_buf_in, src->p_dl_buf_in, sizeof(audio_buf_t));
@@ -1463,7 +1464,7 @@ static void clone_lib_config(
 
     /* dl out */
     if (src->p_dl_buf_out != NULL) {
-        AUDIO_ALLOC_STRUCT(audio_buf_t, des->p_dl_buf_out);
+        des->p_dl_buf_out = buf_block++;
 
         /* data_buf_type & num_channels */
         memcpy(des->p_dl_buf_out, src->p_dl_buf_out, sizeof(audio_buf_t));
@@ -1477,7 +1478,8 @@ static void clone_lib_config(
 
     /* dl refs */
     if (src->num_dl_ref_buf_array != 0) {
-        AUDIO_ALLOC_STRUCT_ARRAY(audio_buf_t, src->num_dl_ref_buf_array, des->p_dl_ref_bufs);
+        des->p_dl_ref_bufs = buf_block;
+        buf_block += src->num_dl_ref_buf_array;
         for (i = 0; i < src->num_dl_ref_buf_array; i++) {
             /* data_buf_type & num_channels */
             memcpy(&des->p_dl_ref_bufs[i], &src->p_dl_ref_bufs[i], sizeof(audio_buf_t));
@@ -1491,6 +1493,7 @@ static void clone_lib_config(
 
 
 static void release_lib_config(arsi_lib_config_t *lib_config) {
+    audio_buf_t *buf_block = get_lib_config_buf_block(lib_config);
     int i = 0;
 
     AUD_LOG_VV("sample_rate %d", lib_config->sample_rate);
@@ -1507,14 +1510,14 @@ static void release_lib_config(arsi_lib_config_t *lib_config) {
     if (lib_config->p_ul_buf_in != NULL) {
         AUD_LOG_V("UL buf_in %p", lib_config->p_ul_buf_in->data_buf.p_buffer);
         AUDIO_FREE_POINTER(lib_config->p_ul_buf_in->data_buf.p_buffer);
-        AUDIO_FREE_POINTER(lib_config->p_ul_buf_in);
+        lib_config->p_ul_buf_in = NULL;
     }
 
     /* ul out */
     if (lib_config->p_ul_buf_out != NULL) {
         AUD_LOG_V("UL buf_out %p", lib_config->p_ul_buf_out->data_buf.p_buffer);
         AUDIO_FREE_POINTER(lib_config->p_ul_buf_out->data_buf.p_buffer);
-        AUDIO_FREE_POINTER(lib_config->p_ul_buf_out);
+        lib_config->p_ul_buf_out = NULL;
     }
 
     /* ul refs */
@@ -1523,21 +1526,21 @@ static void release_lib_config(arsi_lib_config_t *lib_config) {
             AUD_LOG_V("UL buf_ref[%d] %p", i, lib_config->p_ul_ref_bufs[i].data_buf.p_buffer);
             AUDIO_FREE_POINTER(lib_config->p_ul_ref_bufs[i].data_buf.p_buffer);
         }
-        AUDIO_FREE_POINTER(lib_config->p_ul_ref_bufs);
+        lib_config->p_ul_ref_bufs = NULL;
     }
 
     /* dl in */
     if (lib_config->p_dl_buf_in != NULL) {
         AUD_LOG_V("DL buf_in %p", lib_config->p_dl_buf_in->data_buf.p_buffer);
         AUDIO_FREE_POINTER(lib_config->p_dl_buf_in->data_buf.p_buffer);
-        AUDIO_FREE_POINTER(lib_config->p_dl_buf_in);
+        lib_config->p_dl_buf_in = NULL;
     }
 
     /* dl out */
     if (lib_config->p_dl_buf_out != NULL) {
         AUD_LOG_V("DL buf_out %p", lib_config->p_dl_buf_out->data_buf.p_buffer);
         AUDIO_FREE_POINTER(lib_config->p_dl_buf_out->data_buf.p_buffer);
-        AUDIO_FREE_POINTER(lib_config->p_dl_buf_out);
+        lib_config->p_dl_buf_out = NULL;
     }
 
     /* dl refs */
@@ -1546,8 +1549,48 @@ static void release_lib_config(arsi_lib_config_t *lib_config) {
             AUD_LOG_V("DL buf_ref[%d] %p", i, lib_config->p_dl_ref_bufs[i].data_buf.p_buffer);
             AUDIO_FREE_POINTER(lib_config->p_dl_ref_bufs[i].data_buf.p_buffer);
         }
-        AUDIO_FREE_POINTER(lib_config->p_dl_ref_bufs);
+        lib_config->p_dl_ref_bufs = NULL;
     }
+
+    AUDIO_FREE_POINTER(buf_block);
+}
+
+
+static uint32_t get_num_lib_config_bufs(const arsi_lib_config_t *lib_config) {
+    uint32_t num_bufs = 0;
+
+    num_bufs += (lib_config->p_ul_buf_in != NULL) ? 1 : 0;
+    num_bufs += (lib_config->p_ul_buf_out != NULL) ? 1 : 0;
+    num_bufs += lib_config->num_ul_ref_buf_array;
+    num_bufs += (lib_config->p_dl_buf_in != NULL) ? 1 : 0;
+    num_bufs += (lib_config->p_dl_buf_out != NULL) ? 1 : 0;
+    num_bufs += lib_config->num_dl_ref_buf_array;
+
+    return num_bufs;
+}
+
+
+static audio_buf_t *get_lib_config_buf_block(const arsi_lib_config_t *lib_config) {
+    /* same order as clone_lib_config() carves the block */
+    if (lib_config->p_ul_buf_in != NULL) {
+        return lib_config->p_ul_buf_in;
+    }
+    if (lib_config->p_ul_buf_out != NULL) {
+        return lib_config->p_ul_buf_out;
+    }
+    if (lib_config->num_ul_ref_buf_array != 0) {
+        return lib_config->p_ul_ref_bufs;
+    }
+    if (lib_config->p_dl_buf_in != NULL) {
+        return lib_config->p_dl_buf_in;
+    }
+    if (lib_config->p_dl_buf_out != NULL) {
+        return lib_config->p_dl_buf_out;
+    }
+    if (lib_config->num_dl_ref_buf_array != 0) {
+        return lib_config->p_dl_ref_bufs;
+    }
+    return NULL;
 }
 
 
@@ -1707,6 +1750,7 @@ static void aurisys_create_lib_handler_list_xlink(
         new_lib_handler->api = the_library_config->api;
         new_lib_handler->param_path = the_library_config->param_path;
         new_lib_handler->lib_dump_path = the_library_config->lib_dump_path;
+        new_lib_handler->param_cache_list = &the_library_config->param_cache_list;
 
         new_lib_handler->param_buf.memory_size = MAX_LIB_PARAM_SIZE;
         new_lib_handler->param_buf.data_size = 0;
@@ -1959,6 +2003,52 @@ static status_t aurisys_parsing_param_file(
 }
 
 
+static status_t aurisys_load_param_buf(
+    aurisys_lib_handler_t    *lib_handler,
+    const arsi_task_config_t *arsi_task_config,
+    const bool                force_parsing) {
+    status_t retval = NO_ERROR;
+
+    bool use_cache = (lib_handler->param_cache_list != NULL &&
+                      strlen(lib_handler->param_path) != 0);
+
+    /* scenario switch reuses the param of the same config w/o reading file */
+    if (use_cache == true && force_parsing == false) {
+        if (aurisys_param_cache_fetch(
+                lib_handler->param_cache_list,
+                arsi_task_config,
+                &lib_handler->lib_config,
+                lib_handler->param_path,
+                *lib_handler->enhancement_mode,
+                &lib_handler->param_buf) == 0) {
+            return NO_ERROR;
+        }
+    }
+
+    retval = aurisys_parsing_param_file(
+                 lib_handler->api,
+                 arsi_task_config,
+                 &lib_handler->lib_config,
+                 gPhoneProductName,
+                 lib_handler->param_path,
+                 *lib_handler->enhancement_mode,
+                 &lib_handler->param_buf,
+                 lib_handler->debug_log_fp);
+
+    if (use_cache == true && retval == NO_ERROR) {
+        aurisys_param_cache_update(
+            lib_handler->param_cache_list,
+            arsi_task_config,
+            &lib_handler->lib_config,
+            lib_handler->param_path,
+            *lib_handler->enhancement_mode,
+            &lib_handler->param_buf);
+    }
+
+    return retval;
+}
+
+
 /*
  * =============================================================================
  *                     utilities implementation
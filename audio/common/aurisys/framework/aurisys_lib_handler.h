@@ -32,6 +32,7 @@ struct aurisys_config_t;
 struct aurisys_adb_command_t;
 struct PcmDump_t;
 struct aurisys_user_prefer_configs_t;
+struct aurisys_param_cache_t;
 
 
 /*
@@ -66,6 +67,7 @@ typedef struct aurisys_lib_handler_t {
     struct AurisysLibInterface *api;        /* only pointer to library_config's api */
     char *param_path;                       /* only pointer to library_config's param path */
     char *lib_dump_path;                    /* only pointer to library_config's lib dump path */
+    struct aurisys_param_cache_t **param_cache_list; /* only pointer to library_config's param cache */
 
     data_buf_t param_buf;
 
@@ -0,0 +1,53 @@
+LOCAL_PATH := $(call my-dir)
+
+ifeq ($(strip $(MTK_AURISYS_FRAMEWORK_SUPPORT)),yes)
+
+#
+# aurisys config / param cache benchmark
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    aurisys_config_bench.c \
+    ../utility/aurisys_utility.c \
+    ../utility/aurisys_adb_command.c \
+    ../utility/audio_pool_buf_handler.c \
+    ../utility/AudioAurisysPcmDump.c \
+    ../framework/aurisys_config_parser.c \
+    ../framework/aurisys_config_cache.c \
+    ../framework/aurisys_controller.c \
+    ../framework/aurisys_lib_manager.c \
+    ../framework/aurisys_lib_handler.c \
+    ../../utility/audio_lock.c \
+    ../../utility/audio_ringbuf.c \
+    ../../utility/audio_sample_rate.c \
+    ../../utility/audio_time.c
+
+LOCAL_C_INCLUDES := \
+    $(TOPDIR)vendor/mediatek/proprietary/external/aurisys/interface \
+    $(TOPDIR)external/libxml2/include \
+    $(TOPDIR)external/libxml2/include/libxml \
+    $(LOCAL_PATH)/../../utility \
+    $(LOCAL_PATH)/../../utility/uthash \
+    $(LOCAL_PATH)/../utility \
+    $(LOCAL_PATH)/../framework
+
+LOCAL_CFLAGS += -DMTK_AURISYS_FRAMEWORK_SUPPORT
+
+LOCAL_SHARED_LIBRARIES := \
+    libxml2 \
+    liblog \
+    libcutils \
+    libutils \
+    libdl
+
+LOCAL_MODULE := aurisys_config_bench
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_EXECUTABLE)
+
+endif
@@ -0,0 +1,158 @@
+/*
+ * aurisys_config_bench: measure the aurisys config binary cache & param cache
+ *
+ *  - cold parse : xml parse on every iteration (cache invalidated)
+ *  - warm parse : mmap the binary cache
+ *  - scenario switch : create/destroy lib managers & arsi handlers for every
+ *                      scenario. 1st pass parses param files, later passes
+ *                      hit the param cache
+ *
+ * usage: aurisys_config_bench [loop]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <audio_time.h>
+
+#include <aurisys_scenario.h>
+
+#include <arsi_type.h>
+#include <aurisys_config.h>
+#include <aurisys_utility.h>
+
+#include <aurisys_config_parser.h>
+#include <aurisys_config_cache.h>
+#include <aurisys_controller.h>
+#include <aurisys_lib_manager.h>
+
+
+#define DEFAULT_LOOP (20)
+
+
+static uint64_t bench_parse(const uint32_t loop, const bool cold) {
+    struct aurisys_config_t *aurisys_config = NULL;
+    struct timespec ts_start;
+    struct timespec ts_stop;
+    uint64_t total_ns = 0;
+    uint32_t i = 0;
+
+    for (i = 0; i < loop; i++) {
+        if (cold) {
+            aurisys_config_cache_invalidate(AURISYS_CONFIG_CACHE_PATH);
+        }
+
+        audio_get_timespec_monotonic(&ts_start);
+        aurisys_config = parse_aurisys_config();
+        audio_get_timespec_monotonic(&ts_stop);
+        if (aurisys_config == NULL) {
+            printf("parse_aurisys_config fail!!\n");
+            return 0;
+        }
+        if (!cold && !aurisys_config_is_cache_backed(aurisys_config)) {
+            printf("warning: iteration %u not cache backed\n", i);
+        }
+        delete_aurisys_config(aurisys_config);
+
+        total_ns += get_time_diff_ns(&ts_start, &ts_stop);
+    }
+
+    return total_ns / loop;
+}
+
+
+static void init_task_config(struct aurisys_lib_manager_t *manager) {
+    arsi_task_config_t *arsi_task_config = get_arsi_task_config(manager);
+
+    arsi_task_config->input_device_info.devices = 0x80000004; /* AUDIO_DEVICE_IN_BUILTIN_MIC */
+    arsi_task_config->input_device_info.audio_format = 0x1; /* AUDIO_FORMAT_PCM_16_BIT */
+    arsi_task_config->input_device_info.sample_rate = 48000;
+    arsi_task_config->input_device_info.num_channels = 2;
+
+    arsi_task_config->output_device_info.devices = 0x2; /* AUDIO_DEVICE_OUT_SPEAKER */
+    arsi_task_config->output_device_info.audio_format = 0x1;
+    arsi_task_config->output_device_info.sample_rate = 48000;
+    arsi_task_config->output_device_info.num_channels = 2;
+
+    arsi_task_config->task_scene = get_task_scene_of_manager(manager);
+
+    arsi_task_config->max_input_device_sample_rate  = 48000;
+    arsi_task_config->max_output_device_sample_rate = 48000;
+    arsi_task_config->max_input_device_num_channels = 2;
+    arsi_task_config->max_output_device_num_channels = 2;
+}
+
+
+static uint64_t bench_scenario_switch(void) {
+    struct aurisys_user_prefer_configs_t prefer_configs;
+    struct aurisys_lib_manager_t *manager = NULL;
+    struct timespec ts_start;
+    struct timespec ts_stop;
+    uint64_t total_ns = 0;
+    aurisys_scenario_t scenario = 0;
+
+    memset(&prefer_configs, 0, sizeof(prefer_configs));
+    prefer_configs.audio_format = 0x1; /* AUDIO_FORMAT_PCM_16_BIT */
+    prefer_configs.sample_rate = 48000;
+    prefer_configs.frame_size_ms = 0;
+    prefer_configs.num_channels_ul = 2;
+    prefer_configs.num_channels_dl = 2;
+
+    for (scenario = 0; scenario < AURISYS_SCENARIO_SIZE; scenario++) {
+        audio_get_timespec_monotonic(&ts_start);
+        manager = create_aurisys_lib_manager(scenario, &prefer_configs);
+        if (manager != NULL) {
+            init_task_config(manager);
+            aurisys_create_arsi_handlers(manager);
+        }
+        audio_get_timespec_monotonic(&ts_stop);
+
+        if (manager != NULL) {
+            aurisys_destroy_lib_handlers(manager);
+            destroy_aurisys_lib_manager(manager);
+        }
+
+        total_ns += get_time_diff_ns(&ts_start, &ts_stop);
+    }
+
+    return total_ns;
+}
+
+
+int main(int argc, char **argv) {
+    uint32_t loop = DEFAULT_LOOP;
+    uint64_t first_ns = 0;
+    uint64_t others_ns = 0;
+    uint32_t i = 0;
+
+    if (argc > 1) {
+        loop = (uint32_t)atoi(argv[1]);
+    }
+    if (loop == 0) {
+        loop = DEFAULT_LOOP;
+    }
+
+    printf("parse cold (xml):    %8llu us\n",
+           (unsigned long long)(bench_parse(loop, true) / 1000));
+    printf("parse warm (cache):  %8llu us\n",
+           (unsigned long long)(bench_parse(loop, false) / 1000));
+
+    init_aurisys_controller();
+    first_ns = bench_scenario_switch();
+    for (i = 1; i < loop; i++) {
+        others_ns += bench_scenario_switch();
+    }
+    deinit_aurisys_controller();
+
+    printf("switch all scenario, 1st pass:  %8llu us\n",
+           (unsigned long long)(first_ns / 1000));
+    if (loop > 1) {
+        printf("switch all scenario, avg later: %8llu us\n",
+               (unsigned long long)(others_ns / (loop - 1) / 1000));
+    }
+
+    return 0;
+}
+
@@ -0,0 +1,120 @@
+#ifndef ANDROID_AUDIO_PCM_DUMP_WRITER_H
+#define ANDROID_AUDIO_PCM_DUMP_WRITER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include <pthread.h>
+
+#include <atomic>
+
+#include <AudioLock.h>
+
+
+namespace android {
+
+/*
+ * =============================================================================
+ *                     MACRO
+ * =============================================================================
+ */
+
+#define MAX_PCM_DUMP_FILE_NUM (32)
+#define MAX_PCM_DUMP_PATH_LEN (256)
+
+
+/*
+ * =============================================================================
+ *                     typedef
+ * =============================================================================
+ */
+
+struct PCMDumpSlot {
+    std::atomic<FILE *> file;           /* key looked up by audio thread */
+    std::atomic<uint32_t> users;        /* audio threads inside push(), ring kept */
+    AudioLock ioLock;                   /* drain, rotate & teardown of this slot */
+
+    char *ring;
+    uint32_t ringSize;                  /* power of 2 */
+    std::atomic<uint32_t> head;         /* free running, written by audio thread */
+    std::atomic<uint32_t> tail;         /* free running, written by writer thread */
+
+    std::atomic<uint32_t> dropPeriods;  /* push when ring full */
+    std::atomic<uint32_t> dropBytes;
+    uint32_t reportedDropPeriods;
+
+    char path[MAX_PCM_DUMP_PATH_LEN];
+    uint64_t segmentBytes;
+    uint32_t segmentIndex;
+};
+
+
+/*
+ * =============================================================================
+ *                     public function
+ * =============================================================================
+ */
+
+/*
+ * Background writer of AudioDumpPCMData().
+ *
+ * Each dump file owns a bounded SPSC ring. The audio thread only copies the
+ * period into the ring (no lock, no malloc, no file io) and drops the period
+ * when the ring is full. A low priority thread batches the rings to disk and
+ * rotates the file when "pcm.dump.rotate_mb" is set.
+ *
+ * Disk io is done under the ioLock of the slot only, so registering or
+ * unregistering a file never waits for the writes of another one.
+ * unregisterFile() waits until no push() is inside the ring before it is
+ * freed.
+ *
+ * NOTE: one producer thread per FILE.
+ */
+class AudioPCMDumpWriter {
+public:
+    static AudioPCMDumpWriter *getInstance();
+
+    int             registerFile(FILE *file, const char *filepath);
+    void            unregisterFile(FILE *file); /* drain all pending data */
+
+    /* realtime safe. return false when file is not registered */
+    bool            push(FILE *file, const void *buffer, const uint32_t bytes);
+
+    uint32_t        getDropPeriods(FILE *file);
+
+
+private:
+    AudioPCMDumpWriter();
+    virtual ~AudioPCMDumpWriter();
+
+    PCMDumpSlot    *findSlot(FILE *file);
+
+    bool            drainSlot(PCMDumpSlot *slot, FILE *file);
+    void            rotateSlot(PCMDumpSlot *slot, FILE *file);
+    void            reportDrop(PCMDumpSlot *slot);
+
+    int             createWriterThread();
+    static void    *writerThread(void *arg);
+
+    PCMDumpSlot     mSlots[MAX_PCM_DUMP_FILE_NUM];
+
+    uint32_t        mRingSize;
+    uint64_t        mRotateBytes;
+
+    AudioLock       mLock;              /* slot register, never for audio thread */
+
+    bool            mThreadCreated;
+    pthread_t       hWriterThread;
+
+    std::atomic<bool> mWriterSleeping;
+    pthread_mutex_t mWakeMutex;
+    pthread_cond_t  mWakeCond;
+};
+
+
+
+} /* end of namespace android */
+
+#endif /* end of ANDROID_AUDIO_PCM_DUMP_WRITER_H */
+
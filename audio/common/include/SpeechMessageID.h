@@ -271,6 +271,11 @@ bool isApMsgBypassQueue(const struct sph_msg_t *p_sph_msg);
 bool isApNeedAck(const struct sph_msg_t *p_sph_msg);
 bool isMdAckBack(const struct sph_msg_t *p_sph_msg);
 
+/* independent msg which can be sent without waiting the ack of previous one */
+bool isApMsgPipelineAllowed(const struct sph_msg_t *p_sph_msg);
+/* only the latest pending one need to be sent */
+bool isApMsgCoalescible(const struct sph_msg_t *p_sph_msg);
+
 
 bool isApMsg(const struct sph_msg_t *p_sph_msg);
 
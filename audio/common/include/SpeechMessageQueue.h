@@ -42,6 +42,18 @@ typedef int (*error_handle_message_wrapper_fp_t)(void *arg, sph_msg_t *p_sph_msg
 class SpeechQueueElement;
 
 
+/*
+ * Messages are sent in order with a sequence number. Independent messages
+ * (volume, mute, ...) are pipelined to modem without waiting the ack of the
+ * previous one, up to a window of in flight messages, while the others (speech
+ * on/off, device change, ...) still act as a barrier. The acks are matched to
+ * the in flight messages by msg id, and the elements are retired in order.
+ *
+ * A volume-like update still pending in the queue is overwritten by a newer
+ * update of the same msg id instead of being sent twice.
+ *
+ * set "af.speech.msg_serial" to 1 for the legacy send & wait one by one.
+ */
 class SpeechMessageQueue {
 public:
     SpeechMessageQueue(
@@ -56,6 +68,7 @@ public:
     int sendSpeechMessageAckToQueue(sph_msg_t *p_sph_msg_ack);
     void notifyQueueToStopWaitingAck();
 
+    uint32_t getCoalescedCount() const { return mCoalescedCount; }
 
 
 private:
@@ -67,18 +80,21 @@ private:
 
     uint32_t        getQueueSize() const;
     uint32_t        getQueueNumElements() const;
+    uint32_t        getNextIndex(const uint32_t index) const;
 
-    int             pushElement(sph_msg_t *p_sph_msg, uint32_t *idx_msg);
+    int             pushElement(sph_msg_t *p_sph_msg, uint32_t *idx_msg, bool *coalesced);
     int             popElement();
-    int             frontElement(sph_msg_t **pp_sph_msg, uint32_t *idx_msg);
+
+    bool            coalesceElement(sph_msg_t *p_sph_msg, uint32_t *idx_msg);
 
     int             waitUntilElementProcessDone(const uint32_t idx_msg, const uint32_t ms);
     int             signalElementProcessDone(const uint32_t idx_msg);
 
-    int             waitUntilModemAckBack(sph_msg_t *p_sph_msg, uint32_t idx_msg);
+    bool            checkElementCanBeSent(const uint32_t idx_msg) const;
+    int             getTimeoutElement(uint32_t *idx_msg, uint32_t *wait_ms);
 
-
-    int             getQueueElementUntilPushed(sph_msg_t **pp_sph_msg, uint32_t *idx_msg);
+    int             sendElement(const uint32_t idx_msg);
+    int             retireElement(const uint32_t idx_msg);
 
     bool            mEnableThread; /* not speech on/off but new/delete status */
     static void    *processElementThread(void *arg);
@@ -91,14 +107,14 @@ private:
     AudioLock    mQueueLock;
     SpeechQueueElement *mQueue;
     uint32_t mQueueSize;
-    uint32_t mQueueIndexRead;
+    uint32_t mQueueIndexRead;  /* oldest element not retired yet */
+    uint32_t mQueueIndexSend;  /* next element to send to modem */
     uint32_t mQueueIndexWrite;
 
-
-    AudioLock    mWaitAckLock;
-
-    bool mWaitAckFlag;
-    sph_msg_t *mSphMsgAck;
+    uint32_t mSeqNum;
+    uint32_t mMaxInflight;     /* max number of need ack msg waiting ack */
+    bool     mCoalesceEnable;
+    uint32_t mCoalescedCount;
 
 
     send_message_wrapper_fp_t sendMessageWrapper;
@@ -201,6 +201,60 @@ bool isMdAckBack(const struct sph_msg_t *p_sph_msg) {
 }
 
 
+bool isApMsgPipelineAllowed(const struct sph_msg_t *p_sph_msg) {
+    bool retval = false;
+
+    if (p_sph_msg == NULL) {
+        ALOGW("%s(), p_sph_msg == NULL!! return", __FUNCTION__);
+        return false;
+    }
+
+    switch (p_sph_msg->msg_id) {
+    case MSG_A2M_SPH_DL_DIGIT_VOLUME:
+    case MSG_A2M_SPH_UL_DIGIT_VOLUME:
+    case MSG_A2M_SPH_DL_ENH_REF_DIGIT_VOLUME:
+    case MSG_A2M_MUTE_SPH_UL:
+    case MSG_A2M_MUTE_SPH_DL:
+    case MSG_A2M_MUTE_SPH_UL_SOURCE:
+    case MSG_A2M_MUTE_SPH_DL_CODEC:
+    case MSG_A2M_BGSND_CONFIG:
+        retval = true;
+        break;
+    default:
+        retval = false;
+    }
+
+    return retval;
+}
+
+
+bool isApMsgCoalescible(const struct sph_msg_t *p_sph_msg) {
+    bool retval = false;
+
+    if (p_sph_msg == NULL) {
+        ALOGW("%s(), p_sph_msg == NULL!! return", __FUNCTION__);
+        return false;
+    }
+
+    if (p_sph_msg->buffer_type != SPH_MSG_BUFFER_TYPE_MAILBOX) {
+        return false;
+    }
+
+    switch (p_sph_msg->msg_id) {
+    case MSG_A2M_SPH_DL_DIGIT_VOLUME:
+    case MSG_A2M_SPH_UL_DIGIT_VOLUME:
+    case MSG_A2M_SPH_DL_ENH_REF_DIGIT_VOLUME:
+    case MSG_A2M_BGSND_CONFIG:
+        retval = true;
+        break;
+    default:
+        retval = false;
+    }
+
+    return retval;
+}
+
+
 bool isApMsg(const struct sph_msg_t *p_sph_msg) {
     if (p_sph_msg == NULL) {
         ALOGW("%s(), p_sph_msg == NULL!! return", __FUNCTION__);
@@ -19,6 +19,8 @@
 
 #include <SpeechMessageID.h>
 
+#include <audio_time.h>
+
 
 
 #ifdef LOG_TAG
@@ -45,7 +47,12 @@ namespace android {
 
 #define MAX_SPEECH_QUEUE_WAIT_ACK_TIMEOUT_MS (60000)
 
+#define MAX_SPH_MSG_INFLIGHT (4) /* need ack msg sent to modem but not ack back yet */
+
+#define INVALID_QUEUE_INDEX (0xFFFFFFFF)
+
 static const char kPropertyKeyLowRam[PROPERTY_KEY_MAX] = "ro.config.low_ram";
+static const char kPropertyKeyMsgSerial[PROPERTY_KEY_MAX] = "af.speech.msg_serial";
 
 
 /*
@@ -54,23 +61,44 @@ static const char kPropertyKeyLowRam[PROPERTY_KEY_MAX] = "ro.config.low_ram";
  * =============================================================================
  */
 
+typedef uint8_t sph_queue_element_state_t;
+
+enum { /* sph_queue_element_state_t */
+    SPH_QUEUE_ELEMENT_STATE_PENDING,    /* in queue, not sent yet */
+    SPH_QUEUE_ELEMENT_STATE_SENT,       /* sent to modem, wait ack if need */
+    SPH_QUEUE_ELEMENT_STATE_DONE        /* ready to retire */
+};
+
+
 class SpeechQueueElement {
 public:
     SpeechQueueElement() {
         p_sph_msg_client = NULL;
         memset(&sph_msg, 0, sizeof(sph_msg_t));
+        memset(&sph_msg_ack, 0, sizeof(sph_msg_t));
         wait_in_thread = false;
         signal_arrival = false;
         send_msg_to_modem_retval = 0;
+        seq_num = 0;
+        state = SPH_QUEUE_ELEMENT_STATE_DONE;
+        need_ack = false;
+        memset(&ts_send, 0, sizeof(ts_send));
     }
     virtual ~SpeechQueueElement() { }
 
     sph_msg_t *p_sph_msg_client;    /* the address of client's message */
     sph_msg_t sph_msg;              /* the copy msg in queue */
+    sph_msg_t sph_msg_ack;          /* the ack from modem */
     AudioLock    mElementLock;      /* wait/signal */
     bool wait_in_thread;
     bool signal_arrival;
     int send_msg_to_modem_retval;
+
+    /* protected by mQueueLock */
+    uint32_t seq_num;
+    sph_queue_element_state_t state;
+    bool need_ack;
+    struct timespec ts_send;
 };
 
 
@@ -97,11 +125,20 @@ SpeechMessageQueue::SpeechMessageQueue(
     }
     mQueue = new SpeechQueueElement[mQueueSize];
     mQueueIndexRead = 0;
+    mQueueIndexSend = 0;
     mQueueIndexWrite = 0;
 
-    mWaitAckFlag = false;
-
-    AUDIO_ALLOC_STRUCT(sph_msg_t, mSphMsgAck);
+    mSeqNum = 0;
+    if (get_uint32_from_property(kPropertyKeyMsgSerial) != 0) {
+        mMaxInflight = 1;
+        mCoalesceEnable = false;
+    } else {
+        mMaxInflight = MAX_SPH_MSG_INFLIGHT;
+        mCoalesceEnable = true;
+    }
+    mCoalescedCount = 0;
+    ALOGD("%s(), mQueueSize: %u, mMaxInflight: %u, mCoalesceEnable: %d", __FUNCTION__,
+          mQueueSize, mMaxInflight, mCoalesceEnable);
 
     /* callback to send msg to modem */
     sendMessageWrapper = send_message_wrapper;
@@ -119,16 +156,18 @@ SpeechMessageQueue::SpeechMessageQueue(
 
 
 SpeechMessageQueue::~SpeechMessageQueue() {
+    AL_LOCK_MS(mQueueLock, MAX_SPEECH_QUEUE_AUTO_LOCK_TIMEOUT_MS);
     mEnableThread = false;
+    AL_SIGNAL(mQueueLock);
+    AL_UNLOCK(mQueueLock);
+
     pthread_join(hProcessElementThread, NULL);
     ALOGD("pthread_join hProcessElementThread done");
 
     /* init var */
     if (mQueue) {
-        delete mQueue;
+        delete[] mQueue;
     }
-
-    AUDIO_FREE(mSphMsgAck);
 }
 
 
@@ -138,14 +177,7 @@ bool SpeechMessageQueue::checkQueueEmpty() const {
 
 
 bool SpeechMessageQueue::checkQueueToBeFull() const {
-    uint8_t idx_w_to_be = 0;
-
-    idx_w_to_be = mQueueIndexWrite + 1;
-    if (idx_w_to_be == mQueueSize) {
-        idx_w_to_be = 0;
-    }
-
-    return (idx_w_to_be == mQueueIndexRead) ? true : false;
+    return (getNextIndex(mQueueIndexWrite) == mQueueIndexRead) ? true : false;
 }
 
 
@@ -166,18 +198,65 @@ uint32_t SpeechMessageQueue::getQueueNumElements() const {
 }
 
 
-int SpeechMessageQueue::pushElement(sph_msg_t *p_sph_msg, uint32_t *idx_msg) {
+uint32_t SpeechMessageQueue::getNextIndex(const uint32_t index) const {
+    return (index + 1 == mQueueSize) ? 0 : (index + 1);
+}
+
+
+bool SpeechMessageQueue::coalesceElement(sph_msg_t *p_sph_msg, uint32_t *idx_msg) {
+    uint32_t idx = mQueueIndexWrite;
+
+    if (isApMsgCoalescible(p_sph_msg) == false) {
+        return false;
+    }
+
+    /* look for the same update not sent yet, but never across a barrier msg */
+    while (idx != mQueueIndexSend) {
+        idx = (idx == 0) ? (mQueueSize - 1) : (idx - 1);
+
+        if (mQueue[idx].sph_msg.msg_id == p_sph_msg->msg_id &&
+            mQueue[idx].sph_msg.buffer_type == p_sph_msg->buffer_type) {
+            AL_LOCK_MS(mQueue[idx].mElementLock, MAX_SPEECH_QUEUE_AUTO_LOCK_TIMEOUT_MS);
+            mQueue[idx].sph_msg.param_16bit = p_sph_msg->param_16bit;
+            mQueue[idx].sph_msg.param_32bit = p_sph_msg->param_32bit;
+            AL_UNLOCK(mQueue[idx].mElementLock);
+
+            *idx_msg = idx;
+            mCoalescedCount++;
+            SPH_LOG_T("%s(), msg: 0x%x coalesced into seq %u, param16: 0x%x, param32: 0x%x",
+                      __FUNCTION__, p_sph_msg->msg_id, mQueue[idx].seq_num,
+                      p_sph_msg->param_16bit, p_sph_msg->param_32bit);
+            return true;
+        }
+
+        if (isApMsgPipelineAllowed(&mQueue[idx].sph_msg) == false) {
+            break;
+        }
+    }
+
+    return false;
+}
+
+
+int SpeechMessageQueue::pushElement(sph_msg_t *p_sph_msg, uint32_t *idx_msg, bool *coalesced) {
     /* error handling */
-    if (p_sph_msg == NULL || idx_msg == NULL) {
-        ALOGE("%s(), NULL!! p_sph_msg: %p, idx_msg: %p", __FUNCTION__,
-              p_sph_msg, idx_msg);
+    if (p_sph_msg == NULL || idx_msg == NULL || coalesced == NULL) {
+        ALOGE("%s(), NULL!! p_sph_msg: %p, idx_msg: %p, coalesced: %p", __FUNCTION__,
+              p_sph_msg, idx_msg, coalesced);
         return -EFAULT;
     }
 
 
-    *idx_msg = 0xFFFFFFFF;
+    *idx_msg = INVALID_QUEUE_INDEX;
+    *coalesced = false;
     AL_AUTOLOCK_MS(mQueueLock, MAX_SPEECH_QUEUE_AUTO_LOCK_TIMEOUT_MS);
 
+    /* overwrite the pending one instead of sending the same update twice */
+    if (mCoalesceEnable == true && coalesceElement(p_sph_msg, idx_msg) == true) {
+        *coalesced = true;
+        return 0;
+    }
+
     /* check mQueue not full */
     if (checkQueueToBeFull() == true) {
         ALOGW("%s(), Queue FULL!! mQueueIndexRead: %u, mQueueIndexWrite: %u", __FUNCTION__, mQueueIndexRead, mQueueIndexWrite);
@@ -189,22 +268,24 @@ int SpeechMessageQueue::pushElement(sph_msg_t *p_sph_msg, uint32_t *idx_msg) {
     AL_LOCK_MS(mQueue[mQueueIndexWrite].mElementLock, MAX_SPEECH_QUEUE_AUTO_LOCK_TIMEOUT_MS);
     mQueue[mQueueIndexWrite].p_sph_msg_client = p_sph_msg;
     memcpy(&mQueue[mQueueIndexWrite].sph_msg, p_sph_msg, sizeof(sph_msg_t));
+    memset(&mQueue[mQueueIndexWrite].sph_msg_ack, 0, sizeof(sph_msg_t));
     mQueue[mQueueIndexWrite].wait_in_thread = true;
     mQueue[mQueueIndexWrite].signal_arrival = false;
     mQueue[mQueueIndexWrite].send_msg_to_modem_retval = 0;
     AL_UNLOCK(mQueue[mQueueIndexWrite].mElementLock);
 
+    mQueue[mQueueIndexWrite].seq_num = mSeqNum++;
+    mQueue[mQueueIndexWrite].state = SPH_QUEUE_ELEMENT_STATE_PENDING;
+    mQueue[mQueueIndexWrite].need_ack = isApNeedAck(p_sph_msg);
+
     *idx_msg = mQueueIndexWrite;
-    mQueueIndexWrite++;
-    if (mQueueIndexWrite == mQueueSize) {
-        mQueueIndexWrite = 0;
-    }
+    mQueueIndexWrite = getNextIndex(mQueueIndexWrite);
     AL_SIGNAL(mQueueLock);
 
-    SPH_LOG_T("%s(), push msg: 0x%x, read_idx: %u, write_idx: %u, queue(%u/%u), idx_msg: %u",
+    SPH_LOG_T("%s(), push msg: 0x%x, seq: %u, read_idx: %u, send_idx: %u, write_idx: %u, queue(%u/%u), idx_msg: %u",
               __FUNCTION__,
-              mQueue[*idx_msg].sph_msg.msg_id,
-              mQueueIndexRead, mQueueIndexWrite,
+              mQueue[*idx_msg].sph_msg.msg_id, mQueue[*idx_msg].seq_num,
+              mQueueIndexRead, mQueueIndexSend, mQueueIndexWrite,
               getQueueNumElements(), getQueueSize(), *idx_msg);
     return 0;
 }
@@ -212,61 +293,32 @@ int SpeechMessageQueue::pushElement(sph_msg_t *p_sph_msg, uint32_t *idx_msg) {
 
 int SpeechMessageQueue::popElement() {
     uint16_t msg_id = 0;
+    uint32_t seq_num = 0;
 
     AL_AUTOLOCK_MS(mQueueLock, MAX_SPEECH_QUEUE_AUTO_LOCK_TIMEOUT_MS);
 
     /* check mQueue not empty */
-    if (checkQueueEmpty() == true) {
-        ALOGW("%s(), Queue EMPTY!! mQueueIndexRead: %u, mQueueIndexWrite: %u", __FUNCTION__, mQueueIndexRead, mQueueIndexWrite);
+    if (checkQueueEmpty() == true || mQueueIndexRead == mQueueIndexSend) {
+        ALOGW("%s(), Queue EMPTY!! mQueueIndexRead: %u, mQueueIndexSend: %u, mQueueIndexWrite: %u",
+              __FUNCTION__, mQueueIndexRead, mQueueIndexSend, mQueueIndexWrite);
         return -ENOMEM;
     }
 
     /* get msg_id for debug log */
     msg_id = mQueue[mQueueIndexRead].sph_msg.msg_id;
+    seq_num = mQueue[mQueueIndexRead].seq_num;
 
     /* pop */
-    mQueueIndexRead++;
-    if (mQueueIndexRead == mQueueSize) {
-        mQueueIndexRead = 0;
-    }
+    mQueueIndexRead = getNextIndex(mQueueIndexRead);
 
-    SPH_LOG_T("%s(), pop msg:  0x%x, read_idx: %u, write_idx: %u, queue(%u/%u)",
+    SPH_LOG_T("%s(), pop msg:  0x%x, seq: %u, read_idx: %u, send_idx: %u, write_idx: %u, queue(%u/%u)",
               __FUNCTION__,
-              msg_id, mQueueIndexRead, mQueueIndexWrite,
+              msg_id, seq_num, mQueueIndexRead, mQueueIndexSend, mQueueIndexWrite,
               getQueueNumElements(), getQueueSize());
     return 0;
 }
 
 
-int SpeechMessageQueue::frontElement(sph_msg_t **pp_sph_msg, uint32_t *idx_msg) {
-    ASSERT(AL_TRYLOCK(mQueueLock) != 0);
-
-    /* error handling */
-    if (pp_sph_msg == NULL) {
-        ALOGE("%s(), pp_sph_msg = NULL, return", __FUNCTION__);
-        return -EFAULT;
-    }
-    *pp_sph_msg = NULL;
-
-    if (idx_msg == NULL) {
-        ALOGE("%s(), idx_msg = NULL, return", __FUNCTION__);
-        return -EFAULT;
-    }
-    *idx_msg = 0xFFFFFFFF;
-
-    /* check mQueue empty */
-    if (checkQueueEmpty() == true) {
-        ALOGW("%s(), Queue EMPTY!! mQueueIndexRead: %u, mQueueIndexWrite: %u", __FUNCTION__, mQueueIndexRead, mQueueIndexWrite);
-        return -ENOMEM;
-    }
-
-    *pp_sph_msg = &mQueue[mQueueIndexRead].sph_msg;
-    *idx_msg = mQueueIndexRead;
-
-    return 0;
-}
-
-
 int SpeechMessageQueue::waitUntilElementProcessDone(const uint32_t idx_msg, const uint32_t ms) {
     int retval = 0;
 
@@ -318,28 +370,13 @@ int SpeechMessageQueue::signalElementProcessDone(const uint32_t idx_msg) {
 }
 
 
-int SpeechMessageQueue::getQueueElementUntilPushed(sph_msg_t **pp_sph_msg, uint32_t *idx_msg) {
-    int retval = 0;
-
-    CLEANUP_PUSH_ALOCK(mQueueLock.getAlock());
-    AL_LOCK_MS(mQueueLock, MAX_SPEECH_QUEUE_WAIT_ELEMENT_LOCK_TIMEOUT_MS);
-    if (checkQueueEmpty() == true) {
-        AL_WAIT_NO_TIMEOUT(mQueueLock);
-    }
-    retval = frontElement(pp_sph_msg, idx_msg); /* not p_sph_msg_client!!! */
-    AL_UNLOCK(mQueueLock);
-    CLEANUP_POP_ALOCK(mQueueLock.getAlock());
-
-    return retval;
-}
-
-
 int SpeechMessageQueue::sendSpeechMessageToQueue(
     sph_msg_t *p_sph_msg,
     const uint32_t block_thread_ms) {
 
-    uint32_t idx_msg = 0xFFFFFFFF;
-    uint32_t idx_msg_head = 0xFFFFFFFF;
+    uint32_t idx_msg = INVALID_QUEUE_INDEX;
+    uint32_t idx_msg_head = INVALID_QUEUE_INDEX;
+    bool coalesced = false;
     int retval = 0;
 
     /* error handling */
@@ -349,7 +386,7 @@ int SpeechMessageQueue::sendSpeechMessageToQueue(
     }
 
     /* push message to mQueue */
-    retval = pushElement(p_sph_msg, &idx_msg);
+    retval = pushElement(p_sph_msg, &idx_msg, &coalesced);
     if (retval != 0) {
         ALOGW("%s(), pushElement fail!! return", __FUNCTION__);
         PRINT_SPH_MSG(ALOGE, "pushElement fail!! drop msg", p_sph_msg);
@@ -364,6 +401,11 @@ int SpeechMessageQueue::sendSpeechMessageToQueue(
         return -EOVERFLOW;
     }
 
+    /* merged into a pending msg which nobody waits */
+    if (coalesced == true) {
+        return 0;
+    }
+
 
     /* wait until message processed */
     retval = waitUntilElementProcessDone(idx_msg, block_thread_ms);
@@ -381,6 +423,9 @@ int SpeechMessageQueue::sendSpeechMessageToQueue(
 
 
 int SpeechMessageQueue::sendSpeechMessageAckToQueue(sph_msg_t *p_sph_msg_ack) {
+    uint32_t idx = 0;
+    bool in_pair = false;
+
     /* error handling */
     if (p_sph_msg_ack == NULL) {
         ALOGE("%s(), p_sph_msg_ack = NULL, return", __FUNCTION__);
@@ -394,105 +439,184 @@ int SpeechMessageQueue::sendSpeechMessageAckToQueue(sph_msg_t *p_sph_msg_ack) {
 
     PRINT_SPH_MSG(ALOGD, "ack back", p_sph_msg_ack);
 
-    /* get msg ack & wake up queue */
-    AL_LOCK_MS(mWaitAckLock, MAX_SPEECH_QUEUE_AUTO_LOCK_TIMEOUT_MS);
-    if (mSphMsgAck->msg_id != 0) {
-        ALOGE("%s(), p_sph_msg_ack: 0x%x, mSphMsgAck msg_id: 0x%x != 0", __FUNCTION__,
-              p_sph_msg_ack->msg_id, mSphMsgAck->msg_id);
+    /* match the ack with the in flight msg & wake up queue */
+    AL_LOCK_MS(mQueueLock, MAX_SPEECH_QUEUE_AUTO_LOCK_TIMEOUT_MS);
+    for (idx = mQueueIndexRead; idx != mQueueIndexSend; idx = getNextIndex(idx)) {
+        if (mQueue[idx].state == SPH_QUEUE_ELEMENT_STATE_SENT &&
+            mQueue[idx].need_ack == true &&
+            isAckMessageInPair(&mQueue[idx].sph_msg, p_sph_msg_ack) == true) {
+            in_pair = true;
+            break;
+        }
     }
-    memcpy(mSphMsgAck, p_sph_msg_ack, sizeof(sph_msg_t));
-    AL_SIGNAL(mWaitAckLock);
-    AL_UNLOCK(mWaitAckLock);
-    return 0;
+
+    if (in_pair == true) {
+        memcpy(&mQueue[idx].sph_msg_ack, p_sph_msg_ack, sizeof(sph_msg_t));
+        mQueue[idx].send_msg_to_modem_retval = 0;
+        mQueue[idx].state = SPH_QUEUE_ELEMENT_STATE_DONE;
+        AL_SIGNAL(mQueueLock);
+    } else {
+        ALOGE("%s(), p_sph_msg_ack: 0x%x, no msg waiting for it!! drop ack", __FUNCTION__,
+              p_sph_msg_ack->msg_id);
+    }
+    AL_UNLOCK(mQueueLock);
+
+    return (in_pair == true) ? 0 : -EINVAL;
 }
 
 
 void SpeechMessageQueue::notifyQueueToStopWaitingAck() {
-    AL_LOCK_MS(mWaitAckLock, MAX_SPEECH_QUEUE_AUTO_LOCK_TIMEOUT_MS);
-    if (mWaitAckFlag == true) { /* someone is waiting */
+    uint32_t idx = 0;
+    bool wait_ack = false;
+
+    AL_LOCK_MS(mQueueLock, MAX_SPEECH_QUEUE_AUTO_LOCK_TIMEOUT_MS);
+    for (idx = mQueueIndexRead; idx != mQueueIndexSend; idx = getNextIndex(idx)) {
+        if (mQueue[idx].state == SPH_QUEUE_ELEMENT_STATE_SENT &&
+            mQueue[idx].need_ack == true) {
+            PRINT_SPH_MSG(ALOGW, "wait ack canceled!!", &mQueue[idx].sph_msg);
+            mQueue[idx].send_msg_to_modem_retval = -ECANCELED;
+            mQueue[idx].state = SPH_QUEUE_ELEMENT_STATE_DONE;
+            wait_ack = true;
+        }
+    }
+    if (wait_ack == true) { /* someone is waiting */
         ALOGW("%s(), stop waiting ack", __FUNCTION__);
-        mWaitAckFlag = false;
-        AL_SIGNAL(mWaitAckLock); /* notify to stop waiting ack */
+        AL_SIGNAL(mQueueLock); /* notify to stop waiting ack */
     }
-    AL_UNLOCK(mWaitAckLock);
+    AL_UNLOCK(mQueueLock);
 }
 
 
-int SpeechMessageQueue::waitUntilModemAckBack(sph_msg_t *p_sph_msg, uint32_t idx_msg) {
-    int retval = 0;
-    sph_msg_t *p_sph_msg_client = NULL;
+bool SpeechMessageQueue::checkElementCanBeSent(const uint32_t idx_msg) const {
+    const sph_msg_t *p_sph_msg = &mQueue[idx_msg].sph_msg;
+    uint32_t num_wait_ack = 0;
+    bool barrier_wait_ack = false;
+    bool same_id_wait_ack = false;
+    uint32_t idx = 0;
 
-    /* error handling */
-    if (p_sph_msg == NULL) {
-        ALOGE("%s(), p_sph_msg = NULL, return", __FUNCTION__);
-        return -EFAULT;
+    for (idx = mQueueIndexRead; idx != mQueueIndexSend; idx = getNextIndex(idx)) {
+        if (mQueue[idx].state != SPH_QUEUE_ELEMENT_STATE_SENT || mQueue[idx].need_ack == false) {
+            continue;
+        }
+        num_wait_ack++;
+        if (isApMsgPipelineAllowed(&mQueue[idx].sph_msg) == false) {
+            barrier_wait_ack = true;
+        }
+        if (mQueue[idx].sph_msg.msg_id == p_sph_msg->msg_id) {
+            same_id_wait_ack = true; /* ack is paired by msg id only */
+        }
     }
 
-    if (checkQueueIndexValid(idx_msg) == false) {
-        ALOGW("%s(), idx_msg %d is invalid!! return", __FUNCTION__, idx_msg);
-        return -EOVERFLOW;
+    if (num_wait_ack == 0) {
+        return true;
     }
 
+    /* legacy: send & wait ack one by one */
+    if (mMaxInflight <= 1) {
+        return false;
+    }
 
-    CLEANUP_PUSH_ALOCK(mWaitAckLock.getAlock());
-    AL_LOCK_MS(mWaitAckLock, MAX_SPEECH_QUEUE_AUTO_LOCK_TIMEOUT_MS);
+    /* a barrier msg is sent alone */
+    if (barrier_wait_ack == true || isApMsgPipelineAllowed(p_sph_msg) == false) {
+        return false;
+    }
 
-    /* should no ack before wait */
-    if (mSphMsgAck->msg_id != 0) {
-        if (isAckMessageInPair(p_sph_msg, mSphMsgAck) == false) {
-            ALOGE("%s(), p_sph_msg: 0x%x, mSphMsgAck msg_id: 0x%x != 0!! drop previous ack", __FUNCTION__,
-                  p_sph_msg->msg_id, mSphMsgAck->msg_id);
-            memset(mSphMsgAck, 0, sizeof(sph_msg_t));
-        }
+    if (same_id_wait_ack == true) {
+        return false;
     }
 
-    /* wait ack if need */
-    if (mSphMsgAck->msg_id == 0) {
-        PRINT_SPH_MSG(ALOGV, "wait(+)", p_sph_msg);
-        mWaitAckFlag = true;
-        retval = AL_WAIT_MS(mWaitAckLock, MAX_SPEECH_QUEUE_WAIT_ACK_TIMEOUT_MS);
-        PRINT_SPH_MSG(ALOGV, "wait(-)", p_sph_msg);
+    if (mQueue[idx_msg].need_ack == true) {
+        return (num_wait_ack < mMaxInflight);
+    }
+    return true;
+}
+
+
+int SpeechMessageQueue::getTimeoutElement(uint32_t *idx_msg, uint32_t *wait_ms) {
+    struct timespec ts_now;
+    uint64_t time_diff_ms = 0;
+    uint32_t min_wait_ms = 0;
+    uint32_t idx = 0;
 
-        if (mWaitAckFlag == false) { /* canceled */
-            PRINT_SPH_MSG(ALOGW, "wait ack canceled!!", p_sph_msg);
-            retval = -ECANCELED;
-            goto WAIT_ACK_DONE;
+    *idx_msg = INVALID_QUEUE_INDEX;
+    *wait_ms = 0;
+
+    audio_get_timespec_monotonic(&ts_now);
+    for (idx = mQueueIndexRead; idx != mQueueIndexSend; idx = getNextIndex(idx)) {
+        if (mQueue[idx].state != SPH_QUEUE_ELEMENT_STATE_SENT || mQueue[idx].need_ack == false) {
+            continue;
+        }
+        time_diff_ms = get_time_diff_ms(&mQueue[idx].ts_send, &ts_now);
+        if (time_diff_ms >= MAX_SPEECH_QUEUE_WAIT_ACK_TIMEOUT_MS) {
+            *idx_msg = idx;
+            return 0;
         }
+        if (min_wait_ms == 0 || MAX_SPEECH_QUEUE_WAIT_ACK_TIMEOUT_MS - time_diff_ms < min_wait_ms) {
+            min_wait_ms = MAX_SPEECH_QUEUE_WAIT_ACK_TIMEOUT_MS - time_diff_ms;
+        }
+    }
 
-        if (retval != 0) { /* timeout */
-            PRINT_SPH_MSG(ALOGE, "wait ack timeout!!", p_sph_msg);
-            retval = -ETIMEDOUT;
-            goto WAIT_ACK_DONE;
+    *wait_ms = min_wait_ms;
+    return -ENOENT;
+}
+
+
+int SpeechMessageQueue::sendElement(const uint32_t idx_msg) {
+    sph_msg_t *p_sph_msg = &mQueue[idx_msg].sph_msg;
+    int retval = 0;
+
+    /* send to modem */
+    retval = sendSpeechMessage(p_sph_msg);
+
+    AL_LOCK_MS(mQueueLock, MAX_SPEECH_QUEUE_AUTO_LOCK_TIMEOUT_MS);
+    if (retval != 0) {
+        if (mQueue[idx_msg].need_ack == true) {
+            PRINT_SPH_MSG(ALOGE, "send fail, don't wait ack", p_sph_msg);
         }
+        mQueue[idx_msg].send_msg_to_modem_retval = retval;
+        mQueue[idx_msg].state = SPH_QUEUE_ELEMENT_STATE_DONE;
+    } else if (mQueue[idx_msg].need_ack == false) {
+        mQueue[idx_msg].state = SPH_QUEUE_ELEMENT_STATE_DONE;
     }
+    /* else: wait ack, which might be already back */
+    AL_UNLOCK(mQueueLock);
+
+    return retval;
+}
+
 
-    /* should be in pair after wait */
-    if (isAckMessageInPair(p_sph_msg, mSphMsgAck) == false) {
-        ALOGE("%s(), msg_id: 0x%x, ack msg id: 0x%x not in pair!!", __FUNCTION__,
-              p_sph_msg->msg_id, mSphMsgAck->msg_id);
-        WARNING("ack not in pair");
-        retval = -EINVAL;
-        goto WAIT_ACK_DONE;
+int SpeechMessageQueue::retireElement(const uint32_t idx_msg) {
+    SpeechQueueElement *p_element = &mQueue[idx_msg];
+    sph_msg_t *p_sph_msg_client = NULL;
+    int retval = p_element->send_msg_to_modem_retval;
+
+    if (retval == 0 && p_element->need_ack == true) {
+        /* copy return mailbox value to original thread */
+        AL_LOCK_MS(p_element->mElementLock, MAX_SPEECH_QUEUE_WAIT_ELEMENT_LOCK_TIMEOUT_MS);
+        if (p_element->wait_in_thread == true) {
+            p_sph_msg_client = p_element->p_sph_msg_client;
+            if (p_sph_msg_client->buffer_type == SPH_MSG_BUFFER_TYPE_MAILBOX &&
+                p_element->sph_msg_ack.buffer_type == SPH_MSG_BUFFER_TYPE_MAILBOX) {
+                p_sph_msg_client->param_16bit = p_element->sph_msg_ack.param_16bit;
+                p_sph_msg_client->param_32bit = p_element->sph_msg_ack.param_32bit;
+            }
+        }
+        AL_UNLOCK(p_element->mElementLock);
     }
 
-    /* copy return mailbox value to original thread */
-    AL_LOCK_MS(mQueue[idx_msg].mElementLock, MAX_SPEECH_QUEUE_WAIT_ELEMENT_LOCK_TIMEOUT_MS);
-    if (mQueue[idx_msg].wait_in_thread == true) {
-        p_sph_msg_client = mQueue[idx_msg].p_sph_msg_client;
-        if (p_sph_msg_client->buffer_type == SPH_MSG_BUFFER_TYPE_MAILBOX &&
-            mSphMsgAck->buffer_type == SPH_MSG_BUFFER_TYPE_MAILBOX) {
-            p_sph_msg_client->param_16bit = mSphMsgAck->param_16bit;
-            p_sph_msg_client->param_32bit = mSphMsgAck->param_32bit;
+    /* error handing for send/wait_ack fail */
+    if (retval != 0) {
+        if (retval == -ETIMEDOUT) {
+            PRINT_SPH_MSG(ALOGE, "wait ack timeout!!", &p_element->sph_msg);
         }
+        errorHandleSpeechMessage(&p_element->sph_msg);
     }
-    AL_UNLOCK(mQueue[idx_msg].mElementLock);
 
+    /* signal */
+    signalElementProcessDone(idx_msg);
 
-WAIT_ACK_DONE:
-    mWaitAckFlag = false;
-    memset(mSphMsgAck, 0, sizeof(sph_msg_t));
-    AL_UNLOCK(mWaitAckLock);
-    CLEANUP_POP_ALOCK(mWaitAckLock.getAlock());
+    /* pop message from mQueue */
+    popElement();
 
     if (retval == -ETIMEDOUT) {
         WARNING("wait ack timeout");
@@ -507,10 +631,10 @@ void *SpeechMessageQueue::processElementThread(void *arg) {
 
     SpeechMessageQueue *pSpeechMessageQueue = NULL;
 
-    sph_msg_t *p_sph_msg = NULL;
-    uint32_t idx_msg = 0xFFFFFFFF;
-
-    int retval = 0;
+    uint32_t idx_msg = INVALID_QUEUE_INDEX;
+    uint32_t wait_ms = 0;
+    bool need_send = false;
+    bool need_retire = false;
 
 
     CONFIG_THREAD(thread_name, ANDROID_PRIORITY_AUDIO);
@@ -523,39 +647,53 @@ void *SpeechMessageQueue::processElementThread(void *arg) {
 
 
     while (pSpeechMessageQueue->mEnableThread == true) {
-        /* wait until element pushed */
-        retval = pSpeechMessageQueue->getQueueElementUntilPushed(&p_sph_msg, &idx_msg);
-        if (retval != 0 ||
-            p_sph_msg == NULL ||
-            pSpeechMessageQueue->checkQueueIndexValid(idx_msg) == false) {
-            ALOGW("%s(), getQueueElementUntilPushed fail!!", __FUNCTION__);
-            usleep(5 * 1000);
-            continue;
-        }
+        need_send = false;
+        need_retire = false;
+
+        CLEANUP_PUSH_ALOCK(pSpeechMessageQueue->mQueueLock.getAlock());
+        AL_LOCK_MS(pSpeechMessageQueue->mQueueLock, MAX_SPEECH_QUEUE_WAIT_ELEMENT_LOCK_TIMEOUT_MS);
+        while (pSpeechMessageQueue->mEnableThread == true) {
+            /* retire in order */
+            idx_msg = pSpeechMessageQueue->mQueueIndexRead;
+            if (idx_msg != pSpeechMessageQueue->mQueueIndexSend &&
+                pSpeechMessageQueue->mQueue[idx_msg].state == SPH_QUEUE_ELEMENT_STATE_DONE) {
+                need_retire = true;
+                break;
+            }
+
+            /* send next one if the in flight msgs allow */
+            idx_msg = pSpeechMessageQueue->mQueueIndexSend;
+            if (idx_msg != pSpeechMessageQueue->mQueueIndexWrite &&
+                pSpeechMessageQueue->checkElementCanBeSent(idx_msg) == true) {
+                pSpeechMessageQueue->mQueue[idx_msg].state = SPH_QUEUE_ELEMENT_STATE_SENT;
+                audio_get_timespec_monotonic(&pSpeechMessageQueue->mQueue[idx_msg].ts_send);
+                pSpeechMessageQueue->mQueueIndexSend = pSpeechMessageQueue->getNextIndex(idx_msg);
+                need_send = true;
+                break;
+            }
 
-        /* send to modem */
-        retval = pSpeechMessageQueue->sendSpeechMessage(p_sph_msg);
+            /* ack timeout */
+            if (pSpeechMessageQueue->getTimeoutElement(&idx_msg, &wait_ms) == 0) {
+                pSpeechMessageQueue->mQueue[idx_msg].send_msg_to_modem_retval = -ETIMEDOUT;
+                pSpeechMessageQueue->mQueue[idx_msg].state = SPH_QUEUE_ELEMENT_STATE_DONE;
+                continue;
+            }
 
-        /* need ack, wait */
-        if (isApNeedAck(p_sph_msg) == true) {
-            if (retval != 0) {
-                PRINT_SPH_MSG(ALOGE, "send fail, don't wait ack", p_sph_msg);
+            /* wait until element pushed / ack back / timeout */
+            if (wait_ms == 0) {
+                AL_WAIT_NO_TIMEOUT(pSpeechMessageQueue->mQueueLock);
             } else {
-                retval = pSpeechMessageQueue->waitUntilModemAckBack(p_sph_msg, idx_msg);
+                AL_WAIT_MS(pSpeechMessageQueue->mQueueLock, wait_ms);
             }
         }
+        AL_UNLOCK(pSpeechMessageQueue->mQueueLock);
+        CLEANUP_POP_ALOCK(pSpeechMessageQueue->mQueueLock.getAlock());
 
-        /* error handing for send/wait_ack fail */
-        if (retval != 0) {
-            pSpeechMessageQueue->errorHandleSpeechMessage(p_sph_msg);
+        if (need_send == true) {
+            pSpeechMessageQueue->sendElement(idx_msg);
+        } else if (need_retire == true) {
+            pSpeechMessageQueue->retireElement(idx_msg);
         }
-
-        /* signal */
-        pSpeechMessageQueue->mQueue[idx_msg].send_msg_to_modem_retval = retval;
-        pSpeechMessageQueue->signalElementProcessDone(idx_msg);
-
-        /* pop message from mQueue */
-        pSpeechMessageQueue->popElement();
     }
 
 
@@ -0,0 +1,32 @@
+LOCAL_PATH := $(call my-dir)
+
+#
+# speech message queue call setup latency test with a fake ccci endpoint
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    speech_message_queue_test.cpp \
+    ../SpeechMessageQueue.cpp \
+    ../SpeechMessageID.cpp \
+    ../SpeechUtility.cpp \
+    ../../utility/audio_lock.c \
+    ../../utility/audio_time.c
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/../../include \
+    $(LOCAL_PATH)/../../utility
+
+LOCAL_SHARED_LIBRARIES := \
+    liblog \
+    libcutils \
+    libutils
+
+LOCAL_MODULE := speech_message_queue_test
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_EXECUTABLE)
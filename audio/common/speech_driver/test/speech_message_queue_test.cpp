@@ -0,0 +1,381 @@
+/*
+ * speech_message_queue_test: call setup latency of SpeechMessageQueue, end to
+ * end, against a fake CCCI endpoint.
+ *
+ * The fake modem receives the messages after a one way CCCI latency,
+ * processes them one by one, and sends the ack back after the same latency.
+ * Several client threads (call control, volume, mute) push a typical call
+ * setup at the same time, like AudioPolicy / volume / mic mute threads do.
+ *
+ * Both the legacy send & wait one by one ("af.speech.msg_serial" = 1) and the
+ * pipelined & coalesced queue are measured.
+ *
+ * usage: speech_message_queue_test [loop]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include <deque>
+
+#include <cutils/properties.h>
+
+#include <audio_time.h>
+
+#include <SpeechType.h>
+#include <SpeechUtility.h>
+#include <SpeechMessageID.h>
+#include <SpeechMessageQueue.h>
+
+
+using namespace android;
+
+
+#define DEFAULT_LOOP            (10)
+
+#define CCCI_WRITE_US           (200)   /* ioctl/write of ccci node */
+#define CCCI_ONE_WAY_US         (1500)  /* ap -> md or md -> ap */
+#define MD_PROCESS_BYPASS_US    (300)
+
+
+static const char kPropertyKeyMsgSerial[PROPERTY_KEY_MAX] = "af.speech.msg_serial";
+
+
+/*
+ * =============================================================================
+ *                     fake ccci endpoint
+ * =============================================================================
+ */
+
+struct fake_ccci_msg_t {
+    sph_msg_t sph_msg;
+    uint64_t  deliver_ns;
+};
+
+
+class FakeCcciModem {
+public:
+    FakeCcciModem() :
+        mQueue(NULL),
+        mEnable(true),
+        mNumReceived(0),
+        mNumAck(0),
+        mLastDoneNs(0) {
+        pthread_mutex_init(&mLock, NULL);
+        pthread_cond_init(&mCond, NULL);
+        pthread_create(&hModemThread, NULL, modemThread, this);
+        pthread_create(&hAckThread, NULL, ackThread, this);
+    }
+
+    virtual ~FakeCcciModem() {
+        pthread_mutex_lock(&mLock);
+        mEnable = false;
+        pthread_cond_broadcast(&mCond);
+        pthread_mutex_unlock(&mLock);
+        pthread_join(hModemThread, NULL);
+        pthread_join(hAckThread, NULL);
+        pthread_cond_destroy(&mCond);
+        pthread_mutex_destroy(&mLock);
+    }
+
+    void setQueue(SpeechMessageQueue *queue) { mQueue = queue; }
+
+    /* => SpeechMessengerNormal::sendSpeechMessage() */
+    int send(sph_msg_t *p_sph_msg) {
+        fake_ccci_msg_t msg;
+
+        usleep(CCCI_WRITE_US);
+
+        memcpy(&msg.sph_msg, p_sph_msg, sizeof(sph_msg_t));
+        msg.deliver_ns = now_ns() + CCCI_ONE_WAY_US * 1000ULL;
+
+        pthread_mutex_lock(&mLock);
+        mInbox.push_back(msg);
+        mNumReceived++;
+        pthread_cond_broadcast(&mCond);
+        pthread_mutex_unlock(&mLock);
+        return 0;
+    }
+
+    void reset() {
+        pthread_mutex_lock(&mLock);
+        mNumReceived = 0;
+        mNumAck = 0;
+        mLastDoneNs = 0;
+        pthread_mutex_unlock(&mLock);
+    }
+
+    uint32_t getNumReceived() { return mNumReceived; }
+    uint64_t getLastDoneNs() { return mLastDoneNs; }
+
+    static uint64_t now_ns() {
+        struct timespec ts;
+        audio_get_timespec_monotonic(&ts);
+        return audio_timespec_to_ns(&ts);
+    }
+
+
+private:
+    static uint32_t getProcessTimeUs(const uint16_t msg_id) {
+        switch (msg_id) {
+        case MSG_A2M_SPH_ON:
+            return 20000;
+        case MSG_A2M_SPH_DEV_CHANGE:
+            return 8000;
+        case MSG_A2M_MUTE_SPH_UL:
+        case MSG_A2M_MUTE_SPH_DL:
+        case MSG_A2M_MUTE_SPH_UL_SOURCE:
+            return 500;
+        default:
+            return MD_PROCESS_BYPASS_US;
+        }
+    }
+
+    /* wait until the head of box is delivered. call with mLock */
+    bool waitDeliver(std::deque<fake_ccci_msg_t> &box, fake_ccci_msg_t *msg) {
+        struct timespec ts;
+        while (mEnable && (box.empty() || box.front().deliver_ns > now_ns())) {
+            if (box.empty()) {
+                pthread_cond_wait(&mCond, &mLock);
+            } else {
+                uint64_t deliver_ns = box.front().deliver_ns;
+                pthread_mutex_unlock(&mLock);
+                ts.tv_sec = deliver_ns / 1000000000ULL;
+                ts.tv_nsec = deliver_ns % 1000000000ULL;
+                clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+                pthread_mutex_lock(&mLock);
+            }
+        }
+        if (!mEnable) {
+            return false;
+        }
+        *msg = box.front();
+        box.pop_front();
+        return true;
+    }
+
+    static void *modemThread(void *arg) {
+        FakeCcciModem *modem = (FakeCcciModem *)arg;
+        fake_ccci_msg_t msg;
+
+        pthread_mutex_lock(&modem->mLock);
+        while (modem->waitDeliver(modem->mInbox, &msg)) {
+            pthread_mutex_unlock(&modem->mLock);
+            usleep(getProcessTimeUs(msg.sph_msg.msg_id)); /* modem handles msg one by one */
+            pthread_mutex_lock(&modem->mLock);
+
+            if (isApNeedAck(&msg.sph_msg)) {
+                makeFakeMdAckMsgFromApMsg(&msg.sph_msg);
+                msg.deliver_ns = now_ns() + CCCI_ONE_WAY_US * 1000ULL;
+                modem->mOutbox.push_back(msg);
+                pthread_cond_broadcast(&modem->mCond);
+            } else {
+                modem->mLastDoneNs = now_ns();
+            }
+        }
+        pthread_mutex_unlock(&modem->mLock);
+        return NULL;
+    }
+
+    static void *ackThread(void *arg) {
+        FakeCcciModem *modem = (FakeCcciModem *)arg;
+        fake_ccci_msg_t msg;
+
+        pthread_mutex_lock(&modem->mLock);
+        while (modem->waitDeliver(modem->mOutbox, &msg)) {
+            pthread_mutex_unlock(&modem->mLock);
+            /* => SpeechDriverNormal::readSpeechMessageThread() */
+            modem->mQueue->sendSpeechMessageAckToQueue(&msg.sph_msg);
+            pthread_mutex_lock(&modem->mLock);
+            modem->mNumAck++;
+            modem->mLastDoneNs = now_ns();
+        }
+        pthread_mutex_unlock(&modem->mLock);
+        return NULL;
+    }
+
+    SpeechMessageQueue *mQueue;
+
+    pthread_mutex_t mLock;
+    pthread_cond_t  mCond;
+    bool mEnable;
+
+    std::deque<fake_ccci_msg_t> mInbox;
+    std::deque<fake_ccci_msg_t> mOutbox;
+
+    uint32_t mNumReceived;
+    uint32_t mNumAck;
+    uint64_t mLastDoneNs;
+
+    pthread_t hModemThread;
+    pthread_t hAckThread;
+};
+
+
+static int sendMessageWrapper(void *arg, sph_msg_t *p_sph_msg) {
+    return ((FakeCcciModem *)arg)->send(p_sph_msg);
+}
+
+static int errorHandleMessageWrapper(void *arg, sph_msg_t *p_sph_msg) {
+    (void)arg;
+    PRINT_SPH_MSG(ALOGW, "error handle", p_sph_msg);
+    return 0;
+}
+
+
+/*
+ * =============================================================================
+ *                     call setup scenario
+ * =============================================================================
+ */
+
+struct client_step_t {
+    uint16_t msg_id;
+    uint16_t param_16bit;
+};
+
+struct client_script_t {
+    const char *name;
+    const client_step_t *steps;
+    uint32_t num_steps;
+    SpeechMessageQueue *queue;
+    pthread_barrier_t *barrier;
+};
+
+static const client_step_t kCallControl[] = {
+    { MSG_A2M_SPH_ON,         0 },
+    { MSG_A2M_SPH_DEV_CHANGE, 0 },
+};
+
+static const client_step_t kVolume[] = { /* volume ramp during setup */
+    { MSG_A2M_SPH_DL_DIGIT_VOLUME, 0x100 },
+    { MSG_A2M_SPH_UL_DIGIT_VOLUME, 0x100 },
+    { MSG_A2M_SPH_DL_DIGIT_VOLUME, 0x200 },
+    { MSG_A2M_SPH_DL_DIGIT_VOLUME, 0x300 },
+    { MSG_A2M_SPH_DL_ENH_REF_DIGIT_VOLUME, 0x300 },
+    { MSG_A2M_SPH_DL_DIGIT_VOLUME, 0x400 },
+    { MSG_A2M_SPH_UL_DIGIT_VOLUME, 0x200 },
+    { MSG_A2M_SPH_DL_DIGIT_VOLUME, 0x500 },
+    { MSG_A2M_SPH_DL_ENH_REF_DIGIT_VOLUME, 0x500 },
+    { MSG_A2M_SPH_DL_DIGIT_VOLUME, 0x600 },
+};
+
+static const client_step_t kMuteUl[] = {
+    { MSG_A2M_MUTE_SPH_UL, 1 },
+    { MSG_A2M_MUTE_SPH_UL, 0 },
+};
+
+static const client_step_t kMuteDl[] = {
+    { MSG_A2M_MUTE_SPH_DL, 1 },
+    { MSG_A2M_MUTE_SPH_DL, 0 },
+};
+
+static const client_step_t kMuteUlSource[] = {
+    { MSG_A2M_MUTE_SPH_UL_SOURCE, 0 },
+};
+
+
+static void *clientThread(void *arg) {
+    client_script_t *script = (client_script_t *)arg;
+    sph_msg_t sph_msg;
+    uint32_t i = 0;
+
+    pthread_barrier_wait(script->barrier);
+    for (i = 0; i < script->num_steps; i++) {
+        memset(&sph_msg, 0, sizeof(sph_msg_t));
+        sph_msg.buffer_type = SPH_MSG_BUFFER_TYPE_MAILBOX;
+        sph_msg.msg_id = script->steps[i].msg_id;
+        sph_msg.param_16bit = script->steps[i].param_16bit;
+        script->queue->sendSpeechMessageToQueue(&sph_msg, getBlockThreadTimeMsByID(&sph_msg));
+    }
+    return NULL;
+}
+
+
+static uint64_t runCallSetup(SpeechMessageQueue *queue, FakeCcciModem *modem,
+                             uint32_t *num_sent) {
+#define NUM_CLIENT (5)
+    client_script_t scripts[NUM_CLIENT] = {
+        { "call",     kCallControl,  sizeof(kCallControl) / sizeof(client_step_t),  queue, NULL },
+        { "volume",   kVolume,       sizeof(kVolume) / sizeof(client_step_t),       queue, NULL },
+        { "mute_ul",  kMuteUl,       sizeof(kMuteUl) / sizeof(client_step_t),       queue, NULL },
+        { "mute_dl",  kMuteDl,       sizeof(kMuteDl) / sizeof(client_step_t),       queue, NULL },
+        { "mute_src", kMuteUlSource, sizeof(kMuteUlSource) / sizeof(client_step_t), queue, NULL },
+    };
+    pthread_t clients[NUM_CLIENT];
+    pthread_barrier_t barrier;
+    uint64_t start_ns = 0;
+    uint32_t i = 0;
+
+    modem->reset();
+    pthread_barrier_init(&barrier, NULL, NUM_CLIENT + 1);
+    for (i = 0; i < NUM_CLIENT; i++) {
+        scripts[i].barrier = &barrier;
+        pthread_create(&clients[i], NULL, clientThread, &scripts[i]);
+    }
+
+    start_ns = FakeCcciModem::now_ns();
+    pthread_barrier_wait(&barrier);
+    for (i = 0; i < NUM_CLIENT; i++) {
+        pthread_join(clients[i], NULL);
+    }
+    pthread_barrier_destroy(&barrier);
+
+    usleep(200 * 1000); /* let the queue & modem drain */
+
+    *num_sent = modem->getNumReceived();
+    return modem->getLastDoneNs() - start_ns;
+}
+
+
+static void runTest(const char *name, const uint32_t serial, const uint32_t loop) {
+    FakeCcciModem *modem = new FakeCcciModem();
+    SpeechMessageQueue *queue = NULL;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+    uint64_t latency_ns = 0;
+    uint32_t num_sent = 0;
+    uint32_t i = 0;
+
+    set_uint32_to_property(kPropertyKeyMsgSerial, serial);
+    queue = new SpeechMessageQueue(sendMessageWrapper, errorHandleMessageWrapper, modem);
+    modem->setQueue(queue);
+
+    for (i = 0; i < loop; i++) {
+        latency_ns = runCallSetup(queue, modem, &num_sent);
+        total_ns += latency_ns;
+        if (latency_ns > max_ns) {
+            max_ns = latency_ns;
+        }
+    }
+
+    printf("%-12s call setup avg %6.2f ms, max %6.2f ms, msg sent to modem %u, coalesced %u\n",
+           name, total_ns / 1000000.0 / loop, max_ns / 1000000.0,
+           num_sent, queue->getCoalescedCount() / loop);
+
+    delete queue;
+    delete modem;
+}
+
+
+int main(int argc, char **argv) {
+    uint32_t loop = DEFAULT_LOOP;
+
+    if (argc > 1) {
+        loop = (uint32_t)atoi(argv[1]);
+    }
+    if (loop == 0) {
+        loop = DEFAULT_LOOP;
+    }
+
+    runTest("serial", 1, loop);
+    runTest("pipelined", 0, loop);
+
+    set_uint32_to_property(kPropertyKeyMsgSerial, 0);
+    return 0;
+}
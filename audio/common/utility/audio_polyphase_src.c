@@ -0,0 +1,536 @@
+#include "audio_polyphase_src.h"
+
+#include <string.h>
+#include <math.h>
+
+#include <pthread.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define AUDIO_POLYPHASE_SRC_NEON
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#define AUDIO_POLYPHASE_SRC_SSE
+#endif
+
+#include <audio_log.h>
+#include <audio_assert.h>
+#include <audio_memory_control.h>
+
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * =============================================================================
+ *                     MACRO
+ * =============================================================================
+ */
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+#define LOG_TAG "AudioPolyphaseSrc"
+
+
+#define MAX_POLYPHASE_TABLE_NUM (16)
+
+#define POLYPHASE_SRC_CHUNK_FRAMES (256)
+
+#define POLYPHASE_SRC_STOPBAND_DB (80.0)
+
+
+/*
+ * =============================================================================
+ *                     typedef
+ * =============================================================================
+ */
+
+typedef struct polyphase_table_t {
+    uint32_t L;         /* up */
+    uint32_t M;         /* down */
+    uint32_t taps;      /* per phase, multiple of 8 */
+    float   *coef;      /* [L][taps], reversed to multiply the history in order */
+} polyphase_table_t;
+
+
+struct audio_polyphase_src_t {
+    uint32_t input_rate;
+    uint32_t output_rate;
+    uint32_t input_channels;
+    uint32_t output_channels;
+    uint32_t process_channels;  /* 1 for 1 <-> 2 */
+
+    audio_src_sample_format_t input_format;
+    audio_src_sample_format_t output_format;
+
+    const polyphase_table_t *table;
+
+    uint32_t phase;     /* 0 ~ L-1 */
+    uint32_t in_idx;    /* next input index of the coming chunk */
+
+    float   *work[AUDIO_POLYPHASE_SRC_MAX_CHANNELS]; /* (taps - 1) history + chunk */
+};
+
+
+/*
+ * =============================================================================
+ *                     private variable
+ * =============================================================================
+ */
+
+static polyphase_table_t g_polyphase_tables[MAX_POLYPHASE_TABLE_NUM];
+static uint32_t g_num_polyphase_tables;
+static pthread_mutex_t g_polyphase_table_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/*
+ * =============================================================================
+ *                     private function
+ * =============================================================================
+ */
+
+static uint32_t gcd_u32(uint32_t a, uint32_t b) {
+    uint32_t t = 0;
+
+    while (b != 0) {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+
+static double bessel_i0(const double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    double k = 1.0;
+
+    do {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        k += 1.0;
+    } while (term > sum * 1e-12);
+
+    return sum;
+}
+
+
+static uint32_t get_taps_of_ratio(const uint32_t L, const uint32_t M) {
+    uint32_t taps = AUDIO_POLYPHASE_SRC_TAPS;
+
+    /* keep the transition band in output rate when down sampling */
+    if (M > L) {
+        taps = (AUDIO_POLYPHASE_SRC_TAPS * M + L - 1) / L;
+    }
+    return (taps + 7) & ~7;
+}
+
+
+/* windowed sinc (kaiser), cutoff at the nyquist of min(in, out) rate */
+static float *build_polyphase_coef(const uint32_t L, const uint32_t M, const uint32_t taps) {
+    const uint32_t length = L * taps;
+    const double center = (double)(length - 1) / 2.0;
+    const double ratio = (L < M) ? (double)L / (double)M : 1.0;
+    const double transition = (POLYPHASE_SRC_STOPBAND_DB - 8.0) / (2.285 * 2.0 * M_PI * taps);
+    const double cutoff = 0.5 * ratio - transition / 2.0;  /* cycles per input sample */
+    const double beta = 0.1102 * (POLYPHASE_SRC_STOPBAND_DB - 8.7);
+    const double i0_beta = bessel_i0(beta);
+
+    double *proto = NULL;
+    double sum = 0.0;
+    float *coef = NULL;
+    uint32_t p = 0;
+    uint32_t j = 0;
+    uint32_t k = 0;
+
+    AUDIO_ALLOC_STRUCT_ARRAY(double, length, proto);
+    AUDIO_ALLOC_STRUCT_ARRAY(float, length, coef);
+
+    for (k = 0; k < length; k++) {
+        double t = ((double)k - center) / (double)L;
+        double x = 2.0 * cutoff * t;
+        double sinc = (x == 0.0) ? 1.0 : sin(M_PI * x) / (M_PI * x);
+        double r = (2.0 * k) / (double)(length - 1) - 1.0;
+        double window = bessel_i0(beta * sqrt(1.0 - r * r)) / i0_beta;
+
+        proto[k] = 2.0 * cutoff * sinc * window;
+        sum += proto[k];
+    }
+
+    /* unity dc gain of each phase */
+    for (p = 0; p < L; p++) {
+        for (j = 0; j < taps; j++) {
+            coef[p * taps + j] = (float)(proto[p + (taps - 1 - j) * L] * (double)L / sum);
+        }
+    }
+
+    AUDIO_FREE_POINTER(proto);
+    return coef;
+}
+
+
+static const polyphase_table_t *get_polyphase_table(const uint32_t L, const uint32_t M) {
+    const polyphase_table_t *table = NULL;
+    uint32_t i = 0;
+
+    pthread_mutex_lock(&g_polyphase_table_lock);
+
+    for (i = 0; i < g_num_polyphase_tables; i++) {
+        if (g_polyphase_tables[i].L == L && g_polyphase_tables[i].M == M) {
+            table = &g_polyphase_tables[i];
+            break;
+        }
+    }
+
+    if (table == NULL && g_num_polyphase_tables < MAX_POLYPHASE_TABLE_NUM) {
+        polyphase_table_t *new_table = &g_polyphase_tables[g_num_polyphase_tables];
+
+        new_table->L = L;
+        new_table->M = M;
+        new_table->taps = get_taps_of_ratio(L, M);
+        new_table->coef = build_polyphase_coef(L, M, new_table->taps);
+        g_num_polyphase_tables++;
+
+        AUD_LOG_D("%s(), new table %u/%u, taps %u", __FUNCTION__, L, M, new_table->taps);
+        table = new_table;
+    }
+
+    pthread_mutex_unlock(&g_polyphase_table_lock);
+
+    if (table == NULL) {
+        AUD_LOG_W("%s(), table full!! L %u, M %u", __FUNCTION__, L, M);
+    }
+    return table;
+}
+
+
+static inline float dot_product(const float *coef, const float *x, const uint32_t taps) {
+    uint32_t i = 0;
+
+#if defined(AUDIO_POLYPHASE_SRC_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+
+    for (i = 0; i < taps; i += 8) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(coef + i),     vld1q_f32(x + i));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(coef + i + 4), vld1q_f32(x + i + 4));
+    }
+    acc0 = vaddq_f32(acc0, acc1);
+#if defined(__aarch64__)
+    return vaddvq_f32(acc0);
+#else
+    float32x2_t sum = vadd_f32(vget_low_f32(acc0), vget_high_f32(acc0));
+    sum = vpadd_f32(sum, sum);
+    return vget_lane_f32(sum, 0);
+#endif
+
+#elif defined(AUDIO_POLYPHASE_SRC_SSE)
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    float result = 0.0f;
+
+    for (i = 0; i < taps; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(coef + i),     _mm_loadu_ps(x + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(coef + i + 4), _mm_loadu_ps(x + i + 4)));
+    }
+    acc0 = _mm_add_ps(acc0, acc1);
+    acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+    acc0 = _mm_add_ss(acc0, _mm_shuffle_ps(acc0, acc0, 0x55));
+    _mm_store_ss(&result, acc0);
+    return result;
+
+#else
+    float acc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+
+    for (i = 0; i < taps; i += 4) {
+        acc[0] += coef[i]     * x[i];
+        acc[1] += coef[i + 1] * x[i + 1];
+        acc[2] += coef[i + 2] * x[i + 2];
+        acc[3] += coef[i + 3] * x[i + 3];
+    }
+    return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+#endif
+}
+
+
+static inline float read_sample(const void *buf, const uint32_t idx,
+                                const audio_src_sample_format_t format) {
+    switch (format) {
+    case AUDIO_SRC_SAMPLE_Q1P15:
+        return (float)((const int16_t *)buf)[idx] * (1.0f / 32768.0f);
+    case AUDIO_SRC_SAMPLE_Q9P23:
+        return (float)((const int32_t *)buf)[idx] * (1.0f / 8388608.0f);
+    case AUDIO_SRC_SAMPLE_Q1P31:
+        return (float)((const int32_t *)buf)[idx] * (1.0f / 2147483648.0f);
+    default:
+        return 0.0f;
+    }
+}
+
+
+static inline void write_sample(void *buf, const uint32_t idx, float value,
+                                const audio_src_sample_format_t format) {
+    if (value >= 1.0f) {
+        value = 1.0f;
+    } else if (value < -1.0f) {
+        value = -1.0f;
+    }
+
+    switch (format) {
+    case AUDIO_SRC_SAMPLE_Q1P15:
+        ((int16_t *)buf)[idx] = (value >= 1.0f) ? 32767 : (int16_t)lrintf(value * 32768.0f);
+        break;
+    case AUDIO_SRC_SAMPLE_Q9P23:
+        ((int32_t *)buf)[idx] = (value >= 1.0f) ? 8388607 : (int32_t)lrintf(value * 8388608.0f);
+        break;
+    case AUDIO_SRC_SAMPLE_Q1P31:
+        ((int32_t *)buf)[idx] = (value >= 1.0f) ? INT32_MAX : (int32_t)(value * 2147483648.0f);
+        break;
+    default:
+        break;
+    }
+}
+
+
+/* convert (and downmix 2 -> 1) the chunk into the work buffers */
+static void load_chunk(audio_polyphase_src_t *src, const char *input, const uint32_t frames) {
+    const uint32_t taps = src->table->taps;
+    const uint32_t in_ch = src->input_channels;
+    uint32_t ch = 0;
+    uint32_t i = 0;
+
+    if (in_ch == 2 && src->process_channels == 1) {
+        float *dst = src->work[0] + taps - 1;
+        for (i = 0; i < frames; i++) {
+            dst[i] = 0.5f * (read_sample(input, 2 * i, src->input_format) +
+                             read_sample(input, 2 * i + 1, src->input_format));
+        }
+        return;
+    }
+
+    for (ch = 0; ch < src->process_channels; ch++) {
+        float *dst = src->work[ch] + taps - 1;
+        for (i = 0; i < frames; i++) {
+            dst[i] = read_sample(input, i * in_ch + ch, src->input_format);
+        }
+    }
+}
+
+
+/*
+ * =============================================================================
+ *                     public function
+ * =============================================================================
+ */
+
+uint32_t audio_src_sample_format_size(const audio_src_sample_format_t format) {
+    switch (format) {
+    case AUDIO_SRC_SAMPLE_Q1P15:
+        return sizeof(int16_t);
+    case AUDIO_SRC_SAMPLE_Q9P23:
+    case AUDIO_SRC_SAMPLE_Q1P31:
+        return sizeof(int32_t);
+    default:
+        return 0;
+    }
+}
+
+
+bool audio_polyphase_src_support(const uint32_t input_rate, const uint32_t output_rate) {
+    uint32_t gcd = 0;
+
+    if (input_rate == 0 || output_rate == 0) {
+        return false;
+    }
+
+    gcd = gcd_u32(input_rate, output_rate);
+    return (output_rate / gcd <= AUDIO_POLYPHASE_SRC_MAX_PHASE &&
+            input_rate / gcd <= AUDIO_POLYPHASE_SRC_MAX_PHASE);
+}
+
+
+audio_polyphase_src_t *audio_polyphase_src_create(
+    const uint32_t input_rate,
+    const uint32_t input_channels,
+    const uint32_t output_rate,
+    const uint32_t output_channels,
+    const audio_src_sample_format_t input_format,
+    const audio_src_sample_format_t output_format) {
+    audio_polyphase_src_t *src = NULL;
+    const polyphase_table_t *table = NULL;
+    uint32_t gcd = 0;
+    uint32_t ch = 0;
+
+    if (!audio_polyphase_src_support(input_rate, output_rate)) {
+        AUD_LOG_W("%s(), not support rate %u => %u", __FUNCTION__, input_rate, output_rate);
+        return NULL;
+    }
+    if (input_channels == 0 || input_channels > AUDIO_POLYPHASE_SRC_MAX_CHANNELS ||
+        (input_channels != output_channels &&
+         !(input_channels == 1 && output_channels == 2) &&
+         !(input_channels == 2 && output_channels == 1))) {
+        AUD_LOG_W("%s(), not support channels %u => %u", __FUNCTION__, input_channels, output_channels);
+        return NULL;
+    }
+    if (audio_src_sample_format_size(input_format) == 0 ||
+        audio_src_sample_format_size(output_format) == 0) {
+        AUD_LOG_W("%s(), not support format %d => %d", __FUNCTION__, input_format, output_format);
+        return NULL;
+    }
+
+    gcd = gcd_u32(input_rate, output_rate);
+    table = get_polyphase_table(output_rate / gcd, input_rate / gcd);
+    if (table == NULL) {
+        return NULL;
+    }
+
+    AUDIO_ALLOC_STRUCT(audio_polyphase_src_t, src);
+
+    src->input_rate = input_rate;
+    src->output_rate = output_rate;
+    src->input_channels = input_channels;
+    src->output_channels = output_channels;
+    src->process_channels = (input_channels == output_channels) ? input_channels : 1;
+    src->input_format = input_format;
+    src->output_format = output_format;
+    src->table = table;
+
+    for (ch = 0; ch < src->process_channels; ch++) {
+        AUDIO_ALLOC_STRUCT_ARRAY(float, (table->taps - 1 + POLYPHASE_SRC_CHUNK_FRAMES), src->work[ch]);
+    }
+
+    AUD_LOG_D("%s(), %u => %u (%u/%u, taps %u), ch %u => %u, format %d => %d", __FUNCTION__,
+              input_rate, output_rate, table->L, table->M, table->taps,
+              input_channels, output_channels, input_format, output_format);
+
+    audio_polyphase_src_reset(src);
+    return src;
+}
+
+
+void audio_polyphase_src_destroy(audio_polyphase_src_t *src) {
+    uint32_t ch = 0;
+
+    if (src == NULL) {
+        return;
+    }
+
+    for (ch = 0; ch < AUDIO_POLYPHASE_SRC_MAX_CHANNELS; ch++) {
+        AUDIO_FREE_POINTER(src->work[ch]);
+    }
+    AUDIO_FREE_POINTER(src);
+}
+
+
+void audio_polyphase_src_reset(audio_polyphase_src_t *src) {
+    uint32_t ch = 0;
+
+    if (src == NULL) {
+        return;
+    }
+
+    src->phase = 0;
+    src->in_idx = 0;
+    for (ch = 0; ch < src->process_channels; ch++) {
+        memset(src->work[ch], 0, sizeof(float) * (src->table->taps - 1));
+    }
+}
+
+
+int audio_polyphase_src_process(
+    audio_polyphase_src_t *src,
+    const void *input,
+    uint32_t *p_input_bytes,
+    void *output,
+    uint32_t *p_output_bytes) {
+    const polyphase_table_t *table = NULL;
+    uint32_t in_frame_size = 0;
+    uint32_t out_frame_size = 0;
+    uint32_t in_frames = 0;
+    uint32_t out_frames = 0;
+    uint32_t consumed = 0;
+    uint32_t produced = 0;
+
+    if (src == NULL || input == NULL || output == NULL ||
+        p_input_bytes == NULL || p_output_bytes == NULL) {
+        AUD_LOG_E("%s(), NULL!!", __FUNCTION__);
+        return -1;
+    }
+
+    table = src->table;
+    in_frame_size = src->input_channels * audio_src_sample_format_size(src->input_format);
+    out_frame_size = src->output_channels * audio_src_sample_format_size(src->output_format);
+    in_frames = *p_input_bytes / in_frame_size;
+    out_frames = *p_output_bytes / out_frame_size;
+
+    while (consumed < in_frames) {
+        const char *p_in = (const char *)input + consumed * in_frame_size;
+        uint32_t chunk = in_frames - consumed;
+        uint64_t chunk_max = 0;
+        uint32_t idx = src->in_idx;
+        uint32_t phase = src->phase;
+        uint32_t ch = 0;
+
+        if (chunk > POLYPHASE_SRC_CHUNK_FRAMES) {
+            chunk = POLYPHASE_SRC_CHUNK_FRAMES;
+        }
+
+        /* outputs of chunk = ceil(((chunk - idx) * L - phase) / M), limit by out space */
+        chunk_max = idx + ((uint64_t)(out_frames - produced) * table->M + phase) / table->L;
+        if (chunk > chunk_max) {
+            chunk = (uint32_t)chunk_max;
+        }
+        if (chunk == 0) {
+            break;
+        }
+
+        load_chunk(src, p_in, chunk);
+
+        while (idx < chunk) {
+            const float *coef = table->coef + phase * table->taps;
+            uint32_t out_base = produced * src->output_channels;
+
+            if (src->process_channels == src->output_channels) {
+                for (ch = 0; ch < src->process_channels; ch++) {
+                    write_sample(output, out_base + ch,
+                                 dot_product(coef, src->work[ch] + idx, table->taps),
+                                 src->output_format);
+                }
+            } else { /* 1 -> 2, or 2 -> 1 after downmix */
+                float value = dot_product(coef, src->work[0] + idx, table->taps);
+                for (ch = 0; ch < src->output_channels; ch++) {
+                    write_sample(output, out_base + ch, value, src->output_format);
+                }
+            }
+            produced++;
+
+            phase += table->M;
+            idx += phase / table->L;
+            phase %= table->L;
+        }
+
+        /* keep taps - 1 history for the next chunk */
+        for (ch = 0; ch < src->process_channels; ch++) {
+            memmove(src->work[ch], src->work[ch] + chunk, sizeof(float) * (table->taps - 1));
+        }
+        src->in_idx = idx - chunk;
+        src->phase = phase;
+        consumed += chunk;
+    }
+
+    *p_input_bytes -= consumed * in_frame_size;
+    *p_output_bytes = produced * out_frame_size;
+    return 0;
+}
+
+
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
@@ -0,0 +1,89 @@
+#ifndef AUDIO_POLYPHASE_SRC_H
+#define AUDIO_POLYPHASE_SRC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * =============================================================================
+ *                     MACRO
+ * =============================================================================
+ */
+
+#define AUDIO_POLYPHASE_SRC_TAPS            (48)  /* taps per phase, multiple of 8 */
+#define AUDIO_POLYPHASE_SRC_MAX_PHASE       (320) /* ex, 22050 -> 48000 = 320 / 147 */
+#define AUDIO_POLYPHASE_SRC_MAX_CHANNELS    (8)
+
+
+/*
+ * =============================================================================
+ *                     typedef
+ * =============================================================================
+ */
+
+typedef enum {
+    AUDIO_SRC_SAMPLE_Q1P15, /* AUDIO_FORMAT_PCM_16_BIT */
+    AUDIO_SRC_SAMPLE_Q9P23, /* AUDIO_FORMAT_PCM_8_24_BIT */
+    AUDIO_SRC_SAMPLE_Q1P31, /* AUDIO_FORMAT_PCM_32_BIT */
+    AUDIO_SRC_SAMPLE_INVALID
+} audio_src_sample_format_t;
+
+
+struct audio_polyphase_src_t;
+typedef struct audio_polyphase_src_t audio_polyphase_src_t;
+
+
+/*
+ * =============================================================================
+ *                     public function
+ * =============================================================================
+ */
+
+/* rate ratio reduced to L/M with L, M <= AUDIO_POLYPHASE_SRC_MAX_PHASE */
+bool audio_polyphase_src_support(
+    const uint32_t input_rate,
+    const uint32_t output_rate);
+
+/*
+ * channel: in == out, or 1 <-> 2 (dup / average).
+ * the coefficient table of each ratio is built once and shared by all streams.
+ */
+audio_polyphase_src_t *audio_polyphase_src_create(
+    const uint32_t input_rate,
+    const uint32_t input_channels,
+    const uint32_t output_rate,
+    const uint32_t output_channels,
+    const audio_src_sample_format_t input_format,
+    const audio_src_sample_format_t output_format);
+
+void audio_polyphase_src_destroy(audio_polyphase_src_t *src);
+
+void audio_polyphase_src_reset(audio_polyphase_src_t *src);
+
+/*
+ * same semantic as MtkAudioSrcBase::process():
+ *  in : *p_input_bytes = input size,  *p_output_bytes = output buffer size
+ *  out: *p_input_bytes = input left,  *p_output_bytes = output size
+ */
+int audio_polyphase_src_process(
+    audio_polyphase_src_t *src,
+    const void *input,
+    uint32_t *p_input_bytes,
+    void *output,
+    uint32_t *p_output_bytes);
+
+uint32_t audio_src_sample_format_size(const audio_src_sample_format_t format);
+
+
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif /* end of AUDIO_POLYPHASE_SRC_H */
+
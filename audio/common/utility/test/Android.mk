@@ -0,0 +1,30 @@
+LOCAL_PATH := $(call my-dir)
+
+#
+# polyphase SRC THD+N / throughput test
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    audio_polyphase_src_test.cpp \
+    ../audio_polyphase_src.c \
+    ../audio_time.c
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/.. \
+    $(TOPDIR)vendor/mediatek/proprietary/external/AudioComponentEngine
+
+LOCAL_SHARED_LIBRARIES := \
+    liblog \
+    libcutils \
+    libutils \
+    libdl
+
+LOCAL_MODULE := audio_polyphase_src_test
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,237 @@
+/*
+ * audio_polyphase_src_test: THD+N & throughput of polyphase SRC vs Bli SRC
+ *
+ * 997 Hz sine at -6 dBFS, stereo, 16 bit, 20 ms periods.
+ * Bli SRC is loaded from libaudiocomponentengine_vendor.so as the HAL does.
+ * Polyphase SRC fails the test when its THD+N is above THDN_MAX_DB or its
+ * output length is off the rate ratio; Bli SRC is only a reference.
+ *
+ * usage: audio_polyphase_src_test [seconds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <dlfcn.h>
+
+#include <audio_time.h>
+#include <audio_polyphase_src.h>
+
+#include "MtkAudioComponent.h"
+
+
+using namespace android;
+
+
+#if defined(__LP64__)
+#define AUDIO_COMPONENT_ENGINE_LIB_VENDOR_PATH "/vendor/lib64/libaudiocomponentengine_vendor.so"
+#else
+#define AUDIO_COMPONENT_ENGINE_LIB_VENDOR_PATH "/vendor/lib/libaudiocomponentengine_vendor.so"
+#endif
+
+#define TEST_TONE_HZ     (997.0)
+#define TEST_TONE_AMP    (0.5)
+#define TEST_CHANNELS    (2)
+#define TEST_PERIOD_MS   (20)
+#define SETTLE_MS        (100)  /* skip filter delay */
+
+#define THDN_MAX_DB      (-80.0)  /* polyphase SRC measures about -89 dB */
+#define LENGTH_TOLERANCE (1)      /* output frames off in_frames * out_rate / in_rate */
+
+
+struct SrcTestCase {
+    uint32_t input_rate;
+    uint32_t output_rate;
+};
+
+static const SrcTestCase kTestCases[] = {
+    {44100, 48000},
+    {48000, 44100},
+    {16000, 48000},
+    {48000, 16000},
+    { 8000, 48000},
+    {32000, 48000},
+};
+
+
+struct SrcTestResult {
+    double thdn_db;
+    double realtime_ratio;
+    uint32_t output_frames;
+    uint32_t expected_frames;
+};
+
+
+typedef int (*src_process_fp_t)(void *arg, int16_t *in, uint32_t *in_bytes, int16_t *out, uint32_t *out_bytes);
+
+
+static int processPolyphase(void *arg, int16_t *in, uint32_t *in_bytes, int16_t *out, uint32_t *out_bytes) {
+    return audio_polyphase_src_process((audio_polyphase_src_t *)arg, in, in_bytes, out, out_bytes);
+}
+
+
+static int processBli(void *arg, int16_t *in, uint32_t *in_bytes, int16_t *out, uint32_t *out_bytes) {
+    return ((MtkAudioSrcBase *)arg)->process(in, in_bytes, out, out_bytes);
+}
+
+
+/* least square fit of the tone, everything else is noise + distortion */
+static double calculateThdn(const int16_t *buf, const uint32_t frames, const uint32_t rate) {
+    double s11 = 0, s12 = 0, s22 = 0, r1 = 0, r2 = 0;
+    double a = 0, b = 0, det = 0;
+    double signal = 0, residual = 0;
+    uint32_t i = 0;
+
+    for (i = 0; i < frames; i++) {
+        double w = 2.0 * M_PI * TEST_TONE_HZ * i / rate;
+        double y = buf[i * TEST_CHANNELS] / 32768.0;
+        s11 += cos(w) * cos(w);
+        s12 += cos(w) * sin(w);
+        s22 += sin(w) * sin(w);
+        r1 += y * cos(w);
+        r2 += y * sin(w);
+    }
+    det = s11 * s22 - s12 * s12;
+    a = (r1 * s22 - r2 * s12) / det;
+    b = (s11 * r2 - s12 * r1) / det;
+
+    for (i = 0; i < frames; i++) {
+        double w = 2.0 * M_PI * TEST_TONE_HZ * i / rate;
+        double fit = a * cos(w) + b * sin(w);
+        double y = buf[i * TEST_CHANNELS] / 32768.0;
+        signal += fit * fit;
+        residual += (y - fit) * (y - fit);
+    }
+    return 10.0 * log10(residual / signal);
+}
+
+
+static void runTest(const SrcTestCase *test_case, const uint32_t seconds,
+                    src_process_fp_t process, void *arg, SrcTestResult *result) {
+    const uint32_t in_frames = test_case->input_rate * seconds;
+    const uint32_t out_capacity = (uint32_t)((uint64_t)in_frames * test_case->output_rate / test_case->input_rate) + 1024;
+    const uint32_t period_frames = test_case->input_rate * TEST_PERIOD_MS / 1000;
+    const uint32_t frame_size = TEST_CHANNELS * sizeof(int16_t);
+    const uint32_t settle = test_case->output_rate * SETTLE_MS / 1000;
+
+    int16_t *in = new int16_t[in_frames * TEST_CHANNELS];
+    int16_t *out = new int16_t[out_capacity * TEST_CHANNELS];
+    struct timespec ts_start;
+    struct timespec ts_stop;
+    uint32_t produced = 0;
+    uint32_t i = 0;
+
+    for (i = 0; i < in_frames; i++) {
+        int16_t value = (int16_t)lrint(TEST_TONE_AMP * 32767.0 * sin(2.0 * M_PI * TEST_TONE_HZ * i / test_case->input_rate));
+        in[i * TEST_CHANNELS] = value;
+        in[i * TEST_CHANNELS + 1] = value;
+    }
+
+    audio_get_timespec_monotonic(&ts_start);
+    for (i = 0; i + period_frames <= in_frames; i += period_frames) {
+        uint32_t in_bytes = period_frames * frame_size;
+        uint32_t out_bytes = (out_capacity - produced) * frame_size;
+        process(arg, in + i * TEST_CHANNELS, &in_bytes, out + produced * TEST_CHANNELS, &out_bytes);
+        produced += out_bytes / frame_size;
+    }
+    audio_get_timespec_monotonic(&ts_stop);
+
+    result->output_frames = produced;
+    result->expected_frames = (uint32_t)((uint64_t)i * test_case->output_rate / test_case->input_rate);
+    result->realtime_ratio = (double)seconds * 1e9 / (double)get_time_diff_ns(&ts_start, &ts_stop);
+    result->thdn_db = (produced > settle) ?
+                      calculateThdn(out + settle * TEST_CHANNELS, produced - settle, test_case->output_rate) :
+                      0.0;
+
+    delete[] in;
+    delete[] out;
+}
+
+
+int main(int argc, char **argv) {
+    uint32_t seconds = 5;
+    void *handle = NULL;
+    create_AudioSrc *create_bli_src = NULL;
+    destroy_AudioSrc *destroy_bli_src = NULL;
+    int fail = 0;
+
+    if (argc > 1) {
+        seconds = (uint32_t)atoi(argv[1]);
+    }
+    if (seconds == 0) {
+        seconds = 5;
+    }
+
+    handle = dlopen(AUDIO_COMPONENT_ENGINE_LIB_VENDOR_PATH, RTLD_NOW);
+    if (handle != NULL) {
+        create_bli_src = (create_AudioSrc *)dlsym(handle, "createMtkAudioSrc");
+        destroy_bli_src = (destroy_AudioSrc *)dlsym(handle, "destroyMtkAudioSrc");
+    }
+    if (create_bli_src == NULL || destroy_bli_src == NULL) {
+        printf("Bli SRC not available, test polyphase SRC only\n");
+    }
+
+    printf("%-14s | %-22s | %-22s\n", "ratio", "polyphase THD+N / xRT", "bli THD+N / xRT");
+
+    for (size_t c = 0; c < sizeof(kTestCases) / sizeof(kTestCases[0]); c++) {
+        const SrcTestCase *test_case = &kTestCases[c];
+        SrcTestResult polyphase_result;
+        SrcTestResult bli_result;
+        audio_polyphase_src_t *polyphase_src = NULL;
+        MtkAudioSrcBase *bli_src = NULL;
+
+        memset(&polyphase_result, 0, sizeof(polyphase_result));
+        memset(&bli_result, 0, sizeof(bli_result));
+
+        polyphase_src = audio_polyphase_src_create(
+                            test_case->input_rate, TEST_CHANNELS,
+                            test_case->output_rate, TEST_CHANNELS,
+                            AUDIO_SRC_SAMPLE_Q1P15, AUDIO_SRC_SAMPLE_Q1P15);
+        if (polyphase_src != NULL) {
+            runTest(test_case, seconds, processPolyphase, polyphase_src, &polyphase_result);
+            audio_polyphase_src_destroy(polyphase_src);
+        } else {
+            printf("FAIL: %u -> %u polyphase SRC create failed\n", test_case->input_rate, test_case->output_rate);
+            fail++;
+        }
+
+        if (create_bli_src != NULL) {
+            bli_src = create_bli_src(test_case->input_rate, TEST_CHANNELS,
+                                     test_case->output_rate, TEST_CHANNELS,
+                                     SRC_IN_Q1P15_OUT_Q1P15);
+        }
+        if (bli_src != NULL) {
+            bli_src->open();
+            runTest(test_case, seconds, processBli, bli_src, &bli_result);
+            bli_src->close();
+            destroy_bli_src(bli_src);
+        }
+
+        printf("%5u -> %5u | %7.1f dB / %7.1fx | %7.1f dB / %7.1fx\n",
+               test_case->input_rate, test_case->output_rate,
+               polyphase_result.thdn_db, polyphase_result.realtime_ratio,
+               bli_result.thdn_db, bli_result.realtime_ratio);
+
+        if (polyphase_src == NULL) {
+            continue;
+        }
+        if (polyphase_result.thdn_db > THDN_MAX_DB) {
+            printf("FAIL: %u -> %u THD+N %.1f dB above %.1f dB\n",
+                   test_case->input_rate, test_case->output_rate, polyphase_result.thdn_db, THDN_MAX_DB);
+            fail++;
+        }
+        if (abs((int)polyphase_result.output_frames - (int)polyphase_result.expected_frames) > LENGTH_TOLERANCE) {
+            printf("FAIL: %u -> %u output %u frames, expected %u\n", test_case->input_rate, test_case->output_rate,
+                   polyphase_result.output_frames, polyphase_result.expected_frames);
+            fail++;
+        }
+    }
+
+    if (handle != NULL) {
+        dlclose(handle);
+    }
+
+    printf("%s\n", fail ? "FAIL" : "PASS");
+    return fail ? 1 : 0;
+}
@@ -255,11 +255,13 @@ LOCAL_C_INCLUDES += external/icu/icu4c/source/common
 LOCAL_SRC_FILES+= \
     $(LOCAL_COMMON_PATH)/utility/audio_lock.c \
     $(LOCAL_COMMON_PATH)/utility/audio_time.c \
+    $(LOCAL_COMMON_PATH)/utility/audio_polyphase_src.c \
     $(LOCAL_COMMON_PATH)/utility/audio_ringbuf.c \
     $(LOCAL_COMMON_PATH)/aud_drv/audio_hw_hal.cpp \
     $(LOCAL_COMMON_PATH)/aud_drv/AudioMTKFilter.cpp \
     $(LOCAL_COMMON_PATH)/aud_drv/AudioMTKHeadsetMessager.cpp \
     $(LOCAL_COMMON_PATH)/aud_drv/AudioUtility.cpp \
+    $(LOCAL_COMMON_PATH)/aud_drv/AudioPCMDumpWriter.cpp \
     $(LOCAL_COMMON_PATH)/aud_drv/AudioFtmBase.cpp \
     $(LOCAL_COMMON_PATH)/aud_drv/WCNChipController.cpp \
     $(LOCAL_COMMON_PATH)/speech_driver/SpeechDriverFactory.cpp \
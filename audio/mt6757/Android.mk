@@ -274,12 +274,14 @@ endif
 LOCAL_SRC_FILES+= \
     $(LOCAL_COMMON_PATH)/utility/audio_lock.c \
     $(LOCAL_COMMON_PATH)/utility/audio_time.c \
+    $(LOCAL_COMMON_PATH)/utility/audio_polyphase_src.c \
     $(LOCAL_COMMON_PATH)/utility/audio_ringbuf.c \
     $(LOCAL_COMMON_PATH)/utility/audio_sample_rate.c \
     $(LOCAL_COMMON_PATH)/aud_drv/audio_hw_hal.cpp \
     $(LOCAL_COMMON_PATH)/aud_drv/AudioMTKFilter.cpp \
     $(LOCAL_COMMON_PATH)/aud_drv/AudioMTKHeadsetMessager.cpp \
     $(LOCAL_COMMON_PATH)/aud_drv/AudioUtility.cpp \
+    $(LOCAL_COMMON_PATH)/aud_drv/AudioPCMDumpWriter.cpp \
     $(LOCAL_COMMON_PATH)/aud_drv/AudioFtmBase.cpp \
     $(LOCAL_COMMON_PATH)/aud_drv/WCNChipController.cpp \
     $(LOCAL_COMMON_PATH)/speech_driver/SpeechDriverFactory.cpp \
@@ -427,6 +429,7 @@ ifeq ($(strip $(MTK_AURISYS_FRAMEWORK_SUPPORT)),yes)
         $(LOCAL_COMMON_PATH)/aurisys/utility/audio_pool_buf_handler.c \
         $(LOCAL_COMMON_PATH)/aurisys/utility/AudioAurisysPcmDump.c \
         $(LOCAL_COMMON_PATH)/aurisys/framework/aurisys_config_parser.c \
+        $(LOCAL_COMMON_PATH)/aurisys/framework/aurisys_config_cache.c \
         $(LOCAL_COMMON_PATH)/aurisys/framework/aurisys_controller.c \
         $(LOCAL_COMMON_PATH)/aurisys/framework/aurisys_lib_manager.c \
         $(LOCAL_COMMON_PATH)/aurisys/framework/aurisys_lib_handler.c \
@@ -43,8 +43,8 @@
 
 #include <media/AudioParameter.h>
 #include <media/AudioBufferProvider.h>
-#include <media/nbaio/MonoPipe.h>
-#include <media/nbaio/MonoPipeReader.h>
+
+#include "submix_ring.h"
 
 #define MAX_UNREAD_COUNTS            50 //to print debug information
 
@@ -84,12 +84,18 @@ namespace android {
 #define SUBMIX_ALOGE(...)
 #endif // SUBMIX_VERBOSE_LOGGING
 
-// NOTE: This value will be rounded up to the nearest power of 2 by MonoPipe().
+// NOTE: This value will be rounded up to the nearest power of 2 by SubmixRing().
 #define DEFAULT_PIPE_SIZE_IN_FRAMES  (1024*4)
-// Value used to divide the MonoPipe() buffer into segments that are written to the source and
-// read from the sink.  The maximum latency of the device is the size of the MonoPipe's buffer
-// the minimum latency is the MonoPipe buffer size divided by this value.
+// Value used to divide the SubmixRing() buffer into segments that are written to the source and
+// read from the sink.  The maximum latency of the device is the size of the SubmixRing's buffer
+// the minimum latency is the SubmixRing buffer size divided by this value.
 #define DEFAULT_PIPE_PERIOD_COUNT    4
+// Both streams are paced against CLOCK_MONOTONIC.  A stream late by more than this (ex: after
+// a stall of the client) is re-anchored instead of bursting to catch up.
+#define PACING_MAX_LAG_MS            50
+// Maximum slew of the input pacing per read used to keep the ring fill level around one read
+// period, i.e. to compensate the drift between the writer and the reader.
+#define DRIFT_SLEW_MAX_US            500
 // The duration of MAX_READ_ATTEMPTS * READ_ATTEMPT_SLEEP_MS must be stricly inferior to
 //   the duration of a record buffer at the current record sample rate (of the device, not of
 //   the recording itself). Here we have:
@@ -176,10 +182,11 @@ typedef struct route_config {
     // A usecase example is one where the component capturing the audio is then sending it over
     // Wifi for presentation on a remote Wifi Display device (e.g. a dongle attached to a TV, or a
     // TV with Wifi Display capabilities), or to a wireless audio player.
-    sp<MonoPipe> rsxSink;
-    sp<MonoPipeReader> rsxSource;
-    // Pointers to the current input and output stream instances.  rsxSink and rsxSource are
-    // destroyed if both and input and output streams are destroyed.
+    // The ring is lock-free SPSC shared memory: the output stream is the only producer and the
+    // input stream the only consumer, so rsxadev->lock is only needed to look it up.
+    sp<SubmixRing> rsxRing;
+    // Pointers to the current input and output stream instances.  rsxRing is destroyed if both
+    // and input and output streams are destroyed.
     struct submix_stream_out *output;
     struct submix_stream_in *input;
 #if ENABLE_RESAMPLING
@@ -204,6 +211,8 @@ struct submix_stream_out {
     bool output_standby;
     uint64_t frames_written;
     uint64_t frames_written_since_standby;
+    // real time pacing of the writes
+    struct SubmixClock clock;
 #if LOG_STREAMS_TO_FILES
     int log_fd;
 #endif // LOG_STREAMS_TO_FILES
@@ -219,6 +228,8 @@ struct submix_stream_in {
     struct timespec record_start_time;
     // how many frames have been requested to be read
     uint64_t read_counter_frames;
+    // real time pacing of the reads
+    struct SubmixClock clock;
 #ifdef MTK_AOSP_ENHANCEMENT
     // last record start time
     struct timespec last_record_start_time;
@@ -487,7 +498,7 @@ static void submix_audio_device_create_pipe_l(struct submix_audio_device * const
     strncpy(rsxadev->routes[route_idx].address, address, AUDIO_DEVICE_MAX_ADDRESS_LEN);
     ALOGD("  now using address %s for route %d", rsxadev->routes[route_idx].address, route_idx);
     // If a pipe isn't associated with the device, create one.
-    if (rsxadev->routes[route_idx].rsxSink == NULL || rsxadev->routes[route_idx].rsxSource == NULL)
+    if (rsxadev->routes[route_idx].rsxRing == NULL)
     {
         struct submix_config * const device_config = &rsxadev->routes[route_idx].config;
         uint32_t channel_count;
@@ -503,31 +514,21 @@ static void submix_audio_device_create_pipe_l(struct submix_audio_device * const
 #else
         const uint32_t pipe_channel_count = channel_count;
 #endif // ENABLE_CHANNEL_CONVERSION
-        const NBAIO_Format format = Format_from_SR_C(config->sample_rate, pipe_channel_count,
-            config->format);
-        const NBAIO_Format offers[1] = {format};
-        size_t numCounterOffers = 0;
-        // Create a MonoPipe with optional blocking set to true.
-        MonoPipe* sink = new MonoPipe(buffer_size_frames, format, true /*writeCanBlock*/);
-        // Negotiation between the source and sink cannot fail as the device open operation
-        // creates both ends of the pipe using the same audio format.
-        ssize_t index = sink->negotiate(offers, 1, NULL, numCounterOffers);
-        ALOG_ASSERT(index == 0);
-        MonoPipeReader* source = new MonoPipeReader(sink);
-        numCounterOffers = 0;
-        index = source->negotiate(offers, 1, NULL, numCounterOffers);
-        ALOG_ASSERT(index == 0);
+        const size_t ring_frame_size = pipe_channel_count * audio_bytes_per_sample(config->format);
+        // Both ends share the same ring, the format cannot mismatch.
+        SubmixRing* ring = new SubmixRing(buffer_size_frames, ring_frame_size);
+        if (!ring->initCheck()) {
+            ALOGE("submix_audio_device_create_pipe_l(): ring allocation failed");
+        }
         ALOGV("submix_audio_device_create_pipe_l(): created pipe");
 
-        // Save references to the source and sink.
-        ALOG_ASSERT(rsxadev->routes[route_idx].rsxSink == NULL);
-        ALOG_ASSERT(rsxadev->routes[route_idx].rsxSource == NULL);
-        rsxadev->routes[route_idx].rsxSink = sink;
-        rsxadev->routes[route_idx].rsxSource = source;
+        // Save a reference to the ring.
+        ALOG_ASSERT(rsxadev->routes[route_idx].rsxRing == NULL);
+        rsxadev->routes[route_idx].rsxRing = ring;
         // Store the sanitized audio format in the device so that it's possible to determine
         // the format of the pipe source when opening the input device.
         memcpy(&device_config->common, config, sizeof(device_config->common));
-        device_config->buffer_size_frames = sink->maxFrames();
+        device_config->buffer_size_frames = ring->maxFrames();
         device_config->buffer_period_size_frames = device_config->buffer_size_frames /
                 buffer_period_count;
         if (in) device_config->pipe_frame_size = audio_stream_in_frame_size(&in->stream);
@@ -543,9 +544,8 @@ static void submix_audio_device_create_pipe_l(struct submix_audio_device * const
     }
 }
 
-// Release references to the sink and source.  Input and output threads may maintain references
-// to these objects via StrongPointer (sp<MonoPipe> and sp<MonoPipeReader>) which they can use
-// before they shutdown.
+// Release the reference to the ring.  Input and output threads may maintain references to it via
+// StrongPointer (sp<SubmixRing>) which they can use before they shutdown.
 // Must be called with lock held on the submix_audio_device
 static void submix_audio_device_release_pipe_l(struct submix_audio_device * const rsxadev,
         int route_idx)
@@ -554,13 +554,9 @@ static void submix_audio_device_release_pipe_l(struct submix_audio_device * cons
     ALOG_ASSERT(route_idx < MAX_ROUTES);
     ALOGD("submix_audio_device_release_pipe_l(idx=%d) addr=%s", route_idx,
             rsxadev->routes[route_idx].address);
-    if (rsxadev->routes[route_idx].rsxSink != 0) {
-        rsxadev->routes[route_idx].rsxSink.clear();
-        rsxadev->routes[route_idx].rsxSink = 0;
-    }
-    if (rsxadev->routes[route_idx].rsxSource != 0) {
-        rsxadev->routes[route_idx].rsxSource.clear();
-        rsxadev->routes[route_idx].rsxSource = 0;
+    if (rsxadev->routes[route_idx].rsxRing != 0) {
+        rsxadev->routes[route_idx].rsxRing.clear();
+        rsxadev->routes[route_idx].rsxRing = 0;
     }
     memset(rsxadev->routes[route_idx].address, 0, AUDIO_DEVICE_MAX_ADDRESS_LEN);
 #ifdef ENABLE_RESAMPLING
@@ -576,7 +572,6 @@ static void submix_audio_device_destroy_pipe_l(struct submix_audio_device * cons
                                              const struct submix_stream_in * const in,
                                              const struct submix_stream_out * const out)
 {
-    MonoPipe* sink;
     ALOGV("submix_audio_device_destroy_pipe_l()");
     int route_idx = -1;
     if (in != NULL) {
@@ -796,6 +791,7 @@ static int out_standby(struct audio_stream *stream)
 
     out->output_standby = true;
     out->frames_written_since_standby = 0;
+    out->clock.reset(out_get_sample_rate(stream));
 
     pthread_mutex_unlock(&rsxadev->lock);
 
@@ -822,15 +818,15 @@ static int out_set_parameters(struct audio_stream *stream, const char *kvpairs)
                 audio_stream_get_submix_stream_out(stream)->dev;
         pthread_mutex_lock(&rsxadev->lock);
         { // using the sink
-            sp<MonoPipe> sink =
+            sp<SubmixRing> sink =
                     rsxadev->routes[audio_stream_get_submix_stream_out(stream)->route_handle]
-                                    .rsxSink;
+                                    .rsxRing;
             if (sink == NULL) {
                 pthread_mutex_unlock(&rsxadev->lock);
                 return 0;
             }
 
-            ALOGD("out_set_parameters(): shutting down MonoPipe sink");
+            ALOGD("out_set_parameters(): shutting down SubmixRing sink");
             sink->shutdown(true);
         } // done using the sink
         pthread_mutex_unlock(&rsxadev->lock);
@@ -884,7 +880,7 @@ static ssize_t out_write(struct audio_stream_out *stream, const void* buffer,
 
     out->output_standby = false;
 
-    sp<MonoPipe> sink = rsxadev->routes[out->route_handle].rsxSink;
+    sp<SubmixRing> sink = rsxadev->routes[out->route_handle].rsxRing;
     if (sink != NULL) {
         if (sink->isShutdown()) {
             sink.clear();
@@ -892,7 +888,7 @@ static ssize_t out_write(struct audio_stream_out *stream, const void* buffer,
             SUBMIX_ALOGV("out_write(): pipe shutdown, ignoring the write.");
             // the pipe has already been shutdown, this buffer will be lost but we must
             //   simulate timing so we don't drain the output faster than realtime
-            usleep(frames * 1000000 / out_get_sample_rate(&stream->common));
+            out->clock.pace(frames, (int64_t)PACING_MAX_LAG_MS * 1000000);
             return bytes;
         }
     } else {
@@ -901,54 +897,19 @@ static ssize_t out_write(struct audio_stream_out *stream, const void* buffer,
         ALOG_ASSERT("out_write without a pipe!");
         return 0;
     }
+    pthread_mutex_unlock(&rsxadev->lock);
+
     //Dump debug data
     dumpPcmData(r_submix_streamout,(void*)buffer,bytes,streamout_propty);
 
-    // If the write to the sink would block when no input stream is present, flush enough frames
-    // from the pipe to make space to write the most recent data.
-    {
-        const size_t availableToWrite = sink->availableToWrite();
-        sp<MonoPipeReader> source = rsxadev->routes[out->route_handle].rsxSource;
-        if (rsxadev->routes[out->route_handle].input == NULL && availableToWrite < frames) {
-            static uint8_t flush_buffer[64];
-            const size_t flushBufferSizeFrames = sizeof(flush_buffer) / frame_size;
-            size_t frames_to_flush_from_source = frames - availableToWrite;
-            SUBMIX_ALOGV("out_write(): flushing %d frames from the pipe to avoid blocking",
-                         frames_to_flush_from_source);
-            while (frames_to_flush_from_source) {
-                const size_t flush_size = min(frames_to_flush_from_source, flushBufferSizeFrames);
-                frames_to_flush_from_source -= flush_size;
-                // read does not block
-                source->read(flush_buffer, flush_size);
-            }
-        }
-    }
-
-    pthread_mutex_unlock(&rsxadev->lock);
-
+    // The write never blocks: when no input stream is present, or the input stream stalls,
+    // the oldest frames of the ring are overwritten so that the most recent data is kept.
     written_frames = sink->write(buffer, frames);
 
 #if LOG_STREAMS_TO_FILES
     if (out->log_fd >= 0) write(out->log_fd, buffer, written_frames * frame_size);
 #endif // LOG_STREAMS_TO_FILES
 
-    if (written_frames < 0) {
-        if (written_frames == (ssize_t)NEGOTIATE) {
-            ALOGE("out_write() write to pipe returned NEGOTIATE");
-
-            pthread_mutex_lock(&rsxadev->lock);
-            sink.clear();
-            pthread_mutex_unlock(&rsxadev->lock);
-
-            written_frames = 0;
-            return 0;
-        } else {
-            // write() returned UNDERRUN or WOULD_BLOCK, retry
-            ALOGE("out_write() write to pipe returned unexpected %zd", written_frames);
-            written_frames = sink->write(buffer, frames);
-        }
-    }
-
     pthread_mutex_lock(&rsxadev->lock);
     sink.clear();
     if (written_frames > 0) {
@@ -961,11 +922,35 @@ static ssize_t out_write(struct audio_stream_out *stream, const void* buffer,
         ALOGE("out_write() failed writing to pipe with %zd", written_frames);
         return 0;
     }
+
+    // the ring does not rate limit the writer any more, consume the period in real time
+    out->clock.pace(written_frames, (int64_t)PACING_MAX_LAG_MS * 1000000);
+
     const ssize_t written_bytes = written_frames * frame_size;
     ALOGD("out_write() wrote %zd bytes %zd frames", written_bytes, written_frames);
     return written_bytes;
 }
 
+// Number of frames written by the output stream and not yet presented at time now.  When an input
+// stream is reading, the frames it consumes in bursts are spread at the nominal rate so that the
+// position advances smoothly instead of one period at a time.
+// Must be called with lock held on the submix_audio_device
+static ssize_t submix_frames_in_pipe_l(const struct submix_audio_device * const rsxadev,
+                                       const struct submix_stream_out * const out,
+                                       const struct timespec * const now)
+{
+    const sp<SubmixRing>& ring = rsxadev->routes[out->route_handle].rsxRing;
+    if (ring == NULL) {
+        return -1;
+    }
+    if (rsxadev->routes[out->route_handle].input == NULL) {
+        return ring->availableToRead();
+    }
+    const uint64_t consumed = ring->consumedPosition(
+            out_get_sample_rate(&out->stream.common), submix_timespec_to_ns(now));
+    return (ssize_t)(ring->framesWritten() - consumed);
+}
+
 static int out_get_presentation_position(const struct audio_stream_out *stream,
                                    uint64_t *frames, struct timespec *timestamp)
 {
@@ -978,9 +963,10 @@ static int out_get_presentation_position(const struct audio_stream_out *stream,
     struct submix_audio_device * const rsxadev = out->dev;
 
     int ret = -EWOULDBLOCK;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
     pthread_mutex_lock(&rsxadev->lock);
-    const ssize_t frames_in_pipe =
-            rsxadev->routes[out->route_handle].rsxSource->availableToRead();
+    const ssize_t frames_in_pipe = submix_frames_in_pipe_l(rsxadev, out, &now);
     if (CC_UNLIKELY(frames_in_pipe < 0)) {
         *frames = out->frames_written;
         ret = 0;
@@ -991,7 +977,7 @@ static int out_get_presentation_position(const struct audio_stream_out *stream,
     pthread_mutex_unlock(&rsxadev->lock);
 
     if (ret == 0) {
-        clock_gettime(CLOCK_MONOTONIC, timestamp);
+        *timestamp = now;
     }
 
     SUBMIX_ALOGV("out_get_presentation_position() got frames=%llu timestamp sec=%ld",
@@ -1011,9 +997,10 @@ static int out_get_render_position(const struct audio_stream_out *stream,
             const_cast<struct audio_stream_out *>(stream));
     struct submix_audio_device * const rsxadev = out->dev;
 
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
     pthread_mutex_lock(&rsxadev->lock);
-    const ssize_t frames_in_pipe =
-            rsxadev->routes[out->route_handle].rsxSource->availableToRead();
+    const ssize_t frames_in_pipe = submix_frames_in_pipe_l(rsxadev, out, &now);
     if (CC_UNLIKELY(frames_in_pipe < 0)) {
         *dsp_frames = (uint32_t)out->frames_written_since_standby;
     } else {
@@ -1249,6 +1236,7 @@ static ssize_t in_read(struct audio_stream_in *stream, void* buffer,
 #endif
             in->read_counter_frames = 0;
         }
+        in->clock.reset(in_get_sample_rate(&stream->common));
     }
 
     in->read_counter_frames += frames_to_read;
@@ -1256,13 +1244,13 @@ static ssize_t in_read(struct audio_stream_in *stream, void* buffer,
 
     {
         // about to read from audio source
-        sp<MonoPipeReader> source = rsxadev->routes[in->route_handle].rsxSource;
+        sp<SubmixRing> source = rsxadev->routes[in->route_handle].rsxRing;
         if (source == NULL) {
             in->read_error_count++;// ok if it rolls over
             ALOGE_IF(in->read_error_count < MAX_READ_ERROR_LOGS,
                     "no audio pipe yet we're trying to read! (not all errors will be logged)");
             pthread_mutex_unlock(&rsxadev->lock);
-            usleep(frames_to_read * 1000000 / in_get_sample_rate(&stream->common));
+            in->clock.pace(frames_to_read, (int64_t)PACING_MAX_LAG_MS * 1000000);
             memset(buffer, 0, bytes);
             return bytes;
         }
@@ -1403,6 +1391,20 @@ static ssize_t in_read(struct audio_stream_in *stream, void* buffer,
                 usleep(READ_ATTEMPT_SLEEP_MS * 1000);
             }
         }
+        // Drift compensation: keep about one period in the ring after each read.  A fuller ring
+        // means the writer runs faster than our clock (latency grows), an emptier one that it
+        // runs slower (underrun ahead), slew the read clock a little towards the target.
+        {
+            const uint32_t pipe_sample_rate = rsxadev->routes[in->route_handle].config
+                    .common.sample_rate;
+            const int64_t fill_error_frames = (int64_t)source->availableToRead() -
+                    (int64_t)rsxadev->routes[in->route_handle].config.buffer_period_size_frames;
+            int64_t slew_ns = fill_error_frames * 1000000000LL / pipe_sample_rate / 8;
+            slew_ns = max(min(slew_ns, (int64_t)DRIFT_SLEW_MAX_US * 1000),
+                          -(int64_t)DRIFT_SLEW_MAX_US * 1000);
+            in->clock.adjust(-slew_ns);
+        }
+
         // done using the source
         pthread_mutex_lock(&rsxadev->lock);
         source.clear();
@@ -1430,52 +1432,24 @@ static ssize_t in_read(struct audio_stream_in *stream, void* buffer,
     //Dump debug data
     dumpPcmData(r_submix_streamin,(void*)buffer,bytes,streamin_propty);
 
-    // compute how much we need to sleep after reading the data by comparing the wall clock with
-    //   the projected time at which we should return.
-    struct timespec time_after_read;// wall clock after reading from the pipe
-    struct timespec record_duration;// observed record duration
-    int rc = clock_gettime(CLOCK_MONOTONIC, &time_after_read);
-    const uint32_t sample_rate = in_get_sample_rate(&stream->common);
-    if (rc == 0) {
-        // for how long have we been recording?
-        record_duration.tv_sec  = time_after_read.tv_sec - in->record_start_time.tv_sec;
-        record_duration.tv_nsec = time_after_read.tv_nsec - in->record_start_time.tv_nsec;
-        if (record_duration.tv_nsec < 0) {
-            record_duration.tv_sec--;
-            record_duration.tv_nsec += 1000000000;
-        }
-
-        // read_counter_frames contains the number of frames that have been read since the
-        // beginning of recording (including this call): it's converted to usec and compared to
-        // how long we've been recording for, which gives us how long we must wait to sync the
-        // projected recording time, and the observed recording time.
-        long projected_vs_observed_offset_us =
-                ((int64_t)(in->read_counter_frames
-                            - (record_duration.tv_sec*sample_rate)))
-                        * 1000000 / sample_rate
-                - (record_duration.tv_nsec / 1000);
-
-        SUBMIX_ALOGV("  record duration %5lds %3ldms, will wait: %7ldus",
-                record_duration.tv_sec, record_duration.tv_nsec/1000000,
-                projected_vs_observed_offset_us);
-        if (projected_vs_observed_offset_us > 0) {
-            usleep(projected_vs_observed_offset_us);
-        }
+    // wait for the absolute time at which this period is due: the projected recording time
+    //   (frames read since the beginning of recording) is compared with CLOCK_MONOTONIC.
+    const int64_t late_ns = in->clock.pace(frames_to_read, (int64_t)PACING_MAX_LAG_MS * 1000000);
 #ifdef MTK_AOSP_ENHANCEMENT
 #ifdef LOST_FRAME_DEBUG
-        else{
-            ALOGD("  record duration %5lds %3ldms, projected_vs_observed_offset_us %7ldus",
-                record_duration.tv_sec, record_duration.tv_nsec/1000000,
-                projected_vs_observed_offset_us);
-        }
-#endif
-        read_count++;
-        if(read_count > 50){
-            read_count = 0;
-            ALOGD("read_frames %lld, T_rec %fs, p_vs_o %7ldus",in->read_counter_frames, (float)in->read_counter_frames / sample_rate, projected_vs_observed_offset_us);
-        }
+    if (late_ns > 0) {
+        ALOGD("  in_read late by %7lldus", (long long)(late_ns / 1000));
+    }
 #endif
+    read_count++;
+    if(read_count > 50){
+        const uint32_t sample_rate = in_get_sample_rate(&stream->common);
+        read_count = 0;
+        ALOGD("read_frames %lld, T_rec %fs, late %7lldus",in->read_counter_frames, (float)in->read_counter_frames / sample_rate, (long long)(late_ns / 1000));
     }
+#else
+    (void)late_ns;
+#endif
 
     ALOGD("in_read returns %zu", bytes);
     return bytes;
@@ -1585,21 +1559,22 @@ static int adev_open_output_stream(struct audio_hw_device *dev,
     out->stream.get_presentation_position = out_get_presentation_position;
 
 #if ENABLE_RESAMPLING
-    // Recreate the pipe with the correct sample rate so that MonoPipe.write() rate limits
-    // writes correctly.
+    // Recreate the pipe with the correct sample rate so that the pipe config matches the
+    // rate the writes are paced at.
     force_pipe_creation = rsxadev->routes[route_idx].config.common.sample_rate
             != config->sample_rate;
 #endif // ENABLE_RESAMPLING
 
     // If the sink has been shutdown or pipe recreation is forced (see above), delete the pipe so
     // that it's recreated.
-    if ((rsxadev->routes[route_idx].rsxSink != NULL
-            && rsxadev->routes[route_idx].rsxSink->isShutdown()) || force_pipe_creation) {
+    if ((rsxadev->routes[route_idx].rsxRing != NULL
+            && rsxadev->routes[route_idx].rsxRing->isShutdown()) || force_pipe_creation) {
         submix_audio_device_release_pipe_l(rsxadev, route_idx);
     }
 
     // Store a pointer to the device from the output stream.
     out->dev = rsxadev;
+    out->clock.reset(config->sample_rate);
     // Initialize the pipe.
     ALOGV("adev_open_output_stream(): about to create pipe at index %d", route_idx);
     submix_audio_device_create_pipe_l(rsxadev, config, DEFAULT_PIPE_SIZE_IN_FRAMES,
@@ -1779,7 +1754,7 @@ static int adev_open_input_stream(struct audio_hw_device *dev,
     in = rsxadev->routes[route_idx].input;
     if (in) {
         in->ref_count++;
-        sp<MonoPipe> sink = rsxadev->routes[route_idx].rsxSink;
+        sp<SubmixRing> sink = rsxadev->routes[route_idx].rsxRing;
         ALOG_ASSERT(sink != NULL);
         // If the sink has been shutdown, delete the pipe.
         if (sink != NULL) {
@@ -1831,6 +1806,7 @@ static int adev_open_input_stream(struct audio_hw_device *dev,
 
     // Initialize the input stream.
     in->read_counter_frames = 0;
+    in->clock.reset(config->sample_rate);
 
     in->input_standby = true;
     if (rsxadev->routes[route_idx].output != NULL) {
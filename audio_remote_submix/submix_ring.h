@@ -0,0 +1,302 @@
+/*
+* Copyright (C) 2014 MediaTek Inc.
+* Modification based on code covered by the mentioned copyright
+* and/or permission notice(s).
+*/
+
+#ifndef ANDROID_SUBMIX_RING_H
+#define ANDROID_SUBMIX_RING_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+
+#include <atomic>
+
+#include <cutils/ashmem.h>
+#include <utils/RefBase.h>
+
+namespace android {
+
+#define SUBMIX_NS_PER_SEC 1000000000LL
+
+static inline int64_t submix_timespec_to_ns(const struct timespec *ts)
+{
+    return (int64_t)ts->tv_sec * SUBMIX_NS_PER_SEC + ts->tv_nsec;
+}
+
+static inline int64_t submix_now_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return submix_timespec_to_ns(&now);
+}
+
+// Single producer / single consumer ring used between the submix output stream (producer) and
+// the submix input stream (consumer).
+//
+// The frames live in an ashmem region, the indices are free running 64 bit counters so that the
+// fill level is always rear - front.  Neither side blocks: when the ring is full the producer
+// drops the oldest frames by advancing front with a CAS, and the consumer commits its read with
+// a CAS as well so that a read racing with such a drop is detected and retried.  This keeps the
+// latency bounded when the consumer stalls instead of blocking the mixer thread.
+class SubmixRing : public RefBase {
+public:
+    SubmixRing(size_t frameCount, size_t frameSize) :
+        mFrameSize(frameSize),
+        mMaxFrames(roundup_pow2(frameCount)),
+        mBuffer(NULL),
+        mBufferBytes(0),
+        mFd(-1),
+        mFront(0),
+        mRear(0),
+        mOverrunFrames(0),
+        mShutdown(false),
+        mReadSeq(0),
+        mReadFront(0),
+        mReadTimeNs(0) {
+        mBufferBytes = mMaxFrames * mFrameSize;
+        mFd = ashmem_create_region("r_submix_ring", mBufferBytes);
+        if (mFd >= 0) {
+            mBuffer = (uint8_t *)mmap(NULL, mBufferBytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+                                      mFd, 0);
+        } else {
+            mBuffer = (uint8_t *)mmap(NULL, mBufferBytes, PROT_READ | PROT_WRITE,
+                                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        }
+        if (mBuffer == MAP_FAILED) {
+            mBuffer = NULL;
+        }
+    }
+
+    bool initCheck() const { return mBuffer != NULL; }
+
+    // ashmem fd backing the frames, -1 when anonymous memory is used.
+    int getFd() const { return mFd; }
+
+    size_t maxFrames() const { return mMaxFrames; }
+    size_t frameSize() const { return mFrameSize; }
+
+    void shutdown(bool newState) { mShutdown.store(newState, std::memory_order_release); }
+    bool isShutdown() const { return mShutdown.load(std::memory_order_acquire); }
+
+    ssize_t availableToRead() const {
+        const uint64_t rear = mRear.load(std::memory_order_acquire);
+        const uint64_t front = mFront.load(std::memory_order_acquire);
+        return (ssize_t)(rear - front);
+    }
+
+    size_t availableToWrite() const { return mMaxFrames - (size_t)availableToRead(); }
+
+    uint64_t framesWritten() const { return mRear.load(std::memory_order_acquire); }
+    uint64_t framesRead() const { return mFront.load(std::memory_order_acquire); }
+    uint64_t overrunFrames() const { return mOverrunFrames.load(std::memory_order_relaxed); }
+
+    // Producer side, never blocks.  Returns the number of frames accepted (always frames).
+    ssize_t write(const void *buffer, size_t frames) {
+        if (mBuffer == NULL) {
+            return -ENOMEM;
+        }
+        const uint8_t *src = (const uint8_t *)buffer;
+        if (frames > mMaxFrames) {
+            // only the newest part can survive anyway
+            const size_t skip = frames - mMaxFrames;
+            src += skip * mFrameSize;
+            mOverrunFrames.fetch_add(skip, std::memory_order_relaxed);
+            frames -= skip;
+        }
+
+        const uint64_t rear = mRear.load(std::memory_order_relaxed);
+        const uint64_t new_front = rear + frames - mMaxFrames; // only valid when rear + frames > size
+        uint64_t front = mFront.load(std::memory_order_acquire);
+        while (rear + frames > front + mMaxFrames) {
+            if (mFront.compare_exchange_weak(front, new_front, std::memory_order_acq_rel)) {
+                mOverrunFrames.fetch_add(new_front - front, std::memory_order_relaxed);
+                break;
+            }
+        }
+
+        copy_in(rear, src, frames);
+        mRear.store(rear + frames, std::memory_order_release);
+        return frames;
+    }
+
+    // Consumer side, never blocks.  Returns the number of frames copied, 0 when empty.
+    ssize_t read(void *buffer, size_t frames) {
+        if (mBuffer == NULL) {
+            return -ENOMEM;
+        }
+        for (;;) {
+            uint64_t front = mFront.load(std::memory_order_acquire);
+            const uint64_t rear = mRear.load(std::memory_order_acquire);
+            const size_t count = (size_t)(rear - front) < frames ? (size_t)(rear - front) : frames;
+            if (count == 0) {
+                return 0;
+            }
+            copy_out(front, (uint8_t *)buffer, count);
+            // the producer moved front while we were copying: the frames may be overwritten
+            if (mFront.compare_exchange_strong(front, front + count,
+                                               std::memory_order_acq_rel)) {
+                publish_read(front + count);
+                return count;
+            }
+        }
+    }
+
+    // Drop frames from the consumer side, ex: to bring the fill level back to its target.
+    size_t discard(size_t frames) {
+        uint64_t front = mFront.load(std::memory_order_acquire);
+        for (;;) {
+            const uint64_t rear = mRear.load(std::memory_order_acquire);
+            const size_t count = (size_t)(rear - front) < frames ? (size_t)(rear - front) : frames;
+            if (count == 0 ||
+                mFront.compare_exchange_weak(front, front + count, std::memory_order_acq_rel)) {
+                return count;
+            }
+        }
+    }
+
+    // Frames consumed by the reader at the current time.  The consumer reads in bursts of one
+    // period, so between two reads the position is extrapolated at the nominal rate from the
+    // last read, and clamped to what has really been written.
+    uint64_t consumedPosition(uint32_t sampleRate, int64_t nowNs) const {
+        uint64_t front;
+        int64_t readTimeNs;
+        uint32_t seq;
+        do {
+            seq = mReadSeq.load(std::memory_order_acquire);
+            front = mReadFront.load(std::memory_order_relaxed);
+            readTimeNs = mReadTimeNs.load(std::memory_order_relaxed);
+        } while ((seq & 1) || seq != mReadSeq.load(std::memory_order_acquire));
+
+        const uint64_t rear = mRear.load(std::memory_order_acquire);
+        if (readTimeNs == 0 || nowNs <= readTimeNs) {
+            return mFront.load(std::memory_order_acquire);
+        }
+        uint64_t position = front + (uint64_t)((nowNs - readTimeNs) * sampleRate / SUBMIX_NS_PER_SEC);
+        if (position > rear) {
+            position = rear;
+        }
+        const uint64_t current_front = mFront.load(std::memory_order_acquire);
+        return position > current_front ? position : current_front;
+    }
+
+protected:
+    virtual ~SubmixRing() {
+        if (mBuffer != NULL) {
+            munmap(mBuffer, mBufferBytes);
+        }
+        if (mFd >= 0) {
+            close(mFd);
+        }
+    }
+
+private:
+    static size_t roundup_pow2(size_t v) {
+        size_t pow2 = 1;
+        while (pow2 < v) {
+            pow2 <<= 1;
+        }
+        return pow2;
+    }
+
+    void copy_in(uint64_t position, const uint8_t *src, size_t frames) {
+        const size_t offset = (size_t)(position & (mMaxFrames - 1));
+        const size_t first = (mMaxFrames - offset) < frames ? (mMaxFrames - offset) : frames;
+        memcpy(mBuffer + offset * mFrameSize, src, first * mFrameSize);
+        if (frames > first) {
+            memcpy(mBuffer, src + first * mFrameSize, (frames - first) * mFrameSize);
+        }
+    }
+
+    void copy_out(uint64_t position, uint8_t *dst, size_t frames) const {
+        const size_t offset = (size_t)(position & (mMaxFrames - 1));
+        const size_t first = (mMaxFrames - offset) < frames ? (mMaxFrames - offset) : frames;
+        memcpy(dst, mBuffer + offset * mFrameSize, first * mFrameSize);
+        if (frames > first) {
+            memcpy(dst + first * mFrameSize, mBuffer, (frames - first) * mFrameSize);
+        }
+    }
+
+    // single writer (the consumer thread), seqlock protected pair for consumedPosition()
+    void publish_read(uint64_t front) {
+        const uint32_t seq = mReadSeq.load(std::memory_order_relaxed);
+        mReadSeq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        mReadFront.store(front, std::memory_order_relaxed);
+        mReadTimeNs.store(submix_now_ns(), std::memory_order_relaxed);
+        mReadSeq.store(seq + 2, std::memory_order_release);
+    }
+
+    const size_t mFrameSize;
+    const size_t mMaxFrames;    // power of 2
+    uint8_t *mBuffer;
+    size_t mBufferBytes;
+    int mFd;
+
+    std::atomic<uint64_t> mFront;   // free running, consumer (or producer on overrun)
+    std::atomic<uint64_t> mRear;    // free running, producer only
+    std::atomic<uint64_t> mOverrunFrames;
+    std::atomic<bool> mShutdown;
+
+    std::atomic<uint32_t> mReadSeq;
+    std::atomic<uint64_t> mReadFront;
+    std::atomic<int64_t> mReadTimeNs;
+};
+
+// Real time pacing of one side of the ring against CLOCK_MONOTONIC.
+//
+// Each call of pace() advances the stream by a number of frames and sleeps until the absolute
+// time at which those frames are due, so that the scheduling error of one period does not
+// accumulate like a relative usleep() does.  When the caller is late by more than maxLagNs (ex:
+// after a stall) the clock is re-anchored instead of bursting to catch up.  adjust() slews the
+// anchor to compensate the drift between the producer and the consumer.
+struct SubmixClock {
+    int64_t anchorNs;
+    uint64_t frames;
+    uint32_t sampleRate;
+    bool started;
+
+    void reset(uint32_t rate) {
+        anchorNs = 0;
+        frames = 0;
+        sampleRate = rate;
+        started = false;
+    }
+
+    // Returns how late the caller was in ns (<= 0 when it had to wait).
+    int64_t pace(size_t count, int64_t maxLagNs) {
+        const int64_t nowNs = submix_now_ns();
+        if (!started) {
+            anchorNs = nowNs;
+            frames = 0;
+            started = true;
+        }
+        frames += count;
+        const int64_t deadlineNs = anchorNs + (int64_t)(frames * SUBMIX_NS_PER_SEC / sampleRate);
+        const int64_t lateNs = nowNs - deadlineNs;
+        if (lateNs < 0) {
+            struct timespec deadline;
+            deadline.tv_sec = deadlineNs / SUBMIX_NS_PER_SEC;
+            deadline.tv_nsec = deadlineNs % SUBMIX_NS_PER_SEC;
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+            }
+        } else if (lateNs > maxLagNs) {
+            anchorNs = nowNs;
+            frames = 0;
+        }
+        return lateNs;
+    }
+
+    void adjust(int64_t ns) {
+        anchorNs += ns;
+    }
+};
+
+}; // namespace android
+
+#endif // ANDROID_SUBMIX_RING_H
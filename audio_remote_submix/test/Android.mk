@@ -0,0 +1,26 @@
+LOCAL_PATH := $(call my-dir)
+
+#
+# remote submix ring latency / jitter test
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    submix_ring_test.cpp
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/..
+
+LOCAL_SHARED_LIBRARIES := \
+    liblog \
+    libcutils \
+    libutils
+
+LOCAL_MODULE := submix_ring_test
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,188 @@
+/*
+ * submix_ring_test: drive the remote submix SubmixRing with a paced writer and
+ * a paced reader (same pacing & drift compensation as audio_hw.cpp) at
+ * different period sizes and report latency, jitter, underrun and overrun.
+ *
+ *  - latency : time between the write of a frame and its read
+ *  - jitter  : standard deviation of the read interval vs the nominal period
+ *
+ * usage: submix_ring_test [duration_ms]
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <submix_ring.h>
+
+using namespace android;
+
+#define SAMPLE_RATE         (48000)
+#define CHANNELS            (2)
+#define RING_FRAMES         (4096)
+#define RING_PERIOD_FRAMES  (RING_FRAMES / 4)
+#define MAX_LAG_NS          (50 * 1000000LL)
+#define DRIFT_SLEW_MAX_NS   (500 * 1000LL)
+#define DEFAULT_DURATION_MS (2000)
+#define MAX_PERIODS         (4096)
+
+
+struct test_config {
+    size_t write_frames;
+    size_t read_frames;
+};
+
+struct test_context {
+    sp<SubmixRing> ring;
+    struct test_config config;
+    uint32_t duration_ms;
+    volatile bool stop;
+
+    int64_t write_time_ns[MAX_PERIODS]; /* time of the write of period n */
+};
+
+
+/* each frame carries its index so the reader can tell when it was written */
+static void fill_period(int16_t *buffer, uint64_t first_frame, size_t frames) {
+    for (size_t i = 0; i < frames; i++) {
+        const uint32_t index = (uint32_t)(first_frame + i);
+        buffer[i * CHANNELS] = (int16_t)(index & 0xFFFF);
+        buffer[i * CHANNELS + 1] = (int16_t)(index >> 16);
+    }
+}
+
+static uint32_t frame_index(const int16_t *frame) {
+    return (uint16_t)frame[0] | ((uint32_t)(uint16_t)frame[1] << 16);
+}
+
+
+static void *writer_thread(void *arg) {
+    struct test_context *ctx = (struct test_context *)arg;
+    const size_t frames = ctx->config.write_frames;
+    int16_t *buffer = new int16_t[frames * CHANNELS];
+    struct SubmixClock clock;
+    uint64_t written = 0;
+    uint32_t period = 0;
+
+    clock.reset(SAMPLE_RATE);
+    while (!ctx->stop) {
+        fill_period(buffer, written, frames);
+        if (period < MAX_PERIODS) {
+            ctx->write_time_ns[period] = submix_now_ns();
+        }
+        ctx->ring->write(buffer, frames);
+        written += frames;
+        period++;
+        clock.pace(frames, MAX_LAG_NS);
+    }
+
+    delete[] buffer;
+    return NULL;
+}
+
+
+static void run_test(const struct test_config *config, const uint32_t duration_ms) {
+    struct test_context *ctx = new test_context();
+    const size_t frames = config->read_frames;
+    int16_t *buffer = new int16_t[frames * CHANNELS];
+    struct SubmixClock clock;
+    pthread_t writer;
+
+    double latency_sum = 0, latency_max = 0;
+    double interval_sum = 0, interval_sq_sum = 0;
+    uint32_t latency_count = 0, interval_count = 0;
+    uint64_t underrun_frames = 0;
+    int64_t last_read_ns = 0;
+
+    ctx->ring = new SubmixRing(RING_FRAMES, CHANNELS * sizeof(int16_t));
+    ctx->config = *config;
+    ctx->duration_ms = duration_ms;
+    ctx->stop = false;
+    pthread_create(&writer, NULL, writer_thread, ctx);
+
+    const uint32_t reads = (uint32_t)((uint64_t)duration_ms * SAMPLE_RATE / 1000 / frames);
+    const double nominal_us = (double)frames * 1000000.0 / SAMPLE_RATE;
+
+    clock.reset(SAMPLE_RATE);
+    for (uint32_t n = 0; n < reads; n++) {
+        const ssize_t got = ctx->ring->read(buffer, frames);
+        const int64_t now_ns = submix_now_ns();
+
+        if (got > 0) {
+            const uint32_t index = frame_index(buffer);
+            const uint32_t period = index / config->write_frames;
+            if (period < MAX_PERIODS && n > 10) { /* skip warm up */
+                const double latency_us = (now_ns - ctx->write_time_ns[period]) / 1000.0 -
+                        (double)(index % config->write_frames) * 1000000.0 / SAMPLE_RATE;
+                latency_sum += latency_us;
+                latency_max = latency_us > latency_max ? latency_us : latency_max;
+                latency_count++;
+            }
+        }
+        if (got < (ssize_t)frames && n > 10) {
+            underrun_frames += frames - (got > 0 ? got : 0);
+        }
+        if (last_read_ns != 0 && n > 10) {
+            const double interval_err_us = (now_ns - last_read_ns) / 1000.0 - nominal_us;
+            interval_sum += interval_err_us;
+            interval_sq_sum += interval_err_us * interval_err_us;
+            interval_count++;
+        }
+        last_read_ns = now_ns;
+
+        /* same drift compensation as in_read() */
+        int64_t slew_ns = ((int64_t)ctx->ring->availableToRead() - RING_PERIOD_FRAMES) *
+                1000000000LL / SAMPLE_RATE / 8;
+        if (slew_ns > DRIFT_SLEW_MAX_NS) {
+            slew_ns = DRIFT_SLEW_MAX_NS;
+        } else if (slew_ns < -DRIFT_SLEW_MAX_NS) {
+            slew_ns = -DRIFT_SLEW_MAX_NS;
+        }
+        clock.adjust(-slew_ns);
+        clock.pace(frames, MAX_LAG_NS);
+    }
+
+    ctx->stop = true;
+    pthread_join(writer, NULL);
+
+    const double mean = interval_count ? interval_sum / interval_count : 0;
+    const double jitter = interval_count ?
+            sqrt(interval_sq_sum / interval_count - mean * mean) : 0;
+    printf("write %5zu read %5zu: latency avg %8.1f us max %8.1f us, jitter %7.1f us, "
+           "underrun %6llu frames, overrun %6llu frames\n",
+           config->write_frames, config->read_frames,
+           latency_count ? latency_sum / latency_count : 0.0, latency_max, jitter,
+           (unsigned long long)underrun_frames,
+           (unsigned long long)ctx->ring->overrunFrames());
+
+    ctx->ring.clear();
+    delete[] buffer;
+    delete ctx;
+}
+
+
+int main(int argc, char **argv) {
+    const struct test_config configs[] = {
+        { 256,  256 },
+        { 480,  1024 },
+        { 1024, 1024 },
+        { 1024, 256 },
+        { 960,  441 },
+    };
+    uint32_t duration_ms = DEFAULT_DURATION_MS;
+
+    if (argc > 1) {
+        duration_ms = (uint32_t)atoi(argv[1]);
+    }
+    if (duration_ms == 0) {
+        duration_ms = DEFAULT_DURATION_MS;
+    }
+
+    for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+        run_test(&configs[i], duration_ms);
+    }
+
+    return 0;
+}
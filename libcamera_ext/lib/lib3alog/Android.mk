@@ -52,7 +52,8 @@ LOCAL_CFLAGS += -DMTKCAM_3A_LOG_DEFAULT=$(MTKCAM_3A_LOG_DEFAULT)
 LOCAL_STATIC_LIBRARIES := \
 
 LOCAL_SRC_FILES:= \
-    aaa_log.cpp
+    aaa_log.cpp \
+    aaa_log_ring.cpp
 
 LOCAL_SHARED_LIBRARIES:= libutils libcutils liblog
 LOCAL_LDLIBS:=-llog
@@ -63,4 +64,25 @@ LOCAL_MODULE:= lib3a.log
 LOCAL_PROPRIETARY_MODULE := true
 LOCAL_MODULE_OWNER := mtk
 
-include $(MTK_SHARED_LIBRARY)
\ No newline at end of file
+include $(MTK_SHARED_LIBRARY)
+
+#
+# 3A log record decoder
+#
+include $(CLEAR_VARS)
+
+LOCAL_CFLAGS += -DMTKCAM_3A_LOG_DEFAULT=$(MTKCAM_3A_LOG_DEFAULT)
+
+LOCAL_SRC_FILES:= \
+    aaa_log_decode.cpp
+
+LOCAL_SHARED_LIBRARIES:= libutils libcutils liblog lib3a.log
+
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE:= aaa_log_decode
+LOCAL_PROPRIETARY_MODULE := true
+LOCAL_MODULE_OWNER := mtk
+
+include $(BUILD_EXECUTABLE)
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
@@ -2,6 +2,7 @@
 #include <string>
 
 bool clog3A::bEn = 0;
+bool clog3A::bRing = 0;
 clog3A::_init clog3A::_initializer;
 
 void blog_print(BLog &blog, const char *tag, const char *fmt, ...)
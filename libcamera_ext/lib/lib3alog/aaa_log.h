@@ -63,6 +63,7 @@ TO REVISE OR REPLACE THE MEDIATEK SOFTWARE AT ISSUE, OR REFUND ANY SOFTWARE LICE
 
 #include "stdlib.h"
 #include "stdio.h"
+#include <stdint.h>
 #include <android/log.h>
 #include <cutils/properties.h>
 //
@@ -107,10 +108,15 @@ using namespace android;
 
 #endif
 
+struct RLogSite;
+void rlog_print(RLogSite *site, const char *fmt, ...);
+int rlog_start(const char *path);
+
 class clog3A
 {
 public:
     static bool bEn;
+    static bool bRing;
 
     static class _init
     {
@@ -120,6 +126,13 @@ public:
             char value[PROPERTY_VALUE_MAX] = {'\0'};
             int itmp = 0;
 
+            property_get("debug.3alog.ring", value, LOG_OFF);          // log through the binary ring
+            if( atoi(value) != 0 )
+            {
+                property_get("debug.3alog.ring.file", value, "");
+                rlog_start(value[0] ? value : NULL);
+            }
+
             property_get("debug.3alog.enable", value, DEFAULT_LOG);    // check property
             itmp = atoi(value);
             __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, " 3alog = %d, default = %s", itmp, DEFAULT_LOG );
@@ -147,8 +160,22 @@ public:
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
-#define MY_LOG(...)          do { if ( (clog3A::bEn) ) { __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__); } }while(0)
-#define MY_LOG_IF(cond, ...) do { if ( (cond) ) { __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__); } }while(0)
+// the ring registers fmt once per call site, only string literals go through
+// it; other formats (a buffer, a variable) go straight to the logger
+#define MY_LOG_RING(fmt, arg...)\
+{\
+    if ( __builtin_constant_p(fmt) )\
+    {\
+        static RLogSite _rlog_site = { fmt, LOG_TAG, ANDROID_LOG_DEBUG, 0 };\
+        rlog_print(&_rlog_site, fmt, ##arg);\
+    }\
+    else\
+    {\
+        __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, fmt, ##arg);\
+    }\
+}
+#define MY_LOG(fmt, arg...)          do { if ( (clog3A::bEn) ) { if ( (clog3A::bRing) ) MY_LOG_RING(fmt, ##arg) else { __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, fmt, ##arg); } } }while(0)
+#define MY_LOG_IF(cond, fmt, arg...) do { if ( (cond) ) { if ( (clog3A::bRing) ) MY_LOG_RING(fmt, ##arg) else { __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, fmt, ##arg); } } }while(0)
 #define MY_ERR(fmt, arg...)  do { __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "[%s()] Err: %5d:, " fmt, __FUNCTION__, __LINE__, ##arg); }while(0)
 #define MY_ASSERT(x, str)\
         if (x) {} \
@@ -192,5 +219,48 @@ void blog_print(BLog &blog, const char *tag, const char *fmt, ...);
 void blog_flush(BLog &blog, const char *tag);
 int blog_isUserLoad();
 
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+// Binary log ring
+//
+// With debug.3alog.ring=1, MY_LOG only stores the format ID and the raw
+// arguments in a lock-free ring; a background thread formats them and prints
+// to logcat, or with debug.3alog.ring.file=<path> writes the records to a
+// file that aaa_log_decode turns back into text. A full ring drops the log
+// instead of waiting. Formats that are not string literals, and formats
+// with %n, %m, %ls, %lc or %L, fall back to __android_log_print.
+// MY_LOG expands in its callers, so the prebuilt lib3a.ae, lib3a.af and
+// lib3a.awb under libcamera_3a/*/bin log through the ring only once they
+// are rebuilt against this header.
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+#define RLOG_RING_SIZE  4096    // records, a power of 2
+#define RLOG_REC_SIZE   128     // bytes per record, the arguments get 104
+#define RLOG_MAX_FMT    2048    // formats that can be registered
+#define RLOG_MAX_ARGS   24      // arguments of a format, * widths included
+#define RLOG_DRAIN_MS   5       // drain period of the background thread, a half full ring wakes it
+
+// one per MY_LOG call, registered on its first call; the registry keeps
+// copies of fmt and tag, so records queued by a library outlive its dlclose
+struct RLogSite
+{
+    const char*     fmt;
+    const char*     tag;
+    int32_t         level;
+    int32_t         id;         // 0 before the first call, -1 if not recordable
+};
+
+// start the drain thread, path NULL for logcat, else the binary record file;
+// returns -1 if the file can not be opened (the ring prints to logcat then)
+// or the thread can not be started
+int rlog_start(const char *path);
+// stop the drain thread after the ring is drained
+void rlog_stop();
+// drain the ring now, returns the number of records written
+int rlog_flush();
+// logs dropped on a full ring since the first rlog_start
+uint32_t rlog_dropped();
+// write the records of a binary record file as text, returns the number of
+// records or -1 if in is not a record file
+int rlog_decode(FILE *in, FILE *out);
+
 
 #endif // _AAA_LOG_H_
@@ -0,0 +1,25 @@
+#include <aaa_log.h>
+
+// usage: aaa_log_decode <record file from debug.3alog.ring.file> [text file]
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <record file> [text file]\n", argv[0]);
+        return 1;
+    }
+    FILE *in = fopen(argv[1], "rb");
+    FILE *out = (argc > 2) ? fopen(argv[2], "w") : stdout;
+    if (in == NULL || out == NULL)
+    {
+        fprintf(stderr, "can not open %s\n", (in == NULL) ? argv[1] : argv[2]);
+        return 1;
+    }
+    int n = rlog_decode(in, out);
+    if (n < 0)
+        fprintf(stderr, "%s is not a 3A log record file\n", argv[1]);
+    fclose(in);
+    if (out != stdout)
+        fclose(out);
+    return (n < 0) ? 1 : 0;
+}
@@ -0,0 +1,642 @@
+#include <aaa_log.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+// Argument kinds, stored with the size of their C type, strings as a length
+// byte and the characters
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+enum
+{
+    RLOG_ARG_INT,
+    RLOG_ARG_LONG,
+    RLOG_ARG_LLONG,
+    RLOG_ARG_SIZE,
+    RLOG_ARG_PTRDIFF,
+    RLOG_ARG_INTMAX,
+    RLOG_ARG_PTR,
+    RLOG_ARG_DOUBLE,
+    RLOG_ARG_STR,
+};
+
+static const uint8_t gArgSize[] =
+{
+    sizeof(int), sizeof(long), sizeof(long long), sizeof(size_t),
+    sizeof(ptrdiff_t), sizeof(intmax_t), sizeof(void *), sizeof(double), 1,
+};
+
+struct RLogSlot
+{
+    uint32_t        seq;        // ring position this slot is free or full for
+    uint16_t        id;
+    uint16_t        len;
+    int32_t         tid;
+    uint32_t        reserved;
+    int64_t         time;       // CLOCK_MONOTONIC in ns
+    uint8_t         data[RLOG_REC_SIZE - 24];
+};
+
+struct RLogFmt     // copies of the site strings, valid after its library is unloaded
+{
+    char*           fmt;
+    char*           tag;
+    int32_t         level;
+    uint8_t         num;
+    uint8_t         kinds[RLOG_MAX_ARGS];
+    uint16_t        fixed;      // bytes of the arguments besides string characters
+};
+
+#define RLOG_DATA_SIZE  ((int)sizeof(((RLogSlot *)0)->data))
+#define RLOG_FILE_MAGIC "3ALOGRB1"
+
+static RLogSlot         gRing[RLOG_RING_SIZE];
+static uint32_t         gHead __attribute__((aligned(64)));     // claimed by producers
+static uint32_t         gTail __attribute__((aligned(64)));     // drained, under gDrainLock, read by producers
+static uint32_t         gDropped;
+static uint32_t         gWake;                                  // futex the drain thread sleeps on
+static uint32_t         gDrainIdle;                             // the drain thread sleeps, or is about to
+static RLogFmt          gFmt[RLOG_MAX_FMT];                     // index 0 unused
+static uint32_t         gFmtNum;
+static uint8_t          gFmtWritten[RLOG_MAX_FMT];              // formats already in gFile
+static bool             gRingInit = false;
+static bool             gStop = false;
+static pthread_t        gThread;
+static FILE*            gFile = NULL;
+static uint32_t         gDroppedReported;
+static pthread_mutex_t  gDrainLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t  gStartLock = PTHREAD_MUTEX_INITIALIZER;
+static __thread int32_t tTid;
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+// Format parsing, shared by the recording and the decoding side
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// parse the conversion at p ('%'), append its argument kinds; returns the
+// character after it, or NULL if it can not be recorded
+static const char *rlog_spec(const char *p, uint8_t *kinds, int *num)
+{
+    int lenMod = 0;     // 'h' 'H'(hh) 'l' 'q'(ll) 'z' 't' 'j' 'L'
+
+    p++;
+    if (*p == '%')
+        return p + 1;
+    while (*p && strchr("-+ #0'", *p))
+        p++;
+    if (*p == '*')
+    {
+        kinds[(*num)++] = RLOG_ARG_INT;
+        p++;
+    }
+    while (*p >= '0' && *p <= '9')
+        p++;
+    if (*p == '.')
+    {
+        p++;
+        if (*p == '*')
+        {
+            kinds[(*num)++] = RLOG_ARG_INT;
+            p++;
+        }
+        while (*p >= '0' && *p <= '9')
+            p++;
+    }
+    switch (*p)
+    {
+    case 'h': lenMod = (p[1] == 'h') ? 'H' : 'h'; p += (p[1] == 'h') ? 2 : 1; break;
+    case 'l': lenMod = (p[1] == 'l') ? 'q' : 'l'; p += (p[1] == 'l') ? 2 : 1; break;
+    case 'q': case 'z': case 't': case 'j': case 'L': lenMod = *p++; break;
+    default: break;
+    }
+
+    uint8_t kind;
+    switch (*p)
+    {
+    case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+        switch (lenMod)
+        {
+        case 0: case 'h': case 'H': kind = RLOG_ARG_INT; break;
+        case 'l': kind = RLOG_ARG_LONG; break;
+        case 'q': kind = RLOG_ARG_LLONG; break;
+        case 'z': kind = RLOG_ARG_SIZE; break;
+        case 't': kind = RLOG_ARG_PTRDIFF; break;
+        case 'j': kind = RLOG_ARG_INTMAX; break;
+        default: return NULL;
+        }
+        break;
+    case 'c':
+        if (lenMod != 0)
+            return NULL;
+        kind = RLOG_ARG_INT;
+        break;
+    case 'p':
+        if (lenMod != 0)
+            return NULL;
+        kind = RLOG_ARG_PTR;
+        break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        if (lenMod != 0 && lenMod != 'l')
+            return NULL;
+        kind = RLOG_ARG_DOUBLE;
+        break;
+    case 's':
+        if (lenMod != 0)
+            return NULL;
+        kind = RLOG_ARG_STR;
+        break;
+    default:    // %n, %m, or not a conversion
+        return NULL;
+    }
+    kinds[(*num)++] = kind;
+    return p + 1;
+}
+
+// argument kinds of fmt, returns the count or -1 if fmt can not be recorded
+static int rlog_parse(const char *fmt, uint8_t *kinds)
+{
+    uint8_t spec[3];
+    int num = 0;
+
+    for (const char *p = fmt; *p; )
+    {
+        if (*p != '%')
+        {
+            p++;
+            continue;
+        }
+        int n = 0;
+        p = rlog_spec(p, spec, &n);
+        if (p == NULL || num + n > RLOG_MAX_ARGS)
+            return -1;
+        memcpy(kinds + num, spec, n);
+        num += n;
+    }
+    return num;
+}
+
+// format fmt with the recorded arguments, one snprintf per conversion
+static void rlog_format(char *out, size_t size, const char *fmt, const uint8_t *data, int len)
+{
+    size_t o = 0;
+    const uint8_t *end = data + len;
+
+    out[0] = '\0';
+    for (const char *p = fmt; *p && o + 1 < size; )
+    {
+        if (*p != '%')
+        {
+            out[o++] = *p++;
+            out[o] = '\0';
+            continue;
+        }
+        uint8_t kinds[3];
+        int num = 0;
+        const char *q = rlog_spec(p, kinds, &num);
+        char spec[32];
+        if (q == NULL || q - p >= (int)sizeof(spec))
+            return;
+        memcpy(spec, p, q - p);
+        spec[q - p] = '\0';
+        p = q;
+        if (num == 0)       // %%
+        {
+            out[o++] = '%';
+            out[o] = '\0';
+            continue;
+        }
+
+        int star[2] = { 0, 0 };
+        for (int i = 0; i < num - 1; i++)
+        {
+            if (data + sizeof(int) > end)
+                return;
+            memcpy(&star[i], data, sizeof(int));
+            data += sizeof(int);
+        }
+
+        union
+        {
+            int i; long l; long long ll; size_t z; ptrdiff_t t; intmax_t j; void *p; double d;
+        } v;
+        char str[256];
+        uint8_t kind = kinds[num - 1];
+        if (kind == RLOG_ARG_STR)
+        {
+            if (data + 1 > end || data + 1 + data[0] > end)
+                return;
+            memcpy(str, data + 1, data[0]);
+            str[data[0]] = '\0';
+            data += 1 + data[0];
+        }
+        else
+        {
+            if (data + gArgSize[kind] > end)
+                return;
+            memcpy(&v, data, gArgSize[kind]);
+            data += gArgSize[kind];
+        }
+
+        char *dst = out + o;
+        size_t room = size - o;
+        int r = 0;
+#define RLOG_PUT(val)   ((num == 1) ? snprintf(dst, room, spec, val) :\
+                         (num == 2) ? snprintf(dst, room, spec, star[0], val) :\
+                                      snprintf(dst, room, spec, star[0], star[1], val))
+        switch (kind)
+        {
+        case RLOG_ARG_INT:      r = RLOG_PUT(v.i); break;
+        case RLOG_ARG_LONG:     r = RLOG_PUT(v.l); break;
+        case RLOG_ARG_LLONG:    r = RLOG_PUT(v.ll); break;
+        case RLOG_ARG_SIZE:     r = RLOG_PUT(v.z); break;
+        case RLOG_ARG_PTRDIFF:  r = RLOG_PUT(v.t); break;
+        case RLOG_ARG_INTMAX:   r = RLOG_PUT(v.j); break;
+        case RLOG_ARG_PTR:      r = RLOG_PUT(v.p); break;
+        case RLOG_ARG_DOUBLE:   r = RLOG_PUT(v.d); break;
+        default:                r = RLOG_PUT(str); break;
+        }
+#undef RLOG_PUT
+        if (r < 0)
+            return;
+        o += ((size_t)r < room) ? (size_t)r : room - 1;
+    }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+// Recording
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+static int32_t rlog_register(RLogSite *site)
+{
+    uint8_t kinds[RLOG_MAX_ARGS];
+    int32_t id = -1;
+    int num = rlog_parse(site->fmt, kinds);
+    int fixed = 0;
+
+    for (int i = 0; i < num; i++)
+        fixed += gArgSize[kinds[i]];
+    if (num >= 0 && fixed <= RLOG_DATA_SIZE)
+    {
+        uint32_t n = __atomic_add_fetch(&gFmtNum, 1, __ATOMIC_RELAXED);
+        if (n < RLOG_MAX_FMT)
+        {
+            RLogFmt &f = gFmt[n];
+            f.fmt = strdup(site->fmt);
+            f.tag = strdup(site->tag);
+            f.level = site->level;
+            f.num = (uint8_t)num;
+            memcpy(f.kinds, kinds, num);
+            f.fixed = (uint16_t)fixed;
+            if (f.fmt != NULL && f.tag != NULL)
+                id = (int32_t)n;
+        }
+    }
+
+    // another thread may have registered the site meanwhile, keep its ID
+    int32_t expected = 0;
+    if (!__atomic_compare_exchange_n(&site->id, &expected, id, false, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE))
+        id = expected;
+    return id;
+}
+
+static void rlog_wake()
+{
+    __atomic_add_fetch(&gWake, 1, __ATOMIC_RELEASE);
+    syscall(__NR_futex, &gWake, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+// wake the drain thread if it sleeps, one producer does the syscall; a wake
+// lost to a race costs at most one drain period
+static inline void rlog_kick()
+{
+    if (__atomic_load_n(&gDrainIdle, __ATOMIC_SEQ_CST) && __atomic_exchange_n(&gDrainIdle, 0, __ATOMIC_ACQ_REL))
+        rlog_wake();
+}
+
+void rlog_print(RLogSite *site, const char *fmt, ...)
+{
+    va_list ap;
+    int32_t id = __atomic_load_n(&site->id, __ATOMIC_ACQUIRE);
+
+    if (id == 0)
+        id = rlog_register(site);
+    if (id < 0)
+    {
+        va_start(ap, fmt);
+        __android_log_vprint(site->level, site->tag, fmt, ap);
+        va_end(ap);
+        return;
+    }
+
+    // claim a slot, a full ring drops the log
+    RLogSlot *slot;
+    uint32_t pos = __atomic_load_n(&gHead, __ATOMIC_RELAXED);
+    for (;;)
+    {
+        slot = &gRing[pos & (RLOG_RING_SIZE - 1)];
+        int32_t dif = (int32_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+        if (dif == 0)
+        {
+            if (__atomic_compare_exchange_n(&gHead, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if (dif < 0)
+        {
+            __atomic_add_fetch(&gDropped, 1, __ATOMIC_RELAXED);
+            rlog_kick();
+            return;
+        }
+        else
+        {
+            pos = __atomic_load_n(&gHead, __ATOMIC_RELAXED);
+        }
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    if (tTid == 0)
+        tTid = (int32_t)syscall(__NR_gettid);
+    slot->id = (uint16_t)id;
+    slot->tid = tTid;
+    slot->time = (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+    // strings share what the other arguments leave, in order
+    const RLogFmt &f = gFmt[id];
+    uint8_t *data = slot->data;
+    int strRoom = RLOG_DATA_SIZE - f.fixed;
+    va_start(ap, fmt);
+    for (int i = 0; i < f.num; i++)
+    {
+        switch (f.kinds[i])
+        {
+#define RLOG_ARG(kind, type) case kind: { type v = va_arg(ap, type); memcpy(data, &v, sizeof(v)); data += sizeof(v); break; }
+        RLOG_ARG(RLOG_ARG_INT, int)
+        RLOG_ARG(RLOG_ARG_LONG, long)
+        RLOG_ARG(RLOG_ARG_LLONG, long long)
+        RLOG_ARG(RLOG_ARG_SIZE, size_t)
+        RLOG_ARG(RLOG_ARG_PTRDIFF, ptrdiff_t)
+        RLOG_ARG(RLOG_ARG_INTMAX, intmax_t)
+        RLOG_ARG(RLOG_ARG_PTR, void *)
+        RLOG_ARG(RLOG_ARG_DOUBLE, double)
+#undef RLOG_ARG
+        default:
+        {
+            const char *s = va_arg(ap, const char *);
+            if (s == NULL)
+                s = "(null)";
+            size_t n = strnlen(s, strRoom < 255 ? strRoom : 255);
+            data[0] = (uint8_t)n;
+            memcpy(data + 1, s, n);
+            data += 1 + n;
+            strRoom -= (int)n;
+            break;
+        }
+        }
+    }
+    va_end(ap);
+    slot->len = (uint16_t)(data - slot->data);
+
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+    // half full, the drain thread should not sleep out its period
+    if (pos + 1 - __atomic_load_n(&gTail, __ATOMIC_RELAXED) >= RLOG_RING_SIZE / 2)
+        rlog_kick();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+// Draining
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+static void rlog_write(const RLogSlot &rec)
+{
+    const RLogFmt *f = &gFmt[rec.id];
+
+    if (gFile == NULL)
+    {
+        char text[1024];
+        rlog_format(text, sizeof(text), f->fmt, rec.data, rec.len);
+        __android_log_print(f->level, f->tag, "[%5lld.%06lld] %s",
+            (long long)(rec.time / 1000000000), (long long)(rec.time % 1000000000 / 1000), text);
+        return;
+    }
+
+    if (!gFmtWritten[rec.id])
+    {
+        uint8_t tagLen = (uint8_t)strnlen(f->tag, 255);
+        uint16_t fmtLen = (uint16_t)strnlen(f->fmt, 65535);
+        fputc('F', gFile);
+        fwrite(&rec.id, sizeof(rec.id), 1, gFile);
+        fwrite(&f->level, sizeof(f->level), 1, gFile);
+        fwrite(&tagLen, 1, 1, gFile);
+        fwrite(f->tag, 1, tagLen, gFile);
+        fwrite(&fmtLen, sizeof(fmtLen), 1, gFile);
+        fwrite(f->fmt, 1, fmtLen, gFile);
+        gFmtWritten[rec.id] = 1;
+    }
+    fputc('R', gFile);
+    fwrite(&rec.id, sizeof(rec.id), 1, gFile);
+    fwrite(&rec.tid, sizeof(rec.tid), 1, gFile);
+    fwrite(&rec.time, sizeof(rec.time), 1, gFile);
+    fwrite(&rec.len, sizeof(rec.len), 1, gFile);
+    fwrite(rec.data, 1, rec.len, gFile);
+}
+
+int rlog_flush()
+{
+    int n = 0;
+
+    pthread_mutex_lock(&gDrainLock);
+    for (;;)
+    {
+        RLogSlot *slot = &gRing[gTail & (RLOG_RING_SIZE - 1)];
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != gTail + 1)
+            break;
+        RLogSlot rec;
+        memcpy(&rec, slot, offsetof(RLogSlot, data) + slot->len);
+        __atomic_store_n(&slot->seq, gTail + RLOG_RING_SIZE, __ATOMIC_RELEASE);
+        __atomic_store_n(&gTail, gTail + 1, __ATOMIC_RELAXED);
+        rlog_write(rec);
+        n++;
+    }
+
+    uint32_t dropped = __atomic_load_n(&gDropped, __ATOMIC_RELAXED);
+    if (dropped != gDroppedReported)
+    {
+        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "3A log ring full, %u logs dropped", dropped - gDroppedReported);
+        gDroppedReported = dropped;
+    }
+    if (gFile != NULL && n != 0)
+        fflush(gFile);
+    pthread_mutex_unlock(&gDrainLock);
+    return n;
+}
+
+// logs of the last drain period at process exit
+static void rlog_exit()
+{
+    rlog_flush();
+}
+
+static void *rlog_thread(void *)
+{
+    while (!__atomic_load_n(&gStop, __ATOMIC_ACQUIRE))
+    {
+        if (rlog_flush() != 0)
+            continue;
+        // sleep a drain period, or until a producer finds the ring half full
+        uint32_t wake = __atomic_load_n(&gWake, __ATOMIC_ACQUIRE);
+        __atomic_store_n(&gDrainIdle, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&gHead, __ATOMIC_SEQ_CST) - __atomic_load_n(&gTail, __ATOMIC_RELAXED) < RLOG_RING_SIZE / 2 &&
+            !__atomic_load_n(&gStop, __ATOMIC_ACQUIRE))
+        {
+            struct timespec ts = { 0, RLOG_DRAIN_MS * 1000000L };
+            syscall(__NR_futex, &gWake, FUTEX_WAIT_PRIVATE, wake, &ts, NULL, 0);
+        }
+        __atomic_store_n(&gDrainIdle, 0, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+int rlog_start(const char *path)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&gStartLock);
+    if (clog3A::bRing)
+    {
+        pthread_mutex_unlock(&gStartLock);
+        return 0;
+    }
+    // the ring is set up once, logs still in flight from a previous start stay valid
+    if (!gRingInit)
+    {
+        for (uint32_t i = 0; i < RLOG_RING_SIZE; i++)
+            gRing[i].seq = i;
+        gRingInit = true;
+        atexit(rlog_exit);
+    }
+
+    pthread_mutex_lock(&gDrainLock);
+    gFile = NULL;
+    if (path != NULL)
+    {
+        gFile = fopen(path, "wb");
+        if (gFile == NULL)
+        {
+            __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "3A log ring can not open %s, using logcat", path);
+            ret = -1;
+        }
+        else
+            fwrite(RLOG_FILE_MAGIC, 1, 8, gFile);
+    }
+    memset(gFmtWritten, 0, sizeof(gFmtWritten));
+    pthread_mutex_unlock(&gDrainLock);
+
+    gStop = false;
+    if (pthread_create(&gThread, NULL, rlog_thread, NULL) != 0)
+    {
+        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "3A log ring thread not started");
+        if (gFile != NULL)
+            fclose(gFile);
+        gFile = NULL;
+        pthread_mutex_unlock(&gStartLock);
+        return -1;
+    }
+    __atomic_store_n(&clog3A::bRing, true, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&gStartLock);
+    return ret;
+}
+
+void rlog_stop()
+{
+    pthread_mutex_lock(&gStartLock);
+    if (clog3A::bRing)
+    {
+        __atomic_store_n(&clog3A::bRing, false, __ATOMIC_RELEASE);
+        __atomic_store_n(&gStop, true, __ATOMIC_RELEASE);
+        rlog_wake();
+        pthread_join(gThread, NULL);
+        rlog_flush();
+        pthread_mutex_lock(&gDrainLock);
+        if (gFile != NULL)
+            fclose(gFile);
+        gFile = NULL;
+        pthread_mutex_unlock(&gDrainLock);
+    }
+    pthread_mutex_unlock(&gStartLock);
+}
+
+uint32_t rlog_dropped()
+{
+    return __atomic_load_n(&gDropped, __ATOMIC_RELAXED);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+// Decoding
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+int rlog_decode(FILE *in, FILE *out)
+{
+    static const char levels[] = "??VDIWEF";
+    char magic[8];
+    char *tags[RLOG_MAX_FMT] = { NULL };
+    char *fmts[RLOG_MAX_FMT] = { NULL };
+    int32_t lvls[RLOG_MAX_FMT] = { 0 };
+    int n = 0;
+
+    if (fread(magic, 1, 8, in) != 8 || memcmp(magic, RLOG_FILE_MAGIC, 8) != 0)
+        return -1;
+
+    for (int type; (type = fgetc(in)) != EOF; )
+    {
+        uint16_t id;
+        if (fread(&id, sizeof(id), 1, in) != 1 || id >= RLOG_MAX_FMT)
+            break;
+        if (type == 'F')
+        {
+            uint8_t tagLen;
+            uint16_t fmtLen;
+            free(tags[id]);
+            free(fmts[id]);
+            tags[id] = fmts[id] = NULL;
+            if (fread(&lvls[id], sizeof(lvls[id]), 1, in) != 1 || fread(&tagLen, 1, 1, in) != 1)
+                break;
+            tags[id] = (char *)calloc(tagLen + 1, 1);
+            if (fread(tags[id], 1, tagLen, in) != tagLen || fread(&fmtLen, sizeof(fmtLen), 1, in) != 1)
+                break;
+            fmts[id] = (char *)calloc(fmtLen + 1, 1);
+            if (fread(fmts[id], 1, fmtLen, in) != fmtLen)
+                break;
+        }
+        else if (type == 'R')
+        {
+            RLogSlot rec;
+            if (fread(&rec.tid, sizeof(rec.tid), 1, in) != 1 || fread(&rec.time, sizeof(rec.time), 1, in) != 1 ||
+                fread(&rec.len, sizeof(rec.len), 1, in) != 1 || rec.len > RLOG_DATA_SIZE ||
+                fread(rec.data, 1, rec.len, in) != rec.len)
+                break;
+            char text[1024];
+            if (fmts[id] != NULL)
+                rlog_format(text, sizeof(text), fmts[id], rec.data, rec.len);
+            else
+                snprintf(text, sizeof(text), "<format %d missing>", id);
+            fprintf(out, "%5lld.%06lld %5d %c %s: %s\n",
+                (long long)(rec.time / 1000000000), (long long)(rec.time % 1000000000 / 1000), rec.tid,
+                levels[(lvls[id] >= 0 && lvls[id] < 8) ? lvls[id] : 0], tags[id] ? tags[id] : "?", text);
+            n++;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    for (int i = 0; i < RLOG_MAX_FMT; i++)
+    {
+        free(tags[i]);
+        free(fmts[i]);
+    }
+    return n;
+}
@@ -0,0 +1,286 @@
+/*
+ * Test and benchmark of the 3A log ring
+ *
+ *  - MY_LOG through the ring and rlog_decode give the text of snprintf,
+ *    for every argument kind, * widths and long strings
+ *  - formats that can not be recorded, or are not literals, go straight
+ *    to the logger
+ *  - logs of several threads all arrive, in order per thread, or are
+ *    counted as dropped
+ *  - cost of a MY_LOG call, direct and through the ring, and the logs
+ *    dropped for bursts of half a ring every millisecond, faster than the
+ *    drain period (scheduling dependent, not checked)
+ *
+ * usage: aaa_log_test [work dir]
+ */
+#define LOG_TAG "aaa_log_test"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "aaa_log.h"
+
+static int g_fail = 0;
+
+#define CHECK(cond, ...)                \
+    do {                                \
+        if (!(cond)) {                  \
+            printf("FAIL: " __VA_ARGS__); \
+            printf("\n");               \
+            g_fail++;                   \
+        }                               \
+    } while (0)
+
+static std::string g_dir = "/data/local/tmp";
+
+static double nowMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// decode a record file, the text after "tag: " of each line
+static std::vector<std::string> decode(const std::string &path)
+{
+    std::vector<std::string> lines;
+    FILE *in = fopen(path.c_str(), "rb");
+    FILE *out = tmpfile();
+    if (in == NULL || out == NULL)
+        return lines;
+    int n = rlog_decode(in, out);
+    rewind(out);
+    char line[2048];
+    while (fgets(line, sizeof(line), out))
+    {
+        line[strcspn(line, "\n")] = '\0';
+        const char *text = strstr(line, LOG_TAG ": ");
+        lines.push_back(text ? text + strlen(LOG_TAG ": ") : line);
+    }
+    CHECK(n == (int)lines.size(), "rlog_decode returned %d for %d lines", n, (int)lines.size());
+    fclose(in);
+    fclose(out);
+    return lines;
+}
+
+static void testFormat()
+{
+    std::string path = g_dir + "/aaa_log_test.bin";
+    std::vector<std::string> expect;
+    char buf[1024];
+    std::string big(300, 'x');
+    int v = -42;
+    long long ll = -1234567890123LL;
+    size_t z = 4000000000u;
+    double d = 3.14159265;
+    void *p = &v;
+
+#define LOG_AND_EXPECT(fmt, arg...)\
+    do { MY_LOG(fmt, ##arg); snprintf(buf, sizeof(buf), fmt, ##arg); expect.push_back(buf); } while (0)
+
+    int ret = rlog_start(path.c_str());
+    CHECK(ret == 0, "rlog_start can not open %s, give a writable work dir", path.c_str());
+    if (ret != 0)
+    {
+        rlog_stop();
+        return;
+    }
+    CHECK(clog3A::bRing, "ring not started");
+    LOG_AND_EXPECT("no argument");
+    LOG_AND_EXPECT("100%% done");
+    LOG_AND_EXPECT("[%s] idx %d, %u, 0x%08x, %c", "ae", v, 7u, 0xbeefu, 'k');
+    LOG_AND_EXPECT("ll %lld %llu l %ld z %zu hh %hhd h %hd", ll, (unsigned long long)ll, -5L, z, 300, 70000);
+    LOG_AND_EXPECT("d %f %.3e %8.2g %-9.1f| p %p", d, d, d, -d, p);
+    LOG_AND_EXPECT("star %*d|%-*.*f|%.*s", 6, v, 10, 2, d, 3, "abcdef");
+    MY_LOG("null %s", (const char *)NULL);
+    expect.push_back("null (null)");
+    LOG_AND_EXPECT("%d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d",
+        1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20);
+    MY_LOG_IF(1, "if %d", 1);
+    expect.push_back("if 1");
+    MY_LOG_IF(0, "if %d", 0);
+    // formats that are not literals go to the logger, not the ring
+    char dyn[32];
+    snprintf(dyn, sizeof(dyn), "dynamic %s", "%d");
+    std::string str = dyn;
+    MY_LOG(dyn, 1);
+    MY_LOG_IF(1, str.c_str(), 2);
+    // the string gets what the arguments leave of the record
+    MY_LOG("big %s %d", big.c_str(), 5);
+    rlog_stop();
+    CHECK(!clog3A::bRing, "ring not stopped");
+
+    std::vector<std::string> lines = decode(path);
+    CHECK(lines.size() == expect.size() + 1, "%d lines decoded, %d logged", (int)lines.size(), (int)expect.size() + 1);
+    for (size_t i = 0; i < expect.size() && i < lines.size(); i++)
+    {
+        // the time prefix is only on logcat lines
+        CHECK(lines[i] == expect[i], "line %d: \"%s\" != \"%s\"", (int)i, lines[i].c_str(), expect[i].c_str());
+    }
+    if (lines.size() == expect.size() + 1)
+    {
+        const std::string &last = lines.back();
+        CHECK(last.compare(0, 8, "big xxxx") == 0 && last.size() > 90 && last.size() < 110 &&
+              last.compare(last.size() - 2, 2, " 5") == 0, "long string: \"%s\"", last.c_str());
+    }
+    remove(path.c_str());
+}
+
+static void testFallback()
+{
+    RLogSite ld = { "%Lf", LOG_TAG, ANDROID_LOG_DEBUG, 0 };
+    RLogSite many = { "%f %f %f %f %f %f %f %f %f %f %f %f %f %f", LOG_TAG, ANDROID_LOG_DEBUG, 0 };
+
+    rlog_print(&ld, ld.fmt, (long double)1.0);
+    CHECK(ld.id == -1, "%%Lf recorded");
+    rlog_print(&many, many.fmt, 1., 2., 3., 4., 5., 6., 7., 8., 9., 10., 11., 12., 13., 14.);
+    CHECK(many.id == -1, "14 doubles recorded in %d bytes", RLOG_REC_SIZE);
+    RLogSite ok = { "%d", LOG_TAG, ANDROID_LOG_DEBUG, 0 };
+    rlog_print(&ok, ok.fmt, 1);
+    CHECK(ok.id > 0, "%%d not recorded");
+    rlog_flush();
+}
+
+/*
+ * threads
+ */
+
+static const int THREADS = 4;
+static const int LOGS = 50000;
+static const int BURST = RLOG_RING_SIZE / 2 / THREADS; // per thread and frame
+
+struct LogThreadArg
+{
+    int t;
+    bool paced;     // bursts of BURST logs every millisecond
+};
+
+static void *logThread(void *arg)
+{
+    const LogThreadArg *a = (const LogThreadArg *)arg;
+    for (int i = 0; i < LOGS; i++)
+    {
+        MY_LOG("thread %d log %d", a->t, i);
+        if (a->paced && i % BURST == BURST - 1)
+            usleep(1000);
+    }
+    return NULL;
+}
+
+// THREADS x LOGS logs into a record file, each decoded in order or counted
+// as dropped; returns the dropped count, -1 if the file can not be opened
+static int runThreads(bool paced)
+{
+    std::string path = g_dir + "/aaa_log_test_mt.bin";
+    pthread_t th[THREADS];
+    LogThreadArg args[THREADS];
+    uint32_t dropped = rlog_dropped();
+
+    int ret = rlog_start(path.c_str());
+    CHECK(ret == 0, "rlog_start can not open %s, give a writable work dir", path.c_str());
+    if (ret != 0)
+    {
+        rlog_stop();
+        return -1;
+    }
+    for (int t = 0; t < THREADS; t++)
+    {
+        args[t].t = t;
+        args[t].paced = paced;
+        pthread_create(&th[t], NULL, logThread, &args[t]);
+    }
+    for (int t = 0; t < THREADS; t++)
+        pthread_join(th[t], NULL);
+    rlog_stop();
+    dropped = rlog_dropped() - dropped;
+
+    std::vector<std::string> lines = decode(path);
+    int last[THREADS], disorder = 0;
+    for (int t = 0; t < THREADS; t++)
+        last[t] = -1;
+    for (size_t i = 0; i < lines.size(); i++)
+    {
+        int t, k;
+        if (sscanf(lines[i].c_str(), "thread %d log %d", &t, &k) != 2 || t < 0 || t >= THREADS)
+        {
+            disorder++;
+            continue;
+        }
+        disorder += k <= last[t];
+        last[t] = k;
+    }
+    CHECK(disorder == 0, "%d lines out of order or broken", disorder);
+    CHECK(lines.size() + dropped == (size_t)THREADS * LOGS, "%d decoded + %u dropped != %d",
+          (int)lines.size(), dropped, THREADS * LOGS);
+    remove(path.c_str());
+    return (int)dropped;
+}
+
+static void testThreads()
+{
+    int dropped = runThreads(false);
+    if (dropped >= 0)
+        printf("%d threads x %d logs back to back: %d dropped on a full ring\n", THREADS, LOGS, dropped);
+}
+
+/*
+ * benchmark
+ */
+
+static double timeCalls(int calls)
+{
+    double t0 = nowMs();
+    for (int i = 0; i < calls; i++)
+        MY_LOG("AE idx %d exp %d gain %d iso %d lv %d ratio %.3f [%s]", i, 10000 + i, 1024, 100, 85, 0.5 * i, "preview");
+    return (nowMs() - t0) * 1e6 / calls;
+}
+
+static void benchmark()
+{
+    const int burst = RLOG_RING_SIZE / 2, rounds = 20;
+    double direct = 0, ring = 0, drain = 0;
+
+    for (int r = 0; r < rounds; r++)
+        direct += timeCalls(burst) / rounds;
+
+    // logcat output, the drain thread formats and prints
+    rlog_start(NULL);
+    for (int r = 0; r < rounds; r++)
+    {
+        ring += timeCalls(burst) / rounds;
+        double t0 = nowMs();
+        rlog_flush();
+        drain += (nowMs() - t0) * 1e6 / burst / rounds;
+    }
+    rlog_stop();
+
+    printf("%24s %10s  (ns per call)\n", "", "MY_LOG");
+    printf("%24s %10.0f\n", "__android_log_print", direct);
+    printf("%24s %10.0f\n", "ring", ring);
+    printf("%24s %10.0f\n", "ring drain, off thread", drain);
+
+    int dropped = runThreads(true);
+    if (dropped >= 0)
+        printf("%d threads x %d logs in bursts of %d per ms: %d dropped\n", THREADS, LOGS, BURST, dropped);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+        g_dir = argv[1];
+    clog3A::bEn = true;
+
+    testFormat();
+    testFallback();
+    testThreads();
+    benchmark();
+
+    printf("%s\n", g_fail ? "FAIL" : "PASS");
+    return g_fail ? 1 : 0;
+}
@@ -7,6 +7,7 @@
 #include "utilTransform/utilResize.h"
 #include "utilTransform/utilRotate.h"
 #include "utilTransform/utilColorTransform.h"
+#include "utilTransform/utilColorConvert.h"
 #include "utilFiltering/utilBlur.h"
 #include "utilFiltering/utilPartialDerivative.h"
 #include "utilFiltering/utilHarrisDetector.h"
@@ -0,0 +1,440 @@
+/*
+ * Test and benchmark of utilImageArithmetic
+ *
+ *  - ImageAdd and ImageSubstract match the per-pixel loops for residues
+ *    in and out of the 8-bit range
+ *  - utilImageSad and utilImageSadBatch match the unrolled loop for
+ *    subsample steps 1 to 5, positive and negative motions and
+ *    saturation values
+ *  - utilBlockSad and utilBlockSadSearch match a per-pixel block sad,
+ *    with and without the sad map
+ *  - motion search of a 1920x1080 frame against a shifted copy
+ *
+ * usage: util_arithmetic_test
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "utilMultiFrame/utilImageArithmetic.h"
+#include "util_test_common.h"
+
+// a smooth pattern with noise, so motion search has a clear minimum
+static void fillScene(std::vector<MUINT8> &buf, int w, int h, int dx, int dy, unsigned int seed)
+{
+    buf.resize(w * h);
+    for (int y = 0; y < h; y++)
+    {
+        for (int x = 0; x < w; x++)
+        {
+            int sx = x - dx, sy = y - dy;
+            seed = seed * 1103515245 + 12345;
+            int v = 128 + (((sx * 7) ^ (sy * 13)) & 63) + ((sx * sx + sy * 3) & 31) + ((seed >> 16) & 3);
+            buf[y * w + x] = (MUINT8)(v > 255 ? 255 : v);
+        }
+    }
+}
+
+/*
+ * references
+ */
+
+static void refArith(const std::vector<MUINT8> &a, const std::vector<MUINT8> &b, int residue, bool subtract, std::vector<MUINT8> &c)
+{
+    c.resize(a.size());
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        int value = subtract ? a[i] - b[i] + residue : a[i] + b[i] + residue;
+        c[i] = (MUINT8)(value > 255 ? 255 : value < 0 ? 0 : value);
+    }
+}
+
+// the unrolled loop of utilImageSad
+static void refImageSad(P_UTIL_IMAGE_SAD_STRUCT sad_data, MUINT32 *sum, MUINT32 *count)
+{
+    P_UTIL_CLIP_IMAGE_STRUCT src1 = &sad_data->src1;
+    P_UTIL_BASE_IMAGE_STRUCT src2 = &sad_data->src2;
+    MINT32 h = src1->clip_x, v = src1->clip_y;
+    MUINT8 *pImg1Y = (MUINT8 *)src1->data, *pImg2Y = (MUINT8 *)src2->data;
+    MUINT32 SadSum = 0, Count = 0, x_count, y_count, i;
+
+    if (v >= 0)
+    {
+        pImg1Y += v * src1->width;
+        y_count = (src1->clip_height - 1 - v) / sad_data->sub_h + 1;
+    }
+    else
+    {
+        pImg2Y += (-v) * src1->width;
+        y_count = (src1->clip_height - 1 + v) / sad_data->sub_h + 1;
+    }
+    if (h >= 0)
+    {
+        x_count = (src1->clip_width - 1 - h) / sad_data->sub_w + 1;
+        pImg1Y += h;
+    }
+    else
+    {
+        x_count = (src1->clip_width - 1 + h) / sad_data->sub_w + 1;
+        pImg2Y -= h;
+    }
+    for (; y_count != 0; y_count--)
+    {
+        MUINT8 *pImg1X = pImg1Y, *pImg2X = pImg2Y;
+        for (i = x_count; i > 3; i -= 4)
+        {
+            Count += 4;
+            for (int k = 0; k < 4; k++)
+            {
+                if (sad_data->saturation_value != 0 && *pImg2X == sad_data->saturation_value)
+                    Count--;
+                else
+                    SadSum += abs((int)*pImg2X - (int)*pImg1X);
+                pImg1X += sad_data->sub_w;
+                pImg2X += sad_data->sub_w;
+            }
+        }
+        for (; i != 0; i--)
+        {
+            SadSum += abs((int)*pImg2X - (int)*pImg1X);
+            Count++;
+            pImg1X += sad_data->sub_w;
+            pImg2X += sad_data->sub_w;
+        }
+        pImg1Y += sad_data->sub_h * src1->width;
+        pImg2Y += sad_data->sub_h * src2->width;
+    }
+    *sum = SadSum;
+    *count = Count;
+}
+
+static MUINT32 refBlockSad(const std::vector<MUINT8> &cur, int cw, int bx, int by, int bw, int bh,
+                           const std::vector<MUINT8> &ref, int rw, int rh, int dx, int dy)
+{
+    MUINT32 sum = 0;
+    if (bx + dx < 0 || by + dy < 0 || bx + dx + bw > rw || by + dy + bh > rh)
+        return UTL_BLOCK_SAD_INVALID;
+    for (int y = 0; y < bh; y++)
+        for (int x = 0; x < bw; x++)
+            sum += abs((int)cur[(by + y) * cw + bx + x] - (int)ref[(by + dy + y) * rw + bx + dx + x]);
+    return sum;
+}
+
+/*
+ * correctness
+ */
+
+static void testArith()
+{
+    const int sizes[][2] = { { 1, 1 }, { 7, 3 }, { 33, 17 }, { 640, 480 } };
+    const int residues[] = { 0, 1, -1, 128, -128, 509, -509, 600, -600, 100000, -100000 };
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        int w = sizes[s][0], h = sizes[s][1];
+        std::vector<MUINT8> a(w * h), b(w * h), c(w * h), ref;
+        fillRandom(a, 1 + s);
+        fillRandom(b, 100 + s);
+        UTIL_BASE_IMAGE_STRUCT A = { w, h, &a[0] }, B = { w, h, &b[0] }, C = { 0, 0, &c[0] };
+
+        for (size_t r = 0; r < sizeof(residues) / sizeof(residues[0]); r++)
+        {
+            for (int subtract = 0; subtract < 2; subtract++)
+            {
+                refArith(a, b, residues[r], subtract != 0, ref);
+                if (subtract)
+                    ImageSubstract(&A, &B, residues[r], &C);
+                else
+                    ImageAdd(&A, &B, residues[r], &C);
+                CHECK(c == ref && C.width == w && C.height == h, "%s %dx%d residue %d",
+                      subtract ? "ImageSubstract" : "ImageAdd", w, h, residues[r]);
+            }
+        }
+    }
+}
+
+static void testImageSad()
+{
+    const int w = 123, h = 77;
+    const MINT16 saturations[] = { 0, 255, 17, -1, 300 };
+    std::vector<MUINT8> img1(w * h), img2(w * h);
+    fillRandom(img1, 7);
+    fillRandom(img2, 8);
+    // saturated runs so whole groups of 4 are masked
+    for (int i = 0; i < w * h; i += 37)
+        memset(&img2[i], i % 2 ? 255 : 17, 9);
+
+    std::vector<MINT32> motion;
+    for (int v = -6; v <= 6; v += 3)
+        for (int hh = -7; hh <= 7; hh++)
+            motion.push_back(hh), motion.push_back(v);
+    int num = (int)motion.size() / 2;
+
+    for (int sub_w = 1; sub_w <= 5; sub_w++)
+    {
+        for (int sub_h = 1; sub_h <= 3; sub_h++)
+        {
+            for (size_t s = 0; s < sizeof(saturations) / sizeof(saturations[0]); s++)
+            {
+                UTIL_IMAGE_SAD_STRUCT sad;
+                memset(&sad, 0, sizeof(sad));
+                sad.src1.width = w;
+                sad.src1.height = h;
+                sad.src1.data = &img1[0];
+                sad.src1.clip_width = w - 3;
+                sad.src1.clip_height = h - 2;
+                sad.src2.width = w;
+                sad.src2.height = h;
+                sad.src2.data = &img2[0];
+                sad.sub_w = sub_w;
+                sad.sub_h = sub_h;
+                sad.saturation_value = saturations[s];
+
+                std::vector<MUINT32> sum(num), count(num);
+                utilImageSadBatch(&sad, &motion[0], num, &sum[0], &count[0]);
+                int bad = 0;
+                for (int k = 0; k < num; k++)
+                {
+                    MUINT32 refSum, refCount, oneSum, oneCount;
+                    sad.src1.clip_x = motion[2 * k];
+                    sad.src1.clip_y = motion[2 * k + 1];
+                    refImageSad(&sad, &refSum, &refCount);
+                    utilImageSad(&sad, &oneSum, &oneCount);
+                    bad += sum[k] != refSum || count[k] != refCount || oneSum != refSum || oneCount != refCount;
+                }
+                CHECK(bad == 0, "utilImageSad sub %dx%d saturation %d: %d bad motions",
+                      sub_w, sub_h, saturations[s], bad);
+            }
+        }
+    }
+}
+
+static void testBlockSad()
+{
+    const int w = 96, h = 64;
+    const int blocks[][4] = { { 40, 30, 16, 16 }, { 0, 0, 8, 8 }, { 3, 5, 27, 9 }, { 80, 48, 16, 16 }, { 10, 10, 1, 1 } };
+    std::vector<MUINT8> cur, ref;
+    fillScene(cur, w, h, 0, 0, 1);
+    fillScene(ref, w, h, 3, -2, 2);
+
+    for (size_t b = 0; b < sizeof(blocks) / sizeof(blocks[0]); b++)
+    {
+        const int range = 6, side = 2 * range + 1;
+        UTIL_BLOCK_SAD_STRUCT sad;
+        memset(&sad, 0, sizeof(sad));
+        sad.cur.width = w;
+        sad.cur.height = h;
+        sad.cur.data = &cur[0];
+        sad.cur.clip_x = blocks[b][0];
+        sad.cur.clip_y = blocks[b][1];
+        sad.cur.clip_width = blocks[b][2];
+        sad.cur.clip_height = blocks[b][3];
+        sad.ref.width = w;
+        sad.ref.height = h;
+        sad.ref.data = &ref[0];
+
+        std::vector<MINT32> motion;
+        std::vector<MUINT32> refMap;
+        MUINT32 refBest = UTL_BLOCK_SAD_INVALID;
+        MINT32 refBestMotion[2] = { 0, 0 };
+        for (int dy = -range; dy <= range; dy++)
+        {
+            for (int dx = -range; dx <= range; dx++)
+            {
+                MUINT32 v = refBlockSad(cur, w, blocks[b][0], blocks[b][1], blocks[b][2], blocks[b][3], ref, w, h, dx, dy);
+                motion.push_back(dx);
+                motion.push_back(dy);
+                refMap.push_back(v);
+                if (v < refBest)
+                {
+                    refBest = v;
+                    refBestMotion[0] = dx;
+                    refBestMotion[1] = dy;
+                }
+            }
+        }
+
+        std::vector<MUINT32> sads(side * side), map(side * side);
+        MINT32 best[2], bestNoMap[2];
+        CHECK(utilBlockSad(&sad, &motion[0], side * side, &sads[0]) == UTIL_OK, "utilBlockSad block %d", (int)b);
+        CHECK(sads == refMap, "utilBlockSad block %d sads", (int)b);
+
+        // runs of 6 motions in raster order from scattered starts, some of them wrap to the next row
+        std::vector<MINT32> shuffled;
+        std::vector<MUINT32> shuffledRef, shuffledSads(side * side);
+        for (int i = 0; i < side * side; i++)
+        {
+            int k = (i / 6 * 29 + i % 6) % (side * side);
+            shuffled.push_back(motion[2 * k]);
+            shuffled.push_back(motion[2 * k + 1]);
+            shuffledRef.push_back(refMap[k]);
+        }
+        utilBlockSad(&sad, &shuffled[0], side * side, &shuffledSads[0]);
+        CHECK(shuffledSads == shuffledRef, "utilBlockSad block %d sads of shuffled motions", (int)b);
+
+        utilBlockSadSearch(&sad, range, range, &map[0], best);
+        utilBlockSadSearch(&sad, range, range, NULL, bestNoMap);
+        CHECK(map == refMap, "utilBlockSadSearch block %d map", (int)b);
+        CHECK(best[0] == refBestMotion[0] && best[1] == refBestMotion[1] &&
+              bestNoMap[0] == refBestMotion[0] && bestNoMap[1] == refBestMotion[1],
+              "utilBlockSadSearch block %d best (%d, %d) (%d, %d), expected (%d, %d)", (int)b,
+              best[0], best[1], bestNoMap[0], bestNoMap[1], refBestMotion[0], refBestMotion[1]);
+    }
+
+    // the block must be inside cur
+    UTIL_BLOCK_SAD_STRUCT sad;
+    memset(&sad, 0, sizeof(sad));
+    sad.cur.width = w;
+    sad.cur.height = h;
+    sad.cur.data = &cur[0];
+    sad.cur.clip_x = w - 8;
+    sad.cur.clip_width = 16;
+    sad.cur.clip_height = 16;
+    sad.ref = sad.cur;
+    MINT32 best[2];
+    CHECK(utilBlockSadSearch(&sad, 1, 1, NULL, best) == UTIL_COMMON_ERR_INVALID_PARAMETER, "block outside cur");
+}
+
+/*
+ * benchmark
+ */
+
+static void benchmark()
+{
+    const int w = 1920, h = 1080, range = 8;
+    const int shift_x = 5, shift_y = -3;
+    std::vector<MUINT8> cur, ref, a(w * h), b(w * h), c(w * h);
+    fillScene(cur, w, h, 0, 0, 3);
+    fillScene(ref, w, h, shift_x, shift_y, 4);
+    fillRandom(a, 5);
+    fillRandom(b, 6);
+    double t0, tRef, tNew;
+
+    // add and subtract
+    UTIL_BASE_IMAGE_STRUCT A = { w, h, &a[0] }, B = { w, h, &b[0] }, C = { 0, 0, &c[0] };
+    std::vector<MUINT8> refC;
+    t0 = nowMs();
+    refArith(a, b, 16, true, refC);
+    tRef = nowMs() - t0;
+    t0 = nowMs();
+    ImageSubstract(&A, &B, 16, &C);
+    tNew = nowMs() - t0;
+    printf("ImageSubstract %dx%d: per-pixel %.2f ms, simd %.2f ms\n", w, h, tRef, tNew);
+
+    // whole frame alignment, subsampled by SUBSAMPLE_D
+    UTIL_IMAGE_SAD_STRUCT isad;
+    memset(&isad, 0, sizeof(isad));
+    isad.src1.width = w;
+    isad.src1.height = h;
+    isad.src1.data = &cur[0];
+    isad.src1.clip_width = w;
+    isad.src1.clip_height = h;
+    isad.src2.width = w;
+    isad.src2.height = h;
+    isad.src2.data = &ref[0];
+    isad.sub_w = SUBSAMPLE_D;
+    isad.sub_h = SUBSAMPLE_D;
+    isad.saturation_value = 255;
+
+    std::vector<MINT32> motion;
+    for (int v = -range; v <= range; v++)
+        for (int hh = -range; hh <= range; hh++)
+            motion.push_back(hh), motion.push_back(v);
+    int num = (int)motion.size() / 2;
+    std::vector<MUINT32> sum(num), count(num), refSum(num), refCount(num);
+
+    t0 = nowMs();
+    for (int k = 0; k < num; k++)
+    {
+        isad.src1.clip_x = motion[2 * k];
+        isad.src1.clip_y = motion[2 * k + 1];
+        refImageSad(&isad, &refSum[k], &refCount[k]);
+    }
+    tRef = nowMs() - t0;
+    t0 = nowMs();
+    utilImageSadBatch(&isad, &motion[0], num, &sum[0], &count[0]);
+    tNew = nowMs() - t0;
+    CHECK(sum == refSum && count == refCount, "benchmark image sad mismatch");
+    printf("utilImageSad %dx%d sub %d, %d motions: per-pixel %.2f ms, batch %.2f ms\n",
+           w, h, SUBSAMPLE_D, num, tRef, tNew);
+
+    // 16x16 block full search of every block
+    UTIL_BLOCK_SAD_STRUCT bsad;
+    memset(&bsad, 0, sizeof(bsad));
+    bsad.cur.width = w;
+    bsad.cur.height = h;
+    bsad.cur.data = &cur[0];
+    bsad.cur.clip_width = 16;
+    bsad.cur.clip_height = 16;
+    bsad.ref.width = w;
+    bsad.ref.height = h;
+    bsad.ref.data = &ref[0];
+    int blocks = 0, refFound = 0;
+    double tMap;
+
+    t0 = nowMs();
+    for (int by = 0; by + 16 <= h; by += 16)
+    {
+        for (int bx = 0; bx + 16 <= w; bx += 16)
+        {
+            MUINT32 best = UTL_BLOCK_SAD_INVALID;
+            int bestX = 0, bestY = 0;
+            for (int dy = -range; dy <= range; dy++)
+            {
+                for (int dx = -range; dx <= range; dx++)
+                {
+                    MUINT32 v = refBlockSad(cur, w, bx, by, 16, 16, ref, w, h, dx, dy);
+                    if (v < best)
+                        best = v, bestX = dx, bestY = dy;
+                }
+            }
+            blocks++;
+            refFound += bestX == shift_x && bestY == shift_y;
+        }
+    }
+    tRef = nowMs() - t0;
+
+    std::vector<MUINT32> map((2 * range + 1) * (2 * range + 1));
+    MINT32 bestMotion[2];
+    t0 = nowMs();
+    for (int by = 0; by + 16 <= h; by += 16)
+    {
+        for (int bx = 0; bx + 16 <= w; bx += 16)
+        {
+            bsad.cur.clip_x = bx;
+            bsad.cur.clip_y = by;
+            utilBlockSadSearch(&bsad, range, range, &map[0], bestMotion);
+        }
+    }
+    tMap = nowMs() - t0;
+
+    int found = 0;
+    t0 = nowMs();
+    for (int by = 0; by + 16 <= h; by += 16)
+    {
+        for (int bx = 0; bx + 16 <= w; bx += 16)
+        {
+            bsad.cur.clip_x = bx;
+            bsad.cur.clip_y = by;
+            utilBlockSadSearch(&bsad, range, range, NULL, bestMotion);
+            found += bestMotion[0] == shift_x && bestMotion[1] == shift_y;
+        }
+    }
+    tNew = nowMs() - t0;
+    CHECK(found == refFound, "benchmark block search found %d, expected %d", found, refFound);
+    printf("block search %d 16x16 blocks +/-%d: per-pixel %.2f ms, with map %.2f ms, early exit %.2f ms, "
+           "%d at the shift\n", blocks, range, tRef, tMap, tNew, found);
+}
+
+int main()
+{
+    testArith();
+    testImageSad();
+    testBlockSad();
+    benchmark();
+
+    printf("%s\n", g_fail ? "FAIL" : "PASS");
+    return g_fail ? 1 : 0;
+}
@@ -0,0 +1,308 @@
+/*
+ * Test and benchmark of UtlColorConvert
+ *
+ *  - the SIMD kernels give the same result as the C kernels, for each
+ *    matrix, at sizes which leave a tail to the C kernels
+ *  - the row bands on a tpq give the same result as one band
+ *  - with UTIL_COLOR_BT601_LIMITED, the result is close to the converters
+ *    of utilColorTransform
+ *  - the throughput of each conversion, legacy vs C vs SIMD vs SIMD on tpq
+ *
+ * usage: util_color_convert_test [width height [threads]]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "utilTransform/utilColorConvert.h"
+#include "utilTransform/utilColorTransform.h"
+#include "util_test_common.h"
+
+static const char *formatName(UTL_IMAGE_FORMAT_ENUM format)
+{
+    switch (format)
+    {
+        case UTL_IMAGE_FORMAT_RGBA8888:     return "RGBA";
+        case UTL_IMAGE_FORMAT_RGB888:       return "RGB";
+        case UTL_IMAGE_FORMAT_YUV420:       return "I420";
+        case UTL_IMAGE_FORMAT_NV21:         return "NV21";
+        case UTL_IMAGE_FORMAT_PACKET_YUY2:  return "YUYV";
+        default:                            return "?";
+    }
+}
+
+static int imageSize(UTL_IMAGE_FORMAT_ENUM format, int width, int height)
+{
+    switch (format)
+    {
+        case UTL_IMAGE_FORMAT_RGBA8888:     return width * height * 4;
+        case UTL_IMAGE_FORMAT_RGB888:       return width * height * 3;
+        case UTL_IMAGE_FORMAT_PACKET_YUY2:  return width * height * 2;
+        default:                            return width * height * 3 / 2;
+    }
+}
+
+static int maxDiff(const std::vector<MUINT8> &a, const std::vector<MUINT8> &b)
+{
+    int diff = 0;
+    for (size_t i = 0; i < a.size() && i < b.size(); i++)
+    {
+        int d = abs((int)a[i] - (int)b[i]);
+        if (d > diff)
+            diff = d;
+    }
+    return diff;
+}
+
+static UTIL_ERRCODE_ENUM convert(std::vector<MUINT8> &src, UTL_IMAGE_FORMAT_ENUM srcFormat,
+                                 std::vector<MUINT8> &dst, UTL_IMAGE_FORMAT_ENUM dstFormat,
+                                 int width, int height, UTIL_COLOR_MATRIX_ENUM matrix,
+                                 tp_queue tpq, int numTasks)
+{
+    dst.assign(imageSize(dstFormat, width, height), 0);
+    UTIL_BASE_IMAGE_STRUCT src_img = { width, height, src.data() };
+    UTIL_BASE_IMAGE_STRUCT dst_img = { width, height, dst.data() };
+    return UtlColorConvert(&src_img, srcFormat, &dst_img, dstFormat, matrix, tpq, numTasks);
+}
+
+/*
+ * legacy converters of utilColorTransform, in the same src / dst form
+ */
+static bool convertLegacy(std::vector<MUINT8> &src, UTL_IMAGE_FORMAT_ENUM srcFormat,
+                          std::vector<MUINT8> &dst, UTL_IMAGE_FORMAT_ENUM dstFormat,
+                          int width, int height)
+{
+    UTIL_BASE_IMAGE_STRUCT src_img = { width, height, src.data() };
+    dst.assign(imageSize(dstFormat, width, height), 0);
+    UTIL_BASE_IMAGE_STRUCT dst_img = { width, height, dst.data() };
+
+    if (srcFormat == UTL_IMAGE_FORMAT_RGBA8888 && dstFormat == UTL_IMAGE_FORMAT_YUV420)
+        return UtlRGBA8888toI420(&src_img, dst.data()) == UTIL_OK;
+    if (srcFormat == UTL_IMAGE_FORMAT_RGB888 && dstFormat == UTL_IMAGE_FORMAT_YUV420)
+        return UtlRGB888toI420(&src_img, dst.data()) == UTIL_OK;
+    if (srcFormat == UTL_IMAGE_FORMAT_YUV420 && dstFormat == UTL_IMAGE_FORMAT_RGBA8888)
+        return UtlI420toRGBA8888(&src_img, dst.data()) == UTIL_OK;
+    if (srcFormat == UTL_IMAGE_FORMAT_YUV420 && dstFormat == UTL_IMAGE_FORMAT_RGB888)
+        return UtlI420toRGB888(&src_img, dst.data()) == UTIL_OK;
+    if (srcFormat == UTL_IMAGE_FORMAT_PACKET_YUY2 && dstFormat == UTL_IMAGE_FORMAT_YUV420)
+        return UtlYUYVtoI420(&dst_img, &src_img) == UTIL_OK;
+    if (srcFormat == UTL_IMAGE_FORMAT_YUV420 && dstFormat == UTL_IMAGE_FORMAT_PACKET_YUY2)
+        return UtlI420toYUYV(&dst_img, &src_img) == UTIL_OK;
+    if (srcFormat == UTL_IMAGE_FORMAT_NV21 && dstFormat == UTL_IMAGE_FORMAT_YUV420)
+    {
+        // in place with a buffer of the chroma planes
+        std::vector<MUINT8> buffer(width * height / 2);
+        dst = src;
+        dst_img.data = dst.data();
+        return UtlNV21toI420(&dst_img, buffer.data()) == UTIL_OK;
+    }
+    return false;
+}
+
+struct ConvertPair
+{
+    UTL_IMAGE_FORMAT_ENUM src;
+    UTL_IMAGE_FORMAT_ENUM dst;
+    int legacy_tolerance;   // max difference to the legacy converter, -1 if it has none
+};
+
+static const ConvertPair g_pairs[] =
+{
+    { UTL_IMAGE_FORMAT_RGBA8888,    UTL_IMAGE_FORMAT_YUV420,        1 },
+    { UTL_IMAGE_FORMAT_RGB888,      UTL_IMAGE_FORMAT_YUV420,        1 },
+    { UTL_IMAGE_FORMAT_RGBA8888,    UTL_IMAGE_FORMAT_NV21,          -1 },
+    { UTL_IMAGE_FORMAT_YUV420,      UTL_IMAGE_FORMAT_RGBA8888,      1 },
+    { UTL_IMAGE_FORMAT_YUV420,      UTL_IMAGE_FORMAT_RGB888,        1 },
+    { UTL_IMAGE_FORMAT_NV21,        UTL_IMAGE_FORMAT_RGBA8888,      -1 },
+    { UTL_IMAGE_FORMAT_NV21,        UTL_IMAGE_FORMAT_RGB888,        -1 },
+    { UTL_IMAGE_FORMAT_PACKET_YUY2, UTL_IMAGE_FORMAT_YUV420,        1 },
+    { UTL_IMAGE_FORMAT_YUV420,      UTL_IMAGE_FORMAT_PACKET_YUY2,   1 },
+    { UTL_IMAGE_FORMAT_NV21,        UTL_IMAGE_FORMAT_YUV420,        0 },
+    { UTL_IMAGE_FORMAT_YUV420,      UTL_IMAGE_FORMAT_NV21,          -1 },
+};
+
+#define PAIR_NUM (int)(sizeof(g_pairs) / sizeof(g_pairs[0]))
+
+static void testBitExact(UTIL_COLOR_ISA_ENUM simd, tp_queue tpq)
+{
+    // 16n + 2 leaves a tail to the C kernels; 2x2 and 4x6 are tails only
+    static const int sizes[][2] = { { 2, 2 }, { 4, 6 }, { 34, 10 }, { 130, 66 } };
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        int width = sizes[s][0];
+        int height = sizes[s][1];
+        for (int p = 0; p < PAIR_NUM; p++)
+        {
+            std::vector<MUINT8> src(imageSize(g_pairs[p].src, width, height));
+            std::vector<MUINT8> ref, out, out_mt, legacy;
+            fillRandom(src, width * 131 + height + p);
+
+            for (int m = 0; m < UTIL_COLOR_MATRIX_NUM; m++)
+            {
+                UTIL_COLOR_MATRIX_ENUM matrix = (UTIL_COLOR_MATRIX_ENUM)m;
+                UtlColorConvertSetIsa(UTIL_COLOR_ISA_C);
+                CHECK(convert(src, g_pairs[p].src, ref, g_pairs[p].dst, width, height, matrix, NULL, 1) == UTIL_OK,
+                      "%s->%s %dx%d", formatName(g_pairs[p].src), formatName(g_pairs[p].dst), width, height);
+
+                UtlColorConvertSetIsa(simd);
+                convert(src, g_pairs[p].src, out, g_pairs[p].dst, width, height, matrix, NULL, 1);
+                convert(src, g_pairs[p].src, out_mt, g_pairs[p].dst, width, height, matrix, tpq, 7);
+                CHECK(out == ref, "%s->%s %dx%d matrix %d: SIMD differs from C by %d",
+                      formatName(g_pairs[p].src), formatName(g_pairs[p].dst), width, height, m, maxDiff(out, ref));
+                CHECK(out_mt == ref, "%s->%s %dx%d matrix %d: bands differ from C by %d",
+                      formatName(g_pairs[p].src), formatName(g_pairs[p].dst), width, height, m, maxDiff(out_mt, ref));
+            }
+
+            if (g_pairs[p].legacy_tolerance >= 0 && width >= 16)
+            {
+                UtlColorConvertSetIsa(simd);
+                convert(src, g_pairs[p].src, out, g_pairs[p].dst, width, height, UTIL_COLOR_BT601_LIMITED, NULL, 1);
+                if (convertLegacy(src, g_pairs[p].src, legacy, g_pairs[p].dst, width, height))
+                {
+                    int diff = maxDiff(out, legacy);
+                    CHECK(diff <= g_pairs[p].legacy_tolerance, "%s->%s %dx%d: %d from the legacy converter",
+                          formatName(g_pairs[p].src), formatName(g_pairs[p].dst), width, height, diff);
+                }
+            }
+        }
+    }
+}
+
+static void testErrors()
+{
+    std::vector<MUINT8> src(64 * 4), dst(64 * 4);
+    UTIL_BASE_IMAGE_STRUCT src_img = { 8, 8, src.data() };
+    UTIL_BASE_IMAGE_STRUCT dst_img = { 8, 8, dst.data() };
+    UTIL_BASE_IMAGE_STRUCT odd_img = { 7, 8, dst.data() };
+    UTIL_BASE_IMAGE_STRUCT null_img = { 8, 8, NULL };
+
+    CHECK(UtlColorConvert(&src_img, UTL_IMAGE_FORMAT_RGBA8888, &null_img, UTL_IMAGE_FORMAT_YUV420,
+                          UTIL_COLOR_BT601_LIMITED, NULL, 1) == UTIL_COMMON_ERR_NULL_BUFFER_POINTER, "null buffer");
+    CHECK(UtlColorConvert(&odd_img, UTL_IMAGE_FORMAT_RGBA8888, &odd_img, UTL_IMAGE_FORMAT_YUV420,
+                          UTIL_COLOR_BT601_LIMITED, NULL, 1) == UTIL_COMMON_ERR_INVALID_PARAMETER, "odd width");
+    CHECK(UtlColorConvert(&src_img, UTL_IMAGE_FORMAT_RGBA8888, &odd_img, UTL_IMAGE_FORMAT_YUV420,
+                          UTIL_COLOR_BT601_LIMITED, NULL, 1) == UTIL_COMMON_ERR_INVALID_PARAMETER, "size mismatch");
+    CHECK(UtlColorConvert(&src_img, UTL_IMAGE_FORMAT_RGBA8888, &dst_img, UTL_IMAGE_FORMAT_YUV420,
+                          UTIL_COLOR_MATRIX_NUM, NULL, 1) == UTIL_COMMON_ERR_INVALID_PARAMETER, "matrix");
+    CHECK(UtlColorConvert(&src_img, UTL_IMAGE_FORMAT_RGBA8888, &dst_img, UTL_IMAGE_FORMAT_YUV420,
+                          UTIL_COLOR_BT601_LIMITED, NULL, UTL_COLOR_MAX_TASKS + 1) == UTIL_COMMON_ERR_INVALID_PARAMETER,
+          "tasks");
+    CHECK(UtlColorConvert(&src_img, UTL_IMAGE_FORMAT_RGBA8888, &dst_img, UTL_IMAGE_FORMAT_RGB888,
+                          UTIL_COLOR_BT601_LIMITED, NULL, 1) == UTIL_COMMON_ERR_UNSUPPORTED_IMAGE_FORMAT, "pair");
+}
+
+static void testGrey(UTIL_COLOR_ISA_ENUM simd)
+{
+    // grey has no chroma and round trips in each matrix, up to the
+    // quantization of Y to 219 levels in the limited range
+    std::vector<MUINT8> rgba(32 * 2 * 4), yuv, back;
+    for (int i = 0; i < 32 * 2; i++)
+        memset(&rgba[i * 4], (i * 4) & 0xFF, 3), rgba[i * 4 + 3] = 0xFF;
+
+    UtlColorConvertSetIsa(simd);
+    for (int m = 0; m < UTIL_COLOR_MATRIX_NUM; m++)
+    {
+        convert(rgba, UTL_IMAGE_FORMAT_RGBA8888, yuv, UTL_IMAGE_FORMAT_NV21, 32, 2, (UTIL_COLOR_MATRIX_ENUM)m, NULL, 1);
+        for (int i = 32 * 2; i < (int)yuv.size(); i++)
+            CHECK(abs(yuv[i] - 128) <= 1, "matrix %d: chroma %d of grey", m, yuv[i]);
+
+        convert(yuv, UTL_IMAGE_FORMAT_NV21, back, UTL_IMAGE_FORMAT_RGBA8888, 32, 2, (UTIL_COLOR_MATRIX_ENUM)m, NULL, 1);
+        CHECK(maxDiff(back, rgba) <= 3, "matrix %d: grey round trip off by %d", m, maxDiff(back, rgba));
+    }
+}
+
+static double runMs(int loops, bool (*func)(void *), void *arg)
+{
+    double begin = nowMs();
+    for (int i = 0; i < loops; i++)
+        func(arg);
+    return (nowMs() - begin) / loops;
+}
+
+struct BenchArg
+{
+    const ConvertPair *pair;
+    std::vector<MUINT8> *src;
+    std::vector<MUINT8> *dst;
+    int width;
+    int height;
+    tp_queue tpq;
+    int tasks;
+};
+
+static bool benchLegacy(void *arg)
+{
+    BenchArg *b = (BenchArg *)arg;
+    return convertLegacy(*b->src, b->pair->src, *b->dst, b->pair->dst, b->width, b->height);
+}
+
+static bool benchConvert(void *arg)
+{
+    BenchArg *b = (BenchArg *)arg;
+    return convert(*b->src, b->pair->src, *b->dst, b->pair->dst, b->width, b->height,
+                   UTIL_COLOR_BT601_LIMITED, b->tpq, b->tasks) == UTIL_OK;
+}
+
+static void benchmark(UTIL_COLOR_ISA_ENUM simd, int width, int height, tp_queue tpq, int threads)
+{
+    const int loops = 10;
+    double mp = width * (double)height / 1000000.0;
+
+    printf("\n%dx%d, MP/s        legacy        C     SIMD  SIMD+%dT\n", width, height, threads);
+    for (int p = 0; p < PAIR_NUM; p++)
+    {
+        std::vector<MUINT8> src(imageSize(g_pairs[p].src, width, height)), dst;
+        fillRandom(src, p);
+        BenchArg arg = { &g_pairs[p], &src, &dst, width, height, NULL, 1 };
+
+        double legacy = 0;
+        if (benchLegacy(&arg))
+            legacy = runMs(loops, benchLegacy, &arg);
+
+        UtlColorConvertSetIsa(UTIL_COLOR_ISA_C);
+        double c = runMs(loops, benchConvert, &arg);
+        UtlColorConvertSetIsa(simd);
+        double s = runMs(loops, benchConvert, &arg);
+        arg.tpq = tpq;
+        arg.tasks = threads * 2;
+        double mt = runMs(loops, benchConvert, &arg);
+
+        printf("%-4s -> %-4s   ", formatName(g_pairs[p].src), formatName(g_pairs[p].dst));
+        if (legacy > 0)
+            printf("%9.1f", mp * 1000.0 / legacy);
+        else
+            printf("%9s", "-");
+        printf("%9.1f%9.1f%9.1f\n", mp * 1000.0 / c, mp * 1000.0 / s, mp * 1000.0 / mt);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int width = (argc > 2) ? atoi(argv[1]) : 1920;
+    int height = (argc > 2) ? atoi(argv[2]) : 1080;
+    int threads = (argc > 3) ? atoi(argv[3]) : 4;
+    if (width <= 0 || height <= 0 || (width & 15) || (height & 1) || threads <= 0 || threads * 2 > UTL_COLOR_MAX_TASKS)
+    {
+        printf("usage: %s [width height [threads]], width of 16n, even height, up to %d threads\n",
+               argv[0], UTL_COLOR_MAX_TASKS / 2);
+        return 1;
+    }
+
+    UTIL_COLOR_ISA_ENUM simd = UtlColorConvertGetIsa();
+    printf("isa: %s\n", simd == UTIL_COLOR_ISA_NEON ? "NEON" : (simd == UTIL_COLOR_ISA_SSE41 ? "SSE4.1" : "C"));
+
+    tp_queue tpq = tpq_create(threads, "colortest");
+
+    testErrors();
+    testBitExact(simd, tpq);
+    testGrey(simd);
+    benchmark(simd, width, height, tpq, threads);
+
+    tpq_destroy(tpq);
+
+    printf("\n%s\n", g_fail ? "FAIL" : "PASS");
+    return g_fail ? 1 : 0;
+}
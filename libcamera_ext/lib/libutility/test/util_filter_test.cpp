@@ -0,0 +1,411 @@
+/*
+ * Test and benchmark of utilBlur, utilSobel, utilBoxBlur, Convolve and
+ * utilHarrisResponse
+ *
+ *  - utilBlur, utilSobel and Convolve give the output of the per-pixel
+ *    loops they had, for separable and non-separable kernels
+ *  - utilBoxBlur gives the rounded mean of the window inside the image,
+ *    utilIntegralImage the sums of the rectangles from the top-left
+ *  - utilHarrisResponse gives the output of utilPartialDerivative
+ *    followed by utilHarrisDetector
+ *  - the bands on a tpq give the same result as one band
+ *  - the time of each, per-pixel reference vs one band vs bands on tpq
+ *
+ * usage: util_filter_test [threads]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "utilFiltering/utilBlur.h"
+#include "utilFiltering/utilConvolve.h"
+#include "utilFiltering/utilHarrisDetector.h"
+#include "utilFiltering/utilPartialDerivative.h"
+#include "util_test_common.h"
+
+// random blobs, smooth enough for gradients both under and over the harris threshold
+static void fillScene(std::vector<MUINT8> &buf, int w, int h, unsigned int seed)
+{
+    for (int y = 0; y < h; y++)
+    {
+        for (int x = 0; x < w; x++)
+        {
+            seed = seed * 1103515245 + 12345;
+            int v = 128 + ((((x / 7) ^ (y / 5)) & 1) ? 60 : -60) + (int)((seed >> 16) % 9) - 4;
+            buf[y * w + x] = (MUINT8)v;
+        }
+    }
+}
+
+/*
+ * references, the per-pixel loops before the separable passes
+ */
+
+static void refBlur(MUINT8 *dst, const UTIL_CLIP_IMAGE_STRUCT *src)
+{
+    const int width = src->width;
+    const MUINT8 *p_src = (const MUINT8 *)src->data;
+    static const int k[5] = { 1, 4, 6, 4, 1 };
+    for (int y = 0; y < src->clip_height; y++)
+    {
+        for (int x = 0; x < src->clip_width; x++)
+        {
+            int val = 0;
+            for (int i = 0; i < 5; i++)
+                for (int j = 0; j < 5; j++)
+                    val += p_src[(y + i) * width + x + j] * k[i] * k[j];
+            dst[(y + src->clip_y) * width + x + src->clip_x] = (MUINT8)((val + 128) >> 8);
+        }
+    }
+}
+
+static void refSobel(MUINT32 *dst, const UTIL_CLIP_IMAGE_STRUCT *src)
+{
+    const int width = src->width;
+    const MUINT8 *p = (const MUINT8 *)src->data;
+    const int height_4 = (src->height - src->clip_y * 2) >> 2;
+    const int width_4 = (width - src->clip_x * 2) >> 2;
+    for (int b = 0; b < 16; b++)
+        dst[b] = 0;
+    for (int yy = 0; yy < 4; yy++)
+    {
+        for (int xx = 0; xx < 4; xx++)
+        {
+            for (int y = 0; y < height_4; y += 2)
+            {
+                for (int x = 0; x < width_4; x += 2)
+                {
+                    int c = (yy * height_4 + src->clip_y + y) * width + xx * width_4 + src->clip_x + x;
+                    int dy = -p[c - width - 1] - 2 * p[c - width] - p[c - width + 1]
+                             + p[c + width - 1] + 2 * p[c + width] + p[c + width + 1];
+                    int dx = -p[c - width - 1] + p[c - width + 1] - 2 * p[c - 1] + 2 * p[c + 1]
+                             - p[c + width - 1] + p[c + width + 1];
+                    dst[(yy << 2) + xx] += (abs(dx) + abs(dy)) >> 1;
+                }
+            }
+        }
+    }
+}
+
+static void refConvolve(MUINT8 *dst, const MUINT8 *src, int width, int height, const MUINT8 *kernel, int kw, int kh)
+{
+    for (int i = 0; i < height; i++)
+    {
+        for (int j = 0; j < width; j++)
+        {
+            int sum = 0;
+            for (int ii = 0; ii < kh; ii++)
+            {
+                for (int jj = 0; jj < kw; jj++)
+                {
+                    int r = i + (ii - kh / 2);
+                    int c = j + (jj - kw / 2);
+                    if (r < 0)
+                        r = -r;
+                    else if (height <= r)
+                        r = 2 * height - r - 2;
+                    if (c < 0)
+                        c = -c;
+                    else if (width <= c)
+                        c = 2 * width - c - 2;
+                    sum += src[r * width + c] * kernel[ii * kw + jj];
+                }
+            }
+            dst[i * width + j] = (MUINT8)((sum + 2) >> 2);
+        }
+    }
+}
+
+static void refBoxBlur(MUINT8 *dst, const MUINT8 *src, int width, int height, int radius)
+{
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            unsigned int sum = 0, n = 0;
+            for (int i = y - radius; i <= y + radius; i++)
+            {
+                for (int j = x - radius; j <= x + radius; j++)
+                {
+                    if (i >= 0 && i < height && j >= 0 && j < width)
+                    {
+                        sum += src[i * width + j];
+                        n++;
+                    }
+                }
+            }
+            dst[y * width + x] = (MUINT8)((sum + n / 2) / n);
+        }
+    }
+}
+
+/*
+ * tests
+ */
+
+static void testBlur(tp_queue tpq, int threads)
+{
+    const int sizes[][2] = { { 13, 9 }, { 64, 48 }, { 333, 101 } };
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        int w = sizes[s][0], h = sizes[s][1];
+        std::vector<MUINT8> src(w * h), ref(w * h, 0), out(w * h, 0), outMt(w * h, 0);
+        fillRandom(src, 11 + s);
+
+        UTIL_CLIP_IMAGE_STRUCT img;
+        img.width = w;
+        img.height = h;
+        img.data = &src[0];
+        img.clip_x = 2;
+        img.clip_y = 2;
+        img.clip_width = w - 4;
+        img.clip_height = h - 4;
+
+        refBlur(&ref[0], &img);
+        CHECK(utilBlur(&out[0], &img) == UTIL_OK, "utilBlur %dx%d", w, h);
+        CHECK(utilBlur(&outMt[0], &img, tpq, threads) == UTIL_OK, "utilBlur tpq %dx%d", w, h);
+        CHECK(out == ref, "utilBlur %dx%d differs from the per-pixel loop", w, h);
+        CHECK(outMt == ref, "utilBlur tpq %dx%d differs from the per-pixel loop", w, h);
+
+        MUINT32 sobel[16], sobelRef[16];
+        refSobel(sobelRef, &img);
+        CHECK(utilSobel(sobel, &img) == UTIL_OK, "utilSobel %dx%d", w, h);
+        CHECK(memcmp(sobel, sobelRef, sizeof(sobel)) == 0, "utilSobel %dx%d differs from the per-pixel loop", w, h);
+    }
+}
+
+static void testConvolve(tp_queue tpq, int threads)
+{
+    // separable gaussians, a separable kernel with a common factor, and non-separable ones
+    const MUINT8 k3[9] = { 1, 2, 1, 2, 4, 2, 1, 2, 1 };
+    const MUINT8 k5x3[15] = { 2, 4, 6, 4, 2, 3, 6, 9, 6, 3, 2, 4, 6, 4, 2 };
+    const MUINT8 k1x7[7] = { 1, 2, 3, 4, 3, 2, 1 };
+    const MUINT8 kCross[9] = { 0, 1, 0, 1, 4, 1, 0, 1, 0 };
+    const MUINT8 kRandom[25] = { 3, 9, 1, 0, 7, 2, 2, 8, 1, 1, 0, 5, 5, 5, 0, 4, 1, 1, 9, 2, 6, 0, 3, 1, 1 };
+    const MUINT8 kZero[9] = { 0 };
+    struct { const MUINT8 *k; int w, h; const char *name; } kernels[] = {
+        { k3, 3, 3, "3x3 gaussian" }, { k5x3, 5, 3, "5x3 separable" }, { k1x7, 7, 1, "7x1" },
+        { kCross, 3, 3, "3x3 cross" }, { kRandom, 5, 5, "5x5 random" }, { kZero, 3, 3, "zero" },
+    };
+    const int sizes[][2] = { { 7, 5 }, { 40, 31 }, { 257, 66 } };
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        int w = sizes[s][0], h = sizes[s][1];
+        std::vector<MUINT8> src(w * h), ref(w * h), out(w * h), outMt(w * h);
+        fillRandom(src, 23 + s);
+        for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++)
+        {
+            UTIL_BASE_IMAGE_STRUCT a = { w, h, &src[0] };
+            UTIL_BASE_IMAGE_STRUCT kernel = { kernels[k].w, kernels[k].h, (void *)kernels[k].k };
+            UTIL_BASE_IMAGE_STRUCT c = { 0, 0, &out[0] };
+            UTIL_BASE_IMAGE_STRUCT cMt = { 0, 0, &outMt[0] };
+
+            refConvolve(&ref[0], &src[0], w, h, kernels[k].k, kernels[k].w, kernels[k].h);
+            CHECK(Convolve(&a, &kernel, &c) == UTIL_OK, "Convolve %s %dx%d", kernels[k].name, w, h);
+            CHECK(Convolve(&a, &kernel, &cMt, tpq, threads) == UTIL_OK, "Convolve tpq %s %dx%d", kernels[k].name, w, h);
+            CHECK(out == ref, "Convolve %s %dx%d differs from the per-pixel loop", kernels[k].name, w, h);
+            CHECK(outMt == ref, "Convolve tpq %s %dx%d differs from the per-pixel loop", kernels[k].name, w, h);
+            CHECK(c.width == w && c.height == h, "Convolve %s output size", kernels[k].name);
+        }
+    }
+}
+
+static void testBoxBlur(tp_queue tpq, int threads)
+{
+    const int sizes[][2] = { { 1, 1 }, { 9, 4 }, { 70, 53 } };
+    const int radii[] = { 0, 1, 3, 20, 100 };
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        int w = sizes[s][0], h = sizes[s][1];
+        std::vector<MUINT8> src(w * h), ref(w * h), out(w * h), outMt(w * h);
+        fillRandom(src, 37 + s);
+        UTIL_BASE_IMAGE_STRUCT img = { w, h, &src[0] };
+
+        std::vector<MUINT32> integral((w + 1) * (h + 1));
+        CHECK(utilIntegralImage(&integral[0], &img) == UTIL_OK, "utilIntegralImage %dx%d", w, h);
+        int bad = 0;
+        for (int y = 0; y <= h; y++)
+        {
+            for (int x = 0; x <= w; x++)
+            {
+                MUINT32 expect = 0;
+                for (int i = 0; i < y; i++)
+                    for (int j = 0; j < x; j++)
+                        expect += src[i * w + j];
+                bad += integral[y * (w + 1) + x] != expect;
+            }
+        }
+        CHECK(bad == 0, "utilIntegralImage %dx%d: %d bad sums", w, h, bad);
+
+        for (size_t r = 0; r < sizeof(radii) / sizeof(radii[0]); r++)
+        {
+            refBoxBlur(&ref[0], &src[0], w, h, radii[r]);
+            CHECK(utilBoxBlur(&out[0], &img, radii[r], NULL, 1) == UTIL_OK, "utilBoxBlur %dx%d r %d", w, h, radii[r]);
+            CHECK(utilBoxBlur(&outMt[0], &img, radii[r], tpq, threads) == UTIL_OK, "utilBoxBlur tpq %dx%d r %d", w, h, radii[r]);
+            CHECK(out == ref, "utilBoxBlur %dx%d r %d differs from the window mean", w, h, radii[r]);
+            CHECK(outMt == ref, "utilBoxBlur tpq %dx%d r %d differs from the window mean", w, h, radii[r]);
+        }
+    }
+}
+
+static void testHarris(tp_queue tpq, int threads)
+{
+    const int sizes[][2] = { { 24, 20 }, { 160, 120 }, { 321, 97 } };
+    const int clips[][2] = { { 2, 3 }, { 3, 3 }, { 8, 5 } };
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        int w = sizes[s][0], h = sizes[s][1];
+        std::vector<MUINT8> src(w * h);
+        std::vector<MINT8> gx(w * h, 0), gy(w * h, 0);
+        std::vector<MINT32> ref(w * h), out(w * h, -1), outMt(w * h, -1);
+        fillScene(src, w, h, 41 + s);
+
+        UTIL_BASE_IMAGE_STRUCT img = { w, h, &src[0] };
+        utilPartialDerivative(&gx[0], &gy[0], &img);
+
+        for (size_t c = 0; c < sizeof(clips) / sizeof(clips[0]); c++)
+        {
+            UTIL_CLIP_IMAGE_STRUCT rc;
+            rc.width = w;
+            rc.height = h;
+            rc.clip_x = clips[c][0];
+            rc.clip_y = clips[c][1];
+            rc.clip_width = w - 2 * rc.clip_x;
+            rc.clip_height = h - 2 * rc.clip_y;
+            MINT32 rangeRef = -1, range = -2, rangeMt = -3;
+
+            rc.data = &ref[0];
+            utilHarrisDetector(&rc, &gx[0], &gy[0], &rangeRef);
+            rc.data = &out[0];
+            CHECK(utilHarrisResponse(&rc, &img, &range, NULL, 1) == UTIL_OK, "utilHarrisResponse %dx%d", w, h);
+            rc.data = &outMt[0];
+            CHECK(utilHarrisResponse(&rc, &img, &rangeMt, tpq, threads) == UTIL_OK, "utilHarrisResponse tpq %dx%d", w, h);
+
+            int corners = 0;
+            for (int i = 0; i < w * h; i++)
+                corners += ref[i] != 0;
+            CHECK(corners > 0, "harris %dx%d: no response to compare", w, h);
+            CHECK(out == ref && range == rangeRef, "utilHarrisResponse %dx%d clip %d,%d differs from the two passes",
+                  w, h, rc.clip_x, rc.clip_y);
+            CHECK(outMt == ref && rangeMt == rangeRef, "utilHarrisResponse tpq %dx%d clip %d,%d differs from the two passes",
+                  w, h, rc.clip_x, rc.clip_y);
+        }
+    }
+}
+
+/*
+ * benchmark
+ */
+
+static void benchmark(tp_queue tpq, int threads)
+{
+    const int w = 1920, h = 1080, rounds = 5;
+    std::vector<MUINT8> src(w * h), dst(w * h);
+    std::vector<MINT8> gx(w * h), gy(w * h);
+    std::vector<MINT32> rc(w * h);
+    MINT32 range;
+    double t0, tRef, tOne, tMt;
+    fillScene(src, w, h, 5);
+
+    UTIL_CLIP_IMAGE_STRUCT clip;
+    clip.width = w;
+    clip.height = h;
+    clip.data = &src[0];
+    clip.clip_x = 2;
+    clip.clip_y = 2;
+    clip.clip_width = w - 4;
+    clip.clip_height = h - 4;
+
+    t0 = nowMs();
+    for (int r = 0; r < rounds; r++) refBlur(&dst[0], &clip);
+    tRef = (nowMs() - t0) / rounds;
+    t0 = nowMs();
+    for (int r = 0; r < rounds; r++) utilBlur(&dst[0], &clip);
+    tOne = (nowMs() - t0) / rounds;
+    t0 = nowMs();
+    for (int r = 0; r < rounds; r++) utilBlur(&dst[0], &clip, tpq, threads);
+    tMt = (nowMs() - t0) / rounds;
+    printf("utilBlur %dx%d: per-pixel %.2f ms, separable %.2f ms, %d bands %.2f ms\n", w, h, tRef, tOne, threads, tMt);
+
+    const MUINT8 k5[25] = { 1, 4, 6, 4, 1, 4, 16, 24, 16, 4, 6, 24, 36, 24, 6, 4, 16, 24, 16, 4, 1, 4, 6, 4, 1 };
+    const MUINT8 kRandom[25] = { 3, 9, 1, 0, 7, 2, 2, 8, 1, 1, 0, 5, 5, 5, 0, 4, 1, 1, 9, 2, 6, 0, 3, 1, 1 };
+    const MUINT8 *kernels[2] = { k5, kRandom };
+    const char *names[2] = { "5x5 separable", "5x5 non-separable" };
+    for (int k = 0; k < 2; k++)
+    {
+        UTIL_BASE_IMAGE_STRUCT a = { w, h, &src[0] };
+        UTIL_BASE_IMAGE_STRUCT kernel = { 5, 5, (void *)kernels[k] };
+        UTIL_BASE_IMAGE_STRUCT c = { 0, 0, &dst[0] };
+        t0 = nowMs();
+        refConvolve(&dst[0], &src[0], w, h, kernels[k], 5, 5);
+        tRef = nowMs() - t0;
+        t0 = nowMs();
+        for (int r = 0; r < rounds; r++) Convolve(&a, &kernel, &c);
+        tOne = (nowMs() - t0) / rounds;
+        t0 = nowMs();
+        for (int r = 0; r < rounds; r++) Convolve(&a, &kernel, &c, tpq, threads);
+        tMt = (nowMs() - t0) / rounds;
+        printf("Convolve %s %dx%d: per-pixel %.2f ms, one band %.2f ms, %d bands %.2f ms\n",
+               names[k], w, h, tRef, tOne, threads, tMt);
+    }
+
+    UTIL_BASE_IMAGE_STRUCT img = { w, h, &src[0] };
+    for (int radius = 2; radius <= 32; radius *= 4)
+    {
+        t0 = nowMs();
+        refBoxBlur(&dst[0], &src[0], w, h, radius);
+        tRef = nowMs() - t0;
+        t0 = nowMs();
+        for (int r = 0; r < rounds; r++) utilBoxBlur(&dst[0], &img, radius, NULL, 1);
+        tOne = (nowMs() - t0) / rounds;
+        t0 = nowMs();
+        for (int r = 0; r < rounds; r++) utilBoxBlur(&dst[0], &img, radius, tpq, threads);
+        tMt = (nowMs() - t0) / rounds;
+        printf("utilBoxBlur r %d %dx%d: per-pixel %.2f ms, integral %.2f ms, %d bands %.2f ms\n",
+               radius, w, h, tRef, tOne, threads, tMt);
+    }
+
+    UTIL_CLIP_IMAGE_STRUCT out;
+    out.width = w;
+    out.height = h;
+    out.data = &rc[0];
+    out.clip_x = 3;
+    out.clip_y = 3;
+    out.clip_width = w - 6;
+    out.clip_height = h - 6;
+    t0 = nowMs();
+    for (int r = 0; r < rounds; r++)
+    {
+        utilPartialDerivative(&gx[0], &gy[0], &img);
+        utilHarrisDetector(&out, &gx[0], &gy[0], &range);
+    }
+    tRef = (nowMs() - t0) / rounds;
+    t0 = nowMs();
+    for (int r = 0; r < rounds; r++) utilHarrisResponse(&out, &img, &range, NULL, 1);
+    tOne = (nowMs() - t0) / rounds;
+    t0 = nowMs();
+    for (int r = 0; r < rounds; r++) utilHarrisResponse(&out, &img, &range, tpq, threads);
+    tMt = (nowMs() - t0) / rounds;
+    printf("harris %dx%d: two passes %.2f ms, fused %.2f ms, %d bands %.2f ms\n", w, h, tRef, tOne, threads, tMt);
+}
+
+int main(int argc, char **argv)
+{
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    if (threads < 1 || threads > UTL_BLUR_MAX_TASKS)
+        threads = 4;
+    tp_queue tpq = tpq_create(threads, "filter_test");
+
+    testBlur(tpq, threads);
+    testConvolve(tpq, threads);
+    testBoxBlur(tpq, threads);
+    testHarris(tpq, threads);
+    benchmark(tpq, threads);
+
+    tpq_destroy(tpq);
+    printf("%s\n", g_fail ? "FAIL" : "PASS");
+    return g_fail ? 1 : 0;
+}
@@ -0,0 +1,374 @@
+/*
+ * Test and benchmark of the fixed size and batched solvers of utilMath
+ *
+ *  - residuals of utilMatSolve3x3/4x4/8x8 and utilCholSolve3x3/4x4/8x8
+ *    on random systems, against a double precision residual
+ *  - a homography from 4 point pairs through the 8x8 solver
+ *  - singular and indefinite systems, alone and inside a batch
+ *  - the batched solvers against the single ones for every size and
+ *    batch tails of 1 to 3 systems
+ *  - repeated utilLevmarBcDif calls on one workspace
+ *  - solves per second against utilinverse and utilAxEqBLu
+ *
+ * usage: util_math_test
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <vector>
+
+#include "utilMath/utilMath.h"
+#include "util_test_common.h"
+
+static unsigned int g_seed = 1;
+
+// uniform in [-1, 1)
+static MFLOAT frand()
+{
+    g_seed = g_seed * 1103515245 + 12345;
+    return (MFLOAT)((g_seed >> 8) & 0xffff) / 32768.0f - 1.0f;
+}
+
+// a general system with a condition number in the tens
+static void makeGeneral(MFLOAT *A, MFLOAT *b, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        for (int j = 0; j < n; j++)
+            A[i * n + j] = frand() + (i == j ? 2.0f * (frand() > 0 ? 1 : -1) : 0.0f);
+        b[i] = frand() * 10;
+    }
+}
+
+// M^T M + I / 2
+static void makeSpd(MFLOAT *A, MFLOAT *b, int n)
+{
+    MFLOAT M[64];
+    for (int i = 0; i < n * n; i++)
+        M[i] = frand();
+    for (int i = 0; i < n; i++)
+    {
+        for (int j = 0; j < n; j++)
+        {
+            MFLOAT s = (i == j) ? 0.5f : 0.0f;
+            for (int k = 0; k < n; k++)
+                s += M[k * n + i] * M[k * n + j];
+            A[i * n + j] = s;
+        }
+        b[i] = frand() * 10;
+    }
+}
+
+// ||A x - b|| / (||A|| ||x||) in double
+static double residual(const MFLOAT *A, const MFLOAT *x, const MFLOAT *b, int n)
+{
+    double r = 0, a = 0, xx = 0;
+    for (int i = 0; i < n; i++)
+    {
+        double s = -b[i];
+        for (int j = 0; j < n; j++)
+        {
+            s += (double)A[i * n + j] * x[j];
+            a += (double)A[i * n + j] * A[i * n + j];
+        }
+        r += s * s;
+        xx += (double)x[i] * x[i];
+    }
+    return sqrt(r) / (sqrt(a) * sqrt(xx) + 1e-30);
+}
+
+typedef MBOOL (*SolveFunc)(MFLOAT *x, const MFLOAT *A, const MFLOAT *b);
+
+static void testAccuracy()
+{
+    const int sizes[] = { 3, 4, 8 };
+    const SolveFunc lu[] = { utilMatSolve3x3, utilMatSolve4x4, utilMatSolve8x8 };
+    const SolveFunc chol[] = { utilCholSolve3x3, utilCholSolve4x4, utilCholSolve8x8 };
+
+    for (int s = 0; s < 3; s++)
+    {
+        int n = sizes[s];
+        double worstLu = 0, worstChol = 0;
+        int bad = 0;
+        for (int t = 0; t < 2000; t++)
+        {
+            MFLOAT A[64], b[8], x[8];
+            makeGeneral(A, b, n);
+            bad += !lu[s](x, A, b);
+            worstLu = fmax(worstLu, residual(A, x, b, n));
+            makeSpd(A, b, n);
+            bad += !chol[s](x, A, b);
+            worstChol = fmax(worstChol, residual(A, x, b, n));
+        }
+        CHECK(bad == 0, "%dx%d: %d systems not solved", n, n, bad);
+        CHECK(worstLu < 1e-5 && worstChol < 1e-5, "%dx%d: residual %g LU %g Cholesky", n, n, worstLu, worstChol);
+        printf("%dx%d worst relative residual: LU %.2e, Cholesky %.2e\n", n, n, worstLu, worstChol);
+    }
+}
+
+static void testHomography()
+{
+    // H maps (u, v) to (x, y), h22 = 1
+    const MFLOAT H[9] = { 1.05f, 0.02f, 0.1f, -0.03f, 0.97f, -0.05f, 0.01f, -0.02f, 1.0f };
+    const MFLOAT u[4] = { -1, 1, 1, -1 }, v[4] = { -1, -1, 1, 1 };
+    MFLOAT A[64], b[8], h[8];
+
+    for (int k = 0; k < 4; k++)
+    {
+        MFLOAT w = H[6] * u[k] + H[7] * v[k] + 1;
+        MFLOAT x = (H[0] * u[k] + H[1] * v[k] + H[2]) / w, y = (H[3] * u[k] + H[4] * v[k] + H[5]) / w;
+        MFLOAT r0[8] = { u[k], v[k], 1, 0, 0, 0, -u[k] * x, -v[k] * x };
+        MFLOAT r1[8] = { 0, 0, 0, u[k], v[k], 1, -u[k] * y, -v[k] * y };
+        memcpy(&A[(2 * k) * 8], r0, sizeof(r0));
+        memcpy(&A[(2 * k + 1) * 8], r1, sizeof(r1));
+        b[2 * k] = x;
+        b[2 * k + 1] = y;
+    }
+    CHECK(utilMatSolve8x8(h, A, b), "homography not solved");
+    double err = 0;
+    for (int i = 0; i < 8; i++)
+        err = fmax(err, fabs(h[i] - H[i]));
+    CHECK(err < 1e-5, "homography error %g", err);
+}
+
+static void testSingular()
+{
+    MFLOAT A[64], b[8], x[8];
+
+    memset(A, 0, sizeof(A));
+    for (int i = 0; i < 8; i++)
+        b[i] = x[i] = 1;
+    CHECK(!utilMatSolve3x3(x, A, b) && x[0] == 0 && x[2] == 0, "zero 3x3");
+    CHECK(!utilCholSolve8x8(x, A, b) && x[7] == 0, "zero 8x8 Cholesky");
+
+    // two equal rows
+    for (int i = 0; i < 16; i++)
+        A[i] = (MFLOAT)(i % 4 * 3 + i / 4 + (i == 5));
+    memcpy(&A[8], &A[4], 4 * sizeof(MFLOAT));
+    CHECK(!utilMatSolve4x4(x, A, b), "rank deficient 4x4");
+
+    // indefinite
+    const MFLOAT S[9] = { 1, 2, 0, 2, 1, 0, 0, 0, 1 };
+    CHECK(!utilCholSolve3x3(x, S, b), "indefinite 3x3");
+    CHECK(utilMatSolve3x3(x, S, b), "indefinite 3x3 by LU");
+
+    const MFLOAT N[9] = { NAN, 0, 0, 0, 1, 0, 0, 0, 1 };
+    CHECK(!utilMatSolve3x3(x, N, b) || !utilCholSolve3x3(x, N, b), "NaN");
+}
+
+static void testBatch()
+{
+    const int maxNum = 11;
+    MUINT8 flags[maxNum], one;
+
+    for (int n = 1; n <= UTL_MAT_MAX_DIM; n++)
+    {
+        for (int num = 0; num <= maxNum; num++)
+        {
+            std::vector<MFLOAT> A(num * n * n + 1), b(num * n + 1), x(num * n + 1), ref(n);
+            for (int mode = 0; mode < 2; mode++)
+            {
+                for (int k = 0; k < num; k++)
+                {
+                    if (mode == 0)
+                        makeGeneral(&A[k * n * n], &b[k * n], n);
+                    else
+                        makeSpd(&A[k * n * n], &b[k * n], n);
+                }
+                // every third system fails, a zero row for LU and a negative pivot for Cholesky
+                for (int k = 2; k < num; k += 3)
+                {
+                    for (int j = 0; j < n && mode == 0; j++)
+                        A[k * n * n + (n - 1) * n + j] = 0;
+                    if (mode == 1)
+                        A[k * n * n + (n - 1) * n + (n - 1)] = -1000.0f;
+                }
+
+                memset(flags, 0xff, sizeof(flags));
+                UTIL_ERRCODE_ENUM ret = mode == 0 ? utilMatSolveBatch(&x[0], &A[0], &b[0], n, num, flags)
+                                                  : utilCholSolveBatch(&x[0], &A[0], &b[0], n, num, flags);
+                CHECK(ret == UTIL_OK, "batch n %d num %d", n, num);
+
+                int bad = 0;
+                for (int k = 0; k < num; k++)
+                {
+                    MBOOL expect = (k % 3 != 2);
+                    bad += flags[k] != expect;
+                    std::vector<MFLOAT> one_x(n);
+                    // the single solves of the sizes that have them
+                    std::vector<MFLOAT> Ak(&A[k * n * n], &A[k * n * n] + n * n);
+                    if (mode == 0)
+                        utilMatSolveBatch(&ref[0], &Ak[0], &b[k * n], n, 1, &one);
+                    else
+                        utilCholSolveBatch(&ref[0], &Ak[0], &b[k * n], n, 1, &one);
+                    bad += one != flags[k];
+                    for (int i = 0; i < n; i++)
+                    {
+                        MFLOAT d = fabsf(x[k * n + i] - ref[i]);
+                        bad += !(d <= 1e-4f * (1 + fabsf(ref[i])));
+                        bad += !flags[k] && x[k * n + i] != 0;
+                    }
+                    if (flags[k])
+                        bad += !(residual(&A[k * n * n], &x[k * n], &b[k * n], n) < 1e-5);
+                }
+                CHECK(bad == 0, "%s batch n %d num %d: %d bad", mode ? "Cholesky" : "LU", n, num, bad);
+            }
+        }
+    }
+
+    // the batch against the fixed size entry points
+    MFLOAT A[4][64], b[4][8], x[4][8], y[8];
+    for (int k = 0; k < 4; k++)
+        makeSpd(A[k], b[k], 8);
+    utilCholSolveBatch(&x[0][0], &A[0][0], &b[0][0], 8, 4, NULL);
+    for (int k = 0; k < 4; k++)
+    {
+        utilCholSolve8x8(y, A[k], b[k]);
+        for (int i = 0; i < 8; i++)
+            CHECK(fabsf(x[k][i] - y[i]) <= 1e-5f * (1 + fabsf(y[i])), "8x8 batch %d[%d] %g %g", k, i, x[k][i], y[i]);
+    }
+
+    MFLOAT v;
+    CHECK(utilMatSolveBatch(NULL, &v, &v, 1, 1, NULL) == UTIL_COMMON_ERR_NULL_BUFFER_POINTER, "NULL x");
+    CHECK(utilCholSolveBatch(&v, &v, &v, 9, 1, NULL) == UTIL_COMMON_ERR_INVALID_PARAMETER, "n 9");
+    CHECK(utilCholSolveBatch(&v, &v, &v, 0, 1, NULL) == UTIL_COMMON_ERR_INVALID_PARAMETER, "n 0");
+    CHECK(utilMatSolveBatch(&v, &v, &v, 2, -1, NULL) == UTIL_COMMON_ERR_INVALID_PARAMETER, "num -1");
+}
+
+/*
+ * Levmar, fit y = 1000 (p0 t + p1 t^2 + ...) on one workspace; the solver
+ * stops once the squared error falls to the number of measurements
+ */
+
+static const int LM_MEASURE = 24;
+static int g_lm_para = 2;
+
+static void polyCost(MFLOAT *p, MFLOAT *hx)
+{
+    for (int i = 0; i < LM_MEASURE; i++)
+    {
+        MFLOAT t = (MFLOAT)i / LM_MEASURE, tk = t, sum = 0;
+        for (int k = 0; k < g_lm_para; k++, tk *= t)
+            sum += p[k] * tk;
+        hx[i] = 1000 * sum;
+    }
+}
+
+static void testLevmar()
+{
+    // 6 unknowns, where the Jacobian is larger than the query used to cover
+    for (g_lm_para = 2; g_lm_para <= 6; g_lm_para += 4)
+    {
+        const MINT32 size = utilLevmarBufferSizeQuery(g_lm_para, LM_MEASURE, 1, 1);
+        const MINT32 guard = 64;
+        std::vector<MUINT8> buf(size + guard, 0xA5);
+        std::vector<MFLOAT> q(g_lm_para);
+        LEVMAR_CAL_STRUCT lm;
+        memset(&lm, 0, sizeof(lm));
+        utilLevmarInit(&lm, &buf[0], g_lm_para, LM_MEASURE, polyCost);
+        size_t work = lm.ProcBufAddr;
+
+        int bad = 0;
+        for (int r = 0; r < 100; r++)
+        {
+            for (int k = 0; k < g_lm_para; k++)
+            {
+                q[k] = 0.5f * frand();
+                lm.p[k] = 0;
+            }
+            polyCost(&q[0], lm.x);
+            memset(lm.info, 0, sizeof(lm.info));
+            MINT32 iter = utilLevmarBcDif(&lm, 200);
+            bad += iter < 0 || !(lm.info[1] <= LM_MEASURE);
+            if (g_lm_para == 2)
+                bad += fabsf(lm.p[0] - q[0]) > 1e-2f || fabsf(lm.p[1] - q[1]) > 1e-2f;
+            bad += lm.ProcBufAddr != work;
+        }
+        CHECK(bad == 0, "levmar %d unknowns: %d of 100 fits wrong", g_lm_para, bad);
+
+        int guardBad = 0;
+        for (int i = size; i < size + guard; i++)
+            guardBad += buf[i] != 0xA5;
+        CHECK(guardBad == 0, "levmar %d unknowns wrote %d bytes past the queried size", g_lm_para, guardBad);
+    }
+}
+
+/*
+ * benchmark
+ */
+
+static void benchmark()
+{
+    const int sizes[] = { 3, 4, 8 };
+    const SolveFunc lu[] = { utilMatSolve3x3, utilMatSolve4x4, utilMatSolve8x8 };
+    const SolveFunc chol[] = { utilCholSolve3x3, utilCholSolve4x4, utilCholSolve8x8 };
+    const int num = 1024, reps = 200;
+
+    printf("%6s %12s %12s %12s %12s %12s  (M solves/s)\n", "size", "utilinverse", "utilAxEqBLu", "MatSolve", "CholSolve",
+           "CholBatch");
+    for (int s = 0; s < 3; s++)
+    {
+        int n = sizes[s];
+        std::vector<MFLOAT> A(num * n * n), b(num * n), x(num * n), tmp(n * n);
+        std::vector<MFLOAT> work((n + 2) * n + n);
+        for (int k = 0; k < num; k++)
+            makeSpd(&A[k * n * n], &b[k * n], n);
+
+        double rate[5];
+        for (int m = 0; m < 5; m++)
+        {
+            double t0 = nowMs();
+            for (int r = 0; r < reps; r++)
+            {
+                if (m == 4)
+                {
+                    utilCholSolveBatch(&x[0], &A[0], &b[0], n, num, NULL);
+                    continue;
+                }
+                for (int k = 0; k < num; k++)
+                {
+                    MFLOAT *Ak = &A[k * n * n], *bk = &b[k * n], *xk = &x[k * n];
+                    switch (m)
+                    {
+                        case 0:
+                        {
+                            // utilinverse works in place on M
+                            MFLOAT M[64], Mi[64];
+                            memcpy(M, Ak, n * n * sizeof(MFLOAT));
+                            utilinverse(M, n, Mi);
+                            for (int i = 0; i < n; i++)
+                            {
+                                MFLOAT sum = 0;
+                                for (int j = 0; j < n; j++)
+                                    sum += Mi[i * n + j] * bk[j];
+                                xk[i] = sum;
+                            }
+                            break;
+                        }
+                        case 1: utilAxEqBLu(Ak, bk, xk, n, (size_t)&work[0]); break;
+                        case 2: lu[s](xk, Ak, bk); break;
+                        default: chol[s](xk, Ak, bk); break;
+                    }
+                }
+                __asm__ __volatile__("" : : "r"(&x[0]) : "memory");
+            }
+            rate[m] = (double)num * reps / ((nowMs() - t0) * 1000.0);
+        }
+        printf("%4dx%d %12.2f %12.2f %12.2f %12.2f %12.2f\n", n, n, rate[0], rate[1], rate[2], rate[3], rate[4]);
+    }
+}
+
+int main()
+{
+    testAccuracy();
+    testHomography();
+    testSingular();
+    testBatch();
+    testLevmar();
+    benchmark();
+
+    printf("%s\n", g_fail ? "FAIL" : "PASS");
+    return g_fail ? 1 : 0;
+}
@@ -0,0 +1,464 @@
+/*
+ * Test and benchmark of the zone profiler
+ *
+ *  - nested zones on the calling thread and zones on tpq threads
+ *  - a ring overflow keeps the newest UTL_PROF_RING_SIZE zones
+ *  - utilProfStart drops the zones of the previous run
+ *  - rings of exited threads are reused, more threads than
+ *    UTL_PROF_MAX_THREADS over several runs
+ *  - the Chrome JSON events and the Perfetto begin / end pairs
+ *  - cost of a zone with the profiler started and stopped, the median
+ *    of several rounds
+ *  - a demo trace of UtlColorConvert bands and CoreCpuWarp frames
+ *
+ * usage: util_prof_test [output directory, default $TMPDIR or /tmp]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "utilSystem/utilProf.h"
+#include "utilTransform/utilColorConvert.h"
+#include "coreCpuWarp.h"
+#include "util_test_common.h"
+
+static std::string g_dir;
+
+/*
+ * Chrome JSON, one event per line
+ */
+
+struct JsonZone
+{
+    std::string name;
+    int tid;
+    double ts, dur;
+};
+
+static std::vector<JsonZone> readJson(const std::string &path, int *numThreads)
+{
+    std::vector<JsonZone> zones;
+    FILE *fp = fopen(path.c_str(), "r");
+    char line[512];
+
+    *numThreads = 0;
+    if (fp == NULL)
+        return zones;
+    while (fgets(line, sizeof(line), fp))
+    {
+        char name[128];
+        JsonZone z;
+        int pid;
+
+        if (strstr(line, "\"ph\":\"M\""))
+            (*numThreads)++;
+        if (sscanf(line, "{\"ph\":\"X\",\"name\":\"%127[^\"]\",\"pid\":%d,\"tid\":%d,\"ts\":%lf,\"dur\":%lf}",
+                   name, &pid, &z.tid, &z.ts, &z.dur) == 5)
+        {
+            z.name = name;
+            zones.push_back(z);
+        }
+    }
+    fclose(fp);
+    return zones;
+}
+
+static int countZones(const std::vector<JsonZone> &zones, const char *name)
+{
+    int n = 0;
+    for (size_t i = 0; i < zones.size(); i++)
+        n += zones[i].name == name;
+    return n;
+}
+
+/*
+ * Perfetto, decode the packets back into begin / end counts per track
+ */
+
+static bool readVarint(const MUINT8 *&p, const MUINT8 *end, MUINT64 *v)
+{
+    *v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7)
+    {
+        MUINT8 b = *p++;
+        *v |= (MUINT64)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return true;
+    }
+    return false;
+}
+
+// calls fn(field, value, data, size) for each varint or bytes field
+template <typename F>
+static bool readFields(const MUINT8 *p, const MUINT8 *end, F fn)
+{
+    while (p < end)
+    {
+        MUINT64 tag, v;
+        if (!readVarint(p, end, &tag))
+            return false;
+        if ((tag & 7) == 0)
+        {
+            if (!readVarint(p, end, &v))
+                return false;
+            fn((int)(tag >> 3), v, (const MUINT8 *)NULL, 0);
+        }
+        else if ((tag & 7) == 2)
+        {
+            if (!readVarint(p, end, &v) || v > (MUINT64)(end - p))
+                return false;
+            fn((int)(tag >> 3), 0, p, (size_t)v);
+            p += v;
+        }
+        else
+            return false;
+    }
+    return true;
+}
+
+struct PerfettoStats
+{
+    int tracks, begins, ends, badNesting, badTime;
+    std::vector<int> depth;
+    std::vector<MUINT64> lastTs;
+};
+
+static bool readPerfetto(const std::string &path, PerfettoStats *st)
+{
+    std::vector<MUINT8> buf;
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (fp == NULL)
+        return false;
+    MUINT8 tmp[4096];
+    size_t n;
+    while ((n = fread(tmp, 1, sizeof(tmp), fp)) > 0)
+        buf.insert(buf.end(), tmp, tmp + n);
+    fclose(fp);
+
+    st->tracks = st->begins = st->ends = st->badNesting = st->badTime = 0;
+    st->depth.assign(UTL_PROF_MAX_THREADS + 1, 0);
+    st->lastTs.assign(UTL_PROF_MAX_THREADS + 1, 0);
+    bool ok = true;
+
+    ok &= readFields(buf.data(), buf.data() + buf.size(), [&](int field, MUINT64, const MUINT8 *data, size_t size) {
+        if (field != 1 || data == NULL)
+        {
+            ok = false;
+            return;
+        }
+        MUINT64 ts = 0, type = 0, uuid = 0;
+        bool isEvent = false;
+        ok &= readFields(data, data + size, [&](int f, MUINT64 v, const MUINT8 *d, size_t s) {
+            if (f == 8)
+                ts = v;
+            else if (f == 60)
+                st->tracks++;
+            else if (f == 11 && d)
+            {
+                isEvent = true;
+                ok &= readFields(d, d + s, [&](int ef, MUINT64 ev, const MUINT8 *, size_t) {
+                    if (ef == 9)
+                        type = ev;
+                    else if (ef == 11)
+                        uuid = ev;
+                });
+            }
+        });
+        if (!isEvent)
+            return;
+        if (uuid == 0 || uuid > UTL_PROF_MAX_THREADS)
+        {
+            ok = false;
+            return;
+        }
+        st->badTime += ts < st->lastTs[uuid];
+        st->lastTs[uuid] = ts;
+        if (type == 1)
+        {
+            st->begins++;
+            st->depth[uuid]++;
+        }
+        else if (type == 2)
+        {
+            st->ends++;
+            st->badNesting += --st->depth[uuid] < 0;
+        }
+    });
+    for (size_t i = 0; i < st->depth.size(); i++)
+        st->badNesting += st->depth[i] != 0;
+    return ok;
+}
+
+/*
+ * tests
+ */
+
+static void *zoneJob(void *arg, rtinfo *info)
+{
+    (void)arg;
+    (void)info;
+    UTIL_PROF_ZONE("job");
+    volatile int sum = 0;
+    for (int i = 0; i < 10000; i++)
+        sum += i;
+    return NULL;
+}
+
+static void testZones()
+{
+    const int numJobs = 20;
+    tp_queue tpq = tpq_create(3, "prof_test");
+    std::string json = g_dir + "/util_prof_test.json";
+    std::string pb = g_dir + "/util_prof_test.perfetto-trace";
+
+    {
+        UTIL_PROF_ZONE("before start");
+    }
+    utilProfStart();
+    {
+        UTIL_PROF_ZONE("outer");
+        {
+            UTIL_PROF_ZONE("inner");
+            for (int i = 0; i < numJobs; i++)
+                tpq_add_work(tpq, zoneJob, NULL);
+            tpq_exec(tpq, 0);
+        }
+    }
+    utilProfStop();
+    {
+        UTIL_PROF_ZONE("after stop");
+    }
+
+    CHECK(utilProfExport(json.c_str(), UTIL_PROF_CHROME_JSON) == UTIL_OK, "export %s", json.c_str());
+    int numThreads;
+    std::vector<JsonZone> zones = readJson(json, &numThreads);
+    CHECK(countZones(zones, "outer") == 1 && countZones(zones, "inner") == 1, "nested zones");
+    CHECK(countZones(zones, "job") == numJobs, "%d of %d job zones", countZones(zones, "job"), numJobs);
+    CHECK(countZones(zones, "before start") == 0 && countZones(zones, "after stop") == 0, "zones while stopped");
+    CHECK(numThreads >= 2, "%d thread names", numThreads);
+
+    const JsonZone *outer = NULL, *inner = NULL;
+    for (size_t i = 0; i < zones.size(); i++)
+    {
+        CHECK(zones[i].ts >= 0 && zones[i].dur >= 0, "zone %s at %.3f for %.3f us",
+              zones[i].name.c_str(), zones[i].ts, zones[i].dur);
+        if (zones[i].name == "outer")
+            outer = &zones[i];
+        if (zones[i].name == "inner")
+            inner = &zones[i];
+    }
+    if (outer && inner)
+        CHECK(outer->tid == inner->tid && outer->ts <= inner->ts &&
+              inner->ts + inner->dur <= outer->ts + outer->dur + 0.002, "inner zone outside outer zone");
+
+    PerfettoStats st;
+    CHECK(utilProfExport(pb.c_str(), UTIL_PROF_PERFETTO_PROTO) == UTIL_OK, "export %s", pb.c_str());
+    CHECK(readPerfetto(pb, &st), "decode %s", pb.c_str());
+    CHECK(st.begins == numJobs + 2 && st.ends == st.begins, "%d begins %d ends", st.begins, st.ends);
+    CHECK(st.tracks == numThreads && st.badNesting == 0 && st.badTime == 0,
+          "%d tracks, %d bad nesting, %d bad order", st.tracks, st.badNesting, st.badTime);
+
+    // a new start drops the zones above
+    utilProfStart();
+    utilProfStop();
+    CHECK(utilProfExport(json.c_str(), UTIL_PROF_CHROME_JSON) == UTIL_OK, "export %s", json.c_str());
+    CHECK(readJson(json, &numThreads).empty(), "zones kept after restart");
+
+    CHECK(utilProfExport(NULL, UTIL_PROF_CHROME_JSON) == UTIL_COMMON_ERR_INVALID_PARAMETER, "NULL path");
+    CHECK(utilProfExport("/nonexistent/dir/trace.json", UTIL_PROF_CHROME_JSON) == UTIL_COMMON_ERR_INVALID_PARAMETER,
+          "bad path");
+
+    tpq_destroy(tpq);
+}
+
+static void testOverflow()
+{
+    std::string json = g_dir + "/util_prof_test.json";
+    std::string pb = g_dir + "/util_prof_test.perfetto-trace";
+
+    utilProfStart();
+    std::thread t([] {
+        for (int i = 0; i < 100; i++)
+        {
+            UTIL_PROF_ZONE("dropped");
+        }
+        for (int i = 0; i < UTL_PROF_RING_SIZE; i++)
+        {
+            UTIL_PROF_ZONE("kept");
+        }
+    });
+    t.join();
+    utilProfStop();
+
+    int numThreads;
+    CHECK(utilProfExport(json.c_str(), UTIL_PROF_CHROME_JSON) == UTIL_OK, "export %s", json.c_str());
+    std::vector<JsonZone> zones = readJson(json, &numThreads);
+    CHECK(countZones(zones, "kept") == UTL_PROF_RING_SIZE && countZones(zones, "dropped") == 0,
+          "overflow: %d kept %d dropped", countZones(zones, "kept"), countZones(zones, "dropped"));
+
+    PerfettoStats st;
+    CHECK(utilProfExport(pb.c_str(), UTIL_PROF_PERFETTO_PROTO) == UTIL_OK && readPerfetto(pb, &st) &&
+          st.begins == UTL_PROF_RING_SIZE && st.ends == st.begins && st.badNesting == 0,
+          "overflow perfetto: %d begins %d ends", st.begins, st.ends);
+}
+
+// threads that come and go, as the workers of a tpq created per frame
+static void testThreadExit()
+{
+    const int rounds = 4, threadsPerRound = UTL_PROF_MAX_THREADS / 2;
+    std::string json = g_dir + "/util_prof_test.json";
+
+    for (int r = 0; r < rounds; r++)
+    {
+        utilProfStart();
+        for (int i = 0; i < threadsPerRound; i++)
+        {
+            std::thread t([] {
+                UTIL_PROF_ZONE("short thread");
+            });
+            t.join();
+        }
+        utilProfStop();
+
+        int numThreads;
+        CHECK(utilProfExport(json.c_str(), UTIL_PROF_CHROME_JSON) == UTIL_OK, "export %s", json.c_str());
+        std::vector<JsonZone> zones = readJson(json, &numThreads);
+        CHECK(countZones(zones, "short thread") == threadsPerRound,
+              "round %d: %d of %d zones of exited threads", r, countZones(zones, "short thread"), threadsPerRound);
+    }
+}
+
+/*
+ * benchmark
+ */
+
+static void benchmark()
+{
+    const int reps = 200000, rounds = 9;
+    double t[2];
+
+    for (int k = 0; k < 2; k++)
+    {
+        std::vector<double> round(rounds);
+        for (int r = 0; r < rounds; r++)
+        {
+            if (k == 0)
+                utilProfStart();
+            double t0 = nowMs();
+            for (int i = 0; i < reps; i++)
+            {
+                UTIL_PROF_ZONE("bench");
+                __asm__ __volatile__("" : : : "memory");
+            }
+            round[r] = (nowMs() - t0) * 1e6 / reps;
+            utilProfStop();
+        }
+        std::sort(round.begin(), round.end());
+        t[k] = round[rounds / 2];
+    }
+    printf("zone cost, median of %d rounds: %.1f ns started, %.1f ns stopped\n", rounds, t[0], t[1]);
+    CHECK(t[0] < 500, "zone cost %.1f ns", t[0]);
+}
+
+/*
+ * demo, a trace of color conversion and CPU warping frames
+ */
+
+static void demo()
+{
+    const int W = 1920, H = 1080, gw = 33, gh = 19, frames = 8;
+    tp_queue tpq = tpq_create(4, "prof_demo");
+    std::vector<MUINT8> yuv(W * H * 3 / 2), rgba(W * H * 4), warped(W * H * 3 / 2);
+    std::vector<int> mapX(gw * gh), mapY(gw * gh);
+    fillRandom(yuv, 4);
+
+    // a small zoom about the center, in 1/16 pixels, kept inside the image
+    for (int y = 0; y < gh; y++)
+    {
+        for (int x = 0; x < gw; x++)
+        {
+            double sx = (W - 1) * (0.5 + 0.95 * ((double)x / (gw - 1) - 0.5));
+            double sy = (H - 1) * (0.5 + 0.95 * ((double)y / (gh - 1) - 0.5));
+            mapX[y * gw + x] = (int)(sx * 16);
+            mapY[y * gw + x] = (int)(sy * 16);
+        }
+    }
+
+    CoreCpuWarp warp;
+    memset(&warp.core_info, 0, sizeof(warp.core_info));
+    warp.core_info.Width = W;
+    warp.core_info.Height = H;
+    warp.core_info.ClipWidth = W;
+    warp.core_info.ClipHeight = H;
+    warp.core_info.ImgFmt = CPU_WARP_IMAGE_YUV420;
+    warp.core_info.OutImgFmt = CPU_WARP_IMAGE_YUV420;
+    warp.core_info.SrcBuffer = &yuv[0];
+    warp.core_info.DstBuffer = &warped[0];
+    warp.core_info.WarpMapNum = 1;
+    warp.core_info.WarpMapAddr[0][0] = (MUINT32 *)&mapX[0];
+    warp.core_info.WarpMapAddr[0][1] = (MUINT32 *)&mapY[0];
+    warp.core_info.WarpMapSize[0][0] = gw;
+    warp.core_info.WarpMapSize[0][1] = gh;
+    warp.CpuWarpingInit();
+
+    UTIL_BASE_IMAGE_STRUCT src = { W, H, &warped[0] }, dst = { W, H, &rgba[0] };
+    double t0 = nowMs();
+    utilProfStart();
+    for (int f = 0; f < frames; f++)
+    {
+        UTIL_PROF_ZONE("frame");
+        {
+            UTIL_PROF_ZONE("CpuWarpingMain");
+            warp.CpuWarpingMain();
+        }
+        CHECK(UtlColorConvert(&src, UTL_IMAGE_FORMAT_YUV420, &dst, UTL_IMAGE_FORMAT_RGBA8888,
+                              UTIL_COLOR_BT601_FULL, tpq, 8) == UTIL_OK, "demo color convert");
+    }
+    utilProfStop();
+    double t1 = nowMs();
+    warp.CpuWarpingReset();
+
+    std::string json = g_dir + "/util_prof_demo.json";
+    std::string pb = g_dir + "/util_prof_demo.perfetto-trace";
+    CHECK(utilProfExport(json.c_str(), UTIL_PROF_CHROME_JSON) == UTIL_OK, "export %s", json.c_str());
+    CHECK(utilProfExport(pb.c_str(), UTIL_PROF_PERFETTO_PROTO) == UTIL_OK, "export %s", pb.c_str());
+
+    int numThreads;
+    std::vector<JsonZone> zones = readJson(json, &numThreads);
+    CHECK(countZones(zones, "frame") == frames && countZones(zones, "CpuWarpingMain") == frames &&
+          countZones(zones, "UtlColorConvert") == frames && countZones(zones, "UtlColorConvert band") == frames * 8,
+          "demo zones");
+    double warpUs = 0, colorUs = 0;
+    for (size_t i = 0; i < zones.size(); i++)
+    {
+        if (zones[i].name == "CpuWarpingMain")
+            warpUs += zones[i].dur;
+        if (zones[i].name == "UtlColorConvert")
+            colorUs += zones[i].dur;
+    }
+    printf("demo: %d frames %dx%d in %.1f ms, CpuWarpingMain %.2f ms, UtlColorConvert %.2f ms per frame\n",
+           frames, W, H, t1 - t0, warpUs / 1000 / frames, colorUs / 1000 / frames);
+    printf("demo traces: %s %s\n", json.c_str(), pb.c_str());
+
+    tpq_destroy(tpq);
+}
+
+int main(int argc, char **argv)
+{
+    const char *tmp = getenv("TMPDIR");
+    g_dir = argc > 1 ? argv[1] : (tmp != NULL && tmp[0] ? tmp : "/tmp");
+
+    testZones();
+    testOverflow();
+    testThreadExit();
+    benchmark();
+    demo();
+
+    printf("%s\n", g_fail ? "FAIL" : "PASS");
+    return g_fail ? 1 : 0;
+}
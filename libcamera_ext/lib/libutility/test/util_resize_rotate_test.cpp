@@ -0,0 +1,309 @@
+/*
+ * Test and benchmark of utilResizer, utilRotate and utilMirror
+ *
+ *  - UTIL_RESIZE_BILINEAR gives the output of the per-pixel bilinear loop
+ *    utilBilinearResizer had, UTIL_RESIZE_AREA is within 1 of a box filter
+ *  - the rotations and mirrors give the output of the per-pixel mapping,
+ *    with clips and sizes which are not multiples of the blocks
+ *  - the bands on a tpq give the same result as one band
+ *  - the time of each, per-pixel reference vs one band vs bands on tpq
+ *
+ * usage: util_resize_rotate_test [threads]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "utilTransform/utilResize.h"
+#include "utilTransform/utilRotate.h"
+#include "util_test_common.h"
+
+/*
+ * references
+ */
+
+// the per-pixel loop of utilBilinearResizer for YUV400
+static void refBilinear(std::vector<MUINT8> &dst, int dw, int dh, const std::vector<MUINT8> &src, int sw, int sh)
+{
+    MUINT32 step_x = UTL_IUL_I_TO_X(sw) / dw;
+    MUINT32 step_y = UTL_IUL_I_TO_X(sh) / dh;
+    MUINT32 coord_y = 0;
+    dst.resize(dw * dh);
+    for (int y = 0; y < dh; y++, coord_y += step_y)
+    {
+        const MUINT8 *row1 = &src[UTL_IUL_X_TO_I_CHOP(coord_y) * sw];
+        const MUINT8 *row2 = &src[UTL_IUL_X_TO_I_CARRY(coord_y) * sw];
+        MUINT32 coord_x = 0;
+        for (int x = 0; x < dw; x++, coord_x += step_x)
+        {
+            int chop = UTL_IUL_X_TO_I_CHOP(coord_x);
+            int carry = UTL_IUL_X_TO_I_CARRY(coord_x);
+            int w = UTL_IUL_X_FRACTION(coord_x);
+            int v1 = LINEAR_INTERPOLATION(row1[chop], row1[carry], w);
+            int v2 = LINEAR_INTERPOLATION(row2[chop], row2[carry], w);
+            dst[y * dw + x] = (MUINT8)LINEAR_INTERPOLATION(v1, v2, (int)UTL_IUL_X_FRACTION(coord_y));
+        }
+    }
+}
+
+// average of the covered source area, in double
+static void refArea(std::vector<MUINT8> &dst, int dw, int dh, const std::vector<MUINT8> &src, int sw, int sh)
+{
+    dst.resize(dw * dh);
+    for (int y = 0; y < dh; y++)
+    {
+        double y0 = (double)y * sh / dh, y1 = (double)(y + 1) * sh / dh;
+        for (int x = 0; x < dw; x++)
+        {
+            double x0 = (double)x * sw / dw, x1 = (double)(x + 1) * sw / dw;
+            double sum = 0;
+            for (int j = (int)y0; j < sh && j < y1; j++)
+            {
+                double wy = ((j + 1 < y1) ? j + 1 : y1) - ((j > y0) ? j : y0);
+                for (int i = (int)x0; i < sw && i < x1; i++)
+                {
+                    double wx = ((i + 1 < x1) ? i + 1 : x1) - ((i > x0) ? i : x0);
+                    sum += wx * wy * src[j * sw + i];
+                }
+            }
+            dst[y * dw + x] = (MUINT8)(sum / ((x1 - x0) * (y1 - y0)) + 0.5);
+        }
+    }
+}
+
+// the mapping of each angle, as the row and column walks of utilRotate and utilMirror
+static void refRotate(UTIL_CLIP_IMAGE_STRUCT *dst, const UTIL_CLIP_IMAGE_STRUCT *src, UTIL_ANGLE angle, bool mirror)
+{
+    const MUINT8 *s = (const MUINT8 *)src->data;
+    MUINT8 *d = (MUINT8 *)dst->data;
+    int dw = dst->clip_width, dh = dst->clip_height;
+    for (int y = 0; y < src->clip_height; y++)
+    {
+        for (int x = 0; x < src->clip_width; x++)
+        {
+            int row, col;
+            switch (angle)
+            {
+                case UTIL_ANGLE_000: row = y;                          col = mirror ? dw - 1 - x : x;  break;
+                case UTIL_ANGLE_090: row = x;                          col = mirror ? y : dw - 1 - y;  break;
+                case UTIL_ANGLE_180: row = dh - 1 - y;                 col = mirror ? x : dw - 1 - x;  break;
+                default:             row = dh - 1 - x;                 col = mirror ? dw - 1 - y : y;  break;
+            }
+            d[(dst->clip_y + row) * dst->width + dst->clip_x + col] =
+                s[(src->clip_y + y) * src->width + src->clip_x + x];
+        }
+    }
+}
+
+/*
+ * tests
+ */
+static void testResize(tp_queue tpq)
+{
+    // downscales, and upscales which do not read past the source
+    static const int sizes[][4] =
+    {
+        { 64, 48, 32, 24 }, { 100, 80, 37, 29 }, { 640, 480, 320, 240 }, { 33, 17, 16, 9 },
+        { 200, 150, 199, 149 }, { 1000, 750, 96, 72 }, { 17, 9, 17, 9 },
+    };
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        int sw = sizes[s][0], sh = sizes[s][1], dw = sizes[s][2], dh = sizes[s][3];
+        std::vector<MUINT8> src(sw * sh), ref, out(dw * dh), out_mt(dw * dh);
+        UTIL_BASE_IMAGE_STRUCT src_img = { sw, sh, src.data() };
+        UTIL_BASE_IMAGE_STRUCT dst_img = { dw, dh, out.data() };
+        UTIL_BASE_IMAGE_STRUCT dst_mt_img = { dw, dh, out_mt.data() };
+        fillRandom(src, sw + sh * 7);
+
+        refBilinear(ref, dw, dh, src, sw, sh);
+        CHECK(utilBilinearResizer(&dst_img, &src_img, UTL_IMAGE_FORMAT_YUV400) == UTIL_OK, "bilinear %dx%d", sw, sh);
+        CHECK(out == ref, "bilinear %dx%d -> %dx%d differs from the reference", sw, sh, dw, dh);
+        utilResizer(&dst_mt_img, &src_img, UTL_IMAGE_FORMAT_YUV400, UTIL_RESIZE_BILINEAR, tpq, 5);
+        CHECK(out_mt == ref, "bilinear %dx%d -> %dx%d in bands differs", sw, sh, dw, dh);
+
+        refArea(ref, dw, dh, src, sw, sh);
+        CHECK(utilResizer(&dst_img, &src_img, UTL_IMAGE_FORMAT_YUV400, UTIL_RESIZE_AREA, NULL, 1) == UTIL_OK,
+              "area %dx%d", sw, sh);
+        int diff = 0;
+        for (int i = 0; i < dw * dh; i++)
+            diff = (abs(out[i] - ref[i]) > diff) ? abs(out[i] - ref[i]) : diff;
+        CHECK(diff <= 1, "area %dx%d -> %dx%d is %d from the reference", sw, sh, dw, dh, diff);
+        utilResizer(&dst_mt_img, &src_img, UTL_IMAGE_FORMAT_YUV400, UTIL_RESIZE_AREA, tpq, 5);
+        CHECK(out_mt == out, "area %dx%d -> %dx%d in bands differs", sw, sh, dw, dh);
+    }
+
+    // I420 is the three planes resized one by one
+    {
+        std::vector<MUINT8> src(64 * 48 * 3 / 2), out(32 * 24 * 3 / 2), plane(16 * 12);
+        UTIL_BASE_IMAGE_STRUCT src_img = { 64, 48, src.data() };
+        UTIL_BASE_IMAGE_STRUCT dst_img = { 32, 24, out.data() };
+        UTIL_BASE_IMAGE_STRUCT src_v = { 32, 24, src.data() + 64 * 48 * 5 / 4 };
+        UTIL_BASE_IMAGE_STRUCT dst_v = { 16, 12, plane.data() };
+        fillRandom(src, 42);
+        CHECK(utilResizer(&dst_img, &src_img, UTL_IMAGE_FORMAT_YUV420, UTIL_RESIZE_AREA, tpq, 3) == UTIL_OK, "I420");
+        utilResizer(&dst_v, &src_v, UTL_IMAGE_FORMAT_YUV400, UTIL_RESIZE_AREA, NULL, 1);
+        CHECK(memcmp(plane.data(), out.data() + 32 * 24 * 5 / 4, plane.size()) == 0, "I420 V plane");
+    }
+
+    // errors
+    {
+        std::vector<MUINT8> buf(64 * 64);
+        UTIL_BASE_IMAGE_STRUCT img = { 8, 8, buf.data() };
+        UTIL_BASE_IMAGE_STRUCT odd = { 7, 8, buf.data() };
+        UTIL_BASE_IMAGE_STRUCT null_img = { 8, 8, NULL };
+        CHECK(utilResizer(&null_img, &img, UTL_IMAGE_FORMAT_YUV400, UTIL_RESIZE_AREA, NULL, 1) ==
+              UTIL_COMMON_ERR_NULL_BUFFER_POINTER, "null");
+        CHECK(utilResizer(&img, &odd, UTL_IMAGE_FORMAT_YUV420, UTIL_RESIZE_AREA, NULL, 1) ==
+              UTIL_COMMON_ERR_INVALID_PARAMETER, "odd I420");
+        CHECK(utilResizer(&img, &img, UTL_IMAGE_FORMAT_YUV400, UTIL_RESIZE_AREA, NULL, UTL_RESIZE_MAX_TASKS + 1) ==
+              UTIL_COMMON_ERR_INVALID_PARAMETER, "tasks");
+        CHECK(utilResizer(&img, &img, UTL_IMAGE_FORMAT_RGB565, UTIL_RESIZE_AREA, NULL, 1) ==
+              UTIL_COMMON_ERR_UNSUPPORTED_IMAGE_FORMAT, "format");
+    }
+}
+
+static void setClip(UTIL_CLIP_IMAGE_STRUCT *img, std::vector<MUINT8> &buf, int width, int height,
+                    int clip_x, int clip_y, int clip_width, int clip_height)
+{
+    img->width = width;
+    img->height = height;
+    img->data = buf.data();
+    img->clip_x = clip_x;
+    img->clip_y = clip_y;
+    img->clip_width = clip_width;
+    img->clip_height = clip_height;
+}
+
+static void testRotate(tp_queue tpq)
+{
+    static const int sizes[][2] = { { 64, 64 }, { 77, 53 }, { 130, 200 }, { 8, 8 }, { 5, 3 } };
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        for (int mode = 0; mode < 8; mode++)
+        {
+            UTIL_ANGLE angle = (UTIL_ANGLE)(mode & 3);
+            bool mirror = mode >= 4;
+            bool transpose = (angle == UTIL_ANGLE_090 || angle == UTIL_ANGLE_270);
+            int sw = sizes[s][0], sh = sizes[s][1];
+            int dw = transpose ? sh : sw, dh = transpose ? sw : sh;
+
+            // clips inside larger images
+            std::vector<MUINT8> src((sw + 10) * (sh + 12));
+            std::vector<MUINT8> ref((dw + 6) * (dh + 5), 7), out(ref), out_mt(ref);
+            UTIL_CLIP_IMAGE_STRUCT src_img, ref_img, out_img, out_mt_img;
+            fillRandom(src, sw * 3 + sh + mode);
+            setClip(&src_img, src, sw + 10, sh + 12, 3, 5, sw, sh);
+            setClip(&ref_img, ref, dw + 6, dh + 5, 2, 1, dw, dh);
+            setClip(&out_img, out, dw + 6, dh + 5, 2, 1, dw, dh);
+            setClip(&out_mt_img, out_mt, dw + 6, dh + 5, 2, 1, dw, dh);
+
+            refRotate(&ref_img, &src_img, angle, mirror);
+            if (mirror)
+            {
+                utilMirror(&out_img, &src_img, angle);
+                utilMirror(&out_mt_img, &src_img, angle, tpq, 3);
+            }
+            else
+            {
+                utilRotate(&out_img, &src_img, angle);
+                utilRotate(&out_mt_img, &src_img, angle, tpq, 3);
+            }
+            CHECK(out == ref, "%s %d %dx%d differs from the reference", mirror ? "mirror" : "rotate", angle * 90, sw, sh);
+            CHECK(out_mt == ref, "%s %d %dx%d in bands differs", mirror ? "mirror" : "rotate", angle * 90, sw, sh);
+        }
+    }
+}
+
+/*
+ * benchmark
+ */
+static void benchResize(tp_queue tpq, int threads, int sw, int sh, int dw, int dh)
+{
+    const int loops = 5;
+    std::vector<MUINT8> src(sw * sh), out(dw * dh);
+    UTIL_BASE_IMAGE_STRUCT src_img = { sw, sh, src.data() };
+    UTIL_BASE_IMAGE_STRUCT dst_img = { dw, dh, out.data() };
+    fillRandom(src, 1);
+
+    double begin = nowMs();
+    for (int i = 0; i < loops; i++)
+        refBilinear(out, dw, dh, src, sw, sh);
+    double ref = (nowMs() - begin) / loops;
+
+    double t[UTIL_RESIZE_FILTER_NUM][2];
+    for (int f = 0; f < UTIL_RESIZE_FILTER_NUM; f++)
+    {
+        begin = nowMs();
+        for (int i = 0; i < loops; i++)
+            utilResizer(&dst_img, &src_img, UTL_IMAGE_FORMAT_YUV400, (UTIL_RESIZE_FILTER_ENUM)f, NULL, 1);
+        t[f][0] = (nowMs() - begin) / loops;
+        begin = nowMs();
+        for (int i = 0; i < loops; i++)
+            utilResizer(&dst_img, &src_img, UTL_IMAGE_FORMAT_YUV400, (UTIL_RESIZE_FILTER_ENUM)f, tpq, threads * 2);
+        t[f][1] = (nowMs() - begin) / loops;
+    }
+    printf("resize %4dx%-4d -> %4dx%-4d  per-pixel bilinear %7.2f ms, bilinear %7.2f / %7.2f ms, area %7.2f / %7.2f ms\n",
+           sw, sh, dw, dh, ref, t[0][0], t[0][1], t[1][0], t[1][1]);
+}
+
+static void benchRotate(tp_queue tpq, int threads, int sw, int sh, UTIL_ANGLE angle)
+{
+    const int loops = 5;
+    bool transpose = (angle == UTIL_ANGLE_090 || angle == UTIL_ANGLE_270);
+    int dw = transpose ? sh : sw, dh = transpose ? sw : sh;
+    std::vector<MUINT8> src(sw * sh), out(sw * sh);
+    UTIL_CLIP_IMAGE_STRUCT src_img, dst_img;
+    fillRandom(src, 2);
+    setClip(&src_img, src, sw, sh, 0, 0, sw, sh);
+    setClip(&dst_img, out, dw, dh, 0, 0, dw, dh);
+
+    double begin = nowMs();
+    for (int i = 0; i < loops; i++)
+        refRotate(&dst_img, &src_img, angle, false);
+    double ref = (nowMs() - begin) / loops;
+    begin = nowMs();
+    for (int i = 0; i < loops; i++)
+        utilRotate(&dst_img, &src_img, angle);
+    double one = (nowMs() - begin) / loops;
+    begin = nowMs();
+    for (int i = 0; i < loops; i++)
+        utilRotate(&dst_img, &src_img, angle, tpq, threads * 2);
+    double mt = (nowMs() - begin) / loops;
+
+    printf("rotate %4dx%-4d %3d deg  per-pixel %7.2f ms, blocked %7.2f ms, %dT %7.2f ms\n",
+           sw, sh, angle * 90, ref, one, threads, mt);
+}
+
+int main(int argc, char **argv)
+{
+    int threads = (argc > 1) ? atoi(argv[1]) : 4;
+    if (threads <= 0 || threads * 2 > UTL_ROTATE_MAX_TASKS)
+    {
+        printf("usage: %s [threads], up to %d threads\n", argv[0], UTL_ROTATE_MAX_TASKS / 2);
+        return 1;
+    }
+
+    tp_queue tpq = tpq_create(threads, "resizetest");
+
+    testResize(tpq);
+    testRotate(tpq);
+
+    printf("\n");
+    benchResize(tpq, threads, 4000, 3000, 320, 240);
+    benchResize(tpq, threads, 4000, 3000, 1920, 1440);
+    benchResize(tpq, threads, 1920, 1080, 1280, 720);
+    benchResize(tpq, threads, 1280, 720, 640, 360);
+    benchRotate(tpq, threads, 4000, 3000, UTIL_ANGLE_090);
+    benchRotate(tpq, threads, 1920, 1080, UTIL_ANGLE_090);
+    benchRotate(tpq, threads, 1920, 1080, UTIL_ANGLE_180);
+    benchRotate(tpq, threads, 1920, 1080, UTIL_ANGLE_270);
+
+    tpq_destroy(tpq);
+
+    printf("\n%s\n", g_fail ? "FAIL" : "PASS");
+    return g_fail ? 1 : 0;
+}
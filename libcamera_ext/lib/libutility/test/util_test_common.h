@@ -0,0 +1,45 @@
+/*
+ * Helpers shared by the libutility tests
+ *
+ *  - CHECK prints a failed condition and counts it in g_fail, main returns
+ *    non-zero when g_fail is set
+ *  - fillRandom fills a buffer from a seed, the same on every run
+ *  - nowMs is a monotonic clock for the benchmarks
+ */
+#ifndef _UTIL_TEST_COMMON_H_
+#define _UTIL_TEST_COMMON_H_
+
+#include <stdio.h>
+#include <time.h>
+#include <vector>
+
+#include "MTKUtilType.h"
+
+static int g_fail = 0;
+
+#define CHECK(cond, ...)                \
+    do {                                \
+        if (!(cond)) {                  \
+            printf("FAIL: " __VA_ARGS__); \
+            printf("\n");               \
+            g_fail++;                   \
+        }                               \
+    } while (0)
+
+static inline void fillRandom(std::vector<MUINT8> &buf, unsigned int seed)
+{
+    for (size_t i = 0; i < buf.size(); i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        buf[i] = (MUINT8)(seed >> 16);
+    }
+}
+
+static inline double nowMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+#endif // _UTIL_TEST_COMMON_H_
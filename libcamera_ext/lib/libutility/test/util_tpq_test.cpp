@@ -0,0 +1,330 @@
+/*
+ * Test and benchmark of tpq
+ *
+ *  - every added job runs once with task_id/num_tasks/thread_id/group ids
+ *  - jobs added from a job run in the same tpq_exec, and tpq_exec from a
+ *    job returns only after the jobs that job added are done
+ *  - idle workers do not burn the cpu while one long job runs
+ *  - tpq_parallel_for covers each item once for fixed and auto grains,
+ *    from the caller and from inside a job
+ *  - scaling over 1 to 8 threads for tiny jobs, large jobs and a
+ *    parallel for of tiny items
+ *
+ * usage: util_tpq_test [max threads]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <vector>
+
+#include "utilSystem/tpq.h"
+#include "util_test_common.h"
+
+/*
+ * correctness
+ */
+
+struct JobRecord
+{
+    std::atomic<int> runs;
+    int task_id;
+    int num_tasks;
+    int thread_id;
+    int group_id;
+    int group_task_id;
+    int group_num_tasks;
+};
+
+static void *recordJob(void *arg, rtinfo *info)
+{
+    JobRecord *rec = (JobRecord *)arg;
+    rec->runs++;
+    rec->task_id = info->task_id;
+    rec->num_tasks = info->num_tasks;
+    rec->thread_id = info->thread_id;
+    rec->group_id = info->group_id;
+    rec->group_task_id = info->group_task_id;
+    rec->group_num_tasks = info->group_num_tasks;
+    return NULL;
+}
+
+static void testJobs(int threads)
+{
+    const int numJobs = 1000;
+    tp_queue tpq = tpq_group_create(threads, 2, "tpq_test");
+    std::vector<JobRecord> recs(numJobs);
+
+    // twice, to run on rewound job pools
+    for (int round = 0; round < 2; round++)
+    {
+        for (int i = 0; i < numJobs; i++)
+        {
+            recs[i].runs = 0;
+            tpq_add_group_work(i % 3 == 0 ? 1 : 0, tpq, recordJob, &recs[i]);
+        }
+        tpq_exec(tpq, 0);
+
+        int bad = 0;
+        for (int i = 0; i < numJobs; i++)
+        {
+            int g = i % 3 == 0 ? 1 : 0;
+            int gn = g ? (numJobs + 2) / 3 : numJobs - (numJobs + 2) / 3;
+            if (recs[i].runs != 1 || recs[i].task_id != i || recs[i].num_tasks != numJobs ||
+                recs[i].thread_id < 0 || recs[i].thread_id >= threads ||
+                recs[i].group_id != g || recs[i].group_task_id != (g ? i / 3 : i - i / 3 - 1) ||
+                recs[i].group_num_tasks != gn)
+                bad++;
+        }
+        CHECK(bad == 0, "jobs threads %d round %d: %d bad records", threads, round, bad);
+    }
+
+    // exec of an empty queue returns
+    tpq_exec(tpq, 0);
+    tpq_destroy(tpq);
+}
+
+struct Nested
+{
+    tp_queue tpq;
+    std::atomic<int> leaves;
+    std::vector<std::atomic<int> > hits;
+    Nested(int n) : tpq(NULL), leaves(0), hits(n) {}
+};
+
+static void *leafJob(void *arg, rtinfo *)
+{
+    ((Nested *)arg)->leaves++;
+    return NULL;
+}
+
+static void nestedRange(void *arg, int begin, int end, rtinfo *info)
+{
+    Nested *nest = (Nested *)arg;
+    for (int i = begin; i < end; i++)
+        nest->hits[i]++;
+    if (info->thread_id < 0 || info->thread_id >= info->num_threads)
+        g_fail++;
+}
+
+static void *spawnJob(void *arg, rtinfo *)
+{
+    Nested *nest = (Nested *)arg;
+    for (int i = 0; i < 10; i++)
+        tpq_add_work(nest->tpq, leafJob, nest);
+    return NULL;
+}
+
+// bands on the stack of the job, as the band overloads of utilResizer do
+static void *bandJob(void *arg, rtinfo *)
+{
+    usleep(100);
+    (*(int *)arg)++;
+    return NULL;
+}
+
+static void *execJob(void *arg, rtinfo *)
+{
+    Nested *nest = (Nested *)arg;
+    int bands[8] = { 0 };
+    for (int i = 0; i < 8; i++)
+        tpq_add_work(nest->tpq, bandJob, &bands[i]);
+    tpq_exec(nest->tpq, 0);
+    for (int i = 0; i < 8; i++)
+        nest->leaves += bands[i];
+    return NULL;
+}
+
+static void *pforJob(void *arg, rtinfo *)
+{
+    Nested *nest = (Nested *)arg;
+    tpq_parallel_for(nest->tpq, 0, (int)nest->hits.size(), 0, nestedRange, nest);
+    return NULL;
+}
+
+static void testNested(int threads)
+{
+    tp_queue tpq = tpq_create(threads, "tpq_test");
+
+    Nested spawn(1);
+    spawn.tpq = tpq;
+    for (int i = 0; i < 50; i++)
+        tpq_add_work(tpq, spawnJob, &spawn);
+    tpq_exec(tpq, 0);
+    CHECK(spawn.leaves == 500, "nested add threads %d: %d leaves", threads, spawn.leaves.load());
+
+    Nested exec(1);
+    exec.tpq = tpq;
+    for (int i = 0; i < 20; i++)
+        tpq_add_work(tpq, execJob, &exec);
+    tpq_exec(tpq, 0);
+    CHECK(exec.leaves == 160, "nested exec threads %d: %d bands done", threads, exec.leaves.load());
+
+    // several jobs running a parallel for of their own
+    std::vector<Nested *> nests;
+    for (int i = 0; i < 8; i++)
+    {
+        nests.push_back(new Nested(5000 + i));
+        nests.back()->tpq = tpq;
+        tpq_add_work(tpq, pforJob, nests.back());
+    }
+    tpq_exec(tpq, 0);
+    for (size_t k = 0; k < nests.size(); k++)
+    {
+        int bad = 0;
+        for (size_t i = 0; i < nests[k]->hits.size(); i++)
+            bad += nests[k]->hits[i] != 1;
+        CHECK(bad == 0, "nested parallel for threads %d job %d: %d bad items", threads, (int)k, bad);
+        delete nests[k];
+    }
+
+    tpq_destroy(tpq);
+}
+
+static double cpuMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void *sleepJob(void *, rtinfo *)
+{
+    usleep(100000);
+    return NULL;
+}
+
+static void testIdle(int threads)
+{
+    tp_queue tpq = tpq_create(threads, "tpq_test");
+
+    // the other workers find no job while this one sleeps
+    double t0 = cpuMs();
+    tpq_add_work(tpq, sleepJob, NULL);
+    tpq_exec(tpq, 0);
+    double cpu = cpuMs() - t0;
+    CHECK(cpu < 20, "idle threads %d: %.1f ms cpu during a 100 ms job", threads, cpu);
+
+    tpq_destroy(tpq);
+}
+
+static void countRange(void *arg, int begin, int end, rtinfo *)
+{
+    std::vector<std::atomic<int> > *hits = (std::vector<std::atomic<int> > *)arg;
+    for (int i = begin; i < end; i++)
+        (*hits)[i]++;
+}
+
+static void testParallelFor(int threads)
+{
+    tp_queue tpq = tpq_create(threads, "tpq_test");
+    const int sizes[] = { 1, 7, 1000, 100003 };
+    const int grains[] = { 0, 1, 16, 100000 };
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        for (size_t g = 0; g < sizeof(grains) / sizeof(grains[0]); g++)
+        {
+            std::vector<std::atomic<int> > hits(sizes[s] + 20);
+            tpq_parallel_for(tpq, 10, 10 + sizes[s], grains[g], countRange, &hits);
+            int bad = 0;
+            for (int i = 0; i < sizes[s] + 20; i++)
+                bad += hits[i] != (i >= 10 && i < 10 + sizes[s]);
+            CHECK(bad == 0, "parallel for threads %d size %d grain %d: %d bad items",
+                  threads, sizes[s], grains[g], bad);
+        }
+    }
+
+    // empty range
+    tpq_parallel_for(tpq, 5, 5, 0, countRange, NULL);
+    tpq_destroy(tpq);
+}
+
+/*
+ * benchmark
+ */
+
+static std::atomic<unsigned int> g_sink;
+
+static unsigned int spin(int iters, unsigned int x)
+{
+    for (int i = 0; i < iters; i++)
+        x = x * 1664525u + 1013904223u;
+    return x;
+}
+
+static void *tinyJob(void *arg, rtinfo *)
+{
+    g_sink.store(spin(20, (unsigned int)(size_t)arg), std::memory_order_relaxed);
+    return NULL;
+}
+
+static void *largeJob(void *arg, rtinfo *)
+{
+    g_sink.store(spin(200000, (unsigned int)(size_t)arg), std::memory_order_relaxed);
+    return NULL;
+}
+
+static void tinyRange(void *, int begin, int end, rtinfo *)
+{
+    unsigned int x = 0;
+    for (int i = begin; i < end; i++)
+        x = spin(20, x + i);
+    g_sink.store(x, std::memory_order_relaxed);
+}
+
+static void benchmark(int threads)
+{
+    tp_queue tpq = tpq_create(threads, "tpq_bench");
+    const int rounds = 20;
+    const int numTiny = 10000, numLarge = 64, numItems = 200000;
+    double t0, tTiny, tLarge, tFor;
+
+    t0 = nowMs();
+    for (int r = 0; r < rounds; r++)
+    {
+        for (int i = 0; i < numTiny; i++)
+            tpq_add_work(tpq, tinyJob, (void *)(size_t)i);
+        tpq_exec(tpq, 0);
+    }
+    tTiny = (nowMs() - t0) / rounds;
+
+    t0 = nowMs();
+    for (int i = 0; i < numLarge; i++)
+        tpq_add_work(tpq, largeJob, (void *)(size_t)i);
+    tpq_exec(tpq, 0);
+    tLarge = nowMs() - t0;
+
+    t0 = nowMs();
+    for (int r = 0; r < rounds; r++)
+        tpq_parallel_for(tpq, 0, numItems, 0, tinyRange, NULL);
+    tFor = (nowMs() - t0) / rounds;
+
+    printf("threads %d: %d tiny jobs %.3f ms (%.0f ns/job), %d large jobs %.3f ms, "
+           "parallel for %d items %.3f ms\n",
+           threads, numTiny, tTiny, tTiny * 1e6 / numTiny, numLarge, tLarge, numItems, tFor);
+    tpq_destroy(tpq);
+}
+
+int main(int argc, char **argv)
+{
+    int maxThreads = argc > 1 ? atoi(argv[1]) : 8;
+    if (maxThreads < 1)
+        maxThreads = 1;
+
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        testJobs(threads);
+        testNested(threads);
+        testParallelFor(threads);
+        testIdle(threads);
+    }
+
+    for (int threads = 1; threads <= maxThreads; threads++)
+        benchmark(threads);
+
+    printf("%s\n", g_fail ? "FAIL" : "PASS");
+    return g_fail ? 1 : 0;
+}
@@ -1,6 +1,7 @@
 #define LOG_TAG "utilBlur"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #ifdef ANDROID // Android
 #include <android/log.h>
@@ -9,302 +10,413 @@
 #define LOGD(...)
 #endif /* ANDROID */
 
-#ifdef NEON_OPT
-#ifdef ANDROID
-#include "arm_neon.h"
-#else
-#include "neon_template.hpp"
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define FILTER_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#define FILTER_SSE2
+#include <emmintrin.h>
 #endif
-#endif /* NEON_OPT */
 
 #include "utilBlur.h"
 #include "utilMath.h"
 
-// neon debug
-//#include "neon_template.hpp"
-//#define NEON_OPT
-//#define uint8x8_t MUINT8x8
-//#define uint16x8_t MUINT16x8
+/// gaussian blur rows of a band
+typedef struct
+{
+    const MUINT8 *src;      ///< top-left of the 5x5 window of the first output pixel
+    MUINT8 *dst;            ///< first output pixel
+    MINT32 stride;          ///< source and destination stride
+    MINT32 width;           ///< output width
+    MINT32 row_begin;
+    MINT32 row_end;
+    UTIL_ERRCODE_ENUM result;
+} UTL_BLUR_BAND_STRUCT;
+
+/// box blur rows of a band
+typedef struct
+{
+    const MUINT8 *src;
+    MUINT8 *dst;
+    MINT32 width;
+    MINT32 height;
+    MINT32 radius;
+    MINT32 row_begin;
+    MINT32 row_end;
+    UTIL_ERRCODE_ENUM result;
+} UTL_BOX_BAND_STRUCT;
+
+typedef void *(*UTL_BAND_JOB)(void *, rtinfo *);
+
+// run numTasks bands of size band_size at bands, on tpq or inline
+static void runBands(void *bands, size_t band_size, MINT32 numTasks, UTL_BAND_JOB job, tp_queue tpq)
+{
+    MUINT8 *band = (MUINT8 *)bands;
+
+    if (tpq == NULL || numTasks == 1)
+    {
+        for (MINT32 i = 0; i < numTasks; i++)
+            job(band + i * band_size, NULL);
+        return;
+    }
+
+    for (MINT32 i = 0; i < numTasks; i++)
+    {
+        if (tpq_add_work(tpq, job, band + i * band_size) != 0)
+            job(band + i * band_size, NULL);
+    }
+    tpq_exec(tpq, 0);
+}
+
+/*
+ * gaussian blur, 1 4 6 4 1 on both axes
+ */
+
+// dst[x] = s[x] + 4 * s[x + 1] + 6 * s[x + 2] + 4 * s[x + 3] + s[x + 4], at most 16 * 255
+static void blurRow(const MUINT8 *s, MUINT16 *dst, MINT32 width)
+{
+    MINT32 x = 0;
+#if defined(FILTER_NEON)
+    const uint8x8_t v_4 = vdup_n_u8(4);
+    const uint8x8_t v_6 = vdup_n_u8(6);
+    for (; x + 8 <= width; x += 8)
+    {
+        uint16x8_t v_sum = vaddl_u8(vld1_u8(s + x), vld1_u8(s + x + 4));
+        v_sum = vmlal_u8(v_sum, vld1_u8(s + x + 1), v_4);
+        v_sum = vmlal_u8(v_sum, vld1_u8(s + x + 2), v_6);
+        v_sum = vmlal_u8(v_sum, vld1_u8(s + x + 3), v_4);
+        vst1q_u16(dst + x, v_sum);
+    }
+#elif defined(FILTER_SSE2)
+    const __m128i v_zero = _mm_setzero_si128();
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i v_s0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(s + x)), v_zero);
+        __m128i v_s1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(s + x + 1)), v_zero);
+        __m128i v_s2 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(s + x + 2)), v_zero);
+        __m128i v_s3 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(s + x + 3)), v_zero);
+        __m128i v_s4 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(s + x + 4)), v_zero);
+        __m128i v_13 = _mm_slli_epi16(_mm_add_epi16(v_s1, v_s3), 2);
+        __m128i v_2 = _mm_add_epi16(_mm_slli_epi16(v_s2, 2), _mm_slli_epi16(v_s2, 1));
+        _mm_storeu_si128((__m128i *)(dst + x),
+                         _mm_add_epi16(_mm_add_epi16(v_s0, v_s4), _mm_add_epi16(v_13, v_2)));
+    }
+#endif
+    for (; x < width; x++)
+        dst[x] = (MUINT16)(s[x] + ((s[x + 1] + s[x + 3]) << 2) + s[x + 2] * 6 + s[x + 4]);
+}
+
+// dst[x] = (r0 + 4 * r1 + 6 * r2 + 4 * r3 + r4 + 128) >> 8, the sum fits 16 bits
+static void blurColumns(const MUINT16 *const *rows, MUINT8 *dst, MINT32 width)
+{
+    const MUINT16 *r0 = rows[0], *r1 = rows[1], *r2 = rows[2], *r3 = rows[3], *r4 = rows[4];
+    MINT32 x = 0;
+#if defined(FILTER_NEON)
+    const uint16x8_t v_4 = vdupq_n_u16(4);
+    const uint16x8_t v_6 = vdupq_n_u16(6);
+    for (; x + 8 <= width; x += 8)
+    {
+        uint16x8_t v_sum = vaddq_u16(vld1q_u16(r0 + x), vld1q_u16(r4 + x));
+        v_sum = vmlaq_u16(v_sum, vaddq_u16(vld1q_u16(r1 + x), vld1q_u16(r3 + x)), v_4);
+        v_sum = vmlaq_u16(v_sum, vld1q_u16(r2 + x), v_6);
+        vst1_u8(dst + x, vrshrn_n_u16(v_sum, 8));
+    }
+#elif defined(FILTER_SSE2)
+    const __m128i v_round = _mm_set1_epi16(128);
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i v_r2 = _mm_loadu_si128((const __m128i *)(r2 + x));
+        __m128i v_13 = _mm_slli_epi16(_mm_add_epi16(_mm_loadu_si128((const __m128i *)(r1 + x)),
+                                                    _mm_loadu_si128((const __m128i *)(r3 + x))), 2);
+        __m128i v_sum = _mm_add_epi16(_mm_loadu_si128((const __m128i *)(r0 + x)),
+                                      _mm_loadu_si128((const __m128i *)(r4 + x)));
+        v_sum = _mm_add_epi16(v_sum, _mm_add_epi16(v_13, _mm_add_epi16(_mm_slli_epi16(v_r2, 2), _mm_slli_epi16(v_r2, 1))));
+        v_sum = _mm_srli_epi16(_mm_add_epi16(v_sum, v_round), 8);
+        _mm_storel_epi64((__m128i *)(dst + x), _mm_packus_epi16(v_sum, v_sum));
+    }
+#endif
+    for (; x < width; x++)
+        dst[x] = (MUINT8)((r0[x] + ((r1[x] + r3[x]) << 2) + r2[x] * 6 + r4[x] + 128) >> 8);
+}
+
+static void *blurBandJob(void *arg, rtinfo *info)
+{
+    UTL_BLUR_BAND_STRUCT *band = (UTL_BLUR_BAND_STRUCT *)arg;
+    const MINT32 width = band->width;
+    (void)info;
+
+    // source row i is kept in slot i % 5
+    MUINT16 *ring = (MUINT16 *)malloc(5 * width * sizeof(MUINT16));
+    if (!ring)
+    {
+        band->result = UTIL_COMMON_ERR_OUT_OF_MEMORY;
+        return NULL;
+    }
+
+    for (MINT32 i = band->row_begin; i < band->row_begin + 4; i++)
+        blurRow(band->src + i * band->stride, ring + (i % 5) * width, width);
+
+    for (MINT32 y = band->row_begin; y < band->row_end; y++)
+    {
+        const MUINT16 *rows[5];
+        blurRow(band->src + (y + 4) * band->stride, ring + ((y + 4) % 5) * width, width);
+        for (MINT32 k = 0; k < 5; k++)
+            rows[k] = ring + ((y + k) % 5) * width;
+        blurColumns(rows, band->dst + y * band->stride, width);
+    }
+
+    free(ring);
+    band->result = UTIL_OK;
+    return NULL;
+}
 
-#ifndef NEON_OPT
 UTIL_ERRCODE_ENUM utilBlur(MUINT8 *dst, P_UTIL_CLIP_IMAGE_STRUCT src)
+{
+    return utilBlur(dst, src, NULL, 1);
+}
+
+UTIL_ERRCODE_ENUM utilBlur(MUINT8 *dst, P_UTIL_CLIP_IMAGE_STRUCT src, tp_queue tpq, MINT32 numTasks)
 {
     UTIL_ERRCODE_ENUM result = UTIL_OK;
     MINT32 x_offset = src->clip_x;
     MINT32 y_offset = src->clip_y;
     MINT32 width = src->width;
     MUINT8 *p_src = (MUINT8 *)(src->data);
-    MUINT8 *p_dst = dst + (width*y_offset + x_offset);
 
     // data pointer check
-    if (!p_src || !p_dst)
+    if (!p_src || !dst)
     {
         result = UTIL_COMMON_ERR_NULL_BUFFER_POINTER;
         LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
         return result;
     }
 
-    MINT32 val;
-    MUINT8 *tmp = 0;
-    MINT32 y_count = src->clip_height;
-    while(--y_count>=0)
+    // the window of the last output pixel starts at clip_height - 1, clip_width - 1
+    if ((src->clip_width <= 0) || (src->clip_height <= 0) ||
+        (src->clip_width + 4 > width) || (src->clip_height + 4 > src->height) ||
+        (numTasks < 1) || (numTasks > UTL_BLUR_MAX_TASKS))
     {
-        MINT32 x_count = src->clip_width;
-        while(--x_count>=0)
-        {
-            tmp = p_src++;
-            val  = (*(tmp  ));      // x1
-            val += (*(tmp+1))<<2;   // x4
-            val += (*(tmp+2))*6;    // x6
-            val += (*(tmp+3))<<2;   // x4
-            val += (*(tmp+4));      // x1
-
-            tmp += width;
-            val += (*(tmp  ))<<2;   // x4
-            val += (*(tmp+1))<<4;   // x16
-            val += (*(tmp+2))*24;   // x24
-            val += (*(tmp+3))<<4;   // x16
-            val += (*(tmp+4))<<2;   // x4
-
-            tmp += width;
-            val += (*(tmp  ))*6;    // x6
-            val += (*(tmp+1))*24;   // x24
-            val += (*(tmp+2))*36;   // x36
-            val += (*(tmp+3))*24;   // x24
-            val += (*(tmp+4))*6;    // x6
-
-            tmp += width;
-            val += (*(tmp  ))<<2;   // x4
-            val += (*(tmp+1))<<4;   // x16
-            val += (*(tmp+2))*24;   // x24
-            val += (*(tmp+3))<<4;   // x16
-            val += (*(tmp+4))<<2;   // x4
-
-            tmp += width;
-            val += (*(tmp  ));      // x1
-            val += (*(tmp+1))<<2;   // x4
-            val += (*(tmp+2))*6;    // x6
-            val += (*(tmp+3))<<2;   // x4
-            val += (*(tmp+4));      // x1
-
-            *p_dst++ = (MUINT8)((val+128)>>8);
-        }
+        result = UTIL_COMMON_ERR_INVALID_PARAMETER;
+        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
+        return result;
+    }
+
+    if (numTasks > src->clip_height)
+        numTasks = src->clip_height;
 
-        p_src += 2*x_offset;
-        p_dst += 2*x_offset;
+    UTL_BLUR_BAND_STRUCT bands[UTL_BLUR_MAX_TASKS];
+    for (MINT32 i = 0; i < numTasks; i++)
+    {
+        bands[i].src = p_src;
+        bands[i].dst = dst + (width * y_offset + x_offset);
+        bands[i].stride = width;
+        bands[i].width = src->clip_width;
+        bands[i].row_begin = src->clip_height * i / numTasks;
+        bands[i].row_end = src->clip_height * (i + 1) / numTasks;
+        bands[i].result = UTIL_OK;
+    }
+    runBands(bands, sizeof(bands[0]), numTasks, blurBandJob, tpq);
+
+    for (MINT32 i = 0; i < numTasks; i++)
+    {
+        if (bands[i].result != UTIL_OK)
+            result = bands[i].result;
+    }
+    if (result != UTIL_OK)
+    {
+        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
     }
 
     return result;
 }
-#else
-UTIL_ERRCODE_ENUM utilBlur(MUINT8 *dst, P_UTIL_CLIP_IMAGE_STRUCT src)
+
+UTIL_ERRCODE_ENUM utilSobel(MUINT32 *dst, P_UTIL_CLIP_IMAGE_STRUCT src)
 {
     UTIL_ERRCODE_ENUM result = UTIL_OK;
-    MINT32 x_offset = src->clip_x;
-    MINT32 y_offset = src->clip_y;
-    MINT32 width = src->width;
-    MUINT8 *src_Image = (MUINT8 *)(src->data);
-    MUINT8 *des_image = dst + (width*y_offset + x_offset);
-    MINT32 xcount = src->clip_width;
-    MINT32 ycount = src->clip_height;
+    MUINT32 width = src->width;
+    MUINT32 height = src->height;
+    MUINT32 margin_x = src->clip_x;
+    MUINT32 margin_y = src->clip_y;
+    MUINT8 *p_src = (MUINT8 *)src->data;
+    MUINT32 xx, yy;
+    MINT32 x, y;
+    MUINT32 width_4, height_4;
 
     // data pointer check
-    if (!src_Image || !des_image)
+    if (!p_src || !dst)
     {
         result = UTIL_COMMON_ERR_NULL_BUFFER_POINTER;
         LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
         return result;
     }
 
-    uint8x8_t row1, row2, row3, row4, row5;
-    uint8x8_t left_row, right_row;
-    uint16x8_t sum_row;
-    uint8x8_t filter4, filter6;
-
-    uint16x8_t filter_4, filter_6;
-
-    uint16x8_t sum_row1 = vdupq_n_u16(0);
-    uint16x8_t sum_row2 = vdupq_n_u16(0);
-    uint16x8_t sum_row3 = vdupq_n_u16(0);
-    uint16x8_t sum_row4 = vdupq_n_u16(0);
-    uint16x8_t sum_row5 = vdupq_n_u16(0);
+    for(yy=0; yy<16; yy++)
+        dst[yy] = 0;  //sperate the preview image to 16 sub-region and count their graident sum
 
-    uint16x8_t sum_row_final;
+    height_4 = (height-margin_y*2)>>2;  //Calculate the height of each sub-block
+    width_4 = (width-margin_x*2)>>2;    //Calculate the width  of each sub-block
 
-    uint8x8_t final;  //5x5 result
-    uint8x8_t zero = vdup_n_u8(0);
+    //sobel cofficient
+    //sobel_y[3][3] = {{-1, -2, -1}, {0, 0, 0}, {1, 2, 1}}
+    //sobel_x[3][3] = {{-1, 0, 1}, {-2, 0, 2}, {-1, 0, 1}}
+    //split into the column sums smooth = top + 2 * mid + bottom and diff = bottom - top,
+    //then dx = smooth[x + 1] - smooth[x - 1], dy = diff[x - 1] + 2 * diff[x] + diff[x + 1]
+    MINT32 span = 4 * width_4 + 2;
+    MINT16 *smooth = (MINT16 *)malloc(2 * span * sizeof(MINT16));
+    if (!smooth)
+    {
+        result = UTIL_COMMON_ERR_OUT_OF_MEMORY;
+        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
+        return result;
+    }
+    MINT16 *diff = smooth + span;
 
-    int i, j, k, w;
-    int right_side;
-    int val;
-    register unsigned char *Image, *tmpImage, *ptrImg, *tmp;
+    for(yy=0; yy<4 ; yy++){
+        for(y=0; y<(MINT32)height_4; y+=2){
+            // columns margin_x - 1 to margin_x + 4 * width_4
+            MINT32 place = (yy*height_4 + margin_y + y)*width + margin_x - 1;
+            const MUINT8 *top = p_src + place - width;
+            const MUINT8 *mid = p_src + place;
+            const MUINT8 *bot = p_src + place + width;
+            for(x=0; x<span; x++){
+                smooth[x] = (MINT16)(top[x] + (mid[x]<<1) + bot[x]);
+                diff[x] = (MINT16)(bot[x] - top[x]);
+            }
 
+            for(xx=0; xx<4 ; xx++){
+                MUINT32 sum = 0;
+                for(x=xx*width_4+1; x<(MINT32)((xx+1)*width_4+1); x+=2){
+                    MINT32 dx = smooth[x+1] - smooth[x-1];
+                    MINT32 dy = diff[x-1] + diff[x]*2 + diff[x+1];
+                    sum += (UTL_ABS(dx) + UTL_ABS(dy))>>1;
+                }
+                dst[(yy<<2) + xx] += sum;
+            }
+        }
+    }
 
-    Image = src_Image;
+    free(smooth);
+    return result;
+}
 
-    filter4 = vdup_n_u8(4);
-    filter6 = vdup_n_u8(6);
-    filter_4 = vdupq_n_u16(4);
-    filter_6 = vdupq_n_u16(6);
+/*
+ * integral image and box blur
+ */
 
-    sum_row = vdupq_n_u16(0);
-    for(i=0; i<xcount-16; i+=8) //for each stripe
+// integral row of one source row, from the integral row above
+static void integralRow(const MUINT8 *src, const MUINT32 *above, MUINT32 *dst, MINT32 width)
+{
+    MUINT32 sum = 0;
+    dst[0] = 0;
+    for (MINT32 x = 0; x < width; x++)
     {
-        for(k=0; k<5; k++)
-        {
-            tmpImage = Image + (k * width);
-            left_row = vld1_u8(tmpImage+(i));
-            right_row = vld1_u8(tmpImage+i+8);
-
-            row1 = left_row;
-            row2 = vext_u8(left_row, right_row,  1);
-            row3 = vext_u8(left_row, right_row,  2);
-            row4 = vext_u8(left_row, right_row,  3);
-            row5 = vext_u8(left_row, right_row,  4);
-
-            sum_row = vmovl_u8(row1);
-            sum_row = vmlal_u8(sum_row, row2, filter4);
-            sum_row = vmlal_u8(sum_row, row3, filter6);
-            sum_row = vmlal_u8(sum_row, row4, filter4);
-            sum_row = vaddw_u8(sum_row, row5);
+        sum += src[x];
+        dst[x + 1] = above[x + 1] + sum;
+    }
+}
 
-            if(k==0)
-                sum_row1 = sum_row;
+UTIL_ERRCODE_ENUM utilIntegralImage(MUINT32 *dst, P_UTIL_BASE_IMAGE_STRUCT src)
+{
+    UTIL_ERRCODE_ENUM result = UTIL_OK;
+    MUINT8 *p_src = (MUINT8 *)(src->data);
+    MINT32 width = src->width;
 
-            else if(k==1)
-                sum_row2 = sum_row;
+    // data pointer check
+    if (!p_src || !dst)
+    {
+        result = UTIL_COMMON_ERR_NULL_BUFFER_POINTER;
+        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
+        return result;
+    }
 
-            else if(k==2)
-                sum_row3 = sum_row;
+    memset(dst, 0, (width + 1) * sizeof(MUINT32));
+    for (MINT32 y = 0; y < src->height; y++)
+        integralRow(p_src + y * width, dst + y * (width + 1), dst + (y + 1) * (width + 1), width);
 
-            else if(k==3)
-                sum_row4 = sum_row;
+    return result;
+}
 
-            else //k==4
-                sum_row5 = sum_row;
-        }
-        sum_row_final = sum_row1;
-        sum_row_final = vmlaq_u16(sum_row_final, sum_row2, filter_4);
-        sum_row_final = vmlaq_u16(sum_row_final, sum_row3, filter_6);
-        sum_row_final = vmlaq_u16(sum_row_final, sum_row4, filter_4);
-        sum_row_final = vaddq_u16(sum_row_final, sum_row5);
+static void *boxBandJob(void *arg, rtinfo *info)
+{
+    UTL_BOX_BAND_STRUCT *band = (UTL_BOX_BAND_STRUCT *)arg;
+    const MINT32 width = band->width;
+    const MINT32 height = band->height;
+    const MINT32 radius = band->radius;
+    const MINT32 ring_rows = 2 * radius + 2;
+    (void)info;
+
+    // integral row k of the band sums source rows first .. first + k - 1, kept in slot k % ring_rows
+    MUINT32 *ring = (MUINT32 *)malloc(ring_rows * (width + 1) * sizeof(MUINT32));
+    MINT32 *columns = (MINT32 *)malloc(width * sizeof(MINT32));
+    if (!ring || !columns)
+    {
+        free(ring);
+        free(columns);
+        band->result = UTIL_COMMON_ERR_OUT_OF_MEMORY;
+        return NULL;
+    }
 
-        final = vrshrn_n_u16(sum_row_final, 8);
+    // columns of the window of each output column
+    for (MINT32 x = 0; x < width; x++)
+        columns[x] = UTL_MIN(width - 1, x + radius) - UTL_MAX(0, x - radius) + 1;
 
-        vst1_u8( des_image + (i)  , final);
+    const MINT32 first = UTL_MAX(0, band->row_begin - radius);
+    MINT32 filled = 0;
+    memset(ring, 0, (width + 1) * sizeof(MUINT32));
 
-        for(j=1; j<ycount; j++) //for each line
+    for (MINT32 y = band->row_begin; y < band->row_end; y++)
+    {
+        const MINT32 top = UTL_MAX(0, y - radius) - first;
+        const MINT32 bottom = UTL_MIN(height - 1, y + radius) + 1 - first;
+        while (filled < bottom)
         {
-            sum_row1 = sum_row2;
-            sum_row2 = sum_row3;
-            sum_row3 = sum_row4;
-            sum_row4 = sum_row5;
-            //row5
-            tmpImage = Image + ((j+4) * width);
-            //tmpImage = tmpImage + ((j+4) * width);
-            left_row = vld1_u8(tmpImage+(i));
-            right_row = vld1_u8(tmpImage+i+8);
-            row1 = left_row;
-            row2 = vext_u8(left_row, right_row,  1);
-            row3 = vext_u8(left_row, right_row,  2);
-            row4 = vext_u8(left_row, right_row,  3);
-            row5 = vext_u8(left_row, right_row,  4);
-            sum_row = vmovl_u8(row1);
-            sum_row = vmlal_u8(sum_row, row2, filter4);
-            sum_row = vmlal_u8(sum_row, row3, filter6);
-            sum_row = vmlal_u8(sum_row, row4, filter4);
-            sum_row = vaddw_u8(sum_row, row5);
-            sum_row5 = sum_row;
-            //SUM
-            sum_row_final = sum_row1;
-            sum_row_final = vmlaq_u16(sum_row_final, sum_row2, filter_4);
-            sum_row_final = vmlaq_u16(sum_row_final, sum_row3, filter_6);
-            sum_row_final = vmlaq_u16(sum_row_final, sum_row4, filter_4);
-            sum_row_final = vaddq_u16(sum_row_final, sum_row5);
-
-            final = vrshrn_n_u16(sum_row_final, 8);
-
-            vst1_u8( des_image + (i) + ((j)*(width))  , final);
-
+            integralRow(band->src + (first + filled) * width, ring + (filled % ring_rows) * (width + 1),
+                        ring + ((filled + 1) % ring_rows) * (width + 1), width);
+            filled++;
         }
-    }
 
-    /*
-     * right_side stripe
-     */
-    right_side = xcount - i;
+        const MUINT32 *upper = ring + (top % ring_rows) * (width + 1);
+        const MUINT32 *lower = ring + (bottom % ring_rows) * (width + 1);
+        const MUINT32 rows = bottom - top;
+        MUINT8 *out = band->dst + y * width;
 
-    if(right_side>0)
-    {
-        w = width;
-        ptrImg = des_image + i;
-        tmpImage = Image + i;
+        // the window is 2 * radius + 1 columns away from the borders, divided by a multiply
+        const MUINT32 n = rows * (2 * radius + 1);
+        const MUINT64 recip = (n < 4096) ? ((((MUINT64)1 << 32) + n - 1) / n) : 0;
+        const MINT32 x_begin = UTL_MIN(radius, width);
+        const MINT32 x_end = UTL_MAX(x_begin, width - radius);
 
-        for(j=0; j<ycount; j++)
+        for (MINT32 x = 0; x < width; x++)
         {
-            for(i=0; i<right_side; i++)
+            if (x == x_begin && recip)
             {
-                tmp = tmpImage + i;
-                val  = (*(tmp  ));      // x1
-                val += (*(tmp+1))<<2;   // x4
-                val += (*(tmp+2))*6;    // x6
-                val += (*(tmp+3))<<2;   // x4
-                val += (*(tmp+4));      // x1
-
-                tmp += w;
-                val += (*(tmp  ))<<2;   // x4
-                val += (*(tmp+1))<<4;   // x16
-                val += (*(tmp+2))*24;   // x24
-                val += (*(tmp+3))<<4;   // x16
-                val += (*(tmp+4))<<2;   // x4
-
-                tmp += w;
-                val += (*(tmp  ))*6;    // x6
-                val += (*(tmp+1))*24;   // x24
-                val += (*(tmp+2))*36;   // x36
-                val += (*(tmp+3))*24;   // x24
-                val += (*(tmp+4))*6;    // x6
-
-                tmp += w;
-                val += (*(tmp  ))<<2;   // x4
-                val += (*(tmp+1))<<4;   // x16
-                val += (*(tmp+2))*24;   // x24
-                val += (*(tmp+3))<<4;   // x16
-                val += (*(tmp+4))<<2;   // x4
-
-                tmp += w;
-                val += (*(tmp  ));      // x1
-                val += (*(tmp+1))<<2;   // x4
-                val += (*(tmp+2))*6;    // x6
-                val += (*(tmp+3))<<2;   // x4
-                val += (*(tmp+4));      // x1
-
-                *(ptrImg+i) = (MUINT8)((val+128)>>8);
+                // (sum + n / 2) * n < 2^32 for n < 4096, where the multiply is exact
+                for (; x < x_end; x++)
+                {
+                    MUINT32 sum = (lower[x + radius + 1] - lower[x - radius]) - (upper[x + radius + 1] - upper[x - radius]);
+                    out[x] = (MUINT8)(((sum + (n >> 1)) * recip) >> 32);
+                }
+                if (x == width)
+                    break;
             }
-            ptrImg += width;
-            tmpImage += width;
+            const MINT32 left = UTL_MAX(0, x - radius);
+            const MINT32 right = UTL_MIN(width - 1, x + radius) + 1;
+            const MUINT32 count = rows * columns[x];
+            MUINT32 sum = (lower[right] - lower[left]) - (upper[right] - upper[left]);
+            out[x] = (MUINT8)((sum + (count >> 1)) / count);
         }
     }
 
-    return result;
+    free(ring);
+    free(columns);
+    band->result = UTIL_OK;
+    return NULL;
 }
-#endif
 
-UTIL_ERRCODE_ENUM utilSobel(MUINT32 *dst, P_UTIL_CLIP_IMAGE_STRUCT src)
+UTIL_ERRCODE_ENUM utilBoxBlur(MUINT8 *dst, P_UTIL_BASE_IMAGE_STRUCT src, MINT32 radius, tp_queue tpq, MINT32 numTasks)
 {
     UTIL_ERRCODE_ENUM result = UTIL_OK;
-    MUINT32 width = src->width;
-    MUINT32 height = src->height;
-    MUINT32 margin_x = src->clip_x;
-    MUINT32 margin_y = src->clip_y;
-    MUINT8 *p_src = (MUINT8 *)src->data;
-    MUINT32 xx, yy;
-    MINT32 x, y;
-    MINT32 dy, dx;
-    MUINT32 width_4, height_4;
-    MINT32 value_temp1, value_temp2, value_temp3, value_temp4,value_temp5, value_temp6;
-    MINT32 place, place_temp1, place_temp2;
-    MUINT32 place_block;
+    MUINT8 *p_src = (MUINT8 *)(src->data);
 
     // data pointer check
     if (!p_src || !dst)
@@ -314,50 +426,44 @@ UTIL_ERRCODE_ENUM utilSobel(MUINT32 *dst, P_UTIL_CLIP_IMAGE_STRUCT src)
         return result;
     }
 
-    for(yy=0; yy<16; yy++)
-        dst[yy] = 0;  //sperate the preview image to 16 sub-region and count their graident sum
+    if ((src->width <= 0) || (src->height <= 0) || (radius < 0) ||
+        (numTasks < 1) || (numTasks > UTL_BLUR_MAX_TASKS))
+    {
+        result = UTIL_COMMON_ERR_INVALID_PARAMETER;
+        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
+        return result;
+    }
 
-    height_4 = (height-margin_y*2)>>2;  //Calculate the height of each sub-block
-    width_4 = (width-margin_x*2)>>2;    //Calculate the width  of each sub-block
+    // a larger window is the whole image on every side
+    if (radius > UTL_MAX(src->width, src->height))
+        radius = UTL_MAX(src->width, src->height);
 
-    for(yy=0; yy<4 ; yy++){
-        for(xx=0; xx<4 ; xx++){
-            place_block = (yy<<2) + xx;
-            place = (yy*height_4 + margin_y)*width + xx*width_4 + margin_x;
-            for(y=height_4; y>0; y-=2){
-                for(x=width_4; x>0; x-=2){
-
-                    MUINT8* addr;
-                    place_temp1 = place-width;
-                    place_temp2 = place+width;
-                    addr = p_src+place_temp1-1;
-                    value_temp1 = (MINT32)(*addr++);
-                    value_temp2 = (MINT32)(*addr++);
-                    value_temp3 = (MINT32)(*addr);
-
-                    addr = p_src+place_temp2-1;
-                    value_temp4 = (MINT32)(*addr++);
-                    value_temp5 = (MINT32)(*addr++);
-                    value_temp6 = (MINT32)(*addr);
-
-                    //sobel cofficient
-                    //sobel_y[3][3] = {{-1, -2, -1}, {0, 0, 0}, {1, 2, 1}}
-                    //sobel_x[3][3] = {{-1, 0, 1}, {-2, 0, 2}, {-1, 0, 1}}
-                    dy = -value_temp1 - (value_temp2<<1) - value_temp3 +
-                          value_temp4 + (value_temp5<<1) + value_temp6;
-
-                    dx = -value_temp1 + value_temp3
-                         -((MINT32)p_src[place-1]<<1) + ((MINT32)p_src[place+1]<<1)
-                         -value_temp4 + value_temp6;
-
-                    dy = (UTL_ABS(dx) + UTL_ABS(dy))>>1;
-                    dst[place_block] += dy;
-
-                    place+=2;
-                }
-                place = place - width_4 + width*2;
-            }
-        }
+    if (numTasks > src->height)
+        numTasks = src->height;
+
+    UTL_BOX_BAND_STRUCT bands[UTL_BLUR_MAX_TASKS];
+    for (MINT32 i = 0; i < numTasks; i++)
+    {
+        bands[i].src = p_src;
+        bands[i].dst = dst;
+        bands[i].width = src->width;
+        bands[i].height = src->height;
+        bands[i].radius = radius;
+        bands[i].row_begin = src->height * i / numTasks;
+        bands[i].row_end = src->height * (i + 1) / numTasks;
+        bands[i].result = UTIL_OK;
+    }
+    runBands(bands, sizeof(bands[0]), numTasks, boxBandJob, tpq);
+
+    for (MINT32 i = 0; i < numTasks; i++)
+    {
+        if (bands[i].result != UTIL_OK)
+            result = bands[i].result;
     }
+    if (result != UTIL_OK)
+    {
+        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
+    }
+
     return result;
 }
@@ -1,7 +1,12 @@
+
 #ifndef _UTIL_BLUR_H_
 #define _UTIL_BLUR_H_
 
 #include "MTKUtilCommon.h"
+#include "utilSystem/tpq.h"
+
+/// max number of row bands of utilBlur and utilBoxBlur
+#define UTL_BLUR_MAX_TASKS (32)
 
 /**
  *  \details blur function with 5x5 gaussion kernel
@@ -12,6 +17,20 @@
  */
 UTIL_ERRCODE_ENUM utilBlur(MUINT8 *dst, P_UTIL_CLIP_IMAGE_STRUCT src);
 
+/**
+ *  \details blur function with 5x5 gaussion kernel on row bands
+ *  \fn UTIL_ERRCODE_ENUM utilBlur(MUINT8 *dst, P_UTIL_CLIP_IMAGE_STRUCT src, tp_queue tpq, MINT32 numTasks)
+ *  \param[out] dst destination image
+ *  \param[in] src source image structure
+ *  \param[in] tpq thread pool to run the row bands on, or NULL to run on the calling thread
+ *  \param[in] numTasks number of row bands (1 to UTL_BLUR_MAX_TASKS)
+ *  \return utility error code enumerator
+ *
+ *  The kernel is run as a 1x5 pass into a ring of 5 rows and a 5x1 pass
+ *  from the ring, with the same output as utilBlur.
+ */
+UTIL_ERRCODE_ENUM utilBlur(MUINT8 *dst, P_UTIL_CLIP_IMAGE_STRUCT src, tp_queue tpq, MINT32 numTasks);
+
 /**
  *  \details sobel filter
  *  \fn UTIL_ERRCODE_ENUM utilSobel(MUINT8 *dst, P_UTIL_CLIP_IMAGE_STRUCT src)
@@ -21,5 +40,31 @@ UTIL_ERRCODE_ENUM utilBlur(MUINT8 *dst, P_UTIL_CLIP_IMAGE_STRUCT src);
  */
 UTIL_ERRCODE_ENUM utilSobel(MUINT32 *dst, P_UTIL_CLIP_IMAGE_STRUCT src);
 
-#endif /* _UTIL_BLUR_H_ */
+/**
+ *  \details integral image
+ *  \fn UTIL_ERRCODE_ENUM utilIntegralImage(MUINT32 *dst, P_UTIL_BASE_IMAGE_STRUCT src)
+ *  \param[out] dst (width + 1) x (height + 1) sums, dst[(y + 1) * (width + 1) + x + 1] is the sum of src[0..y][0..x]
+ *  \param[in] src source image structure
+ *  \return utility error code enumerator
+ *
+ *  The sums wrap at 32 bits, the difference of 4 corners still gives the
+ *  sum of any rectangle below 2^32.
+ */
+UTIL_ERRCODE_ENUM utilIntegralImage(MUINT32 *dst, P_UTIL_BASE_IMAGE_STRUCT src);
 
+/**
+ *  \details box blur, the rounded mean of the (2 * radius + 1)^2 window inside the image
+ *  \fn UTIL_ERRCODE_ENUM utilBoxBlur(MUINT8 *dst, P_UTIL_BASE_IMAGE_STRUCT src, MINT32 radius, tp_queue tpq, MINT32 numTasks)
+ *  \param[out] dst destination image, the size of src
+ *  \param[in] src source image structure
+ *  \param[in] radius window radius
+ *  \param[in] tpq thread pool to run the row bands on, or NULL to run on the calling thread
+ *  \param[in] numTasks number of row bands (1 to UTL_BLUR_MAX_TASKS)
+ *  \return utility error code enumerator
+ *
+ *  Each band keeps a ring of 2 * radius + 2 integral image rows, so the
+ *  cost per pixel does not depend on the radius.
+ */
+UTIL_ERRCODE_ENUM utilBoxBlur(MUINT8 *dst, P_UTIL_BASE_IMAGE_STRUCT src, MINT32 radius, tp_queue tpq, MINT32 numTasks);
+
+#endif /* _UTIL_BLUR_H_ */
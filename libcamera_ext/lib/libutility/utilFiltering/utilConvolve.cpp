@@ -2,6 +2,7 @@
 
 #define MTK_LOG_ENABLE 1
 #include <stdio.h>
+#include <stdlib.h>
 #if defined(__ANDROID__) || defined(ANDROID)
 #include <android/log.h>
 #define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
@@ -10,78 +11,416 @@
 #endif
 #include "utilConvolve.h"
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define CONVOLVE_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#define CONVOLVE_SSE2
+#include <emmintrin.h>
+#endif
+
+/// convolution of an image, shared by the row bands
+typedef struct
+{
+    const MUINT8 *src;
+    MUINT8 *dst;
+    MINT32 width;
+    MINT32 height;
+    const MUINT8 *kernel;       ///< kernel_height x kernel_width
+    MINT32 kernel_width;
+    MINT32 kernel_height;
+    MBOOL separable;            ///< kernel[i][j] = col_taps[i] * row_taps[j]
+    MUINT32 *row_taps;
+    MUINT32 *col_taps;
+    MINT32 *col_index;          ///< reflected column of padded column p, kernel_width - 1 + width entries
+} UTL_CONVOLVE_STRUCT;
+
+typedef struct
+{
+    const UTL_CONVOLVE_STRUCT *conv;
+    MINT32 row_begin;
+    MINT32 row_end;
+    UTIL_ERRCODE_ENUM result;
+} UTL_CONVOLVE_BAND_STRUCT;
+
+// the border rule of the per-pixel loop, -1 -> 1 and n -> n - 2
+static MINT32 reflectIndex(MINT32 i, MINT32 n)
+{
+    if (i < 0)
+        return -i;
+    if (n <= i)
+        return 2 * n - i - 2;
+    return i;
+}
+
+static MUINT32 gcd(MUINT32 a, MUINT32 b)
+{
+    while (b)
+    {
+        MUINT32 t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// split the kernel into row_taps x col_taps if it is an outer product of integers
+static MBOOL splitKernel(const MUINT8 *kernel, MINT32 kw, MINT32 kh, MUINT32 *row_taps, MUINT32 *col_taps)
+{
+    MINT32 r0 = -1, j0 = -1;
+    MUINT32 g = 0;
+
+    for (MINT32 i = 0; i < kh && r0 < 0; i++)
+    {
+        for (MINT32 j = 0; j < kw; j++)
+        {
+            if (kernel[i * kw + j])
+            {
+                r0 = i;
+                break;
+            }
+        }
+    }
+    if (r0 < 0)
+    {
+        // all zero
+        for (MINT32 j = 0; j < kw; j++)
+            row_taps[j] = 0;
+        for (MINT32 i = 0; i < kh; i++)
+            col_taps[i] = 0;
+        return 1;
+    }
+
+    // the row taps have no common factor, so every column tap is an integer
+    for (MINT32 j = 0; j < kw; j++)
+        g = gcd(g, kernel[r0 * kw + j]);
+    for (MINT32 j = 0; j < kw; j++)
+    {
+        row_taps[j] = kernel[r0 * kw + j] / g;
+        if (row_taps[j] && j0 < 0)
+            j0 = j;
+    }
+
+    for (MINT32 i = 0; i < kh; i++)
+    {
+        MUINT32 k = kernel[i * kw + j0];
+        if (k % row_taps[j0])
+            return 0;
+        col_taps[i] = k / row_taps[j0];
+        for (MINT32 j = 0; j < kw; j++)
+        {
+            if (kernel[i * kw + j] != col_taps[i] * row_taps[j])
+                return 0;
+        }
+    }
+    return 1;
+}
+
+// acc[x] (+)= sum of taps[j] * pad[x + j]
+static void filterRowTaps(const MUINT8 *pad, const MUINT32 *taps, MINT32 ntaps, MUINT32 *acc, MINT32 width, MBOOL accumulate)
+{
+    MINT32 x = 0;
+#if defined(CONVOLVE_NEON)
+    for (; x + 8 <= width; x += 8)
+    {
+        uint32x4_t v_lo = accumulate ? vld1q_u32(acc + x) : vdupq_n_u32(0);
+        uint32x4_t v_hi = accumulate ? vld1q_u32(acc + x + 4) : vdupq_n_u32(0);
+        for (MINT32 j = 0; j < ntaps; j++)
+        {
+            uint16x8_t v_src = vmovl_u8(vld1_u8(pad + x + j));
+            v_lo = vmlal_n_u16(v_lo, vget_low_u16(v_src), (MUINT16)taps[j]);
+            v_hi = vmlal_n_u16(v_hi, vget_high_u16(v_src), (MUINT16)taps[j]);
+        }
+        vst1q_u32(acc + x, v_lo);
+        vst1q_u32(acc + x + 4, v_hi);
+    }
+#elif defined(CONVOLVE_SSE2)
+    const __m128i v_zero = _mm_setzero_si128();
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i v_lo = accumulate ? _mm_loadu_si128((const __m128i *)(acc + x)) : v_zero;
+        __m128i v_hi = accumulate ? _mm_loadu_si128((const __m128i *)(acc + x + 4)) : v_zero;
+        MINT32 j = 0;
+        // two taps per madd, taps and pixels fit 16 bits
+        for (; j + 2 <= ntaps; j += 2)
+        {
+            __m128i v_src0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(pad + x + j)), v_zero);
+            __m128i v_src1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(pad + x + j + 1)), v_zero);
+            __m128i v_w = _mm_set1_epi32((MINT32)(taps[j] | (taps[j + 1] << 16)));
+            v_lo = _mm_add_epi32(v_lo, _mm_madd_epi16(_mm_unpacklo_epi16(v_src0, v_src1), v_w));
+            v_hi = _mm_add_epi32(v_hi, _mm_madd_epi16(_mm_unpackhi_epi16(v_src0, v_src1), v_w));
+        }
+        if (j < ntaps)
+        {
+            __m128i v_src0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(pad + x + j)), v_zero);
+            __m128i v_w = _mm_set1_epi32((MINT32)taps[j]);
+            v_lo = _mm_add_epi32(v_lo, _mm_madd_epi16(_mm_unpacklo_epi16(v_src0, v_zero), v_w));
+            v_hi = _mm_add_epi32(v_hi, _mm_madd_epi16(_mm_unpackhi_epi16(v_src0, v_zero), v_w));
+        }
+        _mm_storeu_si128((__m128i *)(acc + x), v_lo);
+        _mm_storeu_si128((__m128i *)(acc + x + 4), v_hi);
+    }
+#endif
+    for (; x < width; x++)
+    {
+        MUINT32 sum = accumulate ? acc[x] : 0;
+        for (MINT32 j = 0; j < ntaps; j++)
+            sum += taps[j] * pad[x + j];
+        acc[x] = sum;
+    }
+}
+
+#if defined(CONVOLVE_SSE2)
+// low 32 bits of a * b per lane
+static inline __m128i mullo32(__m128i a, __m128i b)
+{
+    __m128i v_even = _mm_mul_epu32(a, b);
+    __m128i v_odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(v_even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(v_odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+#endif
+
+// dst[x] = (MUINT8)((sum of taps[i] * rows[i][x] + 2) >> 2)
+static void filterColumnTaps(const MUINT32 *const *rows, const MUINT32 *taps, MINT32 ntaps, MUINT8 *dst, MINT32 width)
+{
+    MINT32 x = 0;
+#if defined(CONVOLVE_NEON)
+    for (; x + 8 <= width; x += 8)
+    {
+        uint32x4_t v_lo = vdupq_n_u32(2);
+        uint32x4_t v_hi = vdupq_n_u32(2);
+        for (MINT32 i = 0; i < ntaps; i++)
+        {
+            v_lo = vmlaq_n_u32(v_lo, vld1q_u32(rows[i] + x), taps[i]);
+            v_hi = vmlaq_n_u32(v_hi, vld1q_u32(rows[i] + x + 4), taps[i]);
+        }
+        // narrowing keeps the low bits, as the cast does
+        uint16x8_t v_sum = vcombine_u16(vmovn_u32(vshrq_n_u32(v_lo, 2)), vmovn_u32(vshrq_n_u32(v_hi, 2)));
+        vst1_u8(dst + x, vmovn_u16(v_sum));
+    }
+#elif defined(CONVOLVE_SSE2)
+    const __m128i v_mask = _mm_set1_epi32(0xFF);
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i v_lo = _mm_set1_epi32(2);
+        __m128i v_hi = _mm_set1_epi32(2);
+        for (MINT32 i = 0; i < ntaps; i++)
+        {
+            __m128i v_w = _mm_set1_epi32((MINT32)taps[i]);
+            v_lo = _mm_add_epi32(v_lo, mullo32(_mm_loadu_si128((const __m128i *)(rows[i] + x)), v_w));
+            v_hi = _mm_add_epi32(v_hi, mullo32(_mm_loadu_si128((const __m128i *)(rows[i] + x + 4)), v_w));
+        }
+        // keep the low bits, as the cast does
+        v_lo = _mm_and_si128(_mm_srli_epi32(v_lo, 2), v_mask);
+        v_hi = _mm_and_si128(_mm_srli_epi32(v_hi, 2), v_mask);
+        __m128i v_sum = _mm_packs_epi32(v_lo, v_hi);
+        _mm_storel_epi64((__m128i *)(dst + x), _mm_packus_epi16(v_sum, v_sum));
+    }
+#endif
+    for (; x < width; x++)
+    {
+        MUINT32 sum = 2;
+        for (MINT32 i = 0; i < ntaps; i++)
+            sum += taps[i] * rows[i][x];
+        dst[x] = (MUINT8)(sum >> 2);
+    }
+}
+
+// source row with the reflected columns around it
+static void padRow(const UTL_CONVOLVE_STRUCT *conv, MINT32 row, MUINT8 *pad)
+{
+    const MUINT8 *src = conv->src + row * conv->width;
+    const MINT32 n = conv->width + conv->kernel_width - 1;
+    for (MINT32 p = 0; p < n; p++)
+        pad[p] = src[conv->col_index[p]];
+}
+
+static UTIL_ERRCODE_ENUM convolveBandSeparable(const UTL_CONVOLVE_STRUCT *conv, MINT32 row_begin, MINT32 row_end)
+{
+    const MINT32 width = conv->width;
+    const MINT32 kh = conv->kernel_height;
+    const MINT32 center = kh / 2;
+
+    // row pass of virtual row v (before reflection) is kept in slot (v + center) % kh
+    MUINT32 *ring = (MUINT32 *)malloc(kh * width * sizeof(MUINT32));
+    MUINT8 *pad = (MUINT8 *)malloc(width + conv->kernel_width - 1);
+    const MUINT32 **rows = (const MUINT32 **)malloc(kh * sizeof(MUINT32 *));
+    if (!ring || !pad || !rows)
+    {
+        free(ring);
+        free(pad);
+        free(rows);
+        return UTIL_COMMON_ERR_OUT_OF_MEMORY;
+    }
+
+    MINT32 next = row_begin - center;
+    for (MINT32 y = row_begin; y < row_end; y++)
+    {
+        for (; next <= y + kh - 1 - center; next++)
+        {
+            padRow(conv, reflectIndex(next, conv->height), pad);
+            filterRowTaps(pad, conv->row_taps, conv->kernel_width, ring + ((next + center) % kh) * width, width, 0);
+        }
+        for (MINT32 i = 0; i < kh; i++)
+            rows[i] = ring + ((y + i) % kh) * width;
+        filterColumnTaps(rows, conv->col_taps, kh, conv->dst + y * width, width);
+    }
+
+    free(ring);
+    free(pad);
+    free(rows);
+    return UTIL_OK;
+}
+
+static UTIL_ERRCODE_ENUM convolveBandDirect(const UTL_CONVOLVE_STRUCT *conv, MINT32 row_begin, MINT32 row_end)
+{
+    const MINT32 width = conv->width;
+    const MINT32 kw = conv->kernel_width;
+    const MINT32 kh = conv->kernel_height;
+    const MUINT32 one = 1;
+    const MUINT32 *unit = &one;
+
+    // each kernel row is a row pass accumulated into one row
+    MUINT32 *acc = (MUINT32 *)malloc(width * sizeof(MUINT32));
+    MUINT32 *taps = (MUINT32 *)malloc(kw * kh * sizeof(MUINT32));
+    MUINT8 *pad = (MUINT8 *)malloc(width + kw - 1);
+    if (!acc || !taps || !pad)
+    {
+        free(acc);
+        free(taps);
+        free(pad);
+        return UTIL_COMMON_ERR_OUT_OF_MEMORY;
+    }
+    for (MINT32 i = 0; i < kw * kh; i++)
+        taps[i] = conv->kernel[i];
+
+    for (MINT32 y = row_begin; y < row_end; y++)
+    {
+        for (MINT32 i = 0; i < kh; i++)
+        {
+            padRow(conv, reflectIndex(y + i - kh / 2, conv->height), pad);
+            filterRowTaps(pad, taps + i * kw, kw, acc, width, i > 0);
+        }
+        filterColumnTaps((const MUINT32 *const *)&acc, unit, 1, conv->dst + y * width, width);
+    }
+
+    free(acc);
+    free(taps);
+    free(pad);
+    return UTIL_OK;
+}
+
+static void *convolveBandJob(void *arg, rtinfo *info)
+{
+    UTL_CONVOLVE_BAND_STRUCT *band = (UTL_CONVOLVE_BAND_STRUCT *)arg;
+    (void)info;
+    if (band->conv->separable)
+        band->result = convolveBandSeparable(band->conv, band->row_begin, band->row_end);
+    else
+        band->result = convolveBandDirect(band->conv, band->row_begin, band->row_end);
+    return NULL;
+}
 
 UTIL_ERRCODE_ENUM Convolve(const UTIL_BASE_IMAGE_STRUCT* A, const UTIL_BASE_IMAGE_STRUCT* kernel, UTIL_BASE_IMAGE_STRUCT* C)
+{
+    return Convolve(A, kernel, C, NULL, 1);
+}
+
+UTIL_ERRCODE_ENUM Convolve(const UTIL_BASE_IMAGE_STRUCT* A, const UTIL_BASE_IMAGE_STRUCT* kernel, UTIL_BASE_IMAGE_STRUCT* C,
+                           tp_queue tpq, MINT32 numTasks)
 {
     UTIL_ERRCODE_ENUM result = UTIL_OK;
-    MINT32 i, j, ii, jj, k_center_height, k_center_width;
     MINT32 width, height;
     MINT32 kernel_height, kernel_width;
-    UTIL_BASE_IMAGE_STRUCT MA, MKernel;
-    MUINT8 *pOut;
-
-    MA.data = A->data;
-    MA.height = A->height;
-    MA.width = A->width;
+    UTL_CONVOLVE_STRUCT conv;
 
     width = A->width;
     height = A->height;
 
-    MKernel.data = kernel->data;
-    MKernel.width = kernel->width;
-    MKernel.height = kernel->height;
-
     kernel_height = kernel->height;
     kernel_width = kernel->width;
 
     C->width = A->width;
     C->height = A->height;
 
-    pOut = (MUINT8 *)(C->data);
-
     // data pointer check
-    if (!MA.data || !MKernel.data || !pOut)
+    if (!A->data || !kernel->data || !C->data)
     {
         result = UTIL_COMMON_ERR_NULL_BUFFER_POINTER;
         LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
         return result;
     }
 
-    k_center_height = kernel->height/2;
-    k_center_width = kernel->width/2;
+    // the reflection reaches at most one image size away
+    if ((width <= 0) || (height <= 0) || (kernel_width <= 0) || (kernel_height <= 0) ||
+        (kernel_width / 2 >= width) || (kernel_width - 1 - kernel_width / 2 >= width) ||
+        (kernel_height / 2 >= height) || (kernel_height - 1 - kernel_height / 2 >= height) ||
+        (numTasks < 1) || (numTasks > UTL_CONVOLVE_MAX_TASKS))
+    {
+        result = UTIL_COMMON_ERR_INVALID_PARAMETER;
+        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
+        return result;
+    }
 
-    for(i=0;i<height;i++)
+    conv.src = (const MUINT8 *)A->data;
+    conv.dst = (MUINT8 *)C->data;
+    conv.width = width;
+    conv.height = height;
+    conv.kernel = (const MUINT8 *)kernel->data;
+    conv.kernel_width = kernel_width;
+    conv.kernel_height = kernel_height;
+    conv.row_taps = (MUINT32 *)malloc((kernel_width + kernel_height) * sizeof(MUINT32));
+    conv.col_index = (MINT32 *)malloc((width + kernel_width - 1) * sizeof(MINT32));
+    if (!conv.row_taps || !conv.col_index)
     {
-        for(j=0;j<width;j++)
-        {
-            int sum = 0;
+        free(conv.row_taps);
+        free(conv.col_index);
+        result = UTIL_COMMON_ERR_OUT_OF_MEMORY;
+        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
+        return result;
+    }
+    conv.col_taps = conv.row_taps + kernel_width;
+    conv.separable = splitKernel(conv.kernel, kernel_width, kernel_height, conv.row_taps, conv.col_taps);
+    for (MINT32 p = 0; p < width + kernel_width - 1; p++)
+        conv.col_index[p] = reflectIndex(p - kernel_width / 2, width);
 
-            for(ii=0;ii<kernel_height;ii++)
-            {
-                for(jj=0;jj<kernel_width;jj++)
-                {
-                    int r = i + (ii - k_center_height);
-                    int c = j  + (jj - k_center_width);
-
-                    if (r<0)
-                        r=-r;
-                    else if (height <= r)
-                        r = 2*height - r - 2;
-
-                    if (c<0)
-                        c=-c;
-                    else if (width <= c)
-                        c = 2*width - c - 2;
-
-                    sum += UTIL_ELM(MA,r,c) * UTIL_ELM(MKernel,ii,jj);
-                }
-            }
-            sum = (sum + 2)>>2;                            // cause gaussian kernel's weighting is 4  (3x3)
-            *pOut = (MUINT8)(sum);
-            pOut++;
+    if (numTasks > height)
+        numTasks = height;
+
+    UTL_CONVOLVE_BAND_STRUCT bands[UTL_CONVOLVE_MAX_TASKS];
+    for (MINT32 i = 0; i < numTasks; i++)
+    {
+        bands[i].conv = &conv;
+        bands[i].row_begin = height * i / numTasks;
+        bands[i].row_end = height * (i + 1) / numTasks;
+        bands[i].result = UTIL_OK;
+    }
+
+    if (tpq == NULL || numTasks == 1)
+    {
+        for (MINT32 i = 0; i < numTasks; i++)
+            convolveBandJob(&bands[i], NULL);
+    }
+    else
+    {
+        for (MINT32 i = 0; i < numTasks; i++)
+        {
+            if (tpq_add_work(tpq, convolveBandJob, &bands[i]) != 0)
+                convolveBandJob(&bands[i], NULL);
         }
+        tpq_exec(tpq, 0);
     }
 
+    for (MINT32 i = 0; i < numTasks; i++)
+    {
+        if (bands[i].result != UTIL_OK)
+            result = bands[i].result;
+    }
+    if (result != UTIL_OK)
+        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
+
+    free(conv.row_taps);
+    free(conv.col_index);
     return result;
 }
-
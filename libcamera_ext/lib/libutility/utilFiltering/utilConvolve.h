@@ -2,10 +2,14 @@
 #define _UTIL_CONVOLVE_H_
 
 #include "MTKUtilCommon.h"
+#include "utilSystem/tpq.h"
 
 /// get element data from image/kernel
 #define UTIL_ELM(A,i,j) ((MUINT8*)((A).data))[ (i)*(A).width + (j) ]
 
+/// max number of row bands of Convolve
+#define UTL_CONVOLVE_MAX_TASKS (32)
+
 /**
  * \details image convolution with given kernel
  * \fn UTIL_ERRCODE_ENUM Convolve(const UTIL_BASE_IMAGE_STRUCT* A, const UTIL_BASE_IMAGE_STRUCT* kernel, UTIL_BASE_IMAGE_STRUCT* C)
@@ -16,5 +20,22 @@
  */
 UTIL_ERRCODE_ENUM Convolve(const UTIL_BASE_IMAGE_STRUCT* A, const UTIL_BASE_IMAGE_STRUCT* kernel, UTIL_BASE_IMAGE_STRUCT* C);
 
+/**
+ * \details image convolution with given kernel on row bands
+ * \fn UTIL_ERRCODE_ENUM Convolve(const UTIL_BASE_IMAGE_STRUCT* A, const UTIL_BASE_IMAGE_STRUCT* kernel, UTIL_BASE_IMAGE_STRUCT* C, tp_queue tpq, MINT32 numTasks)
+ * \param[in] A input image
+ * \param[in] kernel kernel function
+ * \param[out] C output image
+ * \param[in] tpq thread pool to run the row bands on, or NULL to run on the calling thread
+ * \param[in] numTasks number of row bands (1 to UTL_CONVOLVE_MAX_TASKS)
+ * \return utility error code
+ *
+ * A kernel which is the outer product of a column and a row of integers
+ * is run as a row pass and a column pass, with the same output as the
+ * full 2D sum.
+ */
+UTIL_ERRCODE_ENUM Convolve(const UTIL_BASE_IMAGE_STRUCT* A, const UTIL_BASE_IMAGE_STRUCT* kernel, UTIL_BASE_IMAGE_STRUCT* C,
+                           tp_queue tpq, MINT32 numTasks);
+
 #endif /* _UTIL_CONVOLVE_H_ */
 
@@ -2,6 +2,7 @@
 
 #define MTK_LOG_ENABLE 1
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #if defined(__ANDROID__) || defined(ANDROID)
 #include <android/log.h>
@@ -9,8 +10,48 @@
 #else // WIN32 or LINUX64
 #define LOGD printf
 #endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define HARRIS_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#define HARRIS_SSE2
+#include <emmintrin.h>
+#endif
+
 #include "utilHarrisDetector.h"
 
+/// rows of a band of utilHarrisResponse
+typedef struct
+{
+    const MUINT8 *src;
+    MINT32 *dst;
+    MINT32 width;
+    MINT32 x_offset;
+    MINT32 row_begin;
+    MINT32 row_end;
+    MINT32 count;       ///< # of corner responses
+    UTIL_ERRCODE_ENUM result;
+} UTL_HARRIS_BAND_STRUCT;
+
+/// response from the sums of dx^2, dy^2 and dx*dy over the 5x5 window
+static inline MINT32 CornerResponse(MUINT32 dxavg, MUINT32 dyavg, MINT32 dxyavg)
+{
+    MINT32 Det, Tr;
+    MINT32 tmp;
+
+    dxavg = (denom * dxavg + (1<<(HARRIS_AVG_BITS-1))) >> HARRIS_AVG_BITS;
+    dyavg = (denom * dyavg + (1<<(HARRIS_AVG_BITS-1))) >> HARRIS_AVG_BITS;
+
+    // the product wraps at 32 bits, the sum is up to 25 * 128 * 128
+    dxyavg = (MINT32)((MUINT32)denom * (MUINT32)dxyavg) >> HARRIS_AVG_BITS;
+
+    Det = dxavg * dyavg - dxyavg * dxyavg;
+    Tr = dxavg + dyavg;
+    tmp  = (((KAPPA + 1) * Tr * Tr + (1<<(FE_HARRIS_KAPPA_BITS-1))) >> FE_HARRIS_KAPPA_BITS);
+
+    return Det - tmp;
+}
+
 MINT32 GetCornerResponse(MINT8 *grdx, MINT8 *grdy, MINT32 w)
 {
     //kappa = FE_Harris_kappa
@@ -20,9 +61,6 @@ MINT32 GetCornerResponse(MINT8 *grdx, MINT8 *grdy, MINT32 w)
     MUINT32 dyavg = 0;
     MINT32 dxyavg = 0;
 
-    MINT32 Det, Tr;
-    MINT32 rc;
-    MINT32 tmp;
     MINT32 dx, dy, dxy;
     MINT8 *grdx_ind2,*grdy_ind2;
 
@@ -46,17 +84,7 @@ MINT32 GetCornerResponse(MINT8 *grdx, MINT8 *grdy, MINT32 w)
         }
     }
 
-    dxavg = (denom * dxavg + (1<<(HARRIS_AVG_BITS-1))) >> HARRIS_AVG_BITS;
-    dyavg = (denom * dyavg + (1<<(HARRIS_AVG_BITS-1))) >> HARRIS_AVG_BITS;
-
-    dxyavg = (denom * dxyavg) >> HARRIS_AVG_BITS;
-
-    Det = dxavg * dyavg - dxyavg * dxyavg;
-    Tr = dxavg + dyavg;
-    tmp  = (((KAPPA + 1) * Tr * Tr + (1<<(FE_HARRIS_KAPPA_BITS-1))) >> FE_HARRIS_KAPPA_BITS);
-    rc = Det - tmp;
-
-    return rc;
+    return CornerResponse(dxavg, dyavg, dxyavg);
 }
 
 UTIL_ERRCODE_ENUM utilHarrisDetector(P_UTIL_CLIP_IMAGE_STRUCT dst, MINT8* src_x, MINT8* src_y, MINT32 *range)
@@ -108,3 +136,388 @@ UTIL_ERRCODE_ENUM utilHarrisDetector(P_UTIL_CLIP_IMAGE_STRUCT dst, MINT8* src_x,
     *pVarNei = count/10000;
     return result;
 }
+
+// gradients of utilPartialDerivative at src[0..n), and their products
+static void gradientRow(const MUINT8 *src, MINT32 stride, MINT32 n, MINT8 *gx, MINT8 *gy,
+                        MINT32 *pxx, MINT32 *pyy, MINT32 *pxy)
+{
+    MINT32 c = 0;
+#if defined(HARRIS_NEON)
+    for (; c + 8 <= n; c += 8)
+    {
+        // (a - b) >> 1 of two bytes is -128 .. 127
+        int16x8_t v_dx = vshrq_n_s16(vreinterpretq_s16_u16(vsubl_u8(vld1_u8(src + c - 1), vld1_u8(src + c + 1))), 1);
+        int16x8_t v_dy = vshrq_n_s16(vreinterpretq_s16_u16(vsubl_u8(vld1_u8(src + c - stride), vld1_u8(src + c + stride))), 1);
+        vst1_s8(gx + c, vmovn_s16(v_dx));
+        vst1_s8(gy + c, vmovn_s16(v_dy));
+        vst1q_s32(pxx + c, vmull_s16(vget_low_s16(v_dx), vget_low_s16(v_dx)));
+        vst1q_s32(pxx + c + 4, vmull_s16(vget_high_s16(v_dx), vget_high_s16(v_dx)));
+        vst1q_s32(pyy + c, vmull_s16(vget_low_s16(v_dy), vget_low_s16(v_dy)));
+        vst1q_s32(pyy + c + 4, vmull_s16(vget_high_s16(v_dy), vget_high_s16(v_dy)));
+        vst1q_s32(pxy + c, vmull_s16(vget_low_s16(v_dx), vget_low_s16(v_dy)));
+        vst1q_s32(pxy + c + 4, vmull_s16(vget_high_s16(v_dx), vget_high_s16(v_dy)));
+    }
+#elif defined(HARRIS_SSE2)
+    const __m128i v_zero = _mm_setzero_si128();
+    for (; c + 8 <= n; c += 8)
+    {
+        __m128i v_l = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(src + c - 1)), v_zero);
+        __m128i v_r = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(src + c + 1)), v_zero);
+        __m128i v_u = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(src + c - stride)), v_zero);
+        __m128i v_d = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(src + c + stride)), v_zero);
+        // (a - b) >> 1 of two bytes is -128 .. 127
+        __m128i v_dx = _mm_srai_epi16(_mm_sub_epi16(v_l, v_r), 1);
+        __m128i v_dy = _mm_srai_epi16(_mm_sub_epi16(v_u, v_d), 1);
+        _mm_storel_epi64((__m128i *)(gx + c), _mm_packs_epi16(v_dx, v_dx));
+        _mm_storel_epi64((__m128i *)(gy + c), _mm_packs_epi16(v_dy, v_dy));
+
+        // a gradient and a zero in each 32-bit lane, so madd gives the 32-bit product
+        __m128i v_dx_lo = _mm_unpacklo_epi16(v_dx, v_zero);
+        __m128i v_dx_hi = _mm_unpackhi_epi16(v_dx, v_zero);
+        __m128i v_dy_lo = _mm_unpacklo_epi16(v_dy, v_zero);
+        __m128i v_dy_hi = _mm_unpackhi_epi16(v_dy, v_zero);
+        _mm_storeu_si128((__m128i *)(pxx + c), _mm_madd_epi16(v_dx_lo, v_dx_lo));
+        _mm_storeu_si128((__m128i *)(pxx + c + 4), _mm_madd_epi16(v_dx_hi, v_dx_hi));
+        _mm_storeu_si128((__m128i *)(pyy + c), _mm_madd_epi16(v_dy_lo, v_dy_lo));
+        _mm_storeu_si128((__m128i *)(pyy + c + 4), _mm_madd_epi16(v_dy_hi, v_dy_hi));
+        _mm_storeu_si128((__m128i *)(pxy + c), _mm_madd_epi16(v_dx_lo, v_dy_lo));
+        _mm_storeu_si128((__m128i *)(pxy + c + 4), _mm_madd_epi16(v_dx_hi, v_dy_hi));
+    }
+#endif
+    for (; c < n; c++)
+    {
+        MINT32 dx = ((MINT32)src[c - 1] - src[c + 1]) >> 1;
+        MINT32 dy = ((MINT32)src[c - stride] - src[c + stride]) >> 1;
+        gx[c] = (MINT8)dx;
+        gy[c] = (MINT8)dy;
+        pxx[c] = dx * dx;
+        pyy[c] = dy * dy;
+        pxy[c] = dx * dy;
+    }
+}
+
+// sum[c] += add[c] - sub[c], or sum[c] += add[c] without sub
+static void slideColumnSums(MINT32 *sum, const MINT32 *add, const MINT32 *sub, MINT32 n)
+{
+    MINT32 c = 0;
+    if (sub == NULL)
+    {
+        for (; c < n; c++)
+            sum[c] += add[c];
+        return;
+    }
+#if defined(HARRIS_NEON)
+    for (; c + 4 <= n; c += 4)
+        vst1q_s32(sum + c, vaddq_s32(vld1q_s32(sum + c), vsubq_s32(vld1q_s32(add + c), vld1q_s32(sub + c))));
+#elif defined(HARRIS_SSE2)
+    for (; c + 4 <= n; c += 4)
+    {
+        __m128i v_d = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(add + c)), _mm_loadu_si128((const __m128i *)(sub + c)));
+        _mm_storeu_si128((__m128i *)(sum + c), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(sum + c)), v_d));
+    }
+#endif
+    for (; c < n; c++)
+        sum[c] += add[c] - sub[c];
+}
+
+// win[x] = sum[x] + .. + sum[x + 4], the 5x5 window sums of a row from its column sums
+static void windowRow(const MINT32 *sum, MINT32 *win, MINT32 n)
+{
+    MINT32 x = 0;
+#if defined(HARRIS_NEON)
+    for (; x + 4 <= n; x += 4)
+    {
+        int32x4_t v_sum = vaddq_s32(vld1q_s32(sum + x), vld1q_s32(sum + x + 1));
+        v_sum = vaddq_s32(v_sum, vaddq_s32(vld1q_s32(sum + x + 2), vld1q_s32(sum + x + 3)));
+        vst1q_s32(win + x, vaddq_s32(v_sum, vld1q_s32(sum + x + 4)));
+    }
+#elif defined(HARRIS_SSE2)
+    for (; x + 4 <= n; x += 4)
+    {
+        __m128i v_sum = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(sum + x)),
+                                      _mm_loadu_si128((const __m128i *)(sum + x + 1)));
+        v_sum = _mm_add_epi32(v_sum, _mm_add_epi32(_mm_loadu_si128((const __m128i *)(sum + x + 2)),
+                                                   _mm_loadu_si128((const __m128i *)(sum + x + 3))));
+        _mm_storeu_si128((__m128i *)(win + x), _mm_add_epi32(v_sum, _mm_loadu_si128((const __m128i *)(sum + x + 4))));
+    }
+#endif
+    for (; x < n; x++)
+        win[x] = sum[x] + sum[x + 1] + sum[x + 2] + sum[x + 3] + sum[x + 4];
+}
+
+#if defined(HARRIS_SSE2)
+// the low 32 bits of the products of the lanes, as _mm_mullo_epi32 of SSE4.1
+static inline __m128i mullo32(__m128i a, __m128i b)
+{
+    __m128i v_even = _mm_mul_epu32(a, b);
+    __m128i v_odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(v_even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(v_odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+#endif
+
+// CornerResponse of each window, into wxx; the products wrap at 32 bits as there
+static void responseRow(MINT32 *wxx, const MINT32 *wyy, const MINT32 *wxy, MINT32 n)
+{
+    MINT32 x = 0;
+#if defined(HARRIS_NEON)
+    const uint32x4_t v_denom = vdupq_n_u32(denom);
+    const uint32x4_t v_half = vdupq_n_u32(1 << (HARRIS_AVG_BITS - 1));
+    const int32x4_t v_kappa_half = vdupq_n_s32(1 << (FE_HARRIS_KAPPA_BITS - 1));
+    for (; x + 4 <= n; x += 4)
+    {
+        uint32x4_t v_xx = vshrq_n_u32(vmlaq_u32(v_half, v_denom, vreinterpretq_u32_s32(vld1q_s32(wxx + x))), HARRIS_AVG_BITS);
+        uint32x4_t v_yy = vshrq_n_u32(vmlaq_u32(v_half, v_denom, vreinterpretq_u32_s32(vld1q_s32(wyy + x))), HARRIS_AVG_BITS);
+        int32x4_t v_xy = vshrq_n_s32(vreinterpretq_s32_u32(vmulq_u32(v_denom, vreinterpretq_u32_s32(vld1q_s32(wxy + x)))), HARRIS_AVG_BITS);
+        int32x4_t v_det = vsubq_s32(vreinterpretq_s32_u32(vmulq_u32(v_xx, v_yy)), vmulq_s32(v_xy, v_xy));
+        int32x4_t v_tr = vreinterpretq_s32_u32(vaddq_u32(v_xx, v_yy));
+        int32x4_t v_tmp = vmulq_s32(vmulq_n_s32(v_tr, KAPPA + 1), v_tr);
+        v_tmp = vshrq_n_s32(vaddq_s32(v_tmp, v_kappa_half), FE_HARRIS_KAPPA_BITS);
+        vst1q_s32(wxx + x, vsubq_s32(v_det, v_tmp));
+    }
+#elif defined(HARRIS_SSE2)
+    const __m128i v_denom = _mm_set1_epi32(denom);
+    const __m128i v_half = _mm_set1_epi32(1 << (HARRIS_AVG_BITS - 1));
+    const __m128i v_kappa = _mm_set1_epi32(KAPPA + 1);
+    const __m128i v_kappa_half = _mm_set1_epi32(1 << (FE_HARRIS_KAPPA_BITS - 1));
+    for (; x + 4 <= n; x += 4)
+    {
+        __m128i v_xx = _mm_srli_epi32(_mm_add_epi32(mullo32(v_denom, _mm_loadu_si128((const __m128i *)(wxx + x))), v_half), HARRIS_AVG_BITS);
+        __m128i v_yy = _mm_srli_epi32(_mm_add_epi32(mullo32(v_denom, _mm_loadu_si128((const __m128i *)(wyy + x))), v_half), HARRIS_AVG_BITS);
+        __m128i v_xy = _mm_srai_epi32(mullo32(v_denom, _mm_loadu_si128((const __m128i *)(wxy + x))), HARRIS_AVG_BITS);
+        __m128i v_det = _mm_sub_epi32(mullo32(v_xx, v_yy), mullo32(v_xy, v_xy));
+        __m128i v_tr = _mm_add_epi32(v_xx, v_yy);
+        __m128i v_tmp = mullo32(mullo32(v_kappa, v_tr), v_tr);
+        v_tmp = _mm_srai_epi32(_mm_add_epi32(v_tmp, v_kappa_half), FE_HARRIS_KAPPA_BITS);
+        _mm_storeu_si128((__m128i *)(wxx + x), _mm_sub_epi32(v_det, v_tmp));
+    }
+#endif
+    for (; x < n; x++)
+        wxx[x] = CornerResponse(wxx[x], wyy[x], wxy[x]);
+}
+
+// rc[x] = resp[x] where both gradients are out of -4 .. 4, else 0; returns the # of those
+static MINT32 selectRow(const MINT8 *gx, const MINT8 *gy, const MINT32 *resp, MINT32 *rc, MINT32 n)
+{
+    MINT32 x = 0;
+    MINT32 count = 0;
+#if defined(HARRIS_NEON)
+    const int8x16_t v_4 = vdupq_n_s8(4);
+    for (; x + 16 <= n; x += 16)
+    {
+        // saturating, so -128 is out of -4 .. 4 too
+        uint8x16_t v_mask = vandq_u8(vcgtq_s8(vqabsq_s8(vld1q_s8(gx + x)), v_4),
+                                     vcgtq_s8(vqabsq_s8(vld1q_s8(gy + x)), v_4));
+        int8x16x2_t v_zip = vzipq_s8(vreinterpretq_s8_u8(v_mask), vreinterpretq_s8_u8(v_mask));
+        int16x8_t v_lo = vreinterpretq_s16_s8(v_zip.val[0]);
+        int16x8_t v_hi = vreinterpretq_s16_s8(v_zip.val[1]);
+        int32x4_t v_m0 = vmovl_s16(vget_low_s16(v_lo));
+        int32x4_t v_m1 = vmovl_s16(vget_high_s16(v_lo));
+        int32x4_t v_m2 = vmovl_s16(vget_low_s16(v_hi));
+        int32x4_t v_m3 = vmovl_s16(vget_high_s16(v_hi));
+        vst1q_s32(rc + x, vandq_s32(vld1q_s32(resp + x), v_m0));
+        vst1q_s32(rc + x + 4, vandq_s32(vld1q_s32(resp + x + 4), v_m1));
+        vst1q_s32(rc + x + 8, vandq_s32(vld1q_s32(resp + x + 8), v_m2));
+        vst1q_s32(rc + x + 12, vandq_s32(vld1q_s32(resp + x + 12), v_m3));
+        uint64x2_t v_count = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(vshrq_n_u8(v_mask, 7))));
+        count += (MINT32)(vgetq_lane_u64(v_count, 0) + vgetq_lane_u64(v_count, 1));
+    }
+#elif defined(HARRIS_SSE2)
+    const __m128i v_4 = _mm_set1_epi8(4);
+    const __m128i v_m4 = _mm_set1_epi8(-4);
+    for (; x + 16 <= n; x += 16)
+    {
+        __m128i v_gx = _mm_loadu_si128((const __m128i *)(gx + x));
+        __m128i v_gy = _mm_loadu_si128((const __m128i *)(gy + x));
+        __m128i v_mask = _mm_and_si128(_mm_or_si128(_mm_cmpgt_epi8(v_gx, v_4), _mm_cmplt_epi8(v_gx, v_m4)),
+                                       _mm_or_si128(_mm_cmpgt_epi8(v_gy, v_4), _mm_cmplt_epi8(v_gy, v_m4)));
+        // widen the byte masks to the 32-bit lanes of the responses
+        __m128i v_lo = _mm_unpacklo_epi8(v_mask, v_mask);
+        __m128i v_hi = _mm_unpackhi_epi8(v_mask, v_mask);
+        _mm_storeu_si128((__m128i *)(rc + x), _mm_and_si128(_mm_loadu_si128((const __m128i *)(resp + x)), _mm_unpacklo_epi16(v_lo, v_lo)));
+        _mm_storeu_si128((__m128i *)(rc + x + 4), _mm_and_si128(_mm_loadu_si128((const __m128i *)(resp + x + 4)), _mm_unpackhi_epi16(v_lo, v_lo)));
+        _mm_storeu_si128((__m128i *)(rc + x + 8), _mm_and_si128(_mm_loadu_si128((const __m128i *)(resp + x + 8)), _mm_unpacklo_epi16(v_hi, v_hi)));
+        _mm_storeu_si128((__m128i *)(rc + x + 12), _mm_and_si128(_mm_loadu_si128((const __m128i *)(resp + x + 12)), _mm_unpackhi_epi16(v_hi, v_hi)));
+        count += __builtin_popcount(_mm_movemask_epi8(v_mask));
+    }
+#endif
+    for (; x < n; x++)
+    {
+        if (!( (unsigned)(gx[x]+4) <= 8 ) && !( (unsigned)(gy[x]+4) <= 8 ))
+        {
+            rc[x] = resp[x];
+            count++;
+        }
+        else
+        {
+            rc[x] = 0;
+        }
+    }
+    return count;
+}
+
+static void *harrisBandJob(void *arg, rtinfo *info)
+{
+    UTL_HARRIS_BAND_STRUCT *band = (UTL_HARRIS_BAND_STRUCT *)arg;
+    const MINT32 w = band->width;
+    const MINT32 x_offset = band->x_offset;
+    // columns x_offset - 2 .. w - x_offset + 1 of the window
+    const MINT32 n = w - 2 * x_offset + 4;
+    const MINT32 c0 = x_offset - 2;
+    const MINT32 out_w = w - 2 * x_offset;
+    MINT32 count = 0;
+    (void)info;
+
+    // gradient row r is kept in slot r % 6, so row y + 2 does not take the
+    // slot of row y - 3 before it leaves the column sums of the 5 rows around
+    // the output row; then the 5x5 window sums of the output row
+    MINT8 *grad = (MINT8 *)malloc(6 * 2 * n);
+    MINT32 *prod = (MINT32 *)malloc((6 * 3 + 3 + 3) * n * sizeof(MINT32));
+    if (!grad || !prod)
+    {
+        free(grad);
+        free(prod);
+        band->result = UTIL_COMMON_ERR_OUT_OF_MEMORY;
+        return NULL;
+    }
+    MINT32 *sxx = prod + 6 * 3 * n;
+    MINT32 *syy = sxx + n;
+    MINT32 *sxy = syy + n;
+    MINT32 *wxx = sxy + n;
+    MINT32 *wyy = wxx + n;
+    MINT32 *wxy = wyy + n;
+
+#define GX(r)   (grad + ((r) % 6) * 2 * n)
+#define GY(r)   (GX(r) + n)
+#define PXX(r)  (prod + ((r) % 6) * 3 * n)
+#define PYY(r)  (PXX(r) + n)
+#define PXY(r)  (PXX(r) + 2 * n)
+
+    memset(sxx, 0, 3 * n * sizeof(MINT32));
+    for (MINT32 r = band->row_begin - 2; r < band->row_begin + 2; r++)
+    {
+        gradientRow(band->src + r * w + c0, w, n, GX(r), GY(r), PXX(r), PYY(r), PXY(r));
+        slideColumnSums(sxx, PXX(r), NULL, n);
+        slideColumnSums(syy, PYY(r), NULL, n);
+        slideColumnSums(sxy, PXY(r), NULL, n);
+    }
+
+    for (MINT32 y = band->row_begin; y < band->row_end; y++)
+    {
+        // slide the column sums down to rows y - 2 .. y + 2
+        const MINT32 r = y + 2;
+        const MINT32 old = y - 3;
+        const MINT32 has_old = y > band->row_begin;
+        gradientRow(band->src + r * w + c0, w, n, GX(r), GY(r), PXX(r), PYY(r), PXY(r));
+        slideColumnSums(sxx, PXX(r), has_old ? PXX(old) : NULL, n);
+        slideColumnSums(syy, PYY(r), has_old ? PYY(old) : NULL, n);
+        slideColumnSums(sxy, PXY(r), has_old ? PXY(old) : NULL, n);
+
+        windowRow(sxx, wxx, out_w);
+        windowRow(syy, wyy, out_w);
+        windowRow(sxy, wxy, out_w);
+
+        const MINT8 *gx = GX(y) + 2;
+        const MINT8 *gy = GY(y) + 2;
+        MINT32 *rc = band->dst + y * w;
+        memset(rc, 0, x_offset * sizeof(MINT32));
+        memset(rc + w - x_offset, 0, x_offset * sizeof(MINT32));
+        rc += x_offset;
+
+        // the response of every window, kept where both gradients are out of -4 .. 4
+        responseRow(wxx, wyy, wxy, out_w);
+        count += selectRow(gx, gy, wxx, rc, out_w);
+    }
+
+#undef GX
+#undef GY
+#undef PXX
+#undef PYY
+#undef PXY
+
+    free(grad);
+    free(prod);
+    band->count = count;
+    band->result = UTIL_OK;
+    return NULL;
+}
+
+UTIL_ERRCODE_ENUM utilHarrisResponse(P_UTIL_CLIP_IMAGE_STRUCT dst, P_UTIL_BASE_IMAGE_STRUCT src, MINT32 *range, tp_queue tpq, MINT32 numTasks)
+{
+    UTIL_ERRCODE_ENUM result = UTIL_OK;
+    MINT32 *rc = (MINT32 *)dst->data;
+    MUINT8 *pBlurImage = (MUINT8 *)src->data;
+    MINT32 w = dst->width;
+    MINT32 h = dst->height;
+    MINT32 x_offset = dst->clip_x;
+    MINT32 y_offset = dst->clip_y;
+    MINT32 rows = h - 2*y_offset;
+    MINT32 count = 0;
+
+    // data pointer check
+    if (!rc || !pBlurImage || !range)
+    {
+        result = UTIL_COMMON_ERR_NULL_BUFFER_POINTER;
+        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
+        return result;
+    }
+
+    // the 5x5 window of gradients must be inside rows 1 .. h - 2, where utilPartialDerivative writes dy
+    if ((src->width != w) || (src->height != h) || (x_offset < 2) || (y_offset < 3) ||
+        (rows <= 0) || (w - 2*x_offset <= 0) || (numTasks < 1) || (numTasks > UTL_HARRIS_MAX_TASKS))
+    {
+        result = UTIL_COMMON_ERR_INVALID_PARAMETER;
+        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
+        return result;
+    }
+
+    // rows out of the clip, the bands clear their own
+    memset(rc, 0, y_offset*w*sizeof(MINT32));
+    memset(rc + (h - y_offset)*w, 0, y_offset*w*sizeof(MINT32));
+
+    if (numTasks > rows)
+        numTasks = rows;
+
+    UTL_HARRIS_BAND_STRUCT bands[UTL_HARRIS_MAX_TASKS];
+    for (MINT32 i = 0; i < numTasks; i++)
+    {
+        bands[i].src = pBlurImage;
+        bands[i].dst = rc;
+        bands[i].width = w;
+        bands[i].x_offset = x_offset;
+        bands[i].row_begin = y_offset + rows * i / numTasks;
+        bands[i].row_end = y_offset + rows * (i + 1) / numTasks;
+        bands[i].count = 0;
+        bands[i].result = UTIL_OK;
+    }
+
+    if (tpq == NULL || numTasks == 1)
+    {
+        for (MINT32 i = 0; i < numTasks; i++)
+            harrisBandJob(&bands[i], NULL);
+    }
+    else
+    {
+        for (MINT32 i = 0; i < numTasks; i++)
+        {
+            if (tpq_add_work(tpq, harrisBandJob, &bands[i]) != 0)
+                harrisBandJob(&bands[i], NULL);
+        }
+        tpq_exec(tpq, 0);
+    }
+
+    for (MINT32 i = 0; i < numTasks; i++)
+    {
+        if (bands[i].result != UTIL_OK)
+            result = bands[i].result;
+        count += bands[i].count;
+    }
+    if (result != UTIL_OK)
+    {
+        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
+        return result;
+    }
+
+    *range = count/10000;
+    return result;
+}
@@ -2,11 +2,13 @@
 #define _UTIL_HARRIS_DETECTOR_H_
 
 #include "MTKUtilCommon.h"
+#include "utilSystem/tpq.h"
 
 #define denom                   (41943)                     ///< 20-bit is used
 #define KAPPA                   (3)                         ///< Harris kappa
 #define FE_HARRIS_KAPPA_BITS    (5)                         ///< FE Harris Kappa bits
 #define HARRIS_AVG_BITS         (20)                        ///< Harris average bits
+#define UTL_HARRIS_MAX_TASKS    (32)                        ///< max number of row bands of utilHarrisResponse
 
 /**
  *  \details Harris corner detection
@@ -19,5 +21,22 @@
  */
 UTIL_ERRCODE_ENUM utilHarrisDetector(P_UTIL_CLIP_IMAGE_STRUCT dst, MINT8* src_x, MINT8* src_y, MINT32 *range);
 
+/**
+ *  \details Harris corner detection from the blurred image, fused with the partial derivatives
+ *  \fn UTIL_ERRCODE_ENUM utilHarrisResponse(P_UTIL_CLIP_IMAGE_STRUCT dst, P_UTIL_BASE_IMAGE_STRUCT src, MINT32 *range, tp_queue tpq, MINT32 numTasks)
+ *  \param[out] dst destination image structure, clip_x >= 2 and clip_y >= 3
+ *  \param[in] src blurred image, the size of dst
+ *  \param[in,out] range variable window range
+ *  \param[in] tpq thread pool to run the row bands on, or NULL to run on the calling thread
+ *  \param[in] numTasks number of row bands (1 to UTL_HARRIS_MAX_TASKS)
+ *  \return utility error code enumerator
+ *
+ *  Gives the output of utilPartialDerivative followed by utilHarrisDetector
+ *  without the gradient images. Each band computes the gradients of its
+ *  rows once and keeps sliding 5x5 sums of dx^2, dy^2 and dx*dy. The
+ *  gradients, the window sums and the response run on NEON or SSE2.
+ */
+UTIL_ERRCODE_ENUM utilHarrisResponse(P_UTIL_CLIP_IMAGE_STRUCT dst, P_UTIL_BASE_IMAGE_STRUCT src, MINT32 *range, tp_queue tpq, MINT32 numTasks);
+
 #endif /* _UTIL_HARRIS_DETECTOR_H_ */
 
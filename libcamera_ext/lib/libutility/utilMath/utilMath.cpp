@@ -11,6 +11,14 @@
 
 #include "utilMath.h"
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MATH_NEON
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MATH_SSE2
+#endif
+
 MINT32 utilFloorf(MFLOAT i)
 {
     MINT32 x;
@@ -243,6 +251,357 @@ void utilQuickSort(MFLOAT arr[], MINT32 beg, MINT32 end)
 }
 
 
+/**********************************/
+/* Fixed size linear solvers      */
+/**********************************/
+// row[i] += f * src[i], i in [0, N)
+template <MINT32 N>
+static inline void rowAxpy(MFLOAT *row, const MFLOAT *src, MFLOAT f)
+{
+    MINT32 i = 0;
+#if defined(MATH_NEON)
+    float32x4_t v_f = vdupq_n_f32(f);
+    for (; i + 4 <= N; i += 4)
+        vst1q_f32(row + i, vmlaq_f32(vld1q_f32(row + i), vld1q_f32(src + i), v_f));
+#elif defined(MATH_SSE2)
+    __m128 f4 = _mm_set1_ps(f);
+    for (; i + 4 <= N; i += 4)
+        _mm_storeu_ps(row + i, _mm_add_ps(_mm_loadu_ps(row + i), _mm_mul_ps(_mm_loadu_ps(src + i), f4)));
+#endif
+    for (; i < N; i++)
+        row[i] += f * src[i];
+}
+
+// Gaussian elimination with partial pivoting, the rows of the 4 and 8 wide systems are vectors
+template <MINT32 N>
+static MBOOL solveLu(MFLOAT *x, const MFLOAT *A, const MFLOAT *b)
+{
+    MFLOAT a[N][N], v[N], y[N];
+    MINT32 i, j, k;
+
+    for (i = 0; i < N; i++)
+    {
+        for (j = 0; j < N; j++)
+            a[i][j] = A[i * N + j];
+        v[i] = b[i];
+    }
+
+    for (i = 0; i < N; i++)
+    {
+        k = i;
+        for (j = i + 1; j < N; j++)
+        {
+            if (UTL_FABS(a[j][i]) > UTL_FABS(a[k][i]))
+                k = j;
+        }
+        // zero, denormal or NaN pivot
+        if (!(UTL_FABS(a[k][i]) > FLT_MIN))
+        {
+            memset(x, 0, N * sizeof(MFLOAT));
+            return 0;
+        }
+        if (k != i)
+        {
+            for (j = 0; j < N; j++)
+                utilSwap(&a[i][j], &a[k][j]);
+            utilSwap(&v[i], &v[k]);
+        }
+
+        MFLOAT inv = 1.0f / a[i][i];
+        for (j = i + 1; j < N; j++)
+        {
+            MFLOAT f = -a[j][i] * inv;
+            rowAxpy<N>(a[j], a[i], f);
+            v[j] += f * v[i];
+        }
+    }
+
+    for (i = N - 1; i >= 0; i--)
+    {
+        MFLOAT sum = v[i];
+        for (j = i + 1; j < N; j++)
+            sum -= a[i][j] * y[j];
+        y[i] = sum / a[i][i];
+    }
+    memcpy(x, y, N * sizeof(MFLOAT));
+    return 1;
+}
+
+// A = L L^T from the lower triangle of A, then L y = b and L^T x = y
+template <MINT32 N>
+static MBOOL solveChol(MFLOAT *x, const MFLOAT *A, const MFLOAT *b)
+{
+    MFLOAT L[N][N], inv[N], y[N];
+    MINT32 i, j, k;
+
+    for (j = 0; j < N; j++)
+    {
+        MFLOAT d = A[j * N + j];
+        for (k = 0; k < j; k++)
+            d -= L[j][k] * L[j][k];
+        if (!(d > FLT_MIN))
+        {
+            memset(x, 0, N * sizeof(MFLOAT));
+            return 0;
+        }
+        inv[j] = 1.0f / sqrtf(d);
+        for (i = j + 1; i < N; i++)
+        {
+            MFLOAT s = A[i * N + j];
+            for (k = 0; k < j; k++)
+                s -= L[i][k] * L[j][k];
+            L[i][j] = s * inv[j];
+        }
+    }
+
+    for (i = 0; i < N; i++)
+    {
+        MFLOAT s = b[i];
+        for (k = 0; k < i; k++)
+            s -= L[i][k] * y[k];
+        y[i] = s * inv[i];
+    }
+    for (i = N - 1; i >= 0; i--)
+    {
+        MFLOAT s = y[i];
+        for (k = i + 1; k < N; k++)
+            s -= L[k][i] * x[k];
+        x[i] = s * inv[i];
+    }
+    return 1;
+}
+
+#if defined(MATH_NEON) || defined(MATH_SSE2)
+/*
+ * 4 Cholesky solves at once, system p in lane p
+ */
+#if defined(MATH_NEON)
+typedef float32x4_t UTL_V4;
+static inline UTL_V4 v4Load(const MFLOAT *p) { return vld1q_f32(p); }
+static inline void v4Store(MFLOAT *p, UTL_V4 a) { vst1q_f32(p, a); }
+static inline UTL_V4 v4Mul(UTL_V4 a, UTL_V4 b) { return vmulq_f32(a, b); }
+static inline UTL_V4 v4Mls(UTL_V4 a, UTL_V4 b, UTL_V4 c) { return vmlsq_f32(a, b, c); }
+
+// lanes not above FLT_MIN are cleared from *ok and set to 1
+static inline UTL_V4 v4Pivot(UTL_V4 d, MINT32 *ok)
+{
+    uint32x4_t v_gt = vcgtq_f32(d, vdupq_n_f32(FLT_MIN));
+    *ok &= (vgetq_lane_u32(v_gt, 0) & 1) | (vgetq_lane_u32(v_gt, 1) & 2) |
+           (vgetq_lane_u32(v_gt, 2) & 4) | (vgetq_lane_u32(v_gt, 3) & 8);
+    return vbslq_f32(v_gt, d, vdupq_n_f32(1.0f));
+}
+
+static inline UTL_V4 v4RcpSqrt(UTL_V4 d)
+{
+#if defined(__aarch64__)
+    return vdivq_f32(vdupq_n_f32(1.0f), vsqrtq_f32(d));
+#else
+    UTL_V4 v_r = vrsqrteq_f32(d);
+    v_r = vmulq_f32(v_r, vrsqrtsq_f32(vmulq_f32(d, v_r), v_r));
+    v_r = vmulq_f32(v_r, vrsqrtsq_f32(vmulq_f32(d, v_r), v_r));
+    return v_r;
+#endif
+}
+#else
+typedef __m128 UTL_V4;
+static inline UTL_V4 v4Load(const MFLOAT *p) { return _mm_loadu_ps(p); }
+static inline void v4Store(MFLOAT *p, UTL_V4 a) { _mm_storeu_ps(p, a); }
+static inline UTL_V4 v4Mul(UTL_V4 a, UTL_V4 b) { return _mm_mul_ps(a, b); }
+static inline UTL_V4 v4Mls(UTL_V4 a, UTL_V4 b, UTL_V4 c) { return _mm_sub_ps(a, _mm_mul_ps(b, c)); }
+
+// lanes not above FLT_MIN are cleared from *ok and set to 1
+static inline UTL_V4 v4Pivot(UTL_V4 d, MINT32 *ok)
+{
+    __m128 gt = _mm_cmpgt_ps(d, _mm_set1_ps(FLT_MIN));
+    *ok &= _mm_movemask_ps(gt);
+    return _mm_or_ps(_mm_and_ps(gt, d), _mm_andnot_ps(gt, _mm_set1_ps(1.0f)));
+}
+
+static inline UTL_V4 v4RcpSqrt(UTL_V4 d)
+{
+    return _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(d));
+}
+#endif
+
+template <MINT32 N>
+static void cholSolveLanes(MFLOAT *x, const MFLOAT *A, const MFLOAT *b, MUINT8 *solved, MINT32 count)
+{
+    MFLOAT la[N][N][4], lb[N][4], lx[N][4];
+    UTL_V4 L[N][N], inv[N], y[N];
+    MINT32 i, j, k, p, ok = 0xF;
+
+    // transpose the systems into lanes, identity in the unused lanes
+    for (p = 0; p < 4; p++)
+    {
+        for (i = 0; i < N; i++)
+        {
+            for (j = 0; j <= i; j++)
+                la[i][j][p] = (p < count) ? A[p * N * N + i * N + j] : (MFLOAT)(i == j);
+            lb[i][p] = (p < count) ? b[p * N + i] : 0.0f;
+        }
+    }
+
+    for (j = 0; j < N; j++)
+    {
+        UTL_V4 d = v4Load(la[j][j]);
+        for (k = 0; k < j; k++)
+            d = v4Mls(d, L[j][k], L[j][k]);
+        inv[j] = v4RcpSqrt(v4Pivot(d, &ok));
+        for (i = j + 1; i < N; i++)
+        {
+            UTL_V4 s = v4Load(la[i][j]);
+            for (k = 0; k < j; k++)
+                s = v4Mls(s, L[i][k], L[j][k]);
+            L[i][j] = v4Mul(s, inv[j]);
+        }
+    }
+
+    for (i = 0; i < N; i++)
+    {
+        UTL_V4 s = v4Load(lb[i]);
+        for (k = 0; k < i; k++)
+            s = v4Mls(s, L[i][k], y[k]);
+        y[i] = v4Mul(s, inv[i]);
+    }
+    for (i = N - 1; i >= 0; i--)
+    {
+        UTL_V4 s = y[i];
+        for (k = i + 1; k < N; k++)
+            s = v4Mls(s, L[k][i], y[k]);
+        // y[i] is not read again, keep x[i] in its place
+        y[i] = v4Mul(s, inv[i]);
+        v4Store(lx[i], y[i]);
+    }
+
+    for (p = 0; p < count; p++)
+    {
+        MBOOL lane_ok = (ok >> p) & 1;
+        for (i = 0; i < N; i++)
+            x[p * N + i] = lane_ok ? lx[i][p] : 0.0f;
+        if (solved)
+            solved[p] = (MUINT8)lane_ok;
+    }
+}
+#endif
+
+template <MINT32 N>
+static void cholSolveBatch(MFLOAT *x, const MFLOAT *A, const MFLOAT *b, MINT32 num, MUINT8 *solved)
+{
+    MINT32 k;
+#if defined(MATH_NEON) || defined(MATH_SSE2)
+    for (k = 0; k < num; k += 4)
+        cholSolveLanes<N>(x + k * N, A + k * N * N, b + k * N, solved ? solved + k : NULL, UTL_MIN(4, num - k));
+#else
+    for (k = 0; k < num; k++)
+    {
+        MBOOL ok = solveChol<N>(x + k * N, A + k * N * N, b + k * N);
+        if (solved)
+            solved[k] = (MUINT8)ok;
+    }
+#endif
+}
+
+template <MINT32 N>
+static void luSolveBatch(MFLOAT *x, const MFLOAT *A, const MFLOAT *b, MINT32 num, MUINT8 *solved)
+{
+    for (MINT32 k = 0; k < num; k++)
+    {
+        MBOOL ok = solveLu<N>(x + k * N, A + k * N * N, b + k * N);
+        if (solved)
+            solved[k] = (MUINT8)ok;
+    }
+}
+
+MBOOL utilMatSolve3x3(MFLOAT *x, const MFLOAT *A, const MFLOAT *b)
+{
+    return solveLu<3>(x, A, b);
+}
+
+MBOOL utilMatSolve4x4(MFLOAT *x, const MFLOAT *A, const MFLOAT *b)
+{
+    return solveLu<4>(x, A, b);
+}
+
+MBOOL utilMatSolve8x8(MFLOAT *x, const MFLOAT *A, const MFLOAT *b)
+{
+    return solveLu<8>(x, A, b);
+}
+
+MBOOL utilCholSolve3x3(MFLOAT *x, const MFLOAT *A, const MFLOAT *b)
+{
+    return solveChol<3>(x, A, b);
+}
+
+MBOOL utilCholSolve4x4(MFLOAT *x, const MFLOAT *A, const MFLOAT *b)
+{
+    return solveChol<4>(x, A, b);
+}
+
+MBOOL utilCholSolve8x8(MFLOAT *x, const MFLOAT *A, const MFLOAT *b)
+{
+    return solveChol<8>(x, A, b);
+}
+
+static UTIL_ERRCODE_ENUM checkBatch(MFLOAT *x, const MFLOAT *A, const MFLOAT *b, MINT32 n, MINT32 num)
+{
+    UTIL_ERRCODE_ENUM result = UTIL_OK;
+
+    if (!x || !A || !b)
+    {
+        result = UTIL_COMMON_ERR_NULL_BUFFER_POINTER;
+        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
+        return result;
+    }
+    if (n < 1 || n > UTL_MAT_MAX_DIM || num < 0)
+    {
+        result = UTIL_COMMON_ERR_INVALID_PARAMETER;
+        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
+        return result;
+    }
+    return result;
+}
+
+UTIL_ERRCODE_ENUM utilMatSolveBatch(MFLOAT *x, const MFLOAT *A, const MFLOAT *b, MINT32 n, MINT32 num, MUINT8 *solved)
+{
+    UTIL_ERRCODE_ENUM result = checkBatch(x, A, b, n, num);
+    if (result != UTIL_OK)
+        return result;
+
+    switch (n)
+    {
+        case 1: luSolveBatch<1>(x, A, b, num, solved); break;
+        case 2: luSolveBatch<2>(x, A, b, num, solved); break;
+        case 3: luSolveBatch<3>(x, A, b, num, solved); break;
+        case 4: luSolveBatch<4>(x, A, b, num, solved); break;
+        case 5: luSolveBatch<5>(x, A, b, num, solved); break;
+        case 6: luSolveBatch<6>(x, A, b, num, solved); break;
+        case 7: luSolveBatch<7>(x, A, b, num, solved); break;
+        default: luSolveBatch<8>(x, A, b, num, solved); break;
+    }
+    return result;
+}
+
+UTIL_ERRCODE_ENUM utilCholSolveBatch(MFLOAT *x, const MFLOAT *A, const MFLOAT *b, MINT32 n, MINT32 num, MUINT8 *solved)
+{
+    UTIL_ERRCODE_ENUM result = checkBatch(x, A, b, n, num);
+    if (result != UTIL_OK)
+        return result;
+
+    switch (n)
+    {
+        case 1: cholSolveBatch<1>(x, A, b, num, solved); break;
+        case 2: cholSolveBatch<2>(x, A, b, num, solved); break;
+        case 3: cholSolveBatch<3>(x, A, b, num, solved); break;
+        case 4: cholSolveBatch<4>(x, A, b, num, solved); break;
+        case 5: cholSolveBatch<5>(x, A, b, num, solved); break;
+        case 6: cholSolveBatch<6>(x, A, b, num, solved); break;
+        case 7: cholSolveBatch<7>(x, A, b, num, solved); break;
+        default: cholSolveBatch<8>(x, A, b, num, solved); break;
+    }
+    return result;
+}
+
+
 /**********************************/
 /* LEVMAR non-linear optimization */
 /**********************************/
@@ -618,7 +977,6 @@ void utilBoxProject(MFLOAT *p, MFLOAT *lb, MFLOAT *ub, MINT32 num_para)
 
 MINT32 utilLevmarBcDer(LEVMAR_CAL_STRUCT *pLevmarInfo, MINT32 para_max_iter)
 {
-    LOGD("[utilLevmarBcDer] Enter\n");
     register MINT32 i, j;
     register MFLOAT mu;
     register MFLOAT tmp;
@@ -689,8 +1047,9 @@ MINT32 utilLevmarBcDer(LEVMAR_CAL_STRUCT *pLevmarInfo, MINT32 para_max_iter)
     //}
     //>>>>>>>>> Original
 
-    /* set up work arrays */
-    e=(MFLOAT *) pLevmarInfo->ProcBufAddr;
+    /* set up work arrays, given back on return */
+    const size_t work_addr = pLevmarInfo->ProcBufAddr;
+    e=(MFLOAT *) work_addr;
     jacTe=e + pLevmarInfo->num_measure;
     jac=jacTe + pLevmarInfo->num_para;
     jacTjac=jac + nm;
@@ -1096,8 +1455,7 @@ MINT32 utilLevmarBcDer(LEVMAR_CAL_STRUCT *pLevmarInfo, MINT32 para_max_iter)
         pLevmarInfo->info[9]=(MFLOAT)nlss;
     }
 
-    LOGD("[utilLevmarBcDer] Process count = %d\n", proc_cnt);
-    LOGD("[utilLevmarBcDer] Exit\n");
+    pLevmarInfo->ProcBufAddr = work_addr;
     return (stop!=4 && stop!=7)?  k : LM_ERROR;
 }
 
@@ -1170,7 +1528,8 @@ MINT32 utilLevmarBufferSizeQuery(MINT32 NumPara, MINT32 NumMeasure, MINT32 IterN
 {
     MINT32 buffer_size = 0;
     MINT32 ri_data_size = NumMeasure*4 + 9;
-    MINT32 lmbcder_size = (NumMeasure*5 + NumPara*8);
+    // e, J^T e, J, J^T J, Dp, diag(J^T J) and p + Dp of utilLevmarBcDer
+    MINT32 lmbcder_size = UTL_MAX(NumMeasure*5 + NumPara*8, NumMeasure*(NumPara+1) + NumPara*(NumPara+4));
     MINT32 axeqblu_size = ((NumPara+2) * NumPara) * IterNum;
 
     buffer_size += ri_data_size * sizeof(MFLOAT);       // adata
@@ -1191,6 +1550,7 @@ void utilLevmarInit(LEVMAR_CAL_STRUCT *pLevmarInfo, void *pBuffer, MINT32 NumPar
     MINT32 ri_data_size = NumMeasure*4 + 9;
 
     pLevmarInfo->num_para = NumPara;
+    pLevmarInfo->num_measure = NumMeasure;
     pLevmarInfo->adata=(MFLOAT*)(pBuffer);
     pLevmarInfo->p = pLevmarInfo->adata + ri_data_size;
     pLevmarInfo->lb = pLevmarInfo->p + pLevmarInfo->num_para;
@@ -1221,7 +1581,6 @@ void utilLevmarInit(LEVMAR_CAL_STRUCT *pLevmarInfo, void *pBuffer, MINT32 NumPar
 
 MINT32 utilLevmarBcDif(LEVMAR_CAL_STRUCT *pLevmarInfo, MINT32 para_max_iter)
 {
-    LOGD("[utilLevmarBcDif] Enter\n");
     MINT32 ret;
 
     //Clang build error fix, array pointer "pLevmarInfo->opts" alway be true(non-null)
@@ -1244,7 +1603,6 @@ MINT32 utilLevmarBcDif(LEVMAR_CAL_STRUCT *pLevmarInfo, MINT32 para_max_iter)
             pLevmarInfo->info[7]+=pLevmarInfo->info[8]*(2*pLevmarInfo->num_para);
         }
     }
-    LOGD("[utilLevmarBcDif] Exit\n");
     return ret;
 }
 
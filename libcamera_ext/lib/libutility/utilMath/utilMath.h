@@ -117,6 +117,100 @@ void utilVecScale(MFLOAT *dst, const MFLOAT *src, MFLOAT scale);
  */
 void utilMatInv(MFLOAT *dst, MFLOAT *src, MINT32 n);
 
+/************************************/
+/* fixed size linear solvers        */
+/************************************/
+/// largest system of utilMatSolveBatch and utilCholSolveBatch
+#define UTL_MAT_MAX_DIM (8)
+
+/**
+ * \details solve A x = b, 3x3, Gaussian elimination with partial pivoting on the stack
+ * \fn MBOOL utilMatSolve3x3(MFLOAT *x, const MFLOAT *A, const MFLOAT *b)
+ * \param[out] x solution, zeros if A is singular
+ * \param[in] A row-major matrix
+ * \param[in] b right-hand side
+ * \return 1 if solved, 0 if A is singular
+ */
+MBOOL utilMatSolve3x3(MFLOAT *x, const MFLOAT *A, const MFLOAT *b);
+
+/**
+ * \details solve A x = b, 4x4, Gaussian elimination with partial pivoting on the stack
+ * \fn MBOOL utilMatSolve4x4(MFLOAT *x, const MFLOAT *A, const MFLOAT *b)
+ * \param[out] x solution, zeros if A is singular
+ * \param[in] A row-major matrix
+ * \param[in] b right-hand side
+ * \return 1 if solved, 0 if A is singular
+ */
+MBOOL utilMatSolve4x4(MFLOAT *x, const MFLOAT *A, const MFLOAT *b);
+
+/**
+ * \details solve A x = b, 8x8, Gaussian elimination with partial pivoting on the stack
+ * \fn MBOOL utilMatSolve8x8(MFLOAT *x, const MFLOAT *A, const MFLOAT *b)
+ * \param[out] x solution, zeros if A is singular
+ * \param[in] A row-major matrix, as the 8 unknowns of a homography
+ * \param[in] b right-hand side
+ * \return 1 if solved, 0 if A is singular
+ */
+MBOOL utilMatSolve8x8(MFLOAT *x, const MFLOAT *A, const MFLOAT *b);
+
+/**
+ * \details solve A x = b, 3x3 symmetric positive definite, Cholesky on the stack
+ * \fn MBOOL utilCholSolve3x3(MFLOAT *x, const MFLOAT *A, const MFLOAT *b)
+ * \param[out] x solution, zeros if A is not positive definite
+ * \param[in] A row-major matrix, only the lower triangle is read
+ * \param[in] b right-hand side
+ * \return 1 if solved, 0 if A is not positive definite
+ */
+MBOOL utilCholSolve3x3(MFLOAT *x, const MFLOAT *A, const MFLOAT *b);
+
+/**
+ * \details solve A x = b, 4x4 symmetric positive definite, Cholesky on the stack
+ * \fn MBOOL utilCholSolve4x4(MFLOAT *x, const MFLOAT *A, const MFLOAT *b)
+ * \param[out] x solution, zeros if A is not positive definite
+ * \param[in] A row-major matrix, only the lower triangle is read
+ * \param[in] b right-hand side
+ * \return 1 if solved, 0 if A is not positive definite
+ */
+MBOOL utilCholSolve4x4(MFLOAT *x, const MFLOAT *A, const MFLOAT *b);
+
+/**
+ * \details solve A x = b, 8x8 symmetric positive definite, Cholesky on the stack
+ * \fn MBOOL utilCholSolve8x8(MFLOAT *x, const MFLOAT *A, const MFLOAT *b)
+ * \param[out] x solution, zeros if A is not positive definite
+ * \param[in] A row-major matrix, only the lower triangle is read, as the normal equations of a homography
+ * \param[in] b right-hand side
+ * \return 1 if solved, 0 if A is not positive definite
+ */
+MBOOL utilCholSolve8x8(MFLOAT *x, const MFLOAT *A, const MFLOAT *b);
+
+/**
+ * \details solve num independent systems A[k] x[k] = b[k] of the same size
+ * \fn UTIL_ERRCODE_ENUM utilMatSolveBatch(MFLOAT *x, const MFLOAT *A, const MFLOAT *b, MINT32 n, MINT32 num, MUINT8 *solved)
+ * \param[out] x num solutions of n elements, zeros for a singular system
+ * \param[in] A num row-major n x n matrices
+ * \param[in] b num right-hand sides of n elements
+ * \param[in] n system size (1 to UTL_MAT_MAX_DIM)
+ * \param[in] num number of systems
+ * \param[out] solved num flags, 1 if solved and 0 if singular, or NULL
+ * \return utility error code enumerator
+ */
+UTIL_ERRCODE_ENUM utilMatSolveBatch(MFLOAT *x, const MFLOAT *A, const MFLOAT *b, MINT32 n, MINT32 num, MUINT8 *solved);
+
+/**
+ * \details solve num independent symmetric positive definite systems A[k] x[k] = b[k] of the same size
+ * \fn UTIL_ERRCODE_ENUM utilCholSolveBatch(MFLOAT *x, const MFLOAT *A, const MFLOAT *b, MINT32 n, MINT32 num, MUINT8 *solved)
+ * \param[out] x num solutions of n elements, zeros for a system that is not positive definite
+ * \param[in] A num row-major n x n matrices, only the lower triangles are read
+ * \param[in] b num right-hand sides of n elements
+ * \param[in] n system size (1 to UTL_MAT_MAX_DIM)
+ * \param[in] num number of systems
+ * \param[out] solved num flags, 1 if solved and 0 if not positive definite, or NULL
+ * \return utility error code enumerator
+ *
+ * With NEON or SSE2, 4 systems are factored at once, one per vector lane.
+ */
+UTIL_ERRCODE_ENUM utilCholSolveBatch(MFLOAT *x, const MFLOAT *A, const MFLOAT *b, MINT32 n, MINT32 num, MUINT8 *solved);
+
 /**
  * \details data swap
  * \fn void utilSwap(MFLOAT *a, MFLOAT *b)
@@ -287,6 +381,9 @@ void utilLmbcDifJacf(MFLOAT *jac, LEVMAR_CAL_STRUCT *pLevmarInfo);
  *  \param[in] IterNum number of iteration
  *  \param[in] ImgNum number of images
  *  \return required buffer size
+ *
+ *  utilLevmarBcDif gives its work arrays back on return, so one workspace
+ *  sized with IterNum and ImgNum of 1 serves any number of solves.
  */
 MINT32 utilLevmarBufferSizeQuery(MINT32 NumPara, MINT32 NumMeasure, MINT32 IterNum, MINT32 ImgNum);
 
@@ -11,85 +11,111 @@
 #define LOGD(...)
 #endif /* SIM_MAIN */
 
-#ifdef NEON_OPT
-#ifdef ANDROID
-#include "arm_neon.h"
-#else
-#include "neon_template.hpp"
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define ARITH_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#define ARITH_SSE2
+#include <emmintrin.h>
 #endif
-#endif /* NEON_OPT */
 
 #include "utilImageArithmetic.h"
 #include "utilMath.h"
 
-UTIL_ERRCODE_ENUM ImageSubstract(const UTIL_BASE_IMAGE_STRUCT* A, const UTIL_BASE_IMAGE_STRUCT* B, MINT32 residue, UTIL_BASE_IMAGE_STRUCT* C)
-{
-    UTIL_ERRCODE_ENUM result = UTIL_OK;
-    MINT32 i;
-    MUINT8* Adata;
-    MUINT8* Bdata;
-    MUINT8* Cdata;
+/// motions of utilImageSadBatch run together
+#define UTL_SAD_BATCH_SIZE  (64)
 
-    C->height = A->height;
-    C->width = A->width;
+/// candidates of utilBlockSad and utilBlockSadSearch one pixel apart on a row, evaluated together
+#define UTL_BLOCK_SAD_GROUP (4)
 
-    Adata = (MUINT8 *)A->data;
-    Bdata = (MUINT8 *)B->data;
-    Cdata = (MUINT8 *)C->data;
+/// one motion of utilImageSadBatch
+typedef struct
+{
+    const MUINT8 *img1;     ///< first sample of the next row
+    const MUINT8 *img2;
+    MINT32 x_count;         ///< samples per row
+    MINT32 y_count;         ///< rows
+    MUINT32 sum;
+    MUINT32 count;
+} UTL_SAD_MOTION_STRUCT;
+
+// c = clip(a +/- b + residue), n pixels
+static void arithPixels(const MUINT8 *a, const MUINT8 *b, MINT32 residue, MUINT8 *c, MINT32 n, MBOOL subtract)
+{
+    MINT32 i = 0;
 
-#ifndef NEON_OPT
-    for(i=C->width*C->height;i!=0; i--)
+#if defined(ARITH_NEON) || defined(ARITH_SSE2)
+    // a +/- b is within [-255, 510], a larger residue gives the same clip
+    MINT32 res = UTL_MAX(-511, UTL_MIN(511, residue));
+#endif
+#if defined(ARITH_NEON)
+    if (res == 0)
     {
-        int value = (*Adata) - (*Bdata) + residue;
-        if(value > 255)
-            value = 255;
-        if(value < 0)
-            value = 0;
-        *Cdata = value;
-        Adata++;
-        Bdata++;
-        Cdata++;
+        for (; i + 16 <= n; i += 16)
+        {
+            uint8x16_t v_a = vld1q_u8(a + i);
+            uint8x16_t v_b = vld1q_u8(b + i);
+            vst1q_u8(c + i, subtract ? vqsubq_u8(v_a, v_b) : vqaddq_u8(v_a, v_b));
+        }
     }
-#else
-
-    uint8x8_t u8_A_neon, u8_B_neon;
-    uint16x8_t u16_A_neon, u16_B_neon;
-    int16x8_t s16_A_neon, s16_B_neon;
-    int16x8_t s16_resudue = vdupq_n_s16(residue);
-    for(i=C->width*C->height;i>7; i-=8)
+    else
     {
-        u8_A_neon = vld1_u8(Adata);
-        Adata+=8;
-
-        u8_B_neon = vld1_u8(Bdata);
-        Bdata+=8;
-
-        u16_A_neon = vmovl_u8(u8_A_neon);
-        u16_B_neon = vmovl_u8(u8_B_neon);
-
-        s16_A_neon = vreinterpretq_s16_u16(u16_A_neon);
-        s16_B_neon = vreinterpretq_s16_u16(u16_B_neon);
-
-        s16_A_neon = vsubq_s16(s16_A_neon, s16_B_neon);
-        s16_A_neon = vaddq_s16(s16_A_neon, s16_resudue);
-        u8_A_neon = vqmovun_s16(s16_A_neon);
-
-        vst1_u8(Cdata,u8_A_neon);
-        Cdata+=8;
+        int16x8_t v_res = vdupq_n_s16((MINT16)res);
+        for (; i + 8 <= n; i += 8)
+        {
+            uint8x8_t v_a = vld1_u8(a + i);
+            uint8x8_t v_b = vld1_u8(b + i);
+            int16x8_t v_c = vreinterpretq_s16_u16(subtract ? vsubl_u8(v_a, v_b) : vaddl_u8(v_a, v_b));
+            vst1_u8(c + i, vqmovun_s16(vaddq_s16(v_c, v_res)));
+        }
     }
-    for(;i!=0; i--)
+#elif defined(ARITH_SSE2)
+    if (res == 0)
+    {
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i v_a = _mm_loadu_si128((const __m128i *)(a + i));
+            __m128i v_b = _mm_loadu_si128((const __m128i *)(b + i));
+            _mm_storeu_si128((__m128i *)(c + i), subtract ? _mm_subs_epu8(v_a, v_b) : _mm_adds_epu8(v_a, v_b));
+        }
+    }
+    else
     {
-        int value = (*Adata) - (*Bdata) + residue;
+        const __m128i v_zero = _mm_setzero_si128();
+        const __m128i v_res = _mm_set1_epi16((MINT16)res);
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i v_a = _mm_loadu_si128((const __m128i *)(a + i));
+            __m128i v_b = _mm_loadu_si128((const __m128i *)(b + i));
+            __m128i v_alo = _mm_unpacklo_epi8(v_a, v_zero), v_ahi = _mm_unpackhi_epi8(v_a, v_zero);
+            __m128i v_blo = _mm_unpacklo_epi8(v_b, v_zero), v_bhi = _mm_unpackhi_epi8(v_b, v_zero);
+            __m128i v_lo = subtract ? _mm_sub_epi16(v_alo, v_blo) : _mm_add_epi16(v_alo, v_blo);
+            __m128i v_hi = subtract ? _mm_sub_epi16(v_ahi, v_bhi) : _mm_add_epi16(v_ahi, v_bhi);
+            v_lo = _mm_add_epi16(v_lo, v_res);
+            v_hi = _mm_add_epi16(v_hi, v_res);
+            _mm_storeu_si128((__m128i *)(c + i), _mm_packus_epi16(v_lo, v_hi));
+        }
+    }
+#endif
+    for (; i < n; i++)
+    {
+        int value = subtract ? a[i] - b[i] + residue : a[i] + b[i] + residue;
         if(value > 255)
             value = 255;
         if(value < 0)
             value = 0;
-        *Cdata = value;
-        Adata++;
-        Bdata++;
-        Cdata++;
+        c[i] = value;
     }
-#endif
+}
+
+UTIL_ERRCODE_ENUM ImageSubstract(const UTIL_BASE_IMAGE_STRUCT* A, const UTIL_BASE_IMAGE_STRUCT* B, MINT32 residue, UTIL_BASE_IMAGE_STRUCT* C)
+{
+    UTIL_ERRCODE_ENUM result = UTIL_OK;
+
+    C->height = A->height;
+    C->width = A->width;
+
+    arithPixels((const MUINT8 *)A->data, (const MUINT8 *)B->data, residue, (MUINT8 *)C->data, C->width * C->height, 1);
 
     return result;
 
@@ -98,201 +124,581 @@ UTIL_ERRCODE_ENUM ImageSubstract(const UTIL_BASE_IMAGE_STRUCT* A, const UTIL_BAS
 UTIL_ERRCODE_ENUM ImageAdd(const UTIL_BASE_IMAGE_STRUCT* A, const UTIL_BASE_IMAGE_STRUCT* B, MINT32 residue, UTIL_BASE_IMAGE_STRUCT* C)
 {
     UTIL_ERRCODE_ENUM result = UTIL_OK;
-    MINT32 i;
-    MUINT8* Adata;
-    MUINT8* Bdata;
-    MUINT8* Cdata;
 
     C->height = A->height;
     C->width = A->width;
 
-    Adata = (MUINT8 *)A->data;
-    Bdata = (MUINT8 *)B->data;
-    Cdata = (MUINT8 *)C->data;
-#ifndef NEON_OPT
-    for(i=C->width*C->height;i!=0; i--)
-    {
-        int value = (*Adata) + (*Bdata) + residue;
-        if(value > 255)
-            value = 255;
-        if(value < 0)
-            value = 0;
-        *Cdata = value;
-        Adata++;
-        Bdata++;
-        Cdata++;
-    }
-#else
-    uint8x8_t u8_A_neon, u8_B_neon;
-    uint16x8_t u16_A_neon, u16_B_neon;
-    int16x8_t s16_A_neon, s16_B_neon;
-    int16x8_t s16_resudue = vdupq_n_s16(residue);
-    for(i=A->width*A->height;i>7; i-=8)
-    {
-        u8_A_neon = vld1_u8(Adata);
-        Adata+=8;
-
-        u8_B_neon = vld1_u8(Bdata);
-        Bdata+=8;
-
-        u16_A_neon = vmovl_u8(u8_A_neon);
-        u16_B_neon = vmovl_u8(u8_B_neon);
-
-        s16_A_neon = vreinterpretq_s16_u16(u16_A_neon);
-        s16_B_neon = vreinterpretq_s16_u16(u16_B_neon);
+    arithPixels((const MUINT8 *)A->data, (const MUINT8 *)B->data, residue, (MUINT8 *)C->data, C->width * C->height, 0);
 
-        s16_A_neon = vaddq_s16(s16_A_neon, s16_B_neon);
-        s16_A_neon = vaddq_s16(s16_A_neon, s16_resudue);
-        u8_A_neon = vqmovun_s16(s16_A_neon);
+    return result;
+}
 
-        vst1_u8(Cdata,u8_A_neon);
-        Cdata+=8;
+#if defined(ARITH_NEON)
+static inline MUINT32 sumLanes(uint32x4_t v)
+{
+    uint64x2_t v_sum = vpaddlq_u32(v);
+    return (MUINT32)(vgetq_lane_u64(v_sum, 0) + vgetq_lane_u64(v_sum, 1));
+}
+#elif defined(ARITH_SSE2)
+// every step-th byte of 16 * step bytes
+static inline __m128i loadSamples(const MUINT8 *p, MINT32 step)
+{
+    if (step == 1)
+        return _mm_loadu_si128((const __m128i *)p);
+    if (step == 2)
+    {
+        const __m128i v_mask = _mm_set1_epi16(0xFF);
+        __m128i v_0 = _mm_and_si128(_mm_loadu_si128((const __m128i *)p), v_mask);
+        __m128i v_1 = _mm_and_si128(_mm_loadu_si128((const __m128i *)(p + 16)), v_mask);
+        return _mm_packus_epi16(v_0, v_1);
     }
-    for(;i!=0; i--)
+    const __m128i v_mask = _mm_set1_epi32(0xFF);
+    __m128i v_0 = _mm_and_si128(_mm_loadu_si128((const __m128i *)p), v_mask);
+    __m128i v_1 = _mm_and_si128(_mm_loadu_si128((const __m128i *)(p + 16)), v_mask);
+    __m128i v_2 = _mm_and_si128(_mm_loadu_si128((const __m128i *)(p + 32)), v_mask);
+    __m128i v_3 = _mm_and_si128(_mm_loadu_si128((const __m128i *)(p + 48)), v_mask);
+    return _mm_packus_epi16(_mm_packs_epi32(v_0, v_1), _mm_packs_epi32(v_2, v_3));
+}
+#endif
+
+// sum of |img2 - img1| over n samples step pixels apart. With a saturation
+// value, the samples of whole groups of 4 where img2 is saturated are not
+// summed nor counted, as the unrolled loop of utilImageSad did.
+static void sadRow(const MUINT8 *img1, const MUINT8 *img2, MINT32 n, MINT32 step, MINT32 saturation_value, MUINT32 *sum, MUINT32 *count)
+{
+    MINT32 i = 0;
+    MUINT32 SadSum = 0, Count = n;
+    // a value out of 8 bits is never matched
+    MBOOL masked = saturation_value > 0 && saturation_value <= 255;
+    MINT32 masked_n = masked ? n & ~3 : 0;
+
+#if defined(ARITH_NEON) || defined(ARITH_SSE2)
+    // a strided load also reads the bytes up to the next sample, so it stops one sample early
+    if (step == 1 || step == 2 || step == 4)
     {
-        int value = (*Adata) + (*Bdata) + residue;
-        if(value > 255)
-            value = 255;
-        if(value < 0)
-            value = 0;
-        *Cdata = value;
-        Adata++;
-        Bdata++;
-        Cdata++;
+        MINT32 vec_n = masked ? masked_n : n;
+        MINT32 vec_end = step == 1 ? vec_n : UTL_MIN(vec_n, n - 1);
+#if defined(ARITH_NEON)
+        uint32x4_t v_sum = vdupq_n_u32(0);
+        uint32x4_t v_cnt = vdupq_n_u32(0);
+        uint8x16_t v_sat = vdupq_n_u8((MUINT8)saturation_value);
+        for (; i + 16 <= vec_end; i += 16)
+        {
+            const MUINT8 *p1 = img1 + i * step;
+            const MUINT8 *p2 = img2 + i * step;
+            uint8x16_t v_1 = step == 1 ? vld1q_u8(p1) : step == 2 ? vld2q_u8(p1).val[0] : vld4q_u8(p1).val[0];
+            uint8x16_t v_2 = step == 1 ? vld1q_u8(p2) : step == 2 ? vld2q_u8(p2).val[0] : vld4q_u8(p2).val[0];
+            uint8x16_t v_diff = vabdq_u8(v_2, v_1);
+            if (masked)
+            {
+                uint8x16_t v_hit = vceqq_u8(v_2, v_sat);
+                v_diff = vbicq_u8(v_diff, v_hit);
+                v_cnt = vpadalq_u16(v_cnt, vpaddlq_u8(vshrq_n_u8(v_hit, 7)));
+            }
+            v_sum = vpadalq_u16(v_sum, vpaddlq_u8(v_diff));
+        }
+        SadSum = sumLanes(v_sum);
+        Count -= sumLanes(v_cnt);
+#else
+        const __m128i v_zero = _mm_setzero_si128();
+        const __m128i v_one = _mm_set1_epi8(1);
+        const __m128i v_sat = _mm_set1_epi8((char)saturation_value);
+        __m128i v_sum = v_zero;
+        __m128i v_cnt = v_zero;
+        for (; i + 16 <= vec_end; i += 16)
+        {
+            __m128i v_1 = loadSamples(img1 + i * step, step);
+            __m128i v_2 = loadSamples(img2 + i * step, step);
+            __m128i v_diff = _mm_or_si128(_mm_subs_epu8(v_1, v_2), _mm_subs_epu8(v_2, v_1));
+            if (masked)
+            {
+                __m128i v_hit = _mm_cmpeq_epi8(v_2, v_sat);
+                v_diff = _mm_andnot_si128(v_hit, v_diff);
+                v_cnt = _mm_add_epi64(v_cnt, _mm_sad_epu8(_mm_and_si128(v_hit, v_one), v_zero));
+            }
+            v_sum = _mm_add_epi64(v_sum, _mm_sad_epu8(v_diff, v_zero));
+        }
+        v_sum = _mm_add_epi64(v_sum, _mm_unpackhi_epi64(v_sum, v_sum));
+        v_cnt = _mm_add_epi64(v_cnt, _mm_unpackhi_epi64(v_cnt, v_cnt));
+        SadSum = (MUINT32)_mm_cvtsi128_si32(v_sum);
+        Count -= (MUINT32)_mm_cvtsi128_si32(v_cnt);
+#endif
     }
 #endif
+    for (; i < n; i++)
+    {
+        MINT32 p2 = img2[i * step];
+        if (masked && i < masked_n && p2 == saturation_value)
+            Count--;
+        else
+            SadSum += UTL_ABS(p2 - (MINT32)img1[i * step]);
+    }
 
-    return result;
+    *sum += SadSum;
+    *count += Count;
 }
 
 UTIL_ERRCODE_ENUM utilImageSad(P_UTIL_IMAGE_SAD_STRUCT sad_data, MUINT32 *sum, MUINT32 *count)
+{
+    MINT32 motion[2] = { sad_data->src1.clip_x, sad_data->src1.clip_y };
+
+    return utilImageSadBatch(sad_data, motion, 1, sum, count);
+}
+
+UTIL_ERRCODE_ENUM utilImageSadBatch(P_UTIL_IMAGE_SAD_STRUCT sad_data, const MINT32 *motion, MINT32 num, MUINT32 *sum, MUINT32 *count)
 {
     UTIL_ERRCODE_ENUM result = UTIL_OK;
-    MUINT8 *pImg1X, *pImg1Y, *pImg2X, *pImg2Y;
-    MUINT32 xoffset, yoffset1, yoffset2;
-    MUINT32 SadSum = 0, Count = 0;
-    MUINT32 x_count, y_count, i;
-    MINT16 saturation_value = sad_data->saturation_value;
+    UTL_SAD_MOTION_STRUCT motions[UTL_SAD_BATCH_SIZE];
     P_UTIL_CLIP_IMAGE_STRUCT src1 = &sad_data->src1;
     P_UTIL_BASE_IMAGE_STRUCT src2 = &sad_data->src2;
-    MINT32 h = src1->clip_x;
-    MINT32 v = src1->clip_y;
+    MINT32 yoffset1, yoffset2, xoffset;
+
+    if (sad_data->sub_w < 1 || sad_data->sub_h < 1 || num < 0)
+    {
+        result = UTIL_COMMON_ERR_INVALID_PARAMETER;
+        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
+        return result;
+    }
 
-    pImg1Y = (MUINT8 *)src1->data;
-    pImg2Y = (MUINT8 *)src2->data;
     yoffset1 = sad_data->sub_h * src1->width;
     yoffset2 = sad_data->sub_h * src2->width;
     xoffset = sad_data->sub_w;
 
-    if (v >= 0)
+    for (MINT32 base = 0; base < num; base += UTL_SAD_BATCH_SIZE)
     {
-        pImg1Y += v*src1->width;
-        y_count = (src1->clip_height-1-v)/(sad_data->sub_h) + 1;
+        MINT32 batch = UTL_MIN(UTL_SAD_BATCH_SIZE, num - base);
+        MINT32 rows = 0;
+
+        for (MINT32 k = 0; k < batch; k++)
+        {
+            UTL_SAD_MOTION_STRUCT *m = &motions[k];
+            MINT32 h = motion[2 * (base + k)];
+            MINT32 v = motion[2 * (base + k) + 1];
+
+            m->img1 = (const MUINT8 *)src1->data;
+            m->img2 = (const MUINT8 *)src2->data;
+            if (v >= 0)
+            {
+                m->img1 += v*src1->width;
+                m->y_count = (src1->clip_height-1-v)/(sad_data->sub_h) + 1;
+            }
+            else
+            {
+                m->img2 += (-v)*src1->width;
+                m->y_count = (src1->clip_height-1+v)/(sad_data->sub_h) + 1;
+            }
+            if (h >= 0)
+            {
+                m->x_count = (src1->clip_width-1-h)/(sad_data->sub_w) + 1;
+                m->img1 += h;
+            }
+            else
+            {
+                m->x_count = (src1->clip_width-1+h)/(sad_data->sub_w) + 1;
+                m->img2 -= h;
+            }
+            m->x_count = UTL_MAX(m->x_count, 0);
+            m->y_count = UTL_MAX(m->y_count, 0);
+            m->sum = 0;
+            m->count = 0;
+            rows = UTL_MAX(rows, m->y_count);
+        }
+
+        // row by row over the motions, their rows are a few lines apart
+        for (MINT32 y = 0; y < rows; y++)
+        {
+            for (MINT32 k = 0; k < batch; k++)
+            {
+                UTL_SAD_MOTION_STRUCT *m = &motions[k];
+                if (y >= m->y_count)
+                    continue;
+                sadRow(m->img1, m->img2, m->x_count, xoffset, sad_data->saturation_value, &m->sum, &m->count);
+                m->img1 += yoffset1;
+                m->img2 += yoffset2;
+            }
+        }
+
+        for (MINT32 k = 0; k < batch; k++)
+        {
+            sum[base + k] = motions[k].sum;
+            count[base + k] = motions[k].count;
+        }
     }
-    else
+
+    return result;
+}
+
+#if defined(ARITH_NEON)
+typedef uint32x4_t UTL_SAD_ACC;
+#elif defined(ARITH_SSE2)
+typedef __m128i UTL_SAD_ACC;
+#endif
+
+#if defined(ARITH_NEON) || defined(ARITH_SSE2)
+// adds the sad of a row of a multiple of 8 pixels to acc
+static inline void rowSad(const MUINT8 *cur, const MUINT8 *ref, MINT32 w, UTL_SAD_ACC *acc)
+{
+    MINT32 x = 0;
+#if defined(ARITH_NEON)
+    uint32x4_t v_sum = *acc;
+    for (; x + 16 <= w; x += 16)
+        v_sum = vpadalq_u16(v_sum, vpaddlq_u8(vabdq_u8(vld1q_u8(cur + x), vld1q_u8(ref + x))));
+    if (x + 8 <= w)
     {
-        pImg2Y += (-v)*src1->width;
-        y_count = (src1->clip_height-1+v)/(sad_data->sub_h) + 1;
+        v_sum = vpadalq_u16(v_sum, vmovl_u8(vabd_u8(vld1_u8(cur + x), vld1_u8(ref + x))));
+        x += 8;
     }
-    if (h >= 0)
+#else
+    __m128i v_sum = *acc;
+    for (; x + 16 <= w; x += 16)
     {
-        x_count = (src1->clip_width-1-h)/(sad_data->sub_w) + 1;
-        pImg1Y += h;
+        __m128i v_c = _mm_loadu_si128((const __m128i *)(cur + x));
+        __m128i v_r = _mm_loadu_si128((const __m128i *)(ref + x));
+        v_sum = _mm_add_epi64(v_sum, _mm_sad_epu8(v_c, v_r));
     }
-    else
+    if (x + 8 <= w)
     {
-        x_count = (src1->clip_width-1+h)/(sad_data->sub_w) + 1;
-        pImg2Y -= h;
+        __m128i v_c = _mm_loadl_epi64((const __m128i *)(cur + x));
+        __m128i v_r = _mm_loadl_epi64((const __m128i *)(ref + x));
+        v_sum = _mm_add_epi64(v_sum, _mm_sad_epu8(v_c, v_r));
+        x += 8;
     }
+#endif
+    *acc = v_sum;
+}
 
-    for (; y_count!=0; y_count--)
+// adds the sads of a row of a multiple of 8 pixels against the UTL_BLOCK_SAD_GROUP
+// rows of ref starting 0, 1, 2 and 3 pixels to the right; the cur row is loaded once
+static inline void rowSadGroup(const MUINT8 *cur, const MUINT8 *ref, MINT32 w, UTL_SAD_ACC *acc)
+{
+    MINT32 x = 0;
+#if defined(ARITH_NEON)
+    for (; x + 16 <= w; x += 16)
     {
-        pImg1X = pImg1Y;
-        pImg2X = pImg2Y;
-        for(i = x_count; i>3; i-=4)
-        {
-            Count+=4;
+        uint8x16_t v_c = vld1q_u8(cur + x);
+        acc[0] = vpadalq_u16(acc[0], vpaddlq_u8(vabdq_u8(v_c, vld1q_u8(ref + x))));
+        acc[1] = vpadalq_u16(acc[1], vpaddlq_u8(vabdq_u8(v_c, vld1q_u8(ref + x + 1))));
+        acc[2] = vpadalq_u16(acc[2], vpaddlq_u8(vabdq_u8(v_c, vld1q_u8(ref + x + 2))));
+        acc[3] = vpadalq_u16(acc[3], vpaddlq_u8(vabdq_u8(v_c, vld1q_u8(ref + x + 3))));
+    }
+    if (x + 8 <= w)
+    {
+        uint8x8_t v_c = vld1_u8(cur + x);
+        acc[0] = vpadalq_u16(acc[0], vmovl_u8(vabd_u8(v_c, vld1_u8(ref + x))));
+        acc[1] = vpadalq_u16(acc[1], vmovl_u8(vabd_u8(v_c, vld1_u8(ref + x + 1))));
+        acc[2] = vpadalq_u16(acc[2], vmovl_u8(vabd_u8(v_c, vld1_u8(ref + x + 2))));
+        acc[3] = vpadalq_u16(acc[3], vmovl_u8(vabd_u8(v_c, vld1_u8(ref + x + 3))));
+    }
+#else
+    for (; x + 16 <= w; x += 16)
+    {
+        __m128i v_c = _mm_loadu_si128((const __m128i *)(cur + x));
+        acc[0] = _mm_add_epi64(acc[0], _mm_sad_epu8(v_c, _mm_loadu_si128((const __m128i *)(ref + x))));
+        acc[1] = _mm_add_epi64(acc[1], _mm_sad_epu8(v_c, _mm_loadu_si128((const __m128i *)(ref + x + 1))));
+        acc[2] = _mm_add_epi64(acc[2], _mm_sad_epu8(v_c, _mm_loadu_si128((const __m128i *)(ref + x + 2))));
+        acc[3] = _mm_add_epi64(acc[3], _mm_sad_epu8(v_c, _mm_loadu_si128((const __m128i *)(ref + x + 3))));
+    }
+    if (x + 8 <= w)
+    {
+        __m128i v_c = _mm_loadl_epi64((const __m128i *)(cur + x));
+        acc[0] = _mm_add_epi64(acc[0], _mm_sad_epu8(v_c, _mm_loadl_epi64((const __m128i *)(ref + x))));
+        acc[1] = _mm_add_epi64(acc[1], _mm_sad_epu8(v_c, _mm_loadl_epi64((const __m128i *)(ref + x + 1))));
+        acc[2] = _mm_add_epi64(acc[2], _mm_sad_epu8(v_c, _mm_loadl_epi64((const __m128i *)(ref + x + 2))));
+        acc[3] = _mm_add_epi64(acc[3], _mm_sad_epu8(v_c, _mm_loadl_epi64((const __m128i *)(ref + x + 3))));
+    }
+#endif
+}
 
-            if(saturation_value==0)
-            {
-                SadSum += UTL_ABS((MINT32)*pImg2X - (MINT32)*pImg1X);
-                pImg1X+=xoffset;
-                pImg2X+=xoffset;
+// the sum of acc
+static inline MUINT32 accSum(UTL_SAD_ACC v_acc)
+{
+#if defined(ARITH_NEON)
+    return sumLanes(v_acc);
+#else
+    return (MUINT32)_mm_cvtsi128_si32(_mm_add_epi64(v_acc, _mm_unpackhi_epi64(v_acc, v_acc)));
+#endif
+}
 
-                SadSum += UTL_ABS((MINT32)*pImg2X - (MINT32)*pImg1X);
-                pImg1X+=xoffset;
-                pImg2X+=xoffset;
+// the sums of the 4 accumulators of a group, one per 32-bit lane
+static inline UTL_SAD_ACC groupSums(const UTL_SAD_ACC *acc)
+{
+#if defined(ARITH_NEON)
+    uint32x2_t v_01 = vpadd_u32(vadd_u32(vget_low_u32(acc[0]), vget_high_u32(acc[0])),
+                                vadd_u32(vget_low_u32(acc[1]), vget_high_u32(acc[1])));
+    uint32x2_t v_23 = vpadd_u32(vadd_u32(vget_low_u32(acc[2]), vget_high_u32(acc[2])),
+                                vadd_u32(vget_low_u32(acc[3]), vget_high_u32(acc[3])));
+    return vcombine_u32(v_01, v_23);
+#else
+    // psadbw leaves a sum in the low 32 bits of each 64-bit lane
+    __m128i v_01 = _mm_add_epi64(_mm_unpacklo_epi64(acc[0], acc[1]), _mm_unpackhi_epi64(acc[0], acc[1]));
+    __m128i v_23 = _mm_add_epi64(_mm_unpacklo_epi64(acc[2], acc[3]), _mm_unpackhi_epi64(acc[2], acc[3]));
+    return _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(v_01), _mm_castsi128_ps(v_23), _MM_SHUFFLE(2, 0, 2, 0)));
+#endif
+}
 
-                SadSum += UTL_ABS((MINT32)*pImg2X - (MINT32)*pImg1X);
-                pImg1X+=xoffset;
-                pImg2X+=xoffset;
+// whether all 4 sums are past limit
+static inline MBOOL allPast(UTL_SAD_ACC v_sums, MUINT32 limit)
+{
+#if defined(ARITH_NEON)
+    uint32x4_t v_past = vcgtq_u32(v_sums, vdupq_n_u32(limit));
+    uint32x2_t v_all = vand_u32(vget_low_u32(v_past), vget_high_u32(v_past));
+    return (vget_lane_u32(v_all, 0) & vget_lane_u32(v_all, 1)) != 0;
+#else
+    // unsigned compare by flipping the sign bits
+    const __m128i v_sign = _mm_set1_epi32((int)0x80000000);
+    __m128i v_past = _mm_cmpgt_epi32(_mm_xor_si128(v_sums, v_sign), _mm_xor_si128(_mm_set1_epi32((int)limit), v_sign));
+    return _mm_movemask_epi8(v_past) == 0xFFFF;
+#endif
+}
+#endif
 
-                SadSum += UTL_ABS((MINT32)*pImg2X - (MINT32)*pImg1X);
-                pImg1X+=xoffset;
-                pImg2X+=xoffset;
-            }
+// sad of a w x h block, stops within 4 rows after it passes limit
+static MUINT32 blockSad(const MUINT8 *cur, MINT32 cur_stride, const MUINT8 *ref, MINT32 ref_stride, MINT32 w, MINT32 h, MUINT32 limit)
+{
+    MUINT32 SadSum = 0;
+    MINT32 y = 0;
+
+#if defined(ARITH_NEON) || defined(ARITH_SSE2)
+    const MINT32 vec_w = w & ~7;
+#if defined(ARITH_NEON)
+    uint32x4_t v_sum = vdupq_n_u32(0);
+#else
+    __m128i v_sum = _mm_setzero_si128();
+#endif
+    while (y < h)
+    {
+        const MINT32 y_end = limit == UTL_BLOCK_SAD_INVALID ? h : UTL_MIN(h, y + 4);
+        for (; y < y_end; y++, cur += cur_stride, ref += ref_stride)
+        {
+            // a constant width for the usual blocks lets the row loop unroll
+            if (vec_w == 16)
+                rowSad(cur, ref, 16, &v_sum);
             else
+                rowSad(cur, ref, vec_w, &v_sum);
+            for (MINT32 x = vec_w; x < w; x++)
+                SadSum += UTL_ABS((MINT32)cur[x] - (MINT32)ref[x]);
+        }
+        if (y < h && SadSum + accSum(v_sum) > limit)
+            break;
+    }
+    SadSum += accSum(v_sum);
+#else
+    for (; y < h && SadSum <= limit; y++, cur += cur_stride, ref += ref_stride)
+    {
+        for (MINT32 x = 0; x < w; x++)
+            SadSum += UTL_ABS((MINT32)cur[x] - (MINT32)ref[x]);
+    }
+#endif
+
+    return SadSum;
+}
+
+// blockSad of the UTL_BLOCK_SAD_GROUP blocks at ref, ref + 1, ref + 2 and ref + 3;
+// stops within 4 rows after all of them pass limit
+static void blockSadGroup(const MUINT8 *cur, MINT32 cur_stride, const MUINT8 *ref, MINT32 ref_stride, MINT32 w, MINT32 h,
+                          MUINT32 limit, MUINT32 *sad)
+{
+#if defined(ARITH_NEON) || defined(ARITH_SSE2)
+    const MINT32 vec_w = w & ~7;
+    MUINT32 tail[UTL_BLOCK_SAD_GROUP] = { 0, 0, 0, 0 };
+    MINT32 y = 0;
+#if defined(ARITH_NEON)
+    UTL_SAD_ACC acc[UTL_BLOCK_SAD_GROUP] = { vdupq_n_u32(0), vdupq_n_u32(0), vdupq_n_u32(0), vdupq_n_u32(0) };
+#else
+    UTL_SAD_ACC acc[UTL_BLOCK_SAD_GROUP] = { _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128() };
+#endif
+    while (y < h)
+    {
+        const MINT32 y_end = limit == UTL_BLOCK_SAD_INVALID ? h : UTL_MIN(h, y + 4);
+        for (; y < y_end; y++, cur += cur_stride, ref += ref_stride)
+        {
+            if (vec_w == 16)
+                rowSadGroup(cur, ref, 16, acc);
+            else
+                rowSadGroup(cur, ref, vec_w, acc);
+            for (MINT32 x = vec_w; x < w; x++)
             {
-                if((MINT32)(*pImg2X)==saturation_value)
-                {
-                    SadSum += 0;
-                    Count--;
-                }
-                else
-                    SadSum += UTL_ABS((MINT32)(*pImg2X) - (MINT32)(*pImg1X));
+                for (MINT32 j = 0; j < UTL_BLOCK_SAD_GROUP; j++)
+                    tail[j] += UTL_ABS((MINT32)cur[x] - (MINT32)ref[x + j]);
+            }
+        }
+        if (y < h)
+        {
+#if defined(ARITH_NEON)
+            uint32x4_t v_sums = vaddq_u32(groupSums(acc), vld1q_u32(tail));
+#else
+            __m128i v_sums = _mm_add_epi32(groupSums(acc), _mm_loadu_si128((const __m128i *)tail));
+#endif
+            if (allPast(v_sums, limit))
+                break;
+        }
+    }
+#if defined(ARITH_NEON)
+    vst1q_u32(sad, vaddq_u32(groupSums(acc), vld1q_u32(tail)));
+#else
+    _mm_storeu_si128((__m128i *)sad, _mm_add_epi32(groupSums(acc), _mm_loadu_si128((const __m128i *)tail)));
+#endif
+#else
+    for (MINT32 j = 0; j < UTL_BLOCK_SAD_GROUP; j++)
+        sad[j] = blockSad(cur, cur_stride, ref + j, ref_stride, w, h, limit);
+#endif
+}
 
-                pImg1X+=xoffset;
-                pImg2X+=xoffset;
+static UTIL_ERRCODE_ENUM checkBlock(P_UTIL_BLOCK_SAD_STRUCT sad_data)
+{
+    P_UTIL_CLIP_IMAGE_STRUCT cur = &sad_data->cur;
+
+    if (cur->data == NULL || sad_data->ref.data == NULL)
+        return UTIL_COMMON_ERR_NULL_BUFFER_POINTER;
+    if (cur->clip_x < 0 || cur->clip_y < 0 || cur->clip_width < 1 || cur->clip_height < 1 ||
+        cur->clip_x + cur->clip_width > cur->width || cur->clip_y + cur->clip_height > cur->height)
+        return UTIL_COMMON_ERR_INVALID_PARAMETER;
+    return UTIL_OK;
+}
 
-                if((MINT32)(*pImg2X)==saturation_value)
-                {
-                    SadSum += 0;
-                    Count--;
-                }
-                else
-                    SadSum += UTL_ABS((MINT32)(*pImg2X) - (MINT32)(*pImg1X));
+// the motions whose block is inside ref, dx_lo > dx_hi or dy_lo > dy_hi if there is none
+static void motionBounds(P_UTIL_BLOCK_SAD_STRUCT sad_data, MINT32 *dx_lo, MINT32 *dx_hi, MINT32 *dy_lo, MINT32 *dy_hi)
+{
+    P_UTIL_CLIP_IMAGE_STRUCT cur = &sad_data->cur;
+    P_UTIL_BASE_IMAGE_STRUCT ref = &sad_data->ref;
 
-                pImg1X+=xoffset;
-                pImg2X+=xoffset;
+    *dx_lo = -cur->clip_x;
+    *dx_hi = ref->width - cur->clip_width - cur->clip_x;
+    *dy_lo = -cur->clip_y;
+    *dy_hi = ref->height - cur->clip_height - cur->clip_y;
+}
 
-                if((MINT32)(*pImg2X)==saturation_value)
-                {
-                    SadSum += 0;
-                    Count--;
-                }
-                else
-                    SadSum += UTL_ABS((MINT32)(*pImg2X) - (MINT32)(*pImg1X));
+UTIL_ERRCODE_ENUM utilBlockSad(P_UTIL_BLOCK_SAD_STRUCT sad_data, const MINT32 *motion, MINT32 num, MUINT32 *sad)
+{
+    UTIL_ERRCODE_ENUM result = checkBlock(sad_data);
+    P_UTIL_CLIP_IMAGE_STRUCT cur = &sad_data->cur;
+    P_UTIL_BASE_IMAGE_STRUCT ref = &sad_data->ref;
+    MINT32 dx_lo, dx_hi, dy_lo, dy_hi;
+
+    if (result != UTIL_OK)
+    {
+        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
+        return result;
+    }
+
+    motionBounds(sad_data, &dx_lo, &dx_hi, &dy_lo, &dy_hi);
+    const MUINT8 *cur_block = (const MUINT8 *)cur->data + cur->clip_y * cur->width + cur->clip_x;
+    const MUINT8 *ref_block = (const MUINT8 *)ref->data + cur->clip_y * ref->width + cur->clip_x;
+
+    for (MINT32 k = 0; k < num;)
+    {
+        const MINT32 dx = motion[2 * k];
+        const MINT32 dy = motion[2 * k + 1];
+        if (dx < dx_lo || dx > dx_hi || dy < dy_lo || dy > dy_hi)
+        {
+            sad[k++] = UTL_BLOCK_SAD_INVALID;
+            continue;
+        }
 
-                pImg1X+=xoffset;
-                pImg2X+=xoffset;
+        // the next motions one pixel to the right read the same rows of ref
+        MINT32 run = 1;
+        while (run < UTL_BLOCK_SAD_GROUP && k + run < num &&
+               motion[2 * (k + run)] == dx + run && motion[2 * (k + run) + 1] == dy && dx + run <= dx_hi)
+        {
+            run++;
+        }
 
-                if((MINT32)(*pImg2X)==saturation_value)
+        const MUINT8 *ref_moved = ref_block + dy * ref->width + dx;
+        if (run == UTL_BLOCK_SAD_GROUP)
+        {
+            blockSadGroup(cur_block, cur->width, ref_moved, ref->width, cur->clip_width, cur->clip_height,
+                          UTL_BLOCK_SAD_INVALID, sad + k);
+            k += run;
+        }
+        else
+        {
+            sad[k++] = blockSad(cur_block, cur->width, ref_moved, ref->width, cur->clip_width, cur->clip_height,
+                                UTL_BLOCK_SAD_INVALID);
+        }
+    }
+
+    return result;
+}
+
+UTIL_ERRCODE_ENUM utilBlockSadSearch(P_UTIL_BLOCK_SAD_STRUCT sad_data, MINT32 range_x, MINT32 range_y, MUINT32 *sad_map, MINT32 *best_motion)
+{
+    UTIL_ERRCODE_ENUM result = checkBlock(sad_data);
+    P_UTIL_CLIP_IMAGE_STRUCT cur = &sad_data->cur;
+    P_UTIL_BASE_IMAGE_STRUCT ref = &sad_data->ref;
+    MUINT32 best = UTL_BLOCK_SAD_INVALID, limit = UTL_BLOCK_SAD_INVALID;
+    MINT32 dx_lo, dx_hi, dy_lo, dy_hi;
+
+    if (result == UTIL_OK && (range_x < 0 || range_y < 0))
+        result = UTIL_COMMON_ERR_INVALID_PARAMETER;
+    if (result != UTIL_OK)
+    {
+        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
+        return result;
+    }
+
+    // the window of motions whose block is inside ref, the others are UTL_BLOCK_SAD_INVALID
+    motionBounds(sad_data, &dx_lo, &dx_hi, &dy_lo, &dy_hi);
+    dx_lo = UTL_MAX(dx_lo, -range_x);
+    dx_hi = UTL_MIN(dx_hi, range_x);
+    dy_lo = UTL_MAX(dy_lo, -range_y);
+    dy_hi = UTL_MIN(dy_hi, range_y);
+
+    const MUINT8 *cur_block = (const MUINT8 *)cur->data + cur->clip_y * cur->width + cur->clip_x;
+    const MUINT8 *ref_block = (const MUINT8 *)ref->data + cur->clip_y * ref->width + cur->clip_x;
+    const MINT32 w = cur->clip_width;
+    const MINT32 h = cur->clip_height;
+
+    // a candidate past the zero motion sad is never the best one
+    if (!sad_map && dx_lo <= 0 && dx_hi >= 0 && dy_lo <= 0 && dy_hi >= 0)
+        limit = blockSad(cur_block, cur->width, ref_block, ref->width, w, h, UTL_BLOCK_SAD_INVALID);
+
+    best_motion[0] = 0;
+    best_motion[1] = 0;
+    for (MINT32 dy = -range_y; dy <= range_y; dy++)
+    {
+        MINT32 dx = -range_x;
+        if (dy >= dy_lo && dy <= dy_hi)
+        {
+            const MUINT8 *ref_row = ref_block + dy * ref->width;
+
+            for (; dx < dx_lo && sad_map; dx++)
+                *sad_map++ = UTL_BLOCK_SAD_INVALID;
+            dx = UTL_MAX(dx, dx_lo);
+
+            // UTL_BLOCK_SAD_GROUP candidates share the rows of ref, the last ones of the row go alone
+            while (dx <= dx_hi)
+            {
+                MUINT32 sads[UTL_BLOCK_SAD_GROUP];
+                MINT32 n = UTL_BLOCK_SAD_GROUP;
+                if (dx_hi - dx + 1 >= UTL_BLOCK_SAD_GROUP)
                 {
-                    SadSum += 0;
-                    Count--;
+                    blockSadGroup(cur_block, cur->width, ref_row + dx, ref->width, w, h, limit, sads);
                 }
                 else
-                    SadSum += UTL_ABS((MINT32)(*pImg2X) - (MINT32)(*pImg1X));
+                {
+                    sads[0] = blockSad(cur_block, cur->width, ref_row + dx, ref->width, w, h, limit);
+                    n = 1;
+                }
 
-                pImg1X+=xoffset;
-                pImg2X+=xoffset;
+                for (MINT32 j = 0; j < n; j++, dx++)
+                {
+                    if (sad_map)
+                        *sad_map++ = sads[j];
+                    if (sads[j] < best)
+                    {
+                        best = sads[j];
+                        best_motion[0] = dx;
+                        best_motion[1] = dy;
+                        if (!sad_map)
+                            limit = UTL_MIN(limit, best);
+                    }
+                }
             }
         }
-        for (; i!=0; i--)
-        {
-            SadSum += UTL_ABS((MINT32)*pImg2X - (MINT32)*pImg1X);
-            Count+=1;
 
-            pImg1X+=xoffset;
-            pImg2X+=xoffset;
-        }
-        pImg1Y+=yoffset1;
-        pImg2Y+=yoffset2;
+        for (; dx <= range_x && sad_map; dx++)
+            *sad_map++ = UTL_BLOCK_SAD_INVALID;
     }
 
-    *sum = SadSum;
-    *count = Count;
-
     return result;
 }
-
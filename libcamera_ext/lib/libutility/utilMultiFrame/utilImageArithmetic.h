@@ -6,6 +6,8 @@
 #define SUBSAMPLE_D                     (4)       //Sub-smaple ratio in both direction
 #define MOTION_CALCULATED_PIXELS        (10)
 
+#define UTL_BLOCK_SAD_INVALID           (0xFFFFFFFF)    ///< sad of a block outside the reference image
+
 typedef struct UTIL_IMAGE_SAD_STRUCT
 {
     UTIL_CLIP_IMAGE_STRUCT src1;
@@ -15,12 +17,63 @@ typedef struct UTIL_IMAGE_SAD_STRUCT
     MINT16 saturation_value;
 } UTIL_IMAGE_SAD_STRUCT, *P_UTIL_IMAGE_SAD_STRUCT;
 
+/**
+ *  \details block matching data
+ */
+typedef struct UTIL_BLOCK_SAD_STRUCT
+{
+    UTIL_CLIP_IMAGE_STRUCT cur;     ///< current image, the clip is the block
+    UTIL_BASE_IMAGE_STRUCT ref;     ///< reference image
+} UTIL_BLOCK_SAD_STRUCT, *P_UTIL_BLOCK_SAD_STRUCT;
+
 
 UTIL_ERRCODE_ENUM ImageSubstract(const UTIL_BASE_IMAGE_STRUCT* A, const UTIL_BASE_IMAGE_STRUCT* B, MINT32 residue, UTIL_BASE_IMAGE_STRUCT* C);
 UTIL_ERRCODE_ENUM ImageAdd(const UTIL_BASE_IMAGE_STRUCT* A, const UTIL_BASE_IMAGE_STRUCT* B, MINT32 residue, UTIL_BASE_IMAGE_STRUCT* C);
 UTIL_ERRCODE_ENUM utilImageSad(P_UTIL_IMAGE_SAD_STRUCT sad_data, MUINT32 *sum, MUINT32 *count);
 
+/**
+ *  \details utilImageSad for a list of motions
+ *  \fn UTIL_ERRCODE_ENUM utilImageSadBatch(P_UTIL_IMAGE_SAD_STRUCT sad_data, const MINT32 *motion, MINT32 num, MUINT32 *sum, MUINT32 *count)
+ *  \param[in] sad_data sad data, src1.clip_x and src1.clip_y are not used
+ *  \param[in] motion num (x, y) pairs, used as src1.clip_x and src1.clip_y
+ *  \param[in] num number of motions
+ *  \param[out] sum num sums
+ *  \param[out] count num counts
+ *  \return utility error code enumerator
+ *
+ *  The motions are run row by row together, so the rows they read are
+ *  still in the cache for the next motion.
+ */
+UTIL_ERRCODE_ENUM utilImageSadBatch(P_UTIL_IMAGE_SAD_STRUCT sad_data, const MINT32 *motion, MINT32 num, MUINT32 *sum, MUINT32 *count);
 
+/**
+ *  \details sad of a block against blocks of the reference image
+ *  \fn UTIL_ERRCODE_ENUM utilBlockSad(P_UTIL_BLOCK_SAD_STRUCT sad_data, const MINT32 *motion, MINT32 num, MUINT32 *sad)
+ *  \param[in] sad_data block and reference image, the block must be inside cur
+ *  \param[in] motion num (x, y) pairs, the offsets of the reference blocks from the block
+ *  \param[in] num number of motions
+ *  \param[out] sad num sads, UTL_BLOCK_SAD_INVALID for a reference block outside ref
+ *  \return utility error code enumerator
+ *
+ *  Runs of 4 motions one pixel apart on a row are evaluated together.
+ */
+UTIL_ERRCODE_ENUM utilBlockSad(P_UTIL_BLOCK_SAD_STRUCT sad_data, const MINT32 *motion, MINT32 num, MUINT32 *sad);
+
+/**
+ *  \details full search of a block in a window of the reference image
+ *  \fn UTIL_ERRCODE_ENUM utilBlockSadSearch(P_UTIL_BLOCK_SAD_STRUCT sad_data, MINT32 range_x, MINT32 range_y, MUINT32 *sad_map, MINT32 *best_motion)
+ *  \param[in] sad_data block and reference image, the block must be inside cur
+ *  \param[in] range_x motions from -range_x to range_x
+ *  \param[in] range_y motions from -range_y to range_y
+ *  \param[out] sad_map (2 * range_y + 1) x (2 * range_x + 1) sads as utilBlockSad, or NULL
+ *  \param[out] best_motion (x, y) of the first smallest sad in raster order, (0, 0) if no block is inside ref
+ *  \return utility error code enumerator
+ *
+ *  Candidates are evaluated 4 at a time along a row. Without sad_map a
+ *  group is dropped, checked every 4 rows, once the partial sads of all
+ *  its candidates pass the best one.
+ */
+UTIL_ERRCODE_ENUM utilBlockSadSearch(P_UTIL_BLOCK_SAD_STRUCT sad_data, MINT32 range_x, MINT32 range_y, MUINT32 *sad_map, MINT32 *best_motion);
 
-#endif /* _UTIL_IMAGEARITHMETIC_H_ */
 
+#endif /* _UTIL_IMAGEARITHMETIC_H_ */
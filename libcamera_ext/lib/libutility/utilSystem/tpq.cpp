@@ -2,6 +2,7 @@
 
 #ifdef __ANDROID__
 #include <unistd.h>
+#include <sched.h>
 #else
 #include <windows.h>
 #endif
@@ -10,6 +11,7 @@
 #include <pthread.h>
 #include <time.h>
 #include <string.h>
+#include <atomic>
 
 #include "tpq.h"
 
@@ -30,26 +32,89 @@
 #define prctl(...)
 #endif
 
+/*
+ * Scheduling model
+ *
+ * Each worker owns a Chase-Lev deque of job pointers: the owner pushes and
+ * pops at the bottom, idle workers steal from the top. Jobs added from the
+ * calling thread are dealt to the deques by tpq_exec while all workers are
+ * parked, so every deque only ever has one pushing thread at a time. Jobs
+ * added from inside a job go to the deque of the running worker.
+ *
+ * Job descriptors come from chunked pools (one for the caller, one per
+ * worker) that are rewound when tpq_exec returns, so steady-state execution
+ * does no allocation.
+ *
+ * A job counts the jobs it adds; tpq_exec from inside the job runs jobs
+ * until those are done. Workers with nothing to steal spin, yield, then
+ * park on work_cond until a job is pushed or a count they wait on drops
+ * to 0.
+ */
+
+#define JOB_CHUNK_SIZE      256                     /* jobs per pool chunk      */
+#define DEQUE_INIT_SIZE     256                     /* initial deque capacity   */
+#define SPLIT_DEPTH         2                       /* lazy split threshold     */
+#define AUTO_GRAIN_SPLITS   32                      /* auto grain ranges/thread */
+#define SPIN_COUNT          64                      /* polls before yielding    */
+#define YIELD_COUNT         16                      /* yields before parking    */
+
+struct pfor;
+
 /* Job */
 typedef struct job
 {
-    struct job*  next;                              /* next job                 */
     tp_func function;                               /* function pointer         */
     void*  arg;                                     /* argument                 */
     int task_id;                                    /* global task id           */
 
     int group_id;
     int group_task_id;                              /* group task id            */
+
+    struct pfor* range_p;                           /* parallel-for range job   */
+    int begin;
+    int end;
+
+    struct job* parent_p;                           /* job which added this one */
+    std::atomic<int> children;                      /* added jobs not finished  */
 } job;
 
-/* linked-list Job Queue */
-typedef struct jobq
+/* parallel-for context, lives on the stack of tpq_parallel_for */
+typedef struct pfor
+{
+    tp_range_func function;
+    void* arg;
+    int grain;
+    std::atomic<int> remaining;                     /* # of items not yet run   */
+} pfor;
+
+/* chunked job pool, rewound after each tpq_exec */
+typedef struct jobchunk
+{
+    struct jobchunk* next;
+    job jobs[JOB_CHUNK_SIZE];
+} jobchunk;
+
+typedef struct jobpool
 {
-    pthread_mutex_t lock;                           /* lock for critical access */
-    job  *head;                                     /* head of queue            */
-    job  *tail;                                     /* tail of queue            */
-    volatile int  len;                              /* # of jobs                */
-} jobq;
+    jobchunk* head;                                 /* first chunk              */
+    jobchunk* cur;                                  /* chunk in use             */
+    int used;                                       /* jobs used in cur         */
+} jobpool;
+
+/* Chase-Lev deque storage, old arrays are kept until tpq_destroy */
+typedef struct dqarray
+{
+    struct dqarray* prev;
+    long size;                                      /* power of 2               */
+    std::atomic<job*> slots[1];
+} dqarray;
+
+typedef struct deque
+{
+    std::atomic<long> top;
+    std::atomic<long> bottom;
+    std::atomic<dqarray*> array;
+} deque;
 
 typedef struct group
 {
@@ -60,10 +125,13 @@ typedef struct group
 typedef struct thread
 {
     pthread_t pthread;                              /* pointer to actual thread */
+    int       started;                              /* pthread created          */
     struct tpq_* tpq_p;                             /* access to tpq            */
     rtinfo    thread_rtinfo;
-    pthread_mutex_t     start_mutex;
-    pthread_mutex_t     end_mutex;
+    deque     dq;                                   /* own work deque           */
+    jobpool   pool;                                 /* jobs spawned by thread   */
+    unsigned int seed;                              /* victim selection         */
+    struct job* cur_job_p;                          /* job being run            */
 } thread;
 
 
@@ -77,27 +145,76 @@ typedef struct tpq_
     volatile int        num_alive;                  /* # of alive threads       */
 
     pthread_mutex_t     mutex;
-
-    jobq*               jobq_p;                     /* job queue                */
+    pthread_cond_t      start_cond;                 /* workers wait for exec    */
+    pthread_cond_t      end_cond;                   /* caller waits for workers */
+    pthread_cond_t      work_cond;                  /* idle workers wait for jobs */
+    std::atomic<int>    num_idle;                   /* workers on work_cond     */
+    unsigned int        generation;                 /* exec count               */
+    int                 num_awake;                  /* workers not parked       */
+
+    std::atomic<int>    pending;                    /* jobs not yet finished    */
+    std::atomic<int>    next_task_id;               /* ids of nested jobs       */
+    int                 num_tasks;                  /* jobs of current exec     */
+
+    pthread_mutex_t     add_lock;                   /* external add             */
+    jobpool             pool;                       /* externally added jobs    */
+    job**               added;                      /* jobs in add order        */
+    int                 num_added;
+    int                 max_added;
 
     int                 num_groups;
     group               *groups;
     const char          *thread_name;               /* thread name              */
 } tpq_;
 
+/* worker of the calling thread, NULL for other threads */
+static pthread_key_t  s_worker_key;
+static pthread_once_t s_worker_key_once = PTHREAD_ONCE_INIT;
+
 
 /* declaration of static infrastructure functions */
-//static void  thread_create(tpq_* tpq_p, struct thread** thread_p, int id);
-static void  thread_create(tpq_* tpq_p);
-static void  thread_get_tasks(tpq_* tpq_p);
+static int   thread_create(tpq_* tpq_p);
 static void* thread_do(void* thread_ptr);
 static void  thread_destroy(tpq_* tpq_p);
+static void  thread_run_job(struct thread* thread_p, struct job* job_p);
+static void  thread_help(struct thread* thread_p, std::atomic<int>* remaining_p);
+static void  thread_idle(struct thread* thread_p, std::atomic<int>* count_p, int* spin_p);
+static void  thread_wake(tpq_* tpq_p, int all);
+static struct thread* thread_self(tpq_* tpq_p);
+
+static struct job*  jobpool_alloc(struct jobpool* pool_p);
+static void         jobpool_rewind(struct jobpool* pool_p);
+static void         jobpool_destroy(struct jobpool* pool_p);
+
+static int          deque_init(struct deque* dq_p);
+static int          deque_push(struct deque* dq_p, struct job* job_p);
+static struct job*  deque_take(struct deque* dq_p);
+static struct job*  deque_steal(struct deque* dq_p);
+static long         deque_size(struct deque* dq_p);
+static void         deque_destroy(struct deque* dq_p);
+
+static void worker_key_create(void)
+{
+    pthread_key_create(&s_worker_key, NULL);
+}
+
+static inline void cpu_relax(void)
+{
+#if defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield" ::: "memory");
+#elif defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#endif
+}
 
-static int          jobq_init(tpq_* tpq_p);
-static void         jobq_clear(tpq_* tpq_p);
-static void         jobq_enq(tpq_* tpq_p, struct job* newjob_p);
-static struct job*  jobq_deq(tpq_* tpq_p);
-static void         jobq_destroy(tpq_* tpq_p);
+static inline void thread_yield(void)
+{
+#ifdef __ANDROID__
+    sched_yield();
+#else
+    Sleep(0);
+#endif
+}
 
 /* create an instance of Thread Pool Queue */
 struct tpq_* tpq_group_create(int num_threads, int num_groups, const char *thread_name)
@@ -107,6 +224,8 @@ struct tpq_* tpq_group_create(int num_threads, int num_groups, const char *threa
         num_threads = 4;
     }
 
+    pthread_once(&s_worker_key_once, worker_key_create);
+
     /* create new thread pool */
     tpq_p = (struct tpq_*)calloc(sizeof(struct tpq_), 1);
     if (tpq_p == NULL){
@@ -117,23 +236,20 @@ struct tpq_* tpq_group_create(int num_threads, int num_groups, const char *threa
     tpq_p->keepalive = 1;
 
     if(num_groups > 0){
+        tpq_p->groups = (struct group*)calloc(sizeof(struct group), num_groups);
+        if (tpq_p->groups == NULL){
+            LOGE("tpq_create(): Could not allocate memory for groups\n");
+            free(tpq_p);
+            return NULL;
+        }
         tpq_p->num_groups = num_groups;
-        tpq_p->groups = (struct group*)calloc(sizeof(struct group), 1);
-    }
-
-    /* init the job queue */
-    if (jobq_init(tpq_p) == -1){
-        LOGE("tpq_create(): Could not allocate memory for job queue\n");
-        free(tpq_p);
-        return NULL;
     }
 
     /* create thread pool */
-    tpq_p->threads = (struct thread**)calloc(num_threads * sizeof(struct thread), 1);
+    tpq_p->threads = (struct thread**)calloc(num_threads, sizeof(struct thread*));
     if (tpq_p->threads == NULL){
         LOGE("tpq_create(): Could not allocate memory for threads\n");
-        jobq_destroy(tpq_p);
-        free(tpq_p->jobq_p);
+        free(tpq_p->groups);
         free(tpq_p);
         return NULL;
     }
@@ -142,8 +258,16 @@ struct tpq_* tpq_group_create(int num_threads, int num_groups, const char *threa
     tpq_p->thread_name = thread_name;
 
     pthread_mutex_init(&(tpq_p->mutex), NULL);
-
-    thread_create(tpq_p);
+    pthread_cond_init(&(tpq_p->start_cond), NULL);
+    pthread_cond_init(&(tpq_p->end_cond), NULL);
+    pthread_cond_init(&(tpq_p->work_cond), NULL);
+    pthread_mutex_init(&(tpq_p->add_lock), NULL);
+
+    if (thread_create(tpq_p) != 0){
+        LOGE("tpq_create(): Could not create threads\n");
+        tpq_destroy(tpq_p);
+        return NULL;
+    }
 
     return tpq_p;
 }
@@ -156,25 +280,74 @@ struct tpq_* tpq_create(int num_threads, const char *thread_name)
 /* enqueue a work to thread pool queue*/
 int tpq_add_group_work(int gidx, tpq_* tpq_p, tp_func func_ptr, void* arg_ptr)
 {
-
+    struct thread* self_p = thread_self(tpq_p);
     job* newjob;
-    newjob = (struct job*)calloc(sizeof(struct job), 1);
-    if (newjob == NULL){
-        LOGE("tpq_add_work(): Could not allocate memory for new job\n");
-        return -1;
+
+    if (self_p){
+        /* nested work, runs in the current tpq_exec */
+        newjob = jobpool_alloc(&self_p->pool);
+        if (newjob == NULL){
+            LOGE("tpq_add_work(): Could not allocate memory for new job\n");
+            return -1;
+        }
+        newjob->task_id = tpq_p->next_task_id.fetch_add(1, std::memory_order_relaxed);
+    }else{
+        pthread_mutex_lock(&tpq_p->add_lock);
+        if (tpq_p->num_added == tpq_p->max_added){
+            int max_added = tpq_p->max_added ? tpq_p->max_added * 2 : JOB_CHUNK_SIZE;
+            job** added = (job**)realloc(tpq_p->added, max_added * sizeof(job*));
+            if (added == NULL){
+                pthread_mutex_unlock(&tpq_p->add_lock);
+                LOGE("tpq_add_work(): Could not allocate memory for new job\n");
+                return -1;
+            }
+            tpq_p->added = added;
+            tpq_p->max_added = max_added;
+        }
+        newjob = jobpool_alloc(&tpq_p->pool);
+        if (newjob == NULL){
+            pthread_mutex_unlock(&tpq_p->add_lock);
+            LOGE("tpq_add_work(): Could not allocate memory for new job\n");
+            return -1;
+        }
+        newjob->task_id = tpq_p->num_added;
+        tpq_p->added[tpq_p->num_added++] = newjob;
     }
+
     /* add function and argument */
     newjob->function = func_ptr;
     newjob->arg = arg_ptr;
+    newjob->range_p = NULL;
+    newjob->parent_p = self_p ? self_p->cur_job_p : NULL;
+    newjob->children.store(0, std::memory_order_relaxed);
+    newjob->group_id = -1;
+    newjob->group_task_id = 0;
 
     if(tpq_p->num_groups){
         newjob->group_id = gidx;
-        if(gidx >= 0)
-            newjob->group_task_id = tpq_p->groups[gidx].num_tasks++;
+        if(gidx >= 0){
+            if (self_p)
+                newjob->group_task_id = __atomic_fetch_add(&tpq_p->groups[gidx].num_tasks, 1, __ATOMIC_RELAXED);
+            else
+                newjob->group_task_id = tpq_p->groups[gidx].num_tasks++;
+        }
     }
 
-    /* add job to queue */
-    jobq_enq(tpq_p, newjob);
+    if (self_p){
+        tpq_p->pending.fetch_add(1, std::memory_order_relaxed);
+        if (newjob->parent_p)
+            newjob->parent_p->children.fetch_add(1, std::memory_order_relaxed);
+        if (deque_push(&self_p->dq, newjob) != 0){
+            if (newjob->parent_p)
+                newjob->parent_p->children.fetch_sub(1, std::memory_order_relaxed);
+            tpq_p->pending.fetch_sub(1, std::memory_order_relaxed);
+            LOGE("tpq_add_work(): Could not allocate memory for new job\n");
+            return -1;
+        }
+        thread_wake(tpq_p, 0);
+    }else{
+        pthread_mutex_unlock(&tpq_p->add_lock);
+    }
 
     return 0;
 }
@@ -187,38 +360,130 @@ int tpq_add_work(tpq_* tpq_p, tp_func func_ptr, void* arg_ptr)
 /* Wait until all jobs have finished */
 void tpq_exec(tpq_* tpq_p, unsigned int timeout_us)
 {
-    int i;
+    struct thread* self_p = thread_self(tpq_p);
+    int i, n, num_added;
 
-    thread_get_tasks(tpq_p);
+    (void)timeout_us;
 
-    /* trigger thread pool for tasks */
-    for(i = 0; i < tpq_p->num_threads; i++)
-        pthread_mutex_unlock(&(tpq_p->threads[i]->start_mutex));
+    /* jobs added from a job already belong to the running tpq_exec, run
+       jobs until the ones this job added are done */
+    if (self_p){
+        if (self_p->cur_job_p)
+            thread_help(self_p, &self_p->cur_job_p->children);
+        return;
+    }
 
-    for(i = 0; i < tpq_p->num_threads; i++)
-        pthread_mutex_lock(&(tpq_p->threads[i]->end_mutex));
+    /* all workers are parked here, deal added jobs to their deques */
+    num_added = tpq_p->num_added;
+    tpq_p->num_tasks = num_added;
+    tpq_p->next_task_id.store(num_added, std::memory_order_relaxed);
+    tpq_p->pending.fetch_add(num_added, std::memory_order_relaxed);
+    for (n = 0; n < tpq_p->num_threads; n++){
+        struct thread* thread_p = tpq_p->threads[n];
+        int begin = (int)((long)num_added * n / tpq_p->num_threads);
+        int end   = (int)((long)num_added * (n + 1) / tpq_p->num_threads);
+        /* pushed in reverse so that the owner pops them in add order */
+        for (i = end - 1; i >= begin; i--){
+            if (deque_push(&thread_p->dq, tpq_p->added[i]) != 0){
+                /* out of memory, run it here as the parked owner */
+                LOGE("tpq_exec(): Could not grow deque, run job inline\n");
+                thread_run_job(thread_p, tpq_p->added[i]);
+            }
+        }
+    }
 
+    /* trigger thread pool for tasks, wait until all are parked again */
+    pthread_mutex_lock(&tpq_p->mutex);
+    tpq_p->generation++;
+    tpq_p->num_awake = tpq_p->num_threads;
+    pthread_cond_broadcast(&tpq_p->start_cond);
+    while (tpq_p->num_awake)
+        pthread_cond_wait(&tpq_p->end_cond, &tpq_p->mutex);
+    pthread_mutex_unlock(&tpq_p->mutex);
+
+    /* release job descriptors for the next round */
+    tpq_p->num_added = 0;
+    jobpool_rewind(&tpq_p->pool);
+    for (n = 0; n < tpq_p->num_threads; n++)
+        jobpool_rewind(&tpq_p->threads[n]->pool);
 
     for(i = 0; i < tpq_p->num_groups; i++)
         tpq_p->groups[i].num_tasks = 0;
 }
 
+/* parallel for over [begin, end) */
+void tpq_parallel_for(tpq_* tpq_p, int begin, int end, int grain, tp_range_func func_ptr, void* arg_ptr)
+{
+    struct thread* self_p = thread_self(tpq_p);
+    pfor range;
+    job* root;
+
+    if (end <= begin)
+        return;
+
+    if (grain <= 0){
+        grain = (end - begin) / (tpq_p->num_threads * AUTO_GRAIN_SPLITS);
+        if (grain < 1)
+            grain = 1;
+    }
+
+    range.function = func_ptr;
+    range.arg = arg_ptr;
+    range.grain = grain;
+    range.remaining.store(end - begin, std::memory_order_relaxed);
+
+    if (self_p){
+        root = jobpool_alloc(&self_p->pool);
+    }else{
+        pthread_mutex_lock(&tpq_p->add_lock);
+        root = jobpool_alloc(&tpq_p->pool);
+        pthread_mutex_unlock(&tpq_p->add_lock);
+    }
+    if (root == NULL){
+        LOGE("tpq_parallel_for(): Could not allocate memory for new job\n");
+        return;
+    }
+    root->function = NULL;
+    root->arg = NULL;
+    root->range_p = &range;
+    root->begin = begin;
+    root->end = end;
+    root->parent_p = NULL;
+    root->children.store(0, std::memory_order_relaxed);
+
+    tpq_p->pending.fetch_add(1, std::memory_order_relaxed);
+    if (self_p){
+        /* nested: split from the own deque and help until the range is done */
+        if (deque_push(&self_p->dq, root) != 0)
+            thread_run_job(self_p, root);
+        else
+            thread_wake(tpq_p, 0);
+        thread_help(self_p, &range.remaining);
+    }else{
+        /* the range starts on the first worker, the others steal its halves */
+        if (deque_push(&tpq_p->threads[0]->dq, root) != 0)
+            thread_run_job(tpq_p->threads[0], root);
+        tpq_exec(tpq_p, 0);
+    }
+}
+
 /* destroy the thread pool queue */
 void tpq_destroy(tpq_* tpq_p)
 {
     int i, accu_time = 0;
 
     /* End each thread 's infinite loop */
+    pthread_mutex_lock(&tpq_p->mutex);
     tpq_p->keepalive = 0;
-
-    for(i = 0; i < tpq_p->num_threads; i++)
-        pthread_mutex_unlock(&(tpq_p->threads[i]->start_mutex));
+    pthread_cond_broadcast(&tpq_p->start_cond);
+    pthread_mutex_unlock(&tpq_p->mutex);
 
     void *tmp;
     for(i = 0; i < tpq_p->num_threads; i++)
     {
-        struct thread** thread_p = &tpq_p->threads[i];
-        pthread_join((*thread_p)->pthread,&tmp);
+        struct thread* thread_p = tpq_p->threads[i];
+        if (thread_p && thread_p->started)
+            pthread_join(thread_p->pthread,&tmp);
     }
 
     /* Give one second to kill idle threads */
@@ -242,10 +507,14 @@ void tpq_destroy(tpq_* tpq_p)
     }
 
     pthread_mutex_destroy(&tpq_p->mutex);
+    pthread_cond_destroy(&tpq_p->start_cond);
+    pthread_cond_destroy(&tpq_p->end_cond);
+    pthread_cond_destroy(&tpq_p->work_cond);
+    pthread_mutex_destroy(&tpq_p->add_lock);
 
-    /* Job queue cleanup */
-    jobq_destroy(tpq_p);
-    free(tpq_p->jobq_p);
+    /* Job pool cleanup */
+    jobpool_destroy(&tpq_p->pool);
+    free(tpq_p->added);
 
     if(tpq_p->groups)
         free(tpq_p->groups);
@@ -256,8 +525,8 @@ void tpq_destroy(tpq_* tpq_p)
     free(tpq_p);
 }
 
-/* create a thread in the thread pool */
-static void thread_create(tpq_* tpq_p)
+/* create the threads of the thread pool */
+static int thread_create(tpq_* tpq_p)
 {
     int n;
     for(n = 0; n < tpq_p->num_threads; n++){
@@ -265,21 +534,27 @@ static void thread_create(tpq_* tpq_p)
         *thread_p = (struct thread*)calloc(sizeof(struct thread), 1);
         if(*thread_p == NULL){
             LOGE("tpq_create(): Could not allocate memory for thread\n");
-            exit(1);
+            return -1;
         }
 
         (*thread_p)->tpq_p    = tpq_p;
         (*thread_p)->thread_rtinfo.num_threads = tpq_p->num_threads;
         (*thread_p)->thread_rtinfo.thread_id = n;
+        (*thread_p)->seed = 2463534242u + n * 0x9E3779B9u;
 
-        pthread_mutex_init(&((*thread_p)->start_mutex), NULL);
-        pthread_mutex_lock(&((*thread_p)->start_mutex));
-        pthread_mutex_init(&((*thread_p)->end_mutex), NULL);
-        pthread_mutex_lock(&((*thread_p)->end_mutex));
+        if (deque_init(&(*thread_p)->dq) != 0){
+            LOGE("tpq_create(): Could not allocate memory for deque\n");
+            return -1;
+        }
+    }
 
-        int res = pthread_create(&(*thread_p)->pthread, NULL, thread_do, (*thread_p));
+    /* deques must exist before any worker tries to steal */
+    for(n = 0; n < tpq_p->num_threads; n++){
+        struct thread* thread_p = tpq_p->threads[n];
+        int res = pthread_create(&thread_p->pthread, NULL, thread_do, thread_p);
         if (res == 0)
         {
+            thread_p->started = 1;
             /* Mark thread as alive (initialized) */
             pthread_mutex_lock(&tpq_p->mutex);
             tpq_p->num_alive++;
@@ -287,20 +562,191 @@ static void thread_create(tpq_* tpq_p)
         }
         else
         {
-            //TODO: handle pthread_create error exception.
+            return -1;
         }
-        //pthread_detach((*thread_p)->pthread);
+    }
+    return 0;
+}
 
+/* worker of tpq_p running on the calling thread */
+static struct thread* thread_self(tpq_* tpq_p)
+{
+    struct thread* thread_p = (struct thread*)pthread_getspecific(s_worker_key);
+    if (thread_p && thread_p->tpq_p == tpq_p)
+        return thread_p;
+    return NULL;
+}
+
+/* pop own job, else steal from a random victim */
+static struct job* thread_find_job(struct thread* thread_p)
+{
+    tpq_* tpq_p = thread_p->tpq_p;
+    job* job_p = deque_take(&thread_p->dq);
+    int n, num_threads = tpq_p->num_threads;
+
+    if (job_p || num_threads == 1)
+        return job_p;
+
+    /* xorshift32 */
+    thread_p->seed ^= thread_p->seed << 13;
+    thread_p->seed ^= thread_p->seed >> 17;
+    thread_p->seed ^= thread_p->seed << 5;
+
+    int start = thread_p->seed % num_threads;
+    for (n = 0; n < num_threads; n++){
+        struct thread* victim_p = tpq_p->threads[(start + n) % num_threads];
+        if (victim_p == thread_p)
+            continue;
+        job_p = deque_steal(&victim_p->dq);
+        if (job_p)
+            return job_p;
     }
+    return NULL;
 }
 
-static void thread_get_tasks(tpq_ *tpq_p)
+/* any deque has a job to steal */
+static int thread_has_work(tpq_* tpq_p)
 {
     int n;
-    for(n = 0; n < tpq_p->num_threads; n++){
-        struct thread* thread_p = tpq_p->threads[n];
-        thread_p->thread_rtinfo.num_tasks = tpq_p->jobq_p->len;
+    for (n = 0; n < tpq_p->num_threads; n++){
+        if (deque_size(&tpq_p->threads[n]->dq) > 0)
+            return 1;
+    }
+    return 0;
+}
+
+/* no job found: spin, then yield, then park until thread_wake */
+static void thread_idle(struct thread* thread_p, std::atomic<int>* count_p, int* spin_p)
+{
+    tpq_* tpq_p = thread_p->tpq_p;
+
+    if (++*spin_p < SPIN_COUNT){
+        cpu_relax();
+        return;
+    }
+    if (*spin_p < SPIN_COUNT + YIELD_COUNT){
+        thread_yield();
+        return;
+    }
+    *spin_p = 0;
+
+    pthread_mutex_lock(&tpq_p->mutex);
+    tpq_p->num_idle.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    /* a push or a count dropping to 0 after this check wakes us */
+    if (count_p->load(std::memory_order_relaxed) > 0 && !thread_has_work(tpq_p))
+        pthread_cond_wait(&tpq_p->work_cond, &tpq_p->mutex);
+    tpq_p->num_idle.fetch_sub(1, std::memory_order_relaxed);
+    pthread_mutex_unlock(&tpq_p->mutex);
+}
+
+/* after a push (one worker) or a count the workers wait on dropped to 0 (all) */
+static void thread_wake(tpq_* tpq_p, int all)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (tpq_p->num_idle.load(std::memory_order_relaxed) == 0)
+        return;
+
+    pthread_mutex_lock(&tpq_p->mutex);
+    if (all)
+        pthread_cond_broadcast(&tpq_p->work_cond);
+    else
+        pthread_cond_signal(&tpq_p->work_cond);
+    pthread_mutex_unlock(&tpq_p->mutex);
+}
+
+/* run jobs until the count (items of a nested parallel for, jobs added by a job) is 0 */
+static void thread_help(struct thread* thread_p, std::atomic<int>* remaining_p)
+{
+    int spin = 0;
+
+    while (remaining_p->load(std::memory_order_acquire) > 0){
+        job* job_p = thread_find_job(thread_p);
+        if (job_p){
+            thread_run_job(thread_p, job_p);
+            spin = 0;
+        }else{
+            thread_idle(thread_p, remaining_p, &spin);
+        }
+    }
+}
+
+/* run a range job, splitting off halves while the own deque runs low */
+static void thread_run_range(struct thread* thread_p, struct job* job_p)
+{
+    tpq_* tpq_p = thread_p->tpq_p;
+    pfor* range_p = job_p->range_p;
+    int begin = job_p->begin, end = job_p->end;
+    int grain = range_p->grain;
+    rtinfo info;
+
+    memset(&info, 0, sizeof(info));
+    info.task_id = -1;
+    info.group_id = -1;
+    info.thread_id = thread_p->thread_rtinfo.thread_id;
+    info.num_threads = tpq_p->num_threads;
+
+    while (begin < end){
+        int len = end - begin;
+        /* split lazily, only while nobody has work to steal from us */
+        if (len >= 2 * grain && deque_size(&thread_p->dq) < SPLIT_DEPTH){
+            job* half = jobpool_alloc(&thread_p->pool);
+            if (half){
+                int mid = begin + len / 2;
+                half->function = NULL;
+                half->arg = NULL;
+                half->range_p = range_p;
+                half->begin = mid;
+                half->end = end;
+                half->parent_p = NULL;
+                half->children.store(0, std::memory_order_relaxed);
+                tpq_p->pending.fetch_add(1, std::memory_order_relaxed);
+                if (deque_push(&thread_p->dq, half) == 0){
+                    thread_wake(tpq_p, 0);
+                    end = mid;
+                    continue;
+                }
+                tpq_p->pending.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+        int stop = len > grain ? begin + grain : end;
+        range_p->function(range_p->arg, begin, stop, &info);
+        /* range_p may be gone once remaining is 0 */
+        if (range_p->remaining.fetch_sub(stop - begin, std::memory_order_acq_rel) == stop - begin)
+            thread_wake(tpq_p, 1);
+        begin = stop;
+    }
+}
+
+static void thread_run_job(struct thread* thread_p, struct job* job_p)
+{
+    tpq_* tpq_p = thread_p->tpq_p;
+    job* parent_p = job_p->parent_p;
+    job* saved_job_p = thread_p->cur_job_p;
+
+    thread_p->cur_job_p = job_p;
+    if (job_p->range_p){
+        thread_run_range(thread_p, job_p);
+    }else{
+        rtinfo saved = thread_p->thread_rtinfo;
+        thread_p->thread_rtinfo.task_id = job_p->task_id;
+        thread_p->thread_rtinfo.num_tasks = tpq_p->num_tasks;
+        if(tpq_p->num_groups){
+            thread_p->thread_rtinfo.group_id = job_p->group_id;
+            thread_p->thread_rtinfo.group_task_id = job_p->group_task_id;
+            if(job_p->group_id >= 0)
+                thread_p->thread_rtinfo.group_num_tasks = tpq_p->groups[job_p->group_id].num_tasks;
+        }
+        job_p->function(job_p->arg, &thread_p->thread_rtinfo);
+        /* a nested exec may run jobs inside this one */
+        thread_p->thread_rtinfo = saved;
     }
+    thread_p->cur_job_p = saved_job_p;
+
+    if (parent_p && parent_p->children.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        thread_wake(tpq_p, 1);
+    if (tpq_p->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        thread_wake(tpq_p, 1);
 }
 
 /* Worker Thread Loop */
@@ -308,10 +754,14 @@ static void* thread_do(void* thread_ptr)
 {
     /* type casting */
     struct thread* thread_p = (struct thread*)thread_ptr;
+    unsigned int generation = 0;
+    int spin;
 
     /* Assure all threads have been created before starting serving */
     tpq_* tpq_p = thread_p->tpq_p;
 
+    pthread_setspecific(s_worker_key, thread_p);
+
     /* set thread name */
     if (0 != strcmp(tpq_p->thread_name, ""))
     {
@@ -323,34 +773,32 @@ static void* thread_do(void* thread_ptr)
         LOGD("Warning! Thread name will be the same as parent thread\n");
     }
 
-    while(tpq_p->keepalive){
-
-        pthread_mutex_lock(&thread_p->start_mutex);
-
-        while(tpq_p->keepalive && tpq_p->jobq_p->len){
-            tp_func func_buff;
-            void*  arg_buff;
-            job* job_p;
-
-            /* Read job from queue and execute it */
-            job_p = jobq_deq(tpq_p);
-            if (job_p) {
-                func_buff = job_p->function;
-                arg_buff  = job_p->arg;
-                thread_p->thread_rtinfo.task_id = job_p->task_id;
-                if(tpq_p->num_groups){
-                    thread_p->thread_rtinfo.group_id = job_p->group_id;
-                    thread_p->thread_rtinfo.group_task_id = job_p->group_task_id;
-                    if(job_p->group_id >= 0)
-                        thread_p->thread_rtinfo.group_num_tasks = tpq_p->groups[job_p->group_id].num_tasks;
-                }
-                func_buff(arg_buff, &thread_p->thread_rtinfo);
-                free(job_p);
+    for(;;){
+        /* park until the next tpq_exec */
+        pthread_mutex_lock(&tpq_p->mutex);
+        while (tpq_p->keepalive && tpq_p->generation == generation)
+            pthread_cond_wait(&tpq_p->start_cond, &tpq_p->mutex);
+        generation = tpq_p->generation;
+        pthread_mutex_unlock(&tpq_p->mutex);
+
+        if (!tpq_p->keepalive)
+            break;
+
+        spin = 0;
+        while (tpq_p->pending.load(std::memory_order_acquire) > 0){
+            job* job_p = thread_find_job(thread_p);
+            if (job_p){
+                thread_run_job(thread_p, job_p);
+                spin = 0;
+            }else{
+                thread_idle(thread_p, &tpq_p->pending, &spin);
             }
-
         }
 
-        pthread_mutex_unlock(&thread_p->end_mutex);
+        pthread_mutex_lock(&tpq_p->mutex);
+        if (--tpq_p->num_awake == 0)
+            pthread_cond_signal(&tpq_p->end_cond);
+        pthread_mutex_unlock(&tpq_p->mutex);
     }
 
     pthread_mutex_lock(&tpq_p->mutex);
@@ -358,6 +806,7 @@ static void* thread_do(void* thread_ptr)
     pthread_mutex_unlock(&tpq_p->mutex);
 
     pthread_exit(NULL);
+    return NULL;
 }
 
 /* Frees a thread  */
@@ -365,8 +814,10 @@ static void thread_destroy(tpq_* tpq_p)
 {
     int n;
     for(n = 0; n < tpq_p->num_threads; n++){
-        pthread_mutex_destroy(&(tpq_p->threads[n]->start_mutex));
-        pthread_mutex_destroy(&(tpq_p->threads[n]->end_mutex));
+        if (tpq_p->threads[n] == NULL)
+            continue;
+        deque_destroy(&tpq_p->threads[n]->dq);
+        jobpool_destroy(&tpq_p->threads[n]->pool);
         free(tpq_p->threads[n]);
     }
 }
@@ -375,70 +826,144 @@ static void thread_destroy(tpq_* tpq_p)
  * TPQ Internal Infrastructure
  */
 
-/* Initialize queue */
-static int jobq_init(tpq_* tpq_p)
+/* get a job descriptor, chunks are kept across rewinds */
+static struct job* jobpool_alloc(struct jobpool* pool_p)
 {
-    tpq_p->jobq_p = (struct jobq*)calloc(sizeof(struct jobq), 1);
-    if (tpq_p->jobq_p == NULL){
-        return -1;
+    if (pool_p->cur == NULL || pool_p->used == JOB_CHUNK_SIZE){
+        jobchunk* next_p = pool_p->cur ? pool_p->cur->next : pool_p->head;
+        if (next_p == NULL){
+            next_p = (struct jobchunk*)malloc(sizeof(struct jobchunk));
+            if (next_p == NULL)
+                return NULL;
+            next_p->next = NULL;
+            if (pool_p->cur)
+                pool_p->cur->next = next_p;
+            else
+                pool_p->head = next_p;
+        }
+        pool_p->cur = next_p;
+        pool_p->used = 0;
     }
+    return &pool_p->cur->jobs[pool_p->used++];
+}
 
-    pthread_mutex_init(&(tpq_p->jobq_p->lock), NULL);
-
-    return 0;
+static void jobpool_rewind(struct jobpool* pool_p)
+{
+    pool_p->cur = NULL;
+    pool_p->used = 0;
 }
 
-/* clear job queue */
-static void jobq_clear(tpq_* tpq_p)
+static void jobpool_destroy(struct jobpool* pool_p)
 {
-    while(tpq_p->jobq_p->len){
-        free(jobq_deq(tpq_p));
+    jobchunk* chunk_p = pool_p->head;
+    while (chunk_p){
+        jobchunk* next_p = chunk_p->next;
+        free(chunk_p);
+        chunk_p = next_p;
     }
-
-    tpq_p->jobq_p->len = 0;
-    tpq_p->jobq_p->head = NULL;
-    tpq_p->jobq_p->tail  = NULL;
-
+    pool_p->head = NULL;
+    jobpool_rewind(pool_p);
 }
 
-/* enqueue a job */
-static void jobq_enq(tpq_* tpq_p, struct job* newjob)
+static struct dqarray* dqarray_alloc(long size)
 {
+    dqarray* array_p = (struct dqarray*)calloc(1, sizeof(struct dqarray) + (size - 1) * sizeof(std::atomic<job*>));
+    if (array_p)
+        array_p->size = size;
+    return array_p;
+}
 
-    pthread_mutex_lock(&tpq_p->jobq_p->lock);
-
-    newjob->task_id = tpq_p->jobq_p->len;
-    newjob->next = NULL;
-
-    if(tpq_p->jobq_p->len++)
-        tpq_p->jobq_p->tail->next = newjob;
-    else
-        tpq_p->jobq_p->head = newjob;
-
-    tpq_p->jobq_p->tail = newjob;
+static int deque_init(struct deque* dq_p)
+{
+    dqarray* array_p = dqarray_alloc(DEQUE_INIT_SIZE);
+    if (array_p == NULL)
+        return -1;
+    dq_p->top.store(0, std::memory_order_relaxed);
+    dq_p->bottom.store(0, std::memory_order_relaxed);
+    dq_p->array.store(array_p, std::memory_order_relaxed);
+    return 0;
+}
 
-    pthread_mutex_unlock(&tpq_p->jobq_p->lock);
+/* owner only */
+static int deque_push(struct deque* dq_p, struct job* job_p)
+{
+    long b = dq_p->bottom.load(std::memory_order_relaxed);
+    long t = dq_p->top.load(std::memory_order_acquire);
+    dqarray* array_p = dq_p->array.load(std::memory_order_relaxed);
+
+    if (b - t > array_p->size - 1){
+        /* grow, thieves may still read the old array */
+        dqarray* grown_p = dqarray_alloc(array_p->size * 2);
+        if (grown_p == NULL)
+            return -1;
+        for (long i = t; i < b; i++)
+            grown_p->slots[i & (grown_p->size - 1)].store(
+                array_p->slots[i & (array_p->size - 1)].load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+        grown_p->prev = array_p;
+        dq_p->array.store(grown_p, std::memory_order_release);
+        array_p = grown_p;
+    }
+    array_p->slots[b & (array_p->size - 1)].store(job_p, std::memory_order_relaxed);
+    dq_p->bottom.store(b + 1, std::memory_order_release);
+    return 0;
 }
 
-/* dequeue a job */
-static struct job* jobq_deq(tpq_* tpq_p)
+/* owner only, LIFO */
+static struct job* deque_take(struct deque* dq_p)
 {
-    job* job_p;
-    pthread_mutex_lock(&tpq_p->jobq_p->lock);
-    job_p = tpq_p->jobq_p->head;
+    long b = dq_p->bottom.load(std::memory_order_relaxed) - 1;
+    dqarray* array_p = dq_p->array.load(std::memory_order_relaxed);
+    dq_p->bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long t = dq_p->top.load(std::memory_order_relaxed);
+    job* job_p = NULL;
+
+    if (t <= b){
+        job_p = array_p->slots[b & (array_p->size - 1)].load(std::memory_order_relaxed);
+        if (t == b){
+            /* last job, race against thieves */
+            if (!dq_p->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                job_p = NULL;
+            dq_p->bottom.store(b + 1, std::memory_order_relaxed);
+        }
+    }else{
+        dq_p->bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job_p;
+}
 
-    if(tpq_p->jobq_p->head){
-        tpq_p->jobq_p->head = job_p->next;
-        tpq_p->jobq_p->len--;
+/* any thread, FIFO */
+static struct job* deque_steal(struct deque* dq_p)
+{
+    long t = dq_p->top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long b = dq_p->bottom.load(std::memory_order_acquire);
+
+    if (t < b){
+        dqarray* array_p = dq_p->array.load(std::memory_order_acquire);
+        job* job_p = array_p->slots[t & (array_p->size - 1)].load(std::memory_order_relaxed);
+        if (!dq_p->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return NULL;
+        return job_p;
     }
+    return NULL;
+}
 
-    pthread_mutex_unlock(&tpq_p->jobq_p->lock);
-    return job_p;
+static long deque_size(struct deque* dq_p)
+{
+    long b = dq_p->bottom.load(std::memory_order_relaxed);
+    long t = dq_p->top.load(std::memory_order_relaxed);
+    return b > t ? b - t : 0;
 }
 
-/* release job queue resources */
-static void jobq_destroy(tpq_* tpq_p)
+static void deque_destroy(struct deque* dq_p)
 {
-    jobq_clear(tpq_p);
-    pthread_mutex_destroy(&(tpq_p->jobq_p->lock));
+    dqarray* array_p = dq_p->array.load(std::memory_order_relaxed);
+    while (array_p){
+        dqarray* prev_p = array_p->prev;
+        free(array_p);
+        array_p = prev_p;
+    }
+    dq_p->array.store(NULL, std::memory_order_relaxed);
 }
@@ -16,6 +16,7 @@ typedef struct rtinfo
 
 typedef struct tpq_* tp_queue;
 typedef void *(*tp_func)(void*, rtinfo *);
+typedef void (*tp_range_func)(void*, int begin, int end, rtinfo *);
 
 /*
  * Initialize tp_queue
@@ -25,6 +26,7 @@ tp_queue tpq_group_create(int num_threads, int groups, const char *thread_name =
 
 /*
  * Add work to the job queue
+ * From a job of the same tp_queue, the work is added to the running tpq_exec.
  */
 int tpq_add_work(tp_queue, tp_func, void* arg_p);
 int tpq_add_group_work(int, tp_queue, tp_func, void* arg_p);
@@ -33,9 +35,19 @@ int tpq_add_group_work(int, tp_queue, tp_func, void* arg_p);
 
 /*
  * Trigger the execution & block until finish
+ * From a job of the same tp_queue, the calling thread runs jobs until the
+ * ones added by this job so far are finished.
  */
 void tpq_exec(tp_queue, unsigned int);
 
+/*
+ * Run func on [begin, end) in ranges of up to grain items (0 for auto),
+ * with the jobs added so far, & block until finish.
+ * From a job of the same tp_queue, the calling thread runs ranges too.
+ * In rtinfo of a range, only thread_id and num_threads are set.
+ */
+void tpq_parallel_for(tp_queue, int begin, int end, int grain, tp_range_func func, void* arg_p);
+
 /*
  * Release the tp_queue
  */
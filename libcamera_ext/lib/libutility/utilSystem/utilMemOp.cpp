@@ -1,17 +1,333 @@
+#define LOG_TAG "utilMemOp"
+
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
+#if defined(__ANDROID__) || defined(ANDROID)
+#include <android/log.h>
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+#else // WIN32 or LINUX64
+#define LOGD printf
+#endif
 #include "utilMemOp.h"
 
-#ifdef NEON_OPT
-#ifdef ANDROID
-#include "arm_neon.h"
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define MEMOP_NEON
+#include <arm_neon.h>
+#if defined(__aarch64__) && defined(__has_builtin)
+#if __has_builtin(__builtin_nontemporal_store)
+// STNP on aarch64
+#define MEMOP_NEON_STREAM
+#endif
+#endif
+#elif defined(__SSE2__) || defined(_M_X64)
+#define MEMOP_SSE2
+#include <emmintrin.h>
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+// the AVX2 loops are built for AVX2 and only called if the CPU has it
+#define MEMOP_AVX2
+#define MEMOP_AVX2_TARGET __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+#endif
+
+/// a chunk of the tpq overloads
+typedef struct
+{
+    MUINT8 *dst;
+    const MUINT8 *src;      ///< NULL to set
+    MINT32 value;
+    MUINT32 size;
+    MBOOL stream;           ///< part of a copy of at least UTL_MEMOP_STREAM_SIZE
+} UTL_MEMOP_CHUNK_STRUCT;
+
+#ifdef MEMOP_AVX2
+static pthread_once_t g_memop_isa_once = PTHREAD_ONCE_INIT;
+static volatile MINT32 g_memop_avx2 = -1;      ///< -1 until detected
+
+static void detectMemOpIsa()
+{
+    __builtin_cpu_init();
+    g_memop_avx2 = __builtin_cpu_supports("avx2") != 0;
+}
+
+// the once call costs as much as a short copy, so it is only made until detected
+static inline MBOOL hasAvx2()
+{
+    if (g_memop_avx2 < 0)
+        pthread_once(&g_memop_isa_once, detectMemOpIsa);
+    return g_memop_avx2 > 0;
+}
+#endif
+
+/*
+ * Small sizes, up to UTL_MEMOP_SMALL_SIZE. Everything is loaded before it
+ * is stored, so the head and tail moves may overlap.
+ */
+static inline void copySmall(MUINT8 *dst, const MUINT8 *src, MUINT32 size)
+{
+    if (size >= 16)
+    {
+#if defined(MEMOP_NEON)
+        uint8x16_t v_0 = vld1q_u8(src);
+        uint8x16_t v_3 = vld1q_u8(src + size - 16);
+        if (size > 32)
+        {
+            uint8x16_t v_1 = vld1q_u8(src + 16);
+            uint8x16_t v_2 = vld1q_u8(src + size - 32);
+            vst1q_u8(dst + 16, v_1);
+            vst1q_u8(dst + size - 32, v_2);
+        }
+        vst1q_u8(dst, v_0);
+        vst1q_u8(dst + size - 16, v_3);
+#elif defined(MEMOP_SSE2)
+        __m128i v_0 = _mm_loadu_si128((const __m128i *)src);
+        __m128i v_3 = _mm_loadu_si128((const __m128i *)(src + size - 16));
+        if (size > 32)
+        {
+            __m128i v_1 = _mm_loadu_si128((const __m128i *)(src + 16));
+            __m128i v_2 = _mm_loadu_si128((const __m128i *)(src + size - 32));
+            _mm_storeu_si128((__m128i *)(dst + 16), v_1);
+            _mm_storeu_si128((__m128i *)(dst + size - 32), v_2);
+        }
+        _mm_storeu_si128((__m128i *)dst, v_0);
+        _mm_storeu_si128((__m128i *)(dst + size - 16), v_3);
 #else
-#include "neon_template.hpp"
+        memcpy(dst, src, size);
 #endif
+    }
+    else if (size >= 8)
+    {
+        MUINT64 head, tail;
+        memcpy(&head, src, 8);
+        memcpy(&tail, src + size - 8, 8);
+        memcpy(dst, &head, 8);
+        memcpy(dst + size - 8, &tail, 8);
+    }
+    else if (size >= 4)
+    {
+        MUINT32 head, tail;
+        memcpy(&head, src, 4);
+        memcpy(&tail, src + size - 4, 4);
+        memcpy(dst, &head, 4);
+        memcpy(dst + size - 4, &tail, 4);
+    }
+    else if (size != 0)
+    {
+        MUINT8 head = src[0], mid = src[size >> 1], tail = src[size - 1];
+        dst[0] = head;
+        dst[size >> 1] = mid;
+        dst[size - 1] = tail;
+    }
+}
+
+static inline void setSmall(MUINT8 *dst, MUINT8 value, MUINT32 size)
+{
+    if (size >= 16)
+    {
+#if defined(MEMOP_NEON)
+        uint8x16_t v_data = vdupq_n_u8(value);
+        if (size > 32)
+        {
+            vst1q_u8(dst + 16, v_data);
+            vst1q_u8(dst + size - 32, v_data);
+        }
+        vst1q_u8(dst, v_data);
+        vst1q_u8(dst + size - 16, v_data);
+#elif defined(MEMOP_SSE2)
+        __m128i v_data = _mm_set1_epi8((char)value);
+        if (size > 32)
+        {
+            _mm_storeu_si128((__m128i *)(dst + 16), v_data);
+            _mm_storeu_si128((__m128i *)(dst + size - 32), v_data);
+        }
+        _mm_storeu_si128((__m128i *)dst, v_data);
+        _mm_storeu_si128((__m128i *)(dst + size - 16), v_data);
+#else
+        memset(dst, value, size);
 #endif
+    }
+    else if (size >= 8)
+    {
+        MUINT64 data = 0x0101010101010101ULL * value;
+        memcpy(dst, &data, 8);
+        memcpy(dst + size - 8, &data, 8);
+    }
+    else if (size >= 4)
+    {
+        MUINT32 data = 0x01010101U * value;
+        memcpy(dst, &data, 4);
+        memcpy(dst + size - 4, &data, 4);
+    }
+    else if (size != 0)
+    {
+        dst[0] = value;
+        dst[size >> 1] = value;
+        dst[size - 1] = value;
+    }
+}
+
+/*
+ * From UTL_MEMOP_STREAM_SIZE, copies whose destination does not fit in the
+ * cache anyway: an unaligned head, 64 bytes per iteration of non-temporal
+ * stores to an aligned destination, and the last 64 bytes unaligned over
+ * what the loop wrote. Between the tiers libc is faster, and sets are as
+ * fast with libc at every size above UTL_MEMOP_SMALL_SIZE.
+ */
+#ifdef MEMOP_AVX2
+static MEMOP_AVX2_TARGET void copyStreamAvx2(MUINT8 *dst, const MUINT8 *src, MUINT32 size)
+{
+    MUINT8 *dst_end = dst + size;
+    const MUINT8 *src_end = src + size;
+    __m256i v_tail0 = _mm256_loadu_si256((const __m256i *)(src_end - 64));
+    __m256i v_tail1 = _mm256_loadu_si256((const __m256i *)(src_end - 32));
+    MUINT32 skip = 32 - ((size_t)dst & 31);
+
+    _mm256_storeu_si256((__m256i *)dst, _mm256_loadu_si256((const __m256i *)src));
+    dst += skip;
+    src += skip;
+    for (; dst < dst_end - 64; dst += 64, src += 64)
+    {
+        _mm256_stream_si256((__m256i *)dst, _mm256_loadu_si256((const __m256i *)src));
+        _mm256_stream_si256((__m256i *)(dst + 32), _mm256_loadu_si256((const __m256i *)(src + 32)));
+    }
+    _mm_sfence();
+    _mm256_storeu_si256((__m256i *)(dst_end - 64), v_tail0);
+    _mm256_storeu_si256((__m256i *)(dst_end - 32), v_tail1);
+}
+#endif /* MEMOP_AVX2 */
 
-static const MINT32 g_simd_bit = 4;
-static const MINT32 g_step = 1 << g_simd_bit;
+static void copyStream(MUINT8 *dst, const MUINT8 *src, MUINT32 size)
+{
+#if defined(MEMOP_AVX2)
+    if (hasAvx2())
+    {
+        copyStreamAvx2(dst, src, size);
+        return;
+    }
+#endif
+#if defined(MEMOP_NEON_STREAM) || defined(MEMOP_SSE2)
+    MUINT8 *dst_end = dst + size;
+    const MUINT8 *src_end = src + size;
+    MUINT32 skip = 16 - ((size_t)dst & 15);
+#if defined(MEMOP_NEON_STREAM)
+    uint8x16_t v_tail0 = vld1q_u8(src_end - 64), v_tail1 = vld1q_u8(src_end - 48);
+    uint8x16_t v_tail2 = vld1q_u8(src_end - 32), v_tail3 = vld1q_u8(src_end - 16);
+
+    vst1q_u8(dst, vld1q_u8(src));
+    dst += skip;
+    src += skip;
+    for (; dst < dst_end - 64; dst += 64, src += 64)
+    {
+        __builtin_nontemporal_store(vld1q_u8(src), (uint8x16_t *)dst);
+        __builtin_nontemporal_store(vld1q_u8(src + 16), (uint8x16_t *)(dst + 16));
+        __builtin_nontemporal_store(vld1q_u8(src + 32), (uint8x16_t *)(dst + 32));
+        __builtin_nontemporal_store(vld1q_u8(src + 48), (uint8x16_t *)(dst + 48));
+    }
+    vst1q_u8(dst_end - 64, v_tail0);
+    vst1q_u8(dst_end - 48, v_tail1);
+    vst1q_u8(dst_end - 32, v_tail2);
+    vst1q_u8(dst_end - 16, v_tail3);
+#else
+    __m128i v_tail0 = _mm_loadu_si128((const __m128i *)(src_end - 64));
+    __m128i v_tail1 = _mm_loadu_si128((const __m128i *)(src_end - 48));
+    __m128i v_tail2 = _mm_loadu_si128((const __m128i *)(src_end - 32));
+    __m128i v_tail3 = _mm_loadu_si128((const __m128i *)(src_end - 16));
+
+    _mm_storeu_si128((__m128i *)dst, _mm_loadu_si128((const __m128i *)src));
+    dst += skip;
+    src += skip;
+    for (; dst < dst_end - 64; dst += 64, src += 64)
+    {
+        _mm_stream_si128((__m128i *)dst, _mm_loadu_si128((const __m128i *)src));
+        _mm_stream_si128((__m128i *)(dst + 16), _mm_loadu_si128((const __m128i *)(src + 16)));
+        _mm_stream_si128((__m128i *)(dst + 32), _mm_loadu_si128((const __m128i *)(src + 32)));
+        _mm_stream_si128((__m128i *)(dst + 48), _mm_loadu_si128((const __m128i *)(src + 48)));
+    }
+    _mm_sfence();
+    _mm_storeu_si128((__m128i *)(dst_end - 64), v_tail0);
+    _mm_storeu_si128((__m128i *)(dst_end - 48), v_tail1);
+    _mm_storeu_si128((__m128i *)(dst_end - 32), v_tail2);
+    _mm_storeu_si128((__m128i *)(dst_end - 16), v_tail3);
+#endif
+#else
+    // no non-temporal stores on ARMv7
+    memcpy(dst, src, size);
+#endif
+}
+
+static void *memOpChunkJob(void *arg, rtinfo *info)
+{
+    UTL_MEMOP_CHUNK_STRUCT *chunk = (UTL_MEMOP_CHUNK_STRUCT *)arg;
+    (void)info;
+    if (chunk->size <= UTL_MEMOP_SMALL_SIZE)
+    {
+        if (chunk->src)
+            copySmall(chunk->dst, chunk->src, chunk->size);
+        else
+            setSmall(chunk->dst, (MUINT8)chunk->value, chunk->size);
+    }
+    else if (!chunk->src)
+    {
+        memset(chunk->dst, chunk->value, chunk->size);
+    }
+    else if (chunk->stream)
+    {
+        copyStream(chunk->dst, chunk->src, chunk->size);
+    }
+    else
+    {
+        memcpy(chunk->dst, chunk->src, chunk->size);
+    }
+    return NULL;
+}
+
+// chunks on 64-byte boundaries of the destination, so no two share a cache line
+static MINT32 runChunks(MUINT8 *dst, const MUINT8 *src, MINT32 value, MUINT32 size, tp_queue tpq, MINT32 numTasks)
+{
+    MINT32 ret_code = UTIL_OK;
+    UTL_MEMOP_CHUNK_STRUCT chunks[UTL_MEMOP_MAX_TASKS];
+    MUINT32 head = (64 - ((size_t)dst & 63)) & 63;
+    MUINT32 begin = 0;
+
+    if (numTasks <= 0 || numTasks > UTL_MEMOP_MAX_TASKS)
+    {
+        ret_code = UTIL_COMMON_ERR_INVALID_PARAMETER;
+        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME((UTIL_ERRCODE_ENUM)ret_code));
+        return ret_code;
+    }
+    if (tpq == NULL || numTasks == 1 || size < UTL_MEMOP_MT_SIZE)
+        numTasks = 1;
+
+    for (MINT32 i = 0; i < numTasks; i++)
+    {
+        MUINT32 end = size;
+        if (i + 1 < numTasks)
+            end = head + (MUINT32)(((MUINT64)(size - head) * (i + 1) / numTasks) & ~(MUINT64)63);
+        chunks[i].dst = dst + begin;
+        chunks[i].src = src ? src + begin : NULL;
+        chunks[i].value = value;
+        chunks[i].size = end - begin;
+        chunks[i].stream = size >= UTL_MEMOP_STREAM_SIZE;
+        begin = end;
+    }
+
+    if (numTasks == 1)
+    {
+        memOpChunkJob(&chunks[0], NULL);
+    }
+    else
+    {
+        for (MINT32 i = 0; i < numTasks; i++)
+        {
+            if (tpq_add_work(tpq, memOpChunkJob, &chunks[i]) != 0)
+                memOpChunkJob(&chunks[i], NULL);
+        }
+        tpq_exec(tpq, 0);
+    }
+
+    return ret_code;
+}
 
 MINT32 vmemcpy(void *_Dst, void *_Src, MUINT32 Size)
 {
@@ -19,21 +335,12 @@ MINT32 vmemcpy(void *_Dst, void *_Src, MUINT32 Size)
     MUINT8 *p_dst = (MUINT8 *)_Dst;
     MUINT8 *p_src = (MUINT8 *)_Src;
 
-    #ifdef NEON_OPT
-    MINT32 i_simd, simd_bit = g_simd_bit, step = g_step, rest_size;
-    i_simd = Size >> simd_bit;
-    rest_size = Size - (i_simd << simd_bit);
-    while(i_simd-- != 0)
-    {
-        uint8x16_t v_data = vld1q_u8(p_src);
-        p_src += step;
-        vst1q_u8(p_dst, v_data);
-        p_dst += step;
-    }
-    if (rest_size != 0) memcpy(p_dst, p_src, rest_size);
-    #else
-    memcpy(p_dst, p_src, Size);
-    #endif
+    if (Size <= UTL_MEMOP_SMALL_SIZE)
+        copySmall(p_dst, p_src, Size);
+    else if (Size < UTL_MEMOP_STREAM_SIZE)
+        memcpy(p_dst, p_src, Size);
+    else
+        copyStream(p_dst, p_src, Size);
 
     return ret_code;
 }
@@ -43,20 +350,20 @@ MINT32 vmemset(void *_Dst, MINT32 Value, MUINT32 Size)
     MINT32 ret_code = UTIL_OK;
     MUINT8 *p_dst = (MUINT8 *)_Dst;
 
-    #ifdef NEON_OPT
-    MINT32 i, i_simd, simd_bit = g_simd_bit, step = g_step, rest_size;
-    uint8x16_t v_data = vdupq_n_u8(Value);
-    i_simd = Size >> simd_bit;
-    rest_size = Size - (i_simd << simd_bit);
-    while(i_simd-- != 0)
-    {
-        vst1q_u8(p_dst, v_data);
-        p_dst += step;
-    }
-    if (rest_size != 0) memset(p_dst, Value, rest_size);
-    #else
-    memset(p_dst, Value, Size);
-    #endif
+    if (Size <= UTL_MEMOP_SMALL_SIZE)
+        setSmall(p_dst, (MUINT8)Value, Size);
+    else
+        memset(p_dst, (MUINT8)Value, Size);
 
     return ret_code;
-}
\ No newline at end of file
+}
+
+MINT32 vmemcpy(void *_Dst, void *_Src, MUINT32 Size, tp_queue tpq, MINT32 numTasks)
+{
+    return runChunks((MUINT8 *)_Dst, (const MUINT8 *)_Src, 0, Size, tpq, numTasks);
+}
+
+MINT32 vmemset(void *_Dst, MINT32 Value, MUINT32 Size, tp_queue tpq, MINT32 numTasks)
+{
+    return runChunks((MUINT8 *)_Dst, NULL, Value, Size, tpq, numTasks);
+}
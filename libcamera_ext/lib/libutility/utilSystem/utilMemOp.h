@@ -2,8 +2,55 @@
 #define _UTIL_MEM_OP_H_
 
 #include "MTKUtilCommon.h"
+#include "utilSystem/tpq.h"
 
+#define UTL_MEMOP_SMALL_SIZE    (64)            ///< up to this size, a few overlapping moves
+#define UTL_MEMOP_STREAM_SIZE   (2 << 20)       ///< from this size, copies use non-temporal stores that bypass the cache
+#define UTL_MEMOP_MT_SIZE       (4 << 20)       ///< from this size, the tpq overloads split the buffer
+#define UTL_MEMOP_MAX_TASKS     (32)            ///< max number of chunks of the tpq overloads
+
+/**
+ *  \details copy of a buffer, sized by tier: small moves, libc memcpy, non-temporal stores
+ *  \fn MINT32 vmemcpy(void *p_dst, void *p_src, MUINT32 size)
+ *  \param[out] p_dst destination buffer, not overlapping p_src
+ *  \param[in] p_src source buffer
+ *  \param[in] size size in bytes
+ *  \return utility error code
+ */
 MINT32 vmemcpy(void *p_dst, void *p_src, MUINT32 size);
+
+/**
+ *  \details set of a buffer: small moves up to UTL_MEMOP_SMALL_SIZE, libc memset above
+ *  \fn MINT32 vmemset(void *_Dst, MINT32 Value, MUINT32 Size)
+ *  \param[out] _Dst destination buffer
+ *  \param[in] Value byte value
+ *  \param[in] Size size in bytes
+ *  \return utility error code
+ */
 MINT32 vmemset(void *_Dst, MINT32 Value, MUINT32 Size);
 
+/**
+ *  \details vmemcpy in chunks on a thread pool
+ *  \fn MINT32 vmemcpy(void *p_dst, void *p_src, MUINT32 size, tp_queue tpq, MINT32 numTasks)
+ *  \param[out] p_dst destination buffer, not overlapping p_src
+ *  \param[in] p_src source buffer
+ *  \param[in] size size in bytes, below UTL_MEMOP_MT_SIZE it is copied on the calling thread
+ *  \param[in] tpq thread pool to run the chunks on, or NULL to run on the calling thread
+ *  \param[in] numTasks number of chunks (1 to UTL_MEMOP_MAX_TASKS)
+ *  \return utility error code
+ */
+MINT32 vmemcpy(void *p_dst, void *p_src, MUINT32 size, tp_queue tpq, MINT32 numTasks);
+
+/**
+ *  \details vmemset in chunks on a thread pool
+ *  \fn MINT32 vmemset(void *_Dst, MINT32 Value, MUINT32 Size, tp_queue tpq, MINT32 numTasks)
+ *  \param[out] _Dst destination buffer
+ *  \param[in] Value byte value
+ *  \param[in] Size size in bytes, below UTL_MEMOP_MT_SIZE it is set on the calling thread
+ *  \param[in] tpq thread pool to run the chunks on, or NULL to run on the calling thread
+ *  \param[in] numTasks number of chunks (1 to UTL_MEMOP_MAX_TASKS)
+ *  \return utility error code
+ */
+MINT32 vmemset(void *_Dst, MINT32 Value, MUINT32 Size, tp_queue tpq, MINT32 numTasks);
+
 #endif /* _UTIL_MEM_OP_H_ */
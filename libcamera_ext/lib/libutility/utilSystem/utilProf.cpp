@@ -1,7 +1,14 @@
 #define LOG_TAG "utilProf"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#if defined(__linux__) || defined(__ANDROID__)
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#endif
 #include "utilProf.h"
+#include "utilMath.h"
 
 #define BILLION (1000000000)
 
@@ -70,4 +77,454 @@ utilPerf utilPerf::operator+(const utilPerf &in)
     result.sum = this->sum + in.sum;
     result.avg = this->avg + in.avg;
     return result;
-}
\ No newline at end of file
+}
+
+/*
+ * Zone profiler
+ */
+
+/// a recorded zone
+typedef struct
+{
+    const char *name;
+    MUINT64 beg;        ///< ticks
+    MUINT64 end;        ///< ticks
+} UTL_PROF_ZONE_STRUCT;
+
+/// state of a ring
+typedef enum
+{
+    UTL_PROF_RING_LIVE,     ///< its thread records into it
+    UTL_PROF_RING_DONE,     ///< its thread exited, the zones are kept until utilProfStart
+    UTL_PROF_RING_FREE,     ///< no zones, a new thread can take it
+} UTL_PROF_RING_STATE_ENUM;
+
+/// zones of a thread
+typedef struct
+{
+    MUINT32 head;       ///< zones written, only the owner thread writes it
+    MUINT32 start;      ///< head at utilProfStart
+    MINT32 state;       ///< UTL_PROF_RING_STATE_ENUM
+    MINT32 tid;
+    char thread_name[16];
+    UTL_PROF_ZONE_STRUCT zones[UTL_PROF_RING_SIZE];
+} UTL_PROF_RING_STRUCT;
+
+/// begin or end of a zone, for the Perfetto export
+typedef struct
+{
+    MUINT64 ts;         ///< ns
+    MUINT64 dur;        ///< ns
+    const char *name;
+    MINT32 is_end;
+} UTL_PROF_SLICE_STRUCT;
+
+MINT32 g_util_prof_enabled = 0;
+
+static UTL_PROF_RING_STRUCT *g_prof_rings[UTL_PROF_MAX_THREADS];
+static MINT32 g_prof_num_rings = 0;
+static MUINT64 g_prof_start_ticks = 0, g_prof_start_ns = 0;
+static MUINT64 g_prof_calib_ticks = 0, g_prof_calib_ns = 0;
+static double g_prof_ns_per_tick = 0;
+
+static thread_local UTL_PROF_RING_STRUCT *t_prof_ring = NULL;
+static thread_local MINT32 t_prof_registered = 0;
+
+#if defined(__linux__) || defined(__ANDROID__) || defined(__QNX__) || defined(__APPLE__) || defined(__CYGWIN__)
+#define UTL_PROF_THREAD_EXIT
+static pthread_once_t g_prof_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_prof_key;
+
+// at thread exit, the ring goes back to the slots; with zones since
+// utilProfStart it waits for the next utilProfStart, so the export gets them
+static void releaseProfThread(void *arg)
+{
+    UTL_PROF_RING_STRUCT *ring = (UTL_PROF_RING_STRUCT *)arg;
+    MINT32 live = UTL_PROF_RING_LIVE;
+    MINT32 state = __atomic_load_n(&ring->head, __ATOMIC_RELAXED) == __atomic_load_n(&ring->start, __ATOMIC_RELAXED) ?
+                   UTL_PROF_RING_FREE : UTL_PROF_RING_DONE;
+
+    // zones of later thread_local destructors are dropped
+    t_prof_ring = NULL;
+    __atomic_compare_exchange_n(&ring->state, &live, state, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+static void createProfKey()
+{
+    if (pthread_key_create(&g_prof_key, releaseProfThread) != 0)
+        LOGE("no thread key, rings of exited threads are not reused\n");
+}
+#endif
+
+// a free ring of an exited thread, or a new one
+static UTL_PROF_RING_STRUCT *takeProfRing(MINT32 *slot)
+{
+    MINT32 num = UTL_MIN(__atomic_load_n(&g_prof_num_rings, __ATOMIC_ACQUIRE), UTL_PROF_MAX_THREADS);
+    UTL_PROF_RING_STRUCT *ring;
+
+    for (MINT32 i = 0; i < num; i++)
+    {
+        MINT32 free_state = UTL_PROF_RING_FREE;
+        ring = __atomic_load_n(&g_prof_rings[i], __ATOMIC_ACQUIRE);
+        if (ring && __atomic_compare_exchange_n(&ring->state, &free_state, UTL_PROF_RING_LIVE, false,
+                                                __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        {
+            // no zones since utilProfStart, the ones before are not exported
+            __atomic_store_n(&ring->start, __atomic_load_n(&ring->head, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+            memset(ring->thread_name, 0, sizeof(ring->thread_name));
+            *slot = i;
+            return ring;
+        }
+    }
+
+    *slot = __atomic_fetch_add(&g_prof_num_rings, 1, __ATOMIC_ACQ_REL);
+    if (*slot >= UTL_PROF_MAX_THREADS)
+    {
+        if (*slot == UTL_PROF_MAX_THREADS)
+            LOGE("more than %d threads at once, zones of the others are dropped\n", UTL_PROF_MAX_THREADS);
+        return NULL;
+    }
+    ring = (UTL_PROF_RING_STRUCT *)calloc(1, sizeof(UTL_PROF_RING_STRUCT));
+    if (ring == NULL)
+    {
+        LOGE("%s\n", UTIL_GET_ERRCODE_NAME(UTIL_COMMON_ERR_OUT_OF_MEMORY));
+        return NULL;
+    }
+    ring->state = UTL_PROF_RING_LIVE;
+    __atomic_store_n(&g_prof_rings[*slot], ring, __ATOMIC_RELEASE);
+    return ring;
+}
+
+static UTL_PROF_RING_STRUCT *registerProfThread()
+{
+    UTL_PROF_RING_STRUCT *ring;
+    MINT32 slot;
+
+    t_prof_registered = 1;
+    ring = takeProfRing(&slot);
+    if (ring == NULL)
+        return NULL;
+#if defined(__linux__) || defined(__ANDROID__)
+    ring->tid = (MINT32)syscall(__NR_gettid);
+    prctl(PR_GET_NAME, ring->thread_name, 0, 0, 0);
+#else
+    ring->tid = slot + 1;
+#endif
+    if (ring->thread_name[0] == 0)
+        snprintf(ring->thread_name, sizeof(ring->thread_name), "thread %d", ring->tid);
+
+#ifdef UTL_PROF_THREAD_EXIT
+    pthread_once(&g_prof_key_once, createProfKey);
+    pthread_setspecific(g_prof_key, ring);
+#endif
+    t_prof_ring = ring;
+    return ring;
+}
+
+void utilProfRecord(const char *name, MUINT64 beg, MUINT64 end)
+{
+    UTL_PROF_RING_STRUCT *ring = t_prof_ring;
+    UTL_PROF_ZONE_STRUCT *zone;
+
+    if (ring == NULL)
+    {
+        if (t_prof_registered)
+            return;
+        ring = registerProfThread();
+        if (ring == NULL)
+            return;
+    }
+
+    zone = &ring->zones[ring->head & (UTL_PROF_RING_SIZE - 1)];
+    zone->name = name;
+    zone->beg = beg;
+    zone->end = end;
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+void utilProfStart(void)
+{
+    MINT32 num = UTL_MIN(__atomic_load_n(&g_prof_num_rings, __ATOMIC_ACQUIRE), UTL_PROF_MAX_THREADS);
+
+    __atomic_store_n(&g_util_prof_enabled, 0, __ATOMIC_RELAXED);
+    for (MINT32 i = 0; i < num; i++)
+    {
+        UTL_PROF_RING_STRUCT *ring = __atomic_load_n(&g_prof_rings[i], __ATOMIC_ACQUIRE);
+        MINT32 done = UTL_PROF_RING_DONE;
+        if (ring == NULL)
+            continue;
+        __atomic_store_n(&ring->start, __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE), __ATOMIC_RELAXED);
+        // the zones of exited threads are dropped here, their rings are free
+        __atomic_compare_exchange_n(&ring->state, &done, UTL_PROF_RING_FREE, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+    }
+    g_prof_start_ticks = utilProfTicks();
+    g_prof_start_ns = utilCaptureTime();
+    if (g_prof_calib_ns == 0)
+    {
+        g_prof_calib_ticks = g_prof_start_ticks;
+        g_prof_calib_ns = g_prof_start_ns;
+    }
+    __atomic_store_n(&g_util_prof_enabled, 1, __ATOMIC_RELEASE);
+}
+
+void utilProfStop(void)
+{
+    __atomic_store_n(&g_util_prof_enabled, 0, __ATOMIC_RELEASE);
+}
+
+// nanoseconds per tick of utilProfTicks
+static double profNsPerTick()
+{
+#if defined(__aarch64__)
+    MUINT64 freq;
+    __asm__ __volatile__("mrs %0, cntfrq_el0" : "=r"(freq));
+    return freq ? 1e9 / (double)freq : 1.0;
+#elif (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    // the TSC rate, from the first utilProfStart to now; kept once the
+    // samples are 1 s apart, their read error is then below 1e-7
+    MUINT64 ticks, ns;
+    double ns_per_tick;
+
+    if (g_prof_ns_per_tick > 0)
+        return g_prof_ns_per_tick;
+    ticks = utilProfTicks();
+    ns = utilCaptureTime();
+    if (g_prof_calib_ns == 0 || ticks <= g_prof_calib_ticks)
+        return 1.0;
+    ns_per_tick = (double)(ns - g_prof_calib_ns) / (double)(ticks - g_prof_calib_ticks);
+    if (ns >= g_prof_calib_ns + BILLION)
+        g_prof_ns_per_tick = ns_per_tick;
+    return ns_per_tick;
+#else
+    return 1.0;
+#endif
+}
+
+// the zones of a ring since utilProfStart, oldest first
+static MUINT32 profRingZones(const UTL_PROF_RING_STRUCT *ring, MUINT32 *first)
+{
+    MUINT32 head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    MUINT32 num = head - __atomic_load_n(&ring->start, __ATOMIC_RELAXED);
+
+    if (num > UTL_PROF_RING_SIZE)
+        num = UTL_PROF_RING_SIZE;
+    *first = head - num;
+    return num;
+}
+
+static void writeJsonString(FILE *fp, const char *str)
+{
+    fputc('"', fp);
+    for (; *str; str++)
+    {
+        if (*str == '"' || *str == '\\')
+            fprintf(fp, "\\%c", *str);
+        else if ((unsigned char)*str < 0x20)
+            fprintf(fp, "\\u%04x", (unsigned char)*str);
+        else
+            fputc(*str, fp);
+    }
+    fputc('"', fp);
+}
+
+static void exportChromeJson(FILE *fp, MINT32 pid, double ns_per_tick)
+{
+    MINT32 num_rings = UTL_MIN(__atomic_load_n(&g_prof_num_rings, __ATOMIC_ACQUIRE), UTL_PROF_MAX_THREADS);
+    const char *sep = "";
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    for (MINT32 r = 0; r < num_rings; r++)
+    {
+        const UTL_PROF_RING_STRUCT *ring = __atomic_load_n(&g_prof_rings[r], __ATOMIC_ACQUIRE);
+        MUINT32 first, num;
+
+        if (ring == NULL || __atomic_load_n(&ring->state, __ATOMIC_ACQUIRE) == UTL_PROF_RING_FREE)
+            continue;
+        fprintf(fp, "%s\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+                sep, pid, ring->tid);
+        writeJsonString(fp, ring->thread_name);
+        fprintf(fp, "}}");
+        sep = ",";
+
+        num = profRingZones(ring, &first);
+        for (MUINT32 i = 0; i < num; i++)
+        {
+            const UTL_PROF_ZONE_STRUCT *zone = &ring->zones[(first + i) & (UTL_PROF_RING_SIZE - 1)];
+            double ts = (double)(MINT64)(zone->beg - g_prof_start_ticks) * ns_per_tick;
+            double dur = (double)(zone->end - zone->beg) * ns_per_tick;
+
+            // microseconds, to the nanosecond
+            fprintf(fp, ",\n{\"ph\":\"X\",\"name\":");
+            writeJsonString(fp, zone->name);
+            fprintf(fp, ",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", pid, ring->tid, ts / 1000.0, dur / 1000.0);
+        }
+    }
+    fprintf(fp, "\n]}\n");
+}
+
+/*
+ * Perfetto trace packets, written field by field:
+ *   Trace { repeated TracePacket packet = 1; }
+ *   TracePacket { timestamp = 8; trusted_packet_sequence_id = 10; track_event = 11;
+ *                 timestamp_clock_id = 58; track_descriptor = 60; }
+ *   TrackDescriptor { uuid = 1; thread = 4; }
+ *   ThreadDescriptor { pid = 1; tid = 2; thread_name = 5; }
+ *   TrackEvent { type = 9; track_uuid = 11; name = 23; }
+ */
+#define UTL_PROF_PB_VARINT      (0)
+#define UTL_PROF_PB_BYTES       (2)
+#define UTL_PROF_PB_MAX_NAME    (200)
+#define UTL_PROF_CLOCK_MONOTONIC (3)
+#define UTL_PROF_SEQUENCE_ID    (1)
+#define UTL_PROF_SLICE_BEGIN    (1)
+#define UTL_PROF_SLICE_END      (2)
+
+static MUINT8 *pbVarint(MUINT8 *p, MUINT64 v)
+{
+    while (v >= 0x80)
+    {
+        *p++ = (MUINT8)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (MUINT8)v;
+    return p;
+}
+
+static MUINT8 *pbTag(MUINT8 *p, MUINT32 field, MUINT32 wire_type)
+{
+    return pbVarint(p, (field << 3) | wire_type);
+}
+
+static MUINT8 *pbUint(MUINT8 *p, MUINT32 field, MUINT64 v)
+{
+    return pbVarint(pbTag(p, field, UTL_PROF_PB_VARINT), v);
+}
+
+static MUINT8 *pbBytes(MUINT8 *p, MUINT32 field, const void *data, MUINT32 size)
+{
+    p = pbVarint(pbTag(p, field, UTL_PROF_PB_BYTES), size);
+    memcpy(p, data, size);
+    return p + size;
+}
+
+static MUINT8 *pbString(MUINT8 *p, MUINT32 field, const char *str)
+{
+    return pbBytes(p, field, str, (MUINT32)UTL_MIN(strlen(str), (size_t)UTL_PROF_PB_MAX_NAME));
+}
+
+static void pbWritePacket(FILE *fp, const MUINT8 *packet, MUINT32 size)
+{
+    MUINT8 head[16];
+    MUINT8 *p = pbVarint(pbTag(head, 1, UTL_PROF_PB_BYTES), size);
+    fwrite(head, 1, p - head, fp);
+    fwrite(packet, 1, size, fp);
+}
+
+// ends before begins of the same time, the outer zone begins first and ends last
+static int compareSlices(const void *a, const void *b)
+{
+    const UTL_PROF_SLICE_STRUCT *sa = (const UTL_PROF_SLICE_STRUCT *)a;
+    const UTL_PROF_SLICE_STRUCT *sb = (const UTL_PROF_SLICE_STRUCT *)b;
+
+    if (sa->ts != sb->ts)
+        return sa->ts < sb->ts ? -1 : 1;
+    if (sa->is_end != sb->is_end)
+        return sa->is_end ? -1 : 1;
+    if (sa->dur != sb->dur)
+        return (sa->dur < sb->dur) == (sa->is_end != 0) ? -1 : 1;
+    return 0;
+}
+
+static UTIL_ERRCODE_ENUM exportPerfetto(FILE *fp, MINT32 pid, double ns_per_tick)
+{
+    MINT32 num_rings = UTL_MIN(__atomic_load_n(&g_prof_num_rings, __ATOMIC_ACQUIRE), UTL_PROF_MAX_THREADS);
+    UTL_PROF_SLICE_STRUCT *slices = (UTL_PROF_SLICE_STRUCT *)malloc(2 * UTL_PROF_RING_SIZE * sizeof(UTL_PROF_SLICE_STRUCT));
+    MUINT8 packet[2 * UTL_PROF_PB_MAX_NAME + 64], sub[UTL_PROF_PB_MAX_NAME + 64], desc[UTL_PROF_PB_MAX_NAME + 64];
+
+    if (slices == NULL)
+        return UTIL_COMMON_ERR_OUT_OF_MEMORY;
+
+    for (MINT32 r = 0; r < num_rings; r++)
+    {
+        const UTL_PROF_RING_STRUCT *ring = __atomic_load_n(&g_prof_rings[r], __ATOMIC_ACQUIRE);
+        MUINT64 uuid = (MUINT64)(r + 1);
+        MUINT32 first, num;
+        MUINT8 *p, *q;
+
+        if (ring == NULL || __atomic_load_n(&ring->state, __ATOMIC_ACQUIRE) == UTL_PROF_RING_FREE)
+            continue;
+
+        // the thread track
+        q = pbUint(sub, 1, (MUINT32)pid);
+        q = pbUint(q, 2, (MUINT32)ring->tid);
+        q = pbString(q, 5, ring->thread_name);
+        p = pbUint(desc, 1, uuid);
+        p = pbBytes(p, 4, sub, q - sub);
+        q = pbUint(packet, 10, UTL_PROF_SEQUENCE_ID);
+        q = pbBytes(q, 60, desc, p - desc);
+        pbWritePacket(fp, packet, q - packet);
+
+        num = profRingZones(ring, &first);
+        for (MUINT32 i = 0; i < num; i++)
+        {
+            const UTL_PROF_ZONE_STRUCT *zone = &ring->zones[(first + i) & (UTL_PROF_RING_SIZE - 1)];
+            MUINT64 beg = g_prof_start_ns + (MUINT64)((double)(MINT64)(zone->beg - g_prof_start_ticks) * ns_per_tick);
+            MUINT64 dur = (MUINT64)((double)(zone->end - zone->beg) * ns_per_tick);
+            UTL_PROF_SLICE_STRUCT begin_slice = { beg, dur, zone->name, 0 };
+            UTL_PROF_SLICE_STRUCT end_slice = { beg + dur, dur, zone->name, 1 };
+            slices[2 * i] = begin_slice;
+            slices[2 * i + 1] = end_slice;
+        }
+        qsort(slices, 2 * num, sizeof(UTL_PROF_SLICE_STRUCT), compareSlices);
+
+        for (MUINT32 i = 0; i < 2 * num; i++)
+        {
+            p = pbUint(sub, 9, slices[i].is_end ? UTL_PROF_SLICE_END : UTL_PROF_SLICE_BEGIN);
+            p = pbUint(p, 11, uuid);
+            if (!slices[i].is_end)
+                p = pbString(p, 23, slices[i].name);
+            q = pbUint(packet, 8, slices[i].ts);
+            q = pbUint(q, 10, UTL_PROF_SEQUENCE_ID);
+            q = pbBytes(q, 11, sub, p - sub);
+            q = pbUint(q, 58, UTL_PROF_CLOCK_MONOTONIC);
+            pbWritePacket(fp, packet, q - packet);
+        }
+    }
+
+    free(slices);
+    return UTIL_OK;
+}
+
+UTIL_ERRCODE_ENUM utilProfExport(const char *path, UTIL_PROF_FORMAT_ENUM format)
+{
+    UTIL_ERRCODE_ENUM result = UTIL_OK;
+    MINT32 pid = 0;
+    FILE *fp;
+
+    if (path == NULL || (format != UTIL_PROF_CHROME_JSON && format != UTIL_PROF_PERFETTO_PROTO))
+    {
+        result = UTIL_COMMON_ERR_INVALID_PARAMETER;
+        LOGE("%s\n", UTIL_GET_ERRCODE_NAME(result));
+        return result;
+    }
+    fp = fopen(path, format == UTIL_PROF_CHROME_JSON ? "w" : "wb");
+    if (fp == NULL)
+    {
+        result = UTIL_COMMON_ERR_INVALID_PARAMETER;
+        LOGE("cannot open %s\n", path);
+        return result;
+    }
+
+#if defined(__linux__) || defined(__ANDROID__)
+    pid = (MINT32)getpid();
+#endif
+    if (format == UTIL_PROF_CHROME_JSON)
+        exportChromeJson(fp, pid, profNsPerTick());
+    else
+        result = exportPerfetto(fp, pid, profNsPerTick());
+
+    fclose(fp);
+    if (result != UTIL_OK)
+        LOGE("%s\n", UTIL_GET_ERRCODE_NAME(result));
+    return result;
+}
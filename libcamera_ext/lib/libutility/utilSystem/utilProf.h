@@ -33,6 +33,116 @@ void utilStartCapture(utilPerf *perf);
 void utilStopCapture(utilPerf *perf);
 void utilPrintPerf(utilPerf *perf, const char *name = "");
 
+/*
+ * Zone profiler
+ *
+ * UTIL_PROF_ZONE("name") records the time from the macro to the end of the
+ * scope into a ring of the calling thread, while the profiler is started.
+ * Each thread writes only its own ring, so recording takes no lock. The
+ * name must be a string that outlives the export, as a literal does.
+ * The ring of an exited thread is kept for the export until the next
+ * utilProfStart, then reused by a new thread.
+ * Build with UTIL_PROF_DISABLE to compile the zones out.
+ */
+
+#define UTL_PROF_RING_SIZE      (1 << 14)   ///< zones kept per thread, the oldest are overwritten
+#define UTL_PROF_MAX_THREADS    (64)        ///< threads that can record zones in a run
+
+typedef enum UTIL_PROF_FORMAT_ENUM
+{
+    UTIL_PROF_CHROME_JSON,      ///< trace event JSON for chrome://tracing and the Perfetto UI
+    UTIL_PROF_PERFETTO_PROTO,   ///< Perfetto trace packets with a track per thread
+} UTIL_PROF_FORMAT_ENUM;
+
+/// nonzero while the profiler is started
+extern MINT32 g_util_prof_enabled;
+
+/**
+ *  \details timestamp of the profiler, in ticks of the cheapest monotonic counter
+ *  \fn MUINT64 utilProfTicks(void)
+ *  \return ticks, converted to nanoseconds on export
+ */
+static inline MUINT64 utilProfTicks(void)
+{
+#if defined(__aarch64__)
+    MUINT64 t;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(t));
+    return t;
+#elif (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    return __builtin_ia32_rdtsc();
+#elif defined(__linux__) || defined(__ANDROID__) || defined(__QNX__) || defined(__APPLE__) || defined(__CYGWIN__)
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (MUINT64)t.tv_sec * 1000000000 + t.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+/**
+ *  \details clear the rings and start recording
+ *  \fn void utilProfStart(void)
+ */
+void utilProfStart(void);
+
+/**
+ *  \details stop recording, the recorded zones are kept for utilProfExport
+ *  \fn void utilProfStop(void)
+ */
+void utilProfStop(void);
+
+/**
+ *  \details record a zone of the calling thread
+ *  \fn void utilProfRecord(const char *name, MUINT64 beg, MUINT64 end)
+ *  \param[in] name zone name
+ *  \param[in] beg utilProfTicks at the start of the zone
+ *  \param[in] end utilProfTicks at the end of the zone
+ */
+void utilProfRecord(const char *name, MUINT64 beg, MUINT64 end);
+
+/**
+ *  \details write the zones recorded since utilProfStart
+ *  \fn UTIL_ERRCODE_ENUM utilProfExport(const char *path, UTIL_PROF_FORMAT_ENUM format)
+ *  \param[in] path output file
+ *  \param[in] format output format
+ *  \return utility error code enumerator
+ *
+ *  Zones still being recorded may be missing or, if their ring wraps
+ *  during the export, torn; export after utilProfStop for a clean trace.
+ */
+UTIL_ERRCODE_ENUM utilProfExport(const char *path, UTIL_PROF_FORMAT_ENUM format);
+
+class utilProfZone
+{
+public:
+    utilProfZone(const char *zone_name)
+    {
+        name = __atomic_load_n(&g_util_prof_enabled, __ATOMIC_RELAXED) ? zone_name : NULL;
+        beg = name ? utilProfTicks() : 0;
+    }
+    ~utilProfZone()
+    {
+        if (name)
+            utilProfRecord(name, beg, utilProfTicks());
+    }
+
+private:
+    utilProfZone(const utilProfZone &);
+    utilProfZone &operator=(const utilProfZone &);
+
+    const char *name;
+    MUINT64 beg;
+};
+
+#define UTIL_PROF_CAT2(a, b)    a##b
+#define UTIL_PROF_CAT(a, b)     UTIL_PROF_CAT2(a, b)
+#ifdef UTIL_PROF_DISABLE
+#define UTIL_PROF_ZONE(name)
+#else
+#define UTIL_PROF_ZONE(name)    utilProfZone UTIL_PROF_CAT(util_prof_zone_, __LINE__)(name)
+#endif
+#define UTIL_PROF_FUNC()        UTIL_PROF_ZONE(__FUNCTION__)
+
 
 #endif /* _UTIL_PROF_H_ */
 
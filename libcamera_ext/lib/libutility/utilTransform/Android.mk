@@ -56,6 +56,7 @@ LOCAL_SRC_FILES += \
     utilResize.cpp \
     utilRotate.cpp \
     utilColorTransform.cpp \
+    utilColorConvert.cpp \
 
 LOCAL_C_INCLUDES += \
     $(LOCAL_PATH)/.. \
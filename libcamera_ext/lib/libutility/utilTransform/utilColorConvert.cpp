@@ -0,0 +1,1115 @@
+#define LOG_TAG "utilColorConvert"
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#if defined(__ANDROID__) || defined(ANDROID)
+#include <android/log.h>
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+#else // WIN32 or LINUX64
+#define LOGD printf
+#endif
+#include "utilColorConvert.h"
+#include "utilSystem/utilProf.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define COLOR_NEON
+#include <arm_neon.h>
+#if !defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#elif (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+// the SSE4.1 kernels are built for SSE4.1 and only called if the CPU has it
+#define COLOR_SSE41
+#define COLOR_SSE41_TARGET __attribute__((target("sse4.1")))
+#include <smmintrin.h>
+#endif
+
+/*
+ * Fixed-point matrices, all coefficients in Q8
+ *
+ * RGB -> YUV
+ *   Y = y_offset + ((y[0]*R + y[1]*G + y[2]*B + 128) >> 8)
+ *   U = 128 + ((u[0]*sR + u[1]*sG + u[2]*sB + 512) >> 10)
+ *   V = 128 + ((v[0]*sR + v[1]*sG + v[2]*sB + 512) >> 10)
+ *   where sR, sG and sB are the sums of the 2x2 pixels of a chroma sample
+ *
+ * YUV -> RGB, with Y' = Y - y_offset, U' = U - 128 and V' = V - 128
+ *   R = (yc*Y' + rv*V' + 128) >> 8
+ *   G = (yc*Y' + gu*U' + gv*V' + 128) >> 8
+ *   B = (yc*Y' + bu*U' + 128) >> 8
+ *
+ * All the values and products fit in 16-bit inputs and 32-bit sums, so the
+ * SIMD kernels compute exactly the same as the C kernels.
+ * The BT.601 limited range matrix is the one of utilColorTransform.
+ */
+typedef struct UTL_COLOR_COEF_STRUCT
+{
+    MINT16 y[3];
+    MINT16 u[3];
+    MINT16 v[3];
+    MINT16 y_offset;
+
+    MINT16 yc;
+    MINT16 rv;
+    MINT16 gu;
+    MINT16 gv;
+    MINT16 bu;
+} UTL_COLOR_COEF_STRUCT;
+
+static const UTL_COLOR_COEF_STRUCT g_color_coef[UTIL_COLOR_MATRIX_NUM] =
+{
+    // UTIL_COLOR_BT601_LIMITED
+    { { 66, 129,  25}, {-38, -74, 112}, {112, -94, -18}, 16, 298, 409, -100, -208, 516 },
+    // UTIL_COLOR_BT601_FULL
+    { { 77, 150,  29}, {-43, -85, 128}, {128, -107, -21}, 0, 256, 359,  -88, -183, 454 },
+    // UTIL_COLOR_BT709_LIMITED
+    { { 47, 157,  16}, {-26, -87, 112}, {112, -102, -10}, 16, 298, 459,  -55, -136, 541 },
+    // UTIL_COLOR_BT709_FULL
+    { { 54, 183,  19}, {-29, -99, 128}, {128, -116, -12}, 0, 256, 403,  -48, -120, 475 },
+};
+
+static inline MUINT8 clip8(MINT32 x)
+{
+    return (MUINT8)((x > 255) ? 255 : ((x < 0) ? 0 : x));
+}
+
+/*
+ * Row kernels
+ *
+ * Chroma is addressed by a pointer to U, a pointer to V and a step, so the
+ * same kernel serves planar I420 (step 1) and interleaved NV21 (step 2,
+ * V at even bytes).
+ */
+typedef struct UTL_COLOR_KERNEL_STRUCT
+{
+    // one row of RGB(A) -> Y
+    void (*rgbToY)(const MUINT8 *src, MUINT8 *dst_y, MINT32 width, MINT32 bpp, const UTL_COLOR_COEF_STRUCT *coef);
+    // two rows of RGB(A) -> one row of U and V
+    void (*rgbToUV)(const MUINT8 *src0, const MUINT8 *src1, MUINT8 *dst_u, MUINT8 *dst_v, MINT32 uv_step,
+                    MINT32 width, MINT32 bpp, const UTL_COLOR_COEF_STRUCT *coef);
+    // one row of Y and its row of U and V -> one row of RGB(A)
+    void (*yuvToRgb)(const MUINT8 *src_y, const MUINT8 *src_u, const MUINT8 *src_v, MINT32 uv_step,
+                     MUINT8 *dst, MINT32 width, MINT32 bpp, const UTL_COLOR_COEF_STRUCT *coef);
+    // two rows of YUYV -> two rows of Y and one row of U and V
+    void (*yuyvToI420)(const MUINT8 *src0, const MUINT8 *src1, MUINT8 *dst_y0, MUINT8 *dst_y1,
+                       MUINT8 *dst_u, MUINT8 *dst_v, MINT32 width);
+    // one row of Y and U/V interpolated from the nearest and the next chroma rows -> one row of YUYV
+    void (*i420ToYuyv)(const MUINT8 *src_y, const MUINT8 *src_u0, const MUINT8 *src_u1,
+                       const MUINT8 *src_v0, const MUINT8 *src_v1, MUINT8 *dst, MINT32 width);
+    // interleaved VU -> U and V, and back
+    void (*splitVU)(const MUINT8 *src_vu, MUINT8 *dst_u, MUINT8 *dst_v, MINT32 num);
+    void (*mergeVU)(const MUINT8 *src_u, const MUINT8 *src_v, MUINT8 *dst_vu, MINT32 num);
+} UTL_COLOR_KERNEL_STRUCT;
+
+static void rgbToYRowC(const MUINT8 *src, MUINT8 *dst_y, MINT32 width, MINT32 bpp, const UTL_COLOR_COEF_STRUCT *coef)
+{
+    for (MINT32 x = 0; x < width; x++)
+    {
+        MINT32 sum = coef->y[0] * src[0] + coef->y[1] * src[1] + coef->y[2] * src[2];
+        dst_y[x] = clip8(coef->y_offset + ((sum + 128) >> 8));
+        src += bpp;
+    }
+}
+
+static void rgbToUVRowC(const MUINT8 *src0, const MUINT8 *src1, MUINT8 *dst_u, MUINT8 *dst_v, MINT32 uv_step,
+                        MINT32 width, MINT32 bpp, const UTL_COLOR_COEF_STRUCT *coef)
+{
+    for (MINT32 x = 0; x < width; x += 2)
+    {
+        MINT32 r = src0[0] + src0[bpp + 0] + src1[0] + src1[bpp + 0];
+        MINT32 g = src0[1] + src0[bpp + 1] + src1[1] + src1[bpp + 1];
+        MINT32 b = src0[2] + src0[bpp + 2] + src1[2] + src1[bpp + 2];
+        *dst_u = clip8(128 + ((coef->u[0] * r + coef->u[1] * g + coef->u[2] * b + 512) >> 10));
+        *dst_v = clip8(128 + ((coef->v[0] * r + coef->v[1] * g + coef->v[2] * b + 512) >> 10));
+        dst_u += uv_step;
+        dst_v += uv_step;
+        src0 += bpp * 2;
+        src1 += bpp * 2;
+    }
+}
+
+static void yuvToRgbRowC(const MUINT8 *src_y, const MUINT8 *src_u, const MUINT8 *src_v, MINT32 uv_step,
+                         MUINT8 *dst, MINT32 width, MINT32 bpp, const UTL_COLOR_COEF_STRUCT *coef)
+{
+    for (MINT32 x = 0; x < width; x += 2)
+    {
+        MINT32 u = *src_u - 128;
+        MINT32 v = *src_v - 128;
+        MINT32 r = coef->rv * v + 128;
+        MINT32 g = coef->gu * u + coef->gv * v + 128;
+        MINT32 b = coef->bu * u + 128;
+        for (MINT32 i = 0; i < 2; i++)
+        {
+            MINT32 y = coef->yc * (src_y[x + i] - coef->y_offset);
+            dst[0] = clip8((y + r) >> 8);
+            dst[1] = clip8((y + g) >> 8);
+            dst[2] = clip8((y + b) >> 8);
+            if (bpp == 4)
+                dst[3] = 0xFF;
+            dst += bpp;
+        }
+        src_u += uv_step;
+        src_v += uv_step;
+    }
+}
+
+static void yuyvToI420RowC(const MUINT8 *src0, const MUINT8 *src1, MUINT8 *dst_y0, MUINT8 *dst_y1,
+                           MUINT8 *dst_u, MUINT8 *dst_v, MINT32 width)
+{
+    for (MINT32 x = 0; x < width; x += 2)
+    {
+        dst_y0[x + 0] = src0[0];
+        dst_y0[x + 1] = src0[2];
+        dst_y1[x + 0] = src1[0];
+        dst_y1[x + 1] = src1[2];
+        dst_u[x >> 1] = (src0[1] + src1[1] + 1) >> 1;
+        dst_v[x >> 1] = (src0[3] + src1[3] + 1) >> 1;
+        src0 += 4;
+        src1 += 4;
+    }
+}
+
+static void i420ToYuyvRowC(const MUINT8 *src_y, const MUINT8 *src_u0, const MUINT8 *src_u1,
+                           const MUINT8 *src_v0, const MUINT8 *src_v1, MUINT8 *dst, MINT32 width)
+{
+    for (MINT32 x = 0; x < width; x += 2)
+    {
+        MINT32 c = x >> 1;
+        dst[0] = src_y[x + 0];
+        dst[1] = (src_u0[c] * 3 + src_u1[c] + 2) >> 2;
+        dst[2] = src_y[x + 1];
+        dst[3] = (src_v0[c] * 3 + src_v1[c] + 2) >> 2;
+        dst += 4;
+    }
+}
+
+static void splitVURowC(const MUINT8 *src_vu, MUINT8 *dst_u, MUINT8 *dst_v, MINT32 num)
+{
+    for (MINT32 i = 0; i < num; i++)
+    {
+        dst_v[i] = src_vu[2 * i + 0];
+        dst_u[i] = src_vu[2 * i + 1];
+    }
+}
+
+static void mergeVURowC(const MUINT8 *src_u, const MUINT8 *src_v, MUINT8 *dst_vu, MINT32 num)
+{
+    for (MINT32 i = 0; i < num; i++)
+    {
+        dst_vu[2 * i + 0] = src_v[i];
+        dst_vu[2 * i + 1] = src_u[i];
+    }
+}
+
+static const UTL_COLOR_KERNEL_STRUCT g_color_kernel_c =
+{
+    rgbToYRowC,
+    rgbToUVRowC,
+    yuvToRgbRowC,
+    yuyvToI420RowC,
+    i420ToYuyvRowC,
+    splitVURowC,
+    mergeVURowC,
+};
+
+#ifdef COLOR_NEON
+/*
+ * NEON kernels, 16 pixels per iteration; the rest of a row goes to the C kernels
+ */
+static void rgbToYRowNeon(const MUINT8 *src, MUINT8 *dst_y, MINT32 width, MINT32 bpp, const UTL_COLOR_COEF_STRUCT *coef)
+{
+    MINT32 width16 = width & ~15;
+    int16x8_t v_offset = vdupq_n_s16(coef->y_offset);
+    for (MINT32 x = 0; x < width16; x += 16)
+    {
+        // read rgb data
+        uint8x16_t v_r, v_g, v_b;
+        if (bpp == 4)
+        {
+            uint8x16x4_t v_rgba = vld4q_u8(src);
+            v_r = v_rgba.val[0];
+            v_g = v_rgba.val[1];
+            v_b = v_rgba.val[2];
+        }
+        else
+        {
+            uint8x16x3_t v_rgb = vld3q_u8(src);
+            v_r = v_rgb.val[0];
+            v_g = v_rgb.val[1];
+            v_b = v_rgb.val[2];
+        }
+
+        for (MINT32 half = 0; half < 2; half++)
+        {
+            int16x8_t v_r16 = vreinterpretq_s16_u16(vmovl_u8(half ? vget_high_u8(v_r) : vget_low_u8(v_r)));
+            int16x8_t v_g16 = vreinterpretq_s16_u16(vmovl_u8(half ? vget_high_u8(v_g) : vget_low_u8(v_g)));
+            int16x8_t v_b16 = vreinterpretq_s16_u16(vmovl_u8(half ? vget_high_u8(v_b) : vget_low_u8(v_b)));
+
+            // color conversion
+            int32x4_t v_lo = vmull_n_s16(vget_low_s16(v_r16), coef->y[0]);
+            int32x4_t v_hi = vmull_n_s16(vget_high_s16(v_r16), coef->y[0]);
+            v_lo = vmlal_n_s16(v_lo, vget_low_s16(v_g16), coef->y[1]);
+            v_hi = vmlal_n_s16(v_hi, vget_high_s16(v_g16), coef->y[1]);
+            v_lo = vmlal_n_s16(v_lo, vget_low_s16(v_b16), coef->y[2]);
+            v_hi = vmlal_n_s16(v_hi, vget_high_s16(v_b16), coef->y[2]);
+            int16x8_t v_y = vcombine_s16(vmovn_s32(vrshrq_n_s32(v_lo, 8)), vmovn_s32(vrshrq_n_s32(v_hi, 8)));
+            vst1_u8(dst_y + x + half * 8, vqmovun_s16(vaddq_s16(v_y, v_offset)));
+        }
+        src += 16 * bpp;
+    }
+    rgbToYRowC(src, dst_y + width16, width - width16, bpp, coef);
+}
+
+static inline uint8x8_t rgbSumToChromaNeon(uint16x8_t v_r, uint16x8_t v_g, uint16x8_t v_b, const MINT16 *c)
+{
+    int16x8_t v_r16 = vreinterpretq_s16_u16(v_r);
+    int16x8_t v_g16 = vreinterpretq_s16_u16(v_g);
+    int16x8_t v_b16 = vreinterpretq_s16_u16(v_b);
+    int32x4_t v_lo = vmull_n_s16(vget_low_s16(v_r16), c[0]);
+    int32x4_t v_hi = vmull_n_s16(vget_high_s16(v_r16), c[0]);
+    v_lo = vmlal_n_s16(v_lo, vget_low_s16(v_g16), c[1]);
+    v_hi = vmlal_n_s16(v_hi, vget_high_s16(v_g16), c[1]);
+    v_lo = vmlal_n_s16(v_lo, vget_low_s16(v_b16), c[2]);
+    v_hi = vmlal_n_s16(v_hi, vget_high_s16(v_b16), c[2]);
+    int16x8_t v_c = vcombine_s16(vmovn_s32(vrshrq_n_s32(v_lo, 10)), vmovn_s32(vrshrq_n_s32(v_hi, 10)));
+    return vqmovun_s16(vaddq_s16(v_c, vdupq_n_s16(128)));
+}
+
+static inline void storeChromaNeon(MUINT8 *dst_u, MUINT8 *dst_v, MINT32 uv_step, uint8x8_t v_u, uint8x8_t v_v)
+{
+    if (uv_step == 1)
+    {
+        vst1_u8(dst_u, v_u);
+        vst1_u8(dst_v, v_v);
+    }
+    else if (dst_v < dst_u)
+    {
+        uint8x8x2_t v_vu = { { v_v, v_u } };
+        vst2_u8(dst_v, v_vu);
+    }
+    else
+    {
+        uint8x8x2_t v_uv = { { v_u, v_v } };
+        vst2_u8(dst_u, v_uv);
+    }
+}
+
+static void rgbToUVRowNeon(const MUINT8 *src0, const MUINT8 *src1, MUINT8 *dst_u, MUINT8 *dst_v, MINT32 uv_step,
+                           MINT32 width, MINT32 bpp, const UTL_COLOR_COEF_STRUCT *coef)
+{
+    MINT32 width16 = width & ~15;
+    for (MINT32 x = 0; x < width16; x += 16)
+    {
+        // sum of 2x2 pixels
+        uint16x8_t v_r, v_g, v_b;
+        if (bpp == 4)
+        {
+            uint8x16x4_t v_rgba0 = vld4q_u8(src0);
+            uint8x16x4_t v_rgba1 = vld4q_u8(src1);
+            v_r = vpadalq_u8(vpaddlq_u8(v_rgba0.val[0]), v_rgba1.val[0]);
+            v_g = vpadalq_u8(vpaddlq_u8(v_rgba0.val[1]), v_rgba1.val[1]);
+            v_b = vpadalq_u8(vpaddlq_u8(v_rgba0.val[2]), v_rgba1.val[2]);
+        }
+        else
+        {
+            uint8x16x3_t v_rgb0 = vld3q_u8(src0);
+            uint8x16x3_t v_rgb1 = vld3q_u8(src1);
+            v_r = vpadalq_u8(vpaddlq_u8(v_rgb0.val[0]), v_rgb1.val[0]);
+            v_g = vpadalq_u8(vpaddlq_u8(v_rgb0.val[1]), v_rgb1.val[1]);
+            v_b = vpadalq_u8(vpaddlq_u8(v_rgb0.val[2]), v_rgb1.val[2]);
+        }
+
+        // color conversion
+        uint8x8_t v_u = rgbSumToChromaNeon(v_r, v_g, v_b, coef->u);
+        uint8x8_t v_v = rgbSumToChromaNeon(v_r, v_g, v_b, coef->v);
+        storeChromaNeon(dst_u, dst_v, uv_step, v_u, v_v);
+
+        src0 += 16 * bpp;
+        src1 += 16 * bpp;
+        dst_u += 8 * uv_step;
+        dst_v += 8 * uv_step;
+    }
+    rgbToUVRowC(src0, src1, dst_u, dst_v, uv_step, width - width16, bpp, coef);
+}
+
+static inline uint8x8_t yuvToChannelNeon(int32x4_t v_y_lo, int32x4_t v_y_hi, int32x4_t v_c_lo, int32x4_t v_c_hi)
+{
+    int16x8_t v_c = vcombine_s16(vmovn_s32(vrshrq_n_s32(vaddq_s32(v_y_lo, v_c_lo), 8)),
+                                 vmovn_s32(vrshrq_n_s32(vaddq_s32(v_y_hi, v_c_hi), 8)));
+    return vqmovun_s16(v_c);
+}
+
+static void yuvToRgbRowNeon(const MUINT8 *src_y, const MUINT8 *src_u, const MUINT8 *src_v, MINT32 uv_step,
+                            MUINT8 *dst, MINT32 width, MINT32 bpp, const UTL_COLOR_COEF_STRUCT *coef)
+{
+    MINT32 width16 = width & ~15;
+    int16x8_t v_y_offset = vdupq_n_s16(coef->y_offset);
+    int16x8_t v_s128 = vdupq_n_s16(128);
+    uint8x8_t v_a = vdup_n_u8(0xFF);
+    for (MINT32 x = 0; x < width16; x += 16)
+    {
+        // read yuv data
+        uint8x16_t v_src_y = vld1q_u8(src_y + x);
+        uint8x8_t v_src_u, v_src_v;
+        if (uv_step == 1)
+        {
+            v_src_u = vld1_u8(src_u);
+            v_src_v = vld1_u8(src_v);
+        }
+        else if (src_v < src_u)
+        {
+            uint8x8x2_t v_vu = vld2_u8(src_v);
+            v_src_v = v_vu.val[0];
+            v_src_u = v_vu.val[1];
+        }
+        else
+        {
+            uint8x8x2_t v_uv = vld2_u8(src_u);
+            v_src_u = v_uv.val[0];
+            v_src_v = v_uv.val[1];
+        }
+
+        // a chroma sample for 2 pixels
+        uint8x8x2_t v_dup_u = vzip_u8(v_src_u, v_src_u);
+        uint8x8x2_t v_dup_v = vzip_u8(v_src_v, v_src_v);
+
+        for (MINT32 half = 0; half < 2; half++)
+        {
+            int16x8_t v_y = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(half ? vget_high_u8(v_src_y) : vget_low_u8(v_src_y))), v_y_offset);
+            int16x8_t v_u = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(v_dup_u.val[half])), v_s128);
+            int16x8_t v_v = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(v_dup_v.val[half])), v_s128);
+
+            int32x4_t v_y_lo = vmull_n_s16(vget_low_s16(v_y), coef->yc);
+            int32x4_t v_y_hi = vmull_n_s16(vget_high_s16(v_y), coef->yc);
+
+            // color conversion
+            uint8x8_t v_r = yuvToChannelNeon(v_y_lo, v_y_hi,
+                vmull_n_s16(vget_low_s16(v_v), coef->rv), vmull_n_s16(vget_high_s16(v_v), coef->rv));
+            uint8x8_t v_g = yuvToChannelNeon(v_y_lo, v_y_hi,
+                vmlal_n_s16(vmull_n_s16(vget_low_s16(v_u), coef->gu), vget_low_s16(v_v), coef->gv),
+                vmlal_n_s16(vmull_n_s16(vget_high_s16(v_u), coef->gu), vget_high_s16(v_v), coef->gv));
+            uint8x8_t v_b = yuvToChannelNeon(v_y_lo, v_y_hi,
+                vmull_n_s16(vget_low_s16(v_u), coef->bu), vmull_n_s16(vget_high_s16(v_u), coef->bu));
+
+            // store rgb data
+            if (bpp == 4)
+            {
+                uint8x8x4_t v_rgba = { { v_r, v_g, v_b, v_a } };
+                vst4_u8(dst, v_rgba);
+            }
+            else
+            {
+                uint8x8x3_t v_rgb = { { v_r, v_g, v_b } };
+                vst3_u8(dst, v_rgb);
+            }
+            dst += 8 * bpp;
+        }
+        src_u += 8 * uv_step;
+        src_v += 8 * uv_step;
+    }
+    yuvToRgbRowC(src_y + width16, src_u, src_v, uv_step, dst, width - width16, bpp, coef);
+}
+
+static void yuyvToI420RowNeon(const MUINT8 *src0, const MUINT8 *src1, MUINT8 *dst_y0, MUINT8 *dst_y1,
+                              MUINT8 *dst_u, MUINT8 *dst_v, MINT32 width)
+{
+    MINT32 width16 = width & ~15;
+    for (MINT32 x = 0; x < width16; x += 16)
+    {
+        // [0]: even Y, [1]: U, [2]: odd Y, [3]: V
+        uint8x8x4_t v_yuyv0 = vld4_u8(src0 + x * 2);
+        uint8x8x4_t v_yuyv1 = vld4_u8(src1 + x * 2);
+        uint8x8x2_t v_y0 = { { v_yuyv0.val[0], v_yuyv0.val[2] } };
+        uint8x8x2_t v_y1 = { { v_yuyv1.val[0], v_yuyv1.val[2] } };
+        vst2_u8(dst_y0 + x, v_y0);
+        vst2_u8(dst_y1 + x, v_y1);
+        vst1_u8(dst_u + (x >> 1), vrhadd_u8(v_yuyv0.val[1], v_yuyv1.val[1]));
+        vst1_u8(dst_v + (x >> 1), vrhadd_u8(v_yuyv0.val[3], v_yuyv1.val[3]));
+    }
+    yuyvToI420RowC(src0 + width16 * 2, src1 + width16 * 2, dst_y0 + width16, dst_y1 + width16,
+                   dst_u + (width16 >> 1), dst_v + (width16 >> 1), width - width16);
+}
+
+static void i420ToYuyvRowNeon(const MUINT8 *src_y, const MUINT8 *src_u0, const MUINT8 *src_u1,
+                              const MUINT8 *src_v0, const MUINT8 *src_v1, MUINT8 *dst, MINT32 width)
+{
+    MINT32 width16 = width & ~15;
+    uint8x8_t v_3 = vdup_n_u8(3);
+    for (MINT32 x = 0; x < width16; x += 16)
+    {
+        MINT32 c = x >> 1;
+        uint8x8x2_t v_y = vld2_u8(src_y + x);
+
+        // filter U & V: (3 * near + far + 2) >> 2
+        uint8x8_t v_u = vrshrn_n_u16(vmlal_u8(vmovl_u8(vld1_u8(src_u1 + c)), vld1_u8(src_u0 + c), v_3), 2);
+        uint8x8_t v_v = vrshrn_n_u16(vmlal_u8(vmovl_u8(vld1_u8(src_v1 + c)), vld1_u8(src_v0 + c), v_3), 2);
+
+        uint8x8x4_t v_yuyv = { { v_y.val[0], v_u, v_y.val[1], v_v } };
+        vst4_u8(dst + x * 2, v_yuyv);
+    }
+    MINT32 c16 = width16 >> 1;
+    i420ToYuyvRowC(src_y + width16, src_u0 + c16, src_u1 + c16, src_v0 + c16, src_v1 + c16,
+                   dst + width16 * 2, width - width16);
+}
+
+static void splitVURowNeon(const MUINT8 *src_vu, MUINT8 *dst_u, MUINT8 *dst_v, MINT32 num)
+{
+    MINT32 num16 = num & ~15;
+    for (MINT32 i = 0; i < num16; i += 16)
+    {
+        uint8x16x2_t v_vu = vld2q_u8(src_vu + i * 2);
+        vst1q_u8(dst_v + i, v_vu.val[0]);
+        vst1q_u8(dst_u + i, v_vu.val[1]);
+    }
+    splitVURowC(src_vu + num16 * 2, dst_u + num16, dst_v + num16, num - num16);
+}
+
+static void mergeVURowNeon(const MUINT8 *src_u, const MUINT8 *src_v, MUINT8 *dst_vu, MINT32 num)
+{
+    MINT32 num16 = num & ~15;
+    for (MINT32 i = 0; i < num16; i += 16)
+    {
+        uint8x16x2_t v_vu = { { vld1q_u8(src_v + i), vld1q_u8(src_u + i) } };
+        vst2q_u8(dst_vu + i * 2, v_vu);
+    }
+    mergeVURowC(src_u + num16, src_v + num16, dst_vu + num16 * 2, num - num16);
+}
+
+static const UTL_COLOR_KERNEL_STRUCT g_color_kernel_neon =
+{
+    rgbToYRowNeon,
+    rgbToUVRowNeon,
+    yuvToRgbRowNeon,
+    yuyvToI420RowNeon,
+    i420ToYuyvRowNeon,
+    splitVURowNeon,
+    mergeVURowNeon,
+};
+#endif /* COLOR_NEON */
+
+#ifdef COLOR_SSE41
+/*
+ * SSE4.1 kernels, 16 pixels per iteration; the rest of a row goes to the C kernels.
+ * Pixels are handled as RGBx in 16-bit lanes, where _mm_madd_epi16 with
+ * {c0, c1, c2, 0} and _mm_hadd_epi32 give the dot product of each pixel.
+ */
+
+// loadRgbx16() loads 16 pixels as 4 registers of 4 RGBx pixels
+static COLOR_SSE41_TARGET inline void loadRgbx16(const MUINT8 *src, MINT32 bpp, __m128i v_px[4])
+{
+    if (bpp == 4)
+    {
+        v_px[0] = _mm_loadu_si128((const __m128i *)(src + 0));
+        v_px[1] = _mm_loadu_si128((const __m128i *)(src + 16));
+        v_px[2] = _mm_loadu_si128((const __m128i *)(src + 32));
+        v_px[3] = _mm_loadu_si128((const __m128i *)(src + 48));
+    }
+    else
+    {
+        const __m128i v_shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        __m128i v_a = _mm_loadu_si128((const __m128i *)(src + 0));
+        __m128i v_b = _mm_loadu_si128((const __m128i *)(src + 16));
+        __m128i v_c = _mm_loadu_si128((const __m128i *)(src + 32));
+        v_px[0] = _mm_shuffle_epi8(v_a, v_shuffle);
+        v_px[1] = _mm_shuffle_epi8(_mm_alignr_epi8(v_b, v_a, 12), v_shuffle);
+        v_px[2] = _mm_shuffle_epi8(_mm_alignr_epi8(v_c, v_b, 8), v_shuffle);
+        v_px[3] = _mm_shuffle_epi8(_mm_srli_si128(v_c, 4), v_shuffle);
+    }
+}
+
+// dot4() returns the dot products of 4 RGBx pixels in 16-bit lanes (2 per register)
+static COLOR_SSE41_TARGET inline __m128i dot4(__m128i v_px01, __m128i v_px23, __m128i v_coef)
+{
+    return _mm_hadd_epi32(_mm_madd_epi16(v_px01, v_coef), _mm_madd_epi16(v_px23, v_coef));
+}
+
+static COLOR_SSE41_TARGET void rgbToYRowSse41(const MUINT8 *src, MUINT8 *dst_y, MINT32 width, MINT32 bpp,
+                                              const UTL_COLOR_COEF_STRUCT *coef)
+{
+    MINT32 width16 = width & ~15;
+    const __m128i v_coef = _mm_setr_epi16(coef->y[0], coef->y[1], coef->y[2], 0, coef->y[0], coef->y[1], coef->y[2], 0);
+    const __m128i v_round = _mm_set1_epi32(128);
+    const __m128i v_offset = _mm_set1_epi16(coef->y_offset);
+    for (MINT32 x = 0; x < width16; x += 16)
+    {
+        __m128i v_px[4], v_y[4];
+        loadRgbx16(src, bpp, v_px);
+        for (MINT32 i = 0; i < 4; i++)
+        {
+            __m128i v_lo = _mm_cvtepu8_epi16(v_px[i]);
+            __m128i v_hi = _mm_cvtepu8_epi16(_mm_srli_si128(v_px[i], 8));
+            v_y[i] = _mm_srai_epi32(_mm_add_epi32(dot4(v_lo, v_hi, v_coef), v_round), 8);
+        }
+        __m128i v_y16lo = _mm_add_epi16(_mm_packs_epi32(v_y[0], v_y[1]), v_offset);
+        __m128i v_y16hi = _mm_add_epi16(_mm_packs_epi32(v_y[2], v_y[3]), v_offset);
+        _mm_storeu_si128((__m128i *)(dst_y + x), _mm_packus_epi16(v_y16lo, v_y16hi));
+        src += 16 * bpp;
+    }
+    rgbToYRowC(src, dst_y + width16, width - width16, bpp, coef);
+}
+
+// blockSum2() returns the sums of the 2x2 blocks of 4 RGBx pixels of 2 rows, as 2 RGBx in 16-bit lanes
+static COLOR_SSE41_TARGET inline __m128i blockSum2(__m128i v_px0, __m128i v_px1)
+{
+    __m128i v_lo = _mm_add_epi16(_mm_cvtepu8_epi16(v_px0), _mm_cvtepu8_epi16(v_px1));
+    __m128i v_hi = _mm_add_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(v_px0, 8)), _mm_cvtepu8_epi16(_mm_srli_si128(v_px1, 8)));
+    v_lo = _mm_add_epi16(v_lo, _mm_srli_si128(v_lo, 8));
+    v_hi = _mm_add_epi16(v_hi, _mm_srli_si128(v_hi, 8));
+    return _mm_unpacklo_epi64(v_lo, v_hi);
+}
+
+// chroma8() converts 8 block sums to 8 chroma samples in the low 8 bytes
+static COLOR_SSE41_TARGET inline __m128i chroma8(const __m128i v_sum[4], __m128i v_coef)
+{
+    const __m128i v_round = _mm_set1_epi32(512);
+    __m128i v_c0 = _mm_srai_epi32(_mm_add_epi32(dot4(v_sum[0], v_sum[1], v_coef), v_round), 10);
+    __m128i v_c1 = _mm_srai_epi32(_mm_add_epi32(dot4(v_sum[2], v_sum[3], v_coef), v_round), 10);
+    __m128i v_c = _mm_add_epi16(_mm_packs_epi32(v_c0, v_c1), _mm_set1_epi16(128));
+    return _mm_packus_epi16(v_c, v_c);
+}
+
+static COLOR_SSE41_TARGET void rgbToUVRowSse41(const MUINT8 *src0, const MUINT8 *src1, MUINT8 *dst_u, MUINT8 *dst_v,
+                                               MINT32 uv_step, MINT32 width, MINT32 bpp,
+                                               const UTL_COLOR_COEF_STRUCT *coef)
+{
+    MINT32 width16 = width & ~15;
+    const __m128i v_coef_u = _mm_setr_epi16(coef->u[0], coef->u[1], coef->u[2], 0, coef->u[0], coef->u[1], coef->u[2], 0);
+    const __m128i v_coef_v = _mm_setr_epi16(coef->v[0], coef->v[1], coef->v[2], 0, coef->v[0], coef->v[1], coef->v[2], 0);
+    for (MINT32 x = 0; x < width16; x += 16)
+    {
+        __m128i v_px0[4], v_px1[4], v_sum[4];
+        loadRgbx16(src0, bpp, v_px0);
+        loadRgbx16(src1, bpp, v_px1);
+        for (MINT32 i = 0; i < 4; i++)
+            v_sum[i] = blockSum2(v_px0[i], v_px1[i]);
+
+        __m128i v_u = chroma8(v_sum, v_coef_u);
+        __m128i v_v = chroma8(v_sum, v_coef_v);
+        if (uv_step == 1)
+        {
+            _mm_storel_epi64((__m128i *)dst_u, v_u);
+            _mm_storel_epi64((__m128i *)dst_v, v_v);
+        }
+        else if (dst_v < dst_u)
+        {
+            _mm_storeu_si128((__m128i *)dst_v, _mm_unpacklo_epi8(v_v, v_u));
+        }
+        else
+        {
+            _mm_storeu_si128((__m128i *)dst_u, _mm_unpacklo_epi8(v_u, v_v));
+        }
+
+        src0 += 16 * bpp;
+        src1 += 16 * bpp;
+        dst_u += 8 * uv_step;
+        dst_v += 8 * uv_step;
+    }
+    rgbToUVRowC(src0, src1, dst_u, dst_v, uv_step, width - width16, bpp, coef);
+}
+
+// channel8() computes one channel of 8 pixels from the (Y', C) pairs in 16-bit lanes
+static COLOR_SSE41_TARGET inline __m128i channel8(__m128i v_pair_lo, __m128i v_pair_hi, __m128i v_coef, __m128i v_add_lo, __m128i v_add_hi)
+{
+    __m128i v_lo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(v_pair_lo, v_coef), v_add_lo), 8);
+    __m128i v_hi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(v_pair_hi, v_coef), v_add_hi), 8);
+    return _mm_packs_epi32(v_lo, v_hi);
+}
+
+static COLOR_SSE41_TARGET void yuvToRgbRowSse41(const MUINT8 *src_y, const MUINT8 *src_u, const MUINT8 *src_v,
+                                                MINT32 uv_step, MUINT8 *dst, MINT32 width, MINT32 bpp,
+                                                const UTL_COLOR_COEF_STRUCT *coef)
+{
+    MINT32 width16 = width & ~15;
+    const __m128i v_y_offset = _mm_set1_epi16(coef->y_offset);
+    const __m128i v_s128 = _mm_set1_epi16(128);
+    const __m128i v_round = _mm_set1_epi32(128);
+    const __m128i v_coef_r = _mm_setr_epi16(coef->yc, coef->rv, coef->yc, coef->rv, coef->yc, coef->rv, coef->yc, coef->rv);
+    const __m128i v_coef_g = _mm_setr_epi16(coef->yc, coef->gu, coef->yc, coef->gu, coef->yc, coef->gu, coef->yc, coef->gu);
+    const __m128i v_coef_gv = _mm_set1_epi32(coef->gv & 0xFFFF);
+    const __m128i v_coef_b = _mm_setr_epi16(coef->yc, coef->bu, coef->yc, coef->bu, coef->yc, coef->bu, coef->yc, coef->bu);
+    const __m128i v_a = _mm_set1_epi8((char)0xFF);
+    const __m128i v_drop_a = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    for (MINT32 x = 0; x < width16; x += 16)
+    {
+        // read yuv data
+        __m128i v_src_y = _mm_loadu_si128((const __m128i *)(src_y + x));
+        __m128i v_src_u, v_src_v;
+        if (uv_step == 1)
+        {
+            v_src_u = _mm_loadl_epi64((const __m128i *)src_u);
+            v_src_v = _mm_loadl_epi64((const __m128i *)src_v);
+        }
+        else
+        {
+            const __m128i v_mask = _mm_set1_epi16(0x00FF);
+            __m128i v_inter = _mm_loadu_si128((const __m128i *)(src_u < src_v ? src_u : src_v));
+            __m128i v_even = _mm_packus_epi16(_mm_and_si128(v_inter, v_mask), v_inter);
+            __m128i v_odd = _mm_packus_epi16(_mm_srli_epi16(v_inter, 8), v_inter);
+            v_src_u = src_u < src_v ? v_even : v_odd;
+            v_src_v = src_u < src_v ? v_odd : v_even;
+        }
+
+        // a chroma sample for 2 pixels
+        __m128i v_u16 = _mm_sub_epi16(_mm_cvtepu8_epi16(v_src_u), v_s128);
+        __m128i v_v16 = _mm_sub_epi16(_mm_cvtepu8_epi16(v_src_v), v_s128);
+        __m128i v_dup_u[2] = { _mm_unpacklo_epi16(v_u16, v_u16), _mm_unpackhi_epi16(v_u16, v_u16) };
+        __m128i v_dup_v[2] = { _mm_unpacklo_epi16(v_v16, v_v16), _mm_unpackhi_epi16(v_v16, v_v16) };
+
+        for (MINT32 half = 0; half < 2; half++)
+        {
+            __m128i v_y = _mm_sub_epi16(_mm_cvtepu8_epi16(half ? _mm_srli_si128(v_src_y, 8) : v_src_y), v_y_offset);
+            __m128i v_u = v_dup_u[half];
+            __m128i v_v = v_dup_v[half];
+
+            // (Y', U) and (Y', V) pairs
+            __m128i v_yu_lo = _mm_unpacklo_epi16(v_y, v_u);
+            __m128i v_yu_hi = _mm_unpackhi_epi16(v_y, v_u);
+            __m128i v_yv_lo = _mm_unpacklo_epi16(v_y, v_v);
+            __m128i v_yv_hi = _mm_unpackhi_epi16(v_y, v_v);
+
+            // color conversion, the V term of G is added as (V', 0) pairs
+            __m128i v_gv_lo = _mm_add_epi32(_mm_madd_epi16(_mm_cvtepi16_epi32(v_v), v_coef_gv), v_round);
+            __m128i v_gv_hi = _mm_add_epi32(_mm_madd_epi16(_mm_cvtepi16_epi32(_mm_srli_si128(v_v, 8)), v_coef_gv), v_round);
+            __m128i v_r = channel8(v_yv_lo, v_yv_hi, v_coef_r, v_round, v_round);
+            __m128i v_g = channel8(v_yu_lo, v_yu_hi, v_coef_g, v_gv_lo, v_gv_hi);
+            __m128i v_b = channel8(v_yu_lo, v_yu_hi, v_coef_b, v_round, v_round);
+
+            // pack RGBA
+            __m128i v_rg = _mm_unpacklo_epi8(_mm_packus_epi16(v_r, v_r), _mm_packus_epi16(v_g, v_g));
+            __m128i v_ba = _mm_unpacklo_epi8(_mm_packus_epi16(v_b, v_b), v_a);
+            __m128i v_rgba0 = _mm_unpacklo_epi16(v_rg, v_ba);
+            __m128i v_rgba1 = _mm_unpackhi_epi16(v_rg, v_ba);
+
+            // store rgb data
+            if (bpp == 4)
+            {
+                _mm_storeu_si128((__m128i *)(dst + 0), v_rgba0);
+                _mm_storeu_si128((__m128i *)(dst + 16), v_rgba1);
+            }
+            else
+            {
+                __m128i v_rgb0 = _mm_shuffle_epi8(v_rgba0, v_drop_a);
+                __m128i v_rgb1 = _mm_shuffle_epi8(v_rgba1, v_drop_a);
+                _mm_storeu_si128((__m128i *)(dst + 0), _mm_or_si128(v_rgb0, _mm_slli_si128(v_rgb1, 12)));
+                _mm_storel_epi64((__m128i *)(dst + 16), _mm_srli_si128(v_rgb1, 4));
+            }
+            dst += 8 * bpp;
+        }
+        src_u += 8 * uv_step;
+        src_v += 8 * uv_step;
+    }
+    yuvToRgbRowC(src_y + width16, src_u, src_v, uv_step, dst, width - width16, bpp, coef);
+}
+
+static COLOR_SSE41_TARGET void yuyvToI420RowSse41(const MUINT8 *src0, const MUINT8 *src1, MUINT8 *dst_y0,
+                                                  MUINT8 *dst_y1, MUINT8 *dst_u, MUINT8 *dst_v, MINT32 width)
+{
+    MINT32 width16 = width & ~15;
+    const __m128i v_mask = _mm_set1_epi16(0x00FF);
+    for (MINT32 x = 0; x < width16; x += 16)
+    {
+        __m128i v_a0 = _mm_loadu_si128((const __m128i *)(src0 + x * 2));
+        __m128i v_b0 = _mm_loadu_si128((const __m128i *)(src0 + x * 2 + 16));
+        __m128i v_a1 = _mm_loadu_si128((const __m128i *)(src1 + x * 2));
+        __m128i v_b1 = _mm_loadu_si128((const __m128i *)(src1 + x * 2 + 16));
+
+        // Y at even bytes, UV at odd bytes
+        _mm_storeu_si128((__m128i *)(dst_y0 + x), _mm_packus_epi16(_mm_and_si128(v_a0, v_mask), _mm_and_si128(v_b0, v_mask)));
+        _mm_storeu_si128((__m128i *)(dst_y1 + x), _mm_packus_epi16(_mm_and_si128(v_a1, v_mask), _mm_and_si128(v_b1, v_mask)));
+        __m128i v_uv0 = _mm_packus_epi16(_mm_srli_epi16(v_a0, 8), _mm_srli_epi16(v_b0, 8));
+        __m128i v_uv1 = _mm_packus_epi16(_mm_srli_epi16(v_a1, 8), _mm_srli_epi16(v_b1, 8));
+        __m128i v_uv = _mm_avg_epu8(v_uv0, v_uv1);
+
+        _mm_storel_epi64((__m128i *)(dst_u + (x >> 1)), _mm_packus_epi16(_mm_and_si128(v_uv, v_mask), v_uv));
+        _mm_storel_epi64((__m128i *)(dst_v + (x >> 1)), _mm_packus_epi16(_mm_srli_epi16(v_uv, 8), v_uv));
+    }
+    yuyvToI420RowC(src0 + width16 * 2, src1 + width16 * 2, dst_y0 + width16, dst_y1 + width16,
+                   dst_u + (width16 >> 1), dst_v + (width16 >> 1), width - width16);
+}
+
+// filter8() returns (3 * near + far + 2) >> 2 of 8 samples in the low 8 bytes
+static COLOR_SSE41_TARGET inline __m128i filter8(const MUINT8 *near, const MUINT8 *far)
+{
+    __m128i v_near = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *)near));
+    __m128i v_far = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *)far));
+    __m128i v_sum = _mm_add_epi16(_mm_add_epi16(_mm_slli_epi16(v_near, 1), v_near), _mm_add_epi16(v_far, _mm_set1_epi16(2)));
+    __m128i v_c = _mm_srli_epi16(v_sum, 2);
+    return _mm_packus_epi16(v_c, v_c);
+}
+
+static COLOR_SSE41_TARGET void i420ToYuyvRowSse41(const MUINT8 *src_y, const MUINT8 *src_u0, const MUINT8 *src_u1,
+                                                  const MUINT8 *src_v0, const MUINT8 *src_v1, MUINT8 *dst, MINT32 width)
+{
+    MINT32 width16 = width & ~15;
+    for (MINT32 x = 0; x < width16; x += 16)
+    {
+        MINT32 c = x >> 1;
+        __m128i v_y = _mm_loadu_si128((const __m128i *)(src_y + x));
+        __m128i v_uv = _mm_unpacklo_epi8(filter8(src_u0 + c, src_u1 + c), filter8(src_v0 + c, src_v1 + c));
+        _mm_storeu_si128((__m128i *)(dst + x * 2), _mm_unpacklo_epi8(v_y, v_uv));
+        _mm_storeu_si128((__m128i *)(dst + x * 2 + 16), _mm_unpackhi_epi8(v_y, v_uv));
+    }
+    MINT32 c16 = width16 >> 1;
+    i420ToYuyvRowC(src_y + width16, src_u0 + c16, src_u1 + c16, src_v0 + c16, src_v1 + c16,
+                   dst + width16 * 2, width - width16);
+}
+
+static COLOR_SSE41_TARGET void splitVURowSse41(const MUINT8 *src_vu, MUINT8 *dst_u, MUINT8 *dst_v, MINT32 num)
+{
+    MINT32 num16 = num & ~15;
+    const __m128i v_mask = _mm_set1_epi16(0x00FF);
+    for (MINT32 i = 0; i < num16; i += 16)
+    {
+        __m128i v_a = _mm_loadu_si128((const __m128i *)(src_vu + i * 2));
+        __m128i v_b = _mm_loadu_si128((const __m128i *)(src_vu + i * 2 + 16));
+        _mm_storeu_si128((__m128i *)(dst_v + i), _mm_packus_epi16(_mm_and_si128(v_a, v_mask), _mm_and_si128(v_b, v_mask)));
+        _mm_storeu_si128((__m128i *)(dst_u + i), _mm_packus_epi16(_mm_srli_epi16(v_a, 8), _mm_srli_epi16(v_b, 8)));
+    }
+    splitVURowC(src_vu + num16 * 2, dst_u + num16, dst_v + num16, num - num16);
+}
+
+static COLOR_SSE41_TARGET void mergeVURowSse41(const MUINT8 *src_u, const MUINT8 *src_v, MUINT8 *dst_vu, MINT32 num)
+{
+    MINT32 num16 = num & ~15;
+    for (MINT32 i = 0; i < num16; i += 16)
+    {
+        __m128i v_u = _mm_loadu_si128((const __m128i *)(src_u + i));
+        __m128i v_v = _mm_loadu_si128((const __m128i *)(src_v + i));
+        _mm_storeu_si128((__m128i *)(dst_vu + i * 2), _mm_unpacklo_epi8(v_v, v_u));
+        _mm_storeu_si128((__m128i *)(dst_vu + i * 2 + 16), _mm_unpackhi_epi8(v_v, v_u));
+    }
+    mergeVURowC(src_u + num16, src_v + num16, dst_vu + num16 * 2, num - num16);
+}
+
+static const UTL_COLOR_KERNEL_STRUCT g_color_kernel_sse41 =
+{
+    rgbToYRowSse41,
+    rgbToUVRowSse41,
+    yuvToRgbRowSse41,
+    yuyvToI420RowSse41,
+    i420ToYuyvRowSse41,
+    splitVURowSse41,
+    mergeVURowSse41,
+};
+#endif /* COLOR_SSE41 */
+
+/*
+ * Runtime dispatch
+ */
+static pthread_once_t g_color_isa_once = PTHREAD_ONCE_INIT;
+static UTIL_COLOR_ISA_ENUM g_color_isa_best = UTIL_COLOR_ISA_C;
+static volatile UTIL_COLOR_ISA_ENUM g_color_isa = UTIL_COLOR_ISA_C;
+
+static void detectColorIsa()
+{
+#if defined(COLOR_NEON)
+#if !defined(__aarch64__) && defined(__linux__)
+    if (getauxval(AT_HWCAP) & HWCAP_NEON)
+        g_color_isa_best = UTIL_COLOR_ISA_NEON;
+#else
+    g_color_isa_best = UTIL_COLOR_ISA_NEON;
+#endif
+#elif defined(COLOR_SSE41)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.1"))
+        g_color_isa_best = UTIL_COLOR_ISA_SSE41;
+#endif
+    g_color_isa = g_color_isa_best;
+}
+
+static const UTL_COLOR_KERNEL_STRUCT *getColorKernel()
+{
+    pthread_once(&g_color_isa_once, detectColorIsa);
+    switch (g_color_isa)
+    {
+#ifdef COLOR_NEON
+        case UTIL_COLOR_ISA_NEON:
+            return &g_color_kernel_neon;
+#endif
+#ifdef COLOR_SSE41
+        case UTIL_COLOR_ISA_SSE41:
+            return &g_color_kernel_sse41;
+#endif
+        default:
+            return &g_color_kernel_c;
+    }
+}
+
+UTIL_COLOR_ISA_ENUM UtlColorConvertGetIsa()
+{
+    pthread_once(&g_color_isa_once, detectColorIsa);
+    return g_color_isa;
+}
+
+UTIL_ERRCODE_ENUM UtlColorConvertSetIsa(UTIL_COLOR_ISA_ENUM isa)
+{
+    pthread_once(&g_color_isa_once, detectColorIsa);
+    if (isa != UTIL_COLOR_ISA_C && isa != g_color_isa_best)
+        return UTIL_COMMON_ERR_INVALID_PARAMETER;
+
+    g_color_isa = isa;
+    return UTIL_OK;
+}
+
+/*
+ * Conversion of a band of rows
+ */
+typedef enum UTL_COLOR_PATH_ENUM
+{
+    UTL_COLOR_PATH_RGB_TO_YUV420,
+    UTL_COLOR_PATH_YUV420_TO_RGB,
+    UTL_COLOR_PATH_YUYV_TO_I420,
+    UTL_COLOR_PATH_I420_TO_YUYV,
+    UTL_COLOR_PATH_NV21_TO_I420,
+    UTL_COLOR_PATH_I420_TO_NV21,
+} UTL_COLOR_PATH_ENUM;
+
+// the planes of a 4:2:0 image
+typedef struct UTL_COLOR_PLANES_STRUCT
+{
+    MUINT8 *y;
+    MUINT8 *u;
+    MUINT8 *v;
+    MINT32 uv_step;     // 1: I420, 2: NV21
+    MINT32 uv_stride;   // bytes per chroma row
+} UTL_COLOR_PLANES_STRUCT;
+
+typedef struct UTL_COLOR_CONTEXT_STRUCT
+{
+    UTL_COLOR_PATH_ENUM path;
+    const UTL_COLOR_KERNEL_STRUCT *kernel;
+    const UTL_COLOR_COEF_STRUCT *coef;
+    MINT32 width;
+    MINT32 height;
+
+    // the packed side (RGB or YUYV) and the 4:2:0 side (or the I420 side of NV21 <-> I420)
+    MUINT8 *packed;
+    MINT32 bpp;
+    UTL_COLOR_PLANES_STRUCT planes;
+    UTL_COLOR_PLANES_STRUCT nv21;
+} UTL_COLOR_CONTEXT_STRUCT;
+
+typedef struct UTL_COLOR_BAND_STRUCT
+{
+    const UTL_COLOR_CONTEXT_STRUCT *ctx;
+    MINT32 pair_begin;  // first row pair (rows 2*pair_begin and 2*pair_begin+1)
+    MINT32 pair_end;
+} UTL_COLOR_BAND_STRUCT;
+
+static void convertBand(const UTL_COLOR_CONTEXT_STRUCT *ctx, MINT32 pair_begin, MINT32 pair_end)
+{
+    const UTL_COLOR_KERNEL_STRUCT *k = ctx->kernel;
+    const UTL_COLOR_PLANES_STRUCT *p = &ctx->planes;
+    MINT32 width = ctx->width;
+    MINT32 packed_stride = width * ctx->bpp;
+
+    for (MINT32 pair = pair_begin; pair < pair_end; pair++)
+    {
+        MINT32 row = pair * 2;
+        MUINT8 *packed0 = ctx->packed + row * packed_stride;
+        MUINT8 *packed1 = packed0 + packed_stride;
+        MUINT8 *y0 = p->y + row * width;
+        MUINT8 *y1 = y0 + width;
+        MUINT8 *u = p->u + pair * p->uv_stride;
+        MUINT8 *v = p->v + pair * p->uv_stride;
+
+        switch (ctx->path)
+        {
+            case UTL_COLOR_PATH_RGB_TO_YUV420:
+                k->rgbToY(packed0, y0, width, ctx->bpp, ctx->coef);
+                k->rgbToY(packed1, y1, width, ctx->bpp, ctx->coef);
+                k->rgbToUV(packed0, packed1, u, v, p->uv_step, width, ctx->bpp, ctx->coef);
+                break;
+
+            case UTL_COLOR_PATH_YUV420_TO_RGB:
+                k->yuvToRgb(y0, u, v, p->uv_step, packed0, width, ctx->bpp, ctx->coef);
+                k->yuvToRgb(y1, u, v, p->uv_step, packed1, width, ctx->bpp, ctx->coef);
+                break;
+
+            case UTL_COLOR_PATH_YUYV_TO_I420:
+                k->yuyvToI420(packed0, packed1, y0, y1, u, v, width);
+                break;
+
+            case UTL_COLOR_PATH_I420_TO_YUYV:
+            {
+                // chroma is sited between the two rows; interpolate with the row above and below
+                MINT32 prev = (pair > 0) ? -p->uv_stride : 0;
+                MINT32 next = (pair < (ctx->height >> 1) - 1) ? p->uv_stride : 0;
+                k->i420ToYuyv(y0, u, u + prev, v, v + prev, packed0, width);
+                k->i420ToYuyv(y1, u, u + next, v, v + next, packed1, width);
+                break;
+            }
+
+            case UTL_COLOR_PATH_NV21_TO_I420:
+            {
+                MUINT8 *vu = ctx->nv21.v + pair * ctx->nv21.uv_stride;
+                memcpy(y0, ctx->nv21.y + row * width, width * 2);
+                k->splitVU(vu, u, v, width >> 1);
+                break;
+            }
+
+            case UTL_COLOR_PATH_I420_TO_NV21:
+            {
+                MUINT8 *vu = ctx->nv21.v + pair * ctx->nv21.uv_stride;
+                memcpy(ctx->nv21.y + row * width, y0, width * 2);
+                k->mergeVU(u, v, vu, width >> 1);
+                break;
+            }
+        }
+    }
+}
+
+static void *convertBandJob(void *arg, rtinfo *info)
+{
+    UTL_COLOR_BAND_STRUCT *band = (UTL_COLOR_BAND_STRUCT *)arg;
+    (void)info;
+    UTIL_PROF_ZONE("UtlColorConvert band");
+    convertBand(band->ctx, band->pair_begin, band->pair_end);
+    return NULL;
+}
+
+static void setPlanes(UTL_COLOR_PLANES_STRUCT *planes, MUINT8 *data, MINT32 width, MINT32 height, MBOOL is_nv21)
+{
+    MINT32 y_size = width * height;
+    planes->y = data;
+    if (is_nv21)
+    {
+        planes->v = data + y_size;
+        planes->u = planes->v + 1;
+        planes->uv_step = 2;
+        planes->uv_stride = width;
+    }
+    else
+    {
+        planes->u = data + y_size;
+        planes->v = planes->u + (y_size >> 2);
+        planes->uv_step = 1;
+        planes->uv_stride = width >> 1;
+    }
+}
+
+static MINT32 getRgbBpp(UTL_IMAGE_FORMAT_ENUM format)
+{
+    if (format == UTL_IMAGE_FORMAT_RGBA8888)
+        return 4;
+    if (format == UTL_IMAGE_FORMAT_RGB888)
+        return 3;
+    return 0;
+}
+
+static MBOOL isYuv420(UTL_IMAGE_FORMAT_ENUM format)
+{
+    return format == UTL_IMAGE_FORMAT_YUV420 || format == UTL_IMAGE_FORMAT_NV21;
+}
+
+UTIL_ERRCODE_ENUM UtlColorConvert(P_UTIL_BASE_IMAGE_STRUCT pSrc, UTL_IMAGE_FORMAT_ENUM srcFormat,
+                                  P_UTIL_BASE_IMAGE_STRUCT pDst, UTL_IMAGE_FORMAT_ENUM dstFormat,
+                                  UTIL_COLOR_MATRIX_ENUM matrix, tp_queue tpq, MINT32 numTasks)
+{
+    UTIL_ERRCODE_ENUM result = UTIL_OK;
+    UTL_COLOR_CONTEXT_STRUCT ctx;
+    UTIL_PROF_FUNC();
+
+    // data pointer check
+    if (!pSrc || !pDst || !pSrc->data || !pDst->data)
+    {
+        result = UTIL_COMMON_ERR_NULL_BUFFER_POINTER;
+        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
+        return result;
+    }
+
+    // parameter check, 4:2:0 and 4:2:2 need even sizes
+    if (pSrc->width <= 0 || pSrc->height <= 0 || (pSrc->width & 1) || (pSrc->height & 1) ||
+        pSrc->width != pDst->width || pSrc->height != pDst->height ||
+        matrix < 0 || matrix >= UTIL_COLOR_MATRIX_NUM || numTasks <= 0 || numTasks > UTL_COLOR_MAX_TASKS)
+    {
+        result = UTIL_COMMON_ERR_INVALID_PARAMETER;
+        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
+        return result;
+    }
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.kernel = getColorKernel();
+    ctx.coef = &g_color_coef[matrix];
+    ctx.width = pSrc->width;
+    ctx.height = pSrc->height;
+
+    // format pair
+    if (getRgbBpp(srcFormat) && isYuv420(dstFormat))
+    {
+        ctx.path = UTL_COLOR_PATH_RGB_TO_YUV420;
+        ctx.packed = (MUINT8 *)pSrc->data;
+        ctx.bpp = getRgbBpp(srcFormat);
+        setPlanes(&ctx.planes, (MUINT8 *)pDst->data, ctx.width, ctx.height, dstFormat == UTL_IMAGE_FORMAT_NV21);
+    }
+    else if (isYuv420(srcFormat) && getRgbBpp(dstFormat))
+    {
+        ctx.path = UTL_COLOR_PATH_YUV420_TO_RGB;
+        ctx.packed = (MUINT8 *)pDst->data;
+        ctx.bpp = getRgbBpp(dstFormat);
+        setPlanes(&ctx.planes, (MUINT8 *)pSrc->data, ctx.width, ctx.height, srcFormat == UTL_IMAGE_FORMAT_NV21);
+    }
+    else if (srcFormat == UTL_IMAGE_FORMAT_PACKET_YUY2 && dstFormat == UTL_IMAGE_FORMAT_YUV420)
+    {
+        ctx.path = UTL_COLOR_PATH_YUYV_TO_I420;
+        ctx.packed = (MUINT8 *)pSrc->data;
+        ctx.bpp = 2;
+        setPlanes(&ctx.planes, (MUINT8 *)pDst->data, ctx.width, ctx.height, false);
+    }
+    else if (srcFormat == UTL_IMAGE_FORMAT_YUV420 && dstFormat == UTL_IMAGE_FORMAT_PACKET_YUY2)
+    {
+        ctx.path = UTL_COLOR_PATH_I420_TO_YUYV;
+        ctx.packed = (MUINT8 *)pDst->data;
+        ctx.bpp = 2;
+        setPlanes(&ctx.planes, (MUINT8 *)pSrc->data, ctx.width, ctx.height, false);
+    }
+    else if (srcFormat == UTL_IMAGE_FORMAT_NV21 && dstFormat == UTL_IMAGE_FORMAT_YUV420)
+    {
+        ctx.path = UTL_COLOR_PATH_NV21_TO_I420;
+        ctx.packed = (MUINT8 *)pSrc->data;
+        setPlanes(&ctx.nv21, (MUINT8 *)pSrc->data, ctx.width, ctx.height, true);
+        setPlanes(&ctx.planes, (MUINT8 *)pDst->data, ctx.width, ctx.height, false);
+    }
+    else if (srcFormat == UTL_IMAGE_FORMAT_YUV420 && dstFormat == UTL_IMAGE_FORMAT_NV21)
+    {
+        ctx.path = UTL_COLOR_PATH_I420_TO_NV21;
+        ctx.packed = (MUINT8 *)pDst->data;
+        setPlanes(&ctx.nv21, (MUINT8 *)pDst->data, ctx.width, ctx.height, true);
+        setPlanes(&ctx.planes, (MUINT8 *)pSrc->data, ctx.width, ctx.height, false);
+    }
+    else
+    {
+        result = UTIL_COMMON_ERR_UNSUPPORTED_IMAGE_FORMAT;
+        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
+        return result;
+    }
+
+    // split the row pairs into bands
+    MINT32 num_pairs = ctx.height >> 1;
+    if (numTasks > num_pairs)
+        numTasks = num_pairs;
+
+    if (tpq == NULL || numTasks == 1)
+    {
+        convertBand(&ctx, 0, num_pairs);
+        return result;
+    }
+
+    UTL_COLOR_BAND_STRUCT bands[UTL_COLOR_MAX_TASKS];
+    for (MINT32 i = 0; i < numTasks; i++)
+    {
+        bands[i].ctx = &ctx;
+        bands[i].pair_begin = num_pairs * i / numTasks;
+        bands[i].pair_end = num_pairs * (i + 1) / numTasks;
+        if (tpq_add_work(tpq, convertBandJob, &bands[i]) != 0)
+        {
+            // run the band here if it can not be queued
+            convertBand(&ctx, bands[i].pair_begin, bands[i].pair_end);
+        }
+    }
+    tpq_exec(tpq, 0);
+
+    return result;
+}
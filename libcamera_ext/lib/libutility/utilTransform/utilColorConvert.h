@@ -0,0 +1,75 @@
+#ifndef _UTIL_COLOR_CONVERT_H_
+#define _UTIL_COLOR_CONVERT_H_
+
+#include "MTKUtilCommon.h"
+#include "utilSystem/tpq.h"
+
+/**
+ * \brief YCbCr matrix and range of the YUV side of a conversion
+ */
+typedef enum UTIL_COLOR_MATRIX_ENUM
+{
+    UTIL_COLOR_BT601_LIMITED,   ///< Rec.601, Y in [16..235], the same as utilColorTransform
+    UTIL_COLOR_BT601_FULL,      ///< Rec.601, Y in [0..255] (JFIF)
+    UTIL_COLOR_BT709_LIMITED,   ///< Rec.709, Y in [16..235]
+    UTIL_COLOR_BT709_FULL,      ///< Rec.709, Y in [0..255]
+    UTIL_COLOR_MATRIX_NUM
+} UTIL_COLOR_MATRIX_ENUM;
+
+/**
+ * \brief instruction set of the conversion kernels
+ */
+typedef enum UTIL_COLOR_ISA_ENUM
+{
+    UTIL_COLOR_ISA_C,           ///< portable C
+    UTIL_COLOR_ISA_NEON,        ///< ARM NEON
+    UTIL_COLOR_ISA_SSE41,       ///< x86 SSE4.1
+    UTIL_COLOR_ISA_NUM
+} UTIL_COLOR_ISA_ENUM;
+
+/// max number of row bands of one conversion
+#define UTL_COLOR_MAX_TASKS (32)
+
+/**
+ * \brief convert the color format of an image with fixed-point kernels
+ * \fn UTIL_ERRCODE_ENUM UtlColorConvert(P_UTIL_BASE_IMAGE_STRUCT pSrc, UTL_IMAGE_FORMAT_ENUM srcFormat, P_UTIL_BASE_IMAGE_STRUCT pDst, UTL_IMAGE_FORMAT_ENUM dstFormat, UTIL_COLOR_MATRIX_ENUM matrix, tp_queue tpq, MINT32 numTasks)
+ * \param[in] pSrc input image structure
+ * \param[in] srcFormat input format
+ * \param[out] pDst output image structure, of the same width and height as pSrc
+ * \param[in] dstFormat output format
+ * \param[in] matrix YCbCr matrix and range, for the conversions between RGB and YUV
+ * \param[in] tpq thread pool to run the row bands on, or NULL to run on the calling thread
+ * \param[in] numTasks number of row bands (1 to UTL_COLOR_MAX_TASKS)
+ * \return utility error code
+ *
+ * Supported conversions, all buffers are packed without row padding and
+ * width and height must be even:
+ *  - UTL_IMAGE_FORMAT_RGBA8888 / RGB888 -> UTL_IMAGE_FORMAT_YUV420 (I420) / NV21
+ *  - UTL_IMAGE_FORMAT_YUV420 (I420) / NV21 -> UTL_IMAGE_FORMAT_RGBA8888 / RGB888
+ *  - UTL_IMAGE_FORMAT_PACKET_YUY2 (YUYV) <-> UTL_IMAGE_FORMAT_YUV420 (I420)
+ *  - UTL_IMAGE_FORMAT_NV21 <-> UTL_IMAGE_FORMAT_YUV420 (I420)
+ *
+ * The kernels of each instruction set give the same result as the C kernels.
+ * With UTIL_COLOR_BT601_LIMITED, the result is within 1 of the converters of
+ * utilColorTransform.
+ */
+UTIL_ERRCODE_ENUM UtlColorConvert(P_UTIL_BASE_IMAGE_STRUCT pSrc, UTL_IMAGE_FORMAT_ENUM srcFormat,
+                                  P_UTIL_BASE_IMAGE_STRUCT pDst, UTL_IMAGE_FORMAT_ENUM dstFormat,
+                                  UTIL_COLOR_MATRIX_ENUM matrix, tp_queue tpq, MINT32 numTasks);
+
+/**
+ * \brief get the instruction set which UtlColorConvert uses
+ * \fn UTIL_COLOR_ISA_ENUM UtlColorConvertGetIsa()
+ * \return the best one the CPU supports, unless it is changed by UtlColorConvertSetIsa
+ */
+UTIL_COLOR_ISA_ENUM UtlColorConvertGetIsa();
+
+/**
+ * \brief select the instruction set which UtlColorConvert uses, e.g. UTIL_COLOR_ISA_C for reference
+ * \fn UTIL_ERRCODE_ENUM UtlColorConvertSetIsa(UTIL_COLOR_ISA_ENUM isa)
+ * \param[in] isa instruction set
+ * \return UTIL_COMMON_ERR_INVALID_PARAMETER if the CPU or the build does not support it
+ */
+UTIL_ERRCODE_ENUM UtlColorConvertSetIsa(UTIL_COLOR_ISA_ENUM isa);
+
+#endif /* _UTIL_COLOR_CONVERT_H_ */
@@ -10,7 +10,9 @@
 #endif
 #include "utilColorTransform.h"
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || (defined(_WIN32) && defined(_MSC_VER))
 #define NEON_OPT
+#endif
 #ifdef NEON_OPT
 #if defined(_WIN32) && defined(_MSC_VER)
 #include <neon_template.hpp>
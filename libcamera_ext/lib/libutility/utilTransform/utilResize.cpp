@@ -2,6 +2,8 @@
 
 #define MTK_LOG_ENABLE 1
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #if defined(__ANDROID__) || defined(ANDROID)
 #include <android/log.h>
 #define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
@@ -11,6 +13,14 @@
 #include "utilResize.h"
 #include "utilColorTransform.h"
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RESIZE_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#define RESIZE_SSE2
+#include <emmintrin.h>
+#endif
+
 UTIL_ERRCODE_ENUM utilBilinearResizer(P_UTIL_BASE_IMAGE_STRUCT dst, P_UTIL_BASE_IMAGE_STRUCT src, UTL_IMAGE_FORMAT_ENUM ImgFmt)
 {
     UTIL_ERRCODE_ENUM result = UTIL_OK;
@@ -36,72 +46,15 @@ UTIL_ERRCODE_ENUM utilBilinearResizer(P_UTIL_BASE_IMAGE_STRUCT dst, P_UTIL_BASE_
 
     if (ImgFmt == UTL_IMAGE_FORMAT_YUV400)
     {
-        MUINT8 *src_buffer = (MUINT8 *)src_addr;
-        MUINT8 *dstAddr = (MUINT8 *)dst_addr;
-        while (--h >= 0)
+        // the last row must be in the source, as the row loop has checked
+        if ((h <= 0) || ((MINT32)UTL_IUL_X_TO_I_CARRY(srcStepY * (h - 1)) >= srcHeight))
         {
-            MINT32 w = img_w;
-            MUINT32 srcCoordX = 0;
-
-            MINT32 srcOffset_1;
-            MINT32 srcOffset_2;
-            MUINT8 *src_ptr_1;
-            MUINT8 *src_ptr_2;
-
-            MINT32 y_carry = UTL_IUL_X_TO_I_CARRY(srcCoordY);
-            MINT32 y_chop  = UTL_IUL_X_TO_I_CHOP(srcCoordY);
-
-            if ((y_carry < 0) || (y_carry >= srcHeight))
-            {
-                result = UTIL_COMMON_ERR_INVALID_PARAMETER;
-                LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
-                return result;
-            }
-            if ((y_chop < 0) || (y_chop >= srcHeight))
-            {
-                result = UTIL_COMMON_ERR_INVALID_PARAMETER;
-                LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
-                return result;
-            }
-
-            srcOffset_1 = y_chop * srcPitch;
-            srcOffset_2 = y_carry * srcPitch;
-            src_ptr_1 = src_buffer + srcOffset_1;
-            src_ptr_2 = src_buffer + srcOffset_2;
-
-            while (--w >= 0)
-            {
-                MUINT8 pixel_1, pixel_2;
-                MINT32 y, y1;
-
-                MINT32 x_carry = UTL_IUL_X_TO_I_CARRY(srcCoordX);
-                MINT32 x_chop = UTL_IUL_X_TO_I_CHOP(srcCoordX);
-
-                MINT32 weighting2;
-
-                weighting2 = UTL_IUL_X_FRACTION(srcCoordX);
-
-                // 1st horizontal interpolation.
-                pixel_1 = *(src_ptr_1 + x_chop);
-                pixel_2 = *(src_ptr_1 + x_carry);
-                y = LINEAR_INTERPOLATION(pixel_1, pixel_2, weighting2);
-
-                // 2nd horizontal interpolation.
-                pixel_1 = *(src_ptr_2 + x_chop);
-                pixel_2 = *(src_ptr_2 + x_carry);
-                y1 = LINEAR_INTERPOLATION(pixel_1, pixel_2, weighting2);
-
-                // Vertical interpolation.
-                weighting2 = UTL_IUL_X_FRACTION(srcCoordY);
-
-                y = LINEAR_INTERPOLATION(y, y1, weighting2);
-
-                *dstAddr++ = (MUINT8)y;
-
-                srcCoordX += srcStepX;
-            }
-            srcCoordY += srcStepY;
+            result = UTIL_COMMON_ERR_INVALID_PARAMETER;
+            LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
+            return result;
         }
+
+        result = utilResizer(dst, src, ImgFmt, UTIL_RESIZE_BILINEAR, NULL, 1);
     }
     else if (ImgFmt == UTL_IMAGE_FORMAT_RGB565)
     {
@@ -188,3 +141,456 @@ UTIL_ERRCODE_ENUM utilBilinearResizer(P_UTIL_BASE_IMAGE_STRUCT dst, P_UTIL_BASE_
 
     return result;
 }
+
+/*
+ * Separable resizer
+ *
+ * Each axis has a table of taps: for each output coordinate, the source
+ * indices and the weights of a fixed number of taps (zero weights pad the
+ * short ones).
+ *
+ * Bilinear keeps the arithmetic of LINEAR_INTERPOLATION, so it filters
+ * horizontally first: each source row is filtered once into a ring of rows
+ * with weights in Q16 and rounded to an integer, then
+ *   out = h0 + ((h1 - h0) * w + 0x8000) >> 16
+ * which equals LINEAR_INTERPOLATION(h0, h1, w).
+ *
+ * Area weights are the covered fractions of the source pixels in Q14. It
+ * filters vertically first, on whole source rows with SIMD, into a row kept
+ * in Q6, then horizontally:
+ *   out = (sum(w * v) + (1 << 19)) >> 20
+ * Area is for downscaling, where this leaves the fewest pixels to the
+ * horizontal taps.
+ */
+#define RESIZE_AREA_WEIGHT_BITS     (14)
+#define RESIZE_AREA_ROW_BITS        (6)
+
+typedef struct UTL_RESIZE_AXIS_STRUCT
+{
+    MINT32 taps;
+    MINT32 *index;      // [out_size * taps]
+    MINT32 *weight;     // [out_size * taps]
+} UTL_RESIZE_AXIS_STRUCT;
+
+typedef struct UTL_RESIZE_PLANE_STRUCT
+{
+    UTIL_RESIZE_FILTER_ENUM filter;
+    const MUINT8 *src;
+    MINT32 src_width;
+    MINT32 src_height;
+    MUINT8 *dst;
+    MINT32 dst_width;
+    MINT32 dst_height;
+    UTL_RESIZE_AXIS_STRUCT axis_x;
+    UTL_RESIZE_AXIS_STRUCT axis_y;
+} UTL_RESIZE_PLANE_STRUCT;
+
+typedef struct UTL_RESIZE_BAND_STRUCT
+{
+    const UTL_RESIZE_PLANE_STRUCT *plane;
+    MINT32 row_begin;
+    MINT32 row_end;
+    UTIL_ERRCODE_ENUM result;
+} UTL_RESIZE_BAND_STRUCT;
+
+static void freeAxis(UTL_RESIZE_AXIS_STRUCT *axis)
+{
+    free(axis->index);
+    free(axis->weight);
+    axis->index = NULL;
+    axis->weight = NULL;
+}
+
+static UTIL_ERRCODE_ENUM initBilinearAxis(UTL_RESIZE_AXIS_STRUCT *axis, MINT32 src_size, MINT32 dst_size)
+{
+    MUINT32 step = UTL_IUL_I_TO_X(src_size) / dst_size;
+    MUINT32 coord = 0;
+
+    axis->taps = 2;
+    axis->index = (MINT32 *)malloc(dst_size * 2 * sizeof(MINT32));
+    axis->weight = (MINT32 *)malloc(dst_size * 2 * sizeof(MINT32));
+    if (!axis->index || !axis->weight)
+        return UTIL_COMMON_ERR_OUT_OF_MEMORY;
+
+    for (MINT32 i = 0; i < dst_size; i++)
+    {
+        MINT32 carry = UTL_IUL_X_TO_I_CARRY(coord);
+        MINT32 frac = UTL_IUL_X_FRACTION(coord);
+        axis->index[i * 2 + 0] = UTL_IUL_X_TO_I_CHOP(coord);
+        axis->index[i * 2 + 1] = (carry < src_size) ? carry : src_size - 1;
+        axis->weight[i * 2 + 0] = UTL_IUL_I_TO_X(1) - frac;
+        axis->weight[i * 2 + 1] = frac;
+        coord += step;
+    }
+    return UTIL_OK;
+}
+
+static UTIL_ERRCODE_ENUM initAreaAxis(UTL_RESIZE_AXIS_STRUCT *axis, MINT32 src_size, MINT32 dst_size)
+{
+    // in units of 1/dst_size source pixel, source pixel j covers [j*dst_size, (j+1)*dst_size)
+    // and output i covers [i*src_size, (i+1)*src_size)
+    MINT32 taps = (src_size + dst_size - 1) / dst_size + 1;
+
+    axis->taps = taps;
+    axis->index = (MINT32 *)malloc(dst_size * taps * sizeof(MINT32));
+    axis->weight = (MINT32 *)malloc(dst_size * taps * sizeof(MINT32));
+    if (!axis->index || !axis->weight)
+        return UTIL_COMMON_ERR_OUT_OF_MEMORY;
+
+    for (MINT32 i = 0; i < dst_size; i++)
+    {
+        MINT32 *index = axis->index + i * taps;
+        MINT32 *weight = axis->weight + i * taps;
+        MINT64 begin = (MINT64)i * src_size;
+        MINT64 end = begin + src_size;
+        MINT32 first = (MINT32)(begin / dst_size);
+        MINT32 sum = 0, largest = 0;
+
+        for (MINT32 k = 0; k < taps; k++)
+        {
+            MINT32 j = first + k;
+            MINT64 lo = (MINT64)j * dst_size;
+            MINT64 hi = lo + dst_size;
+            MINT64 overlap = ((hi < end) ? hi : end) - ((lo > begin) ? lo : begin);
+
+            if (j >= src_size || overlap <= 0)
+            {
+                index[k] = index[k > 0 ? k - 1 : 0];
+                weight[k] = 0;
+                continue;
+            }
+            index[k] = j;
+            weight[k] = (MINT32)((overlap * (1 << RESIZE_AREA_WEIGHT_BITS) + (src_size >> 1)) / src_size);
+            sum += weight[k];
+            if (weight[k] > weight[largest])
+                largest = k;
+        }
+
+        // the weights sum to exactly 1.0
+        weight[largest] += (1 << RESIZE_AREA_WEIGHT_BITS) - sum;
+    }
+    return UTIL_OK;
+}
+
+static void filterRowBilinear(const UTL_RESIZE_AXIS_STRUCT *axis, const MUINT8 *src, MINT16 *dst, MINT32 width)
+{
+    const MINT32 *index = axis->index;
+    const MINT32 *weight = axis->weight;
+    for (MINT32 x = 0; x < width; x++)
+    {
+        dst[x] = (MINT16)((src[index[0]] * weight[0] + src[index[1]] * weight[1] + (1 << 15)) >> 16);
+        index += 2;
+        weight += 2;
+    }
+}
+
+static void filterRowArea(const UTL_RESIZE_AXIS_STRUCT *axis, const MINT16 *src, MUINT8 *dst, MINT32 width)
+{
+    const MINT32 *index = axis->index;
+    const MINT32 *weight = axis->weight;
+    const MINT32 taps = axis->taps;
+    const MINT32 shift = RESIZE_AREA_WEIGHT_BITS + RESIZE_AREA_ROW_BITS;
+    for (MINT32 x = 0; x < width; x++)
+    {
+        MINT32 sum = 1 << (shift - 1);
+        for (MINT32 k = 0; k < taps; k++)
+            sum += src[index[k]] * weight[k];
+        sum >>= shift;
+        dst[x] = (MUINT8)((sum > 255) ? 255 : sum);
+        index += taps;
+        weight += taps;
+    }
+}
+
+static void blendRowsBilinear(const MINT16 *row0, const MINT16 *row1, MINT32 weight, MUINT8 *dst, MINT32 width)
+{
+    MINT32 x = 0;
+#if defined(RESIZE_NEON)
+    int32x4_t v_weight = vdupq_n_s32(weight);
+    for (; x + 8 <= width; x += 8)
+    {
+        int16x8_t v_h0 = vld1q_s16(row0 + x);
+        int16x8_t v_d = vsubq_s16(vld1q_s16(row1 + x), v_h0);
+
+        // (d * w + 0x8000) >> 16
+        int32x4_t v_lo = vrshrq_n_s32(vmulq_s32(vmovl_s16(vget_low_s16(v_d)), v_weight), 16);
+        int32x4_t v_hi = vrshrq_n_s32(vmulq_s32(vmovl_s16(vget_high_s16(v_d)), v_weight), 16);
+        int16x8_t v_out = vaddq_s16(v_h0, vcombine_s16(vmovn_s32(v_lo), vmovn_s32(v_hi)));
+        vst1_u8(dst + x, vqmovun_s16(v_out));
+    }
+#elif defined(RESIZE_SSE2)
+    // the weight is 0 to 0xFFFF, so the signed d * w is built from the unsigned high half
+    const __m128i v_weight = _mm_set1_epi16((MINT16)weight);
+    const __m128i v_round = _mm_set1_epi32(1 << 15);
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i v_h0 = _mm_loadu_si128((const __m128i *)(row0 + x));
+        __m128i v_d = _mm_sub_epi16(_mm_loadu_si128((const __m128i *)(row1 + x)), v_h0);
+        __m128i v_mul_lo = _mm_mullo_epi16(v_d, v_weight);
+        __m128i v_mul_hi = _mm_sub_epi16(_mm_mulhi_epu16(v_d, v_weight), _mm_and_si128(_mm_srai_epi16(v_d, 15), v_weight));
+        __m128i v_lo = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(v_mul_lo, v_mul_hi), v_round), 16);
+        __m128i v_hi = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(v_mul_lo, v_mul_hi), v_round), 16);
+        __m128i v_out = _mm_add_epi16(v_h0, _mm_packs_epi32(v_lo, v_hi));
+        _mm_storel_epi64((__m128i *)(dst + x), _mm_packus_epi16(v_out, v_out));
+    }
+#endif
+    for (; x < width; x++)
+        dst[x] = (MUINT8)(row0[x] + (((row1[x] - row0[x]) * weight + (1 << 15)) >> 16));
+}
+
+static void filterColumnsArea(const MUINT8 *const *rows, const MINT32 *weight, MINT32 taps, MINT16 *dst, MINT32 width)
+{
+    const MINT32 shift = RESIZE_AREA_WEIGHT_BITS - RESIZE_AREA_ROW_BITS;
+    MINT32 x = 0;
+#if defined(RESIZE_NEON)
+    for (; x + 8 <= width; x += 8)
+    {
+        int32x4_t v_lo = vdupq_n_s32(0);
+        int32x4_t v_hi = vdupq_n_s32(0);
+        for (MINT32 k = 0; k < taps; k++)
+        {
+            int16x8_t v_src = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(rows[k] + x)));
+            v_lo = vmlal_n_s16(v_lo, vget_low_s16(v_src), (MINT16)weight[k]);
+            v_hi = vmlal_n_s16(v_hi, vget_high_s16(v_src), (MINT16)weight[k]);
+        }
+        vst1q_s16(dst + x, vcombine_s16(vrshrn_n_s32(v_lo, RESIZE_AREA_WEIGHT_BITS - RESIZE_AREA_ROW_BITS),
+                                        vrshrn_n_s32(v_hi, RESIZE_AREA_WEIGHT_BITS - RESIZE_AREA_ROW_BITS)));
+    }
+#elif defined(RESIZE_SSE2)
+    const __m128i v_round = _mm_set1_epi32(1 << (shift - 1));
+    const __m128i v_zero = _mm_setzero_si128();
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i v_lo = v_round;
+        __m128i v_hi = v_round;
+        MINT32 k = 0;
+
+        // two taps per _mm_madd_epi16
+        for (; k + 2 <= taps; k += 2)
+        {
+            __m128i v_src0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(rows[k] + x)), v_zero);
+            __m128i v_src1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(rows[k + 1] + x)), v_zero);
+            __m128i v_w = _mm_set1_epi32((weight[k] & 0xFFFF) | (weight[k + 1] << 16));
+            v_lo = _mm_add_epi32(v_lo, _mm_madd_epi16(_mm_unpacklo_epi16(v_src0, v_src1), v_w));
+            v_hi = _mm_add_epi32(v_hi, _mm_madd_epi16(_mm_unpackhi_epi16(v_src0, v_src1), v_w));
+        }
+        if (k < taps)
+        {
+            __m128i v_src0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(rows[k] + x)), v_zero);
+            __m128i v_w = _mm_set1_epi32(weight[k] & 0xFFFF);
+            v_lo = _mm_add_epi32(v_lo, _mm_madd_epi16(_mm_unpacklo_epi16(v_src0, v_zero), v_w));
+            v_hi = _mm_add_epi32(v_hi, _mm_madd_epi16(_mm_unpackhi_epi16(v_src0, v_zero), v_w));
+        }
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_packs_epi32(_mm_srai_epi32(v_lo, shift), _mm_srai_epi32(v_hi, shift)));
+    }
+#endif
+    for (; x < width; x++)
+    {
+        MINT32 sum = 1 << (shift - 1);
+        for (MINT32 k = 0; k < taps; k++)
+            sum += rows[k][x] * weight[k];
+        dst[x] = (MINT16)(sum >> shift);
+    }
+}
+
+static UTIL_ERRCODE_ENUM resizeBandBilinear(const UTL_RESIZE_PLANE_STRUCT *plane, MINT32 row_begin, MINT32 row_end)
+{
+    const UTL_RESIZE_AXIS_STRUCT *axis_y = &plane->axis_y;
+    const MINT32 width = plane->dst_width;
+
+    // source row i is kept in slot i % 2, as the two taps of an output row are consecutive rows
+    MINT16 *ring = (MINT16 *)malloc(2 * width * sizeof(MINT16));
+    MINT32 ring_row[2] = { -1, -1 };
+    if (!ring)
+        return UTIL_COMMON_ERR_OUT_OF_MEMORY;
+
+    for (MINT32 y = row_begin; y < row_end; y++)
+    {
+        const MINT32 *index = axis_y->index + y * 2;
+        const MINT16 *rows[2];
+
+        // horizontal pass of the rows not in the ring yet
+        for (MINT32 k = 0; k < 2; k++)
+        {
+            MINT32 slot = index[k] & 1;
+            if (ring_row[slot] != index[k])
+            {
+                filterRowBilinear(&plane->axis_x, plane->src + index[k] * plane->src_width, ring + slot * width, width);
+                ring_row[slot] = index[k];
+            }
+            rows[k] = ring + slot * width;
+        }
+
+        // vertical pass
+        blendRowsBilinear(rows[0], rows[1], axis_y->weight[y * 2 + 1], plane->dst + y * width, width);
+    }
+
+    free(ring);
+    return UTIL_OK;
+}
+
+static UTIL_ERRCODE_ENUM resizeBandArea(const UTL_RESIZE_PLANE_STRUCT *plane, MINT32 row_begin, MINT32 row_end)
+{
+    const UTL_RESIZE_AXIS_STRUCT *axis_y = &plane->axis_y;
+    const MINT32 taps = axis_y->taps;
+
+    MINT16 *column = (MINT16 *)malloc(plane->src_width * sizeof(MINT16));
+    const MUINT8 **rows = (const MUINT8 **)malloc(taps * sizeof(MUINT8 *));
+    if (!column || !rows)
+    {
+        free(column);
+        free(rows);
+        return UTIL_COMMON_ERR_OUT_OF_MEMORY;
+    }
+
+    for (MINT32 y = row_begin; y < row_end; y++)
+    {
+        const MINT32 *index = axis_y->index + y * taps;
+        for (MINT32 k = 0; k < taps; k++)
+            rows[k] = plane->src + index[k] * plane->src_width;
+
+        filterColumnsArea(rows, axis_y->weight + y * taps, taps, column, plane->src_width);
+        filterRowArea(&plane->axis_x, column, plane->dst + y * plane->dst_width, plane->dst_width);
+    }
+
+    free(column);
+    free(rows);
+    return UTIL_OK;
+}
+
+static UTIL_ERRCODE_ENUM resizeBand(const UTL_RESIZE_PLANE_STRUCT *plane, MINT32 row_begin, MINT32 row_end)
+{
+    if (plane->filter == UTIL_RESIZE_BILINEAR)
+        return resizeBandBilinear(plane, row_begin, row_end);
+    return resizeBandArea(plane, row_begin, row_end);
+}
+
+static void *resizeBandJob(void *arg, rtinfo *info)
+{
+    UTL_RESIZE_BAND_STRUCT *band = (UTL_RESIZE_BAND_STRUCT *)arg;
+    (void)info;
+    band->result = resizeBand(band->plane, band->row_begin, band->row_end);
+    return NULL;
+}
+
+static UTIL_ERRCODE_ENUM resizePlane(UTL_RESIZE_PLANE_STRUCT *plane, tp_queue tpq, MINT32 numTasks)
+{
+    UTIL_ERRCODE_ENUM result = UTIL_OK;
+
+    if (plane->filter == UTIL_RESIZE_BILINEAR)
+    {
+        result = initBilinearAxis(&plane->axis_x, plane->src_width, plane->dst_width);
+        if (result == UTIL_OK)
+            result = initBilinearAxis(&plane->axis_y, plane->src_height, plane->dst_height);
+    }
+    else
+    {
+        result = initAreaAxis(&plane->axis_x, plane->src_width, plane->dst_width);
+        if (result == UTIL_OK)
+            result = initAreaAxis(&plane->axis_y, plane->src_height, plane->dst_height);
+    }
+
+    if (result == UTIL_OK)
+    {
+        if (numTasks > plane->dst_height)
+            numTasks = plane->dst_height;
+
+        if (tpq == NULL || numTasks == 1)
+        {
+            result = resizeBand(plane, 0, plane->dst_height);
+        }
+        else
+        {
+            UTL_RESIZE_BAND_STRUCT bands[UTL_RESIZE_MAX_TASKS];
+            for (MINT32 i = 0; i < numTasks; i++)
+            {
+                bands[i].plane = plane;
+                bands[i].row_begin = plane->dst_height * i / numTasks;
+                bands[i].row_end = plane->dst_height * (i + 1) / numTasks;
+                bands[i].result = UTIL_OK;
+                if (tpq_add_work(tpq, resizeBandJob, &bands[i]) != 0)
+                    resizeBandJob(&bands[i], NULL);
+            }
+            tpq_exec(tpq, 0);
+
+            for (MINT32 i = 0; i < numTasks; i++)
+            {
+                if (bands[i].result != UTIL_OK)
+                    result = bands[i].result;
+            }
+        }
+    }
+
+    freeAxis(&plane->axis_x);
+    freeAxis(&plane->axis_y);
+    return result;
+}
+
+UTIL_ERRCODE_ENUM utilResizer(P_UTIL_BASE_IMAGE_STRUCT dst, P_UTIL_BASE_IMAGE_STRUCT src, UTL_IMAGE_FORMAT_ENUM ImgFmt,
+                              UTIL_RESIZE_FILTER_ENUM filter, tp_queue tpq, MINT32 numTasks)
+{
+    UTIL_ERRCODE_ENUM result = UTIL_OK;
+    UTL_RESIZE_PLANE_STRUCT plane;
+    MINT32 plane_num, p;
+
+    // error check
+    if (!dst || !src || !dst->data || !src->data)
+    {
+        result = UTIL_COMMON_ERR_NULL_BUFFER_POINTER;
+        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
+        return result;
+    }
+
+    if (src->width <= 0 || src->height <= 0 || dst->width <= 0 || dst->height <= 0 ||
+        filter < 0 || filter >= UTIL_RESIZE_FILTER_NUM || numTasks <= 0 || numTasks > UTL_RESIZE_MAX_TASKS)
+    {
+        result = UTIL_COMMON_ERR_INVALID_PARAMETER;
+        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
+        return result;
+    }
+
+    if (ImgFmt == UTL_IMAGE_FORMAT_YUV400)
+    {
+        plane_num = 1;
+    }
+    else if (ImgFmt == UTL_IMAGE_FORMAT_YUV420)
+    {
+        if ((src->width | src->height | dst->width | dst->height) & 1)
+        {
+            result = UTIL_COMMON_ERR_INVALID_PARAMETER;
+            LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
+            return result;
+        }
+        plane_num = 3;
+    }
+    else
+    {
+        result = UTIL_COMMON_ERR_UNSUPPORTED_IMAGE_FORMAT;
+        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
+        return result;
+    }
+
+    memset(&plane, 0, sizeof(plane));
+    plane.filter = filter;
+    plane.src = (const MUINT8 *)src->data;
+    plane.dst = (MUINT8 *)dst->data;
+    for (p = 0; p < plane_num && result == UTIL_OK; p++)
+    {
+        // Y, then U and V of half size
+        MINT32 shift = (p > 0) ? 1 : 0;
+        plane.src_width = src->width >> shift;
+        plane.src_height = src->height >> shift;
+        plane.dst_width = dst->width >> shift;
+        plane.dst_height = dst->height >> shift;
+
+        result = resizePlane(&plane, tpq, numTasks);
+
+        plane.src += plane.src_width * plane.src_height;
+        plane.dst += plane.dst_width * plane.dst_height;
+    }
+
+    if (result != UTIL_OK)
+        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
+
+    return result;
+}
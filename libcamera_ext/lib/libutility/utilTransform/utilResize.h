@@ -2,6 +2,18 @@
 #define _UTIL_RESIZE_BILINEAR_H_
 
 #include "MTKUtilCommon.h"
+#include "utilSystem/tpq.h"
+
+/// \details filter of utilResizer
+typedef enum UTIL_RESIZE_FILTER_ENUM
+{
+    UTIL_RESIZE_BILINEAR,   ///< the same sampling as utilBilinearResizer
+    UTIL_RESIZE_AREA,       ///< average of the covered source area, for downscaling
+    UTIL_RESIZE_FILTER_NUM
+} UTIL_RESIZE_FILTER_ENUM;
+
+/// max number of row bands of utilResizer
+#define UTL_RESIZE_MAX_TASKS (32)
 
 /**
  * \details bilinear resizer for YUV400 or RGB565 format
@@ -13,5 +25,24 @@
  */
 UTIL_ERRCODE_ENUM utilBilinearResizer(P_UTIL_BASE_IMAGE_STRUCT dst, P_UTIL_BASE_IMAGE_STRUCT src, UTL_IMAGE_FORMAT_ENUM ImgFmt);
 
-#endif /* _UTIL_RESIZE_BILINEAR_H_ */
+/**
+ * \details separable resizer for YUV400 or YUV420 (I420) format
+ * \fn UTIL_ERRCODE_ENUM utilResizer(P_UTIL_BASE_IMAGE_STRUCT dst, P_UTIL_BASE_IMAGE_STRUCT src, UTL_IMAGE_FORMAT_ENUM ImgFmt, UTIL_RESIZE_FILTER_ENUM filter, tp_queue tpq, MINT32 numTasks)
+ * \param[out] dst output image data
+ * \param[in] src input image data
+ * \param[in] ImgFmt input image format, YUV420 needs even sizes
+ * \param[in] filter resize filter
+ * \param[in] tpq thread pool to run the row bands on, or NULL to run on the calling thread
+ * \param[in] numTasks number of row bands of each plane (1 to UTL_RESIZE_MAX_TASKS)
+ * \return utility error code
+ *
+ * The coordinates and weights of each axis are computed once into tables,
+ * then each source row is filtered horizontally once and the output rows
+ * are filtered vertically from those. UTIL_RESIZE_BILINEAR gives the same
+ * output as utilBilinearResizer, except that the last source row and
+ * column are repeated where it reads past them.
+ */
+UTIL_ERRCODE_ENUM utilResizer(P_UTIL_BASE_IMAGE_STRUCT dst, P_UTIL_BASE_IMAGE_STRUCT src, UTL_IMAGE_FORMAT_ENUM ImgFmt,
+                              UTIL_RESIZE_FILTER_ENUM filter, tp_queue tpq, MINT32 numTasks);
 
+#endif /* _UTIL_RESIZE_BILINEAR_H_ */
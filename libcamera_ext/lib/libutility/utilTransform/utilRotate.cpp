@@ -11,280 +11,352 @@
 #include <string.h>
 #include "utilRotate.h"
 
-UTIL_ERRCODE_ENUM utilRotate(P_UTIL_CLIP_IMAGE_STRUCT dst, P_UTIL_CLIP_IMAGE_STRUCT src, UTIL_ANGLE angle)
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define ROTATE_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#define ROTATE_SSE2
+#include <emmintrin.h>
+#endif
+
+/*
+ * All rotations and mirrors are one of 8 pixel mappings from the source clip
+ * (x, y) to the destination clip (col, row):
+ *   not transposed: row = flip_y ? dstHeight-1-y : y, col = flip_x ? dstWidth-1-x : x
+ *   transposed:     row = flip_x ? dstHeight-1-x : x, col = flip_y ? dstWidth-1-y : y
+ *
+ * The transposed ones walk the source in 64x64 tiles of 8x8 blocks, so the
+ * columns written by a tile stay in cache, and each 8x8 block is transposed
+ * in registers. The others are row copies, reversed with SIMD if flip_x.
+ * Bands are rows of tiles (or rows), which write disjoint destination areas.
+ */
+#define ROTATE_TILE_SIZE    (64)
+#define ROTATE_BLOCK_SIZE   (8)
+
+typedef struct UTL_ROTATE_CONTEXT_STRUCT
 {
-    UTIL_ERRCODE_ENUM result = UTIL_OK;
-    MUINT8 *srcAddr = (MUINT8 *)src->data;
-    MUINT8 *dstAddr = (MUINT8 *)dst->data;
-    MUINT8 *srcRowAddr, *dstRowAddr, *dstColumnAddr;
-    MINT32 srcWidth  = src->clip_width;
-    MINT32 srcHeight = src->clip_height;
-    MINT32 srcPitch  = src->width;
-    MINT32 dstWidth  = dst->clip_width;
-    MINT32 dstHeight = dst->clip_height;
-    MINT32 dstPitch  = dst->width;
-    MINT32 srcX, srcY;
-    MINT32 minusDstPitch = -dstPitch;
+    const MUINT8 *src;      // top-left of the source clip
+    MINT32 srcPitch;
+    MINT32 srcWidth;
+    MINT32 srcHeight;
+    MUINT8 *dst;            // top-left of the destination clip
+    MINT32 dstPitch;
+    MINT32 dstWidth;
+    MINT32 dstHeight;
+    MBOOL transpose;
+    MBOOL flip_x;
+    MBOOL flip_y;
+} UTL_ROTATE_CONTEXT_STRUCT;
+
+typedef struct UTL_ROTATE_BAND_STRUCT
+{
+    const UTL_ROTATE_CONTEXT_STRUCT *ctx;
+    MINT32 y_begin;         // source rows
+    MINT32 y_end;
+} UTL_ROTATE_BAND_STRUCT;
 
-    // error check
-    if ((srcAddr == NULL) || (dstAddr == NULL))
+static inline MUINT8 *dstPixel(const UTL_ROTATE_CONTEXT_STRUCT *ctx, MINT32 x, MINT32 y)
+{
+    MINT32 row, col;
+    if (ctx->transpose)
     {
-        result = UTIL_COMMON_ERR_NULL_BUFFER_POINTER;
-        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
-        return result;
+        row = ctx->flip_x ? ctx->dstHeight - 1 - x : x;
+        col = ctx->flip_y ? ctx->dstWidth - 1 - y : y;
+    }
+    else
+    {
+        row = ctx->flip_y ? ctx->dstHeight - 1 - y : y;
+        col = ctx->flip_x ? ctx->dstWidth - 1 - x : x;
     }
+    return ctx->dst + row * ctx->dstPitch + col;
+}
 
-    // rotate with crop
-    switch(angle)
+// transposeBlock() writes the 8x8 block at (x, y) of the source, x and y multiples of 8 in the clip
+static void transposeBlock(const UTL_ROTATE_CONTEXT_STRUCT *ctx, MINT32 x, MINT32 y)
+{
+    const MUINT8 *src[ROTATE_BLOCK_SIZE];
+    MUINT8 *dst[ROTATE_BLOCK_SIZE];
+    MINT32 i;
+
+    // with flip_y the source rows are read bottom up, so each output row is in order
+    for (i = 0; i < ROTATE_BLOCK_SIZE; i++)
     {
-    case UTIL_ANGLE_000:
-        {
-            // image pointer
-            srcAddr += (src->clip_x) + ((src->clip_y) * (srcPitch));
-            dstAddr += (dst->clip_x) + ((dst->clip_y) * (dstPitch));
+        MINT32 sy = ctx->flip_y ? y + ROTATE_BLOCK_SIZE - 1 - i : y + i;
+        src[i] = ctx->src + sy * ctx->srcPitch + x;
+        dst[i] = dstPixel(ctx, x + i, ctx->flip_y ? y + ROTATE_BLOCK_SIZE - 1 : y);
+    }
 
-            // image copy
-            srcY = srcHeight;
-            while (--srcY >= 0)
-            {
-                memcpy(dstAddr, srcAddr, dstWidth);
-                srcAddr += srcPitch;
-                dstAddr += dstPitch;
-            }
-        }
-        break;
-    case UTIL_ANGLE_090:
+#if defined(ROTATE_NEON)
+    uint8x8x2_t v_t01 = vtrn_u8(vld1_u8(src[0]), vld1_u8(src[1]));
+    uint8x8x2_t v_t23 = vtrn_u8(vld1_u8(src[2]), vld1_u8(src[3]));
+    uint8x8x2_t v_t45 = vtrn_u8(vld1_u8(src[4]), vld1_u8(src[5]));
+    uint8x8x2_t v_t67 = vtrn_u8(vld1_u8(src[6]), vld1_u8(src[7]));
+    uint16x4x2_t v_u02 = vtrn_u16(vreinterpret_u16_u8(v_t01.val[0]), vreinterpret_u16_u8(v_t23.val[0]));
+    uint16x4x2_t v_u13 = vtrn_u16(vreinterpret_u16_u8(v_t01.val[1]), vreinterpret_u16_u8(v_t23.val[1]));
+    uint16x4x2_t v_u46 = vtrn_u16(vreinterpret_u16_u8(v_t45.val[0]), vreinterpret_u16_u8(v_t67.val[0]));
+    uint16x4x2_t v_u57 = vtrn_u16(vreinterpret_u16_u8(v_t45.val[1]), vreinterpret_u16_u8(v_t67.val[1]));
+    uint32x2x2_t v_w04 = vtrn_u32(vreinterpret_u32_u16(v_u02.val[0]), vreinterpret_u32_u16(v_u46.val[0]));
+    uint32x2x2_t v_w15 = vtrn_u32(vreinterpret_u32_u16(v_u13.val[0]), vreinterpret_u32_u16(v_u57.val[0]));
+    uint32x2x2_t v_w26 = vtrn_u32(vreinterpret_u32_u16(v_u02.val[1]), vreinterpret_u32_u16(v_u46.val[1]));
+    uint32x2x2_t v_w37 = vtrn_u32(vreinterpret_u32_u16(v_u13.val[1]), vreinterpret_u32_u16(v_u57.val[1]));
+    vst1_u8(dst[0], vreinterpret_u8_u32(v_w04.val[0]));
+    vst1_u8(dst[1], vreinterpret_u8_u32(v_w15.val[0]));
+    vst1_u8(dst[2], vreinterpret_u8_u32(v_w26.val[0]));
+    vst1_u8(dst[3], vreinterpret_u8_u32(v_w37.val[0]));
+    vst1_u8(dst[4], vreinterpret_u8_u32(v_w04.val[1]));
+    vst1_u8(dst[5], vreinterpret_u8_u32(v_w15.val[1]));
+    vst1_u8(dst[6], vreinterpret_u8_u32(v_w26.val[1]));
+    vst1_u8(dst[7], vreinterpret_u8_u32(v_w37.val[1]));
+#elif defined(ROTATE_SSE2)
+    __m128i v_b0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)src[0]), _mm_loadl_epi64((const __m128i *)src[1]));
+    __m128i v_b1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)src[2]), _mm_loadl_epi64((const __m128i *)src[3]));
+    __m128i v_b2 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)src[4]), _mm_loadl_epi64((const __m128i *)src[5]));
+    __m128i v_b3 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)src[6]), _mm_loadl_epi64((const __m128i *)src[7]));
+    __m128i v_c0 = _mm_unpacklo_epi16(v_b0, v_b1);
+    __m128i v_c1 = _mm_unpackhi_epi16(v_b0, v_b1);
+    __m128i v_c2 = _mm_unpacklo_epi16(v_b2, v_b3);
+    __m128i v_c3 = _mm_unpackhi_epi16(v_b2, v_b3);
+    __m128i v_d0 = _mm_unpacklo_epi32(v_c0, v_c2);
+    __m128i v_d1 = _mm_unpackhi_epi32(v_c0, v_c2);
+    __m128i v_d2 = _mm_unpacklo_epi32(v_c1, v_c3);
+    __m128i v_d3 = _mm_unpackhi_epi32(v_c1, v_c3);
+    _mm_storel_epi64((__m128i *)dst[0], v_d0);
+    _mm_storel_epi64((__m128i *)dst[1], _mm_unpackhi_epi64(v_d0, v_d0));
+    _mm_storel_epi64((__m128i *)dst[2], v_d1);
+    _mm_storel_epi64((__m128i *)dst[3], _mm_unpackhi_epi64(v_d1, v_d1));
+    _mm_storel_epi64((__m128i *)dst[4], v_d2);
+    _mm_storel_epi64((__m128i *)dst[5], _mm_unpackhi_epi64(v_d2, v_d2));
+    _mm_storel_epi64((__m128i *)dst[6], v_d3);
+    _mm_storel_epi64((__m128i *)dst[7], _mm_unpackhi_epi64(v_d3, v_d3));
+#else
+    for (i = 0; i < ROTATE_BLOCK_SIZE; i++)
+    {
+        for (MINT32 j = 0; j < ROTATE_BLOCK_SIZE; j++)
+            dst[i][j] = src[j][i];
+    }
+#endif
+}
+
+static void transposeBand(const UTL_ROTATE_CONTEXT_STRUCT *ctx, MINT32 y_begin, MINT32 y_end)
+{
+    for (MINT32 ty = y_begin; ty < y_end; ty += ROTATE_TILE_SIZE)
+    {
+        MINT32 tile_h = (y_end - ty < ROTATE_TILE_SIZE) ? y_end - ty : ROTATE_TILE_SIZE;
+        MINT32 block_h = tile_h & ~(ROTATE_BLOCK_SIZE - 1);
+
+        for (MINT32 tx = 0; tx < ctx->srcWidth; tx += ROTATE_TILE_SIZE)
         {
-            // image pointer
-            srcAddr += (src->clip_x) + ((src->clip_y) * (srcPitch));
-            dstAddr += (dst->clip_x) + ((dst->clip_y) * (dstPitch));
-            srcRowAddr = srcAddr;
-            dstColumnAddr = dstAddr + dstWidth  - 1 ;
-
-            // image copy
-            srcY = srcHeight;
-            while (--srcY >= 0)
+            MINT32 tile_w = (ctx->srcWidth - tx < ROTATE_TILE_SIZE) ? ctx->srcWidth - tx : ROTATE_TILE_SIZE;
+            MINT32 block_w = tile_w & ~(ROTATE_BLOCK_SIZE - 1);
+            MINT32 x, y;
+
+            for (y = 0; y < block_h; y += ROTATE_BLOCK_SIZE)
             {
-                srcAddr = srcRowAddr;
-                dstAddr = dstColumnAddr;
-                srcX = srcWidth;
-
-                while (--srcX >= 0)
-                {
-                    *dstAddr = *srcAddr;
-                    srcAddr++;
-                    dstAddr += dstPitch;
-                }
-
-                srcRowAddr += srcPitch;
-                dstColumnAddr--;
+                for (x = 0; x < block_w; x += ROTATE_BLOCK_SIZE)
+                    transposeBlock(ctx, tx + x, ty + y);
             }
-        }
-        break;
-    case UTIL_ANGLE_180:
-        {
-            // image pointer
-            srcAddr += (src->clip_x) + ((src->clip_y) * (srcPitch));
-            dstAddr += (dst->clip_x) + ((dst->clip_y) * (dstPitch));
-            srcRowAddr = srcAddr;
-            dstRowAddr = dstAddr + (dstPitch * (dstHeight - 1)) + (dstWidth - 1) ;
-
-            // image copy
-            srcY = srcHeight;
-            while (--srcY >= 0)
+
+            // the right and bottom edges of the tile not in 8x8 blocks
+            for (y = 0; y < tile_h; y++)
             {
-                srcAddr = srcRowAddr;
-                dstAddr = dstRowAddr;
-
-                srcX = srcWidth;
-                while (--srcX >= 0)
-                {
-                    *dstAddr = *srcAddr;
-                    srcAddr++;
-                    dstAddr--;
-                }
-
-                srcRowAddr += srcPitch;
-                dstRowAddr -= dstPitch;
+                const MUINT8 *src = ctx->src + (ty + y) * ctx->srcPitch;
+                for (x = (y < block_h) ? block_w : 0; x < tile_w; x++)
+                    *dstPixel(ctx, tx + x, ty + y) = src[tx + x];
             }
         }
-        break;
-    case UTIL_ANGLE_270:
+    }
+}
+
+static void reverseCopy(MUINT8 *dst, const MUINT8 *src, MINT32 width)
+{
+    // dst[width - 1 - x] = src[x]
+    MINT32 x = 0;
+#if defined(ROTATE_NEON)
+    for (; x + 16 <= width; x += 16)
+    {
+        uint8x16_t v_rev = vrev64q_u8(vld1q_u8(src + x));
+        vst1q_u8(dst + width - 16 - x, vcombine_u8(vget_high_u8(v_rev), vget_low_u8(v_rev)));
+    }
+#elif defined(ROTATE_SSE2)
+    for (; x + 16 <= width; x += 16)
+    {
+        __m128i v_rev = _mm_loadu_si128((const __m128i *)(src + x));
+        v_rev = _mm_shuffle_epi32(v_rev, _MM_SHUFFLE(0, 1, 2, 3));
+        v_rev = _mm_shufflelo_epi16(v_rev, _MM_SHUFFLE(2, 3, 0, 1));
+        v_rev = _mm_shufflehi_epi16(v_rev, _MM_SHUFFLE(2, 3, 0, 1));
+        v_rev = _mm_or_si128(_mm_slli_epi16(v_rev, 8), _mm_srli_epi16(v_rev, 8));
+        _mm_storeu_si128((__m128i *)(dst + width - 16 - x), v_rev);
+    }
+#endif
+    for (; x < width; x++)
+        dst[width - 1 - x] = src[x];
+}
+
+static void copyBand(const UTL_ROTATE_CONTEXT_STRUCT *ctx, MINT32 y_begin, MINT32 y_end)
+{
+    for (MINT32 y = y_begin; y < y_end; y++)
+    {
+        const MUINT8 *src = ctx->src + y * ctx->srcPitch;
+        MINT32 row = ctx->flip_y ? ctx->dstHeight - 1 - y : y;
+        MUINT8 *dst = ctx->dst + row * ctx->dstPitch;
+
+        if (ctx->flip_x)
+            reverseCopy(dst + ctx->dstWidth - ctx->srcWidth, src, ctx->srcWidth);
+        else
+            memcpy(dst, src, ctx->dstWidth);
+    }
+}
+
+static void *rotateBandJob(void *arg, rtinfo *info)
+{
+    UTL_ROTATE_BAND_STRUCT *band = (UTL_ROTATE_BAND_STRUCT *)arg;
+    (void)info;
+    if (band->ctx->transpose)
+        transposeBand(band->ctx, band->y_begin, band->y_end);
+    else
+        copyBand(band->ctx, band->y_begin, band->y_end);
+    return NULL;
+}
+
+static UTIL_ERRCODE_ENUM rotateImage(P_UTIL_CLIP_IMAGE_STRUCT dst, P_UTIL_CLIP_IMAGE_STRUCT src,
+                                     MBOOL transpose, MBOOL flip_x, MBOOL flip_y, tp_queue tpq, MINT32 numTasks)
+{
+    UTL_ROTATE_CONTEXT_STRUCT ctx;
+    UTL_ROTATE_BAND_STRUCT bands[UTL_ROTATE_MAX_TASKS];
+    MINT32 units, unit_rows, i;
+
+    ctx.src = (const MUINT8 *)src->data + src->clip_x + src->clip_y * src->width;
+    ctx.srcPitch = src->width;
+    ctx.srcWidth = src->clip_width;
+    ctx.srcHeight = src->clip_height;
+    ctx.dst = (MUINT8 *)dst->data + dst->clip_x + dst->clip_y * dst->width;
+    ctx.dstPitch = dst->width;
+    ctx.dstWidth = dst->clip_width;
+    ctx.dstHeight = dst->clip_height;
+    ctx.transpose = transpose;
+    ctx.flip_x = flip_x;
+    ctx.flip_y = flip_y;
+
+    // bands of tile rows, or of rows
+    unit_rows = transpose ? ROTATE_TILE_SIZE : 1;
+    units = (ctx.srcHeight + unit_rows - 1) / unit_rows;
+    if (numTasks > units)
+        numTasks = units;
+    if (numTasks <= 1 || tpq == NULL)
+        numTasks = 1;
+
+    for (i = 0; i < numTasks; i++)
+    {
+        bands[i].ctx = &ctx;
+        bands[i].y_begin = units * i / numTasks * unit_rows;
+        bands[i].y_end = units * (i + 1) / numTasks * unit_rows;
+        if (bands[i].y_end > ctx.srcHeight)
+            bands[i].y_end = ctx.srcHeight;
+    }
+
+    if (numTasks == 1)
+    {
+        rotateBandJob(&bands[0], NULL);
+    }
+    else
+    {
+        for (i = 0; i < numTasks; i++)
         {
-            // image pointer
-            srcAddr += (src->clip_x) + ((src->clip_y) * (srcPitch));
-            dstAddr += (dst->clip_x) + ((dst->clip_y) * (dstPitch));
-            srcRowAddr = srcAddr;
-            dstColumnAddr = dstAddr + (dstPitch * (dstHeight - 1));
-
-            // using minusDstPitch, not dstPitch => speed up 10% in armulator
-            // image copy
-            srcY = srcHeight;
-            while (--srcY >= 0)
-            {
-                srcAddr = srcRowAddr;
-                dstAddr = dstColumnAddr;
-
-                srcX = srcWidth;
-                while (--srcX >= 0)
-                {
-                    *dstAddr = *srcAddr;
-                    srcAddr++;
-                    dstAddr += minusDstPitch;
-                }
-
-                srcRowAddr += srcPitch;
-                dstColumnAddr++;
-            }
+            if (tpq_add_work(tpq, rotateBandJob, &bands[i]) != 0)
+                rotateBandJob(&bands[i], NULL);
         }
-        break;
-    default:
-        result = UTIL_COMMON_ERR_INVALID_PARAMETER;
-        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
-        return result;
-        break;
+        tpq_exec(tpq, 0);
     }
 
-    return result;
+    return UTIL_OK;
 }
 
-UTIL_ERRCODE_ENUM utilMirror(P_UTIL_CLIP_IMAGE_STRUCT dst, P_UTIL_CLIP_IMAGE_STRUCT src, UTIL_ANGLE angle)
+static UTIL_ERRCODE_ENUM checkRotateParam(P_UTIL_CLIP_IMAGE_STRUCT dst, P_UTIL_CLIP_IMAGE_STRUCT src, UTIL_ANGLE angle, MINT32 numTasks)
 {
     UTIL_ERRCODE_ENUM result = UTIL_OK;
-    MUINT8 *srcAddr = (MUINT8 *)src->data;
-    MUINT8 *dstAddr = (MUINT8 *)dst->data;
-    MUINT8 *srcRowAddr, *dstRowAddr, *dstColumnAddr;
-    MINT32 srcWidth  = src->clip_width;
-    MINT32 srcHeight = src->clip_height;
-    MINT32 srcPitch  = src->width;
-    MINT32 dstWidth  = dst->clip_width;
-    MINT32 dstHeight = dst->clip_height;
-    MINT32 dstPitch  = dst->width;
-    MINT32 srcX, srcY;
-    MINT32 minusDstPitch = -dstPitch;
 
     // error check
-    if ((srcAddr == NULL) || (dstAddr == NULL))
+    if ((src->data == NULL) || (dst->data == NULL))
     {
         result = UTIL_COMMON_ERR_NULL_BUFFER_POINTER;
         LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
         return result;
     }
 
-    // rotate with crop
+    if ((angle < UTIL_ANGLE_000) || (angle > UTIL_ANGLE_270) || (numTasks <= 0) || (numTasks > UTL_ROTATE_MAX_TASKS))
+    {
+        result = UTIL_COMMON_ERR_INVALID_PARAMETER;
+        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
+        return result;
+    }
+
+    return result;
+}
+
+UTIL_ERRCODE_ENUM utilRotate(P_UTIL_CLIP_IMAGE_STRUCT dst, P_UTIL_CLIP_IMAGE_STRUCT src, UTIL_ANGLE angle, tp_queue tpq, MINT32 numTasks)
+{
+    UTIL_ERRCODE_ENUM result = checkRotateParam(dst, src, angle, numTasks);
+    if (result != UTIL_OK)
+        return result;
+
+    // rotate with crop, clockwise
     switch(angle)
     {
     case UTIL_ANGLE_000:
-        {
-            // image pointer
-            srcAddr += (src->clip_x) + ((src->clip_y) * (srcPitch));
-            dstAddr += (dst->clip_x) + ((dst->clip_y) * (dstPitch));
-            srcRowAddr = srcAddr;
-            dstRowAddr = dstAddr + dstWidth - 1 ;
-
-            // image copy
-            srcY = srcHeight;
-            while (--srcY >= 0)
-            {
-                srcAddr = srcRowAddr;
-                dstAddr = dstRowAddr;
-                srcX = srcWidth;
-
-                while (--srcX >= 0)
-                {
-                    *dstAddr = *srcAddr;
-                    srcAddr++;
-                    dstAddr--;
-                }
-
-                srcRowAddr += srcPitch;
-                dstRowAddr += dstPitch;
-            }
-        }
+        result = rotateImage(dst, src, false, false, false, tpq, numTasks);
         break;
     case UTIL_ANGLE_090:
-        {
-            // image pointer
-            srcAddr += (src->clip_x) + ((src->clip_y) * (srcPitch));
-            dstAddr += (dst->clip_x) + ((dst->clip_y) * (dstPitch));
-            srcRowAddr = srcAddr;
-            dstColumnAddr = dstAddr;
-
-            // image copy
-            srcY = srcHeight;
-            while (--srcY >= 0)
-            {
-                srcAddr = srcRowAddr;           // set to the start of row
-                dstAddr = dstColumnAddr;        // set to the start of column
-                srcX = srcWidth;                // set loop time
-
-                while (--srcX >= 0)
-                {
-                    *dstAddr = *srcAddr;
-                    srcAddr++;
-                    dstAddr += dstPitch;
-                }
-
-                srcRowAddr += srcPitch;         // read from top to bottom
-                dstColumnAddr++;                // write from right to left
-            }
-        }
+        result = rotateImage(dst, src, true, false, true, tpq, numTasks);
         break;
     case UTIL_ANGLE_180:
-        {
-            // image pointer
-            srcAddr += (src->clip_x) + ((src->clip_y) * (srcPitch));
-            dstAddr += (dst->clip_x) + ((dst->clip_y + dstHeight - 1) * (dstPitch));
-
-            srcY = srcHeight;
-            while (--srcY >= 0)
-            {
-                memcpy(dstAddr, srcAddr, dstWidth);
-                srcAddr += srcPitch;
-                dstAddr -= dstPitch;
-            }
-        }
+        result = rotateImage(dst, src, false, true, true, tpq, numTasks);
         break;
     case UTIL_ANGLE_270:
-        {
-            // image pointer
-            srcAddr += (src->clip_x) + ((src->clip_y) * (srcPitch));
-            dstAddr += (dst->clip_x) + ((dst->clip_y) * (dstPitch));
-            srcRowAddr = srcAddr;
-            dstColumnAddr = dstAddr + (dstPitch * (dstHeight - 1)) + (dstWidth - 1) ;
-
-            // using minusDstPitch, not dstPitch => speed up 10% in armulator
-            // image copy
-            srcY = srcHeight;
-            while (--srcY >= 0)
-            {
-                srcAddr = srcRowAddr;
-                dstAddr = dstColumnAddr;
+    default:
+        result = rotateImage(dst, src, true, true, false, tpq, numTasks);
+        break;
+    }
 
-                srcX = srcWidth;
+    return result;
+}
 
-                while (--srcX >= 0)
-                {
-                    *dstAddr = *srcAddr;
-                    srcAddr++;
-                    dstAddr += minusDstPitch;
-                }
+UTIL_ERRCODE_ENUM utilRotate(P_UTIL_CLIP_IMAGE_STRUCT dst, P_UTIL_CLIP_IMAGE_STRUCT src, UTIL_ANGLE angle)
+{
+    return utilRotate(dst, src, angle, NULL, 1);
+}
 
-                srcRowAddr += srcPitch;
-                dstColumnAddr--;
-            }
-        }
+UTIL_ERRCODE_ENUM utilMirror(P_UTIL_CLIP_IMAGE_STRUCT dst, P_UTIL_CLIP_IMAGE_STRUCT src, UTIL_ANGLE angle, tp_queue tpq, MINT32 numTasks)
+{
+    UTIL_ERRCODE_ENUM result = checkRotateParam(dst, src, angle, numTasks);
+    if (result != UTIL_OK)
+        return result;
+
+    // mirror along the line of the angle
+    switch(angle)
+    {
+    case UTIL_ANGLE_000:
+        result = rotateImage(dst, src, false, true, false, tpq, numTasks);
+        break;
+    case UTIL_ANGLE_090:
+        result = rotateImage(dst, src, true, false, false, tpq, numTasks);
+        break;
+    case UTIL_ANGLE_180:
+        result = rotateImage(dst, src, false, false, true, tpq, numTasks);
         break;
+    case UTIL_ANGLE_270:
     default:
-        result = UTIL_COMMON_ERR_INVALID_PARAMETER;
-        LOGD("[%s] Error Message: %s\n", LOG_TAG, UTIL_GET_ERRCODE_NAME(result));
-        return result;
+        result = rotateImage(dst, src, true, true, true, tpq, numTasks);
         break;
     }
 
     return result;
 }
 
+UTIL_ERRCODE_ENUM utilMirror(P_UTIL_CLIP_IMAGE_STRUCT dst, P_UTIL_CLIP_IMAGE_STRUCT src, UTIL_ANGLE angle)
+{
+    return utilMirror(dst, src, angle, NULL, 1);
+}
+
 UTIL_ERRCODE_ENUM utilImageClip(P_UTIL_CLIP_IMAGE_STRUCT dst, P_UTIL_CLIP_IMAGE_STRUCT src, UTL_IMAGE_FORMAT_ENUM img_fmt)
 {
     UTIL_ERRCODE_ENUM result = UTIL_OK;
@@ -2,6 +2,7 @@
 #define _UTIL_ROTATE_H_
 
 #include "MTKUtilCommon.h"
+#include "utilSystem/tpq.h"
 
 /// \details rotation of mirrorring angle
 typedef enum UTIL_ANGLE
@@ -12,6 +13,9 @@ typedef enum UTIL_ANGLE
     UTIL_ANGLE_270
 } UTIL_ANGLE;
 
+/// max number of bands of utilRotate and utilMirror
+#define UTL_ROTATE_MAX_TASKS (32)
+
 /**
  * \brief rotation function for Y
  * \details image can be rotated for 4 kind of angles, 0 deg can be used for \b crop
@@ -23,6 +27,19 @@ typedef enum UTIL_ANGLE
  */
 UTIL_ERRCODE_ENUM utilRotate(P_UTIL_CLIP_IMAGE_STRUCT dst, P_UTIL_CLIP_IMAGE_STRUCT src, UTIL_ANGLE angle);
 
+/**
+ * \brief rotation function for Y (multi-core version)
+ * \details 90 and 270 deg are done by 8x8 block transposes in 64x64 tiles, and the bands of tiles run on tpq
+ * \fn UTIL_ERRCODE_ENUM utilRotate(P_UTIL_CLIP_IMAGE_STRUCT dst, P_UTIL_CLIP_IMAGE_STRUCT src, UTIL_ANGLE angle, tp_queue tpq, MINT32 numTasks)
+ * \param[out] dst output image data
+ * \param[in] src input image data
+ * \param[in] angle rotation angle
+ * \param[in] tpq thread pool to run the bands on, or NULL to run on the calling thread
+ * \param[in] numTasks number of bands (1 to UTL_ROTATE_MAX_TASKS)
+ * \return utility error code
+ */
+UTIL_ERRCODE_ENUM utilRotate(P_UTIL_CLIP_IMAGE_STRUCT dst, P_UTIL_CLIP_IMAGE_STRUCT src, UTIL_ANGLE angle, tp_queue tpq, MINT32 numTasks);
+
 /**
  * \brief mirror function for Y
  * \details image can be mirror for 4 kind of angles
@@ -34,6 +51,18 @@ UTIL_ERRCODE_ENUM utilRotate(P_UTIL_CLIP_IMAGE_STRUCT dst, P_UTIL_CLIP_IMAGE_STR
  */
 UTIL_ERRCODE_ENUM utilMirror(P_UTIL_CLIP_IMAGE_STRUCT dst, P_UTIL_CLIP_IMAGE_STRUCT src, UTIL_ANGLE angle);
 
+/**
+ * \brief mirror function for Y (multi-core version)
+ * \fn UTIL_ERRCODE_ENUM utilMirror(P_UTIL_CLIP_IMAGE_STRUCT dst, P_UTIL_CLIP_IMAGE_STRUCT src, UTIL_ANGLE angle, tp_queue tpq, MINT32 numTasks)
+ * \param[out] dst output image data
+ * \param[in] src input image data
+ * \param[in] angle angle of mirrorring line
+ * \param[in] tpq thread pool to run the bands on, or NULL to run on the calling thread
+ * \param[in] numTasks number of bands (1 to UTL_ROTATE_MAX_TASKS)
+ * \return utility error code
+ */
+UTIL_ERRCODE_ENUM utilMirror(P_UTIL_CLIP_IMAGE_STRUCT dst, P_UTIL_CLIP_IMAGE_STRUCT src, UTIL_ANGLE angle, tp_queue tpq, MINT32 numTasks);
+
 /**
  * \brief clip function for YUV400 or YUV420 format
  * \details image clipping by utilRotate by 0 degree
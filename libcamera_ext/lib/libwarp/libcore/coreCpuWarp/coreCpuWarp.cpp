@@ -1,8 +1,12 @@
+#define LOG_TAG "coreCpuWarp"
 #define MTK_LOG_ENABLE 1
+#include <stdlib.h>
+#include <string.h>
 #include "coreCpuWarp.h"
 
 #ifdef SIM_MAIN
 #define    MY_LOGD        printf
+#define    LOGD           printf
 #else
 #include <android/log.h>
 #define LOGD(...)  __android_log_print(ANDROID_LOG_DEBUG,LOG_TAG,##__VA_ARGS__) 
@@ -11,11 +15,57 @@
 /*
     Public
 */
+CoreCpuWarp::CoreCpuWarp()
+{
+    memset(&map_cache, 0, sizeof(map_cache));
+    map_cache_enable = true;
+}
+
+CoreCpuWarp::~CoreCpuWarp()
+{
+    CpuWarpingFreeMap();
+}
+
 void CoreCpuWarp::CpuWarpingInit(void)
 {
 }
 
 void CoreCpuWarp::CpuWarpingMain(void)
+{
+    bool compile = false;
+
+    if (!CpuWarpingLookupMap(&compile))
+    {
+        CpuWarpingDirect();
+        return;
+    }
+
+    // a new map is compiled tile by tile, each tile is warped while its table is in cache
+    for (int i = 0; i < map_cache.Hout; i += CPU_WARP_TILE_ROWS)
+    {
+        int i_end = MIN(i + CPU_WARP_TILE_ROWS, map_cache.Hout);
+        if (compile)
+            CpuWarpingCompileRows(i, i_end);
+        CpuWarpingMapRows(i, i_end);
+    }
+}
+
+void CoreCpuWarp::CpuWarpingReset(void)
+{
+    CpuWarpingFreeMap();
+}
+
+void CoreCpuWarp::CpuWarpingSetMapCache(bool enable)
+{
+    map_cache_enable = enable;
+    if (!enable)
+        CpuWarpingFreeMap();
+}
+
+/*
+    Private
+*/
+void CoreCpuWarp::CpuWarpingDirect(void)
 {
     unsigned char *I = (unsigned char *)core_info.SrcBuffer;
     unsigned char *Iout = (unsigned char *)core_info.DstBuffer;
@@ -178,13 +228,234 @@ void CoreCpuWarp::CpuWarpingMain(void)
 
 }
 
-void CoreCpuWarp::CpuWarpingReset(void)
+// source position of output pixel (i, j) in 1/16 pixel, as CpuWarpingDirect computes it
+static void CpuWarpPoint(const int *WarpX, const int *WarpY, int w, int h, int W, int H,
+                         int i, int j, int *src_x, int *src_y)
 {
+    int wa = w-1;
+    int Wa = W-1;
+    int ha = h-1;
+    int Ha = H-1;
+    int ptx = j * wa * 32 / Wa;
+    int pty = i * ha * 32 / Ha;
+    int x1 = (ptx>>5);
+    int y1 = (pty>>5);
+    int idx2, xa, ya, w1, w2, w3, w4, warpx, warpy;
+
+    if(y1>ha-1){
+        y1 = ha-1;
+        pty = (y1<<5)+32;
+
+        if (x1>wa-1 ){
+         x1 = wa-1;
+         ptx = (x1<<5)+32;
+        }
+    }
+
+    idx2 = y1*w+x1;
+    xa = ptx - (x1<<5);
+    ya = pty - (y1<<5);
+
+    w1 = (32-xa)*(32-ya);
+    w2 = (xa)*(32-ya);
+    w3 = (32-xa)*(ya);
+    w4 = (xa)*(ya);
+
+    warpx = WarpX[idx2]*w1 + WarpX[idx2+1]*w2 + WarpX[idx2+w]*w3 + WarpX[idx2+w+1]*w4;
+    warpy = WarpY[idx2]*w1 + WarpY[idx2+1]*w2 + WarpY[idx2+w]*w3 + WarpY[idx2+w+1]*w4;
+
+    *src_x = (warpx / 1024);
+    *src_y = (warpy / 1024);
+}
+
+bool CoreCpuWarp::CpuWarpingLookupMap(bool* compile)
+{
+    CPU_WARP_MAP_CACHE* c = &map_cache;
+    int W = core_info.Width;
+    int H = core_info.Height;
+    int Wout = core_info.ClipWidth;
+    int Hout = core_info.ClipHeight;
+    int w = core_info.WarpMapSize[0][0];
+    int h = core_info.WarpMapSize[0][1];
+    const int *WarpX = (const int *)core_info.WarpMapAddr[0][0];
+    const int *WarpY = (const int *)core_info.WarpMapAddr[0][1];
+    int grid_size = w * h;
+
+    // odd output sizes write the chroma planes out of order, warp them as before
+    if (!map_cache_enable || (Wout & 1) || (Hout & 1) || Wout <= 0 || Hout <= 0 ||
+        W < 2 || H < 2 || w < 2 || h < 2)
+        return false;
+
+    // the same sizes and warp map as the kept copy; memcmp stops at the first
+    // changed word, so a changed map costs less than hashing it would
+    if (c->Grid && c->W == W && c->H == H && c->Wout == Wout && c->Hout == Hout &&
+        c->w == w && c->h == h &&
+        memcmp(c->Grid, WarpX, grid_size * sizeof(int)) == 0 &&
+        memcmp(c->Grid + grid_size, WarpY, grid_size * sizeof(int)) == 0)
+    {
+        *compile = false;
+        return true;
+    }
+
+    if (!c->Grid || c->Wout != Wout || c->Hout != Hout || c->w * c->h != grid_size)
+    {
+        CpuWarpingFreeMap();
+        // one more, the last column reads a zero weighted sample past the Y map
+        c->Grid = (int *)calloc(2 * grid_size + 1, sizeof(int));
+        c->YOffset = (MINT32 *)malloc(Wout * Hout * sizeof(MINT32));
+        c->YFrac = (MUINT8 *)malloc(Wout * Hout);
+        c->UVOffset = (MINT32 *)malloc((Wout/2) * (Hout/2) * sizeof(MINT32));
+        c->UVFrac = (MUINT8 *)malloc((Wout/2) * (Hout/2));
+        if (!c->Grid || !c->YOffset || !c->YFrac || !c->UVOffset || !c->UVFrac)
+        {
+            LOGD("[%s] no memory for a %dx%d warp map, warp without it\n", LOG_TAG, Wout, Hout);
+            CpuWarpingFreeMap();
+            return false;
+        }
+    }
+
+    c->W = W;
+    c->H = H;
+    c->Wout = Wout;
+    c->Hout = Hout;
+    c->w = w;
+    c->h = h;
+    memcpy(c->Grid, WarpX, grid_size * sizeof(int));
+    memcpy(c->Grid + grid_size, WarpY, grid_size * sizeof(int));
+    *compile = true;
+    return true;
+}
+
+// output rows [row_begin, row_end) of the map, row_begin and row_end even
+void CoreCpuWarp::CpuWarpingCompileRows(int row_begin, int row_end)
+{
+    CPU_WARP_MAP_CACHE* c = &map_cache;
+    const int *WarpX = c->Grid;
+    const int *WarpY = c->Grid + c->w * c->h;
+    int W = c->W;
+    int H = c->H;
+    int Wout = c->Wout;
+    int ptx, pty, x1, y1, xs, ys;
+
+    for (int i = row_begin; i < row_end; i++)
+    {
+        MINT32 *off = c->YOffset + i * Wout;
+        MUINT8 *frac = c->YFrac + i * Wout;
+        MINT32 *uv_off = c->UVOffset + (i/2) * (Wout/2);
+        MUINT8 *uv_frac = c->UVFrac + (i/2) * (Wout/2);
+
+        for (int j = 0; j < Wout; j++)
+        {
+            CpuWarpPoint(WarpX, WarpY, c->w, c->h, W, H, i, j, &ptx, &pty);
+            x1 = (ptx / 16);
+            y1 = (pty / 16);
+
+            // the chroma sample is the one of the last pixel of each 2x2 block
+            bool chroma = (i & 1) && (j & 1);
+
+            if (x1<0 || x1>W-2 || y1<0 || y1>H-2){
+                xs = MAX(x1, 0);
+                xs = MIN(xs, W-1);
+                ys = MAX(y1, 0);
+                ys = MIN(ys,H-1);
+                off[j] = ys * W + xs;
+                frac[j] = 0;
+                if (chroma)
+                {
+                    // the nearest sample, clamped where the direct warp reads outside the plane
+                    uv_off[j/2] = (ys/2)*(W/2)+(xs/2);
+                    uv_frac[j/2] = 0;
+                }
+                continue;
+            }
+
+            off[j] = y1*W+x1;
+            frac[j] = (MUINT8)((ptx - (x1<<4)) | ((pty - (y1<<4)) << 4));
+            if (chroma)
+            {
+                ptx = ptx/2;
+                pty = pty/2;
+                x1 = (ptx / 16);
+                y1 = (pty / 16);
+                uv_off[j/2] = y1*W/2+x1;
+                uv_frac[j/2] = (MUINT8)((ptx - (x1<<4)) | ((pty - (y1<<4)) << 4));
+            }
+        }
+    }
+}
+
+// bilinear sample at p, fractions in 1/16 pixel, the same sum as CpuWarpingDirect
+static inline MUINT8 CpuWarpSample(const unsigned char *p, int stride, int f)
+{
+    int xa = f & 15;
+    int ya = f >> 4;
+    int top = p[0] * (16-xa) + p[1] * xa;
+    int bot = p[stride] * (16-xa) + p[stride+1] * xa;
+    return (MUINT8)((top * (16-ya) + bot * ya) >> 8);
+}
+
+// warps output rows [row_begin, row_end) with the compiled map, row_begin and row_end even
+void CoreCpuWarp::CpuWarpingMapRows(int row_begin, int row_end)
+{
+    const CPU_WARP_MAP_CACHE* c = &map_cache;
+    const unsigned char *I = (const unsigned char *)core_info.SrcBuffer;
+    unsigned char *Iout = (unsigned char *)core_info.DstBuffer;
+    int W = c->W;
+    int Wout = c->Wout;
+    int psz1 = c->H * W;
+    int qsz1 = (psz1>>2);
+    int psz2 = c->Hout * Wout;
+    int qsz2 = (psz2>>2);
+    const unsigned char *Iv = I + psz1;
+    const unsigned char *Iu = Iv + qsz1;
+
+    for (int i = row_begin; i < row_end; i++)
+    {
+        const MINT32 *off = c->YOffset + i * Wout;
+        const MUINT8 *frac = c->YFrac + i * Wout;
+        unsigned char *out = Iout + i * Wout;
+
+        for (int j = 0; j < Wout; j++)
+        {
+            int f = frac[j];
+            out[j] = f ? CpuWarpSample(I + off[j], W, f) : I[off[j]];
+        }
+    }
+
+    for (int i = row_begin/2; i < row_end/2; i++)
+    {
+        const MINT32 *off = c->UVOffset + i * (Wout/2);
+        const MUINT8 *frac = c->UVFrac + i * (Wout/2);
+        unsigned char *out_v = Iout + psz2 + i * (Wout/2);
+        unsigned char *out_u = out_v + qsz2;
+
+        for (int j = 0; j < Wout/2; j++)
+        {
+            int f = frac[j];
+            if (f)
+            {
+                out_v[j] = CpuWarpSample(Iv + off[j], W/2, f);
+                out_u[j] = CpuWarpSample(Iu + off[j], W/2, f);
+            }
+            else
+            {
+                out_v[j] = Iv[off[j]];
+                out_u[j] = Iu[off[j]];
+            }
+        }
+    }
+}
+
+void CoreCpuWarp::CpuWarpingFreeMap(void)
+{
+    free(map_cache.Grid);
+    free(map_cache.YOffset);
+    free(map_cache.YFrac);
+    free(map_cache.UVOffset);
+    free(map_cache.UVFrac);
+    memset(&map_cache, 0, sizeof(map_cache));
 }
 
-/*
-    Private
-*/
 bool CoreCpuWarp::CpuWarping()
 {
     bool OK = true;
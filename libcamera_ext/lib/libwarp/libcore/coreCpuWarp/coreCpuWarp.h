@@ -89,16 +89,46 @@ typedef struct CPU_WARP_RESULT
     CORE_ERRCODE_ENUM       RetCode;                    // returned status
 }CPU_WARP_RESULT;
 
+// compiled warp map: the source sample of every output pixel for one warp map and resolution
+// It takes 6.25 bytes per output pixel, 5 for Y and 1.25 for chroma: about 13 MB at
+// 1920x1080 and 52 MB at 3840x2160, for as long as the CoreCpuWarp lives or until
+// CpuWarpingReset; turn it off with CpuWarpingSetMapCache(false) where that is too much.
+typedef struct CPU_WARP_MAP_CACHE
+{
+    int W, H, Wout, Hout, w, h;
+    int* Grid;                                       // copy of the X and Y warp maps, w * h each
+    MINT32* YOffset;                                 // Wout * Hout source offsets in the Y plane
+    MUINT8* YFrac;                                   // x | y << 4 fractions in 1/16 pixel, 0 to copy
+    MINT32* UVOffset;                                // (Wout/2) * (Hout/2) offsets from the V plane
+    MUINT8* UVFrac;
+}CPU_WARP_MAP_CACHE;
+
+#define CPU_WARP_TILE_ROWS (16)                      // output rows compiled and warped at a time
+
 class CoreCpuWarp {
 public:
+    CoreCpuWarp();
+    ~CoreCpuWarp();
     void CpuWarpingInit(void);
     void CpuWarpingMain(void);
     void CpuWarpingReset(void);
+    void CpuWarpingSetMapCache(bool enable);         // default on (6.25 bytes per output pixel), off warps from the map every frame
     CPU_WARP_IMG_EXT_INFO core_info;
 
 private:
+    CoreCpuWarp(const CoreCpuWarp&);
+    CoreCpuWarp& operator=(const CoreCpuWarp&);
+
     bool CpuWarping();
+    void CpuWarpingDirect(void);
+    bool CpuWarpingLookupMap(bool* compile);
+    void CpuWarpingCompileRows(int row_begin, int row_end);
+    void CpuWarpingMapRows(int row_begin, int row_end);
+    void CpuWarpingFreeMap(void);
     //int test;
+
+    CPU_WARP_MAP_CACHE map_cache;
+    bool map_cache_enable;
 };
 
 /* GPU warping */
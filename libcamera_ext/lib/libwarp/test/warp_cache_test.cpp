@@ -0,0 +1,232 @@
+/*
+ * Test and benchmark of the compiled warp map of CoreCpuWarp
+ *
+ *  - the compiled map gives the same YUV420 output as warping from the
+ *    grid, for zooms, rotations and distortions reaching the image border
+ *  - clipped and odd output sizes
+ *  - a grid changed in place, or a new size, compiles a new map
+ *  - first frame and steady state cost against warping from the grid
+ *
+ * usage: warp_cache_test
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <vector>
+
+#include "coreCpuWarp.h"
+
+static int g_fail = 0;
+
+#define CHECK(cond, ...)                \
+    do {                                \
+        if (!(cond)) {                  \
+            printf("FAIL: " __VA_ARGS__); \
+            printf("\n");               \
+            g_fail++;                   \
+        }                               \
+    } while (0)
+
+static void fillRandom(std::vector<MUINT8> &buf, unsigned int seed)
+{
+    for (size_t i = 0; i < buf.size(); i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        buf[i] = (MUINT8)(seed >> 16);
+    }
+}
+
+static double nowMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+enum MapKind { MAP_ZOOM, MAP_ROTATE, MAP_BARREL };
+
+// grid of source positions in 1/16 pixel, kept inside [0, W-1] x [0, H-1]
+static void makeGrid(std::vector<int> &gx, std::vector<int> &gy, int gw, int gh, int W, int H, MapKind kind, double amount)
+{
+    // the direct warp reads a zero weighted sample past the grid in the last column
+    gx.resize(gw * gh + 1);
+    gy.resize(gw * gh + 1);
+    for (int y = 0; y < gh; y++)
+    {
+        for (int x = 0; x < gw; x++)
+        {
+            double u = (double)x / (gw - 1) - 0.5, v = (double)y / (gh - 1) - 0.5, su, sv;
+            if (kind == MAP_ZOOM)
+            {
+                su = u * amount;
+                sv = v * amount;
+            }
+            else if (kind == MAP_ROTATE)
+            {
+                su = u * cos(amount) - v * sin(amount);
+                sv = u * sin(amount) + v * cos(amount);
+            }
+            else
+            {
+                double r2 = u * u + v * v;
+                su = u * (1 + amount * r2);
+                sv = v * (1 + amount * r2);
+            }
+            double sx = (W - 1) * (0.5 + su), sy = (H - 1) * (0.5 + sv);
+            sx = sx < 0 ? 0 : sx > W - 1 ? W - 1 : sx;
+            sy = sy < 0 ? 0 : sy > H - 1 ? H - 1 : sy;
+            gx[y * gw + x] = (int)(sx * 16);
+            gy[y * gw + x] = (int)(sy * 16);
+        }
+    }
+}
+
+static void setup(CoreCpuWarp &warp, int W, int H, int Wout, int Hout, std::vector<MUINT8> &src,
+                  std::vector<MUINT8> &dst, std::vector<int> &gx, std::vector<int> &gy, int gw, int gh)
+{
+    memset(&warp.core_info, 0, sizeof(warp.core_info));
+    warp.core_info.Width = W;
+    warp.core_info.Height = H;
+    warp.core_info.ClipWidth = Wout;
+    warp.core_info.ClipHeight = Hout;
+    warp.core_info.ImgFmt = CPU_WARP_IMAGE_YUV420;
+    warp.core_info.OutImgFmt = CPU_WARP_IMAGE_YUV420;
+    warp.core_info.SrcBuffer = &src[0];
+    warp.core_info.DstBuffer = &dst[0];
+    warp.core_info.WarpMapNum = 1;
+    warp.core_info.WarpMapAddr[0][0] = (MUINT32 *)&gx[0];
+    warp.core_info.WarpMapAddr[0][1] = (MUINT32 *)&gy[0];
+    warp.core_info.WarpMapSize[0][0] = gw;
+    warp.core_info.WarpMapSize[0][1] = gh;
+    warp.CpuWarpingInit();
+}
+
+static void testSameOutput()
+{
+    struct Case { int W, H, Wout, Hout, gw, gh; MapKind kind; double amount; };
+    const Case cases[] = {
+        { 640, 480, 640, 480, 17, 13, MAP_ZOOM, 0.9 },
+        { 640, 480, 640, 480, 17, 13, MAP_ZOOM, 1.2 },
+        { 640, 480, 640, 480, 9, 7, MAP_ROTATE, 0.1 },
+        { 1280, 720, 1280, 720, 33, 19, MAP_BARREL, 0.3 },
+        { 1280, 720, 1280, 720, 33, 19, MAP_BARREL, -0.2 },
+        { 1280, 720, 1024, 576, 33, 19, MAP_ROTATE, -0.05 },
+        { 322, 242, 322, 242, 5, 4, MAP_ZOOM, 0.97 },
+        { 642, 480, 641, 479, 17, 13, MAP_ZOOM, 0.9 },
+    };
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+    {
+        const Case &k = cases[c];
+        // the direct warp reads a row past the U plane at the bottom, pad the source for it
+        std::vector<MUINT8> src(k.W * k.H * 3 / 2 + k.W + 2);
+        std::vector<MUINT8> ref(k.Wout * k.Hout * 3 / 2 + k.Wout), out(ref.size());
+        std::vector<int> gx, gy;
+        fillRandom(src, (unsigned int)c + 1);
+        makeGrid(gx, gy, k.gw, k.gh, k.W, k.H, k.kind, k.amount);
+
+        CoreCpuWarp direct, cached;
+        setup(direct, k.W, k.H, k.Wout, k.Hout, src, ref, gx, gy, k.gw, k.gh);
+        setup(cached, k.W, k.H, k.Wout, k.Hout, src, out, gx, gy, k.gw, k.gh);
+        direct.CpuWarpingSetMapCache(false);
+
+        direct.CpuWarpingMain();
+        cached.CpuWarpingMain();
+        CHECK(ref == out, "case %d: first frame differs", (int)c);
+
+        // steady state, on a new source frame
+        fillRandom(src, (unsigned int)c + 100);
+        memset(&out[0], 0, out.size());
+        direct.CpuWarpingMain();
+        cached.CpuWarpingMain();
+        CHECK(ref == out, "case %d: second frame differs", (int)c);
+
+        // the grid changed in place
+        makeGrid(gx, gy, k.gw, k.gh, k.W, k.H, MAP_ROTATE, 0.02 * (c + 1));
+        direct.CpuWarpingMain();
+        cached.CpuWarpingMain();
+        CHECK(ref == out, "case %d: changed grid differs", (int)c);
+
+        direct.CpuWarpingReset();
+        cached.CpuWarpingReset();
+    }
+}
+
+static void testResize()
+{
+    const int W = 640, H = 480, gw = 9, gh = 7;
+    std::vector<MUINT8> src(W * H * 3 / 2 + W + 2), ref(W * H * 3 / 2), out(W * H * 3 / 2);
+    std::vector<int> gx, gy;
+    fillRandom(src, 7);
+    makeGrid(gx, gy, gw, gh, W, H, MAP_ZOOM, 0.8);
+
+    CoreCpuWarp direct, cached;
+    setup(direct, W, H, W, H, src, ref, gx, gy, gw, gh);
+    setup(cached, W, H, W, H, src, out, gx, gy, gw, gh);
+    direct.CpuWarpingSetMapCache(false);
+    cached.CpuWarpingMain();
+
+    // the same grid on a smaller output
+    direct.core_info.ClipWidth = cached.core_info.ClipWidth = 320;
+    direct.core_info.ClipHeight = cached.core_info.ClipHeight = 240;
+    direct.CpuWarpingMain();
+    cached.CpuWarpingMain();
+    CHECK(memcmp(&ref[0], &out[0], 320 * 240 * 3 / 2) == 0, "new output size differs");
+
+    // off and on again
+    cached.CpuWarpingSetMapCache(false);
+    cached.CpuWarpingMain();
+    cached.CpuWarpingSetMapCache(true);
+    cached.CpuWarpingMain();
+    CHECK(memcmp(&ref[0], &out[0], 320 * 240 * 3 / 2) == 0, "cache off and on differs");
+}
+
+/*
+ * benchmark
+ */
+
+static void benchmark()
+{
+    const int sizes[][4] = { { 1280, 720, 33, 19 }, { 1920, 1080, 33, 19 }, { 1920, 1080, 65, 37 } };
+    const int frames = 10;
+
+    printf("%12s %8s %12s %12s %12s  (ms per frame)\n", "size", "grid", "direct", "first", "steady");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        int W = sizes[s][0], H = sizes[s][1], gw = sizes[s][2], gh = sizes[s][3];
+        std::vector<MUINT8> src(W * H * 3 / 2 + W + 2), dst(W * H * 3 / 2);
+        std::vector<int> gx, gy;
+        fillRandom(src, 9);
+        makeGrid(gx, gy, gw, gh, W, H, MAP_BARREL, 0.25);
+
+        CoreCpuWarp direct, cached;
+        setup(direct, W, H, W, H, src, dst, gx, gy, gw, gh);
+        setup(cached, W, H, W, H, src, dst, gx, gy, gw, gh);
+        direct.CpuWarpingSetMapCache(false);
+
+        double t0 = nowMs();
+        for (int f = 0; f < frames; f++)
+            direct.CpuWarpingMain();
+        double t1 = nowMs();
+        cached.CpuWarpingMain();
+        double t2 = nowMs();
+        for (int f = 0; f < frames; f++)
+            cached.CpuWarpingMain();
+        double t3 = nowMs();
+
+        printf("%6dx%-5d %3dx%-4d %12.2f %12.2f %12.2f\n", W, H, gw, gh,
+               (t1 - t0) / frames, t2 - t1, (t3 - t2) / frames);
+    }
+}
+
+int main()
+{
+    testSameOutput();
+    testResize();
+    benchmark();
+
+    printf("%s\n", g_fail ? "FAIL" : "PASS");
+    return g_fail ? 1 : 0;
+}
@@ -40,19 +40,26 @@ LOCAL_SHARED_LIBRARIES := \
 
 LOCAL_SRC_FILES := \
 	hwc2.cpp \
+	frame_trace.cpp \
+	hrt_model.cpp \
+	dirty_region.cpp \
 	dispatcher.cpp \
 	worker.cpp \
 	display.cpp \
 	hwdev.cpp \
 	event.cpp \
+	vsync_model.cpp \
 	overlay.cpp \
+	ovl_config_diff.cpp \
 	queue.cpp \
 	sync.cpp \
+	fence_set.cpp \
 	composer.cpp \
 	blitdev.cpp \
 	bliter.cpp \
 	bliter_async.cpp \
 	bliter_ultra.cpp \
+	sw_composer.cpp \
 	platform_common.cpp \
 	post_processing.cpp \
 	../utils/tools.cpp \
@@ -123,3 +130,5 @@ endif
 
 include $(MTK_STATIC_LIBRARY)
 
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
@@ -22,11 +22,14 @@
 #include "hwdev.h"
 #include "hwc2.h"
 #include "bliter_ultra.h"
+#include "sw_composer.h"
 
 #include <sync/sync.h>
 
 #include <utils/String8.h>
 
+#include <ui/GraphicBufferMapper.h>
+
 #define ALIGN_FLOOR(x,a)    ((x) & ~((a) - 1L))
 #define ALIGN_CEIL(x,a)     (((x) + (a) - 1L) & ~((a) - 1L))
 
@@ -74,6 +77,7 @@ extern unsigned int mapDpOrientation(const uint32_t transform);
 
 AsyncBliterHandler::AsyncBliterHandler(int dpy, const sp<OverlayEngine>& ovl_engine)
     : LayerHandler(dpy, ovl_engine)
+    , m_sw_composer(NULL)
 {
     int num = m_ovl_engine->getMaxInputNum();
     m_dp_configs = (BufferConfig*)calloc(1, sizeof(BufferConfig) * num);
@@ -103,6 +107,12 @@ AsyncBliterHandler::~AsyncBliterHandler()
         m_bliter_node = NULL;
     }
 
+    if (NULL != m_sw_composer)
+    {
+        delete m_sw_composer;
+        m_sw_composer = NULL;
+    }
+
     if (HWC_DISPLAY_PRIMARY == m_disp_id)
     {
         UltraBliter::getInstance().setBliter(NULL);
@@ -509,7 +519,7 @@ bool AsyncBliterHandler::bypassBlit(HWLayer* hw_layer, int ovl_in)
 }
 
 sp<DisplayBufferQueue> AsyncBliterHandler::getDisplayBufferQueue(
-    PrivateHandle* priv_handle, BufferConfig* config, int ovl_in) const
+    PrivateHandle* priv_handle, BufferConfig* config, int ovl_in, const bool& sw_compose) const
 {
     sp<DisplayBufferQueue> queue = m_ovl_engine->getInputQueue(ovl_in);
     if (queue == NULL)
@@ -522,7 +532,7 @@ sp<DisplayBufferQueue> AsyncBliterHandler::getDisplayBufferQueue(
     }
 
     int format = priv_handle->format;
-    if (m_disp_data->subtype == HWC_DISPLAY_EPAPER)
+    if (m_disp_data->subtype == HWC_DISPLAY_EPAPER || sw_compose)
     {
         format = HAL_PIXEL_FORMAT_RGBA_8888;
     }
@@ -543,7 +553,7 @@ sp<DisplayBufferQueue> AsyncBliterHandler::getDisplayBufferQueue(
     // TODO: should calculate the size from the information of gralloc?
     buffer_param.size    = (buffer_w * buffer_h * bpp / 8);
     buffer_param.protect = (priv_handle->usage & GRALLOC_USAGE_PROTECTED);
-    if (m_disp_data->subtype == HWC_DISPLAY_EPAPER)
+    if (m_disp_data->subtype == HWC_DISPLAY_EPAPER || sw_compose)
     {
         buffer_param.sw_usage = true;
     }
@@ -1044,6 +1054,12 @@ void AsyncBliterHandler::process(DispatcherJob* job)
             continue;
         }
 
+        if (hw_layer->sw_compose)
+        {
+            processSwLayer(job, hw_layer, i);
+            continue;
+        }
+
         // in ULTRA scenario, set src buffer for master, and cancel mdp job for slave
         if (hw_layer->is_ultra_mdp)
         {
@@ -1160,6 +1176,203 @@ void AsyncBliterHandler::process(DispatcherJob* job)
     }
 }
 
+void AsyncBliterHandler::processSwLayer(DispatcherJob* job, HWLayer* hw_layer, int ovl_in)
+{
+    HWC_ATRACE_CALL();
+
+    hwc_layer_1_t* layer = &hw_layer->layer;
+    PrivateHandle* priv_handle = &hw_layer->priv_handle;
+    BufferConfig* config = &m_dp_configs[ovl_in];
+    DisplayBufferQueue::DisplayBuffer disp_buffer;
+
+    if (NULL == m_sw_composer)
+    {
+        m_sw_composer = new SwComposer(Platform::getInstance().m_config.sw_compose_threads);
+        BLOGI(ovl_in, "SwComposer threads:%u kernels:%s",
+            m_sw_composer->getThreadNum(), m_sw_composer->getKernelName());
+    }
+
+    sp<DisplayBufferQueue> queue = getDisplayBufferQueue(priv_handle, config, ovl_in, true);
+
+    // only the pitches and the plane sizes of the source are used
+    status_t err = setDpConfig(priv_handle, config, ovl_in);
+
+    SwLayer sw_layer;
+    sw_layer.src.width = priv_handle->width;
+    sw_layer.src.height = priv_handle->height;
+    sw_layer.src.pitch[0] = config->src_pitch;
+    sw_layer.src.pitch[1] = sw_layer.src.pitch[2] = config->src_pitch_uv;
+    switch (priv_handle->format)
+    {
+        case HAL_PIXEL_FORMAT_RGBA_8888:
+            sw_layer.src.format = SW_FORMAT_RGBA_8888;
+            break;
+
+        case HAL_PIXEL_FORMAT_RGBX_8888:
+            sw_layer.src.format = SW_FORMAT_RGBX_8888;
+            break;
+
+        case HAL_PIXEL_FORMAT_RGB_565:
+            sw_layer.src.format = SW_FORMAT_RGB_565;
+            break;
+
+        case HAL_PIXEL_FORMAT_YV12:
+        case HAL_PIXEL_FORMAT_I420:
+            sw_layer.src.format = SW_FORMAT_YUV_420;
+            break;
+
+        case HAL_PIXEL_FORMAT_NV12:
+            sw_layer.src.format = SW_FORMAT_YUV_420;
+            sw_layer.src.chroma_step = 2;
+            break;
+
+        default:
+            BLOGE(ovl_in, "SwComposer cannot handle format 0x%x", priv_handle->format);
+            err = -EINVAL;
+            break;
+    }
+
+    if (NO_ERROR == err)
+    {
+        err = queue->dequeueBuffer(&disp_buffer, true, false);
+    }
+
+    if (NO_ERROR == err)
+    {
+        const Rect src_roi = getFixedRect(layer->sourceCropf);
+        sw_layer.src_crop.left = src_roi.left;
+        sw_layer.src_crop.top = src_roi.top;
+        sw_layer.src_crop.right = src_roi.right;
+        sw_layer.src_crop.bottom = src_roi.bottom;
+        sw_layer.display_frame = layer->displayFrame;
+        sw_layer.plane_alpha = layer->planeAlpha;
+        switch (layer->blending)
+        {
+            case HWC_BLENDING_PREMULT:
+                sw_layer.blending = SW_BLEND_PREMULT;
+                break;
+
+            case HWC_BLENDING_COVERAGE:
+                sw_layer.blending = SW_BLEND_COVERAGE;
+                break;
+
+            default:
+                sw_layer.blending = SW_BLEND_NONE;
+                break;
+        }
+
+        // the part of the display frame inside the display buffer
+        Rect bounds;
+        hw_layer->mdp_dst_roi.intersect(Rect(config->dst_width, config->dst_height), &bounds);
+
+        GraphicBufferMapper& mapper = GraphicBufferMapper::getInstance();
+        uint8_t* src_addr = NULL;
+        uint8_t* dst_addr = NULL;
+
+        // lockAsync() takes the fences and waits for them
+        err = mapper.lockAsync(layer->handle, GRALLOC_USAGE_SW_READ_OFTEN,
+            Rect(priv_handle->width, priv_handle->height),
+            reinterpret_cast<void**>(&src_addr), layer->acquireFenceFd);
+        layer->acquireFenceFd = -1;
+        if (NO_ERROR != err)
+        {
+            // this frame is already presented, so the layer is lost once;
+            // validate the next frame again and leave the buffer to GLES
+            BLOGE(ovl_in, "SwComposer cannot lock src(%d), use GLES from the next frame", err);
+            Platform::getInstance().rejectSWLayer(priv_handle->alloc_id);
+            HWCMediator::getInstance().addDriverRefreshCount();
+            DisplayManager::getInstance().refresh(m_disp_id);
+        }
+        else
+        {
+            err = mapper.lockAsync(disp_buffer.out_handle, GRALLOC_USAGE_SW_WRITE_OFTEN,
+                bounds, reinterpret_cast<void**>(&dst_addr), disp_buffer.release_fence);
+            disp_buffer.release_fence = -1;
+            if (NO_ERROR == err)
+            {
+                sw_layer.src.plane[0] = src_addr;
+                if (SW_FORMAT_YUV_420 == sw_layer.src.format)
+                {
+                    sw_layer.src.plane[1] = src_addr + config->src_size[0];
+                    sw_layer.src.plane[2] = sw_layer.src.chroma_step == 2 ?
+                        sw_layer.src.plane[1] + 1 : sw_layer.src.plane[1] + config->src_size[1];
+
+                    // YV12 puts Cr before Cb
+                    if (HAL_PIXEL_FORMAT_YV12 == priv_handle->format)
+                    {
+                        uint8_t* cr = sw_layer.src.plane[1];
+                        sw_layer.src.plane[1] = sw_layer.src.plane[2];
+                        sw_layer.src.plane[2] = cr;
+                    }
+                }
+
+                SwBuffer dst;
+                dst.width = config->dst_width;
+                dst.height = config->dst_height;
+                dst.pitch[0] = config->dst_pitch;
+                dst.plane[0] = dst_addr;
+
+                hwc_rect_t dst_bounds;
+                dst_bounds.left = bounds.left;
+                dst_bounds.top = bounds.top;
+                dst_bounds.right = bounds.right;
+                dst_bounds.bottom = bounds.bottom;
+
+                if (!m_sw_composer->compose(&sw_layer, 1, dst, dst_bounds))
+                {
+                    BLOGE(ovl_in, "SwComposer failed src(%d,%d,%d,%d) dst(%d,%d,%d,%d)",
+                        src_roi.left, src_roi.top, src_roi.right, src_roi.bottom,
+                        bounds.left, bounds.top, bounds.right, bounds.bottom);
+                    err = -EINVAL;
+                }
+
+                mapper.unlockAsync(disp_buffer.out_handle, &disp_buffer.acquire_fence);
+            }
+            int src_fence = -1;
+            mapper.unlockAsync(layer->handle, &src_fence);
+            closeFenceFd(&src_fence);
+        }
+    }
+
+    if (NO_ERROR == err)
+    {
+        // the output is premultiplied, and opaque only for an opaque layer
+        const bool is_opaque = SW_BLEND_NONE == sw_layer.blending && 0xFF == sw_layer.plane_alpha;
+        disp_buffer.data_info.src_crop   = hw_layer->mdp_dst_roi;
+        disp_buffer.data_info.dst_crop   = hw_layer->mdp_dst_roi;
+        disp_buffer.data_info.is_sharpen = false;
+        disp_buffer.alpha_enable         = 1;
+        disp_buffer.alpha                = 0xFF;
+        disp_buffer.blending             = is_opaque ? HWC_BLENDING_NONE : HWC_BLENDING_PREMULT;
+        disp_buffer.src_handle           = layer->handle;
+        disp_buffer.data_color_range     = GRALLOC_EXTRA_BIT_YUV_BT601_FULL;
+        disp_buffer.ext_sel_layer        = hw_layer->ext_sel_layer;
+        disp_buffer.sequence = job->sequence;
+
+        queue->queueBuffer(&disp_buffer);
+    }
+    else
+    {
+        if (disp_buffer.out_handle != NULL)
+        {
+            closeFenceFd(&disp_buffer.acquire_fence);
+            queue->cancelBuffer(disp_buffer.index);
+        }
+        BLOGE(ovl_in, "something wrong, cancel sw compose ...");
+    }
+
+    // the source is read, signal its release fence
+    WDT_BL_NODE(cancelJob, hw_layer->mdp_job_id);
+
+    if (priv_handle->ion_fd > 0)
+    {
+        IONDevice::getInstance().ionClose(priv_handle->ion_fd);
+    }
+
+    closeFenceFd(&layer->acquireFenceFd);
+    closeFenceFd(&layer->releaseFenceFd);
+}
+
 void AsyncBliterHandler::nullop()
 {
 }
@@ -16,6 +16,7 @@ struct HWLayer;
 struct PrivateHandle;
 class DisplayBufferQueue;
 class BliterNode;
+class SwComposer;
 
 // ---------------------------------------------------------------------------
 
@@ -126,8 +127,13 @@ private:
     bool bypassBlit(HWLayer* hw_layer, int ovl_in);
 
     // getDisplayBufferQueue() is used to get workable display buffer queue
+    // sw_compose asks for a RGBA_8888 buffer which the CPU can write
     sp<DisplayBufferQueue> getDisplayBufferQueue(PrivateHandle* priv_handle,
-        BufferConfig* config,int ovl_in) const;
+        BufferConfig* config,int ovl_in, const bool& sw_compose = false) const;
+
+    // processSwLayer() is used to compose a layer which MDP cannot handle
+    // by SwComposer into the display buffer queue of ovl_in
+    void processSwLayer(DispatcherJob* job, HWLayer* hw_layer, int ovl_in);
 
     // setDpConfig() is used to prepare configuration for DpFramwork
     status_t setDpConfig(PrivateHandle* priv_handle, BufferConfig* config, int ovl_in);
@@ -195,6 +201,9 @@ private:
     DpAsyncBlitStream m_blit_stream;
 
     BliterNode* m_bliter_node;
+
+    // m_sw_composer is created by the first layer composed by the CPU
+    SwComposer* m_sw_composer;
 };
 
 #endif // HWC_BLITER_ASYNC_H_
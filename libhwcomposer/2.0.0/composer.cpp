@@ -174,7 +174,23 @@ void ComposerHandler::set(
         // partial update - fill dirty rects info
         hw_layer->layer.surfaceDamage = { 0, hw_layer->surface_damage_rect};
         const uint32_t& num_rect = layer->getDamage().numRects;
-        if (!job->is_full_invalidate)
+        if (!job->is_full_invalidate && Platform::getInstance().m_config.dirty_region)
+        {
+            // the dirty region is merged into MAX_DIRTY_RECT_CNT rects already
+            const std::vector<hwc_rect_t>& dirty_rects = layer->getDirtyRegion().getRects();
+            if (dirty_rects.empty())
+            {
+                // nothing to update, it is the same as an empty damage from SurfaceFlinger
+                memset(hw_layer->surface_damage_rect, 0, sizeof(hwc_rect_t));
+                hw_layer->layer.surfaceDamage.numRects = 1;
+            }
+            else
+            {
+                memcpy(hw_layer->surface_damage_rect, &dirty_rects[0], sizeof(hwc_rect_t) * dirty_rects.size());
+                hw_layer->layer.surfaceDamage.numRects = dirty_rects.size();
+            }
+        }
+        else if (!job->is_full_invalidate)
         {
             hwc_rect_t* job_dirty_rect = hw_layer->surface_damage_rect;
             if (num_rect == 0 || num_rect > MAX_DIRTY_RECT_CNT)
@@ -0,0 +1,415 @@
+#include <math.h>
+#include <algorithm>
+
+#include "dirty_region.h"
+
+#define MAP_ROUNDING_TOLERANCE (1e-3f)
+
+// ---------------------------------------------------------------------------
+
+DirtyRegion::DirtyRegion(const hwc_rect_t& rect)
+{
+    if (!isRectEmpty(rect))
+        m_rects.push_back(rect);
+}
+
+int64_t DirtyRegion::getArea() const
+{
+    int64_t area = 0;
+    for (const auto& rect : m_rects)
+    {
+        area += getRectArea(rect);
+    }
+    return area;
+}
+
+hwc_rect_t DirtyRegion::getBounds() const
+{
+    hwc_rect_t bounds = { 0, 0, 0, 0 };
+    for (size_t i = 0; i < m_rects.size(); ++i)
+    {
+        bounds = i == 0 ? m_rects[i] : boundRect(bounds, m_rects[i]);
+    }
+    return bounds;
+}
+
+bool DirtyRegion::contains(const int32_t& x, const int32_t& y) const
+{
+    for (const auto& rect : m_rects)
+    {
+        if (x >= rect.left && x < rect.right && y >= rect.top && y < rect.bottom)
+            return true;
+    }
+    return false;
+}
+
+hwc_rect_t DirtyRegion::intersectRect(const hwc_rect_t& lhs, const hwc_rect_t& rhs)
+{
+    hwc_rect_t rect;
+    rect.left   = std::max(lhs.left, rhs.left);
+    rect.top    = std::max(lhs.top, rhs.top);
+    rect.right  = std::min(lhs.right, rhs.right);
+    rect.bottom = std::min(lhs.bottom, rhs.bottom);
+    return rect;
+}
+
+hwc_rect_t DirtyRegion::boundRect(const hwc_rect_t& lhs, const hwc_rect_t& rhs)
+{
+    hwc_rect_t rect;
+    rect.left   = std::min(lhs.left, rhs.left);
+    rect.top    = std::min(lhs.top, rhs.top);
+    rect.right  = std::max(lhs.right, rhs.right);
+    rect.bottom = std::max(lhs.bottom, rhs.bottom);
+    return rect;
+}
+
+void DirtyRegion::subtractRect(const hwc_rect_t& src, const hwc_rect_t& cut, std::vector<hwc_rect_t>* out)
+{
+    const hwc_rect_t overlap = intersectRect(src, cut);
+    if (isRectEmpty(overlap))
+    {
+        out->push_back(src);
+        return;
+    }
+
+    // the band above and below the cut keep the full width of src,
+    // the pieces on the left and right only have the height of the cut
+    if (src.top < overlap.top)
+    {
+        const hwc_rect_t top = { src.left, src.top, src.right, overlap.top };
+        out->push_back(top);
+    }
+    if (overlap.bottom < src.bottom)
+    {
+        const hwc_rect_t bottom = { src.left, overlap.bottom, src.right, src.bottom };
+        out->push_back(bottom);
+    }
+    if (src.left < overlap.left)
+    {
+        const hwc_rect_t left = { src.left, overlap.top, overlap.left, overlap.bottom };
+        out->push_back(left);
+    }
+    if (overlap.right < src.right)
+    {
+        const hwc_rect_t right = { overlap.right, overlap.top, src.right, overlap.bottom };
+        out->push_back(right);
+    }
+}
+
+DirtyRegion& DirtyRegion::orRect(const hwc_rect_t& rect)
+{
+    if (isRectEmpty(rect))
+        return *this;
+
+    // add the pieces of rect which are not in the region yet
+    std::vector<hwc_rect_t> pieces(1, rect);
+    std::vector<hwc_rect_t> remains;
+    for (size_t i = 0; i < m_rects.size() && !pieces.empty(); ++i)
+    {
+        remains.clear();
+        for (const auto& piece : pieces)
+        {
+            subtractRect(piece, m_rects[i], &remains);
+        }
+        pieces.swap(remains);
+    }
+    m_rects.insert(m_rects.end(), pieces.begin(), pieces.end());
+    return *this;
+}
+
+DirtyRegion& DirtyRegion::orSelf(const DirtyRegion& rhs)
+{
+    if (this == &rhs)
+        return *this;
+
+    for (const auto& rect : rhs.m_rects)
+    {
+        orRect(rect);
+    }
+    return *this;
+}
+
+DirtyRegion& DirtyRegion::andRect(const hwc_rect_t& rect)
+{
+    size_t num = 0;
+    for (size_t i = 0; i < m_rects.size(); ++i)
+    {
+        const hwc_rect_t overlap = intersectRect(m_rects[i], rect);
+        if (!isRectEmpty(overlap))
+            m_rects[num++] = overlap;
+    }
+    m_rects.resize(num);
+    return *this;
+}
+
+DirtyRegion& DirtyRegion::andSelf(const DirtyRegion& rhs)
+{
+    if (this == &rhs)
+        return *this;
+
+    // the intersections of two sets of disjoint rects are disjoint
+    std::vector<hwc_rect_t> result;
+    for (const auto& lhs_rect : m_rects)
+    {
+        for (const auto& rhs_rect : rhs.m_rects)
+        {
+            const hwc_rect_t overlap = intersectRect(lhs_rect, rhs_rect);
+            if (!isRectEmpty(overlap))
+                result.push_back(overlap);
+        }
+    }
+    m_rects.swap(result);
+    return *this;
+}
+
+DirtyRegion& DirtyRegion::subtractRect(const hwc_rect_t& rect)
+{
+    if (isRectEmpty(rect))
+        return *this;
+
+    std::vector<hwc_rect_t> result;
+    for (const auto& src : m_rects)
+    {
+        subtractRect(src, rect, &result);
+    }
+    m_rects.swap(result);
+    return *this;
+}
+
+DirtyRegion& DirtyRegion::subtractSelf(const DirtyRegion& rhs)
+{
+    if (this == &rhs)
+    {
+        clear();
+        return *this;
+    }
+
+    for (const auto& rect : rhs.m_rects)
+    {
+        subtractRect(rect);
+    }
+    return *this;
+}
+
+void DirtyRegion::simplify(const size_t& max_num)
+{
+    if (max_num == 0)
+    {
+        clear();
+        return;
+    }
+
+    while (m_rects.size() > max_num)
+    {
+        size_t best_i = 0;
+        size_t best_j = 1;
+        int64_t best_waste = -1;
+        for (size_t i = 0; i < m_rects.size(); ++i)
+        {
+            for (size_t j = i + 1; j < m_rects.size(); ++j)
+            {
+                const int64_t waste = getRectArea(boundRect(m_rects[i], m_rects[j])) -
+                                      getRectArea(m_rects[i]) - getRectArea(m_rects[j]);
+                if (best_waste < 0 || waste < best_waste)
+                {
+                    best_waste = waste;
+                    best_i = i;
+                    best_j = j;
+                }
+            }
+        }
+
+        hwc_rect_t merged = boundRect(m_rects[best_i], m_rects[best_j]);
+        m_rects.erase(m_rects.begin() + best_j);
+        m_rects.erase(m_rects.begin() + best_i);
+
+        // the merged rect also takes the rects it overlaps, so the rects stay
+        // disjoint and the number of rects always goes down
+        bool grown = true;
+        while (grown)
+        {
+            grown = false;
+            for (size_t i = 0; i < m_rects.size(); ++i)
+            {
+                if (!isRectEmpty(intersectRect(merged, m_rects[i])))
+                {
+                    merged = boundRect(merged, m_rects[i]);
+                    m_rects.erase(m_rects.begin() + i);
+                    grown = true;
+                    break;
+                }
+            }
+        }
+        m_rects.push_back(merged);
+    }
+}
+
+// ---------------------------------------------------------------------------
+
+static hwc_rect_t getCropBounds(const hwc_frect_t& source_crop)
+{
+    const hwc_rect_t bounds = {
+        static_cast<int>(floorf(source_crop.left)),
+        static_cast<int>(floorf(source_crop.top)),
+        static_cast<int>(ceilf(source_crop.right)),
+        static_cast<int>(ceilf(source_crop.bottom)) };
+    return bounds;
+}
+
+void mapDisplayRegionToSource(
+    const DirtyRegion& display_region, const hwc_rect_t& display_frame,
+    const hwc_frect_t& source_crop, const int32_t& transform, DirtyRegion* source_region)
+{
+    const float frame_w = static_cast<float>(display_frame.right - display_frame.left);
+    const float frame_h = static_cast<float>(display_frame.bottom - display_frame.top);
+    const float crop_w = source_crop.right - source_crop.left;
+    const float crop_h = source_crop.bottom - source_crop.top;
+    if (frame_w <= 0 || frame_h <= 0 || crop_w <= 0 || crop_h <= 0)
+        return;
+
+    const hwc_rect_t crop_bounds = getCropBounds(source_crop);
+
+    for (const auto& display_rect : display_region.getRects())
+    {
+        const hwc_rect_t rect = DirtyRegion::intersectRect(display_rect, display_frame);
+        if (DirtyRegion::isRectEmpty(rect))
+            continue;
+
+        // normalized position in the display frame
+        float u0 = (rect.left - display_frame.left) / frame_w;
+        float u1 = (rect.right - display_frame.left) / frame_w;
+        float v0 = (rect.top - display_frame.top) / frame_h;
+        float v1 = (rect.bottom - display_frame.top) / frame_h;
+
+        // the buffer is flipped first, then rotated clockwise by 90 degrees;
+        // undo them in the reverse order
+        float s0 = u0, s1 = u1, t0 = v0, t1 = v1;
+        if (transform & HAL_TRANSFORM_ROT_90)
+        {
+            s0 = v0;
+            s1 = v1;
+            t0 = 1.0f - u1;
+            t1 = 1.0f - u0;
+        }
+        if (transform & HAL_TRANSFORM_FLIP_H)
+        {
+            const float tmp = s0;
+            s0 = 1.0f - s1;
+            s1 = 1.0f - tmp;
+        }
+        if (transform & HAL_TRANSFORM_FLIP_V)
+        {
+            const float tmp = t0;
+            t0 = 1.0f - t1;
+            t1 = 1.0f - tmp;
+        }
+
+        // the tolerance keeps the rects of 1:1 layers from growing
+        // by the rounding error of the normalization
+        hwc_rect_t src_rect = {
+            static_cast<int>(floorf(source_crop.left + s0 * crop_w + MAP_ROUNDING_TOLERANCE)),
+            static_cast<int>(floorf(source_crop.top + t0 * crop_h + MAP_ROUNDING_TOLERANCE)),
+            static_cast<int>(ceilf(source_crop.left + s1 * crop_w - MAP_ROUNDING_TOLERANCE)),
+            static_cast<int>(ceilf(source_crop.top + t1 * crop_h - MAP_ROUNDING_TOLERANCE)) };
+        src_rect = DirtyRegion::intersectRect(src_rect, crop_bounds);
+        source_region->orRect(src_rect);
+    }
+}
+
+// ---------------------------------------------------------------------------
+
+bool DirtyRegionTracker::isGeometryEqual(const Geometry& lhs, const Geometry& rhs)
+{
+    return lhs.display_frame.left == rhs.display_frame.left &&
+           lhs.display_frame.top == rhs.display_frame.top &&
+           lhs.display_frame.right == rhs.display_frame.right &&
+           lhs.display_frame.bottom == rhs.display_frame.bottom &&
+           lhs.source_crop.left == rhs.source_crop.left &&
+           lhs.source_crop.top == rhs.source_crop.top &&
+           lhs.source_crop.right == rhs.source_crop.right &&
+           lhs.source_crop.bottom == rhs.source_crop.bottom &&
+           lhs.transform == rhs.transform &&
+           lhs.blend == rhs.blend &&
+           lhs.plane_alpha == rhs.plane_alpha;
+}
+
+bool DirtyRegionTracker::update(const std::vector<DirtyLayer>& layers)
+{
+    std::vector<Geometry> curr_geometry(layers.size());
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+        curr_geometry[i].id = layers[i].id;
+        curr_geometry[i].display_frame = layers[i].display_frame;
+        curr_geometry[i].source_crop = layers[i].source_crop;
+        curr_geometry[i].transform = layers[i].transform;
+        curr_geometry[i].blend = layers[i].blend;
+        curr_geometry[i].plane_alpha = layers[i].plane_alpha;
+    }
+
+    // both lists are sorted by z order; a layer of the last frame which is
+    // skipped while matching is removed, or moved below the others
+    m_exposed.clear();
+    size_t prev_pos = 0;
+    for (const auto& curr : curr_geometry)
+    {
+        size_t pos = prev_pos;
+        while (pos < m_prev_geometry.size() && m_prev_geometry[pos].id != curr.id)
+            ++pos;
+
+        if (pos == m_prev_geometry.size())
+        {
+            // a new layer, or a layer which is moved above the others
+            m_exposed.orRect(curr.display_frame);
+            continue;
+        }
+
+        for (; prev_pos < pos; ++prev_pos)
+        {
+            m_exposed.orRect(m_prev_geometry[prev_pos].display_frame);
+        }
+
+        const Geometry& prev = m_prev_geometry[prev_pos++];
+        if (!isGeometryEqual(prev, curr))
+        {
+            m_exposed.orRect(prev.display_frame);
+            m_exposed.orRect(curr.display_frame);
+        }
+    }
+    for (; prev_pos < m_prev_geometry.size(); ++prev_pos)
+    {
+        m_exposed.orRect(m_prev_geometry[prev_pos].display_frame);
+    }
+    m_prev_geometry.swap(curr_geometry);
+
+    // an exposed area which no layer covers is not refreshed by any layer
+    DirtyRegion uncovered(m_exposed);
+    for (const auto& layer : layers)
+    {
+        uncovered.subtractRect(layer.display_frame);
+    }
+    if (!uncovered.isEmpty())
+        return false;
+
+    for (const auto& layer : layers)
+    {
+        DirtyRegion* dirty = layer.dirty;
+        if (dirty == NULL)
+            continue;
+
+        dirty->clear();
+        if (!layer.damage_known)
+        {
+            dirty->orRect(layer.buffer_bounds);
+            continue;
+        }
+
+        const hwc_rect_t crop_bounds = getCropBounds(layer.source_crop);
+        for (size_t i = 0; i < layer.damage_num; ++i)
+        {
+            dirty->orRect(DirtyRegion::intersectRect(layer.damage[i], crop_bounds));
+        }
+        mapDisplayRegionToSource(m_exposed, layer.display_frame, layer.source_crop, layer.transform, dirty);
+        dirty->simplify(m_max_rects);
+    }
+    return true;
+}
@@ -0,0 +1,167 @@
+#ifndef HWC_DIRTY_REGION_H_
+#define HWC_DIRTY_REGION_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include <hardware/hwcomposer_defs.h>
+
+// ---------------------------------------------------------------------------
+
+// DirtyRegion is a set of pixels kept as a list of disjoint, non-empty rects.
+// It is small and cheap for the few rects of partial update; the operations
+// are quadratic in the number of rects, not a y-x banded region like
+// android::Region, so the rects are kept as the caller gives them as far as
+// possible, and simplify() bounds their number.
+class DirtyRegion
+{
+public:
+    DirtyRegion() { }
+    explicit DirtyRegion(const hwc_rect_t& rect);
+
+    void clear() { m_rects.clear(); }
+
+    bool isEmpty() const { return m_rects.empty(); }
+
+    size_t getRectNum() const { return m_rects.size(); }
+
+    const std::vector<hwc_rect_t>& getRects() const { return m_rects; }
+
+    // getArea() returns the amount of pixels in the region
+    int64_t getArea() const;
+
+    // getBounds() returns the bounding rect, or an empty rect
+    hwc_rect_t getBounds() const;
+
+    bool contains(const int32_t& x, const int32_t& y) const;
+
+    // union
+    DirtyRegion& orRect(const hwc_rect_t& rect);
+    DirtyRegion& orSelf(const DirtyRegion& rhs);
+
+    // intersection
+    DirtyRegion& andRect(const hwc_rect_t& rect);
+    DirtyRegion& andSelf(const DirtyRegion& rhs);
+
+    // difference
+    DirtyRegion& subtractRect(const hwc_rect_t& rect);
+    DirtyRegion& subtractSelf(const DirtyRegion& rhs);
+
+    // simplify() merges the rects which waste the fewest pixels when they are
+    // replaced by their bounding rect, until there are at most max_num rects.
+    // The result always covers the original region, and stays disjoint.
+    void simplify(const size_t& max_num);
+
+    static bool isRectEmpty(const hwc_rect_t& rect)
+    {
+        return rect.left >= rect.right || rect.top >= rect.bottom;
+    }
+
+    static int64_t getRectArea(const hwc_rect_t& rect)
+    {
+        return isRectEmpty(rect) ? 0 :
+            static_cast<int64_t>(rect.right - rect.left) * (rect.bottom - rect.top);
+    }
+
+    static hwc_rect_t intersectRect(const hwc_rect_t& lhs, const hwc_rect_t& rhs);
+
+    static hwc_rect_t boundRect(const hwc_rect_t& lhs, const hwc_rect_t& rhs);
+
+private:
+    // subtractRect() appends the pieces of src outside of cut to out
+    static void subtractRect(const hwc_rect_t& src, const hwc_rect_t& cut, std::vector<hwc_rect_t>* out);
+
+    std::vector<hwc_rect_t> m_rects;
+};
+
+// mapDisplayRegionToSource() maps a region in display coordinates into the
+// buffer coordinates of a layer which shows source_crop of its buffer in
+// display_frame with transform (HAL_TRANSFORM_*).
+// The part of the region outside display_frame is ignored, and the mapped
+// rects are rounded outward, so every source pixel which contributes to the
+// region is covered.
+void mapDisplayRegionToSource(
+    const DirtyRegion& display_region, const hwc_rect_t& display_frame,
+    const hwc_frect_t& source_crop, const int32_t& transform, DirtyRegion* source_region);
+
+// DirtyLayer is the input and output of DirtyRegionTracker for a layer
+struct DirtyLayer
+{
+    DirtyLayer()
+        : id(0)
+        , transform(0)
+        , blend(0)
+        , plane_alpha(1.0f)
+        , damage_known(false)
+        , damage_num(0)
+        , damage(NULL)
+        , dirty(NULL)
+    {
+        display_frame.left = display_frame.top = display_frame.right = display_frame.bottom = 0;
+        source_crop.left = source_crop.top = source_crop.right = source_crop.bottom = 0;
+        buffer_bounds = display_frame;
+    }
+
+    uint64_t id;
+    hwc_rect_t display_frame;
+    hwc_frect_t source_crop;
+    int32_t transform;
+    int32_t blend;
+    float plane_alpha;
+
+    // the size of the buffer, the dirty region is the full buffer
+    // if the damage is not known
+    hwc_rect_t buffer_bounds;
+
+    // surface damage in buffer coordinates from SurfaceFlinger
+    bool damage_known;
+    size_t damage_num;
+    const hwc_rect_t* damage;
+
+    // output: the dirty region in buffer coordinates
+    DirtyRegion* dirty;
+};
+
+// DirtyRegionTracker keeps the geometry of the layers of the last frame.
+// The area on the screen whose layers are added, removed, moved, or reordered
+// is exposed, and every layer under it has to be composed again; a change of
+// the surface damage alone does not expose anything.
+// The dirty region of a layer is its surface damage plus the exposed area
+// mapped into its buffer, merged into at most max_rects rects.
+class DirtyRegionTracker
+{
+public:
+    explicit DirtyRegionTracker(const size_t& max_rects) : m_max_rects(max_rects) { }
+
+    // update() fills the dirty region of layers (sorted by z order) and
+    // remembers their geometry; return false if the exposed area is not
+    // covered by the layers, and the full screen has to be invalidated
+    bool update(const std::vector<DirtyLayer>& layers);
+
+    // invalidate() forgets the last frame, then all layers are dirty
+    // in the next update()
+    void invalidate() { m_prev_geometry.clear(); }
+
+    // getExposedRegion() returns the area exposed in the last update()
+    const DirtyRegion& getExposedRegion() const { return m_exposed; }
+
+private:
+    struct Geometry
+    {
+        uint64_t id;
+        hwc_rect_t display_frame;
+        hwc_frect_t source_crop;
+        int32_t transform;
+        int32_t blend;
+        float plane_alpha;
+    };
+
+    static bool isGeometryEqual(const Geometry& lhs, const Geometry& rhs);
+
+    const size_t m_max_rects;
+    std::vector<Geometry> m_prev_geometry;
+    DirtyRegion m_exposed;
+};
+
+#endif // HWC_DIRTY_REGION_H_
@@ -87,11 +87,9 @@ DispatcherJob* HWCDispatcher::getJob(int dpy)
         }
         else
         {
-            job = new DispatcherJob();
-            job->disp_ori_id = dpy;
-
-            job->num_layers = m_workers[dpy].ovl_engine->getAvailableInputNum();
-            if (job->num_layers <= 0)
+            int num_layers = m_workers[dpy].ovl_engine->getAvailableInputNum();
+            bool ovl_valid = true;
+            if (num_layers <= 0)
             {
                 // reserve one dump layer for gpu compoisition with FBT
                 // if there's np available input layers
@@ -99,19 +97,18 @@ DispatcherJob* HWCDispatcher::getJob(int dpy)
                 if (dpy < HWC_DISPLAY_VIRTUAL ||
                     m_workers[HWC_DISPLAY_PRIMARY].ovl_engine->getOverlaySessionMode() != DISP_SESSION_DECOUPLE_MIRROR_MODE)
                 {
-                    HWC_LOGW("No available overlay resource (input_num=%d)", job->num_layers);
+                    HWC_LOGW("No available overlay resource (input_num=%d)", num_layers);
                 }
 
-                job->num_layers = 1;
-            }
-            else
-            {
-                job->ovl_valid = true;
+                num_layers = 1;
+                ovl_valid = false;
             }
 
-            job->hw_layers = (HWLayer*)calloc(1, sizeof(HWLayer) * job->num_layers);
-            LOG_ALWAYS_FATAL_IF(job->hw_layers == nullptr, "hw_layers calloc(%zu) fail",
-                sizeof(HWLayer) * job->num_layers);
+            // the job of the last validation is replaced if it is not triggered
+            job = m_workers[dpy].dp_thread->acquireJob(m_curr_jobs[dpy], num_layers);
+            job->disp_ori_id = dpy;
+            job->num_layers = num_layers;
+            job->ovl_valid = ovl_valid;
 
             for (int32_t i = 0; i < job->num_layers; ++i)
             {
@@ -563,6 +560,7 @@ void HWCDispatcher::setJob(const sp<HWCDisplay>& display)
 
         // marked job that should be processed
         job->enable = job_enabled;
+        job->stage_time[JOB_STAGE_SET] = systemTime(SYSTEM_TIME_MONOTONIC);
     }
 }
 
@@ -1033,6 +1031,23 @@ void HWCDispatcher::dump(String8 *dump_str)
         if (m_workers[dpy].enable)
         {
             m_workers[dpy].ovl_engine->dump(dump_str);
+
+            const sp<DispatchThread>& dp_thread = m_workers[dpy].dp_thread;
+            const JobStageTrace& trace = dp_thread->getStageTrace();
+            dump_str->appendFormat("\n[HWC Dispatcher (%d)] jobs:%u dropped:%u queue:%d pool_free:%u/%d heap_jobs:%u\n",
+                dpy, trace.getCount(), trace.getDroppedCount(), dp_thread->getQueueSize(),
+                dp_thread->getJobPoolFreeNum(), HWC_JOB_POOL_DEPTH, dp_thread->getHeapJobCount());
+
+            static const char* const interval_name[JobStageTrace::INTERVAL_NUM] =
+                { "fill", "queue", "handle", "dispatch" };
+            for (int i = 0; i < JobStageTrace::INTERVAL_NUM; ++i)
+            {
+                const JobStageTrace::INTERVAL interval = static_cast<JobStageTrace::INTERVAL>(i);
+                dump_str->appendFormat("  %-8s p50:%.3fms p90:%.3fms p99:%.3fms\n", interval_name[i],
+                    trace.getPercentile(interval, 50) / 1e6,
+                    trace.getPercentile(interval, 90) / 1e6,
+                    trace.getPercentile(interval, 99) / 1e6);
+            }
         }
     }
 }
@@ -1064,11 +1079,32 @@ void HWCDispatcher::decOvlEnginePowerModeChanged(const int32_t& dpy) const
 
 DispatchThread::DispatchThread(int dpy)
     : m_disp_id(dpy)
+    , m_last_job(NULL)
+    , m_heap_job_count(0)
     , m_vsync_signaled(false)
     , m_continue_skip(0)
     , m_first_trigger(true)
 {
     snprintf(m_thread_name, sizeof(m_thread_name), "Dispatcher_%d", dpy);
+    snprintf(m_trace_name, sizeof(m_trace_name), "dispatch_latency_%d", dpy);
+
+    memset(m_job_layers, 0, sizeof(m_job_layers));
+    memset(m_job_layers_size, 0, sizeof(m_job_layers_size));
+}
+
+DispatchThread::~DispatchThread()
+{
+    // release the jobs which are queued after the thread exits
+    DispatcherJob* job = NULL;
+    while (m_job_queue.pop(&job))
+    {
+        clearUsedJob(job);
+    }
+
+    for (int i = 0; i < HWC_JOB_POOL_DEPTH; ++i)
+    {
+        free(m_job_layers[i]);
+    }
 }
 
 void DispatchThread::onFirstRef()
@@ -1076,6 +1112,53 @@ void DispatchThread::onFirstRef()
     run(m_thread_name, PRIORITY_URGENT_DISPLAY);
 }
 
+DispatcherJob* DispatchThread::acquireJob(DispatcherJob* prev_job, const int& num_layers)
+{
+    DispatcherJob* job = prev_job;
+    if (job != NULL)
+    {
+        freeJobResource(job);
+        job->~DispatcherJob();
+        new (job) DispatcherJob();
+    }
+    else
+    {
+        job = m_job_pool.acquire();
+        if (job == NULL)
+        {
+            ++m_heap_job_count;
+            HWC_LOGW("(%d) job pool is exhausted, allocate job from heap (%u)",
+                m_disp_id, m_heap_job_count);
+            job = new DispatcherJob();
+        }
+    }
+
+    if (m_job_pool.owns(job))
+    {
+        // hw_layers of preallocated jobs only grow
+        const uint32_t slot = m_job_pool.getSlot(job);
+        if (m_job_layers_size[slot] < num_layers)
+        {
+            free(m_job_layers[slot]);
+            m_job_layers[slot] = (HWLayer*)malloc(sizeof(HWLayer) * num_layers);
+            LOG_ALWAYS_FATAL_IF(m_job_layers[slot] == nullptr, "hw_layers malloc(%zu) fail",
+                sizeof(HWLayer) * num_layers);
+            m_job_layers_size[slot] = num_layers;
+        }
+        job->hw_layers = m_job_layers[slot];
+        memset(job->hw_layers, 0, sizeof(HWLayer) * num_layers);
+    }
+    else
+    {
+        job->hw_layers = (HWLayer*)calloc(1, sizeof(HWLayer) * num_layers);
+        LOG_ALWAYS_FATAL_IF(job->hw_layers == nullptr, "hw_layers calloc(%zu) fail",
+            sizeof(HWLayer) * num_layers);
+    }
+
+    job->stage_time[JOB_STAGE_ACQUIRE] = systemTime(SYSTEM_TIME_MONOTONIC);
+    return job;
+}
+
 void DispatchThread::trigger(DispatcherJob* job, bool async, bool skip)
 {
 #ifndef MTK_USER_BUILD
@@ -1088,13 +1171,27 @@ void DispatchThread::trigger(DispatcherJob* job, bool async, bool skip)
         need_drop = markDroppableJob();
     }
 
-    AutoMutex l(m_lock);
-
     if (job != NULL)
     {
-        m_job_queue.push_back(job);
+        job->stage_time[JOB_STAGE_QUEUE] = systemTime(SYSTEM_TIME_MONOTONIC);
+        job->queue_state.store(HWC_JOB_QUEUED, std::memory_order_relaxed);
+        while (!m_job_queue.push(job))
+        {
+            // trigger() waits for the thread before the queue is full,
+            // so it only happens if the vsync source is broken
+            HWC_LOGE("(%d) job queue is full, wait for clearing!!", m_disp_id);
+            {
+                AutoMutex l(m_lock);
+                m_state = HWC_THREAD_TRIGGER;
+                sem_post(&m_event);
+            }
+            wait();
+        }
+        m_last_job = job;
     }
 
+    AutoMutex l(m_lock);
+
     HWCDispatcher::WorkerCluster& worker(
             HWCDispatcher::getInstance().m_workers[m_disp_id]);
     // when ignore_job is set by DisplayManager when disconnect this display, so we do not care
@@ -1133,31 +1230,36 @@ void DispatchThread::trigger(DispatcherJob* job, bool async, bool skip)
 
 bool DispatchThread::markDroppableJob()
 {
-    AutoMutex l(m_lock);
-
-    if (!m_job_queue.size())
+    if (m_job_queue.empty() || m_last_job == NULL)
     {
         return false;
     }
 
-    DispatcherJob* last = m_job_queue.editItemAt(m_job_queue.size() - 1);
-    if (last == NULL || (last->fbt_exist && !last->mm_fbt))
+    // m_last_job is still in the queue only if it is in HWC_JOB_QUEUED state,
+    // otherwise it may have been handled and even reused by getJob().
+    // A job from heap may have been freed, so it is never dropped.
+    DispatcherJob* last = m_last_job;
+    if (!m_job_pool.owns(last) ||
+        last->queue_state.load(std::memory_order_acquire) != HWC_JOB_QUEUED ||
+        (last->fbt_exist && !last->mm_fbt))
     {
         return false;
     }
 
-    last->dropped = true;
-    return true;
+    int32_t expected = HWC_JOB_QUEUED;
+    return last->queue_state.compare_exchange_strong(expected, HWC_JOB_DROPPED);
 }
 
 bool DispatchThread::dropJob()
 {
-    bool res = false;
+    DispatcherJob* job = NULL;
+    if (!m_job_queue.front(&job))
     {
-        AutoMutex l(m_lock);
-        res |= m_job_queue[0]->dropped;
+        return false;
     }
 
+    bool res = job->queue_state.load(std::memory_order_acquire) == HWC_JOB_DROPPED;
+
     HWCDispatcher::WorkerCluster& worker(
                 HWCDispatcher::getInstance().m_workers[m_disp_id]);
     {
@@ -1167,68 +1269,69 @@ bool DispatchThread::dropJob()
 
     if (res)
     {
-        DispatcherJob* job = NULL;
-        {
-            AutoMutex l(m_lock);
-            Fifo::iterator front(m_job_queue.begin());
-            job = *front;
-            m_job_queue.erase(front);
-        }
-        HWC_LOGD("(%d) Drop a job %d", m_disp_id, job->sequence);
+        m_job_queue.pop(&job);
+        cancelJob(job);
+    }
+
+    return res;
+}
+
+void DispatchThread::cancelJob(DispatcherJob* job)
+{
+    HWCDispatcher::WorkerCluster& worker(
+                HWCDispatcher::getInstance().m_workers[m_disp_id]);
+
+    HWC_LOGD("(%d) Drop a job %d", m_disp_id, job->sequence);
 
-        if (job->enable)
+    if (job->enable)
+    {
+        AutoMutex l(worker.plug_lock_loop);
+        if (!HWCDispatcher::getInstance().m_is_worker_all_in_one)
         {
-            AutoMutex l(worker.plug_lock_loop);
-            if (!HWCDispatcher::getInstance().m_is_worker_all_in_one)
+            if (job->num_mm_layers || job->mm_fbt)
             {
-                if (job->num_mm_layers || job->mm_fbt)
+                if (worker.mm_thread != NULL)
                 {
-                    if (worker.mm_thread != NULL)
-                    {
-                        // signal the fence of MDP output
-                        worker.mm_thread->cancelLayers(job);
-                    }
-                    else
-                    {
-                        HWC_LOGE("No MMComposerThread");
-                    }
+                    // signal the fence of MDP output
+                    worker.mm_thread->cancelLayers(job);
                 }
-                if (job->num_ui_layers)
+                else
                 {
-                    if (worker.ui_thread != NULL)
-                    {
-                        worker.ui_thread->cancelLayers(job);
-                    }
-                    else
-                    {
-                        HWC_LOGE("No UIComposerThread");
-                    }
+                    HWC_LOGE("No MMComposerThread");
                 }
             }
-            else
+            if (job->num_ui_layers)
             {
-                if (job->num_mm_layers || job->mm_fbt || job->num_ui_layers)
+                if (worker.ui_thread != NULL)
                 {
-                    if (worker.composer != NULL)
-                    {
-                        worker.composer->cancelLayers(job);
-                    }
-                    else
-                    {
-                        HWC_LOGE("No LayerComposer");
-                    }
+                    worker.ui_thread->cancelLayers(job);
+                }
+                else
+                {
+                    HWC_LOGE("No UIComposerThread");
+                }
+            }
+        }
+        else
+        {
+            if (job->num_mm_layers || job->mm_fbt || job->num_ui_layers)
+            {
+                if (worker.composer != NULL)
+                {
+                    worker.composer->cancelLayers(job);
+                }
+                else
+                {
+                    HWC_LOGE("No LayerComposer");
                 }
             }
         }
-        clearUsedJob(job);
     }
-
-    return res;
+    clearUsedJob(job);
 }
 
 int DispatchThread::getQueueSize()
 {
-    AutoMutex l(m_lock);
     return m_job_queue.size();
 }
 
@@ -1242,13 +1345,10 @@ bool DispatchThread::threadLoop()
     {
         DispatcherJob* job = NULL;
 
+        if (m_job_queue.empty())
         {
-            AutoMutex l(m_lock);
-            if (m_job_queue.empty())
-            {
-                HWC_LOGV("(%d) Job is empty...", m_disp_id);
-                break;
-            }
+            HWC_LOGV("(%d) Job is empty...", m_disp_id);
+            break;
         }
 
 #ifndef MTK_USER_BUILD
@@ -1288,12 +1388,20 @@ bool DispatchThread::threadLoop()
         {
             continue;
         }
+
+        if (!m_job_queue.pop(&job))
+        {
+            continue;
+        }
+
+        // the job may be marked as dropped after dropJob() checked it
+        int32_t expected = HWC_JOB_QUEUED;
+        if (!job->queue_state.compare_exchange_strong(expected, HWC_JOB_HANDLING))
         {
-            AutoMutex l(m_lock);
-            Fifo::iterator front(m_job_queue.begin());
-            job = *front;
-            m_job_queue.erase(front);
+            cancelJob(job);
+            continue;
         }
+        job->stage_time[JOB_STAGE_DEQUEUE] = systemTime(SYSTEM_TIME_MONOTONIC);
         m_vsync_signaled = false;
 
         bool need_sync = true;
@@ -1470,18 +1578,45 @@ void DispatchThread::onVSync()
     }
 }
 
+void DispatchThread::freeJobResource(DispatcherJob* job)
+{
+    if(m_disp_id >= HWC_DISPLAY_VIRTUAL)
+    {
+        freeDuppedBufferHandle(job->hw_outbuf.handle);
+    }
+
+    if (!m_job_pool.owns(job))
+    {
+        free(job->hw_layers);
+    }
+    job->hw_layers = NULL;
+}
+
 void DispatchThread::clearUsedJob(DispatcherJob* job)
 {
     if(job == NULL)
         return;
 
-    if(m_disp_id >= HWC_DISPLAY_VIRTUAL)
+    job->stage_time[JOB_STAGE_DONE] = systemTime(SYSTEM_TIME_MONOTONIC);
+    m_stage_trace.record(job->stage_time);
+#ifndef MTK_USER_BUILD
+    if (job->stage_time[JOB_STAGE_DEQUEUE] != 0)
     {
-        freeDuppedBufferHandle(job->hw_outbuf.handle);
+        HWC_ATRACE_INT(m_trace_name,
+            static_cast<int32_t>(ns2us(job->stage_time[JOB_STAGE_DONE] - job->stage_time[JOB_STAGE_QUEUE])));
     }
+#endif
 
-    free(job->hw_layers);
-    delete job;
+    freeJobResource(job);
+
+    if (m_job_pool.owns(job))
+    {
+        m_job_pool.release(job);
+    }
+    else
+    {
+        delete job;
+    }
 }
 
 // ---------------------------------------------------------------------------
@@ -1747,13 +1882,18 @@ void HWCDispatcher::PhyPostHandler::setMirror(
                 ::dup(dst_mirbuf->mir_in_rel_fence_fd) :
                 dst_mirbuf->mir_in_rel_fence_fd;
 
-        int merged_fd = SyncFence::merge(
-            phy_outbuf->mir_out_if_fence_fd,
-            tmp_fd,
-            name);
+        // a fence which is signaled already is closed instead of merged
+        FenceSet fences(SyncFence::merge);
+        if (!fences.add(phy_outbuf->mir_out_if_fence_fd))
+            ::protectedClose(phy_outbuf->mir_out_if_fence_fd);
+        if (!fences.add(tmp_fd))
+            ::protectedClose(tmp_fd);
 
-        ::protectedClose(phy_outbuf->mir_out_if_fence_fd);
-        ::protectedClose(tmp_fd);
+        int merged_fd = -1;
+        if (fences.merge(name, &merged_fd) != NO_ERROR)
+        {
+            HWC_LOGE("merge fences(%d, %d) fail", phy_outbuf->mir_out_if_fence_fd, tmp_fd);
+        }
 
         // TODO: merge fences from different virtual displays to phy_outbuf->mir_out_mer_fence_fd
         phy_outbuf->mir_out_if_fence_fd = merged_fd;
@@ -2280,13 +2420,18 @@ void HWCDispatcher::PostProcessingHandler::setMirror(
                 ::dup(dst_mirbuf->mir_in_rel_fence_fd) :
                 dst_mirbuf->mir_in_rel_fence_fd;
 
-        int merged_fd = SyncFence::merge(
-            phy_outbuf->mir_out_if_fence_fd,
-            tmp_fd,
-            name);
+        // a fence which is signaled already is closed instead of merged
+        FenceSet fences(SyncFence::merge);
+        if (!fences.add(phy_outbuf->mir_out_if_fence_fd))
+            ::protectedClose(phy_outbuf->mir_out_if_fence_fd);
+        if (!fences.add(tmp_fd))
+            ::protectedClose(tmp_fd);
 
-        ::protectedClose(phy_outbuf->mir_out_if_fence_fd);
-        ::protectedClose(tmp_fd);
+        int merged_fd = -1;
+        if (fences.merge(name, &merged_fd) != NO_ERROR)
+        {
+            HWC_LOGE("merge fences(%d, %d) fail", phy_outbuf->mir_out_if_fence_fd, tmp_fd);
+        }
 
         // TODO: merge fences from different virtual displays to phy_outbuf->mir_out_mer_fence_fd
         phy_outbuf->mir_out_if_fence_fd = merged_fd;
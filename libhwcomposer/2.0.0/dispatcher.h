@@ -1,6 +1,7 @@
 #ifndef HWC_DISPATCHER_H_
 #define HWC_DISPATCHER_H_
 
+#include <atomic>
 #include <vector>
 #include <utils/threads.h>
 #include <utils/SortedVector.h>
@@ -15,6 +16,7 @@
 #include "worker.h"
 #include "composer.h"
 #include "hwdev.h"
+#include "job_queue.h"
 #include <linux/disp_session.h>
 
 using namespace android;
@@ -28,6 +30,15 @@ class HWCDisplay;
 
 #define FILL_BLACK_JOB_SIZE 2
 
+// amount of preallocated DispatcherJobs of each display
+// a job is in use from getJob() until DispatchThread finishes it, and trigger()
+// waits for DispatchThread if more than 5 jobs are queued, so the pool covers
+// one filling job, the queued jobs and one handling job
+#define HWC_JOB_POOL_DEPTH 8
+
+// capacity of the job queue of DispatchThread, it must be a power of two
+#define HWC_JOB_QUEUE_DEPTH 16
+
 // HWLayer::type values
 enum {
     HWC_LAYER_TYPE_INVALID      = 0,
@@ -111,6 +122,19 @@ enum HWC_POST_STATE
     HWC_POST_CONTINUE_MASK  = 0x0001,
 };
 
+// DispatcherJob::queue_state values
+enum HWC_JOB_QUEUE_STATE
+{
+    // the job is filled by HWCDispatcher and not queued yet
+    HWC_JOB_FILLING     = 0,
+    // the job is queued and waits for DispatchThread
+    HWC_JOB_QUEUED      = 1,
+    // the job is replaced by a newer job before DispatchThread takes it
+    HWC_JOB_DROPPED     = 2,
+    // the job is taken by DispatchThread and can not be dropped anymore
+    HWC_JOB_HANDLING    = 3,
+};
+
 enum {
     HWC_MIRROR_SOURCE_INVALID = -1,
 };
@@ -200,6 +224,9 @@ struct HWLayer
     // identify if layer has dirty pixels
     bool dirty;
 
+    // identify if MM layer is composed by SwComposer instead of MDP
+    bool sw_compose;
+
     union
     {
         // information of UI layer
@@ -367,7 +394,7 @@ struct DispatcherJob
         , secure(false)
         , mirrored(false)
         , need_output_buffer(false)
-        , dropped(false)
+        , queue_state(HWC_JOB_FILLING)
         , disp_ori_id(0)
         , disp_mir_id(HWC_MIRROR_SOURCE_INVALID)
         , disp_ori_rot(0)
@@ -396,7 +423,9 @@ struct DispatcherJob
         , num_processed_mm_layers(0)
         , is_black_job(false)
         , color_transform(nullptr)
-    { }
+    {
+        memset(stage_time, 0, sizeof(stage_time));
+    }
 
     // check if job should be processed
     bool enable;
@@ -415,8 +444,10 @@ struct DispatcherJob
     // if yes, it need to provide a decouple output buffer to display driver
     bool need_output_buffer;
 
-    // check if job should be dropped
-    bool dropped;
+    // state of the job in the queue of DispatchThread
+    // HWCDispatcher marks the last queued job as dropped and DispatchThread
+    // takes a job for handling, the transition must be atomic
+    std::atomic<int32_t> queue_state;
 
     // display id
     int disp_ori_id;
@@ -517,6 +548,9 @@ struct DispatcherJob
     bool is_black_job;
 
     sp<ColorTransform> color_transform;
+
+    // timestamp (ns) of each JOB_STAGE, 0 if the job has not passed the stage
+    int64_t stage_time[JOB_STAGE_NUM];
 };
 
 // HWCDispatcher is used to dispatch layers to DispatchThreads
@@ -810,6 +844,7 @@ class DispatchThread : public HWCThread,
 {
 public:
     DispatchThread(int dpy);
+    virtual ~DispatchThread();
 
     // trigger() is used to add a dispatch job into a job queue,
     // then triggers DispatchThread
@@ -819,6 +854,22 @@ public:
 
     int getQueueSize();
 
+    // acquireJob() is used by HWCDispatcher::getJob() to get a clean job
+    // with num_layers zeroed hw_layers.
+    // prev_job is the job of the last validation which is not triggered;
+    // it is reused if it is not NULL.
+    DispatcherJob* acquireJob(DispatcherJob* prev_job, const int& num_layers);
+
+    // getStageTrace() is used to get the latency of each stage of the jobs
+    const JobStageTrace& getStageTrace() const { return m_stage_trace; }
+
+    // getJobPoolFreeNum() returns the amount of free preallocated jobs
+    uint32_t getJobPoolFreeNum() const { return m_job_pool.getFreeNum(); }
+
+    // getHeapJobCount() returns the amount of jobs allocated from heap
+    // because the job pool was exhausted
+    uint32_t getHeapJobCount() const { return m_heap_job_count; }
+
 private:
     virtual void onFirstRef();
     virtual bool threadLoop();
@@ -837,17 +888,48 @@ private:
     // implementation of drop job
     bool dropJob();
 
+    // cancelJob() is used to cancel the layers of a dropped job and clear it
+    void cancelJob(DispatcherJob* job);
+
+    // clearUsedJob() is used to release a job to m_job_pool, or to heap
     void clearUsedJob(DispatcherJob* job);
 
+    // freeJobResource() is used to free the resources owned by a job
+    // except hw_layers of a preallocated job
+    void freeJobResource(DispatcherJob* job);
+
     // m_disp_id is used to identify which display
     // DispatchThread needs to handle
     int m_disp_id;
 
-    // m_job_queue is a job queue
-    // which new job would be queued in set()
-    typedef Vector<DispatcherJob*> Fifo;
+    // m_job_queue is a job queue which new job would be queued in set()
+    // all producers hold plug_lock_main of the display,
+    // and this thread is the only consumer
+    typedef SpscRing<DispatcherJob*, HWC_JOB_QUEUE_DEPTH> Fifo;
     Fifo m_job_queue;
 
+    // m_job_pool is the preallocated jobs of this display
+    // jobs are acquired in getJob() with plug_lock_main, and released by
+    // this thread
+    ObjectPool<DispatcherJob, HWC_JOB_POOL_DEPTH> m_job_pool;
+
+    // m_job_layers[i] is hw_layers of the i-th job of m_job_pool
+    // it only grows, and is only touched by the owner of the job
+    HWLayer* m_job_layers[HWC_JOB_POOL_DEPTH];
+    int m_job_layers_size[HWC_JOB_POOL_DEPTH];
+
+    // m_last_job is the last job queued by trigger()
+    // it is only used by the producer to mark it as dropped
+    DispatcherJob* m_last_job;
+
+    uint32_t m_heap_job_count;
+
+    // m_stage_trace keeps the latency of each stage of handled jobs
+    JobStageTrace m_stage_trace;
+
+    // name of the systrace counter of dispatch latency
+    char m_trace_name[32];
+
     // access must be protected by m_vsync_lock
     mutable Mutex m_vsync_lock;
     Condition m_vsync_cond;
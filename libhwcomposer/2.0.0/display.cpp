@@ -240,6 +240,16 @@ void DisplayManager::dump(struct dump_buff* /*log*/)
         g_uevent_thread->setProperty();
 }
 
+void DisplayManager::dumpVSync(String8* str)
+{
+    for (int dpy = 0; dpy < MAX_DISPLAYS; dpy++)
+    {
+        AutoMutex _l(m_vsyncs[dpy].lock);
+        if (m_vsyncs[dpy].thread != NULL)
+            m_vsyncs[dpy].thread->dump(str);
+    }
+}
+
 void DisplayManager::setListener(const sp<EventListener>& listener)
 {
     m_listener = listener;
@@ -77,6 +77,9 @@ public:
     // dump() for debug prupose
     void dump(struct dump_buff* log);
 
+    // dumpVSync() dumps the vsync model of each display
+    void dumpVSync(String8* str);
+
     // init() is used to initialize DisplayManager
     void init();
 
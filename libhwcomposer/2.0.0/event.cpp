@@ -41,7 +41,8 @@ VSyncThread::VSyncThread(int dpy)
     , m_refresh(1e9/60)
     , m_loop(false)
     , m_fake_vsync(false)
-    , m_prev_fake_vsync(0)
+    , m_prev_vsync(0)
+    , m_wakeup_offset(0)
     , m_max_period_io(20)
     , m_max_period_req(500)
 {
@@ -74,6 +75,18 @@ void VSyncThread::initialize(bool force_sw_vsync, nsecs_t refresh)
         m_max_period_io = m_refresh + timeout;
     }
 
+    property_get("debug.hwc.vsync_offset_us", value, "0");
+    {
+        Mutex::Autolock _l(m_model_lock);
+        m_model.reset(m_refresh);
+        m_wakeup_offset = us2ns(atoi(value));
+    }
+
+    if (!m_timer.isValid())
+    {
+        HWC_LOGW("(%d) timerfd is not available, sw vsync uses clock_nanosleep", m_disp_id);
+    }
+
     run(m_thread_name, PRIORITY_URGENT_DISPLAY);
 
     if (m_fake_vsync)
@@ -125,6 +138,11 @@ bool VSyncThread::threadLoop()
             static nsecs_t prev_next_vsync = 0;
             HWC_ATRACE_BUFFER("period: %" PRId64, next_vsync - prev_next_vsync)
             prev_next_vsync = next_vsync;
+
+            {
+                Mutex::Autolock _l(m_model_lock);
+                m_model.addSample(next_vsync);
+            }
 #ifdef DEBUG_VSYNC_TIME
             const nsecs_t time_curr = systemTime();
             const nsecs_t dur1 = time_curr - g_time_prev;
@@ -145,35 +163,48 @@ bool VSyncThread::threadLoop()
 
     if (use_fake_vsync)
     {
-        const nsecs_t& period = m_refresh;
-        const nsecs_t now = systemTime(CLOCK_MONOTONIC);
-        next_vsync = m_prev_fake_vsync + period;
-        nsecs_t sleep = next_vsync - now;
+        next_vsync = waitSwVSync();
+    }
 
-        if (sleep < 0)
-        {
-            sleep = (period - ((now - next_vsync) % period));
-            next_vsync = now + sleep;
-        }
+    m_prev_vsync = next_vsync;
 
-        struct timespec spec;
-        spec.tv_sec  = next_vsync / 1000000000;
-        spec.tv_nsec = next_vsync % 1000000000;
+    DisplayManager::getInstance().vsync(m_disp_id, next_vsync, is_enabled);
+
+    return true;
+}
+
+nsecs_t VSyncThread::waitSwVSync()
+{
+    const nsecs_t now = systemTime(CLOCK_MONOTONIC);
+    nsecs_t next_vsync = 0;
+    nsecs_t wakeup = 0;
+    {
+        Mutex::Autolock _l(m_model_lock);
+        wakeup = m_model.computeNextWakeup(now, m_wakeup_offset, m_prev_vsync, &next_vsync);
+    }
 
+    HWC_LOGD("(%d) use SW VSync sleep: %.2f ms", m_disp_id, (wakeup - now) / 1000000.0);
+
+    // the timer wakes up at an absolute time, so the grid does not drift
+    // with the latency of each wakeup
+    if (!m_timer.waitUntil(wakeup))
+    {
+        struct timespec spec;
+        spec.tv_sec  = wakeup / 1000000000;
+        spec.tv_nsec = wakeup % 1000000000;
 
-        HWC_LOGD("(%d) use SW VSync sleep: %.2f ms", m_disp_id, sleep / 1000000.0);
         int err;
         do {
-
             err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &spec, NULL);
         } while (err<0 && errno == EINTR);
-
-        m_prev_fake_vsync = next_vsync;
     }
 
-    DisplayManager::getInstance().vsync(m_disp_id, next_vsync, is_enabled);
+    {
+        Mutex::Autolock _l(m_model_lock);
+        m_model.addWakeup(wakeup, systemTime(CLOCK_MONOTONIC));
+    }
 
-    return true;
+    return next_vsync;
 }
 
 void VSyncThread::setEnabled(bool enabled)
@@ -214,6 +245,16 @@ void VSyncThread::setProperty()
     {
         m_refresh = nsecs_t(1e9 / fps);
         HWC_LOGD("Set sw vsync fps(%d), period(%d)", __func__, fps, m_refresh);
+
+        Mutex::Autolock _l(m_model_lock);
+        m_model.reset(m_refresh);
+    }
+
+    property_get("debug.hwc.vsync_offset_us", value, "0");
+    {
+        // waitSwVSync() of the vsync thread reads it under the same lock
+        Mutex::Autolock _l(m_model_lock);
+        m_wakeup_offset = us2ns(atoi(value));
     }
 
     property_get("debug.hwc.period_io", value, "0");
@@ -231,6 +272,23 @@ void VSyncThread::setProperty()
     }
 }
 
+void VSyncThread::dump(String8* str) const
+{
+    Mutex::Autolock _l(m_model_lock);
+    const VSyncStats& stats = m_model.getStats();
+
+    str->appendFormat("[VSync] dpy:%d hw:%d locked:%d period:%.3f ms (nominal:%.3f ms) offset(debug.hwc.vsync_offset_us):%" PRId64 " us\n",
+        m_disp_id, !m_fake_vsync, m_model.isLocked(),
+        m_model.getPeriod() / 1e6, m_model.getNominalPeriod() / 1e6, ns2us(m_wakeup_offset));
+    str->appendFormat("  hw timestamps accepted:%u rejected:%u relocks:%u jitter mean:%.1f sd:%.1f max:%.1f us\n",
+        stats.accepted, stats.rejected, stats.relocks,
+        stats.sample_error.getMean() / 1e3, stats.sample_error.getStdDev() / 1e3,
+        stats.sample_error.max_abs / 1e3);
+    str->appendFormat("  sw wakeups:%u latency mean:%.1f sd:%.1f max:%.1f us\n",
+        stats.wakeup_latency.count, stats.wakeup_latency.getMean() / 1e3,
+        stats.wakeup_latency.getStdDev() / 1e3, stats.wakeup_latency.max_abs / 1e3);
+}
+
 // ---------------------------------------------------------------------------
 #define UEVENT_BUFFER_SIZE 2048
 
@@ -2,7 +2,9 @@
 #define HWC_EVENT_H_
 
 #include <utils/threads.h>
+#include <utils/String8.h>
 #include "worker.h"
+#include "vsync_model.h"
 
 using namespace android;
 
@@ -26,10 +28,17 @@ public:
     // setProperty() is used for debug purpose
     void setProperty();
 
+    // dump() is used to dump the vsync model and the jitter statistics
+    void dump(String8* str) const;
+
 private:
     virtual void onFirstRef() { }
     virtual bool threadLoop();
 
+    // waitSwVSync() sleeps until the next sw vsync predicted by m_model
+    // plus m_wakeup_offset; return the vsync timestamp
+    nsecs_t waitSwVSync();
+
     mutable Mutex m_lock;
     Condition m_condition;
 
@@ -42,7 +51,19 @@ private:
     bool m_loop;
 
     bool m_fake_vsync;
-    mutable nsecs_t m_prev_fake_vsync;
+
+    // m_prev_vsync is the last vsync sent, from hw or sw
+    nsecs_t m_prev_vsync;
+
+    // m_model is fitted to hw vsync, and sw vsync follows it when hw vsync
+    // is not available, so sw vsync keeps the phase of the panel
+    mutable Mutex m_model_lock;
+    VSyncModel m_model;
+    VSyncTimer m_timer;
+
+    // m_wakeup_offset moves the wakeup of sw vsync from the vsync,
+    // negative for earlier; guarded by m_model_lock
+    nsecs_t m_wakeup_offset;
 
     long m_max_period_io;
     long m_max_period_req;
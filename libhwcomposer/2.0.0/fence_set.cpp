@@ -0,0 +1,215 @@
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "fence_set.h"
+
+// ---------------------------------------------------------------------------
+
+static int64_t getMonotonicMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+FenceSet::FenceSet(MergeFunc merge_func)
+    : m_merge_func(merge_func)
+    , m_num(0)
+    , m_error(0)
+    , m_poll_count(0)
+    , m_merge_count(0)
+{
+}
+
+FenceSet::~FenceSet()
+{
+    clear();
+}
+
+bool FenceSet::add(const int& fd)
+{
+    if (fd < 0)
+        return true;
+
+    // stdin, stdout, and stderr are never fences, leave them to the caller
+    // which aborts on them in protectedClose()
+    if (fd < 3 || m_num >= MAX_FENCE_NUM)
+        return false;
+
+    m_fds[m_num++] = fd;
+    return true;
+}
+
+void FenceSet::remove(const size_t& idx)
+{
+    ::close(m_fds[idx]);
+    m_fds[idx] = m_fds[--m_num];
+}
+
+void FenceSet::clear()
+{
+    for (size_t i = 0; i < m_num; ++i)
+    {
+        ::close(m_fds[i]);
+    }
+    m_num = 0;
+    m_error = 0;
+}
+
+int FenceSet::poll(const int& timeout)
+{
+    const int64_t deadline = timeout > 0 ? getMonotonicMs() + timeout : 0;
+    struct pollfd fds[MAX_FENCE_NUM];
+
+    while (m_num > 0)
+    {
+        for (size_t i = 0; i < m_num; ++i)
+        {
+            fds[i].fd = m_fds[i];
+            fds[i].events = POLLIN;
+            fds[i].revents = 0;
+        }
+
+        int remaining = timeout;
+        if (timeout > 0)
+        {
+            const int64_t left = deadline - getMonotonicMs();
+            remaining = left > 0 ? static_cast<int>(left) : 0;
+        }
+
+        ++m_poll_count;
+        const int ret = ::poll(fds, m_num, remaining);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -errno;
+        }
+
+        if (ret == 0)
+            break;
+
+        // remove from the back, so the fences moved by remove()
+        // are the ones which are checked already
+        for (size_t i = m_num; i-- > 0;)
+        {
+            if (fds[i].revents == 0)
+                continue;
+
+            if ((fds[i].revents & (POLLERR | POLLNVAL)) && m_error == 0)
+                m_error = -EINVAL;
+            remove(i);
+        }
+
+        if (timeout == 0)
+            break;
+    }
+
+    return static_cast<int>(m_num);
+}
+
+int FenceSet::wait(const int& timeout)
+{
+    const int pending = poll(timeout);
+    if (pending < 0)
+        return pending;
+
+    if (pending > 0)
+        return -ETIME;
+
+    const int err = m_error;
+    m_error = 0;
+    return err;
+}
+
+int FenceSet::merge(const char* name, int* merged_fd)
+{
+    *merged_fd = -1;
+
+    // the signaled fences need not be merged
+    const int pending = poll(0);
+    if (pending < 0)
+        return pending;
+
+    if (m_num == 0)
+    {
+        m_error = 0;
+        return 0;
+    }
+
+    // the last fence is handed over to the caller as is
+    if (m_num == 1)
+    {
+        *merged_fd = m_fds[0];
+        m_num = 0;
+        m_error = 0;
+        return 0;
+    }
+
+    if (m_merge_func == NULL)
+        return -ENOSYS;
+
+    // level[] holds the fences to merge in this round, is_temp[] marks the
+    // fences created by an earlier round, which are closed once merged
+    int level[MAX_FENCE_NUM];
+    bool is_temp[MAX_FENCE_NUM];
+    size_t level_num = m_num;
+    for (size_t i = 0; i < m_num; ++i)
+    {
+        level[i] = m_fds[i];
+        is_temp[i] = false;
+    }
+
+    while (level_num > 1)
+    {
+        size_t next_num = 0;
+        for (size_t i = 0; i < level_num; i += 2)
+        {
+            // the odd one goes up to the next round
+            if (i + 1 == level_num)
+            {
+                level[next_num] = level[i];
+                is_temp[next_num] = is_temp[i];
+                ++next_num;
+                continue;
+            }
+
+            ++m_merge_count;
+            const int fd = m_merge_func(level[i], level[i + 1], name);
+            if (fd < 0)
+            {
+                const int err = errno ? -errno : -EINVAL;
+
+                // the fences of the next round are in level[0, next_num),
+                // the rest of this round in level[i, level_num)
+                for (size_t j = 0; j < next_num; ++j)
+                {
+                    ::close(level[j]);
+                }
+                for (size_t j = i; j < level_num; ++j)
+                {
+                    if (is_temp[j])
+                        ::close(level[j]);
+                }
+                return err;
+            }
+
+            if (is_temp[i])
+                ::close(level[i]);
+            if (is_temp[i + 1])
+                ::close(level[i + 1]);
+
+            level[next_num] = fd;
+            is_temp[next_num] = true;
+            ++next_num;
+        }
+        level_num = next_num;
+    }
+
+    clear();
+    *merged_fd = level[0];
+    return 0;
+}
@@ -0,0 +1,89 @@
+#ifndef HWC_FENCE_SET_H_
+#define HWC_FENCE_SET_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ---------------------------------------------------------------------------
+
+// FenceSet holds the fences which a job waits for at the same time, e.g. the
+// acquire fences of all input layers of a frame.
+// A sync fence fd is readable (POLLIN) once it is signaled, so
+//  - the status of all fences is checked by one poll() with zero timeout,
+//    and the signaled ones are closed without any wait
+//  - all fences are waited by one poll() instead of a sync_wait() per fence
+//  - the remaining fences are merged as a balanced tree, each level halves
+//    the number of fences and no merged fence grows by one point per layer
+// FenceSet owns the fences added to it and closes them when they are
+// signaled, merged, cleared, or the set is destroyed.
+// It is not thread safe; a set is used by the thread which fills it.
+class FenceSet
+{
+public:
+    enum
+    {
+        MAX_FENCE_NUM = 64,
+    };
+
+    // MergeFunc merges two fences into a new one, without closing them;
+    // it returns a valid fd on success, otherwise -1
+    // (the same as SyncFence::merge())
+    typedef int (*MergeFunc)(int fd1, int fd2, const char* name);
+
+    explicit FenceSet(MergeFunc merge_func = NULL);
+
+    ~FenceSet();
+
+    // add() takes the ownership of fd, -1 is ignored.
+    // return false if the set is full or fd is not a fence (0 to 2),
+    // then fd is still owned by the caller
+    bool add(const int& fd);
+
+    size_t size() const { return m_num; }
+
+    bool isEmpty() const { return m_num == 0; }
+
+    int getFd(const size_t& idx) const { return m_fds[idx]; }
+
+    // poll() closes the fences which are signaled within timeout ms
+    // (0 for a status check, < 0 for no limit) with one syscall per wakeup.
+    // return the number of fences which are not signaled, or -errno
+    int poll(const int& timeout);
+
+    // wait() waits for all fences to be signaled within timeout ms
+    // (< 0 for no limit).
+    // return 0 on success, -ETIME if some fences are still in the set
+    // after timeout, or -errno; a fence with an error counts as signaled
+    // and its error is returned after the other fences
+    int wait(const int& timeout);
+
+    // merge() closes the signaled fences and merges the others as a balanced
+    // tree into one new fence, which is owned by the caller.
+    // *merged_fd is -1 if all fences are signaled.
+    // return 0 on success; otherwise -errno, and the set is not changed
+    int merge(const char* name, int* merged_fd);
+
+    // clear() closes all fences in the set
+    void clear();
+
+    // the number of syscalls, for profiling
+    uint32_t getPollCount() const { return m_poll_count; }
+    uint32_t getMergeCount() const { return m_merge_count; }
+
+private:
+    // remove() closes the fence at idx and moves the last fence into its slot
+    void remove(const size_t& idx);
+
+    MergeFunc m_merge_func;
+
+    int m_fds[MAX_FENCE_NUM];
+    size_t m_num;
+
+    // the first error of a fence which is removed by poll()
+    int m_error;
+
+    uint32_t m_poll_count;
+    uint32_t m_merge_count;
+};
+
+#endif // HWC_FENCE_SET_H_
@@ -0,0 +1,275 @@
+#include <string.h>
+
+#include "frame_trace.h"
+
+// ---------------------------------------------------------------------------
+
+// the records are written as they are, without padding
+static_assert(sizeof(FrameTraceFrame) == 88, "FrameTraceFrame has padding");
+static_assert(sizeof(FrameTraceLayer) == 160, "FrameTraceLayer has padding");
+
+// a frame of a dozen layers is about 1.4KB, so a buffer of some frames
+// keeps the recording from writing on every frame
+#define FRAME_TRACE_BUFFER_SIZE (64 * 1024)
+
+// no layer stack is larger than this, anything more is a broken file
+#define FRAME_TRACE_MAX_LAYERS (256)
+
+FrameTraceWriter::FrameTraceWriter()
+    : m_file(NULL)
+    , m_max_frames(0)
+    , m_frame_num(0)
+{
+}
+
+FrameTraceWriter::~FrameTraceWriter()
+{
+    close();
+}
+
+bool FrameTraceWriter::open(const char* path, const uint32_t& max_frames)
+{
+    close();
+
+    m_file = fopen(path, "wb");
+    if (m_file == NULL)
+        return false;
+
+    setvbuf(m_file, NULL, _IOFBF, FRAME_TRACE_BUFFER_SIZE);
+
+    FrameTraceHeader header;
+    header.magic = FRAME_TRACE_MAGIC;
+    header.version = FRAME_TRACE_VERSION;
+    header.frame_size = sizeof(FrameTraceFrame);
+    header.layer_size = sizeof(FrameTraceLayer);
+    if (fwrite(&header, sizeof(header), 1, m_file) != 1)
+    {
+        close();
+        return false;
+    }
+
+    m_max_frames = max_frames;
+    m_frame_num = 0;
+    return true;
+}
+
+void FrameTraceWriter::close()
+{
+    if (m_file != NULL)
+    {
+        fclose(m_file);
+        m_file = NULL;
+    }
+}
+
+bool FrameTraceWriter::write(const FrameTraceFrame& frame, const FrameTraceLayer* layers)
+{
+    if (m_file == NULL || isFull())
+        return false;
+
+    if (fwrite(&frame, sizeof(frame), 1, m_file) != 1)
+        return false;
+
+    if (frame.layer_num > 0 &&
+        fwrite(layers, sizeof(FrameTraceLayer), frame.layer_num, m_file) != frame.layer_num)
+    {
+        return false;
+    }
+
+    ++m_frame_num;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+
+FrameTraceReader::FrameTraceReader()
+    : m_file(NULL)
+{
+}
+
+FrameTraceReader::~FrameTraceReader()
+{
+    close();
+}
+
+bool FrameTraceReader::open(const char* path)
+{
+    close();
+
+    m_file = fopen(path, "rb");
+    if (m_file == NULL)
+        return false;
+
+    FrameTraceHeader header;
+    if (fread(&header, sizeof(header), 1, m_file) != 1 ||
+        header.magic != FRAME_TRACE_MAGIC ||
+        header.version != FRAME_TRACE_VERSION ||
+        header.frame_size != sizeof(FrameTraceFrame) ||
+        header.layer_size != sizeof(FrameTraceLayer))
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void FrameTraceReader::close()
+{
+    if (m_file != NULL)
+    {
+        fclose(m_file);
+        m_file = NULL;
+    }
+}
+
+bool FrameTraceReader::read(FrameTraceFrame* frame, std::vector<FrameTraceLayer>* layers)
+{
+    if (m_file == NULL)
+        return false;
+
+    if (fread(frame, sizeof(*frame), 1, m_file) != 1)
+        return false;
+
+    if (frame->layer_num > FRAME_TRACE_MAX_LAYERS)
+        return false;
+
+    layers->resize(frame->layer_num);
+    if (frame->layer_num > 0 &&
+        fread(layers->data(), sizeof(FrameTraceLayer), frame->layer_num, m_file) != frame->layer_num)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+
+void setFrameTraceValiState(FrameTraceFrame* frame, const ValiDisplayState& state)
+{
+    frame->mirror_src = state.mirror_src;
+    if (state.mirror_src != -1)
+        frame->flags |= FRAME_TRACE_MIRROR;
+    if (state.force_gpu)
+        frame->flags |= FRAME_TRACE_FORCE_GPU;
+    frame->compose_level = state.compose_level;
+    frame->mdp_scale_percentage = state.mdp_scale_percentage;
+    frame->sw_compose = state.sw_compose;
+    frame->video_hdcp = state.video_hdcp;
+    frame->hdcp_version = state.hdcp_version;
+    frame->prexform_ui = state.prexform_ui;
+    if (state.secure)
+        frame->flags |= FRAME_TRACE_SECURE;
+    if (state.rgba_rotate)
+        frame->flags |= FRAME_TRACE_RGBA_ROTATE;
+    if (state.rgbx_scaling)
+        frame->flags |= FRAME_TRACE_RGBX_SCALING;
+    if (state.global_pq)
+        frame->flags |= FRAME_TRACE_GLOBAL_PQ;
+    if (state.uipq_debug)
+        frame->flags |= FRAME_TRACE_UIPQ_DEBUG;
+    if (state.disp_decompress)
+        frame->flags |= FRAME_TRACE_DISP_DECOMPRESS;
+    if (state.mdp_decompress)
+        frame->flags |= FRAME_TRACE_MDP_DECOMPRESS;
+}
+
+void setFrameTraceValiState(FrameTraceLayer* layer, const ValiLayerState& state)
+{
+    layer->id = state.id;
+    layer->sf_comp_type = state.sf_comp_type;
+    layer->display_frame[0] = state.display_frame.left;
+    layer->display_frame[1] = state.display_frame.top;
+    layer->display_frame[2] = state.display_frame.right;
+    layer->display_frame[3] = state.display_frame.bottom;
+    layer->source_crop[0] = state.source_crop.left;
+    layer->source_crop[1] = state.source_crop.top;
+    layer->source_crop[2] = state.source_crop.right;
+    layer->source_crop[3] = state.source_crop.bottom;
+    layer->blend = state.blend;
+    layer->dataspace = state.dataspace;
+    layer->plane_alpha = state.plane_alpha;
+    layer->transform = state.transform;
+    if (state.has_handle)
+    {
+        layer->flags |= FRAME_TRACE_LAYER_HAS_BUFFER;
+        layer->format = state.format;
+        layer->width = state.width;
+        layer->height = state.height;
+        layer->usage = state.usage;
+        layer->prexform = state.prexform;
+        layer->ext_status = state.ext_status;
+        layer->ext_status2 = state.ext_status2;
+        if (state.secure)
+            layer->flags |= FRAME_TRACE_LAYER_SEC_HANDLE | FRAME_TRACE_LAYER_SECURE;
+    }
+}
+
+void getFrameTraceValiState(const FrameTraceFrame& frame, ValiDisplayState* state)
+{
+    memset(state, 0, sizeof(*state));
+    state->mirror_src = frame.mirror_src;
+    state->force_gpu = frame.flags & FRAME_TRACE_FORCE_GPU;
+    state->compose_level = frame.compose_level;
+    state->mdp_scale_percentage = frame.mdp_scale_percentage;
+    state->sw_compose = frame.sw_compose;
+    state->video_hdcp = frame.video_hdcp;
+    state->hdcp_version = frame.hdcp_version;
+    state->secure = frame.flags & FRAME_TRACE_SECURE;
+    state->prexform_ui = frame.prexform_ui;
+    state->rgba_rotate = frame.flags & FRAME_TRACE_RGBA_ROTATE;
+    state->rgbx_scaling = frame.flags & FRAME_TRACE_RGBX_SCALING;
+    state->global_pq = frame.flags & FRAME_TRACE_GLOBAL_PQ;
+    state->uipq_debug = frame.flags & FRAME_TRACE_UIPQ_DEBUG;
+    state->disp_decompress = frame.flags & FRAME_TRACE_DISP_DECOMPRESS;
+    state->mdp_decompress = frame.flags & FRAME_TRACE_MDP_DECOMPRESS;
+}
+
+void getFrameTraceValiState(const FrameTraceLayer& layer, ValiLayerState* state)
+{
+    memset(state, 0, sizeof(*state));
+    state->id = layer.id;
+    state->sf_comp_type = layer.sf_comp_type;
+    state->display_frame.left = layer.display_frame[0];
+    state->display_frame.top = layer.display_frame[1];
+    state->display_frame.right = layer.display_frame[2];
+    state->display_frame.bottom = layer.display_frame[3];
+    state->source_crop.left = layer.source_crop[0];
+    state->source_crop.top = layer.source_crop[1];
+    state->source_crop.right = layer.source_crop[2];
+    state->source_crop.bottom = layer.source_crop[3];
+    state->blend = layer.blend;
+    state->dataspace = layer.dataspace;
+    state->plane_alpha = layer.plane_alpha;
+    state->transform = layer.transform;
+    state->has_handle = layer.flags & FRAME_TRACE_LAYER_HAS_BUFFER;
+    if (state->has_handle)
+    {
+        state->format = layer.format;
+        state->width = layer.width;
+        state->height = layer.height;
+        state->usage = layer.usage;
+        state->prexform = layer.prexform;
+        state->ext_status = layer.ext_status;
+        state->ext_status2 = layer.ext_status2;
+        state->secure = layer.flags & FRAME_TRACE_LAYER_SEC_HANDLE;
+    }
+}
+
+uint64_t calculateFrameTraceFingerprint(
+    const FrameTraceFrame& frame, const FrameTraceLayer* layers)
+{
+    ValiFingerprint fingerprint;
+    ValiDisplayState disp_state;
+    getFrameTraceValiState(frame, &disp_state);
+    addValiDisplayState(&fingerprint, disp_state, frame.layer_num);
+
+    for (uint32_t i = 0; i < frame.layer_num; ++i)
+    {
+        ValiLayerState layer_state;
+        getFrameTraceValiState(layers[i], &layer_state);
+        addValiLayerState(&fingerprint, layer_state);
+    }
+    return fingerprint.get();
+}
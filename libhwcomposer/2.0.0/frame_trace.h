@@ -0,0 +1,220 @@
+#ifndef HWC_FRAME_TRACE_H_
+#define HWC_FRAME_TRACE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#include "vali_cache.h"
+
+// ---------------------------------------------------------------------------
+
+// A frame trace records the layer stack of each frame which HWC validates
+// and presents, with the composition decided for it and the cpu time of
+// validate and present, so the frames can be replayed on a host
+// (test/frame_replay.cpp) to find regressions of the composition decision.
+//
+// The file is a FrameTraceHeader, then for each frame a FrameTraceFrame
+// followed by layer_num FrameTraceLayer, little endian as written.
+// Buffer contents and fences are not recorded, only their properties.
+
+enum
+{
+    FRAME_TRACE_MAGIC   = 0x54435748, // "HWCT"
+    FRAME_TRACE_VERSION = 3,
+};
+
+struct FrameTraceHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t frame_size;
+    uint32_t layer_size;
+};
+
+// FrameTraceFrame::flags
+enum
+{
+    FRAME_TRACE_VALI_CACHE_HIT  = 1 << 0,
+    FRAME_TRACE_SKIP_VALIDATE   = 1 << 1,
+    FRAME_TRACE_FORCE_GPU       = 1 << 2,
+    FRAME_TRACE_MIRROR          = 1 << 3,
+
+    // hrt_gles_head/tail and the hrt_* of the layers are the input of the
+    // hrt query; not set when the frame reused a plan without a query
+    FRAME_TRACE_HRT_QUERY       = 1 << 4,
+
+    // the display and platform states of ValiDisplayState
+    FRAME_TRACE_SECURE          = 1 << 5,
+    FRAME_TRACE_RGBA_ROTATE     = 1 << 6,
+    FRAME_TRACE_RGBX_SCALING    = 1 << 7,
+    FRAME_TRACE_GLOBAL_PQ       = 1 << 8,
+    FRAME_TRACE_UIPQ_DEBUG      = 1 << 9,
+    FRAME_TRACE_DISP_DECOMPRESS = 1 << 10,
+    FRAME_TRACE_MDP_DECOMPRESS  = 1 << 11,
+};
+
+struct FrameTraceFrame
+{
+    uint32_t sequence;
+    uint32_t disp_id;
+    uint32_t layer_num;
+    uint32_t flags;
+    int32_t disp_width;
+    int32_t disp_height;
+
+    // the GLES range which HWC decided, -1 for none
+    int32_t gles_head;
+    int32_t gles_tail;
+
+    // cpu time of validateDisplay and presentDisplay on the device
+    uint32_t validate_ns;
+    uint32_t present_ns;
+
+    // the fingerprint of HWCDisplay::updateValiFingerprint(), and the
+    // states of the display it was built from (ValiDisplayState)
+    uint64_t vali_fingerprint;
+    double mdp_scale_percentage;
+    int32_t mirror_src;
+    int32_t compose_level;
+    uint32_t video_hdcp;
+    uint32_t hdcp_version;
+    uint32_t sw_compose;
+
+    // the GLES range which validate gave to hrt, before the arbitration
+    int32_t hrt_gles_head;
+    int32_t hrt_gles_tail;
+
+    int32_t prexform_ui;
+};
+
+// FrameTraceLayer::flags
+enum
+{
+    FRAME_TRACE_LAYER_HAS_BUFFER        = 1 << 0,
+    FRAME_TRACE_LAYER_BUFFER_CHANGED    = 1 << 1,
+    FRAME_TRACE_LAYER_STATE_CHANGED     = 1 << 2,
+    FRAME_TRACE_LAYER_SECURE            = 1 << 3,
+
+    // composed by MDP, or by SwComposer instead of MDP
+    FRAME_TRACE_LAYER_MDP               = 1 << 4,
+    FRAME_TRACE_LAYER_SW_COMPOSE        = 1 << 5,
+
+    // the buffer has a secure handle, as the fingerprint has it;
+    // FRAME_TRACE_LAYER_SECURE is also set for a secure usage
+    FRAME_TRACE_LAYER_SEC_HANDLE        = 1 << 6,
+};
+
+struct FrameTraceLayer
+{
+    uint64_t id;
+
+    // the states validate depends on (ValiLayerState)
+    int32_t display_frame[4];
+    float source_crop[4];
+    int32_t format;
+    int32_t width;
+    int32_t height;
+    uint32_t usage;
+    uint32_t ext_status;
+    uint32_t ext_status2;
+    int32_t dataspace;
+    int32_t blend;
+    int32_t transform;
+    int32_t prexform;
+    float plane_alpha;
+
+    // bounds of the damage of this frame, and the number of rects
+    int32_t damage_bounds[4];
+    uint32_t damage_num;
+
+    // the composition type asked by SF, and the one HWC decided
+    int32_t sf_comp_type;
+    int32_t comp_type;
+    int32_t hwlayer_type;
+    int32_t layer_caps;
+
+    uint32_t flags;
+    uint32_t reserved;
+
+    // the layer_config which Hrt::fillLayerConfigList() gave to the hrt
+    // query, with FRAME_TRACE_HRT_QUERY
+    uint32_t hrt_src_fmt;
+    uint32_t hrt_src_width;
+    uint32_t hrt_src_height;
+    uint32_t hrt_layer_caps;
+    int32_t hrt_dst_offset_x;
+    int32_t hrt_dst_offset_y;
+    uint32_t hrt_dst_width;
+    uint32_t hrt_dst_height;
+};
+
+// the validate states of a frame and of its layers in the trace, as
+// HWCDisplay::getValiState() and HWCLayer::getValiState() give them
+void setFrameTraceValiState(FrameTraceFrame* frame, const ValiDisplayState& state);
+void setFrameTraceValiState(FrameTraceLayer* layer, const ValiLayerState& state);
+void getFrameTraceValiState(const FrameTraceFrame& frame, ValiDisplayState* state);
+void getFrameTraceValiState(const FrameTraceLayer& layer, ValiLayerState* state);
+
+// calculateFrameTraceFingerprint() builds the fingerprint of a recorded
+// frame as HWCDisplay::updateValiFingerprint() does, so it is the same as
+// vali_fingerprint if the trace has all the states
+uint64_t calculateFrameTraceFingerprint(
+    const FrameTraceFrame& frame, const FrameTraceLayer* layers);
+
+// FrameTraceWriter writes a trace file of up to max_frames frames.
+// It is not thread-safe; frames are written by the thread of presentDisplay.
+class FrameTraceWriter
+{
+public:
+    FrameTraceWriter();
+    ~FrameTraceWriter();
+
+    // open() creates the file; return false on error
+    bool open(const char* path, const uint32_t& max_frames);
+
+    void close();
+
+    bool isOpen() const { return m_file != NULL; }
+
+    // isFull() is true when max_frames frames are written
+    bool isFull() const { return m_frame_num >= m_max_frames; }
+
+    // write() writes one frame with frame.layer_num layers
+    bool write(const FrameTraceFrame& frame, const FrameTraceLayer* layers);
+
+    uint32_t getFrameNum() const { return m_frame_num; }
+
+private:
+    FrameTraceWriter(const FrameTraceWriter&);
+    FrameTraceWriter& operator=(const FrameTraceWriter&);
+
+    FILE* m_file;
+    uint32_t m_max_frames;
+    uint32_t m_frame_num;
+};
+
+// FrameTraceReader reads the frames of a trace file in order
+class FrameTraceReader
+{
+public:
+    FrameTraceReader();
+    ~FrameTraceReader();
+
+    // open() checks the header; return false if it is not a trace of this version
+    bool open(const char* path);
+
+    void close();
+
+    // read() reads the next frame; return false at the end of the file or
+    // on a truncated frame
+    bool read(FrameTraceFrame* frame, std::vector<FrameTraceLayer>* layers);
+
+private:
+    FrameTraceReader(const FrameTraceReader&);
+    FrameTraceReader& operator=(const FrameTraceReader&);
+
+    FILE* m_file;
+};
+
+#endif // HWC_FRAME_TRACE_H_
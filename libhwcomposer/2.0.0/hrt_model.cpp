@@ -0,0 +1,239 @@
+#include <string.h>
+
+#include "hrt_model.h"
+
+// ---------------------------------------------------------------------------
+
+HrtModel::HrtModel(const int32_t& max_ovl_layers, const int32_t& hrt_limit)
+    : m_max_ovl_layers(max_ovl_layers)
+    , m_hrt_limit(hrt_limit)
+    , m_query_count(0)
+{
+}
+
+static bool isLayerOverlapped(const layer_config& layer, const int32_t& x, const int32_t& y)
+{
+    return x >= layer.dst_offset_x &&
+           x < layer.dst_offset_x + static_cast<int32_t>(layer.dst_width) &&
+           y >= layer.dst_offset_y &&
+           y < layer.dst_offset_y + static_cast<int32_t>(layer.dst_height);
+}
+
+int32_t HrtModel::calculateOverlap(
+    const layer_config* configs, const int32_t& num,
+    const int32_t& gles_head, const int32_t& gles_tail) const
+{
+    // the max overlap is always at the top-left corner of a layer
+    int32_t max_overlap = 0;
+    for (int32_t i = 0; i < num; ++i)
+    {
+        for (int32_t j = 0; j < num; ++j)
+        {
+            const int32_t x = configs[i].dst_offset_x;
+            const int32_t y = configs[j].dst_offset_y;
+            int32_t overlap = 0;
+            bool has_gles = false;
+            for (int32_t k = 0; k < num; ++k)
+            {
+                if (!isLayerOverlapped(configs[k], x, y))
+                    continue;
+
+                if (gles_head != -1 && k >= gles_head && k <= gles_tail)
+                    has_gles = true;
+                else if (configs[k].src_fmt != DISP_FORMAT_DIM)
+                    ++overlap;
+            }
+            if (has_gles)
+                ++overlap;
+
+            if (overlap > max_overlap)
+                max_overlap = overlap;
+        }
+    }
+    return max_overlap;
+}
+
+bool HrtModel::arbitrate(
+    layer_config* configs, const int32_t& num,
+    int32_t* gles_head, int32_t* gles_tail, int32_t* overlap) const
+{
+    while (true)
+    {
+        const int32_t gles_num = (*gles_head == -1) ? 0 : *gles_tail - *gles_head + 1;
+        const int32_t committed_num = num - gles_num + (gles_num ? 1 : 0);
+
+        *overlap = calculateOverlap(configs, num, *gles_head, *gles_tail);
+        if (committed_num <= m_max_ovl_layers && *overlap <= m_hrt_limit)
+            break;
+
+        // extend the gles range, top layers first
+        if (*gles_head == -1)
+        {
+            *gles_head = num - 1;
+            *gles_tail = num - 1;
+        }
+        else if (*gles_tail < num - 1)
+        {
+            ++*gles_tail;
+        }
+        else if (*gles_head > 0)
+        {
+            --*gles_head;
+        }
+        else
+        {
+            // all layers are composed by gles, and it still can not fit
+            return false;
+        }
+    }
+
+    int32_t ovl_id = 0;
+    for (int32_t i = 0; i < num; ++i)
+    {
+        const bool is_gles = *gles_head != -1 && i >= *gles_head && i <= *gles_tail;
+        configs[i].ovl_id = ovl_id;
+        configs[i].ext_sel_layer = -1;
+        if (!is_gles || i == *gles_tail)
+            ++ovl_id;
+    }
+    return true;
+}
+
+bool HrtModel::queryValidLayer(disp_layer_info* disp_layer)
+{
+    ++m_query_count;
+
+    int32_t hrt_num = 0;
+    for (int32_t i = 0; i < HRT_DISP_INPUT_NUM; ++i)
+    {
+        if (disp_layer->layer_num[i] <= 0 || disp_layer->input_config[i] == NULL)
+            continue;
+
+        int32_t overlap = 0;
+        if (!arbitrate(disp_layer->input_config[i], disp_layer->layer_num[i],
+                       &disp_layer->gles_head[i], &disp_layer->gles_tail[i], &overlap))
+        {
+            disp_layer->hrt_num = -1;
+            return false;
+        }
+
+        if (overlap > hrt_num)
+            hrt_num = overlap;
+    }
+
+    disp_layer->hrt_num = hrt_num;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+
+HrtQueryCache::HrtQueryCache()
+    : m_valid(false)
+    , m_hit_count(0)
+    , m_miss_count(0)
+{
+    memset(&m_result, 0, sizeof(m_result));
+}
+
+bool HrtQueryCache::isConfigEqual(const layer_config& lhs, const layer_config& rhs)
+{
+    // ovl_id and ext_sel_layer are the output of the query
+    return lhs.src_fmt == rhs.src_fmt &&
+           lhs.dst_offset_x == rhs.dst_offset_x &&
+           lhs.dst_offset_y == rhs.dst_offset_y &&
+           lhs.dst_width == rhs.dst_width &&
+           lhs.dst_height == rhs.dst_height &&
+           lhs.src_width == rhs.src_width &&
+           lhs.src_height == rhs.src_height &&
+           lhs.layer_caps == rhs.layer_caps;
+}
+
+bool HrtQueryCache::isInputEqual(const Input& lhs, const disp_layer_info& rhs, const int32_t& disp_input)
+{
+    if (lhs.disp_mode != rhs.disp_mode[disp_input] ||
+        lhs.layer_num != rhs.layer_num[disp_input] ||
+        lhs.gles_head != rhs.gles_head[disp_input] ||
+        lhs.gles_tail != rhs.gles_tail[disp_input])
+    {
+        return false;
+    }
+
+    for (int32_t i = 0; i < lhs.layer_num; ++i)
+    {
+        if (!isConfigEqual(lhs.configs[i], rhs.input_config[disp_input][i]))
+            return false;
+    }
+    return true;
+}
+
+void HrtQueryCache::copyInput(Input* dst, const disp_layer_info& src, const int32_t& disp_input)
+{
+    dst->disp_mode = src.disp_mode[disp_input];
+    dst->layer_num = src.input_config[disp_input] != NULL ? src.layer_num[disp_input] : 0;
+    dst->gles_head = src.gles_head[disp_input];
+    dst->gles_tail = src.gles_tail[disp_input];
+    if (dst->layer_num > 0)
+        dst->configs.assign(src.input_config[disp_input], src.input_config[disp_input] + dst->layer_num);
+    else
+        dst->configs.clear();
+}
+
+bool HrtQueryCache::lookup(disp_layer_info* disp_layer)
+{
+    bool is_hit = m_valid;
+    for (int32_t i = 0; i < HRT_DISP_INPUT_NUM && is_hit; ++i)
+    {
+        const int32_t layer_num = disp_layer->input_config[i] != NULL ? disp_layer->layer_num[i] : 0;
+        if (layer_num != m_input[i].layer_num)
+            is_hit = false;
+        else if (layer_num > 0 && !isInputEqual(m_input[i], *disp_layer, i))
+            is_hit = false;
+    }
+
+    if (!is_hit)
+    {
+        for (int32_t i = 0; i < HRT_DISP_INPUT_NUM; ++i)
+            copyInput(&m_pending_input[i], *disp_layer, i);
+        ++m_miss_count;
+        return false;
+    }
+
+    // the configs are the same as the last query, fill its result
+    disp_layer->hrt_num = m_result.hrt_num;
+    for (int32_t i = 0; i < HRT_DISP_INPUT_NUM; ++i)
+    {
+        disp_layer->gles_head[i] = m_result.gles_head[i];
+        disp_layer->gles_tail[i] = m_result.gles_tail[i];
+        if (m_input[i].layer_num > 0)
+        {
+            memcpy(disp_layer->input_config[i], &m_result_configs[i][0],
+                sizeof(layer_config) * m_input[i].layer_num);
+        }
+    }
+    ++m_hit_count;
+    return true;
+}
+
+void HrtQueryCache::update(const disp_layer_info& result, const bool& is_valid)
+{
+    if (!is_valid)
+    {
+        m_valid = false;
+        return;
+    }
+
+    m_result = result;
+    for (int32_t i = 0; i < HRT_DISP_INPUT_NUM; ++i)
+    {
+        m_input[i] = m_pending_input[i];
+        if (m_input[i].layer_num > 0)
+        {
+            m_result_configs[i].assign(result.input_config[i], result.input_config[i] + m_input[i].layer_num);
+        }
+        else
+        {
+            m_result_configs[i].clear();
+        }
+    }
+    m_valid = true;
+}
@@ -0,0 +1,107 @@
+#ifndef HWC_HRT_MODEL_H_
+#define HWC_HRT_MODEL_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include <linux/disp_session.h>
+
+// driver only supports two displays at the same time
+// disp_input 0: primary display; disp_input 1: secondry display(MHL or vds)
+#define HRT_DISP_INPUT_NUM 2
+
+// default limitation of HrtModel: 4 ovl input layers and 4 overlapped layers
+#define HRT_MODEL_MAX_OVL_LAYERS 4
+#define HRT_MODEL_HRT_LIMIT 4
+
+// ---------------------------------------------------------------------------
+
+// HrtArbiter decides which layers the display hardware can compose within
+// the HRT (hard real time) bandwidth. It has the same input and output as
+// DISP_IOCTL_QUERY_VALID_LAYER.
+class HrtArbiter
+{
+public:
+    virtual ~HrtArbiter() {}
+
+    // return false if the arbitration fails, and hrt_num is -1 then
+    virtual bool queryValidLayer(disp_layer_info* disp_layer) = 0;
+};
+
+// HrtModel is a deterministic software model of the arbitration of the
+// display driver, for bring-up without the driver and for the tests.
+// A layer costs one unit of bandwidth where it overlaps the others, except
+// dim layers which fetch no memory. GLES layers are composed into one client
+// target whose bandwidth is counted once. The GLES range grows until the
+// overlap is within hrt_limit and the layers fit in max_ovl_layers.
+class HrtModel : public HrtArbiter
+{
+public:
+    HrtModel(const int32_t& max_ovl_layers, const int32_t& hrt_limit);
+
+    bool queryValidLayer(disp_layer_info* disp_layer);
+
+    uint32_t getQueryCount() const { return m_query_count; }
+
+private:
+    int32_t calculateOverlap(
+        const layer_config* configs, const int32_t& num,
+        const int32_t& gles_head, const int32_t& gles_tail) const;
+
+    bool arbitrate(
+        layer_config* configs, const int32_t& num,
+        int32_t* gles_head, int32_t* gles_tail, int32_t* overlap) const;
+
+    const int32_t m_max_ovl_layers;
+    const int32_t m_hrt_limit;
+    uint32_t m_query_count;
+};
+
+// HrtQueryCache keeps the layer configs and the result of the last query.
+// A frame which only changes the buffers of its layers has the same layer
+// configs as the frame before, then its result is reused instead of querying
+// the driver again.
+class HrtQueryCache
+{
+public:
+    HrtQueryCache();
+
+    // return true and fill the result into disp_layer if the layer configs
+    // are the same as the last query, or keep them for update() if not
+    bool lookup(disp_layer_info* disp_layer);
+
+    // remember the result of the query of the last missed lookup()
+    void update(const disp_layer_info& result, const bool& is_valid);
+
+    void invalidate() { m_valid = false; }
+
+    uint32_t getHitCount() const { return m_hit_count; }
+    uint32_t getMissCount() const { return m_miss_count; }
+
+private:
+    struct Input
+    {
+        int32_t disp_mode;
+        int32_t layer_num;
+        int32_t gles_head;
+        int32_t gles_tail;
+        std::vector<layer_config> configs;
+    };
+
+    static bool isConfigEqual(const layer_config& lhs, const layer_config& rhs);
+
+    static bool isInputEqual(const Input& lhs, const disp_layer_info& rhs, const int32_t& disp_input);
+
+    static void copyInput(Input* dst, const disp_layer_info& src, const int32_t& disp_input);
+
+    bool m_valid;
+    Input m_input[HRT_DISP_INPUT_NUM];
+    Input m_pending_input[HRT_DISP_INPUT_NUM];
+    disp_layer_info m_result;
+    std::vector<layer_config> m_result_configs[HRT_DISP_INPUT_NUM];
+
+    uint32_t m_hit_count;
+    uint32_t m_miss_count;
+};
+
+#endif // HWC_HRT_MODEL_H_
@@ -229,6 +229,7 @@ HWCLayer::HWCLayer(const wp<HWCDisplay>& disp, const uint64_t& disp_id, const bo
     , m_sf_comp_type_call_from_sf(0)
     , m_last_comp_type_call_from_sf(0)
     , m_layer_caps(0)
+    , m_sw_compose(false)
 {
     memset(&m_damage, 0, sizeof(m_damage));
     memset(&m_display_frame, 0, sizeof(m_display_frame));
@@ -249,6 +250,9 @@ HWCLayer::~HWCLayer()
         free((void*)m_visible_region.rects);
 }
 
+// the frame trace is replayed by test/frame_replay.cpp
+#define FRAME_TRACE_PATH "/data/hwc_frame.trace"
+
 #define SET_LINE_NUM(RTLINE, TYPE) ({ \
                             *RTLINE = __LINE__; \
                             TYPE; \
@@ -325,6 +329,8 @@ void HWCLayer::validate()
     const int& compose_level = Platform::getInstance().m_config.compose_level;
     int32_t line = -1;
 
+    setSwCompose(false);
+
     if (getSFCompositionType() == HWC2_COMPOSITION_CLIENT)
     {
         setHwlayerType(HWC_LAYER_TYPE_INVALID, __LINE__);
@@ -435,6 +441,16 @@ void HWCLayer::validate()
         return;
     }
 
+    // MDP cannot take it, compose it by the CPU in the bliter thread
+    // rather than sending the whole range to GLES
+    int32_t sw_line = -1;
+    if (Platform::getInstance().isSWLayerValid(this, &sw_line))
+    {
+        setSwCompose(true);
+        setHwlayerType(HWC_LAYER_TYPE_MM, __LINE__);
+        return;
+    }
+
     setHwlayerType(HWC_LAYER_TYPE_INVALID, line == -1 ? line : line + 10000);
 }
 
@@ -624,6 +640,40 @@ void HWCLayer::setVisibleRegion(const hwc_region_t& visible_region)
     }
 }
 
+void HWCLayer::getValiState(ValiLayerState* state) const
+{
+    const PrivateHandle& priv_hnd = getPrivateHandle();
+
+    memset(state, 0, sizeof(*state));
+    state->id = m_id;
+    state->sf_comp_type = m_last_comp_type_call_from_sf;
+    state->display_frame = m_display_frame;
+    state->source_crop = m_source_crop;
+    state->blend = m_blend;
+    state->dataspace = m_dataspace;
+    state->plane_alpha = m_plane_alpha;
+    state->transform = m_transform;
+    state->has_handle = m_hwc_buf != nullptr && m_hwc_buf->getHandle() != nullptr;
+    if (state->has_handle)
+    {
+        state->format = priv_hnd.format;
+        state->width = priv_hnd.width;
+        state->height = priv_hnd.height;
+        state->usage = priv_hnd.usage;
+        state->prexform = priv_hnd.prexform;
+        state->ext_status = priv_hnd.ext_info.status;
+        state->ext_status2 = priv_hnd.ext_info.status2;
+        state->secure = priv_hnd.sec_handle != 0;
+    }
+}
+
+void HWCLayer::addValiFingerprint(ValiFingerprint* fingerprint) const
+{
+    ValiLayerState state;
+    getValiState(&state);
+    addValiLayerState(fingerprint, state);
+}
+
 // -----------------------------------------------------------------------------
 
 void findGlesRange(const vector<sp<HWCLayer> >& layers, int32_t* head, int32_t* tail)
@@ -691,6 +741,8 @@ HWCDisplay::HWCDisplay(const int64_t& disp_id, const int32_t& type)
     , m_vali_present_state(HWC_VALI_PRESENT_STATE_PRESENT_DONE)
     , m_is_visible_layer_changed(false)
     , m_present_vali_state_log(DbgLogger::TYPE_HWC_LOG, 'D', g_present_vali_state_log_prefix)
+    , m_vali_fingerprint(0)
+    , m_dirty_tracker(MAX_DIRTY_RECT_CNT)
 {
     switch (disp_id)
     {
@@ -990,6 +1042,7 @@ inline static void fillHwLayer(
         dpy, priv_handle, ovl_idx, layer->isBufferChanged() || layer->isStateChanged(),
         layer->getHwlayerType(), layer->getId(), layer->getLayerCaps());
     hw_layer->hwc2_layer_id = layer->getId();
+    hw_layer->sw_compose = layer->isSwCompose();
 
     if (HWCMediator::getInstance().m_features.global_pq)
     {
@@ -1112,6 +1165,176 @@ inline void setupHwcLayers(const sp<HWCDisplay>& display, DispatcherJob* job)
     HWC_LOGV("(%" PRIu64 ") - setupHwcLayers", display->getId());
 }
 
+void HWCDisplay::getValiState(ValiDisplayState* state)
+{
+    const int32_t disp_id = static_cast<int32_t>(getId());
+
+    memset(state, 0, sizeof(*state));
+    state->mirror_src = getMirrorSrc();
+    state->force_gpu = isForceGpuCompose();
+    state->compose_level = Platform::getInstance().m_config.compose_level;
+    state->mdp_scale_percentage = Platform::getInstance().m_config.mdp_scale_percentage;
+    state->sw_compose = Platform::getInstance().m_config.sw_compose;
+    state->video_hdcp = DisplayManager::getInstance().getVideoHdcp();
+    state->hdcp_version = DisplayManager::getInstance().m_data[disp_id].hdcp_version;
+    state->secure = getSecure() != 0;
+    state->prexform_ui = Platform::getInstance().m_config.prexformUI;
+    state->rgba_rotate = Platform::getInstance().m_config.enable_rgba_rotate;
+    state->rgbx_scaling = Platform::getInstance().m_config.enable_rgbx_scaling;
+    state->global_pq = HWCMediator::getInstance().m_features.global_pq;
+    state->uipq_debug = Platform::getInstance().m_config.uipq_debug;
+    state->disp_decompress = Platform::getInstance().m_config.disp_support_decompress;
+    state->mdp_decompress = Platform::getInstance().m_config.mdp_support_decompress;
+}
+
+void HWCDisplay::updateValiFingerprint()
+{
+    ValiFingerprint fingerprint;
+    ValiDisplayState state;
+    auto&& layers = getVisibleLayersSortedByZ();
+
+    getValiState(&state);
+    addValiDisplayState(&fingerprint, state, layers.size());
+    for (auto& layer : layers)
+        layer->addValiFingerprint(&fingerprint);
+
+    m_vali_fingerprint = fingerprint.get();
+}
+
+void HWCDisplay::getValiPlan(ValiPlan* plan)
+{
+    auto&& layers = getVisibleLayersSortedByZ();
+
+    plan->fingerprint = m_vali_fingerprint;
+    getGlesRange(&plan->gles_head, &plan->gles_tail);
+    plan->layers.resize(layers.size());
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+        plan->layers[i].hwlayer_type = layers[i]->getHwlayerType();
+        plan->layers[i].hwlayer_type_line = layers[i]->getHwlayerTypeLine();
+        plan->layers[i].layer_caps = layers[i]->getLayerCaps();
+        plan->layers[i].mdp_dst_roi = layers[i]->getMdpDstRoi();
+        plan->layers[i].sw_compose = layers[i]->isSwCompose();
+    }
+    plan->valid = true;
+}
+
+void HWCDisplay::getFrameTrace(FrameTraceFrame* frame, std::vector<FrameTraceLayer>* trace_layers)
+{
+    auto&& layers = getVisibleLayersSortedByZ();
+
+    ValiDisplayState disp_state;
+    getValiState(&disp_state);
+    setFrameTraceValiState(frame, disp_state);
+    frame->vali_fingerprint = getValiFingerprint();
+    frame->disp_id = static_cast<uint32_t>(getId());
+    frame->layer_num = layers.size();
+    frame->disp_width = getWidth();
+    frame->disp_height = getHeight();
+    getGlesRange(&frame->gles_head, &frame->gles_tail);
+
+    trace_layers->resize(layers.size());
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+        const sp<HWCLayer>& layer = layers[i];
+        FrameTraceLayer* trace = &(*trace_layers)[i];
+        memset(trace, 0, sizeof(*trace));
+
+        ValiLayerState layer_state;
+        layer->getValiState(&layer_state);
+        setFrameTraceValiState(trace, layer_state);
+        trace->comp_type = layer->getCompositionType();
+        trace->hwlayer_type = layer->getHwlayerType();
+        trace->layer_caps = layer->getLayerCaps();
+        if (layer_state.has_handle && (layer_state.usage & GRALLOC_USAGE_SECURE))
+            trace->flags |= FRAME_TRACE_LAYER_SECURE;
+
+        const hwc_region_t& damage = layer->getDamage();
+        trace->damage_num = damage.numRects;
+        for (size_t j = 0; j < damage.numRects; ++j)
+        {
+            const hwc_rect_t& rect = damage.rects[j];
+            if (j == 0 || rect.left < trace->damage_bounds[0]) trace->damage_bounds[0] = rect.left;
+            if (j == 0 || rect.top < trace->damage_bounds[1]) trace->damage_bounds[1] = rect.top;
+            if (j == 0 || rect.right > trace->damage_bounds[2]) trace->damage_bounds[2] = rect.right;
+            if (j == 0 || rect.bottom > trace->damage_bounds[3]) trace->damage_bounds[3] = rect.bottom;
+        }
+
+        if (layer->isBufferChanged())
+            trace->flags |= FRAME_TRACE_LAYER_BUFFER_CHANGED;
+        if (layer->isStateChanged())
+            trace->flags |= FRAME_TRACE_LAYER_STATE_CHANGED;
+        if (layer->getHwlayerType() == HWC_LAYER_TYPE_MM ||
+            layer->getHwlayerType() == HWC_LAYER_TYPE_MM_HIGH ||
+            layer->getHwlayerType() == HWC_LAYER_TYPE_UIPQ)
+            trace->flags |= FRAME_TRACE_LAYER_MDP;
+        if (layer->isSwCompose())
+            trace->flags |= FRAME_TRACE_LAYER_SW_COMPOSE;
+    }
+}
+
+void HWCDisplay::saveValiPlan()
+{
+    getValiPlan(&m_vali_plan);
+}
+
+void HWCDisplay::restoreValiPlan()
+{
+    auto&& layers = getVisibleLayersSortedByZ();
+    if (!isValiPlanReusable() || layers.size() != m_vali_plan.layers.size())
+    {
+        HWC_LOGE("(%" PRIu64 ") %s: the plan does not match (%zu/%zu)",
+            getId(), __func__, layers.size(), m_vali_plan.layers.size());
+        return;
+    }
+
+    setValiPresentState(HWC_VALI_PRESENT_STATE_VALIDATE, __LINE__);
+    m_is_validated = true;
+
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+        const ValiPlanLayer& plan_layer = m_vali_plan.layers[i];
+        layers[i]->setHwlayerType(plan_layer.hwlayer_type, plan_layer.hwlayer_type_line);
+        layers[i]->setLayerCaps(plan_layer.layer_caps);
+        layers[i]->editMdpDstRoi() = plan_layer.mdp_dst_roi;
+        layers[i]->setSwCompose(plan_layer.sw_compose);
+    }
+    setGlesRange(m_vali_plan.gles_head, m_vali_plan.gles_tail);
+}
+
+bool HWCDisplay::updateDirtyRegions()
+{
+    const auto& committed_layers = getCommittedLayers();
+
+    std::vector<DirtyLayer> dirty_layers(committed_layers.size());
+    for (size_t i = 0; i < committed_layers.size(); ++i)
+    {
+        const sp<HWCLayer>& layer = committed_layers[i];
+        DirtyLayer& dirty_layer = dirty_layers[i];
+        dirty_layer.id = layer->getId();
+        dirty_layer.display_frame = layer->getDisplayFrame();
+        dirty_layer.source_crop = layer->getSourceCrop();
+        dirty_layer.transform = layer->getTransform();
+        dirty_layer.blend = layer->getBlend();
+        dirty_layer.plane_alpha = layer->getPlaneAlpha();
+
+        const PrivateHandle& priv_handle = layer->getPrivateHandle();
+        dirty_layer.buffer_bounds.right = static_cast<int>(priv_handle.width);
+        dirty_layer.buffer_bounds.bottom = static_cast<int>(priv_handle.height);
+
+        // the damage of a pre-transformed buffer is not in buffer coordinates
+        const hwc_region_t& damage = layer->getDamage();
+        dirty_layer.damage_known = layer->getHandle() != nullptr &&
+            damage.numRects != 0 && damage.rects != nullptr &&
+            layer->getXform() == static_cast<uint32_t>(layer->getTransform());
+        dirty_layer.damage_num = damage.numRects;
+        dirty_layer.damage = damage.rects;
+        dirty_layer.dirty = &layer->editDirtyRegion();
+    }
+
+    return m_dirty_tracker.update(dirty_layers);
+}
+
 void HWCDisplay::setGlesRange(const int32_t& gles_head, const int32_t& gles_tail)
 {
     m_gles_head = gles_head;
@@ -1399,8 +1622,21 @@ void HWCDisplay::beforePresent(const int32_t num_validate_display)
                                                   + (job->fbt_exist ? 1 : 0);
         }
 
-        job->is_full_invalidate =
-            HWCMediator::getInstance().getOvlDevice(getId())->isPartialUpdateSupported() ? isGeometryChanged() : true;
+        if (!HWCMediator::getInstance().getOvlDevice(getId())->isPartialUpdateSupported() ||
+            Platform::getInstance().m_config.force_full_invalidate)
+        {
+            job->is_full_invalidate = true;
+            invalidateDirtyRegions();
+        }
+        else if (Platform::getInstance().m_config.dirty_region)
+        {
+            job->is_full_invalidate = !updateDirtyRegions();
+        }
+        else
+        {
+            job->is_full_invalidate = isGeometryChanged();
+            invalidateDirtyRegions();
+        }
 
         if (needDoAvGrouping(num_validate_display))
             job->need_av_grouping = true;
@@ -1550,6 +1786,8 @@ void HWCDisplay::clear()
     m_ct = nullptr;
     m_prev_comp_types.clear();
     m_pending_removed_layers_id.clear();
+    m_vali_plan.invalidate();
+    m_dirty_tracker.invalidate();
 }
 
 bool HWCDisplay::isConnected() const
@@ -1782,6 +2020,8 @@ void HWCDisplay::setPowerMode(const int32_t& mode)
     // screen blanking based on early_suspend in the kernel
     HWC_LOGI("Display(%" PRId64 ") SetPowerMode(%d)", m_disp_id, mode);
     m_power_mode = mode;
+    invalidateValiPlan();
+    invalidateDirtyRegions();
     DisplayManager::getInstance().setDisplayPowerState(m_disp_id, mode);
 
     HWCDispatcher::getInstance().setPowerMode(m_disp_id, mode);
@@ -2132,19 +2372,6 @@ void HWCDisplay::setupPrivateHandleOfLayers()
     ATRACE_CALL();
     auto layers = getVisibleLayersSortedByZ();
 
-    if (layers.size() > 0)
-    {
-        // RGBA layer_0, alpha value don't care.
-        auto& layer = layers[0];
-        if (layer != nullptr &&
-            layer->getHwcBuffer() != nullptr &&
-            layer->getHwcBuffer()->getHandle() != nullptr &&
-            layer->getPrivateHandle().format == HAL_PIXEL_FORMAT_RGBA_8888)
-        {
-            layer->getEditablePrivateHandle().format = HAL_PIXEL_FORMAT_RGBX_8888;
-        }
-    }
-
     for (auto& layer : layers)
     {
 #ifndef MTK_USER_BUILD
@@ -2168,6 +2395,22 @@ void HWCDisplay::setupPrivateHandleOfLayers()
             layer->getEditablePrivateHandle().format = HAL_PIXEL_FORMAT_RGBX_8888;
         }
     }
+
+    // RGBA layer_0, alpha value don't care.
+    // It is done after the private handles are set up, so the format is the
+    // same whether the handle of layer_0 was set up again or not, and a
+    // buffer update of layer_0 does not change the validate fingerprint.
+    if (layers.size() > 0)
+    {
+        auto& layer = layers[0];
+        if (layer != nullptr &&
+            layer->getHwcBuffer() != nullptr &&
+            layer->getHwcBuffer()->getHandle() != nullptr &&
+            layer->getPrivateHandle().format == HAL_PIXEL_FORMAT_RGBA_8888)
+        {
+            layer->getEditablePrivateHandle().format = HAL_PIXEL_FORMAT_RGBX_8888;
+        }
+    }
 }
 
 void HWCDisplay::setValiPresentState(HWC_VALI_PRESENT_STATE val, const int32_t& line)
@@ -2256,6 +2499,8 @@ HWCMediator::HWCMediator()
     , m_set_buf_from_sf_log(DbgLogger::TYPE_HWC_LOG, 'D', g_set_buf_from_sf_log_prefix)
     , m_set_comp_from_sf_log(DbgLogger::TYPE_HWC_LOG, 'D', g_set_comp_from_sf_log_prefix)
     , m_driver_refresh_count(0)
+    , m_vali_cache_hit(0)
+    , m_vali_cache_miss(0)
     , m_is_init_disp_manager(false)
     , m_callback_hotplug(nullptr)
     , m_callback_hotplug_data(nullptr)
@@ -2264,6 +2509,9 @@ HWCMediator::HWCMediator()
     , m_callback_refresh(nullptr)
     , m_callback_refresh_data(nullptr)
 {
+    memset(m_trace_validate_ns, 0, sizeof(m_trace_validate_ns));
+    memset(m_trace_flags, 0, sizeof(m_trace_flags));
+
     sp<IOverlayDevice> primary_disp_dev = &DispDevice::getInstance();
     sp<IOverlayDevice> virtual_disp_dev = nullptr;
     if (Platform::getInstance().m_config.blitdev_for_virtual)
@@ -2448,6 +2696,7 @@ void HWCMediator::deviceDump(hwc2_device_t* /*device*/, uint32_t* outSize, char*
                 continue;
             display->dump(&dump_str);
         }
+        DisplayManager::getInstance().dumpVSync(&dump_str);
         char value[PROPERTY_VALUE_MAX];
 
         // force full invalidate
@@ -2646,6 +2895,54 @@ void HWCMediator::deviceDump(hwc2_device_t* /*device*/, uint32_t* outSize, char*
             }
         }
 
+        property_get("debug.hwc.vali_cache", value, "-1");
+        if (-1 != atoi(value))
+        {
+            Platform::getInstance().m_config.vali_cache = atoi(value);
+        }
+
+        property_get("debug.hwc.hrt_cache", value, "-1");
+        if (-1 != atoi(value))
+        {
+            Platform::getInstance().m_config.hrt_cache = atoi(value);
+        }
+
+        property_get("debug.hwc.hrt_model", value, "-1");
+        if (-1 != atoi(value))
+        {
+            Platform::getInstance().m_config.hrt_model = atoi(value);
+        }
+
+        property_get("debug.hwc.dirty_region", value, "-1");
+        if (-1 != atoi(value))
+        {
+            Platform::getInstance().m_config.dirty_region = atoi(value);
+        }
+
+        property_get("debug.hwc.sw_compose", value, "-1");
+        if (-1 != atoi(value))
+        {
+            Platform::getInstance().m_config.sw_compose = atoi(value);
+        }
+
+        property_get("debug.hwc.sw_compose_threads", value, "-1");
+        if (0 < atoi(value))
+        {
+            Platform::getInstance().m_config.sw_compose_threads = atoi(value);
+        }
+
+        property_get("debug.hwc.ovl_config_diff", value, "-1");
+        if (-1 != atoi(value))
+        {
+            Platform::getInstance().m_config.ovl_config_diff = atoi(value);
+        }
+
+        property_get("debug.hwc.frame_trace", value, "-1");
+        if (-1 != atoi(value))
+        {
+            Platform::getInstance().m_config.frame_trace = atoi(value);
+        }
+
         property_get("debug.hwc.color_transform", value, "-1");
         if (-1 != atoi(value))
         {
@@ -2731,6 +3028,13 @@ void HWCMediator::deviceDump(hwc2_device_t* /*device*/, uint32_t* outSize, char*
         dump_str.appendFormat("\n[HWC Property]\n");
 #ifndef MTK_USER_BUILD
         dump_str.appendFormat("  force_full_invalidate(debug.hwc.forceFullInvalidate):%d\n", Platform::getInstance().m_config.force_full_invalidate);
+        dump_str.appendFormat("  dirty_region(debug.hwc.dirty_region):%d\n", Platform::getInstance().m_config.dirty_region);
+        dump_str.appendFormat("  sw_compose(debug.hwc.sw_compose):%d threads(debug.hwc.sw_compose_threads):%d\n",
+            Platform::getInstance().m_config.sw_compose, Platform::getInstance().m_config.sw_compose_threads);
+        dump_str.appendFormat("  ovl_config_diff(debug.hwc.ovl_config_diff):%d\n", Platform::getInstance().m_config.ovl_config_diff);
+        dump_str.appendFormat("  frame_trace(debug.hwc.frame_trace):%u written:%u (%s)\n",
+            Platform::getInstance().m_config.frame_trace, m_frame_trace.getFrameNum(), FRAME_TRACE_PATH);
+        DispDevice::getInstance().dumpConfigDiff(&dump_str);
         dump_str.appendFormat("  wait_fence_for_display(debug.hwc.waitFenceForDisplay):%d\n", Platform::getInstance().m_config.wait_fence_for_display);
         dump_str.appendFormat("  rgba_rotate(debug.hwc.rgba_rotate):%d\n", Platform::getInstance().m_config.enable_rgba_rotate);
         dump_str.appendFormat("  rgba_rotate(debug.hwc.rgbx_scaling):%d\n", Platform::getInstance().m_config.enable_rgbx_scaling);
@@ -2764,6 +3068,8 @@ void HWCMediator::deviceDump(hwc2_device_t* /*device*/, uint32_t* outSize, char*
         dump_str.appendFormat("  blitdev_for_virtual(debug.hwc.blitdev_for_virtual):%d\n", Platform::getInstance().m_config.blitdev_for_virtual);
 
         dump_str.appendFormat("  is_skip_validate(debug.hwc.is_skip_validate):%d\n", Platform::getInstance().m_config.is_skip_validate);
+        dump_str.appendFormat("  vali_cache(debug.hwc.vali_cache):%d hit:%u miss:%u\n",
+            Platform::getInstance().m_config.vali_cache, m_vali_cache_hit, m_vali_cache_miss);
         dump_str.appendFormat("  support_color_transform(debug.hwc.color_transform):%d\n", Platform::getInstance().m_config.support_color_transform);
         dump_str.appendFormat("  mdp_scaling_percentage(debug.hwc.mdp_scale_percentage):%.2f\n", Platform::getInstance().m_config.mdp_scale_percentage);
         dump_str.appendFormat("  ExtendMDP(debug.hwc.extend_mdp_cap):%d\n", Platform::getInstance().m_config.extend_mdp_capacity);
@@ -3222,6 +3528,7 @@ int32_t /*hwc2_error_t*/ HWCMediator::displayPresent(
     hwc2_display_t display,
     int32_t* out_retire_fence)
 {
+    const nsecs_t present_start = systemTime();
     HWC_LOGV("(%" PRIu64 ") %s", display, __func__);
     m_displays[display]->editPresentValiStateLog().printf("%s s:%s=>", __func__, getPresentValiStateString(m_displays[display]->getValiPresentState()));
     if (!DisplayManager::getInstance().m_data[display].connected)
@@ -3254,7 +3561,14 @@ int32_t /*hwc2_error_t*/ HWCMediator::displayPresent(
             setNeedValidate(HWC_SKIP_VALIDATE_NOT_SKIP);
             setValiPresentStateOfAllDisplay(HWC_VALI_PRESENT_STATE_CHECK_SKIP_VALI, __LINE__);
             if (checkSkipValidate() == true)
+            {
+                for (auto& hwc_display : m_displays)
+                {
+                    if (hwc_display->isValid())
+                        hwc_display->restoreValiPlan();
+                }
                 setNeedValidate(HWC_SKIP_VALIDATE_SKIP);
+            }
             else
                 setNeedValidate(HWC_SKIP_VALIDATE_NOT_SKIP);
         }
@@ -3268,6 +3582,8 @@ int32_t /*hwc2_error_t*/ HWCMediator::displayPresent(
             m_hrt.run(m_displays, true);
             updateGlesRangeForAllDisplays();
             setValiPresentStateOfAllDisplay(HWC_VALI_PRESENT_STATE_VALIDATE_DONE, __LINE__);
+            m_trace_flags[display] = FRAME_TRACE_SKIP_VALIDATE;
+            m_trace_validate_ns[display] = 0;
         }
     }
 
@@ -3331,6 +3647,8 @@ int32_t /*hwc2_error_t*/ HWCMediator::displayPresent(
     }
     HWC_LOGV("(%" PRIu64 ") %s out_retire_fence:%d", display, __func__, *out_retire_fence);
 
+    recordFrameTrace(display, systemTime() - present_start);
+
     m_validate_seq = 0;
     ++m_present_seq;
     m_displays[display]->editPresentValiStateLog().flushOut();
@@ -3667,6 +3985,9 @@ void Hrt::fillDispLayer(const vector<sp<HWCDisplay> >& displays)
         display->getGlesRange(
             &m_disp_layer.gles_head[disp_input],
             &m_disp_layer.gles_tail[disp_input]);
+        m_query_gles_head[disp_id] = m_disp_layer.gles_head[disp_input];
+        m_query_gles_tail[disp_id] = m_disp_layer.gles_tail[disp_input];
+        m_query_layer_num[disp_id] = m_disp_layer.layer_num[disp_input];
         HWC_LOGV("%s disp:%" PRIu64 " m_disp_layer.gles_head[disp_input]:%d, m_disp_layer.gles_tail[disp_input]:%d",
             __func__, disp_id, m_disp_layer.gles_head[disp_input],m_disp_layer.gles_tail[disp_input] );
     }
@@ -3740,6 +4061,36 @@ void Hrt::setCompType(const std::vector<sp<HWCDisplay> >& displays)
 void Hrt::dump(String8* str)
 {
     str->appendFormat("%s\n", m_hrt_result.str().c_str());
+    str->appendFormat("[HRT] cache(debug.hwc.hrt_cache):%d hit:%u miss:%u model(debug.hwc.hrt_model):%d query:%u\n",
+        Platform::getInstance().m_config.hrt_cache, m_query_cache.getHitCount(), m_query_cache.getMissCount(),
+        Platform::getInstance().m_config.hrt_model, m_model.getQueryCount());
+}
+
+void Hrt::getFrameTrace(const uint64_t& disp_id, FrameTraceFrame* frame,
+                        std::vector<FrameTraceLayer>* trace_layers) const
+{
+    if (disp_id >= DisplayManager::MAX_DISPLAYS || m_query_layer_num[disp_id] < 0 ||
+        static_cast<size_t>(m_query_layer_num[disp_id]) != trace_layers->size())
+    {
+        return;
+    }
+
+    frame->flags |= FRAME_TRACE_HRT_QUERY;
+    frame->hrt_gles_head = m_query_gles_head[disp_id];
+    frame->hrt_gles_tail = m_query_gles_tail[disp_id];
+    for (size_t i = 0; i < trace_layers->size(); ++i)
+    {
+        const layer_config& config = m_layer_config_list[disp_id][i];
+        FrameTraceLayer* trace = &(*trace_layers)[i];
+        trace->hrt_src_fmt = config.src_fmt;
+        trace->hrt_src_width = config.src_width;
+        trace->hrt_src_height = config.src_height;
+        trace->hrt_layer_caps = config.layer_caps;
+        trace->hrt_dst_offset_x = config.dst_offset_x;
+        trace->hrt_dst_offset_y = config.dst_offset_y;
+        trace->hrt_dst_width = config.dst_width;
+        trace->hrt_dst_height = config.dst_height;
+    }
 }
 
 void Hrt::printQueryValidLayerResult()
@@ -3780,8 +4131,38 @@ void Hrt::modifyMdpDstRoiIfRejectedByRpo(const std::vector<sp<HWCDisplay> >& dis
     }
 }
 
+bool HrtDeviceArbiter::queryValidLayer(disp_layer_info* disp_layer)
+{
+    return HWCMediator::getInstance().getOvlDevice(HWC_DISPLAY_PRIMARY)->queryValidLayer(disp_layer);
+}
+
+bool Hrt::queryValidLayer()
+{
+    HrtArbiter* arbiter = Platform::getInstance().m_config.hrt_model ?
+        static_cast<HrtArbiter*>(&m_model) : static_cast<HrtArbiter*>(&m_device_arbiter);
+
+    // the driver may change its result without any change of the layers
+    if (!Platform::getInstance().m_config.hrt_cache ||
+        HWCMediator::getInstance().getDriverRefreshCount() > 0 ||
+        HWCDispatcher::getInstance().getSessionModeChanged() > 0)
+    {
+        m_query_cache.invalidate();
+        return arbiter->queryValidLayer(&m_disp_layer);
+    }
+
+    if (m_query_cache.lookup(&m_disp_layer))
+        return true;
+
+    const bool is_valid = arbiter->queryValidLayer(&m_disp_layer);
+    m_query_cache.update(m_disp_layer, is_valid);
+    return is_valid;
+}
+
 void Hrt::run(vector<sp<HWCDisplay> >& displays, const bool& is_skip_validate)
 {
+    for (int i = 0; i < DisplayManager::MAX_DISPLAYS; ++i)
+        m_query_layer_num[i] = -1;
+
     if (0 == isEnabled())
     {
         for (auto& hwc_display : displays)
@@ -3854,7 +4235,7 @@ void Hrt::run(vector<sp<HWCDisplay> >& displays, const bool& is_skip_validate)
 
     fillDispLayer(displays);
 
-    if (HWCMediator::getInstance().getOvlDevice(HWC_DISPLAY_PRIMARY)->queryValidLayer(&m_disp_layer))
+    if (queryValidLayer())
     {
         fillLayerInfoOfDispatcherJob(displays);
         setCompType(displays);
@@ -4109,11 +4490,13 @@ int32_t /*hwc2_error_t*/ HWCMediator::displayValidateDisplay(
     uint32_t* out_num_types,
     uint32_t* out_num_requests)
 {
+    const nsecs_t validate_start = systemTime();
     m_displays[display]->editPresentValiStateLog().printf("%s s:%s=>", __func__, getPresentValiStateString(m_displays[display]->getValiPresentState()));
     if (!DisplayManager::getInstance().m_data[display].connected)
     {
         return HWC2_ERROR_BAD_DISPLAY;
     }
+    m_trace_flags[display] = 0;
 
     if (m_displays[display]->getValiPresentState() == HWC_VALI_PRESENT_STATE_PRESENT_DONE)
     {
@@ -4137,8 +4520,34 @@ int32_t /*hwc2_error_t*/ HWCMediator::displayValidateDisplay(
     if (m_displays[display]->getValiPresentState() == HWC_VALI_PRESENT_STATE_PRESENT_DONE ||
         m_displays[display]->getValiPresentState() == HWC_VALI_PRESENT_STATE_CHECK_SKIP_VALI)
     {
-        validate();
-        countdowmSkipValiRelatedNumber();
+        if (checkValiPlanReusable() && Platform::getInstance().m_config.vali_cache != 2)
+        {
+            reuseValiPlan();
+            ++m_vali_cache_hit;
+            m_trace_flags[display] |= FRAME_TRACE_VALI_CACHE_HIT;
+        }
+        else
+        {
+            // vali_cache 2: always validate and check the cached plan is the same
+            const bool check_plan = checkValiPlanReusable();
+            validate();
+            countdowmSkipValiRelatedNumber();
+            for (auto& hwc_display : m_displays)
+            {
+                if (!check_plan || !hwc_display->isValid())
+                    continue;
+
+                ValiPlan plan;
+                hwc_display->getValiPlan(&plan);
+                if (!plan.isEquivalent(hwc_display->getSavedValiPlan()))
+                {
+                    HWC_LOGE("(%" PRIu64 ") cached vali plan mismatch fp:%" PRIx64,
+                        hwc_display->getId(), plan.fingerprint);
+                }
+            }
+            saveValiPlanForAllDisplays();
+            ++m_vali_cache_miss;
+        }
     }
 
     vector<sp<HWCLayer> > changed_comp_types;
@@ -4178,6 +4587,7 @@ int32_t /*hwc2_error_t*/ HWCMediator::displayValidateDisplay(
     setLastSFValidateNum(m_validate_seq);
     m_present_seq = 0;
     m_displays[display]->setValiPresentState(HWC_VALI_PRESENT_STATE_VALIDATE_DONE, __LINE__);
+    m_trace_validate_ns[display] = systemTime() - validate_start;
 
     return HWC2_ERROR_NONE;
 }
@@ -4621,15 +5031,38 @@ bool HWCMediator::checkSkipValidate()
 
         auto&& layers = m_displays[i]->getVisibleLayersSortedByZ();
 
-        for (size_t j = 0; j < layers.size(); ++j)
+        // the layers may be changed but the states which validate depends on
+        // are the same as the last validated frame, so reuse its result
+        if (Platform::getInstance().m_config.vali_cache != 0 &&
+            m_displays[i]->isValiPlanReusable())
         {
-            if (layers[j]->isStateChanged())
+            for (size_t j = 0; j < layers.size(); ++j)
             {
-                logger.printf("no skip vali(%d:L%d) ", i, __LINE__);
-                return false;
+                if (m_displays[i]->getSavedValiPlan().layers[j].hwlayer_type == HWC_LAYER_TYPE_INVALID)
+                {
+                    logger.printf("no skip vali(%d:L%d) ", i, __LINE__);
+                    return false;
+                }
+            }
+        }
+        else
+        {
+            for (size_t j = 0; j < layers.size(); ++j)
+            {
+                if (layers[j]->isStateChanged())
+                {
+                    logger.printf("no skip vali(%d:L%d) ", i, __LINE__);
+                    return false;
+                }
+
+                if (layers[j]->getHwlayerType() == HWC_LAYER_TYPE_INVALID)
+                {
+                    logger.printf("no skip vali(%d:L%d) ", i, __LINE__);
+                    return false;
+                }
             }
 
-            if (layers[j]->getHwlayerType() == HWC_LAYER_TYPE_INVALID)
+            if (m_displays[i]->isVisibleLayerChanged())
             {
                 logger.printf("no skip vali(%d:L%d) ", i, __LINE__);
                 return false;
@@ -4643,12 +5076,6 @@ bool HWCMediator::checkSkipValidate()
             return false;
         }
 
-        if (m_displays[i]->isVisibleLayerChanged())
-        {
-            logger.printf("no skip vali(%d:L%d) ", i, __LINE__);
-            return false;
-        }
-
         if (HWCDispatcher::getInstance().getOvlEnginePowerModeChanged(disp_id) > 0)
         {
             logger.printf("no skip vali(%d:L%d) ", i, __LINE__);
@@ -4669,6 +5096,68 @@ bool HWCMediator::checkSkipValidate()
     return (has_valid_display)? true : false;
 }
 
+bool HWCMediator::checkValiPlanReusable()
+{
+    if (Platform::getInstance().m_config.vali_cache == 0)
+        return false;
+
+    if (getDriverRefreshCount() > 0 ||
+        HWCDispatcher::getInstance().getSessionModeChanged() > 0)
+        return false;
+
+    bool has_valid_display = false;
+    for (auto& hwc_display : m_displays)
+    {
+        if (!hwc_display->isValid())
+            continue;
+
+        const int32_t disp_id = static_cast<int32_t>(hwc_display->getId());
+        has_valid_display = true;
+
+        if (!hwc_display->isValiPlanReusable())
+            return false;
+
+        DispatcherJob* job = HWCDispatcher::getInstance().getExistJob(disp_id);
+        if (job == NULL || hwc_display->getPrevAvailableInputLayerNum() != job->num_layers)
+            return false;
+
+        if (HWCDispatcher::getInstance().getOvlEnginePowerModeChanged(disp_id) > 0)
+            return false;
+
+        // the hdcp state of secure layers is not tracked by the fingerprint
+        if (listSecure(hwc_display->getVisibleLayersSortedByZ()))
+            return false;
+    }
+
+    return has_valid_display;
+}
+
+void HWCMediator::reuseValiPlan()
+{
+    for (auto& hwc_display : m_displays)
+    {
+        if (!hwc_display->isValid())
+            continue;
+
+        hwc_display->restoreValiPlan();
+    }
+
+    // the layer configs of hrt are the same as the ones of the last validate
+    m_hrt.run(m_displays, true);
+    updateGlesRangeForAllDisplays();
+}
+
+void HWCMediator::saveValiPlanForAllDisplays()
+{
+    for (auto& hwc_display : m_displays)
+    {
+        if (!hwc_display->isValid())
+            continue;
+
+        hwc_display->saveValiPlan();
+    }
+}
+
 int HWCMediator::getValidDisplayNum()
 {
     int count = 0;
@@ -4692,6 +5181,7 @@ void HWCMediator::buildVisibleLayerForAllDisplay()
         hwc_display->removePendingRemovedLayers();
         hwc_display->buildVisibleLayersSortedByZ();
         hwc_display->setupPrivateHandleOfLayers();
+        hwc_display->updateValiFingerprint();
     }
 }
 
@@ -4734,6 +5224,13 @@ void HWCMediator::setValiPresentStateOfAllDisplay(const HWC_VALI_PRESENT_STATE&
 
 void calculateMdpDstRoi(sp<HWCLayer> layer, const double& mdp_scale_percentage, const int32_t& z_seq)
 {
+    if (layer->isSwCompose())
+    {
+        // SwComposer scales to the display frame, not to be resized by disp
+        layer->editMdpDstRoi() = layer->getDisplayFrame();
+        return;
+    }
+
     if (!HWCMediator::getInstance().getOvlDevice(HWC_DISPLAY_PRIMARY)->isDispRpoSupported())
     {
         if (layer->getHwlayerType() == HWC_LAYER_TYPE_MM ||
@@ -4886,6 +5383,43 @@ void calculateMdpDstRoi(sp<HWCLayer> layer, const double& mdp_scale_percentage,
     }
 }
 
+void HWCMediator::recordFrameTrace(const hwc2_display_t& display, const nsecs_t& present_ns)
+{
+    const uint32_t max_frames = Platform::getInstance().m_config.frame_trace;
+    if (max_frames == 0)
+    {
+        m_frame_trace.close();
+        return;
+    }
+
+    if (!m_frame_trace.isOpen())
+    {
+        if (!m_frame_trace.open(FRAME_TRACE_PATH, max_frames))
+        {
+            HWC_LOGE("failed to open frame trace %s: %s", FRAME_TRACE_PATH, strerror(errno));
+            Platform::getInstance().m_config.frame_trace = 0;
+            return;
+        }
+        HWC_LOGI("frame trace: record %u frames to %s", max_frames, FRAME_TRACE_PATH);
+    }
+
+    FrameTraceFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.sequence = m_frame_trace.getFrameNum();
+    frame.flags = m_trace_flags[display];
+    frame.validate_ns = static_cast<uint32_t>(m_trace_validate_ns[display]);
+    frame.present_ns = static_cast<uint32_t>(present_ns);
+    m_displays[display]->getFrameTrace(&frame, &m_frame_trace_layers);
+    m_hrt.getFrameTrace(display, &frame, &m_frame_trace_layers);
+
+    if (!m_frame_trace.write(frame, m_frame_trace_layers.data()) || m_frame_trace.isFull())
+    {
+        HWC_LOGI("frame trace: %u frames written to %s", m_frame_trace.getFrameNum(), FRAME_TRACE_PATH);
+        m_frame_trace.close();
+        Platform::getInstance().m_config.frame_trace = 0;
+    }
+}
+
 void HWCMediator::validate()
 {
     // check if mirror mode exists
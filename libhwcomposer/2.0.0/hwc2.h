@@ -15,6 +15,10 @@ using vendor::mediatek::hardware::pq::V2_0::IPictureQuality;
 #include "color.h"
 #include "hwc2_api.h"
 #include "display.h"
+#include "vali_cache.h"
+#include "dirty_region.h"
+#include "hrt_model.h"
+#include "frame_trace.h"
 #include "utils/tools.h"
 
 class HWCDisplay;
@@ -254,6 +258,18 @@ public:
 
     void setLayerCaps(const int32_t& layer_caps) { m_layer_caps = layer_caps; }
     int32_t getLayerCaps() const { return m_layer_caps; }
+
+    // an MM layer which is composed by SwComposer instead of MDP
+    void setSwCompose(const bool& sw_compose) { m_sw_compose = sw_compose; }
+    bool isSwCompose() const { return m_sw_compose; }
+
+    // the states which validate() depends on, and their fingerprint
+    void getValiState(ValiLayerState* state) const;
+    void addValiFingerprint(ValiFingerprint* fingerprint) const;
+
+    // dirty region in buffer coordinates for partial update
+    const DirtyRegion& getDirtyRegion() const { return m_dirty_region; }
+    DirtyRegion& editDirtyRegion() { return m_dirty_region; }
 private:
     int64_t m_mtk_flags;
 
@@ -292,6 +308,8 @@ private:
 
     hwc_rect_t m_mdp_dst_roi;
 
+    DirtyRegion m_dirty_region;
+
     uint64_t m_disp_id;
 
     sp<HWCBuffer> m_hwc_buf;
@@ -303,6 +321,8 @@ private:
     int32_t m_last_comp_type_call_from_sf;
 
     int32_t m_layer_caps;
+
+    bool m_sw_compose;
 };
 
 class HWCDisplay : public RefBase
@@ -468,6 +488,32 @@ public:
     void checkVisibleLayerChange(const std::vector<sp<HWCLayer> > &prev_visible_layers);
 
     DbgLogger& editPresentValiStateLog() { return m_present_vali_state_log; }
+
+    // validate result cache
+    void getValiState(ValiDisplayState* state);
+    void updateValiFingerprint();
+    uint64_t getValiFingerprint() const { return m_vali_fingerprint; }
+    bool isValiPlanReusable() const
+    {
+        return m_vali_plan.valid && m_vali_plan.fingerprint == m_vali_fingerprint &&
+               m_vali_plan.layers.size() == m_visible_layers.size();
+    }
+    void saveValiPlan();
+    void restoreValiPlan();
+    void getValiPlan(ValiPlan* plan);
+    const ValiPlan& getSavedValiPlan() const { return m_vali_plan; }
+    void invalidateValiPlan() { m_vali_plan.invalidate(); }
+
+    // getFrameTrace() fills the visible layers and the composition decided
+    // for them into a frame of the frame trace
+    void getFrameTrace(FrameTraceFrame* frame, std::vector<FrameTraceLayer>* trace_layers);
+
+    // partial update
+    // updateDirtyRegions() fills the dirty region of each committed layer from
+    // its surface damage and the area exposed by the geometry change of the
+    // committed layers, return false if the full screen must be invalidated
+    bool updateDirtyRegions();
+    void invalidateDirtyRegions() { m_dirty_tracker.invalidate(); }
 private:
     bool needDoAvGrouping(const int32_t num_validate_display);
 
@@ -509,6 +555,11 @@ private:
     HWC_VALI_PRESENT_STATE m_vali_present_state;
     bool m_is_visible_layer_changed;
     DbgLogger m_present_vali_state_log;
+
+    uint64_t m_vali_fingerprint;
+    ValiPlan m_vali_plan;
+
+    DirtyRegionTracker m_dirty_tracker;
 };
 
 class DisplayListener : public DisplayManager::EventListener
@@ -544,14 +595,28 @@ private:
     virtual void onRefresh(int dpy, unsigned int type);
 };
 
+// query the valid layers from the display driver
+class HrtDeviceArbiter : public HrtArbiter
+{
+public:
+    bool queryValidLayer(disp_layer_info* disp_layer);
+};
+
 class Hrt
 {
 public:
     Hrt()
+        : m_model(HRT_MODEL_MAX_OVL_LAYERS, HRT_MODEL_HRT_LIMIT)
     {
         memset(m_layer_config_list, 0, sizeof(layer_config*) * DisplayManager::MAX_DISPLAYS);
         memset(m_layer_config_len, 0, sizeof(int) * DisplayManager::MAX_DISPLAYS);
         memset(&m_disp_layer, 0, sizeof(disp_layer_info));
+        for (int i = 0; i < DisplayManager::MAX_DISPLAYS; ++i)
+        {
+            m_query_gles_head[i] = -1;
+            m_query_gles_tail[i] = -1;
+            m_query_layer_num[i] = -1;
+        }
     }
     ~Hrt()
     {
@@ -568,6 +633,11 @@ public:
 
     void dump(String8* str);
 
+    // getFrameTrace() fills the input of the hrt query of the last validate
+    // into a frame of display, if the query ran for its visible layers
+    void getFrameTrace(const uint64_t& disp_id, FrameTraceFrame* frame,
+                       std::vector<FrameTraceLayer>* trace_layers) const;
+
 private:
     void printQueryValidLayerResult();
 
@@ -581,12 +651,24 @@ private:
 
     void setCompType(const std::vector<sp<HWCDisplay> >& displays);
 
+    bool queryValidLayer();
+
     layer_config* m_layer_config_list[DisplayManager::MAX_DISPLAYS];
     int m_layer_config_len[DisplayManager::MAX_DISPLAYS];
 
     disp_layer_info m_disp_layer;
 
+    // the GLES range and the layer number given to the last query of each
+    // display, layer_num is -1 if the last run did not query for it
+    int32_t m_query_gles_head[DisplayManager::MAX_DISPLAYS];
+    int32_t m_query_gles_tail[DisplayManager::MAX_DISPLAYS];
+    int32_t m_query_layer_num[DisplayManager::MAX_DISPLAYS];
+
     std::stringstream m_hrt_result;
+
+    HrtDeviceArbiter m_device_arbiter;
+    HrtModel m_model;
+    HrtQueryCache m_query_cache;
 };
 
 class HWCMediator : public HWC2Api, public android::Singleton<HWCMediator>
@@ -645,6 +727,16 @@ private:
 
     void setValiPresentStateOfAllDisplay(const HWC_VALI_PRESENT_STATE& val, const int32_t& line);
 
+    bool checkValiPlanReusable();
+
+    void reuseValiPlan();
+
+    void saveValiPlanForAllDisplays();
+
+    // recordFrameTrace() writes the presented frame of display into the
+    // frame trace while debug.hwc.frame_trace asks for frames
+    void recordFrameTrace(const hwc2_display_t& display, const nsecs_t& present_ns);
+
     SKIP_VALI_STATE getNeedValidate() const { return m_need_validate; }
     void setNeedValidate(SKIP_VALI_STATE val) { m_need_validate = val; }
 
@@ -672,6 +764,16 @@ private:
 
     int m_driver_refresh_count;
     mutable Mutex m_driver_refresh_count_mutex;
+
+    uint32_t m_vali_cache_hit;
+    uint32_t m_vali_cache_miss;
+
+    FrameTraceWriter m_frame_trace;
+    std::vector<FrameTraceLayer> m_frame_trace_layers;
+
+    // cpu time and FRAME_TRACE_* flags of the last validate of each display
+    nsecs_t m_trace_validate_ns[DisplayManager::MAX_DISPLAYS];
+    uint32_t m_trace_flags[DisplayManager::MAX_DISPLAYS];
 public:
     void open(/*hwc_private_device_t* device*/);
 
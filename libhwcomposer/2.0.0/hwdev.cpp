@@ -478,6 +478,8 @@ DispDevice::DispDevice()
     m_ovl_input_num = getMaxOverlayInputNum();
 
     memset(m_frame_cfg, 0, sizeof(disp_frame_cfg_t) * DisplayManager::MAX_DISPLAYS);
+    memset(m_packed_frame_cfg, 0, sizeof(disp_frame_cfg_t) * DisplayManager::MAX_DISPLAYS);
+    memset(m_diff_pending, 0, sizeof(m_diff_pending));
     memset(m_color_transform_info, 0, sizeof(DispColorTransformInfo) * DisplayManager::MAX_DISPLAYS);
 
     for (int i = 0; i < DisplayManager::MAX_DISPLAYS; i++)
@@ -674,6 +676,7 @@ status_t DispDevice::createOverlaySession(int dpy, DISP_MODE mode)
 
     m_frame_cfg[dpy].session_id = config.session_id;
     m_frame_cfg[dpy].mode = mode;
+    invalidateConfigDiff(dpy);
 
     DLOGD(dpy, "Create Session (%s)", getSessionModeString(mode).string());
 
@@ -704,6 +707,7 @@ void DispDevice::destroyOverlaySession(int dpy)
 
     m_frame_cfg[dpy].session_id = DISP_INVALID_SESSION;
     m_frame_cfg[dpy].mode = DISP_INVALID_SESSION_MODE;
+    invalidateConfigDiff(dpy);
 
     DLOGD(dpy, "Destroy DispSession");
 }
@@ -713,19 +717,47 @@ status_t DispDevice::legacySetInputBuffer(int dpy)
     if (m_caps_info.is_support_frame_cfg_ioctl)
         return NO_ERROR;
 
+    const bool is_diffed = m_diff_pending[dpy];
+    m_diff_pending[dpy] = false;
+
+    // nothing to change in the driver
+    if (is_diffed && 0 == m_config_diff[dpy].getChangedNum() &&
+        !m_frame_cfg[dpy].ccorr_config.is_dirty)
+    {
+        m_config_diff[dpy].endFrame();
+        return NO_ERROR;
+    }
+
     static disp_session_input_config input_config;
     memset(&input_config, 0, sizeof(disp_session_input_config));
 
     input_config.session_id = m_frame_cfg[dpy].session_id;
-    input_config.config_layer_num = m_frame_cfg[dpy].input_layer_num;
-    int size = input_config.config_layer_num * sizeof(disp_input_config);
-    memcpy(input_config.config, m_frame_cfg[dpy].input_cfg, size);
+    if (is_diffed)
+    {
+        const OvlConfigDiff& diff = m_config_diff[dpy];
+        input_config.config_layer_num = diff.getChangedNum();
+        for (uint32_t i = 0; i < diff.getChangedNum(); i++)
+        {
+            input_config.config[i] = m_frame_cfg[dpy].input_cfg[diff.getChangedId(i)];
+        }
+    }
+    else
+    {
+        input_config.config_layer_num = m_frame_cfg[dpy].input_layer_num;
+        int size = input_config.config_layer_num * sizeof(disp_input_config);
+        memcpy(input_config.config, m_frame_cfg[dpy].input_cfg, size);
+    }
     memcpy(&input_config.ccorr_config, &m_frame_cfg[dpy].ccorr_config, sizeof(m_frame_cfg[dpy].ccorr_config));
 
     int err = WDT_IOCTL(m_dev_fd, DISP_IOCTL_SET_INPUT_BUFFER, &input_config);
     if (err < 0)
     {
         IOLOGE(dpy, err, "DISP_IOCTL_SET_INPUT_BUFFER");
+        invalidateConfigDiff(dpy);
+    }
+    else if (is_diffed)
+    {
+        m_config_diff[dpy].endFrame();
     }
 
     return err;
@@ -798,16 +830,29 @@ status_t DispDevice::frameConfig(int dpy, int pf_idx, int ovlp_layer_num,
     m_frame_cfg[dpy].tigger_mode = trigger_mode;
     m_frame_cfg[dpy].prev_present_fence_fd = prev_present_fence_fd;
 
-    int err = WDT_IOCTL(m_dev_fd, DISP_IOCTL_FRAME_CONFIG, &m_frame_cfg[dpy]);
+    disp_frame_cfg_t* frame_cfg = &m_frame_cfg[dpy];
+    const bool is_diffed = m_diff_pending[dpy];
+    if (is_diffed)
+    {
+        frame_cfg = packFrameConfig(dpy);
+        m_diff_pending[dpy] = false;
+    }
+
+    int err = WDT_IOCTL(m_dev_fd, DISP_IOCTL_FRAME_CONFIG, frame_cfg);
     if (err < 0)
     {
         IOLOGE(dpy, err, "DISP_IOCTL_FRAME_CONFIG ovlp:%d pf_idx=%d", ovlp_layer_num, pf_idx);
+        invalidateConfigDiff(dpy);
     }
     else
     {
+        if (is_diffed)
+            m_config_diff[dpy].endFrame();
+
         DbgLogger logger(DbgLogger::TYPE_HWC_LOG, 'D');
-        logger.printf("(%d) DISP_IOCTL_FRAME_CONFIG ovlp:%d pf_idx=%d id:%x",
-                                    dpy, ovlp_layer_num, pf_idx, m_frame_cfg[dpy].session_id);
+        logger.printf("(%d) DISP_IOCTL_FRAME_CONFIG ovlp:%d pf_idx=%d id:%x in:%d/%d",
+                                    dpy, ovlp_layer_num, pf_idx, m_frame_cfg[dpy].session_id,
+                                    frame_cfg->input_layer_num, m_frame_cfg[dpy].input_layer_num);
     }
 
     return err;
@@ -874,6 +919,9 @@ void DispDevice::disableOverlaySession(
         m_frame_cfg[dpy].input_layer_num = (num < m_ovl_input_num) ? num : m_ovl_input_num;
     }
 
+    // the inputs are disabled without diffing, so send all of them
+    invalidateConfigDiff(dpy);
+
     if (!m_caps_info.is_support_frame_cfg_ioctl)
         legacySetInputBuffer(dpy);
 
@@ -907,6 +955,7 @@ status_t DispDevice::setOverlaySessionMode(int dpy, DISP_MODE mode)
     }
 
     m_frame_cfg[dpy].mode = mode;
+    invalidateConfigDiff(dpy);
 
     DLOGD(dpy, "DispSessionMode (%s)", getSessionModeString(mode).string());
     return NO_ERROR;
@@ -1255,10 +1304,132 @@ void DispDevice::updateOverlayInputs(
     }
     HWC_LOGV("- updateOverlayInputs");
 
+    diffOverlayInputs(dpy);
+
     if (!m_caps_info.is_support_frame_cfg_ioctl)
         legacySetInputBuffer(dpy);
 }
 
+static void encodeInputConfig(const disp_input_config& input, OvlInputKey* key)
+{
+    key->src_base_addr  = reinterpret_cast<uintptr_t>(input.src_base_addr);
+    key->src_phy_addr   = reinterpret_cast<uintptr_t>(input.src_phy_addr);
+    key->src_fmt        = input.src_fmt;
+    key->src_pitch      = input.src_pitch;
+    key->src_offset_x   = input.src_offset_x;
+    key->src_offset_y   = input.src_offset_y;
+    key->src_width      = input.src_width;
+    key->src_height     = input.src_height;
+    key->tgt_offset_x   = input.tgt_offset_x;
+    key->tgt_offset_y   = input.tgt_offset_y;
+    key->tgt_width      = input.tgt_width;
+    key->tgt_height     = input.tgt_height;
+    key->next_buff_idx  = input.next_buff_idx;
+    key->src_fence_fd   = input.src_fence_fd;
+    key->frm_sequence   = input.frm_sequence;
+    key->identity       = input.identity;
+    key->connected_type = input.connected_type;
+    key->ext_sel_layer  = input.ext_sel_layer;
+    key->layer_enable   = input.layer_enable;
+    key->buffer_source  = input.buffer_source;
+    key->layer_type     = input.layer_type;
+    key->layer_rotation = input.layer_rotation;
+    key->is_tdshp       = input.isTdshp;
+    key->alpha_enable   = input.alpha_enable;
+    key->alpha          = input.alpha;
+    key->yuv_range      = input.yuv_range;
+    key->sur_aen        = input.sur_aen;
+    key->src_alpha      = input.src_alpha;
+    key->dst_alpha      = input.dst_alpha;
+    key->security       = input.security;
+
+    const uint32_t dirty_num = (input.layer_enable && input.dirty_roi_num <= MAX_DIRTY_RECT_CNT) ?
+        input.dirty_roi_num : 0;
+    key->dirty_roi_num = dirty_num;
+    if (dirty_num > 0)
+    {
+        int32_t values[MAX_DIRTY_RECT_CNT * 4];
+        const layer_dirty_roi* rois = static_cast<const layer_dirty_roi*>(input.dirty_roi_addr);
+        for (uint32_t j = 0; j < dirty_num; j++)
+        {
+            values[j * 4 + 0] = rois[j].dirty_x;
+            values[j * 4 + 1] = rois[j].dirty_y;
+            values[j * 4 + 2] = rois[j].dirty_w;
+            values[j * 4 + 3] = rois[j].dirty_h;
+        }
+        key->dirty_hash = OvlInputKey::hashRects(values, dirty_num * 4);
+    }
+}
+
+bool DispDevice::isConfigDiffEnabled()
+{
+    return Platform::getInstance().m_config.ovl_config_diff &&
+           m_ovl_input_num <= OvlConfigDiff::MAX_INPUT_NUM;
+}
+
+void DispDevice::diffOverlayInputs(int dpy)
+{
+    OvlConfigDiff& diff = m_config_diff[dpy];
+    if (!isConfigDiffEnabled())
+    {
+        diff.invalidate();
+        m_diff_pending[dpy] = false;
+        return;
+    }
+
+    diff.beginFrame();
+    const int num = m_frame_cfg[dpy].input_layer_num;
+    for (int i = 0; i < num; i++)
+    {
+        OvlInputKey key;
+        encodeInputConfig(m_frame_cfg[dpy].input_cfg[i], &key);
+        diff.update(i, key);
+    }
+    m_diff_pending[dpy] = true;
+
+    HWC_LOGV("(%d) diffOverlayInputs changed:%u/%d", dpy, diff.getChangedNum(), num);
+}
+
+disp_frame_cfg_t* DispDevice::packFrameConfig(int dpy)
+{
+    const OvlConfigDiff& diff = m_config_diff[dpy];
+    disp_frame_cfg_t* packed = &m_packed_frame_cfg[dpy];
+
+    // the driver applies each input by layer_id, so the changed ones are
+    // packed at the front and the others are left as they are
+    *packed = m_frame_cfg[dpy];
+    for (uint32_t i = 0; i < diff.getChangedNum(); i++)
+    {
+        const uint32_t id = diff.getChangedId(i);
+        if (id != i)
+            packed->input_cfg[i] = m_frame_cfg[dpy].input_cfg[id];
+    }
+    packed->input_layer_num = diff.getChangedNum();
+
+    return packed;
+}
+
+void DispDevice::invalidateConfigDiff(int dpy)
+{
+    m_config_diff[dpy].invalidate();
+    m_diff_pending[dpy] = false;
+}
+
+void DispDevice::dumpConfigDiff(String8* dump_str)
+{
+    for (int dpy = 0; dpy < DisplayManager::MAX_DISPLAYS; dpy++)
+    {
+        const OvlConfigDiffStats& stats = m_config_diff[dpy].getStats();
+        if (0 == stats.frames)
+            continue;
+
+        dump_str->appendFormat("  (%d) ovl config diff frames:%" PRIu64 " full:%" PRIu64 " dropped:%" PRIu64
+            " inputs:%" PRIu64 " sent:%" PRIu64 " bytes sent:%" PRIu64 "/%" PRIu64 "\n",
+            dpy, stats.frames, stats.full_frames, stats.dropped_frames, stats.inputs, stats.pushed,
+            stats.pushed * sizeof(disp_input_config), stats.inputs * sizeof(disp_input_config));
+    }
+}
+
 void DispDevice::prepareOverlayOutput(int dpy, OverlayPrepareParam* param)
 {
     int session_id = m_frame_cfg[dpy].session_id;
@@ -1400,6 +1571,9 @@ status_t DispDevice::waitVSync(int dpy, nsecs_t *ts)
 
 void DispDevice::setPowerMode(int dpy,int mode)
 {
+    // the driver may reset the layers when the display is powered
+    invalidateConfigDiff(dpy);
+
     if (HWCMediator::getInstance().m_features.control_fb)
     {
         HWC_LOGD("DispDevice::setPowerMode() dpy:%d mode:%d", dpy, mode);
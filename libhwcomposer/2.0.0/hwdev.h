@@ -14,6 +14,7 @@
 #include "color.h"
 #include "display.h"
 #include "hwc2_api.h"
+#include "ovl_config_diff.h"
 
 #define DISP_NO_PRESENT_FENCE  -1
 
@@ -296,6 +297,9 @@ public:
 
     // waitRefreshRequest() is used to wait for refresh request from driver
     status_t waitRefreshRequest(unsigned int* type);
+
+    // dumpConfigDiff() dumps how many input configs are sent to the driver
+    void dumpConfigDiff(String8* dump_str);
 private:
 
     // for lagacy driver API
@@ -311,6 +315,21 @@ private:
     // query hw capabilities through ioctl and store in m_caps_info
     status_t queryCapsInfo();
 
+    // isConfigDiffEnabled() is true when only the changed input configs are
+    // sent to the driver
+    bool isConfigDiffEnabled();
+
+    // diffOverlayInputs() finds the input configs of this frame which the
+    // driver does not have yet
+    void diffOverlayInputs(int dpy);
+
+    // packFrameConfig() copies the frame config with only the changed inputs
+    // into m_packed_frame_cfg
+    disp_frame_cfg_t* packFrameConfig(int dpy);
+
+    // invalidateConfigDiff() makes the next frame send all input configs
+    void invalidateConfigDiff(int dpy);
+
     // get the correct device id for extension display when enable dual display
     unsigned int getDeviceId(int dpy);
 
@@ -325,6 +344,16 @@ private:
 
     disp_frame_cfg_t m_frame_cfg[DisplayManager::MAX_DISPLAYS];
 
+    // m_config_diff tracks the input configs which the driver has
+    OvlConfigDiff m_config_diff[DisplayManager::MAX_DISPLAYS];
+
+    // m_diff_pending is true after the inputs of m_frame_cfg are diffed
+    // and until they are sent; for a frame dropped before its ioctl it
+    // stays set, and m_config_diff makes the next frame send all inputs
+    bool m_diff_pending[DisplayManager::MAX_DISPLAYS];
+
+    disp_frame_cfg_t m_packed_frame_cfg[DisplayManager::MAX_DISPLAYS];
+
     disp_caps_info m_caps_info;
 
     layer_config* m_layer_config_list[DisplayManager::MAX_DISPLAYS];
@@ -0,0 +1,253 @@
+#ifndef HWC_JOB_QUEUE_H_
+#define HWC_JOB_QUEUE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <type_traits>
+
+// ---------------------------------------------------------------------------
+
+// SpscRing is a bounded FIFO between exactly one producer thread and exactly
+// one consumer thread. It never blocks and never allocates.
+// N must be a power of two; the ring holds up to N items.
+template <typename T, uint32_t N>
+class SpscRing
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+    SpscRing() : m_head(0), m_tail(0) { }
+
+    // push() is called by the producer, return false if the ring is full
+    bool push(const T& item)
+    {
+        const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) >= N)
+            return false;
+
+        m_items[tail & (N - 1)] = item;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // front() is called by the consumer, return false if the ring is empty
+    bool front(T* item) const
+    {
+        const uint32_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false;
+
+        *item = m_items[head & (N - 1)];
+        return true;
+    }
+
+    // pop() is called by the consumer, return false if the ring is empty
+    bool pop(T* item)
+    {
+        if (!front(item))
+            return false;
+
+        m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        return true;
+    }
+
+    // size() and empty() can be called by any thread,
+    // but the result is only a snapshot
+    uint32_t size() const
+    {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+
+    bool empty() const { return size() == 0; }
+
+    static uint32_t capacity() { return N; }
+
+private:
+    // head and tail are written by different threads, keep them apart
+    // to avoid false sharing
+    alignas(64) std::atomic<uint32_t> m_head;
+    alignas(64) std::atomic<uint32_t> m_tail;
+    T m_items[N];
+};
+
+// ObjectPool preallocates N objects of T. acquire() and release() may run on
+// different threads, but acquire() only on one thread and release() only on
+// one other thread: the free slots are handed back through a SpscRing.
+// acquire() constructs a new T in place, so an acquired object is the same as
+// a newly allocated one; it returns NULL when all objects are in use.
+// The pool does not destroy the objects in use, their owner must release them
+// before the pool is destroyed.
+template <typename T, uint32_t N>
+class ObjectPool
+{
+public:
+    ObjectPool()
+    {
+        for (uint32_t i = 0; i < N; ++i)
+        {
+            m_free.push(i);
+        }
+    }
+
+    T* acquire()
+    {
+        uint32_t slot = 0;
+        if (!m_free.pop(&slot))
+            return NULL;
+
+        return new (&m_storage[slot]) T();
+    }
+
+    void release(T* obj)
+    {
+        obj->~T();
+        m_free.push(static_cast<uint32_t>(reinterpret_cast<Storage*>(obj) - m_storage));
+    }
+
+    // owns() is used to check if obj is allocated from this pool
+    bool owns(const T* obj) const
+    {
+        const Storage* storage = reinterpret_cast<const Storage*>(obj);
+        return storage >= m_storage && storage < m_storage + N;
+    }
+
+    // getSlot() returns the index of an object of this pool
+    uint32_t getSlot(const T* obj) const
+    {
+        return static_cast<uint32_t>(reinterpret_cast<const Storage*>(obj) - m_storage);
+    }
+
+    uint32_t getFreeNum() const { return m_free.size(); }
+
+    static uint32_t capacity() { return N; }
+
+private:
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Storage;
+
+    Storage m_storage[N];
+    SpscRing<uint32_t, N> m_free;
+};
+
+// JOB_STAGE is the stage a job goes through from HWC to the display driver
+enum JOB_STAGE
+{
+    // the job is got by HWCDispatcher::getJob() in validateDisplay()
+    JOB_STAGE_ACQUIRE   = 0,
+    // the job is filled by HWCDispatcher::setJob() in presentDisplay()
+    JOB_STAGE_SET       = 1,
+    // the job is queued into DispatchThread
+    JOB_STAGE_QUEUE     = 2,
+    // the job is taken out of the queue by DispatchThread
+    JOB_STAGE_DEQUEUE   = 3,
+    // the job is composed and released
+    JOB_STAGE_DONE      = 4,
+    JOB_STAGE_NUM,
+};
+
+// JobStageTrace keeps the latency of the last TRACE_SAMPLE_NUM jobs of a
+// display, and reports the percentiles of each stage for dumpsys and tests.
+// record() is called by DispatchThread once per job, the readers are dumpsys
+// or the tests; the short lock is taken only once per frame.
+class JobStageTrace
+{
+public:
+    enum
+    {
+        TRACE_SAMPLE_NUM = 256,
+    };
+
+    // the intervals reported by JobStageTrace
+    enum INTERVAL
+    {
+        // from acquire to queue (the time HWC spends to fill the job)
+        INTERVAL_FILL       = 0,
+        // from queue to dequeue (the time the job waits in the queue)
+        INTERVAL_QUEUE      = 1,
+        // from dequeue to done (the time the job is handled)
+        INTERVAL_HANDLE     = 2,
+        // from queue to done (dispatch latency)
+        INTERVAL_DISPATCH   = 3,
+        INTERVAL_NUM,
+    };
+
+    JobStageTrace()
+        : m_count(0)
+        , m_dropped(0)
+    {
+        memset(m_samples, 0, sizeof(m_samples));
+    }
+
+    // record() is used to record timestamps (ns) of all stages of a job;
+    // a stage which is not passed has timestamp 0
+    void record(const int64_t* stage_time)
+    {
+        std::lock_guard<std::mutex> l(m_lock);
+        if (stage_time[JOB_STAGE_DEQUEUE] == 0)
+        {
+            ++m_dropped;
+            return;
+        }
+
+        const uint32_t idx = m_count % TRACE_SAMPLE_NUM;
+        m_samples[INTERVAL_FILL][idx] =
+            diff(stage_time[JOB_STAGE_ACQUIRE], stage_time[JOB_STAGE_QUEUE]);
+        m_samples[INTERVAL_QUEUE][idx] =
+            diff(stage_time[JOB_STAGE_QUEUE], stage_time[JOB_STAGE_DEQUEUE]);
+        m_samples[INTERVAL_HANDLE][idx] =
+            diff(stage_time[JOB_STAGE_DEQUEUE], stage_time[JOB_STAGE_DONE]);
+        m_samples[INTERVAL_DISPATCH][idx] =
+            diff(stage_time[JOB_STAGE_QUEUE], stage_time[JOB_STAGE_DONE]);
+        ++m_count;
+    }
+
+    // getPercentile() returns the latency (ns) at percent [0, 100]
+    // of the recorded jobs
+    int64_t getPercentile(const INTERVAL& interval, const uint32_t& percent) const
+    {
+        int64_t sorted[TRACE_SAMPLE_NUM];
+        uint32_t num = 0;
+        {
+            std::lock_guard<std::mutex> l(m_lock);
+            num = std::min<uint32_t>(m_count, TRACE_SAMPLE_NUM);
+            memcpy(sorted, m_samples[interval], sizeof(int64_t) * num);
+        }
+
+        if (num == 0)
+            return 0;
+
+        const uint32_t rank = std::min(num - 1, (num * std::min(percent, 100u)) / 100);
+        std::nth_element(sorted, sorted + rank, sorted + num);
+        return sorted[rank];
+    }
+
+    uint32_t getCount() const
+    {
+        std::lock_guard<std::mutex> l(m_lock);
+        return m_count;
+    }
+
+    uint32_t getDroppedCount() const
+    {
+        std::lock_guard<std::mutex> l(m_lock);
+        return m_dropped;
+    }
+
+private:
+    static int64_t diff(const int64_t& begin, const int64_t& end)
+    {
+        return (begin == 0 || end < begin) ? 0 : end - begin;
+    }
+
+    mutable std::mutex m_lock;
+    uint32_t m_count;
+    uint32_t m_dropped;
+    int64_t m_samples[INTERVAL_NUM][TRACE_SAMPLE_NUM];
+};
+
+#endif // HWC_JOB_QUEUE_H_
@@ -1236,23 +1236,32 @@ void OverlayEngine::waitAllFence(sp<FrameInfo>& info)
     DbgLogger logger(DbgLogger::TYPE_HWC_LOG, 'D');
     logger.printf("(%" PRIu64 ") Wait present fence for idx: %d", m_disp_id, info->present_fence_idx);
 
-    waitOverlayFence(&info->overlay_info);
+    // the input, output, and present fences are waited by one poll,
+    // and the signaled ones are skipped
+    FenceSet fences(SyncFence::merge);
+    addOverlayFence(&info->overlay_info, &fences);
 
     if (info->prev_present_fence != -1)
     {
-        sprintf(tag, "%s-PF", DEBUG_LOG_TAG);
+        if (!fences.add(info->prev_present_fence))
+        {
+            sprintf(tag, "%s-PF", DEBUG_LOG_TAG);
+            m_sync_fence->wait(info->prev_present_fence, 1000, tag);
+        }
+        info->prev_present_fence = -1;
+    }
+
 #ifdef FENCE_DEBUG
-        HWC_LOGD("+ OverlayEngine::waitPresentFence prev_present_fence:%d", info->prev_present_fence);
+    HWC_LOGD("+ OverlayEngine::waitAllFence() fences:%zu", fences.size());
 #endif
-        m_sync_fence->wait(info->prev_present_fence, 1000, tag);
+    sprintf(tag, "%s-ALL", DEBUG_LOG_TAG);
+    m_sync_fence->wait(&fences, 1000, tag);
 #ifdef FENCE_DEBUG
-        HWC_LOGD("- OverlayEngine::waitPresentFence");
+    HWC_LOGD("- OverlayEngine::waitAllFence()");
 #endif
-        info->prev_present_fence = -1;
-    }
 }
 
-void OverlayEngine::waitOverlayFence(FrameOverlayInfo* info)
+void OverlayEngine::addOverlayFence(FrameOverlayInfo* info, FenceSet* fences)
 {
     char tag[128];
 
@@ -1261,28 +1270,22 @@ void OverlayEngine::waitOverlayFence(FrameOverlayInfo* info)
         OverlayPortParam* layer = info->input.editItemAt(i);
         if (layer->fence != -1)
         {
-            sprintf(tag, "%s-IN-%d", DEBUG_LOG_TAG, i);
-#ifdef FENCE_DEBUG
-            HWC_LOGD("+ OverlayEngine::waitOverlayFence() layer->fence:%d", layer->fence);
-#endif
-            m_sync_fence->wait(layer->fence, 1000, tag);
-#ifdef FENCE_DEBUG
-            HWC_LOGD("- OverlayEngine::waitOverlayFence()");
-#endif
+            if (!fences->add(layer->fence))
+            {
+                sprintf(tag, "%s-IN-%d", DEBUG_LOG_TAG, i);
+                m_sync_fence->wait(layer->fence, 1000, tag);
+            }
             layer->fence = -1;
         }
     }
 
     if (info->enable_output && info->output.fence != -1)
     {
-        sprintf(tag, "%s-OUT", DEBUG_LOG_TAG);
-#ifdef FENCE_DEBUG
-        HWC_LOGD("+ OverlayEngine::waitOverlayFence() output.fence:%d", info->output.fence);
-#endif
-        m_sync_fence->wait(info->output.fence, 1000, tag);
-#ifdef FENCE_DEBUG
-        HWC_LOGD("- OverlayEngine::waitOverlayFence()");
-#endif
+        if (!fences->add(info->output.fence))
+        {
+            sprintf(tag, "%s-OUT", DEBUG_LOG_TAG);
+            m_sync_fence->wait(info->output.fence, 1000, tag);
+        }
         info->output.fence = -1;
     }
 }
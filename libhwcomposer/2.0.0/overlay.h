@@ -29,6 +29,7 @@ struct DispatcherJob;
 struct HWBuffer;
 struct dump_buff;
 class SyncFence;
+class FenceSet;
 class PostProcessingEngine;
 
 // ---------------------------------------------------------------------------
@@ -385,8 +386,9 @@ private:
     // waitAllFence() is used to wait layer fence, present fence and output buffer fence
     void waitAllFence(sp<FrameInfo>& info);
 
-    // waitOverlayFence is used to wait layer fence and output buffer fence
-    void waitOverlayFence(FrameOverlayInfo* info);
+    // addOverlayFence is used to move layer fence and output buffer fence
+    // into fences, so all of them are waited at once
+    void addOverlayFence(FrameOverlayInfo* info, FenceSet* fences);
 
     // closeOverlayFenceFd is used to close input and output fence
     void closeOverlayFenceFd(FrameOverlayInfo* info);
@@ -0,0 +1,88 @@
+#include <stddef.h>
+
+#include "ovl_config_diff.h"
+
+// ---------------------------------------------------------------------------
+
+static_assert(sizeof(OvlInputKey) == 3 * 8 + 16 * 4 + 16, "OvlInputKey has padding");
+
+uint32_t OvlInputKey::hash() const
+{
+    // FNV-1a by 32-bit words, the key is a multiple of 8 bytes
+    uint32_t words[sizeof(OvlInputKey) / sizeof(uint32_t)];
+    memcpy(words, this, sizeof(words));
+
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); ++i)
+    {
+        h ^= words[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+uint64_t OvlInputKey::hashRects(const int32_t* values, const uint32_t& num)
+{
+    uint64_t h = 14695981039346656037ull;
+    for (uint32_t i = 0; i < num; ++i)
+    {
+        h ^= static_cast<uint32_t>(values[i]);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// ---------------------------------------------------------------------------
+
+OvlConfigDiff::OvlConfigDiff()
+    : m_full(true)
+    , m_in_frame(false)
+    , m_changed_num(0)
+{
+    memset(m_hashes, 0, sizeof(m_hashes));
+    invalidate();
+}
+
+void OvlConfigDiff::invalidate()
+{
+    memset(m_valid, 0, sizeof(m_valid));
+    m_full = true;
+    m_in_frame = false;
+}
+
+void OvlConfigDiff::beginFrame()
+{
+    // the keys of the last frame were taken, but the frame may not have
+    // reached the driver
+    if (m_in_frame)
+    {
+        ++m_stats.dropped_frames;
+        invalidate();
+    }
+
+    ++m_stats.frames;
+    m_in_frame = true;
+    if (m_full)
+    {
+        ++m_stats.full_frames;
+        m_full = false;
+    }
+
+    m_changed_num = 0;
+}
+
+bool OvlConfigDiff::update(const uint32_t& id, const OvlInputKey& key)
+{
+    ++m_stats.inputs;
+
+    const uint32_t h = key.hash();
+    if (m_valid[id] && m_hashes[id] == h && m_keys[id] == key)
+        return false;
+
+    m_keys[id] = key;
+    m_hashes[id] = h;
+    m_valid[id] = true;
+    m_changed[m_changed_num++] = id;
+    ++m_stats.pushed;
+    return true;
+}
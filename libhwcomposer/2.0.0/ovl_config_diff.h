@@ -0,0 +1,145 @@
+#ifndef HWC_OVL_CONFIG_DIFF_H_
+#define HWC_OVL_CONFIG_DIFF_H_
+
+#include <stdint.h>
+#include <string.h>
+
+// ---------------------------------------------------------------------------
+
+// OvlInputKey is the compact encoding of what DispDevice sends to the
+// display driver for one overlay input (disp_input_config), without the
+// pointers: the dirty rects are folded into dirty_hash.
+// It has no padding, so it is compared and hashed as bytes.
+struct OvlInputKey
+{
+    OvlInputKey() { memset(this, 0, sizeof(*this)); }
+
+    uint64_t src_base_addr;
+    uint64_t src_phy_addr;
+    uint64_t dirty_hash;
+
+    uint32_t src_fmt;
+    uint32_t src_pitch;
+    int32_t src_offset_x;
+    int32_t src_offset_y;
+    int32_t src_width;
+    int32_t src_height;
+    int32_t tgt_offset_x;
+    int32_t tgt_offset_y;
+    int32_t tgt_width;
+    int32_t tgt_height;
+    int32_t next_buff_idx;
+    int32_t src_fence_fd;
+    uint32_t frm_sequence;
+    uint32_t identity;
+    uint32_t connected_type;
+    uint32_t ext_sel_layer;
+
+    uint8_t layer_enable;
+    uint8_t buffer_source;
+    uint8_t layer_type;
+    uint8_t layer_rotation;
+    uint8_t is_tdshp;
+    uint8_t alpha_enable;
+    uint8_t alpha;
+    uint8_t yuv_range;
+    uint8_t sur_aen;
+    uint8_t src_alpha;
+    uint8_t dst_alpha;
+    uint8_t security;
+    uint8_t dirty_roi_num;
+    uint8_t reserved[3];
+
+    // hash() is FNV-1a of the 32-bit words
+    uint32_t hash() const;
+
+    bool operator==(const OvlInputKey& rhs) const
+    {
+        return memcmp(this, &rhs, sizeof(*this)) == 0;
+    }
+
+    bool operator!=(const OvlInputKey& rhs) const { return !(*this == rhs); }
+
+    // hashRects() folds an array of int32 (e.g. dirty rects) into a hash
+    static uint64_t hashRects(const int32_t* values, const uint32_t& num);
+};
+
+struct OvlConfigDiffStats
+{
+    OvlConfigDiffStats() : frames(0), full_frames(0), dropped_frames(0), inputs(0), pushed(0) { }
+
+    uint64_t frames;
+
+    // frames which push all inputs, after invalidate()
+    uint64_t full_frames;
+
+    // diffed frames which were not ended, so not known to reach the driver
+    uint64_t dropped_frames;
+
+    // inputs configured by HWC, and the ones which have to be sent
+    uint64_t inputs;
+    uint64_t pushed;
+};
+
+// OvlConfigDiff keeps the config of each overlay input which the display
+// driver has, and tells which inputs of a frame are different from it.
+// The driver applies each disp_input_config by its layer_id, so a frame
+// only needs to carry the changed inputs, packed at the front of input_cfg.
+// An input is unchanged only if all of its config is the same, including
+// the buffer index and the fence, so a release fence is never skipped;
+// in practice these are the disabled inputs, which are most of them.
+// After invalidate(), e.g. a new session or a failed ioctl, the next frame
+// pushes all inputs.
+// The config of a frame is taken by update() before it is sent, so a frame
+// which reaches the driver is closed by endFrame(). A frame which is not,
+// e.g. dropped before its ioctl, is found by the next beginFrame() and
+// handled as invalidate().
+// OvlConfigDiff is not thread-safe; it is used by the thread of the display.
+class OvlConfigDiff
+{
+public:
+    enum
+    {
+        MAX_INPUT_NUM = 32,
+    };
+
+    OvlConfigDiff();
+
+    // invalidate() forgets what the driver has
+    void invalidate();
+
+    // beginFrame() clears the changed inputs of the last frame; if the last
+    // frame was not ended, all inputs of this frame are pushed
+    void beginFrame();
+
+    // endFrame() tells that the frame reached the driver
+    void endFrame() { m_in_frame = false; }
+
+    // update() compares the config of input id (< MAX_INPUT_NUM) with the
+    // one the driver has and takes it; return true if the input has to be sent
+    bool update(const uint32_t& id, const OvlInputKey& key);
+
+    uint32_t getChangedNum() const { return m_changed_num; }
+    uint32_t getChangedId(const uint32_t& idx) const { return m_changed[idx]; }
+
+    const OvlConfigDiffStats& getStats() const { return m_stats; }
+    void resetStats() { m_stats = OvlConfigDiffStats(); }
+
+private:
+    OvlInputKey m_keys[MAX_INPUT_NUM];
+    uint32_t m_hashes[MAX_INPUT_NUM];
+    bool m_valid[MAX_INPUT_NUM];
+
+    // m_full is set by invalidate() and counted by the next beginFrame()
+    bool m_full;
+
+    // m_in_frame is true from beginFrame() until endFrame() or invalidate()
+    bool m_in_frame;
+
+    uint32_t m_changed[MAX_INPUT_NUM];
+    uint32_t m_changed_num;
+
+    OvlConfigDiffStats m_stats;
+};
+
+#endif // HWC_OVL_CONFIG_DIFF_H_
@@ -478,6 +478,109 @@ bool PlatformCommon::isMMLayerValid(const sp<HWCLayer>& layer, int32_t* line)
     *line = __LINE__;
     return true;
 }
+
+bool PlatformCommon::isSWLayerValid(const sp<HWCLayer>& layer, int32_t* line)
+{
+    // SwComposer runs in the thread of AsyncBliterHandler
+    if (!m_config.sw_compose || !m_config.use_async_bliter)
+    {
+        *line = __LINE__;
+        return false;
+    }
+
+    const PrivateHandle& priv_hnd = layer->getPrivateHandle();
+    if ((priv_hnd.usage & (GRALLOC_USAGE_PROTECTED | GRALLOC_USAGE_SECURE)) ||
+        !(priv_hnd.usage & GRALLOC_USAGE_SW_READ_MASK) ||
+        isCompressData(&priv_hnd))
+    {
+        // the CPU cannot read it
+        *line = __LINE__;
+        return false;
+    }
+
+    if (isSWLayerRejected(priv_hnd.alloc_id))
+    {
+        // SwComposer failed to lock it, leave it to GLES
+        *line = __LINE__;
+        return false;
+    }
+
+    switch (priv_hnd.format)
+    {
+        case HAL_PIXEL_FORMAT_RGBA_8888:
+        case HAL_PIXEL_FORMAT_RGBX_8888:
+        case HAL_PIXEL_FORMAT_RGB_565:
+            break;
+
+        case HAL_PIXEL_FORMAT_YV12:
+        case HAL_PIXEL_FORMAT_I420:
+        case HAL_PIXEL_FORMAT_NV12:
+            // SwComposer converts BT.601 narrow range only
+            if ((priv_hnd.ext_info.status & GRALLOC_EXTRA_MASK_YUV_COLORSPACE) !=
+                GRALLOC_EXTRA_BIT_YUV_BT601_NARROW)
+            {
+                *line = __LINE__;
+                return false;
+            }
+            break;
+
+        default:
+            *line = __LINE__;
+            return false;
+    }
+
+    if (layer->getXform() != 0)
+    {
+        // SwComposer does not rotate or flip
+        *line = __LINE__;
+        return false;
+    }
+
+    const int srcLeft = getSrcLeft(layer);
+    const int srcTop = getSrcTop(layer);
+    const int srcWidth = getSrcWidth(layer);
+    const int srcHeight = getSrcHeight(layer);
+    if (srcLeft < 0 || srcTop < 0 ||
+        srcWidth <= 0 || srcHeight <= 0 ||
+        srcLeft + srcWidth > static_cast<int>(priv_hnd.width) ||
+        srcTop + srcHeight > static_cast<int>(priv_hnd.height) ||
+        WIDTH(layer->getDisplayFrame()) <= 0 ||
+        HEIGHT(layer->getDisplayFrame()) <= 0)
+    {
+        *line = __LINE__;
+        return false;
+    }
+
+    *line = __LINE__;
+    return true;
+}
+
+void PlatformCommon::rejectSWLayer(const uint64_t& alloc_id)
+{
+    AutoMutex l(m_sw_reject_lock);
+    if (isSWLayerRejectedLocked(alloc_id))
+        return;
+
+    m_sw_reject_ids[m_sw_reject_num % SW_REJECT_NUM] = alloc_id;
+    ++m_sw_reject_num;
+}
+
+bool PlatformCommon::isSWLayerRejected(const uint64_t& alloc_id) const
+{
+    AutoMutex l(m_sw_reject_lock);
+    return isSWLayerRejectedLocked(alloc_id);
+}
+
+bool PlatformCommon::isSWLayerRejectedLocked(const uint64_t& alloc_id) const
+{
+    const uint32_t num = m_sw_reject_num < SW_REJECT_NUM ? m_sw_reject_num : SW_REJECT_NUM;
+    for (uint32_t i = 0; i < num; ++i)
+    {
+        if (m_sw_reject_ids[i] == alloc_id)
+            return true;
+    }
+    return false;
+}
 #endif // USE_HWC2
 
 size_t PlatformCommon::getLimitedVideoSize()
@@ -533,6 +636,14 @@ PlatformCommon::PlatformConfig::PlatformConfig()
     , blitdev_for_virtual(false)
     , is_support_ext_path_for_virtual(true)
     , is_skip_validate(true)
+    , vali_cache(1)
+    , hrt_cache(true)
+    , hrt_model(false)
+    , dirty_region(true)
+    , sw_compose(false)
+    , sw_compose_threads(2)
+    , ovl_config_diff(false)
+    , frame_trace(0)
     , support_color_transform(false)
     , mdp_scale_percentage(1.f)
     , extend_mdp_capacity(false)
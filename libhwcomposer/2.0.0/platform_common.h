@@ -2,6 +2,7 @@
 #define HWC_PLATFORM_COMMON_H_
 
 #include <utils/Singleton.h>
+#include <utils/Mutex.h>
 #include "hwc2.h"
 
 using namespace android;
@@ -110,7 +111,10 @@ public:
         COND_ALIGNED_SHIFT = 2
     };
 
-    PlatformCommon() { };
+    PlatformCommon()
+        : m_sw_reject_ids()
+        , m_sw_reject_num(0)
+    { };
     virtual ~PlatformCommon() { };
 
     // initOverlay() is used to init overlay related setting
@@ -128,6 +132,17 @@ public:
             PrivateHandle* priv_handle, bool& is_high);
     virtual bool isMMLayerValid(const sp<HWCLayer>& layer, int32_t* line);
 
+    // isSWLayerValid() is used to verify
+    // if a layer rejected by MDP could be composed by SwComposer
+    virtual bool isSWLayerValid(const sp<HWCLayer>& layer, int32_t* line);
+
+    // rejectSWLayer() is called by the bliter thread when SwComposer cannot
+    // read a buffer, isSWLayerValid() rejects the buffer afterwards
+    void rejectSWLayer(const uint64_t& alloc_id);
+
+    // isSWLayerRejected() is used to check if SwComposer failed to read a buffer
+    bool isSWLayerRejected(const uint64_t& alloc_id) const;
+
     // getUltraVideoSize() is used to return the limitation of video resolution
     // when this device connect with the maximum resolution of external display
     size_t getLimitedVideoSize();
@@ -232,6 +247,34 @@ public:
         // 2. If no skip, present -> validate -> present
         bool is_skip_validate;
 
+        // reuse the result of the last validate when the layer states are the same
+        // 0: disable, 1: enable, 2: always validate and check the cached result
+        int vali_cache;
+
+        // reuse the result of the hrt query when the layer configs are the same
+        bool hrt_cache;
+
+        // use the software model of hrt instead of querying the display driver
+        bool hrt_model;
+
+        // track the dirty region of each layer through geometry changes for
+        // partial update, instead of invalidating the full screen
+        bool dirty_region;
+
+        // compose the layers which MDP cannot handle by the CPU in the bliter
+        // thread instead of falling back to GLES; it needs use_async_bliter
+        bool sw_compose;
+
+        // the number of threads of SwComposer, including the bliter thread
+        int sw_compose_threads;
+
+        // send only the overlay input configs which the display driver does
+        // not have yet, instead of all inputs of each frame
+        bool ovl_config_diff;
+
+        // the number of frames to record into the frame trace, 0 for none
+        uint32_t frame_trace;
+
         bool support_color_transform;
 
         double mdp_scale_percentage;
@@ -247,6 +290,15 @@ public:
         bool mdp_support_decompress;
     };
     PlatformConfig m_config;
+
+private:
+    bool isSWLayerRejectedLocked(const uint64_t& alloc_id) const;
+
+    // the alloc ids of the last buffers which SwComposer failed to read
+    enum { SW_REJECT_NUM = 8 };
+    mutable Mutex m_sw_reject_lock;
+    uint64_t m_sw_reject_ids[SW_REJECT_NUM];
+    uint32_t m_sw_reject_num;
 };
 
 #endif // HWC_PLATFORM_H_
@@ -44,17 +44,23 @@
 
 // ---------------------------------------------------------------------------
 
+static int getBufferCount()
+{
+    // 20120818: read board prop to check if need to disable triple buffer
+    char value[PROPERTY_VALUE_MAX];
+    property_get("ro.sf.triplebuf.disable", value, "0");
+    return (atoi(value)) ? (DisplayBufferQueue::NUM_BUFFER_SLOTS - 1) : DisplayBufferQueue::NUM_BUFFER_SLOTS;
+}
+
 DisplayBufferQueue::DisplayBufferQueue(int type)
-    : m_queue_type(type)
+    : m_slot_queue(getBufferCount())
+    , m_queue_type(type)
+    , m_buffer_count(m_slot_queue.getSlotNum())
     , m_is_synchronous(true)
-    , m_frame_counter(0)
+    , m_disp_id(-1)
     , m_last_acquire_idx(INVALID_BUFFER_SLOT)
     , m_listener(NULL)
 {
-    // 20120818: read board prop to check if need to disable triple buffer
-    char value[PROPERTY_VALUE_MAX];
-    property_get("ro.sf.triplebuf.disable", value, "0");
-    m_buffer_count = (atoi(value)) ? (NUM_BUFFER_SLOTS - 1) : NUM_BUFFER_SLOTS;
 
     if (m_queue_type <= QUEUE_TYPE_NONE || m_queue_type > QUEUE_TYPE_OVL)
     {
@@ -86,7 +92,8 @@ DisplayBufferQueue::~DisplayBufferQueue()
 
         if (NULL == slot->out_handle) continue;
 
-        if (slot->release_fence != -1) ::protectedClose(slot->release_fence);
+        const int release_fence = m_slot_queue.getReleaseFence(i);
+        if (release_fence != -1) ::protectedClose(release_fence);
 
         if (slot->out_handle != nullptr)
         {
@@ -108,6 +115,7 @@ status_t DisplayBufferQueue::setBufferParam(BufferParam& param)
     AutoMutex l(m_mutex);
 
     m_buffer_param = param;
+    m_disp_id.store(param.disp_id, std::memory_order_relaxed);
 
     return NO_ERROR;
 }
@@ -187,16 +195,6 @@ status_t DisplayBufferQueue::reallocate(int idx)
     return NO_ERROR;
 }
 
-status_t DisplayBufferQueue::drainQueueLocked()
-{
-    while (m_is_synchronous && !m_queue.isEmpty())
-    {
-        m_dequeue_condition.wait(m_mutex);
-    }
-
-    return NO_ERROR;
-}
-
 status_t DisplayBufferQueue::dequeueBuffer(
     DisplayBuffer* buffer, bool async, bool is_secure)
 {
@@ -204,45 +202,23 @@ status_t DisplayBufferQueue::dequeueBuffer(
 
     AutoMutex l(m_mutex);
 
-    int found = INVALID_BUFFER_SLOT;
-    bool tryAgain = true;
-    while (tryAgain)
+    // the consumer frees slots without taking m_mutex,
+    // the futex of m_slot_queue is woken only if all slots are in use
+    int release_fence = -1;
+    int found = m_slot_queue.dequeue(0, &release_fence);
+    while (found < 0)
     {
-        found = INVALID_BUFFER_SLOT;
-        for (int i = 0; i < m_buffer_count; i++)
+        if (CC_LIKELY(m_buffer_param.dequeue_block))
         {
-            const int state = m_slots[i].state;
-            if (state == BufferSlot::FREE)
-            {
-                // return the oldest of the free buffers to avoid
-                // stalling the producer if possible.
-                if (found < 0)
-                {
-                    found = i;
-                }
-                else if (m_slots[i].frame_num < m_slots[found].frame_num)
-                {
-                    found = i;
-                }
-            }
+            QLOGW("dequeueBuffer: cannot find available buffer, wait...");
+            found = m_slot_queue.dequeue(ms2ns(16), &release_fence);
+            QLOGW("dequeueBuffer: wake up to find available buffer (%s)",
+                    (found < 0) ? "TIME OUT" : "WAKE");
         }
-
-        // if no buffer is found, wait for a buffer to be released
-        tryAgain = (found == INVALID_BUFFER_SLOT);
-        if (tryAgain)
+        else
         {
-            if (CC_LIKELY(m_buffer_param.dequeue_block))
-            {
-                QLOGW("dequeueBuffer: cannot find available buffer, wait...");
-                status_t res = m_dequeue_condition.waitRelative(m_mutex, ms2ns(16));
-                QLOGW("dequeueBuffer: wake up to find available buffer (%s)",
-                        (res == TIMED_OUT) ? "TIME OUT" : "WAKE");
-            }
-            else
-            {
-                QLOGW("dequeueBuffer: cannot find available buffer, exit...");
-                return -EBUSY;
-            }
+            QLOGW("dequeueBuffer: cannot find available buffer, exit...");
+            return -EBUSY;
         }
     }
 
@@ -259,9 +235,6 @@ status_t DisplayBufferQueue::dequeueBuffer(
         m_slots[idx].secure = is_secure;
     }
 
-    // buffer is now in DEQUEUED state
-    m_slots[idx].state = BufferSlot::DEQUEUED;
-
     buffer->out_handle           = m_slots[idx].out_handle;
     buffer->out_ion_fd           = m_slots[idx].out_ion_fd;
     buffer->out_sec_handle       = m_slots[idx].out_sec_handle;
@@ -272,11 +245,10 @@ status_t DisplayBufferQueue::dequeueBuffer(
     buffer->data_info.dst_crop.makeInvalid();
     buffer->data_info.is_sharpen = false;
     buffer->timestamp            = m_slots[idx].timestamp;
-    buffer->frame_num            = m_slots[idx].frame_num;
-    buffer->release_fence        = m_slots[idx].release_fence;
+    buffer->frame_num            = m_slot_queue.getFrameNum(idx);
+    buffer->release_fence        = release_fence;
     buffer->index                = idx;
     buffer->ext_sel_layer        = -1;
-    m_slots[idx].release_fence = -1;
 
     DBG_LOGD("dequeueBuffer (idx=%d, fence=%d) (handle=%p, ion=%d)",
         idx, buffer->release_fence, buffer->out_handle, buffer->out_ion_fd);
@@ -311,104 +283,68 @@ status_t DisplayBufferQueue::queueBuffer(DisplayBuffer* buffer)
                      m_buffer_count, idx);
             return -EINVAL;
         }
-        else if (m_slots[idx].state != BufferSlot::DEQUEUED)
+        else if (m_slot_queue.getState(idx) != SlotQueue<NUM_BUFFER_SLOTS>::STATE_DEQUEUED)
         {
             QLOGE("queueBuffer: slot %d is not owned by the client "
-                     "(state=%d)", idx, m_slots[idx].state);
+                     "(state=%d)", idx, m_slot_queue.getState(idx));
             return -EINVAL;
         }
 
         // if queue not empty, means consumer is slower than producer
         // * in sync mode, may cause lag (but size 1 should be OK for triple buffer)
         // * in async mode, frame drop
-        //bool dump_fifo = false;
-        bool dump_fifo = false;
+        const uint32_t queued_num = m_slot_queue.getQueuedNum();
         if (true == m_is_synchronous)
         {
             // fifo depth 1 is ok for multiple buffer, but 2 would cause lag
-            if (1 < m_queue.size())
+            if (1 < queued_num)
             {
-                QLOGW("queued:%d (lag), type:%d", m_queue.size(), m_queue_type);
-                dump_fifo = true;
+                QLOGW("queued:%u (lag), type:%d", queued_num, m_queue_type);
+                QLOGD("NEW [idx:%d] handle:%p", idx, m_slots[idx].out_handle);
             }
         }
         else
         {
             // frame drop is fifo is not empty
-            if (0 < m_queue.size())
+            if (0 < queued_num)
             {
-                QLOGW("queued:%d (drop frame), type:%d", m_queue.size(), m_queue_type);
-                dump_fifo = true;
+                QLOGW("queued:%u (drop frame), type:%d", queued_num, m_queue_type);
+                QLOGD("NEW [idx:%d] handle:%p", idx, m_slots[idx].out_handle);
             }
         }
 
-        // dump current fifo data, and the new coming one
-        if (true == dump_fifo)
-        {
-            // print from the oldest to the latest queued buffers
-            const BufferSlot *slot = NULL;
-
-            Fifo::const_iterator i(m_queue.begin());
-            while (i != m_queue.end())
-            {
-                slot = &(m_slots[*i]);
-                QLOGD("    [idx:%d] handle:%p", *i, slot->out_handle);
-                ++i;
-            }
-
-            QLOGD("NEW [idx:%d] handle:%p", idx, m_slots[idx].out_handle);
-        }
-
-        if (m_is_synchronous)
-        {
-            // In synchronous mode we queue all buffers in a FIFO
-            m_queue.push_back(idx);
-
-            listener = m_listener;
-        }
-        else
-        {
-            // In asynchronous mode we only keep the most recent buffer.
-            if (m_queue.empty())
-            {
-                m_queue.push_back(idx);
-            }
-            else
-            {
-                Fifo::iterator front(m_queue.begin());
-                // buffer currently queued is freed
-                m_slots[*front].state = BufferSlot::FREE;
-                // and we record the new buffer index in the queued list
-                *front = idx;
-            }
-
-            listener = m_listener;
-        }
-
+        // the slot is filled before it is handed over to the consumer
         m_slots[idx].src_handle           = buffer->src_handle;
         m_slots[idx].data_info.src_crop   = buffer->data_info.src_crop;
         m_slots[idx].data_info.dst_crop   = buffer->data_info.dst_crop;
         m_slots[idx].data_info.is_sharpen = buffer->data_info.is_sharpen;
         m_slots[idx].data_color_range     = buffer->data_color_range;
         m_slots[idx].timestamp            = buffer->timestamp;
-        m_slots[idx].state                = BufferSlot::QUEUED;
-        m_slots[idx].frame_num            = (++m_frame_counter);
         m_slots[idx].alpha_enable         = buffer->alpha_enable;
         m_slots[idx].alpha                = buffer->alpha;
         m_slots[idx].blending             = buffer->blending;
         m_slots[idx].sequence             = buffer->sequence;
-        m_slots[idx].acquire_fence        = buffer->acquire_fence;
         m_slots[idx].is_s3d_slot          = buffer->is_s3d_buffer;
         m_slots[idx].s3d_slot_type        = buffer->s3d_buffer_type;
         m_slots[idx].ext_sel_layer        = buffer->ext_sel_layer;
-        DBG_LOGD("(%d) queueBuffer (idx=%d, fence=%d)",
-            m_buffer_param.disp_id, idx, m_slots[idx].acquire_fence);
 
-        m_dequeue_condition.broadcast();
+        // In synchronous mode we queue all buffers in a FIFO,
+        // in asynchronous mode we only keep the most recent buffer.
+        int dropped_idx = INVALID_BUFFER_SLOT;
+        m_slot_queue.queue(idx, buffer->acquire_fence, !m_is_synchronous, &dropped_idx);
+        if (dropped_idx != INVALID_BUFFER_SLOT)
+        {
+            DBG_LOGD("queueBuffer: drop (idx=%d)", dropped_idx);
+        }
+
+        listener = m_listener;
+
+        DBG_LOGD("(%d) queueBuffer (idx=%d, fence=%d)",
+            m_buffer_param.disp_id, idx, buffer->acquire_fence);
 
         if (DisplayManager::m_profile_level & PROFILE_BLT)
         {
-            HWC_ATRACE_INT(m_client_name.string(), m_queue.size());
+            HWC_ATRACE_INT(m_client_name.string(), m_slot_queue.getQueuedNum());
         }
     }
 
@@ -432,21 +368,15 @@ status_t DisplayBufferQueue::cancelBuffer(int index)
                 m_buffer_count, index);
         return -EINVAL;
     }
-    else if (m_slots[index].state != BufferSlot::DEQUEUED)
+    else if (!m_slot_queue.cancel(index))
     {
         QLOGE("cancelBuffer: slot %d is not owned by the client (state=%d)",
-                index, m_slots[index].state);
+                index, m_slot_queue.getState(index));
         return -EINVAL;
     }
 
     QLOGD("cancelBuffer (%d)", index);
 
-    m_slots[index].state = BufferSlot::FREE;
-    m_slots[index].frame_num = 0;
-    m_slots[index].acquire_fence = -1;
-    m_slots[index].release_fence = -1;
-
-    m_dequeue_condition.broadcast();
     return NO_ERROR;
 }
 
@@ -457,10 +387,9 @@ status_t DisplayBufferQueue::setSynchronousMode(bool enabled)
     if (m_is_synchronous != enabled)
     {
         // drain the queue when changing to asynchronous mode
-        if (!enabled) drainQueueLocked();
+        if (!enabled) m_slot_queue.drain(-1);
 
         m_is_synchronous = enabled;
-        m_dequeue_condition.broadcast();
     }
 
     return NO_ERROR;
@@ -479,21 +408,15 @@ status_t DisplayBufferQueue::acquireBuffer(
 {
     HWC_ATRACE_CALL();
 
-    AutoMutex l(m_mutex);
-
     // check if queue is empty
     // In asynchronous mode the list is guaranteed to be one buffer deep.
     // In synchronous mode we use the oldest buffer.
-    if (!m_queue.empty())
+    int acquire_fence = -1;
+    const int idx = m_slot_queue.acquire(&acquire_fence);
+    if (idx != INVALID_BUFFER_SLOT)
     {
-        Fifo::iterator front(m_queue.begin());
-        int idx = *front;
-
         HWC_ATRACE_BUFFER_INDEX("acquire", idx);
 
-        // buffer is now in ACQUIRED state
-        m_slots[idx].state = BufferSlot::ACQUIRED;
-
         buffer->out_handle           = m_slots[idx].out_handle;
         buffer->out_ion_fd           = m_slots[idx].out_ion_fd;
         buffer->out_sec_handle       = m_slots[idx].out_sec_handle;
@@ -505,19 +428,18 @@ status_t DisplayBufferQueue::acquireBuffer(
         buffer->data_info.dst_crop   = m_slots[idx].data_info.dst_crop;
         buffer->data_info.is_sharpen = m_slots[idx].data_info.is_sharpen;
         buffer->timestamp            = m_slots[idx].timestamp;
-        buffer->frame_num            = m_slots[idx].frame_num;
+        buffer->frame_num            = m_slot_queue.getFrameNum(idx);
         buffer->protect              = m_slots[idx].protect;
         buffer->secure               = m_slots[idx].secure;
         buffer->alpha_enable         = m_slots[idx].alpha_enable;
         buffer->alpha                = m_slots[idx].alpha;
         buffer->blending             = m_slots[idx].blending;
         buffer->sequence             = m_slots[idx].sequence;
-        buffer->acquire_fence        = m_slots[idx].acquire_fence;
+        buffer->acquire_fence        = acquire_fence;
         buffer->index                = idx;
         buffer->is_s3d_buffer        = m_slots[idx].is_s3d_slot;
         buffer->s3d_buffer_type      = m_slots[idx].s3d_slot_type;
         buffer->ext_sel_layer        = m_slots[idx].ext_sel_layer;
-        m_slots[idx].acquire_fence = -1;
 
         DBG_LOGD("acquireBuffer (idx=%d, fence=%d)",
             idx, buffer->acquire_fence);
@@ -525,12 +447,9 @@ status_t DisplayBufferQueue::acquireBuffer(
         // remember last acquire buffer's index
         m_last_acquire_idx = idx;
 
-        m_queue.erase(front);
-        m_dequeue_condition.broadcast();
-
         if (DisplayManager::m_profile_level & PROFILE_TRIG)
         {
-            HWC_ATRACE_INT(m_client_name.string(), m_queue.size());
+            HWC_ATRACE_INT(m_client_name.string(), m_slot_queue.getQueuedNum());
         }
     }
     else
@@ -544,7 +463,7 @@ status_t DisplayBufferQueue::acquireBuffer(
     // wait acquire fence
     if (!async)
     {
-        sp<SyncFence> fence(new SyncFence(m_buffer_param.disp_id));
+        sp<SyncFence> fence(new SyncFence(m_disp_id.load(std::memory_order_relaxed)));
         fence->wait(buffer->acquire_fence, 1000, DEBUG_LOG_TAG);
         buffer->acquire_fence = -1;
     }
@@ -557,8 +476,6 @@ status_t DisplayBufferQueue::releaseBuffer(int index, int fence)
     HWC_ATRACE_CALL();
     HWC_ATRACE_BUFFER_INDEX("release", index);
 
-    AutoMutex l(m_mutex);
-
     if (index == INVALID_BUFFER_SLOT) return -EINVAL;
 
     if (index < 0 || index >= m_buffer_count)
@@ -568,25 +485,22 @@ status_t DisplayBufferQueue::releaseBuffer(int index, int fence)
         return -EINVAL;
     }
 
-    if (m_slots[index].state != BufferSlot::ACQUIRED)
+    int stale_fence = -1;
+    if (!m_slot_queue.release(index, fence, &stale_fence))
     {
         QLOGE("attempted to release buffer(%d) fence:%d with state(%d)",
-            index, fence, m_slots[index].state);
+            index, fence, m_slot_queue.getState(index));
         return -EINVAL;
     }
 
-    m_slots[index].state = BufferSlot::FREE;
-    if (m_slots[index].release_fence != -1)
+    if (stale_fence != -1)
     {
-        QLOGW("release fence existed! buffer(%d) with state(%d) fence:%d",
-            index, m_slots[index].state, fence);
-        ::protectedClose(m_slots[index].release_fence);
+        QLOGW("release fence existed! buffer(%d) fence:%d", index, stale_fence);
+        ::protectedClose(stale_fence);
     }
-    m_slots[index].release_fence = fence;
 
     DBG_LOGD("releaseBuffer (idx=%d, fence=%d)", index, fence);
 
-    m_dequeue_condition.broadcast();
     return NO_ERROR;
 }
 
@@ -7,11 +7,15 @@
 #include <utils/threads.h>
 #include <utils/String8.h>
 
+#include "slot_queue.h"
+
 using namespace android;
 
 // ---------------------------------------------------------------------------
 
 // DisplayBufferQueue manages a pool of display buffer slots.
+// The producer and the consumer never block each other: the slot states and
+// fences are handed over by SlotQueue, and only the producer takes m_mutex.
 class DisplayBufferQueue : public virtual RefBase
 {
 public:
@@ -214,9 +218,6 @@ private:
     // reallocate() is used to reallocate buffer
     status_t reallocate(int idx);
 
-    // drainQueueLocked() drains the buffer queue when change to asynchronous mode
-    status_t drainQueueLocked();
-
     // dumpLocked() is used to dump buffers
     void dumpLocked(int idx);
 
@@ -225,8 +226,7 @@ private:
     struct BufferSlot
     {
         BufferSlot()
-            : state(BufferSlot::FREE)
-            , pool_id(0)
+            : pool_id(0)
             , src_handle(NULL)
             , out_handle(NULL)
             , out_ion_fd(-1)
@@ -237,30 +237,17 @@ private:
             , data_format(0)
             , data_color_range(0)
             , timestamp(0)
-            , frame_num(0)
             , protect(false)
             , secure(false)
             , alpha_enable(0)
             , alpha(0xFF)
             , blending(0)
             , sequence(0)
-            , acquire_fence(-1)
-            , release_fence(-1)
             , is_s3d_slot(false)
             , s3d_slot_type(0)
             , ext_sel_layer(-1)
         { }
 
-        enum BufferState {
-            FREE = 0,
-            DEQUEUED = 1,
-            QUEUED = 2,
-            ACQUIRED = 3
-        };
-
-        // state is the current state of this buffer slot.
-        BufferState state;
-
         // pool_id is used to identify if preallocated buffer pool could be used
         unsigned int pool_id;
 
@@ -298,9 +285,6 @@ private:
         // timestamp is the current timestamp for this buffer
         int64_t timestamp;
 
-        // frame_num is the number of the queued frame for this buffer.
-        uint64_t frame_num;
-
         // protect means if this buffer is protected
         bool protect;
 
@@ -319,14 +303,6 @@ private:
         // sequence is used as a sequence number for profiling latency purpose
         unsigned int sequence;
 
-        // acquire_fence is a fence descriptor
-        // used to signal buffer is filled by producer
-        int acquire_fence;
-
-        // release_fence is a fence descriptor
-        // used to signal buffer is used by consumer
-        int release_fence;
-
         bool is_s3d_slot;
         int s3d_slot_type;
 
@@ -334,8 +310,13 @@ private:
         int ext_sel_layer;
     };
 
+    // m_slots holds the buffers, its data is accessed by the owner
+    // of the slot in m_slot_queue only
     BufferSlot m_slots[NUM_BUFFER_SLOTS];
 
+    // m_slot_queue holds the state, frame number, and fences of the slots
+    SlotQueue<NUM_BUFFER_SLOTS> m_slot_queue;
+
     // m_client_name is used to debug
     String8 m_client_name;
 
@@ -351,22 +332,13 @@ private:
     // m_is_synchronous points whether we're in synchronous mode or not
     bool m_is_synchronous;
 
-    // m_dequeue_condition condition used for dequeueBuffer in synchronous mode
-    mutable Condition m_dequeue_condition;
+    // m_disp_id is m_buffer_param.disp_id for the consumer
+    std::atomic<int> m_disp_id;
 
-    // m_queue is a FIFO of queued buffers used in synchronous mode
-    typedef Vector<int> Fifo;
-    Fifo m_queue;
-
-    // m_mutex is the mutex used to prevent concurrent access to the member
-    // variables of BufferQueue objects. It must be locked whenever the
-    // member variables are accessed.
+    // m_mutex protects the parameters and the listener, which are set and
+    // read by the producer; the consumer never takes it
     mutable Mutex m_mutex;
 
-    // m_frame_counter is the free running counter, incremented for every buffer
-    // queued with the surface Texture.
-    uint64_t m_frame_counter;
-
     // m_last_acquire_idx remembers index of last acquire buffer
     // and it is for dump purpose
     int m_last_acquire_idx;
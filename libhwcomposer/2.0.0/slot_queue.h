@@ -0,0 +1,359 @@
+#ifndef HWC_SLOT_QUEUE_H_
+#define HWC_SLOT_QUEUE_H_
+
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <atomic>
+
+#include "job_queue.h"
+
+// ---------------------------------------------------------------------------
+
+// SlotQueue is the slot state machine of DisplayBufferQueue between exactly
+// one producer thread and exactly one consumer thread:
+//
+//   FREE --dequeue()--> DEQUEUED --queue()--> QUEUED --acquire()--> ACQUIRED
+//     ^                    |                    |                      |
+//     +-----cancel()-------+--(async, replaced)-+------release()-------+
+//
+// Each transition is made by the thread which owns the slot, so the state is
+// published with one atomic store, and the data of a slot (including its
+// fences) is only touched by its owner.
+// Nobody blocks on a mutex. The producer sleeps on a futex only when all
+// slots are in use (full), and drain() only while buffers are queued; the
+// consumer wakes them only on those transitions, and only if someone waits.
+//
+// The fences of a slot are plain fds, SlotQueue never closes them:
+//  - the acquire fence goes from queue() to acquire()
+//  - the release fence goes from release() to the next dequeue()
+//  - the acquire fence of a buffer replaced in async mode becomes the
+//    release fence of its slot, the producer waits for it before reusing it
+template <uint32_t N>
+class SlotQueue
+{
+public:
+    enum STATE
+    {
+        STATE_FREE      = 0,
+        STATE_DEQUEUED  = 1,
+        STATE_QUEUED    = 2,
+        STATE_ACQUIRED  = 3,
+    };
+
+    enum { INVALID_SLOT = -1 };
+
+    explicit SlotQueue(const uint32_t& slot_num = N)
+        : m_slot_num(slot_num < N ? slot_num : N)
+        , m_latest(INVALID_SLOT)
+        , m_event(0)
+        , m_waiters(0)
+        , m_frame_counter(0)
+        , m_wait_count(0)
+        , m_wake_count(0)
+    {
+        for (uint32_t i = 0; i < N; ++i)
+        {
+            m_slots[i].state.store(STATE_FREE, std::memory_order_relaxed);
+            m_slots[i].frame_num = 0;
+            m_slots[i].acquire_fence = -1;
+            m_slots[i].release_fence = -1;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////
+    // PRODUCER INTERFACE
+
+    // dequeue() gets the oldest free slot and its release fence.
+    // It waits up to timeout_ns (< 0 for no limit, 0 to return at once)
+    // for a slot to be freed; return the slot index, or -EBUSY
+    int dequeue(const int64_t& timeout_ns, int* release_fence)
+    {
+        int idx = tryDequeue(release_fence);
+        if (idx >= 0 || timeout_ns == 0)
+            return idx >= 0 ? idx : -EBUSY;
+
+        const int64_t deadline = timeout_ns > 0 ? getNs() + timeout_ns : 0;
+        while (true)
+        {
+            const uint32_t event = m_event.load();
+            m_waiters.fetch_add(1);
+
+            // check again after announcing the waiter, a slot freed before
+            // this point is seen here, and one freed after it wakes us up
+            idx = tryDequeue(release_fence);
+            if (idx >= 0)
+            {
+                m_waiters.fetch_sub(1);
+                return idx;
+            }
+
+            int64_t left = -1;
+            if (timeout_ns > 0)
+            {
+                left = deadline - getNs();
+                if (left <= 0)
+                {
+                    m_waiters.fetch_sub(1);
+                    return -EBUSY;
+                }
+            }
+            waitEvent(event, left);
+            m_waiters.fetch_sub(1);
+        }
+    }
+
+    // queue() hands a dequeued slot to the consumer with its acquire fence.
+    // In async mode the buffer which is not acquired yet is replaced, and its
+    // slot index is returned in dropped_idx (or INVALID_SLOT).
+    // The slot data must be filled before queue().
+    // return false if the slot is not dequeued
+    bool queue(const int& idx, const int& acquire_fence, const bool& async, int* dropped_idx)
+    {
+        *dropped_idx = INVALID_SLOT;
+        if (!isValid(idx) || getState(idx) != STATE_DEQUEUED)
+            return false;
+
+        Slot& slot = m_slots[idx];
+        slot.acquire_fence = acquire_fence;
+        slot.frame_num = ++m_frame_counter;
+        slot.state.store(STATE_QUEUED, std::memory_order_release);
+
+        if (!async)
+        {
+            // the ring holds all slots, it is never full
+            m_fifo.push(idx);
+            return true;
+        }
+
+        const int dropped = m_latest.exchange(idx, std::memory_order_acq_rel);
+        if (dropped != INVALID_SLOT)
+        {
+            // the producer may still be writing the dropped buffer,
+            // wait for it before the buffer is written again
+            Slot& dropped_slot = m_slots[dropped];
+            dropped_slot.release_fence = dropped_slot.acquire_fence;
+            dropped_slot.acquire_fence = -1;
+            *dropped_idx = dropped;
+            setFree(dropped);
+        }
+        return true;
+    }
+
+    // cancel() gives a dequeued slot back without queuing it
+    bool cancel(const int& idx)
+    {
+        if (!isValid(idx) || getState(idx) != STATE_DEQUEUED)
+            return false;
+
+        Slot& slot = m_slots[idx];
+        slot.frame_num = 0;
+        slot.acquire_fence = -1;
+        slot.release_fence = -1;
+        setFree(idx);
+        return true;
+    }
+
+    // drain() waits until the consumer acquires all queued slots,
+    // up to timeout_ns (< 0 for no limit); return false on timeout
+    bool drain(const int64_t& timeout_ns)
+    {
+        const int64_t deadline = timeout_ns > 0 ? getNs() + timeout_ns : 0;
+        while (true)
+        {
+            const uint32_t event = m_event.load();
+            m_waiters.fetch_add(1);
+            if (getQueuedNum() == 0)
+            {
+                m_waiters.fetch_sub(1);
+                return true;
+            }
+
+            int64_t left = -1;
+            if (timeout_ns >= 0)
+            {
+                left = timeout_ns > 0 ? deadline - getNs() : 0;
+                if (left <= 0)
+                {
+                    m_waiters.fetch_sub(1);
+                    return false;
+                }
+            }
+            waitEvent(event, left);
+            m_waiters.fetch_sub(1);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////
+    // CONSUMER INTERFACE
+
+    // acquire() takes the oldest queued slot and its acquire fence;
+    // return the slot index, or INVALID_SLOT if nothing is queued
+    int acquire(int* acquire_fence)
+    {
+        // the async buffer is older than any buffer queued after
+        // switching back to sync mode
+        int idx = m_latest.exchange(INVALID_SLOT, std::memory_order_acq_rel);
+        if (idx == INVALID_SLOT && !m_fifo.pop(&idx))
+            return INVALID_SLOT;
+
+        Slot& slot = m_slots[idx];
+        *acquire_fence = slot.acquire_fence;
+        slot.acquire_fence = -1;
+        slot.state.store(STATE_ACQUIRED, std::memory_order_release);
+
+        // wake up drain() when the queue becomes empty
+        if (getQueuedNum() == 0)
+            notify();
+        return idx;
+    }
+
+    // release() gives an acquired slot back with its release fence.
+    // The release fence which is not taken by dequeue() yet is returned in
+    // stale_fence (or -1), the caller must close it.
+    // return false if the slot is not acquired
+    bool release(const int& idx, const int& release_fence, int* stale_fence)
+    {
+        *stale_fence = -1;
+        if (!isValid(idx) || getState(idx) != STATE_ACQUIRED)
+            return false;
+
+        Slot& slot = m_slots[idx];
+        *stale_fence = slot.release_fence;
+        slot.release_fence = release_fence;
+        setFree(idx);
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////
+
+    STATE getState(const int& idx) const
+    {
+        return static_cast<STATE>(m_slots[idx].state.load(std::memory_order_acquire));
+    }
+
+    // getFrameNum() is read by the owner of the slot
+    uint64_t getFrameNum(const int& idx) const { return m_slots[idx].frame_num; }
+
+    // getReleaseFence() is read by the owner of a free slot, e.g. on teardown
+    int getReleaseFence(const int& idx) const { return m_slots[idx].release_fence; }
+
+    // getQueuedNum() is a snapshot for logs and profiling
+    uint32_t getQueuedNum() const
+    {
+        return m_fifo.size() + (m_latest.load(std::memory_order_acquire) != INVALID_SLOT ? 1 : 0);
+    }
+
+    uint32_t getSlotNum() const { return m_slot_num; }
+
+    // the number of futex waits and wakes, for profiling
+    uint32_t getWaitCount() const { return m_wait_count.load(std::memory_order_relaxed); }
+    uint32_t getWakeCount() const { return m_wake_count.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot
+    {
+        std::atomic<uint32_t> state;
+        uint64_t frame_num;
+        int acquire_fence;
+        int release_fence;
+    };
+
+    static int64_t getNs()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+    }
+
+    bool isValid(const int& idx) const
+    {
+        return idx >= 0 && static_cast<uint32_t>(idx) < m_slot_num;
+    }
+
+    int tryDequeue(int* release_fence)
+    {
+        // only the producer moves a slot out of FREE,
+        // so the slot found here stays free
+        int found = INVALID_SLOT;
+        for (uint32_t i = 0; i < m_slot_num; ++i)
+        {
+            if (getState(i) != STATE_FREE)
+                continue;
+
+            // return the oldest of the free buffers to avoid
+            // stalling the producer if possible.
+            if (found == INVALID_SLOT || m_slots[i].frame_num < m_slots[found].frame_num)
+                found = static_cast<int>(i);
+        }
+
+        if (found == INVALID_SLOT)
+            return INVALID_SLOT;
+
+        Slot& slot = m_slots[found];
+        slot.state.store(STATE_DEQUEUED, std::memory_order_relaxed);
+        *release_fence = slot.release_fence;
+        slot.release_fence = -1;
+        return found;
+    }
+
+    void setFree(const int& idx)
+    {
+        m_slots[idx].state.store(STATE_FREE, std::memory_order_release);
+        notify();
+    }
+
+    void notify()
+    {
+        m_event.fetch_add(1);
+        if (m_waiters.load() == 0)
+            return;
+
+        m_wake_count.fetch_add(1, std::memory_order_relaxed);
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_event), FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+    }
+
+    void waitEvent(const uint32_t& event, const int64_t& timeout_ns)
+    {
+        struct timespec ts;
+        struct timespec* timeout = NULL;
+        if (timeout_ns >= 0)
+        {
+            ts.tv_sec = timeout_ns / 1000000000LL;
+            ts.tv_nsec = timeout_ns % 1000000000LL;
+            timeout = &ts;
+        }
+
+        m_wait_count.fetch_add(1, std::memory_order_relaxed);
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_event), FUTEX_WAIT_PRIVATE, event, timeout, NULL, 0);
+    }
+
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex needs a plain 32-bit word");
+
+    const uint32_t m_slot_num;
+
+    Slot m_slots[N];
+
+    // m_fifo is the queued slots in sync mode,
+    // m_latest is the only queued slot in async mode
+    SpscRing<int, (N <= 4 ? 4 : 8)> m_fifo;
+    static_assert(N <= 8, "SlotQueue holds up to 8 slots");
+    std::atomic<int> m_latest;
+
+    // m_event is bumped on every free or empty transition, the futex word
+    std::atomic<uint32_t> m_event;
+    std::atomic<uint32_t> m_waiters;
+
+    // m_frame_counter is written by the producer only
+    uint64_t m_frame_counter;
+
+    std::atomic<uint32_t> m_wait_count;
+    std::atomic<uint32_t> m_wake_count;
+};
+
+#endif // HWC_SLOT_QUEUE_H_
@@ -0,0 +1,799 @@
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SW_COMPOSER_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SW_COMPOSER_SSE2
+#endif
+
+#include "sw_composer.h"
+
+// ---------------------------------------------------------------------------
+
+// BT.601 narrow range to RGB in 6-bit fixed point, as
+//   Y' = (Y * 0x0101 * YG) >> 16 + YGB    (1.164 * 64 * (Y - 16) + 32)
+//   R = (Y' + VR * (Cr - 128)) >> 6
+//   G = (Y' + UG * (Cb - 128) + VG * (Cr - 128)) >> 6
+//   B = (Y' + UB * (Cb - 128)) >> 6
+// every sum saturates to int16, so the SIMD kernels give the same pixels
+enum
+{
+    YUV_YG  = 18997,
+    YUV_YGB = -1160,
+    YUV_VR  = 102,
+    YUV_UG  = -25,
+    YUV_VG  = -52,
+    YUV_UB  = 129,
+};
+
+static inline uint32_t div255(const uint32_t& x)
+{
+    // round(x / 255) for x <= 255 * 255
+    const uint32_t t = x + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+static inline int32_t sat16(const int32_t& v)
+{
+    return v < -32768 ? -32768 : (v > 32767 ? 32767 : v);
+}
+
+static inline uint32_t clampShift6(const int32_t& v)
+{
+    const int32_t c = v >> 6;
+    return c < 0 ? 0 : (c > 255 ? 255 : static_cast<uint32_t>(c));
+}
+
+static inline uint32_t getChannel(const uint32_t& pixel, const int& c)
+{
+    return (pixel >> (c * 8)) & 0xFF;
+}
+
+// ---------------------------------------------------------------------------
+// scalar kernels, they also handle the tails of the SIMD kernels
+
+static void convertRGBXC(const uint32_t* src, uint32_t* dst, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        dst[i] = src[i] | 0xFF000000u;
+    }
+}
+
+static void convertRGB565C(const uint16_t* src, uint32_t* dst, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        const uint32_t p = src[i];
+        const uint32_t r5 = p >> 11;
+        const uint32_t g6 = (p >> 5) & 0x3F;
+        const uint32_t b5 = p & 0x1F;
+        const uint32_t r = (r5 << 3) | (r5 >> 2);
+        const uint32_t g = (g6 << 2) | (g6 >> 4);
+        const uint32_t b = (b5 << 3) | (b5 >> 2);
+        dst[i] = r | (g << 8) | (b << 16) | 0xFF000000u;
+    }
+}
+
+static void convertYUV420C(const uint8_t* y, const uint8_t* cb, const uint8_t* cr,
+    uint32_t* dst, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        const int32_t yy = static_cast<int32_t>((y[i] * 0x0101u * YUV_YG) >> 16) + YUV_YGB;
+        const int32_t u = cb[i >> 1] - 128;
+        const int32_t v = cr[i >> 1] - 128;
+        const uint32_t r = clampShift6(sat16(yy + v * YUV_VR));
+        const uint32_t g = clampShift6(sat16(sat16(yy + u * YUV_UG) + v * YUV_VG));
+        const uint32_t b = clampShift6(sat16(yy + u * YUV_UB));
+        dst[i] = r | (g << 8) | (b << 16) | 0xFF000000u;
+    }
+}
+
+static void blendC(const uint32_t* src, uint32_t* dst, uint32_t n,
+    uint32_t blending, uint8_t plane_alpha)
+{
+    if (blending == SW_BLEND_NONE && plane_alpha == 0xFF)
+    {
+        convertRGBXC(src, dst, n);
+        return;
+    }
+
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        const uint32_t s = src[i];
+        const uint32_t d = dst[i];
+        uint32_t out = 0;
+
+        if (blending == SW_BLEND_PREMULT)
+        {
+            // out = src * plane_alpha + dst * (1 - src_alpha * plane_alpha)
+            uint32_t sc[4];
+            for (int c = 0; c < 4; ++c)
+            {
+                sc[c] = getChannel(s, c);
+                if (plane_alpha != 0xFF)
+                    sc[c] = div255(sc[c] * plane_alpha);
+            }
+
+            const uint32_t inv = 255 - sc[3];
+            for (int c = 0; c < 4; ++c)
+            {
+                const uint32_t v = sc[c] + div255(getChannel(d, c) * inv);
+                out |= (v > 255 ? 255 : v) << (c * 8);
+            }
+        }
+        else
+        {
+            // coverage, and none with plane alpha, which is coverage
+            // of an opaque source:
+            // out = src * a + dst * (1 - a), out_alpha = a + dst_alpha * (1 - a)
+            uint32_t a = plane_alpha;
+            if (blending == SW_BLEND_COVERAGE)
+            {
+                a = getChannel(s, 3);
+                if (plane_alpha != 0xFF)
+                    a = div255(a * plane_alpha);
+            }
+
+            const uint32_t inv = 255 - a;
+            const uint32_t s_opaque = s | 0xFF000000u;
+            for (int c = 0; c < 4; ++c)
+            {
+                out |= div255(getChannel(s_opaque, c) * a + getChannel(d, c) * inv) << (c * 8);
+            }
+        }
+
+        dst[i] = out;
+    }
+}
+
+static const SwKernels s_kernels_c =
+{
+    "c",
+    convertRGBXC,
+    convertRGB565C,
+    convertYUV420C,
+    blendC,
+};
+
+// ---------------------------------------------------------------------------
+
+#if defined(SW_COMPOSER_NEON)
+
+static inline uint8x8_t div255Neon(const uint16x8_t& x)
+{
+    const uint16x8_t t = vaddq_u16(x, vdupq_n_u16(128));
+    return vshrn_n_u16(vaddq_u16(t, vshrq_n_u16(t, 8)), 8);
+}
+
+static void convertRGBXNeon(const uint32_t* src, uint32_t* dst, uint32_t n)
+{
+    const uint32x4_t alpha = vdupq_n_u32(0xFF000000u);
+    uint32_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        vst1q_u32(dst + i, vorrq_u32(vld1q_u32(src + i), alpha));
+    }
+    convertRGBXC(src + i, dst + i, n - i);
+}
+
+static void convertRGB565Neon(const uint16_t* src, uint32_t* dst, uint32_t n)
+{
+    uint32_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const uint16x8_t p = vld1q_u16(src + i);
+        const uint16x8_t r5 = vshrq_n_u16(p, 11);
+        const uint16x8_t g6 = vandq_u16(vshrq_n_u16(p, 5), vdupq_n_u16(0x3F));
+        const uint16x8_t b5 = vandq_u16(p, vdupq_n_u16(0x1F));
+
+        uint8x8x4_t out;
+        out.val[0] = vmovn_u16(vorrq_u16(vshlq_n_u16(r5, 3), vshrq_n_u16(r5, 2)));
+        out.val[1] = vmovn_u16(vorrq_u16(vshlq_n_u16(g6, 2), vshrq_n_u16(g6, 4)));
+        out.val[2] = vmovn_u16(vorrq_u16(vshlq_n_u16(b5, 3), vshrq_n_u16(b5, 2)));
+        out.val[3] = vdup_n_u8(0xFF);
+        vst4_u8(reinterpret_cast<uint8_t*>(dst + i), out);
+    }
+    convertRGB565C(src + i, dst + i, n - i);
+}
+
+static inline int16x8_t loadChromaNeon(const uint8_t* c)
+{
+    // 4 samples for 8 pixels, each sample is used twice
+    uint32_t c4;
+    memcpy(&c4, c, sizeof(c4));
+    const uint8x8_t c8 = vreinterpret_u8_u32(vdup_n_u32(c4));
+    const uint8x8_t c8x2 = vzip_u8(c8, c8).val[0];
+    return vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(c8x2)), vdupq_n_s16(128));
+}
+
+static void convertYUV420Neon(const uint8_t* y, const uint8_t* cb, const uint8_t* cr,
+    uint32_t* dst, uint32_t n)
+{
+    uint32_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        uint16x8_t y16 = vmovl_u8(vld1_u8(y + i));
+        y16 = vorrq_u16(y16, vshlq_n_u16(y16, 8));
+        const uint32x4_t lo = vmull_u16(vget_low_u16(y16), vdup_n_u16(YUV_YG));
+        const uint32x4_t hi = vmull_u16(vget_high_u16(y16), vdup_n_u16(YUV_YG));
+        const int16x8_t yy = vaddq_s16(
+            vreinterpretq_s16_u16(vcombine_u16(vshrn_n_u32(lo, 16), vshrn_n_u32(hi, 16))),
+            vdupq_n_s16(YUV_YGB));
+
+        const int16x8_t u = loadChromaNeon(cb + i / 2);
+        const int16x8_t v = loadChromaNeon(cr + i / 2);
+
+        uint8x8x4_t out;
+        out.val[0] = vqshrun_n_s16(vqaddq_s16(yy, vmulq_n_s16(v, YUV_VR)), 6);
+        out.val[1] = vqshrun_n_s16(
+            vqaddq_s16(vqaddq_s16(yy, vmulq_n_s16(u, YUV_UG)), vmulq_n_s16(v, YUV_VG)), 6);
+        out.val[2] = vqshrun_n_s16(vqaddq_s16(yy, vmulq_n_s16(u, YUV_UB)), 6);
+        out.val[3] = vdup_n_u8(0xFF);
+        vst4_u8(reinterpret_cast<uint8_t*>(dst + i), out);
+    }
+    convertYUV420C(y + i, cb + i / 2, cr + i / 2, dst + i, n - i);
+}
+
+static void blendNeon(const uint32_t* src, uint32_t* dst, uint32_t n,
+    uint32_t blending, uint8_t plane_alpha)
+{
+    if (blending == SW_BLEND_NONE && plane_alpha == 0xFF)
+    {
+        convertRGBXNeon(src, dst, n);
+        return;
+    }
+
+    const uint8x8_t pa = vdup_n_u8(plane_alpha);
+    uint32_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        uint8x8x4_t s = vld4_u8(reinterpret_cast<const uint8_t*>(src + i));
+        const uint8x8x4_t d = vld4_u8(reinterpret_cast<const uint8_t*>(dst + i));
+        uint8x8x4_t out;
+
+        if (blending == SW_BLEND_PREMULT)
+        {
+            if (plane_alpha != 0xFF)
+            {
+                for (int c = 0; c < 4; ++c)
+                {
+                    s.val[c] = div255Neon(vmull_u8(s.val[c], pa));
+                }
+            }
+
+            const uint8x8_t inv = vmvn_u8(s.val[3]);
+            for (int c = 0; c < 4; ++c)
+            {
+                out.val[c] = vqadd_u8(s.val[c], div255Neon(vmull_u8(d.val[c], inv)));
+            }
+        }
+        else
+        {
+            uint8x8_t a = pa;
+            if (blending == SW_BLEND_COVERAGE)
+            {
+                a = plane_alpha != 0xFF ? div255Neon(vmull_u8(s.val[3], pa)) : s.val[3];
+            }
+
+            const uint8x8_t inv = vmvn_u8(a);
+            s.val[3] = vdup_n_u8(0xFF);
+            for (int c = 0; c < 4; ++c)
+            {
+                out.val[c] = div255Neon(vmlal_u8(vmull_u8(s.val[c], a), d.val[c], inv));
+            }
+        }
+
+        vst4_u8(reinterpret_cast<uint8_t*>(dst + i), out);
+    }
+    blendC(src + i, dst + i, n - i, blending, plane_alpha);
+}
+
+static const SwKernels s_kernels_simd =
+{
+    "neon",
+    convertRGBXNeon,
+    convertRGB565Neon,
+    convertYUV420Neon,
+    blendNeon,
+};
+
+#elif defined(SW_COMPOSER_SSE2)
+
+static inline __m128i div255Sse2(const __m128i& x)
+{
+    const __m128i t = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+// the alpha of each of the 2 pixels in 16-bit lanes to all 4 lanes of the pixel
+static inline __m128i broadcastAlphaSse2(const __m128i& x)
+{
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+// store 8 pixels from R, G and B in 16-bit lanes (0 to 255) with alpha 0xFF
+static inline void storeRGBSse2(const __m128i& r, const __m128i& g, const __m128i& b, uint32_t* dst)
+{
+    const __m128i rg = _mm_unpacklo_epi8(_mm_packus_epi16(r, r), _mm_packus_epi16(g, g));
+    const __m128i ba = _mm_unpacklo_epi8(_mm_packus_epi16(b, b), _mm_set1_epi8(-1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi16(rg, ba));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4), _mm_unpackhi_epi16(rg, ba));
+}
+
+static void convertRGBXSse2(const uint32_t* src, uint32_t* dst, uint32_t n)
+{
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+    uint32_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_or_si128(p, alpha));
+    }
+    convertRGBXC(src + i, dst + i, n - i);
+}
+
+static void convertRGB565Sse2(const uint16_t* src, uint32_t* dst, uint32_t n)
+{
+    const __m128i mask6 = _mm_set1_epi16(0x3F);
+    const __m128i mask5 = _mm_set1_epi16(0x1F);
+    uint32_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i r5 = _mm_srli_epi16(p, 11);
+        const __m128i g6 = _mm_and_si128(_mm_srli_epi16(p, 5), mask6);
+        const __m128i b5 = _mm_and_si128(p, mask5);
+        storeRGBSse2(
+            _mm_or_si128(_mm_slli_epi16(r5, 3), _mm_srli_epi16(r5, 2)),
+            _mm_or_si128(_mm_slli_epi16(g6, 2), _mm_srli_epi16(g6, 4)),
+            _mm_or_si128(_mm_slli_epi16(b5, 3), _mm_srli_epi16(b5, 2)),
+            dst + i);
+    }
+    convertRGB565C(src + i, dst + i, n - i);
+}
+
+static inline __m128i loadChromaSse2(const uint8_t* c)
+{
+    // 4 samples for 8 pixels, each sample is used twice
+    int32_t c4;
+    memcpy(&c4, c, sizeof(c4));
+    const __m128i c8 = _mm_cvtsi32_si128(c4);
+    const __m128i c8x2 = _mm_unpacklo_epi8(c8, c8);
+    return _mm_sub_epi16(_mm_unpacklo_epi8(c8x2, _mm_setzero_si128()), _mm_set1_epi16(128));
+}
+
+static void convertYUV420Sse2(const uint8_t* y, const uint8_t* cb, const uint8_t* cr,
+    uint32_t* dst, uint32_t n)
+{
+    uint32_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m128i y8 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(y + i));
+        const __m128i yy = _mm_add_epi16(
+            _mm_mulhi_epu16(_mm_unpacklo_epi8(y8, y8), _mm_set1_epi16(YUV_YG)),
+            _mm_set1_epi16(YUV_YGB));
+
+        const __m128i u = loadChromaSse2(cb + i / 2);
+        const __m128i v = loadChromaSse2(cr + i / 2);
+
+        const __m128i r = _mm_adds_epi16(yy, _mm_mullo_epi16(v, _mm_set1_epi16(YUV_VR)));
+        const __m128i g = _mm_adds_epi16(
+            _mm_adds_epi16(yy, _mm_mullo_epi16(u, _mm_set1_epi16(YUV_UG))),
+            _mm_mullo_epi16(v, _mm_set1_epi16(YUV_VG)));
+        const __m128i b = _mm_adds_epi16(yy, _mm_mullo_epi16(u, _mm_set1_epi16(YUV_UB)));
+        storeRGBSse2(_mm_srai_epi16(r, 6), _mm_srai_epi16(g, 6), _mm_srai_epi16(b, 6), dst + i);
+    }
+    convertYUV420C(y + i, cb + i / 2, cr + i / 2, dst + i, n - i);
+}
+
+static void blendSse2(const uint32_t* src, uint32_t* dst, uint32_t n,
+    uint32_t blending, uint8_t plane_alpha)
+{
+    if (blending == SW_BLEND_NONE && plane_alpha == 0xFF)
+    {
+        convertRGBXSse2(src, dst, n);
+        return;
+    }
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i c255 = _mm_set1_epi16(255);
+    const __m128i pa = _mm_set1_epi16(plane_alpha);
+    const __m128i alpha_lanes = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+    uint32_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i s_lo = _mm_unpacklo_epi8(s, zero);
+        __m128i s_hi = _mm_unpackhi_epi8(s, zero);
+        const __m128i d_lo = _mm_unpacklo_epi8(d, zero);
+        const __m128i d_hi = _mm_unpackhi_epi8(d, zero);
+        __m128i out;
+
+        if (blending == SW_BLEND_PREMULT)
+        {
+            if (plane_alpha != 0xFF)
+            {
+                s_lo = div255Sse2(_mm_mullo_epi16(s_lo, pa));
+                s_hi = div255Sse2(_mm_mullo_epi16(s_hi, pa));
+            }
+
+            const __m128i inv_lo = _mm_sub_epi16(c255, broadcastAlphaSse2(s_lo));
+            const __m128i inv_hi = _mm_sub_epi16(c255, broadcastAlphaSse2(s_hi));
+            const __m128i o_lo = div255Sse2(_mm_mullo_epi16(d_lo, inv_lo));
+            const __m128i o_hi = div255Sse2(_mm_mullo_epi16(d_hi, inv_hi));
+            out = _mm_adds_epu8(_mm_packus_epi16(s_lo, s_hi), _mm_packus_epi16(o_lo, o_hi));
+        }
+        else
+        {
+            __m128i a_lo = pa;
+            __m128i a_hi = pa;
+            if (blending == SW_BLEND_COVERAGE)
+            {
+                a_lo = broadcastAlphaSse2(s_lo);
+                a_hi = broadcastAlphaSse2(s_hi);
+                if (plane_alpha != 0xFF)
+                {
+                    a_lo = div255Sse2(_mm_mullo_epi16(a_lo, pa));
+                    a_hi = div255Sse2(_mm_mullo_epi16(a_hi, pa));
+                }
+            }
+
+            s_lo = _mm_or_si128(s_lo, alpha_lanes);
+            s_hi = _mm_or_si128(s_hi, alpha_lanes);
+            const __m128i o_lo = div255Sse2(_mm_add_epi16(
+                _mm_mullo_epi16(s_lo, a_lo), _mm_mullo_epi16(d_lo, _mm_sub_epi16(c255, a_lo))));
+            const __m128i o_hi = div255Sse2(_mm_add_epi16(
+                _mm_mullo_epi16(s_hi, a_hi), _mm_mullo_epi16(d_hi, _mm_sub_epi16(c255, a_hi))));
+            out = _mm_packus_epi16(o_lo, o_hi);
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), out);
+    }
+    blendC(src + i, dst + i, n - i, blending, plane_alpha);
+}
+
+static const SwKernels s_kernels_simd =
+{
+    "sse2",
+    convertRGBXSse2,
+    convertRGB565Sse2,
+    convertYUV420Sse2,
+    blendSse2,
+};
+
+#endif
+
+const SwKernels& getSwKernels(const bool& use_simd)
+{
+#if defined(SW_COMPOSER_NEON) || defined(SW_COMPOSER_SSE2)
+    if (use_simd)
+        return s_kernels_simd;
+#else
+    (void)use_simd;
+#endif
+    return s_kernels_c;
+}
+
+// ---------------------------------------------------------------------------
+
+static inline int32_t getWidth(const hwc_rect_t& rect) { return rect.right - rect.left; }
+static inline int32_t getHeight(const hwc_rect_t& rect) { return rect.bottom - rect.top; }
+
+// the source coordinate of the center of pixel i of the scaled length
+static inline int32_t getSampleOffset(const int32_t& i, const int32_t& src_len, const int32_t& dst_len)
+{
+    return static_cast<int32_t>((static_cast<int64_t>(2 * i + 1) * src_len) / (2 * dst_len));
+}
+
+static bool isLayerValid(const SwLayer& layer)
+{
+    const SwBuffer& src = layer.src;
+    if (!SwComposer::isFormatSupported(src.format) || src.plane[0] == NULL)
+        return false;
+
+    if (src.format == SW_FORMAT_YUV_420 &&
+        (src.plane[1] == NULL || src.plane[2] == NULL ||
+         (src.chroma_step != 1 && src.chroma_step != 2)))
+        return false;
+
+    if (layer.blending > SW_BLEND_COVERAGE)
+        return false;
+
+    const hwc_rect_t& crop = layer.src_crop;
+    if (crop.left < 0 || crop.top < 0 ||
+        crop.right > static_cast<int32_t>(src.width) ||
+        crop.bottom > static_cast<int32_t>(src.height) ||
+        getWidth(crop) <= 0 || getHeight(crop) <= 0)
+        return false;
+
+    return getWidth(layer.display_frame) > 0 && getHeight(layer.display_frame) > 0;
+}
+
+SwComposer::SwComposer(const uint32_t& thread_num, const bool& use_simd)
+    : m_kernels(getSwKernels(use_simd))
+    , m_next_tile(0)
+    , m_generation(0)
+    , m_running(0)
+    , m_exit(false)
+{
+    uint32_t num = thread_num;
+    if (num < 1)
+        num = 1;
+    if (num > MAX_THREAD_NUM)
+        num = MAX_THREAD_NUM;
+
+    m_frame.layers = NULL;
+    m_frame.num = 0;
+    m_frame.tiles_x = 0;
+    m_frame.tile_num = 0;
+    m_scratch.resize(num);
+    for (uint32_t i = 1; i < num; ++i)
+    {
+        m_threads.push_back(std::thread(&SwComposer::threadLoop, this, i));
+    }
+}
+
+SwComposer::~SwComposer()
+{
+    {
+        std::lock_guard<std::mutex> l(m_lock);
+        m_exit = true;
+    }
+    m_start_cond.notify_all();
+
+    for (size_t i = 0; i < m_threads.size(); ++i)
+    {
+        m_threads[i].join();
+    }
+}
+
+bool SwComposer::isFormatSupported(const uint32_t& format)
+{
+    switch (format)
+    {
+        case SW_FORMAT_RGBA_8888:
+        case SW_FORMAT_RGBX_8888:
+        case SW_FORMAT_RGB_565:
+        case SW_FORMAT_YUV_420:
+            return true;
+    }
+    return false;
+}
+
+bool SwComposer::compose(const SwLayer* layers, const size_t& num,
+    const SwBuffer& dst, const hwc_rect_t& bounds)
+{
+    if (dst.format != SW_FORMAT_RGBA_8888 || dst.plane[0] == NULL ||
+        bounds.left < 0 || bounds.top < 0 ||
+        bounds.right > static_cast<int32_t>(dst.width) ||
+        bounds.bottom > static_cast<int32_t>(dst.height) ||
+        getWidth(bounds) <= 0 || getHeight(bounds) <= 0)
+        return false;
+
+    if (num > 0 && layers == NULL)
+        return false;
+
+    uint32_t max_src_width = 0;
+    for (size_t i = 0; i < num; ++i)
+    {
+        if (!isLayerValid(layers[i]))
+            return false;
+
+        const uint32_t width = static_cast<uint32_t>(getWidth(layers[i].src_crop));
+        if (width > max_src_width)
+            max_src_width = width;
+    }
+
+    // a source span is one pixel longer when it starts at an odd pixel of
+    // YUV 4:2:0, which is converted from the even pixel before it
+    for (size_t i = 0; i < m_scratch.size(); ++i)
+    {
+        Scratch& scratch = m_scratch[i];
+        if (scratch.conv.size() < max_src_width + 2)
+        {
+            scratch.conv.resize(max_src_width + 2);
+            scratch.cb.resize(max_src_width / 2 + 2);
+            scratch.cr.resize(max_src_width / 2 + 2);
+        }
+        scratch.sample.resize(TILE_WIDTH);
+    }
+
+    const uint32_t tiles_x = (getWidth(bounds) + TILE_WIDTH - 1) / TILE_WIDTH;
+    const uint32_t tiles_y = (getHeight(bounds) + TILE_HEIGHT - 1) / TILE_HEIGHT;
+
+    m_frame.layers = layers;
+    m_frame.num = num;
+    m_frame.dst = dst;
+    m_frame.bounds = bounds;
+    m_frame.tiles_x = tiles_x;
+    m_frame.tile_num = tiles_x * tiles_y;
+    m_next_tile.store(0, std::memory_order_relaxed);
+
+    if (m_threads.empty() || m_frame.tile_num == 1)
+    {
+        runTiles(&m_scratch[0]);
+        return true;
+    }
+
+    {
+        std::lock_guard<std::mutex> l(m_lock);
+        ++m_generation;
+        m_running = static_cast<uint32_t>(m_threads.size());
+    }
+    m_start_cond.notify_all();
+
+    runTiles(&m_scratch[0]);
+
+    // the worker threads read m_frame until they finish
+    std::unique_lock<std::mutex> l(m_lock);
+    m_done_cond.wait(l, [this]() { return m_running == 0; });
+    return true;
+}
+
+void SwComposer::threadLoop(const uint32_t& idx)
+{
+    uint64_t generation = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> l(m_lock);
+            m_start_cond.wait(l, [&]() { return m_exit || m_generation != generation; });
+            if (m_exit)
+                return;
+            generation = m_generation;
+        }
+
+        runTiles(&m_scratch[idx]);
+
+        std::lock_guard<std::mutex> l(m_lock);
+        if (--m_running == 0)
+            m_done_cond.notify_one();
+    }
+}
+
+void SwComposer::runTiles(Scratch* scratch)
+{
+    while (true)
+    {
+        const uint32_t tile = m_next_tile.fetch_add(1, std::memory_order_relaxed);
+        if (tile >= m_frame.tile_num)
+            break;
+
+        renderTile(tile, scratch);
+    }
+}
+
+void SwComposer::renderTile(const uint32_t& tile, Scratch* scratch)
+{
+    const Frame& frame = m_frame;
+    const int32_t left = frame.bounds.left + static_cast<int32_t>(tile % frame.tiles_x) * TILE_WIDTH;
+    const int32_t top = frame.bounds.top + static_cast<int32_t>(tile / frame.tiles_x) * TILE_HEIGHT;
+    const int32_t right = left + TILE_WIDTH < frame.bounds.right ? left + TILE_WIDTH : frame.bounds.right;
+    const int32_t bottom = top + TILE_HEIGHT < frame.bounds.bottom ? top + TILE_HEIGHT : frame.bounds.bottom;
+
+    for (int32_t y = top; y < bottom; ++y)
+    {
+        uint32_t* row = reinterpret_cast<uint32_t*>(frame.dst.plane[0] + y * frame.dst.pitch[0]) + left;
+        memset(row, 0, (right - left) * sizeof(uint32_t));
+
+        for (size_t i = 0; i < frame.num; ++i)
+        {
+            const SwLayer& layer = frame.layers[i];
+            const hwc_rect_t& display_frame = layer.display_frame;
+            if (y < display_frame.top || y >= display_frame.bottom)
+                continue;
+
+            const int32_t x0 = left > display_frame.left ? left : display_frame.left;
+            const int32_t x1 = right < display_frame.right ? right : display_frame.right;
+            if (x0 >= x1)
+                continue;
+
+            const uint32_t* line = fetchRow(layer, y, x0, x1, scratch);
+            m_kernels.blend(line, row + (x0 - left), x1 - x0, layer.blending, layer.plane_alpha);
+        }
+    }
+}
+
+const uint32_t* SwComposer::fetchRow(const SwLayer& layer, const int32_t& y,
+    const int32_t& x0, const int32_t& x1, Scratch* scratch)
+{
+    const hwc_rect_t& crop = layer.src_crop;
+    const hwc_rect_t& display_frame = layer.display_frame;
+    const int32_t crop_w = getWidth(crop);
+    const int32_t frame_w = getWidth(display_frame);
+
+    const int32_t sy = crop.top +
+        getSampleOffset(y - display_frame.top, getHeight(crop), getHeight(display_frame));
+
+    if (crop_w == frame_w)
+    {
+        const int32_t sx = crop.left + (x0 - display_frame.left);
+        return convertRow(layer.src, sx, sy, x1 - x0, scratch->conv.data(), scratch);
+    }
+
+    // convert the span of the source once, then take the nearest samples
+    const int32_t sx0 = getSampleOffset(x0 - display_frame.left, crop_w, frame_w);
+    const int32_t sx1 = getSampleOffset(x1 - 1 - display_frame.left, crop_w, frame_w);
+    const uint32_t* span = convertRow(layer.src, crop.left + sx0, sy, sx1 - sx0 + 1,
+        scratch->conv.data(), scratch);
+
+    // the offset of the next sample moves by crop_w / frame_w, step it with
+    // the quotient and the remainder instead of a division per pixel
+    const int64_t den = 2 * static_cast<int64_t>(frame_w);
+    const int64_t num = static_cast<int64_t>(2 * (x0 - display_frame.left) + 1) * crop_w;
+    const int64_t step = 2 * static_cast<int64_t>(crop_w);
+    const int32_t step_q = static_cast<int32_t>(step / den);
+    const int64_t step_r = step % den;
+    int32_t q = static_cast<int32_t>(num / den) - sx0;
+    int64_t r = num % den;
+
+    uint32_t* sample = scratch->sample.data();
+    const int32_t n = x1 - x0;
+    for (int32_t i = 0; i < n; ++i)
+    {
+        sample[i] = span[q];
+        q += step_q;
+        r += step_r;
+        if (r >= den)
+        {
+            ++q;
+            r -= den;
+        }
+    }
+    return sample;
+}
+
+const uint32_t* SwComposer::convertRow(const SwBuffer& src, const int32_t& sx, const int32_t& sy,
+    const uint32_t& n, uint32_t* dst, Scratch* scratch)
+{
+    const uint8_t* row = src.plane[0] + sy * src.pitch[0];
+
+    switch (src.format)
+    {
+        case SW_FORMAT_RGBA_8888:
+            // already in the output format, read it in place
+            return reinterpret_cast<const uint32_t*>(row) + sx;
+
+        case SW_FORMAT_RGBX_8888:
+            m_kernels.convertRGBX(reinterpret_cast<const uint32_t*>(row) + sx, dst, n);
+            return dst;
+
+        case SW_FORMAT_RGB_565:
+            m_kernels.convertRGB565(reinterpret_cast<const uint16_t*>(row) + sx, dst, n);
+            return dst;
+
+        case SW_FORMAT_YUV_420:
+        {
+            // start from an even pixel to share the chroma with its pair
+            const int32_t phase = sx & 1;
+            const int32_t x = sx - phase;
+            const uint32_t count = n + phase;
+            const uint32_t chroma_num = (count + 1) / 2;
+            const int32_t cy = sy / 2;
+
+            const uint8_t* cb = src.plane[1] + cy * src.pitch[1] + (x / 2) * src.chroma_step;
+            const uint8_t* cr = src.plane[2] + cy * src.pitch[2] + (x / 2) * src.chroma_step;
+            if (src.chroma_step != 1)
+            {
+                uint8_t* cb_line = scratch->cb.data();
+                uint8_t* cr_line = scratch->cr.data();
+                for (uint32_t i = 0; i < chroma_num; ++i)
+                {
+                    cb_line[i] = cb[i * src.chroma_step];
+                    cr_line[i] = cr[i * src.chroma_step];
+                }
+                cb = cb_line;
+                cr = cr_line;
+            }
+
+            m_kernels.convertYUV420(row + x, cb, cr, dst, count);
+            return dst + phase;
+        }
+    }
+    return dst;
+}
@@ -0,0 +1,205 @@
+#ifndef HWC_SW_COMPOSER_H_
+#define HWC_SW_COMPOSER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <hardware/hwcomposer_defs.h>
+
+// ---------------------------------------------------------------------------
+
+// source formats of SwComposer, the output is always SW_FORMAT_RGBA_8888
+enum SW_FORMAT
+{
+    SW_FORMAT_RGBA_8888 = 0,
+    SW_FORMAT_RGBX_8888 = 1,
+    SW_FORMAT_RGB_565   = 2,
+
+    // 4:2:0 with BT.601 narrow range; plane[0] is Y, plane[1] is Cb and
+    // plane[2] is Cr, chroma_step is 1 for planar (I420, YV12) and
+    // 2 for semi-planar (NV12, NV21)
+    SW_FORMAT_YUV_420   = 3,
+};
+
+enum SW_BLEND
+{
+    // the source is opaque
+    SW_BLEND_NONE       = 0,
+
+    // the source color is premultiplied by its alpha
+    SW_BLEND_PREMULT    = 1,
+
+    // the source color is not premultiplied
+    SW_BLEND_COVERAGE   = 2,
+};
+
+struct SwBuffer
+{
+    SwBuffer()
+        : format(SW_FORMAT_RGBA_8888), width(0), height(0), chroma_step(1)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            plane[i] = NULL;
+            pitch[i] = 0;
+        }
+    }
+
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+
+    uint8_t* plane[3];
+
+    // pitch in bytes of each plane
+    uint32_t pitch[3];
+
+    uint32_t chroma_step;
+};
+
+struct SwLayer
+{
+    SwLayer() : blending(SW_BLEND_NONE), plane_alpha(0xFF)
+    {
+        src_crop.left = src_crop.top = src_crop.right = src_crop.bottom = 0;
+        display_frame.left = display_frame.top = display_frame.right = display_frame.bottom = 0;
+    }
+
+    SwBuffer src;
+
+    // src_crop is scaled to display_frame with the nearest sample,
+    // rotation is not supported
+    hwc_rect_t src_crop;
+    hwc_rect_t display_frame;
+
+    uint32_t blending;
+    uint8_t plane_alpha;
+};
+
+// SwKernels is a set of row kernels of SwComposer.
+// The SIMD set gives exactly the same pixels as the scalar one.
+struct SwKernels
+{
+    const char* name;
+
+    // conversions of n pixels to RGBA_8888
+    void (*convertRGBX)(const uint32_t* src, uint32_t* dst, uint32_t n);
+    void (*convertRGB565)(const uint16_t* src, uint32_t* dst, uint32_t n);
+    // pixel i takes its chroma from cb[i / 2] and cr[i / 2]
+    void (*convertYUV420)(const uint8_t* y, const uint8_t* cb, const uint8_t* cr,
+        uint32_t* dst, uint32_t n);
+
+    // blend n RGBA_8888 pixels of src over dst, the result is premultiplied
+    void (*blend)(const uint32_t* src, uint32_t* dst, uint32_t n,
+        uint32_t blending, uint8_t plane_alpha);
+};
+
+// getSwKernels() returns the SIMD kernels of this CPU (NEON or SSE2) if
+// use_simd is set and there are ones, otherwise the scalar kernels
+const SwKernels& getSwKernels(const bool& use_simd);
+
+// SwComposer is the CPU compositor used when MDP cannot take a layer.
+// The output is split into tiles of TILE_WIDTH x TILE_HEIGHT, and the tiles
+// are rendered by the calling thread and the worker threads, each tile from
+// the bottom layer to the top one, row by row:
+//  - the source row is converted to RGBA_8888 into a line buffer of the
+//    thread, then sampled to the width of the display frame if scaled
+//  - the line is blended into the output row, which is still in the cache
+// A tile is claimed with one atomic add, so the threads balance themselves
+// when the cost of tiles differs, e.g. tiles covered by more layers.
+// compose() is called by one thread at a time.
+class SwComposer
+{
+public:
+    enum
+    {
+        TILE_WIDTH  = 256,
+        TILE_HEIGHT = 16,
+
+        MAX_THREAD_NUM = 8,
+    };
+
+    // thread_num counts the calling thread, so thread_num - 1 threads
+    // are created
+    explicit SwComposer(const uint32_t& thread_num, const bool& use_simd = true);
+    ~SwComposer();
+
+    // isFormatSupported() checks a SW_FORMAT
+    static bool isFormatSupported(const uint32_t& format);
+
+    // compose() renders layers (the bottom one first) into the bounds of dst,
+    // which must be SW_FORMAT_RGBA_8888.
+    // The bounds are cleared to transparent black first, so the result is
+    // premultiplied and the pixels outside the bounds are not touched.
+    // return false if a layer or dst is not valid, then dst is not changed
+    bool compose(const SwLayer* layers, const size_t& num,
+        const SwBuffer& dst, const hwc_rect_t& bounds);
+
+    uint32_t getThreadNum() const { return static_cast<uint32_t>(m_threads.size()) + 1; }
+
+    const char* getKernelName() const { return m_kernels.name; }
+
+private:
+    // the line buffers of a thread
+    struct Scratch
+    {
+        std::vector<uint32_t> conv;
+        std::vector<uint32_t> sample;
+        std::vector<uint8_t> cb;
+        std::vector<uint8_t> cr;
+    };
+
+    struct Frame
+    {
+        const SwLayer* layers;
+        size_t num;
+        SwBuffer dst;
+        hwc_rect_t bounds;
+        uint32_t tiles_x;
+        uint32_t tile_num;
+    };
+
+    void threadLoop(const uint32_t& idx);
+
+    // runTiles() renders the tiles left in the current frame
+    void runTiles(Scratch* scratch);
+
+    void renderTile(const uint32_t& tile, Scratch* scratch);
+
+    // fetchRow() converts and samples the part [x0, x1) of row y of the
+    // display frame of a layer; return the RGBA_8888 pixels
+    const uint32_t* fetchRow(const SwLayer& layer, const int32_t& y,
+        const int32_t& x0, const int32_t& x1, Scratch* scratch);
+
+    // convertRow() converts n pixels of row sy of a source from sx into dst;
+    // return the RGBA_8888 pixels, which are in the source if it is RGBA_8888
+    const uint32_t* convertRow(const SwBuffer& src, const int32_t& sx, const int32_t& sy,
+        const uint32_t& n, uint32_t* dst, Scratch* scratch);
+
+    const SwKernels& m_kernels;
+
+    std::vector<std::thread> m_threads;
+
+    // m_scratch[0] is for the calling thread
+    std::vector<Scratch> m_scratch;
+
+    Frame m_frame;
+    std::atomic<uint32_t> m_next_tile;
+
+    // m_generation is bumped for each frame, m_running counts the worker
+    // threads which have not finished it
+    std::mutex m_lock;
+    std::condition_variable m_start_cond;
+    std::condition_variable m_done_cond;
+    uint64_t m_generation;
+    uint32_t m_running;
+    bool m_exit;
+};
+
+#endif // HWC_SW_COMPOSER_H_
@@ -162,6 +162,38 @@ status_t SyncFence::wait(int fd, int timeout, const char* log_name)
     return err < 0 ? -errno : status_t(NO_ERROR);
 }
 
+status_t SyncFence::wait(FenceSet* fences, int timeout, const char* log_name)
+{
+    if (fences->isEmpty()) return NO_ERROR;
+
+    const size_t num = fences->size();
+
+    char atrace_tag[256];
+    sprintf(atrace_tag, "wait_fences(%zu)\n", num);
+    HWC_ATRACE_NAME(atrace_tag);
+
+    int err = fences->wait(timeout);
+    if (err == -ETIME)
+    {
+        HWC_ATRACE_NAME("timeout");
+
+        SYNC_LOGE("[%s] (%d) %zu fences didn't signal in %u ms",
+            log_name, m_client, fences->size(), timeout);
+
+        for (size_t i = 0; i < fences->size(); i++)
+        {
+            dumpLocked(fences->getFd(i));
+        }
+    }
+
+    SYNC_LOGV("[%s] (%d) wait and close %zu fences within %d",
+        log_name, m_client, num, timeout);
+
+    fences->clear();
+
+    return err < 0 ? err : status_t(NO_ERROR);
+}
+
 status_t SyncFence::waitForever(int fd, int warning_timeout, const char* log_name)
 {
     if (fd == -1) return NO_ERROR;
@@ -3,6 +3,8 @@
 
 #include <utils/threads.h>
 
+#include "fence_set.h"
+
 using namespace android;
 
 struct DispatcherJob;
@@ -36,6 +38,13 @@ public:
     // <fd> will be closed implicitly before exiting wait()
     status_t wait(int fd, int timeout, const char* log_name = "");
 
+    // wait() waits for all fences in <fences> with one poll per wakeup;
+    // the fences which are signaled already cost no wait.
+    // the fences which do not signal within timeout are dumped.
+    //
+    // <fences> is empty after exiting wait()
+    status_t wait(FenceSet* fences, int timeout, const char* log_name = "");
+
     // waitForever() is a convenience function for waiting forever for a fence
     // to signal (just like wait(TIMEOUT_NEVER)), but issuing an error to the
     // system log and fence state to the kernel log if the wait lasts longer
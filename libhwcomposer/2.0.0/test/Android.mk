@@ -0,0 +1,246 @@
+LOCAL_PATH := $(call my-dir)
+
+#
+# validate result cache test on HWCDisplay and HWCLayer with gralloc buffers
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	vali_cache_test.cpp
+
+LOCAL_C_INCLUDES += \
+	frameworks/native/services/surfaceflinger \
+	$(TOP)/$(MTK_ROOT)/hardware/hwcomposer \
+	$(TOP)/$(MTK_ROOT)/hardware/hwcomposer/include \
+	$(TOP)/$(MTK_ROOT)/hardware/gralloc_extra/include \
+	$(TOP)/$(MTK_ROOT)/hardware/dpframework/include \
+	$(TOP)/$(MTK_ROOT)/hardware/gpu_ext/ged/include \
+	$(TOP)/$(MTK_ROOT)/hardware/libgem/inc \
+	$(TOP)/$(MTK_ROOT)/hardware/bwc/inc \
+	$(TOP)/$(MTK_ROOT)/hardware/m4u/$(MTK_PLATFORM_DIR) \
+	$(LOCAL_PATH)/../../$(MTK_PLATFORM_DIR) \
+	$(LOCAL_PATH)/../.. \
+	$(LOCAL_PATH)/.. \
+	$(TOP)/$(MTK_ROOT)/external/libion_mtk/include \
+	$(TOP)/system/core/libion/include \
+	$(TOP)/system/core/libsync/include \
+	$(TOP)/system/core/include \
+	frameworks/native/libs/nativewindow/include \
+	frameworks/native/libs/nativebase/include \
+	frameworks/native/libs/arect/include
+
+LOCAL_CFLAGS := \
+	-DLOG_TAG=\"hwc2_vali_cache_test\" \
+	-DUSE_NATIVE_FENCE_SYNC \
+	-DMTK_HWC_VER_2_0 \
+	-DUSE_HWC2
+
+# the composer itself, as hwcomposer.$(MTK_PLATFORM_DIR) links it
+LOCAL_STATIC_LIBRARIES := \
+	hwcomposer.$(MTK_PLATFORM_DIR).2.0.0
+
+LOCAL_SHARED_LIBRARIES := \
+	libui \
+	libutils \
+	libcutils \
+	liblog \
+	libsync \
+	libion \
+	libbwc \
+	libion_mtk \
+	libdpframework \
+	libhardware \
+	libgralloc_extra \
+	libdl \
+	libbinder \
+	libged
+
+ifeq ($(MTK_M4U_SUPPORT), yes)
+	LOCAL_SHARED_LIBRARIES += libm4u
+endif
+
+ifneq ($(MTK_BASIC_PACKAGE), yes)
+	LOCAL_SHARED_LIBRARIES += \
+		libui_ext \
+		libhidlbase \
+		libhwbinder \
+		libhidltransport \
+		libpq_prot \
+		vendor.mediatek.hardware.pq@2.0_vendor \
+		android.hardware.power@1.0 \
+		vendor.mediatek.hardware.power@1.1_vendor
+
+	LOCAL_CFLAGS += -DUSES_PQSERVICE -DUSES_POWERHAL
+endif
+
+LOCAL_MODULE := hwc2_vali_cache_test
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_EXECUTABLE)
+
+#
+# hrt arbitration test with the software model of the display driver
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	hrt_test.cpp \
+	../hrt_model.cpp
+
+LOCAL_MODULE := hwc2_hrt_test
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_EXECUTABLE)
+
+#
+# 120Hz replay benchmark of the job pool and the job queue of DispatchThread
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	dispatcher_job_test.cpp
+
+LOCAL_MODULE := hwc2_dispatcher_job_test
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_EXECUTABLE)
+
+#
+# region operations of partial update, and the pixels read per frame
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	dirty_region_test.cpp \
+	../dirty_region.cpp
+
+LOCAL_MODULE := hwc2_dirty_region_test
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_EXECUTABLE)
+
+#
+# batched wait and balanced merge of fences, on sw_sync or eventfd
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	fence_set_test.cpp \
+	../fence_set.cpp
+
+LOCAL_MODULE := hwc2_fence_set_test
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_EXECUTABLE)
+
+#
+# slot state machine of DisplayBufferQueue, stress and throughput
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	slot_queue_test.cpp
+
+LOCAL_MODULE := hwc2_slot_queue_test
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_EXECUTABLE)
+
+#
+# CPU composer of layers MDP cannot handle, golden images and throughput
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	sw_composer_test.cpp \
+	../sw_composer.cpp
+
+LOCAL_MODULE := hwc2_sw_composer_test
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_EXECUTABLE)
+
+#
+# vsync model with noisy traces, and wakeup latency of timerfd
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	vsync_model_test.cpp \
+	../vsync_model.cpp
+
+LOCAL_MODULE := hwc2_vsync_model_test
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_EXECUTABLE)
+
+#
+# overlay input config diffing against a mock display driver
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	ovl_config_diff_test.cpp \
+	../ovl_config_diff.cpp
+
+LOCAL_MODULE := hwc2_ovl_config_diff_test
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_EXECUTABLE)
+
+#
+# replay of frame traces recorded by debug.hwc.frame_trace
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	frame_replay.cpp \
+	../frame_trace.cpp \
+	../hrt_model.cpp \
+	../fence_set.cpp \
+	../ovl_config_diff.cpp
+
+LOCAL_MODULE := hwc2_frame_replay
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,543 @@
+// dirty_region_test: DirtyRegion, mapDisplayRegionToSource() and
+// DirtyRegionTracker without the display driver.
+//
+// The region operations are checked against a bitmap of a small grid with
+// random rects; the result must be the same set of pixels, the rects must be
+// disjoint, and simplify() must keep the region covered within its limit.
+// The mapping is checked for all transforms: every source pixel whose center
+// is shown in the display rect must be in the mapped region.
+//
+// Then a fake display runs frame sequences:
+//  - a watch face where only the second hand is redrawn
+//  - a list scrolling under a toolbar by the source crop of its layer
+//  - a popup moving over an app
+//  - a terminal with more blinking cursors than MAX_DIRTY_RECT_CNT
+// and the pixels read by partial update per frame are reported for
+//  - old : full update on any geometry change, else the surface damage,
+//          or the full buffer with more than MAX_DIRTY_RECT_CNT rects
+//  - new : the dirty regions of DirtyRegionTracker
+//
+// usage: dirty_region_test [frames]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <vector>
+
+#include "../dirty_region.h"
+
+#define DEFAULT_FRAMES  (600)
+#define GRID_SIZE       (48)
+#define RANDOM_ROUNDS   (2000)
+#define MAX_RECT_CNT    (10)
+
+static bool isDisjoint(const DirtyRegion& region)
+{
+    const std::vector<hwc_rect_t>& rects = region.getRects();
+    for (size_t i = 0; i < rects.size(); ++i)
+    {
+        if (DirtyRegion::isRectEmpty(rects[i]))
+            return false;
+
+        for (size_t j = i + 1; j < rects.size(); ++j)
+        {
+            if (!DirtyRegion::isRectEmpty(DirtyRegion::intersectRect(rects[i], rects[j])))
+                return false;
+        }
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+
+class Bitmap
+{
+public:
+    Bitmap() : m_bits(GRID_SIZE * GRID_SIZE, false) { }
+
+    void set(const hwc_rect_t& rect, const bool& val)
+    {
+        for (int y = std::max(rect.top, 0); y < std::min(rect.bottom, GRID_SIZE); ++y)
+        {
+            for (int x = std::max(rect.left, 0); x < std::min(rect.right, GRID_SIZE); ++x)
+            {
+                m_bits[y * GRID_SIZE + x] = val;
+            }
+        }
+    }
+
+    void orRect(const hwc_rect_t& rect) { set(rect, true); }
+
+    void andRect(const hwc_rect_t& rect)
+    {
+        Bitmap mask;
+        mask.orRect(rect);
+        for (size_t i = 0; i < m_bits.size(); ++i)
+        {
+            m_bits[i] = m_bits[i] && mask.m_bits[i];
+        }
+    }
+
+    void subtractRect(const hwc_rect_t& rect) { set(rect, false); }
+
+    bool get(const int& x, const int& y) const { return m_bits[y * GRID_SIZE + x]; }
+
+    // equals() checks the region is the same set of pixels
+    bool equals(const DirtyRegion& region) const
+    {
+        int64_t area = 0;
+        for (int y = 0; y < GRID_SIZE; ++y)
+        {
+            for (int x = 0; x < GRID_SIZE; ++x)
+            {
+                if (get(x, y) != region.contains(x, y))
+                    return false;
+                area += get(x, y) ? 1 : 0;
+            }
+        }
+        return area == region.getArea();
+    }
+
+    // coveredBy() checks all pixels are in the region
+    bool coveredBy(const DirtyRegion& region) const
+    {
+        for (int y = 0; y < GRID_SIZE; ++y)
+        {
+            for (int x = 0; x < GRID_SIZE; ++x)
+            {
+                if (get(x, y) && !region.contains(x, y))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    std::vector<bool> m_bits;
+};
+
+static hwc_rect_t randomRect(const int& max_size)
+{
+    const int w = rand() % max_size;
+    const int h = rand() % max_size;
+    const int x = rand() % GRID_SIZE - max_size / 4;
+    const int y = rand() % GRID_SIZE - max_size / 4;
+    const hwc_rect_t rect = { x, y, x + w, y + h };
+    return rect;
+}
+
+static bool checkRegionOps()
+{
+    int failed = 0;
+    for (int round = 0; round < RANDOM_ROUNDS; ++round)
+    {
+        DirtyRegion region;
+        Bitmap oracle;
+        const int ops = 1 + rand() % 24;
+        for (int i = 0; i < ops; ++i)
+        {
+            const hwc_rect_t rect = randomRect(GRID_SIZE / 2);
+            const int op = rand() % 6;
+            if (op < 3)
+            {
+                region.orRect(rect);
+                oracle.orRect(rect);
+            }
+            else if (op < 5)
+            {
+                region.subtractRect(rect);
+                oracle.subtractRect(rect);
+            }
+            else
+            {
+                region.andRect(rect);
+                oracle.andRect(rect);
+            }
+        }
+
+        // the region out of the grid is not checked by the bitmap
+        region.andRect({ 0, 0, GRID_SIZE, GRID_SIZE });
+        if (!oracle.equals(region) || !isDisjoint(region))
+        {
+            ++failed;
+            continue;
+        }
+
+        // the same operations on regions
+        DirtyRegion other(randomRect(GRID_SIZE));
+        other.orRect(randomRect(GRID_SIZE));
+        DirtyRegion both(region);
+        both.andSelf(other);
+        DirtyRegion either(region);
+        either.orSelf(other);
+        DirtyRegion diff(region);
+        diff.subtractSelf(other);
+        if (!isDisjoint(both) || !isDisjoint(either) || !isDisjoint(diff) ||
+            both.getArea() + diff.getArea() != region.getArea() ||
+            either.getArea() != diff.getArea() + other.getArea())
+        {
+            ++failed;
+            continue;
+        }
+
+        const size_t max_num = 1 + rand() % MAX_RECT_CNT;
+        region.simplify(max_num);
+        if (region.getRectNum() > max_num || !oracle.coveredBy(region) || !isDisjoint(region))
+            ++failed;
+    }
+
+    printf("region ops: %d rounds, %d failed\n", RANDOM_ROUNDS, failed);
+    return failed == 0;
+}
+
+// ---------------------------------------------------------------------------
+
+// mapSourceToDisplay() is the forward mapping of HAL_TRANSFORM_*:
+// the buffer is flipped first, then rotated clockwise by 90 degrees
+static void mapSourceToDisplay(const float& s, const float& t, const int32_t& transform, float* u, float* v)
+{
+    float fs = (transform & HAL_TRANSFORM_FLIP_H) ? 1.0f - s : s;
+    float ft = (transform & HAL_TRANSFORM_FLIP_V) ? 1.0f - t : t;
+    if (transform & HAL_TRANSFORM_ROT_90)
+    {
+        *u = 1.0f - ft;
+        *v = fs;
+    }
+    else
+    {
+        *u = fs;
+        *v = ft;
+    }
+}
+
+static bool checkMapping()
+{
+    int failed = 0;
+    for (int round = 0; round < RANDOM_ROUNDS / 4; ++round)
+    {
+        const int32_t transform = rand() % 8;
+        const hwc_rect_t display_frame = { 3, 5, 3 + 8 + rand() % 40, 5 + 8 + rand() % 40 };
+        const hwc_frect_t source_crop = {
+            static_cast<float>(rand() % 8) + 0.5f, static_cast<float>(rand() % 8),
+            static_cast<float>(16 + rand() % 32), static_cast<float>(16 + rand() % 32) + 0.25f };
+
+        DirtyRegion display_region(randomRect(GRID_SIZE / 3));
+        display_region.orRect(randomRect(GRID_SIZE / 3));
+
+        DirtyRegion source_region;
+        mapDisplayRegionToSource(display_region, display_frame, source_crop, transform, &source_region);
+
+        const float crop_w = source_crop.right - source_crop.left;
+        const float crop_h = source_crop.bottom - source_crop.top;
+        const float frame_w = static_cast<float>(display_frame.right - display_frame.left);
+        const float frame_h = static_cast<float>(display_frame.bottom - display_frame.top);
+        bool ok = true;
+        for (int y = static_cast<int>(source_crop.top); ok && y < source_crop.bottom; ++y)
+        {
+            for (int x = static_cast<int>(source_crop.left); ok && x < source_crop.right; ++x)
+            {
+                const float s = (x + 0.5f - source_crop.left) / crop_w;
+                const float t = (y + 0.5f - source_crop.top) / crop_h;
+                if (s < 0 || s > 1 || t < 0 || t > 1)
+                    continue;
+
+                float u = 0, v = 0;
+                mapSourceToDisplay(s, t, transform, &u, &v);
+                const int dx = static_cast<int>(floorf(display_frame.left + u * frame_w));
+                const int dy = static_cast<int>(floorf(display_frame.top + v * frame_h));
+                if (dx < display_frame.left || dx >= display_frame.right ||
+                    dy < display_frame.top || dy >= display_frame.bottom)
+                    continue;
+
+                if (display_region.contains(dx, dy) && !source_region.contains(x, y))
+                    ok = false;
+            }
+        }
+        if (!ok || !isDisjoint(source_region))
+            ++failed;
+    }
+
+    printf("mapping: %d rounds, %d failed\n", RANDOM_ROUNDS / 4, failed);
+    return failed == 0;
+}
+
+// ---------------------------------------------------------------------------
+
+struct FakeLayer
+{
+    FakeLayer(const uint64_t& layer_id, const hwc_rect_t& frame)
+        : id(layer_id)
+        , display_frame(frame)
+    {
+        source_crop.left = 0;
+        source_crop.top = 0;
+        source_crop.right = static_cast<float>(frame.right - frame.left);
+        source_crop.bottom = static_cast<float>(frame.bottom - frame.top);
+        buffer_bounds.left = 0;
+        buffer_bounds.top = 0;
+        buffer_bounds.right = frame.right - frame.left;
+        buffer_bounds.bottom = frame.bottom - frame.top;
+        // an unchanged buffer has an empty damage rect
+        damage.push_back({ 0, 0, 0, 0 });
+    }
+
+    uint64_t id;
+    hwc_rect_t display_frame;
+    hwc_frect_t source_crop;
+    hwc_rect_t buffer_bounds;
+    std::vector<hwc_rect_t> damage;
+    DirtyRegion dirty;
+};
+
+typedef void (*FrameUpdater)(std::vector<FakeLayer>* layers, const int frame);
+
+static void initLayers(std::vector<FakeLayer>* layers, const int& w, const int& h)
+{
+    layers->clear();
+    layers->push_back(FakeLayer(1, { 0, 0, w, h }));
+}
+
+// a 454x454 watch face, the second hand is redrawn into a layer over it
+static void updateWatch(std::vector<FakeLayer>* layers, const int frame)
+{
+    if (frame == 0)
+    {
+        initLayers(layers, 454, 454);
+        layers->push_back(FakeLayer(2, { 0, 0, 454, 454 }));
+    }
+
+    const float angle = frame * 6.0f * 3.14159265f / 180.0f;
+    const float prev = (frame - 1) * 6.0f * 3.14159265f / 180.0f;
+    const int cx = 227;
+    const int cy = 227;
+    const int len = 200;
+    const int x0 = cx + static_cast<int>(len * sinf(angle));
+    const int y0 = cy - static_cast<int>(len * cosf(angle));
+    const int x1 = cx + static_cast<int>(len * sinf(prev));
+    const int y1 = cy - static_cast<int>(len * cosf(prev));
+    FakeLayer& hand = (*layers)[1];
+    hand.damage.clear();
+    hand.damage.push_back({ std::min(cx, std::min(x0, x1)) - 4, std::min(cy, std::min(y0, y1)) - 4,
+                            std::max(cx, std::max(x0, x1)) + 4, std::max(cy, std::max(y0, y1)) + 4 });
+    hand.damage[0] = DirtyRegion::intersectRect(hand.damage[0], hand.buffer_bounds);
+}
+
+// a list in a 1080x6000 buffer scrolls under the toolbar by its source crop
+static void updateScroll(std::vector<FakeLayer>* layers, const int frame)
+{
+    if (frame == 0)
+    {
+        initLayers(layers, 1080, 2160);
+        FakeLayer list(2, { 0, 200, 1080, 2160 });
+        list.buffer_bounds.bottom = 6000;
+        layers->push_back(list);
+        layers->push_back(FakeLayer(3, { 0, 0, 1080, 200 }));
+    }
+
+    FakeLayer& list = (*layers)[1];
+    const float offset = static_cast<float>((frame * 12) % (6000 - 1960));
+    list.source_crop.top = offset;
+    list.source_crop.bottom = offset + 1960;
+}
+
+// a 600x400 popup moves over an app by 16 pixels per frame
+static void updatePopup(std::vector<FakeLayer>* layers, const int frame)
+{
+    if (frame == 0)
+    {
+        initLayers(layers, 1080, 2160);
+        layers->push_back(FakeLayer(2, { 0, 0, 1080, 2160 }));
+        layers->push_back(FakeLayer(3, { 0, 0, 600, 400 }));
+    }
+
+    FakeLayer& popup = (*layers)[2];
+    const int x = (frame * 16) % (1080 - 600);
+    const int y = 300 + (frame * 16) % (2160 - 700);
+    popup.display_frame = { x, y, x + 600, y + 400 };
+}
+
+// a terminal with 24 blinking cursors in a grid, 12 of them change per frame
+static void updateCursors(std::vector<FakeLayer>* layers, const int frame)
+{
+    if (frame == 0)
+    {
+        initLayers(layers, 1080, 2160);
+        layers->push_back(FakeLayer(2, { 0, 0, 1080, 2160 }));
+    }
+
+    FakeLayer& app = (*layers)[1];
+    app.damage.clear();
+    for (int i = 0; i < 24; ++i)
+    {
+        if ((i + frame) % 2)
+            continue;
+
+        const int x = 40 + (i % 4) * 260;
+        const int y = 100 + (i / 4) * 340;
+        app.damage.push_back({ x, y, x + 24, y + 48 });
+    }
+}
+
+// the pixels read by the old partial update
+static int64_t getOldArea(const std::vector<FakeLayer>& layers, const std::vector<FakeLayer>& prev)
+{
+    bool geometry_changed = layers.size() != prev.size();
+    for (size_t i = 0; !geometry_changed && i < layers.size(); ++i)
+    {
+        geometry_changed = layers[i].id != prev[i].id ||
+            memcmp(&layers[i].display_frame, &prev[i].display_frame, sizeof(hwc_rect_t)) ||
+            memcmp(&layers[i].source_crop, &prev[i].source_crop, sizeof(hwc_frect_t));
+    }
+
+    int64_t area = 0;
+    for (const auto& layer : layers)
+    {
+        const hwc_rect_t crop = {
+            static_cast<int>(layer.source_crop.left), static_cast<int>(layer.source_crop.top),
+            static_cast<int>(ceilf(layer.source_crop.right)), static_cast<int>(ceilf(layer.source_crop.bottom)) };
+        if (geometry_changed || layer.damage.size() > MAX_RECT_CNT)
+        {
+            area += DirtyRegion::getRectArea(crop);
+            continue;
+        }
+
+        for (const auto& rect : layer.damage)
+        {
+            area += DirtyRegion::getRectArea(DirtyRegion::intersectRect(rect, crop));
+        }
+    }
+    return area;
+}
+
+static bool replay(const char* name, FrameUpdater updater, const int& frames)
+{
+    std::vector<FakeLayer> layers;
+    std::vector<FakeLayer> prev;
+    DirtyRegionTracker tracker(MAX_RECT_CNT);
+
+    int64_t old_area = 0;
+    int64_t new_area = 0;
+    int full_frames = 0;
+    bool ok = true;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        updater(&layers, frame);
+
+        std::vector<DirtyLayer> dirty_layers(layers.size());
+        for (size_t i = 0; i < layers.size(); ++i)
+        {
+            dirty_layers[i].id = layers[i].id;
+            dirty_layers[i].display_frame = layers[i].display_frame;
+            dirty_layers[i].source_crop = layers[i].source_crop;
+            dirty_layers[i].buffer_bounds = layers[i].buffer_bounds;
+            dirty_layers[i].damage_known = true;
+            dirty_layers[i].damage_num = layers[i].damage.size();
+            dirty_layers[i].damage = layers[i].damage.data();
+            dirty_layers[i].dirty = &layers[i].dirty;
+        }
+
+        const bool partial = tracker.update(dirty_layers);
+        if (frame == 0)
+        {
+            // the first frame is always a full update
+            prev = layers;
+            continue;
+        }
+
+        old_area += getOldArea(layers, prev);
+        if (!partial)
+        {
+            ++full_frames;
+            for (const auto& layer : layers)
+            {
+                new_area += DirtyRegion::getRectArea(layer.buffer_bounds);
+            }
+        }
+        else
+        {
+            for (const auto& layer : layers)
+            {
+                // the damage is always kept, and the rects are merged
+                for (const auto& rect : layer.damage)
+                {
+                    DirtyRegion damage(DirtyRegion::intersectRect(rect, layer.buffer_bounds));
+                    DirtyRegion missed(damage);
+                    missed.subtractSelf(layer.dirty);
+                    ok &= missed.isEmpty();
+                }
+                ok &= layer.dirty.getRectNum() <= MAX_RECT_CNT;
+                new_area += layer.dirty.getArea();
+            }
+        }
+        prev = layers;
+    }
+
+    const int counted = frames > 1 ? frames - 1 : 1;
+    printf("%-8s frames:%d  old: %8.1f KB/frame  new: %8.1f KB/frame (%5.1f%%)  full:%d %s\n",
+        name, frames,
+        old_area * 4.0 / 1024 / counted,
+        new_area * 4.0 / 1024 / counted,
+        old_area ? 100.0 * new_area / old_area : 0.0,
+        full_frames, ok ? "" : "DAMAGE MISSED");
+    return ok;
+}
+
+// a popup which is removed exposes the layers under it, and a removed layer
+// which no layer covers needs a full update
+static bool checkTracker()
+{
+    DirtyRegionTracker tracker(MAX_RECT_CNT);
+    const hwc_rect_t empty = { 0, 0, 0, 0 };
+    DirtyRegion dirty[2];
+
+    std::vector<DirtyLayer> layers(2);
+    layers[0].id = 1;
+    layers[0].display_frame = { 0, 0, 100, 100 };
+    layers[0].source_crop = { 0, 0, 100, 100 };
+    layers[0].buffer_bounds = layers[0].display_frame;
+    layers[0].damage_known = true;
+    layers[0].damage_num = 1;
+    layers[0].damage = &empty;
+    layers[0].dirty = &dirty[0];
+    layers[1] = layers[0];
+    layers[1].id = 2;
+    layers[1].display_frame = { 10, 20, 30, 40 };
+    layers[1].dirty = &dirty[1];
+
+    bool ok = tracker.update(layers) && dirty[0].getArea() == 100 * 100;
+
+    ok &= tracker.update(layers) && dirty[0].isEmpty() && dirty[1].isEmpty();
+
+    layers.pop_back();
+    ok &= tracker.update(layers) && dirty[0].getArea() == 20 * 20 && dirty[0].contains(10, 20);
+
+    layers[0].display_frame = { 0, 0, 50, 50 };
+    ok &= !tracker.update(layers);
+
+    printf("tracker: %s\n", ok ? "ok" : "FAILED");
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    int frames = DEFAULT_FRAMES;
+    if (argc > 1)
+        frames = atoi(argv[1]);
+    if (frames <= 0)
+        frames = DEFAULT_FRAMES;
+
+    srand(1);
+    bool ok = checkRegionOps();
+    ok &= checkMapping();
+    ok &= checkTracker();
+
+    ok &= replay("watch", updateWatch, frames);
+    ok &= replay("scroll", updateScroll, frames);
+    ok &= replay("popup", updatePopup, frames);
+    ok &= replay("cursors", updateCursors, frames);
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,432 @@
+// dispatcher_job_test: replay of 120Hz frame submission through the job queue
+// of DispatchThread (job_queue.h).
+//
+// A producer thread acts as SurfaceFlinger: every 8.33ms it gets a job, fills
+// its layers and queues it; in async mode it also marks the last queued job
+// as droppable like HWCDispatcher::trigger() with trigger_by_vsync.
+// A consumer thread acts as DispatchThread: it is woken by a semaphore, takes
+// the jobs, "composes" them and releases them; every STALL_INTERVAL jobs it
+// stalls for 3 frames, so the jobs behind pile up and can be dropped.
+// Two job paths are compared:
+//  - mutex : new/calloc per job, a mutex protected Vector (the old path)
+//  - ring  : ObjectPool + SpscRing + atomic drop handshake (the new path)
+// Each job must be either handled or dropped exactly once; the percentiles
+// of dispatch latency (queue -> done) are reported from JobStageTrace.
+//
+// usage: dispatcher_job_test [frames]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../job_queue.h"
+
+#define DEFAULT_FRAMES      (600)
+#define FRAME_PERIOD_NS     (8333333)
+#define HANDLE_NS           (1500000)
+#define STALL_NS            (25000000)
+#define STALL_INTERVAL      (60)
+#define NUM_LAYERS          (12)
+#define POOL_DEPTH          (8)
+#define QUEUE_DEPTH         (16)
+#define LAYER_SIZE          (512)
+
+enum
+{
+    FAKE_JOB_FILLING    = 0,
+    FAKE_JOB_QUEUED     = 1,
+    FAKE_JOB_DROPPED    = 2,
+    FAKE_JOB_HANDLING   = 3,
+};
+
+struct FakeJob
+{
+    FakeJob()
+        : sequence(0)
+        , droppable(false)
+        , layers(NULL)
+        , queue_state(FAKE_JOB_FILLING)
+    {
+        memset(stage_time, 0, sizeof(stage_time));
+    }
+
+    uint32_t sequence;
+    bool droppable;
+    uint8_t* layers;
+    std::atomic<int32_t> queue_state;
+    int64_t stage_time[JOB_STAGE_NUM];
+};
+
+static int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+static void sleepUntil(const int64_t& deadline)
+{
+    struct timespec ts;
+    ts.tv_sec = deadline / 1000000000LL;
+    ts.tv_nsec = deadline % 1000000000LL;
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+static void spin(const int64_t& ns)
+{
+    const int64_t end = nowNs() + ns;
+    while (nowNs() < end)
+    {
+    }
+}
+
+// ---------------------------------------------------------------------------
+
+class JobPath
+{
+public:
+    JobPath()
+        : m_handled(0)
+        , m_dropped(0)
+    {
+        sem_init(&m_event, 0, 0);
+    }
+
+    virtual ~JobPath()
+    {
+        sem_destroy(&m_event);
+    }
+
+    virtual const char* getName() const = 0;
+
+    // producer
+    virtual FakeJob* acquire() = 0;
+    virtual bool markDroppable() = 0;
+    virtual void queue(FakeJob* job) = 0;
+
+    // consumer
+    virtual bool take(FakeJob** job) = 0;
+    virtual void release(FakeJob* job) = 0;
+
+    void trigger() { sem_post(&m_event); }
+
+    void consume(const std::atomic<bool>& stop)
+    {
+        while (true)
+        {
+            sem_wait(&m_event);
+
+            // stop is checked before the queue is drained,
+            // so the jobs queued before stop are not missed
+            const bool exiting = stop.load();
+
+            FakeJob* job = NULL;
+            while (take(&job))
+            {
+                int32_t expected = FAKE_JOB_QUEUED;
+                if (!job->queue_state.compare_exchange_strong(expected, FAKE_JOB_HANDLING))
+                {
+                    ++m_dropped;
+                    finish(job);
+                    continue;
+                }
+
+                job->stage_time[JOB_STAGE_DEQUEUE] = nowNs();
+                // a missed vsync now and then piles up the jobs behind
+                spin(job->sequence % STALL_INTERVAL ? HANDLE_NS : STALL_NS);
+                ++m_handled;
+                finish(job);
+            }
+
+            if (exiting)
+                break;
+        }
+    }
+
+    const JobStageTrace& getTrace() const { return m_trace; }
+    uint32_t getHandled() const { return m_handled; }
+    uint32_t getDropped() const { return m_dropped; }
+
+protected:
+    static bool markIfQueued(FakeJob* last)
+    {
+        if (last == NULL || !last->droppable)
+            return false;
+
+        int32_t expected = FAKE_JOB_QUEUED;
+        return last->queue_state.compare_exchange_strong(expected, FAKE_JOB_DROPPED);
+    }
+
+private:
+    void finish(FakeJob* job)
+    {
+        job->stage_time[JOB_STAGE_DONE] = nowNs();
+        m_trace.record(job->stage_time);
+        release(job);
+    }
+
+    sem_t m_event;
+    JobStageTrace m_trace;
+    uint32_t m_handled;
+    uint32_t m_dropped;
+};
+
+// the old path: a job is allocated per frame, the queue is protected by a
+// mutex which both threads take for every access
+class MutexJobPath : public JobPath
+{
+public:
+    const char* getName() const { return "mutex"; }
+
+    FakeJob* acquire()
+    {
+        FakeJob* job = new FakeJob();
+        job->layers = (uint8_t*)calloc(1, NUM_LAYERS * LAYER_SIZE);
+        return job;
+    }
+
+    bool markDroppable()
+    {
+        std::lock_guard<std::mutex> l(m_lock);
+        return !m_queue.empty() && markIfQueued(m_queue.back());
+    }
+
+    void queue(FakeJob* job)
+    {
+        std::lock_guard<std::mutex> l(m_lock);
+        m_queue.push_back(job);
+    }
+
+    bool take(FakeJob** job)
+    {
+        std::lock_guard<std::mutex> l(m_lock);
+        if (m_queue.empty())
+            return false;
+
+        *job = m_queue.front();
+        m_queue.pop_front();
+        return true;
+    }
+
+    void release(FakeJob* job)
+    {
+        free(job->layers);
+        delete job;
+    }
+
+private:
+    std::mutex m_lock;
+    std::deque<FakeJob*> m_queue;
+};
+
+// the new path: preallocated jobs and layers, and a lock-free queue
+class RingJobPath : public JobPath
+{
+public:
+    RingJobPath()
+        : m_last(NULL)
+        , m_heap_count(0)
+    {
+        for (int i = 0; i < POOL_DEPTH; ++i)
+        {
+            m_layers[i] = (uint8_t*)malloc(NUM_LAYERS * LAYER_SIZE);
+        }
+    }
+
+    ~RingJobPath()
+    {
+        for (int i = 0; i < POOL_DEPTH; ++i)
+        {
+            free(m_layers[i]);
+        }
+    }
+
+    const char* getName() const { return "ring"; }
+
+    FakeJob* acquire()
+    {
+        FakeJob* job = m_pool.acquire();
+        if (job == NULL)
+        {
+            ++m_heap_count;
+            job = new FakeJob();
+            job->layers = (uint8_t*)calloc(1, NUM_LAYERS * LAYER_SIZE);
+            return job;
+        }
+
+        job->layers = m_layers[m_pool.getSlot(job)];
+        memset(job->layers, 0, NUM_LAYERS * LAYER_SIZE);
+        return job;
+    }
+
+    bool markDroppable()
+    {
+        return !m_queue.empty() && m_pool.owns(m_last) &&
+            m_last->queue_state.load() == FAKE_JOB_QUEUED && markIfQueued(m_last);
+    }
+
+    void queue(FakeJob* job)
+    {
+        while (!m_queue.push(job))
+        {
+            std::this_thread::yield();
+        }
+        m_last = job;
+    }
+
+    bool take(FakeJob** job)
+    {
+        return m_queue.pop(job);
+    }
+
+    void release(FakeJob* job)
+    {
+        if (m_pool.owns(job))
+        {
+            m_pool.release(job);
+        }
+        else
+        {
+            free(job->layers);
+            delete job;
+        }
+    }
+
+    uint32_t getHeapCount() const { return m_heap_count; }
+    uint32_t getFreeNum() const { return m_pool.getFreeNum(); }
+
+private:
+    ObjectPool<FakeJob, POOL_DEPTH> m_pool;
+    SpscRing<FakeJob*, QUEUE_DEPTH> m_queue;
+    uint8_t* m_layers[POOL_DEPTH];
+    FakeJob* m_last;
+    uint32_t m_heap_count;
+};
+
+// ---------------------------------------------------------------------------
+
+static bool replay(JobPath* path, const int frames, const bool async)
+{
+    std::atomic<bool> stop(false);
+    std::thread consumer(&JobPath::consume, path, std::cref(stop));
+
+    uint32_t marked = 0;
+    int64_t deadline = nowNs();
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        FakeJob* job = path->acquire();
+        job->stage_time[JOB_STAGE_ACQUIRE] = nowNs();
+        job->sequence = frame;
+        // jobs with gles composition are never dropped
+        job->droppable = (frame % 4) != 0;
+        for (int i = 0; i < NUM_LAYERS; ++i)
+        {
+            memset(job->layers + i * LAYER_SIZE, frame & 0xff, LAYER_SIZE / 2);
+        }
+        job->stage_time[JOB_STAGE_SET] = nowNs();
+
+        if (async && path->markDroppable())
+            ++marked;
+
+        job->stage_time[JOB_STAGE_QUEUE] = nowNs();
+        job->queue_state.store(FAKE_JOB_QUEUED);
+        path->queue(job);
+        path->trigger();
+
+        deadline += FRAME_PERIOD_NS;
+        sleepUntil(deadline);
+    }
+
+    stop.store(true);
+    path->trigger();
+    consumer.join();
+
+    const JobStageTrace& trace = path->getTrace();
+    printf("%-6s %-5s frames:%d handled:%u dropped:%u(marked:%u) "
+           "dispatch p50:%7.1f us p90:%7.1f us p99:%7.1f us max:%7.1f us  queue p99:%6.1f us\n",
+        path->getName(), async ? "async" : "sync", frames, path->getHandled(), path->getDropped(), marked,
+        trace.getPercentile(JobStageTrace::INTERVAL_DISPATCH, 50) / 1e3,
+        trace.getPercentile(JobStageTrace::INTERVAL_DISPATCH, 90) / 1e3,
+        trace.getPercentile(JobStageTrace::INTERVAL_DISPATCH, 99) / 1e3,
+        trace.getPercentile(JobStageTrace::INTERVAL_DISPATCH, 100) / 1e3,
+        trace.getPercentile(JobStageTrace::INTERVAL_QUEUE, 99) / 1e3);
+
+    // every job is released once, and a job is dropped only if it was marked
+    return path->getHandled() + path->getDropped() == static_cast<uint32_t>(frames) &&
+           path->getDropped() == marked;
+}
+
+// push a sequence through SpscRing as fast as possible, it must keep order
+static bool checkRingOrder()
+{
+    const uint32_t count = 1 << 20;
+    SpscRing<uint32_t, QUEUE_DEPTH> ring;
+    bool ok = true;
+
+    std::thread consumer([&ring, &ok, count]() {
+        uint32_t expected = 0;
+        while (expected < count)
+        {
+            uint32_t val = 0;
+            if (!ring.pop(&val))
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            if (val != expected)
+                ok = false;
+            ++expected;
+        }
+    });
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        while (!ring.push(i))
+        {
+            std::this_thread::yield();
+        }
+    }
+    consumer.join();
+
+    printf("ring order: %u items %s\n", count, ok ? "in order" : "OUT OF ORDER");
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    int frames = DEFAULT_FRAMES;
+    if (argc > 1)
+        frames = atoi(argv[1]);
+    if (frames <= 0)
+        frames = DEFAULT_FRAMES;
+
+    bool ok = checkRingOrder();
+
+    for (int async = 0; async <= 1; ++async)
+    {
+        MutexJobPath mutex_path;
+        ok &= replay(&mutex_path, frames, async);
+
+        RingJobPath ring_path;
+        ok &= replay(&ring_path, frames, async);
+        if (ring_path.getFreeNum() != POOL_DEPTH)
+        {
+            printf("job pool leaks: %u/%d free\n", ring_path.getFreeNum(), POOL_DEPTH);
+            ok = false;
+        }
+        printf("ring   heap jobs:%u\n", ring_path.getHeapCount());
+    }
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,644 @@
+// fence_set_test: FenceSet on sw_sync timelines without the display driver.
+//
+// The fences come from sw_sync (/sys/kernel/debug/sync/sw_sync) if the kernel
+// has it; otherwise from a fake timeline of eventfds, which are pollable like
+// sync fences, so the test runs on a stock Linux host too.
+//
+// The checks cover the status check, the timeout, the errors of merge, and
+// that no fd leaks. Then frames with a fence per layer from its own timeline
+// are replayed, with a part of the fences signaled before the wait, and
+//  - old : a sync_wait() (poll of one fd) per fence, and a chain of merges
+//  - new : FenceSet, one poll for all fences, a balanced tree of merges
+// are compared by syscalls, merged points, and time per frame.
+//
+// usage: fence_set_test [frames]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <linux/sync_file.h>
+
+#include "../fence_set.h"
+
+#define DEFAULT_FRAMES      (300)
+#define SIGNALED_PERCENT    (50)
+
+static uint64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+static int countOpenFds()
+{
+    int num = 0;
+    DIR* dir = opendir("/proc/self/fd");
+    if (dir == NULL)
+        return -1;
+
+    while (readdir(dir) != NULL)
+        ++num;
+    closedir(dir);
+    return num;
+}
+
+static bool isSignaled(const int& fd)
+{
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    return ::poll(&pfd, 1, 0) > 0;
+}
+
+// ---------------------------------------------------------------------------
+
+// FenceBackend creates timelines and fences, and merges them
+class FenceBackend
+{
+public:
+    virtual ~FenceBackend() { }
+
+    virtual const char* getName() const = 0;
+
+    virtual int createTimeline() = 0;
+
+    virtual void destroyTimeline(const int& timeline) = 0;
+
+    // createFence() returns a fence which is signaled when the timeline
+    // reaches value
+    virtual int createFence(const int& timeline, const uint32_t& value) = 0;
+
+    virtual void inc(const int& timeline) = 0;
+
+    virtual int merge(int fd1, int fd2, const char* name) = 0;
+
+    // getPointCount() returns the number of sync points in a fence
+    // if the backend knows, or 0
+    virtual size_t getPointCount(const int& /*fd*/) { return 0; }
+
+    // a merge which fails from the n-th call, for the error path
+    int m_fail_after = -1;
+};
+
+static FenceBackend* g_backend = NULL;
+
+// the sync points copied into merged fences, a merge costs in proportion
+static uint64_t g_merged_points = 0;
+
+static int mergeFence(int fd1, int fd2, const char* name)
+{
+    if (g_backend->m_fail_after == 0)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+    if (g_backend->m_fail_after > 0)
+        --g_backend->m_fail_after;
+
+    const int fd = g_backend->merge(fd1, fd2, name);
+    if (fd >= 0)
+        g_merged_points += g_backend->getPointCount(fd);
+    return fd;
+}
+
+struct sw_sync_create_fence_data
+{
+    uint32_t value;
+    char name[32];
+    int32_t fence;
+};
+
+#define SW_SYNC_IOC_MAGIC           'W'
+#define SW_SYNC_IOC_CREATE_FENCE    _IOWR(SW_SYNC_IOC_MAGIC, 0, struct sw_sync_create_fence_data)
+#define SW_SYNC_IOC_INC             _IOW(SW_SYNC_IOC_MAGIC, 1, uint32_t)
+
+class SwSyncBackend : public FenceBackend
+{
+public:
+    static bool isAvailable()
+    {
+        const int fd = open("/sys/kernel/debug/sync/sw_sync", O_RDWR);
+        if (fd < 0)
+            return false;
+        close(fd);
+        return true;
+    }
+
+    const char* getName() const { return "sw_sync"; }
+
+    int createTimeline() { return open("/sys/kernel/debug/sync/sw_sync", O_RDWR); }
+
+    void destroyTimeline(const int& timeline) { close(timeline); }
+
+    int createFence(const int& timeline, const uint32_t& value)
+    {
+        struct sw_sync_create_fence_data data;
+        memset(&data, 0, sizeof(data));
+        data.value = value;
+        strncpy(data.name, "test", sizeof(data.name) - 1);
+        if (ioctl(timeline, SW_SYNC_IOC_CREATE_FENCE, &data) < 0)
+            return -1;
+        return data.fence;
+    }
+
+    void inc(const int& timeline)
+    {
+        uint32_t count = 1;
+        ioctl(timeline, SW_SYNC_IOC_INC, &count);
+    }
+
+    int merge(int fd1, int fd2, const char* name)
+    {
+        struct sync_merge_data data;
+        memset(&data, 0, sizeof(data));
+        data.fd2 = fd2;
+        strncpy(data.name, name, sizeof(data.name) - 1);
+        if (ioctl(fd1, SYNC_IOC_MERGE, &data) < 0)
+            return -1;
+        return data.fence;
+    }
+};
+
+// FakeBackend signals an eventfd when all of its points are reached;
+// like a sync_file, a merged fence keeps one point per timeline
+class FakeBackend : public FenceBackend
+{
+public:
+    ~FakeBackend()
+    {
+        for (auto& item : m_fences)
+        {
+            close(item.second->signal_fd);
+        }
+    }
+
+    const char* getName() const { return "eventfd"; }
+
+    int createTimeline()
+    {
+        std::lock_guard<std::mutex> l(m_lock);
+        m_timelines.push_back(0);
+        return static_cast<int>(m_timelines.size() - 1);
+    }
+
+    // like sw_sync, the fences of a destroyed timeline are signaled
+    void destroyTimeline(const int& timeline)
+    {
+        std::lock_guard<std::mutex> l(m_lock);
+        m_timelines[timeline] = UINT32_MAX;
+        signalLocked();
+    }
+
+    int createFence(const int& timeline, const uint32_t& value)
+    {
+        std::map<int, uint32_t> points;
+        points[timeline] = value;
+        return createFence(points);
+    }
+
+    void inc(const int& timeline)
+    {
+        std::lock_guard<std::mutex> l(m_lock);
+        ++m_timelines[timeline];
+        signalLocked();
+    }
+
+    int merge(int fd1, int fd2, const char* /*name*/)
+    {
+        std::map<int, uint32_t> points;
+        {
+            std::lock_guard<std::mutex> l(m_lock);
+            const FakeFence* fences[2] = { findLocked(fd1), findLocked(fd2) };
+            for (const FakeFence* fence : fences)
+            {
+                if (fence == NULL)
+                    continue;
+
+                for (const auto& point : fence->points)
+                {
+                    uint32_t& value = points[point.first];
+                    value = std::max(value, point.second);
+                }
+            }
+        }
+        return createFence(points);
+    }
+
+    size_t getPointCount(const int& fd)
+    {
+        std::lock_guard<std::mutex> l(m_lock);
+        const FakeFence* fence = findLocked(fd);
+        return fence ? fence->points.size() : 0;
+    }
+
+private:
+    struct FakeFence
+    {
+        // the eventfd kept by the backend to signal the fence
+        int signal_fd;
+        std::map<int, uint32_t> points;
+    };
+
+    int createFence(const std::map<int, uint32_t>& points)
+    {
+        const int fd = eventfd(0, EFD_CLOEXEC);
+        if (fd < 0)
+            return -1;
+
+        std::lock_guard<std::mutex> l(m_lock);
+        std::shared_ptr<FakeFence> fence(new FakeFence);
+        fence->signal_fd = dup(fd);
+        fence->points = points;
+        if (isReachedLocked(*fence))
+        {
+            const uint64_t one = 1;
+            if (write(fd, &one, sizeof(one)) != sizeof(one))
+                perror("eventfd write");
+            close(fence->signal_fd);
+            m_by_fd.erase(fd);
+            return fd;
+        }
+
+        m_fences[fence->signal_fd] = fence;
+        m_by_fd[fd] = fence;
+        return fd;
+    }
+
+    void signalLocked()
+    {
+        for (auto it = m_fences.begin(); it != m_fences.end();)
+        {
+            if (!isReachedLocked(*it->second))
+            {
+                ++it;
+                continue;
+            }
+
+            const uint64_t one = 1;
+            if (write(it->second->signal_fd, &one, sizeof(one)) != sizeof(one))
+                perror("eventfd write");
+            close(it->second->signal_fd);
+            it = m_fences.erase(it);
+        }
+    }
+
+    bool isReachedLocked(const FakeFence& fence) const
+    {
+        for (const auto& point : fence.points)
+        {
+            if (m_timelines[point.first] < point.second)
+                return false;
+        }
+        return true;
+    }
+
+    // the fd of a signaled fence is not tracked any more
+    const FakeFence* findLocked(const int& fd) const
+    {
+        auto it = m_by_fd.find(fd);
+        if (it == m_by_fd.end())
+            return NULL;
+
+        auto live = m_fences.find(it->second->signal_fd);
+        if (live == m_fences.end() || live->second != it->second)
+            return NULL;
+        return it->second.get();
+    }
+
+    std::mutex m_lock;
+    std::vector<uint32_t> m_timelines;
+    std::map<int, std::shared_ptr<FakeFence> > m_fences;
+    std::map<int, std::shared_ptr<FakeFence> > m_by_fd;
+};
+
+// ---------------------------------------------------------------------------
+
+#define CHECK(cond)                                                 \
+    do {                                                            \
+        if (!(cond))                                                \
+        {                                                           \
+            printf("  check failed at line %d: %s\n", __LINE__, #cond); \
+            ok = false;                                             \
+        }                                                           \
+    } while (0)
+
+static bool checkFenceSet()
+{
+    bool ok = true;
+    const int fds_before = countOpenFds();
+    const int timeline = g_backend->createTimeline();
+
+    // an empty set
+    {
+        FenceSet fences(mergeFence);
+        int merged_fd = 0;
+        CHECK(fences.wait(0) == 0);
+        CHECK(fences.merge("empty", &merged_fd) == 0 && merged_fd == -1);
+        CHECK(fences.add(-1) && fences.isEmpty());
+        CHECK(!fences.add(2));
+    }
+
+    // the status check removes the signaled fences only
+    {
+        FenceSet fences(mergeFence);
+        g_backend->inc(timeline);
+        CHECK(fences.add(g_backend->createFence(timeline, 1)));
+        CHECK(fences.add(g_backend->createFence(timeline, 2)));
+        CHECK(fences.add(g_backend->createFence(timeline, 3)));
+        CHECK(fences.poll(0) == 2);
+        CHECK(fences.getPollCount() == 1);
+
+        CHECK(fences.wait(10) == -ETIME && fences.size() == 2);
+        g_backend->inc(timeline);
+        g_backend->inc(timeline);
+        CHECK(fences.wait(1000) == 0 && fences.isEmpty());
+    }
+
+    // the merged fence is signaled only after all fences
+    for (int num = 1; num <= 20; ++num)
+    {
+        std::vector<int> timelines;
+        FenceSet fences(mergeFence);
+        for (int i = 0; i < num; ++i)
+        {
+            timelines.push_back(g_backend->createTimeline());
+            CHECK(fences.add(g_backend->createFence(timelines.back(), 1)));
+        }
+
+        int merged_fd = -1;
+        CHECK(fences.merge("tree", &merged_fd) == 0 && merged_fd >= 0 && fences.isEmpty());
+        CHECK(fences.getMergeCount() == static_cast<uint32_t>(num - 1));
+        if (g_backend->getPointCount(merged_fd))
+            CHECK(g_backend->getPointCount(merged_fd) == static_cast<size_t>(num));
+
+        for (int i = 0; i < num; ++i)
+        {
+            CHECK(!isSignaled(merged_fd));
+            g_backend->inc(timelines[i]);
+        }
+        CHECK(isSignaled(merged_fd));
+        close(merged_fd);
+
+        for (const int& tl : timelines)
+        {
+            g_backend->destroyTimeline(tl);
+        }
+    }
+
+    // a failed merge keeps the fences, and closes the fences it created
+    {
+        const int tl = g_backend->createTimeline();
+        FenceSet fences(mergeFence);
+        for (int i = 0; i < 9; ++i)
+        {
+            CHECK(fences.add(g_backend->createFence(tl, 1 + i)));
+        }
+
+        int merged_fd = -1;
+        g_backend->m_fail_after = 5;
+        CHECK(fences.merge("fail", &merged_fd) == -ENOMEM && merged_fd == -1 && fences.size() == 9);
+        g_backend->m_fail_after = -1;
+        fences.clear();
+        g_backend->destroyTimeline(tl);
+    }
+
+    // a full set gives the fence back
+    {
+        const int tl = g_backend->createTimeline();
+        FenceSet fences(mergeFence);
+        for (int i = 0; i < FenceSet::MAX_FENCE_NUM; ++i)
+        {
+            CHECK(fences.add(g_backend->createFence(tl, 1)));
+        }
+        const int fd = g_backend->createFence(tl, 1);
+        CHECK(!fences.add(fd));
+        close(fd);
+        g_backend->destroyTimeline(tl);
+    }
+
+    g_backend->destroyTimeline(timeline);
+
+    const int fds_after = countOpenFds();
+    printf("fence set: %s (fds %d -> %d)\n", ok ? "ok" : "FAILED", fds_before, fds_after);
+    return ok && fds_before == fds_after;
+}
+
+// ---------------------------------------------------------------------------
+
+struct FrameStat
+{
+    FrameStat() : syscalls(0), merges(0), points(0), ns(0) { }
+
+    uint64_t syscalls;
+    uint64_t merges;
+    uint64_t points;
+    uint64_t ns;
+};
+
+// the fences of a frame; every layer has its own timeline, and a part of
+// them is signaled before the frame is waited
+class Frame
+{
+public:
+    Frame(const int& num_layers, const int& frame)
+    {
+        for (int i = 0; i < num_layers; ++i)
+        {
+            const int timeline = g_backend->createTimeline();
+            m_timelines.push_back(timeline);
+            m_fds.push_back(g_backend->createFence(timeline, 1));
+            if ((i * 37 + frame * 11) % 100 < SIGNALED_PERCENT)
+                g_backend->inc(timeline);
+            else
+                m_pending.push_back(timeline);
+        }
+    }
+
+    ~Frame()
+    {
+        for (const int& timeline : m_timelines)
+        {
+            g_backend->destroyTimeline(timeline);
+        }
+    }
+
+    // signal() signals the rest of the fences from another thread,
+    // like the GPU which finishes the layers one by one
+    std::thread signal()
+    {
+        std::vector<int> pending = m_pending;
+        return std::thread([pending]() {
+            for (const int& timeline : pending)
+            {
+                std::this_thread::yield();
+                g_backend->inc(timeline);
+            }
+        });
+    }
+
+    const std::vector<int>& getFds() const { return m_fds; }
+
+private:
+    std::vector<int> m_timelines;
+    std::vector<int> m_pending;
+    std::vector<int> m_fds;
+};
+
+static void waitOld(const Frame& frame, FrameStat* stat)
+{
+    for (const int& fd : frame.getFds())
+    {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        ++stat->syscalls;
+        while (::poll(&pfd, 1, 1000) < 0 && errno == EINTR)
+        {
+            ++stat->syscalls;
+        }
+        close(fd);
+    }
+}
+
+static void waitNew(const Frame& frame, FrameStat* stat)
+{
+    FenceSet fences(mergeFence);
+    for (const int& fd : frame.getFds())
+    {
+        fences.add(fd);
+    }
+    fences.wait(1000);
+    stat->syscalls += fences.getPollCount();
+}
+
+static int mergeOld(const Frame& frame, FrameStat* stat)
+{
+    int merged_fd = -1;
+    for (const int& fd : frame.getFds())
+    {
+        if (merged_fd < 0)
+        {
+            merged_fd = mergeFence(fd, fd, "chain");
+        }
+        else
+        {
+            const int next_fd = mergeFence(merged_fd, fd, "chain");
+            close(merged_fd);
+            merged_fd = next_fd;
+        }
+        ++stat->merges;
+        close(fd);
+    }
+    return merged_fd;
+}
+
+static int mergeNew(const Frame& frame, FrameStat* stat)
+{
+    FenceSet fences(mergeFence);
+    for (const int& fd : frame.getFds())
+    {
+        fences.add(fd);
+    }
+
+    int merged_fd = -1;
+    fences.merge("tree", &merged_fd);
+    stat->merges += fences.getMergeCount();
+    stat->syscalls += fences.getPollCount();
+    return merged_fd;
+}
+
+static bool replay(const int& num_layers, const int& frames)
+{
+    FrameStat wait_stat[2];
+    FrameStat merge_stat[2];
+    bool ok = true;
+
+    for (int i = 0; i < frames; ++i)
+    {
+        for (int path = 0; path < 2; ++path)
+        {
+            {
+                Frame frame(num_layers, i);
+                const uint64_t begin = nowNs();
+                std::thread signaler = frame.signal();
+                if (path == 0)
+                    waitOld(frame, &wait_stat[path]);
+                else
+                    waitNew(frame, &wait_stat[path]);
+                wait_stat[path].ns += nowNs() - begin;
+                signaler.join();
+            }
+
+            {
+                Frame frame(num_layers, i);
+                const uint64_t begin = nowNs();
+                const uint64_t points = g_merged_points;
+                const int merged_fd = path == 0 ?
+                    mergeOld(frame, &merge_stat[path]) : mergeNew(frame, &merge_stat[path]);
+                merge_stat[path].ns += nowNs() - begin;
+                merge_stat[path].points += g_merged_points - points;
+
+                // the merged fence must wait for the pending layers
+                std::thread signaler = frame.signal();
+                signaler.join();
+                if (merged_fd >= 0)
+                {
+                    ok &= isSignaled(merged_fd);
+                    close(merged_fd);
+                }
+            }
+        }
+    }
+
+    printf("layers:%2d  wait  old: %5.1f polls %6.1f us   new: %5.1f polls %6.1f us\n",
+        num_layers,
+        wait_stat[0].syscalls / static_cast<double>(frames), wait_stat[0].ns / 1e3 / frames,
+        wait_stat[1].syscalls / static_cast<double>(frames), wait_stat[1].ns / 1e3 / frames);
+    printf("           merge old: %5.1f merges %5.1f points %6.1f us   new: %5.1f merges %5.1f points %6.1f us\n",
+        merge_stat[0].merges / static_cast<double>(frames), merge_stat[0].points / static_cast<double>(frames),
+        merge_stat[0].ns / 1e3 / frames,
+        merge_stat[1].merges / static_cast<double>(frames), merge_stat[1].points / static_cast<double>(frames),
+        merge_stat[1].ns / 1e3 / frames);
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    int frames = DEFAULT_FRAMES;
+    if (argc > 1)
+        frames = atoi(argv[1]);
+    if (frames <= 0)
+        frames = DEFAULT_FRAMES;
+
+    std::unique_ptr<FenceBackend> backend;
+    if (SwSyncBackend::isAvailable())
+        backend.reset(new SwSyncBackend());
+    else
+        backend.reset(new FakeBackend());
+    g_backend = backend.get();
+    printf("backend: %s\n", g_backend->getName());
+
+    bool ok = checkFenceSet();
+
+    const int layer_nums[] = { 4, 8, 16 };
+    for (const int& num_layers : layer_nums)
+    {
+        ok &= replay(num_layers, frames);
+    }
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,840 @@
+// frame_replay: replay a frame trace (frame_trace.h) without the display driver.
+//
+// A trace is recorded on the device by HWCMediator when debug.hwc.frame_trace
+// is set to a number of frames (see FRAME_TRACE_PATH in hwc2.cpp).
+// validateDisplay and presentDisplay of hwc2.cpp need the driver, gralloc and
+// the rest of the composer, so they can not run here; the trace records what
+// they decided from, and each frame is replayed through the portable parts:
+//  - validate: the fingerprint of the recorded layer states, built by the
+//    same addValiDisplayState()/addValiLayerState() as the device, and the
+//    plan cache; on a miss, HrtModel as the mock of
+//    DispDevice::queryValidLayer() with the layer configs and the GLES range
+//    which the device gave to its query
+//  - present : the acquire fences of the updated layers as eventfds in a
+//    FenceSet (mock SyncFence), the overlay inputs through OvlConfigDiff
+//    (mock display driver), and a counted job per updated MDP layer
+//    (mock bliter)
+// The output is the cpu time per frame of the replay and of the device, the
+// composition types, the plan cache hit ratio, and how often the GLES range of
+// HrtModel agrees with the one decided on the device. A frame whose
+// fingerprint is not the one of the device fails the replay.
+//
+// Without a trace, a synthetic trace of home screen, video, scrolling and a
+// dragged popup is written and read back first. Its GLES ranges are the ones
+// the display driver gives for 4 ovl inputs, written down per scene and not
+// computed by HrtModel, so the replay must agree with every frame of it.
+//
+// usage: frame_replay [-c] [-o max_ovl_layers] [trace]
+//        frame_replay -s frames trace   (write a synthetic trace, then replay it)
+//   -c  print a line per frame (csv)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include <hardware/hwcomposer2.h>
+
+#include "../frame_trace.h"
+#include "../fence_set.h"
+#include "../hrt_model.h"
+#include "../ovl_config_diff.h"
+#include "../vali_cache.h"
+
+#define DEFAULT_SYNTH_FRAMES    (1200)
+#define DEFAULT_SYNTH_PATH      "/data/local/tmp/hwc_frame_synth.trace"
+#define DISP_WIDTH              (1080)
+#define DISP_HEIGHT             (2160)
+
+// the same as HWC_LAYER_TYPE_* of dispatcher.h
+enum
+{
+    REPLAY_LAYER_TYPE_UI    = 2,
+    REPLAY_LAYER_TYPE_MM    = 3,
+    REPLAY_LAYER_TYPE_DIM   = 4,
+};
+
+// the formats of the synthetic layers, only their difference matters
+enum
+{
+    SYNTH_FORMAT_RGBA       = 1,
+    SYNTH_FORMAT_YV12       = 0x32315659,
+};
+
+static uint64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t s_rand = 2463534242u;
+
+static uint32_t xorshift32()
+{
+    s_rand ^= s_rand << 13;
+    s_rand ^= s_rand >> 17;
+    s_rand ^= s_rand << 5;
+    return s_rand;
+}
+
+static bool isGles(const int32_t& i, const int32_t& head, const int32_t& tail)
+{
+    return head != -1 && i >= head && i <= tail;
+}
+
+// ---------------------------------------------------------------------------
+
+// the composition which validate decides for one frame
+struct ReplayPlan
+{
+    ReplayPlan() : valid(false), from_model(false), fingerprint(0), gles_head(-1), gles_tail(-1) { }
+
+    bool valid;
+    // the GLES range is decided by HrtModel, not taken from the device
+    bool from_model;
+    uint64_t fingerprint;
+    int32_t gles_head;
+    int32_t gles_tail;
+    std::vector<layer_config> configs;
+};
+
+// arbitrate() decides the GLES range of a frame with FRAME_TRACE_HRT_QUERY:
+// HrtModel gets the layer configs and the GLES range which validate gave to
+// the hrt query on the device
+static bool arbitrate(
+    HrtArbiter* arbiter, const FrameTraceFrame& frame, const std::vector<FrameTraceLayer>& layers,
+    ReplayPlan* plan)
+{
+    const int32_t num = static_cast<int32_t>(layers.size());
+    plan->gles_head = frame.hrt_gles_head;
+    plan->gles_tail = frame.hrt_gles_tail;
+    plan->configs.resize(layers.size());
+    for (int32_t i = 0; i < num; ++i)
+    {
+        const FrameTraceLayer& layer = layers[i];
+        layer_config* config = &plan->configs[i];
+        memset(config, 0, sizeof(*config));
+        config->ovl_id = -1;
+        config->ext_sel_layer = -1;
+        config->src_fmt = layer.hrt_src_fmt;
+        config->dst_offset_x = layer.hrt_dst_offset_x;
+        config->dst_offset_y = layer.hrt_dst_offset_y;
+        config->dst_width = layer.hrt_dst_width;
+        config->dst_height = layer.hrt_dst_height;
+        config->src_width = layer.hrt_src_width;
+        config->src_height = layer.hrt_src_height;
+        config->layer_caps = layer.hrt_layer_caps;
+    }
+
+    if (num == 0)
+        return true;
+
+    disp_layer_info disp_layer;
+    memset(&disp_layer, 0, sizeof(disp_layer));
+    disp_layer.input_config[0] = &plan->configs[0];
+    disp_layer.layer_num[0] = num;
+    disp_layer.disp_mode[0] = DISP_SESSION_DIRECT_LINK_MODE;
+    disp_layer.gles_head[0] = plan->gles_head;
+    disp_layer.gles_tail[0] = plan->gles_tail;
+    disp_layer.gles_head[1] = -1;
+    disp_layer.gles_tail[1] = -1;
+    disp_layer.hrt_num = -1;
+    if (!arbiter->queryValidLayer(&disp_layer))
+    {
+        // all layers go to the client target, as HWC does when the query fails
+        plan->gles_head = 0;
+        plan->gles_tail = num - 1;
+        return false;
+    }
+
+    plan->gles_head = disp_layer.gles_head[0];
+    plan->gles_tail = disp_layer.gles_tail[0];
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+
+// the result of one replayed frame
+struct ReplayFrame
+{
+    uint64_t validate_ns;
+    uint64_t present_ns;
+    bool cache_hit;
+    // the fingerprint is the one of the device
+    bool fingerprint_match;
+    // the GLES range is decided by HrtModel, so it is compared with the device
+    bool compared;
+    int32_t gles_head;
+    int32_t gles_tail;
+    uint32_t client_num;
+    uint32_t device_num;
+    uint32_t mdp_num;
+    uint32_t dim_num;
+    uint32_t fence_num;
+    uint32_t mdp_jobs;
+    uint32_t pushed_inputs;
+};
+
+class Replayer
+{
+public:
+    explicit Replayer(const int32_t& max_ovl_layers)
+        : m_max_ovl_layers(max_ovl_layers)
+        , m_hrt(max_ovl_layers, HRT_MODEL_HRT_LIMIT)
+        , m_cache_hit(0)
+        , m_mdp_jobs(0)
+    {
+    }
+
+    void replay(const FrameTraceFrame& frame, const std::vector<FrameTraceLayer>& layers, ReplayFrame* result)
+    {
+        memset(result, 0, sizeof(*result));
+        ReplayPlan& plan = m_plans[frame.disp_id];
+
+        // validate
+        uint64_t start = nowNs();
+        const uint64_t fingerprint = calculateFrameTraceFingerprint(frame, layers.data());
+        if (plan.valid && plan.fingerprint == fingerprint)
+        {
+            result->cache_hit = true;
+            ++m_cache_hit;
+        }
+        else if (frame.flags & FRAME_TRACE_HRT_QUERY)
+        {
+            arbitrate(&m_hrt, frame, layers, &plan);
+            plan.from_model = true;
+        }
+        else
+        {
+            // the device did not query on this frame, its plan is taken as it is
+            plan.gles_head = frame.gles_head;
+            plan.gles_tail = frame.gles_tail;
+            plan.from_model = false;
+        }
+        plan.fingerprint = fingerprint;
+        plan.valid = true;
+        result->validate_ns = nowNs() - start;
+        result->fingerprint_match = fingerprint == frame.vali_fingerprint;
+        result->compared = plan.from_model;
+        result->gles_head = plan.gles_head;
+        result->gles_tail = plan.gles_tail;
+
+        // present
+        start = nowNs();
+        present(frame, layers, plan, result);
+        result->present_ns = nowNs() - start;
+    }
+
+    uint64_t getCacheHit() const { return m_cache_hit; }
+    uint32_t getQueryCount() const { return m_hrt.getQueryCount(); }
+    uint64_t getMdpJobs() const { return m_mdp_jobs; }
+
+    OvlConfigDiffStats getDiffStats() const
+    {
+        OvlConfigDiffStats stats;
+        for (auto& diff : m_diffs)
+        {
+            stats.frames += diff.second.getStats().frames;
+            stats.full_frames += diff.second.getStats().full_frames;
+            stats.dropped_frames += diff.second.getStats().dropped_frames;
+            stats.inputs += diff.second.getStats().inputs;
+            stats.pushed += diff.second.getStats().pushed;
+        }
+        return stats;
+    }
+
+private:
+    // signaledFence() is a mock acquire fence, which is already signaled as
+    // most acquire fences are at present
+    static int signaledFence()
+    {
+        const int fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (fd >= 0)
+        {
+            const uint64_t val = 1;
+            if (write(fd, &val, sizeof(val)) != sizeof(val))
+            {
+                close(fd);
+                return -1;
+            }
+        }
+        return fd;
+    }
+
+    void present(
+        const FrameTraceFrame& frame, const std::vector<FrameTraceLayer>& layers,
+        const ReplayPlan& plan, ReplayFrame* result)
+    {
+        FenceSet fences;
+        OvlConfigDiff& diff = m_diffs[frame.disp_id];
+        std::map<uint64_t, uint32_t>& buffer_idx = m_buffer_idx[frame.disp_id];
+
+        diff.beginFrame();
+        int32_t ovl_id = 0;
+        for (size_t i = 0; i < layers.size(); ++i)
+        {
+            const FrameTraceLayer& layer = layers[i];
+            const bool is_gles = isGles(i, plan.gles_head, plan.gles_tail);
+            const bool is_dim = layer.hwlayer_type == REPLAY_LAYER_TYPE_DIM;
+            const bool is_mdp = layer.flags & FRAME_TRACE_LAYER_MDP;
+            const bool updated = layer.flags & FRAME_TRACE_LAYER_BUFFER_CHANGED;
+
+            if (is_gles)
+            {
+                ++result->client_num;
+                if (static_cast<int32_t>(i) != plan.gles_tail)
+                    continue;
+            }
+            else if (is_dim)
+            {
+                ++result->dim_num;
+            }
+            else if (is_mdp)
+            {
+                ++result->mdp_num;
+            }
+            else
+            {
+                ++result->device_num;
+            }
+
+            // the client target takes the ovl input at the top of the gles range
+            uint32_t& idx = buffer_idx[is_gles ? ~0ULL : layer.id];
+            if (is_gles || updated)
+            {
+                ++idx;
+                if ((layer.flags & FRAME_TRACE_LAYER_HAS_BUFFER) || is_gles)
+                {
+                    const int fd = signaledFence();
+                    if (fd >= 0 && !fences.add(fd))
+                        close(fd);
+                }
+                if (!is_gles && is_mdp)
+                {
+                    ++result->mdp_jobs;
+                    ++m_mdp_jobs;
+                }
+            }
+
+            if (ovl_id >= m_max_ovl_layers || ovl_id >= OvlConfigDiff::MAX_INPUT_NUM)
+                continue;
+
+            OvlInputKey key;
+            key.layer_enable = 1;
+            key.src_fmt = is_gles ? SYNTH_FORMAT_RGBA : layer.format;
+            key.src_width = is_gles ? frame.disp_width : layer.width;
+            key.src_height = is_gles ? frame.disp_height : layer.height;
+            key.tgt_offset_x = is_gles ? 0 : layer.display_frame[0];
+            key.tgt_offset_y = is_gles ? 0 : layer.display_frame[1];
+            key.tgt_width = is_gles ? frame.disp_width : layer.display_frame[2] - layer.display_frame[0];
+            key.tgt_height = is_gles ? frame.disp_height : layer.display_frame[3] - layer.display_frame[1];
+            key.alpha = static_cast<uint8_t>(layer.plane_alpha * 255);
+            key.security = (layer.flags & FRAME_TRACE_LAYER_SECURE) ? 1 : 0;
+            key.layer_type = is_dim ? 1 : 0;
+            key.next_buff_idx = idx;
+            key.src_fence_fd = idx;
+            key.frm_sequence = frame.sequence;
+            key.dirty_hash = OvlInputKey::hashRects(layer.damage_bounds, 4);
+            diff.update(ovl_id, key);
+            ++ovl_id;
+        }
+
+        // the inputs above the layers are disabled
+        for (; ovl_id < m_max_ovl_layers && ovl_id < OvlConfigDiff::MAX_INPUT_NUM; ++ovl_id)
+            diff.update(ovl_id, OvlInputKey());
+
+        // the mock driver always takes the frame
+        result->pushed_inputs = diff.getChangedNum();
+        diff.endFrame();
+        result->fence_num = fences.size();
+        fences.wait(-1);
+    }
+
+    const int32_t m_max_ovl_layers;
+    HrtModel m_hrt;
+    std::map<uint32_t, ReplayPlan> m_plans;
+    std::map<uint32_t, OvlConfigDiff> m_diffs;
+    std::map<uint32_t, std::map<uint64_t, uint32_t> > m_buffer_idx;
+    uint64_t m_cache_hit;
+    uint64_t m_mdp_jobs;
+};
+
+// ---------------------------------------------------------------------------
+
+// a layer of the synthetic trace, with the states the device would have
+struct SynthLayer
+{
+    ValiLayerState state;
+    int32_t hwlayer_type;
+    bool updated;
+    int32_t damage_top;
+    int32_t damage_bottom;
+};
+
+static SynthLayer makeLayer(
+    const int64_t& id, const int32_t& x, const int32_t& y, const int32_t& w, const int32_t& h,
+    const uint32_t& format, const int32_t& hwlayer_type)
+{
+    SynthLayer layer;
+    memset(&layer, 0, sizeof(layer));
+    layer.state.id = id;
+    layer.state.sf_comp_type = hwlayer_type == REPLAY_LAYER_TYPE_DIM ?
+        HWC2_COMPOSITION_SOLID_COLOR : HWC2_COMPOSITION_DEVICE;
+    layer.state.display_frame.left = x;
+    layer.state.display_frame.top = y;
+    layer.state.display_frame.right = x + w;
+    layer.state.display_frame.bottom = y + h;
+    layer.state.source_crop.right = static_cast<float>(w);
+    layer.state.source_crop.bottom = static_cast<float>(h);
+    layer.state.blend = HWC2_BLEND_MODE_PREMULTIPLIED;
+    layer.state.plane_alpha = 1.0f;
+    layer.state.has_handle = hwlayer_type != REPLAY_LAYER_TYPE_DIM;
+    if (layer.state.has_handle)
+    {
+        layer.state.format = format;
+        layer.state.width = w;
+        layer.state.height = h;
+    }
+    layer.hwlayer_type = hwlayer_type;
+    return layer;
+}
+
+static void setUpdated(SynthLayer* layer, const int32_t& top, const int32_t& bottom)
+{
+    layer->updated = true;
+    layer->damage_top = top;
+    layer->damage_bottom = bottom;
+}
+
+// toTraceLayer() records a synthetic layer as HWCDisplay::getFrameTrace() and
+// Hrt::getFrameTrace() do, with the layer config of Hrt::fillLayerConfigList()
+static FrameTraceLayer toTraceLayer(const SynthLayer& synth, const bool& hrt_query)
+{
+    FrameTraceLayer layer;
+    memset(&layer, 0, sizeof(layer));
+    setFrameTraceValiState(&layer, synth.state);
+    layer.hwlayer_type = synth.hwlayer_type;
+    if (synth.hwlayer_type == REPLAY_LAYER_TYPE_MM)
+        layer.flags |= FRAME_TRACE_LAYER_MDP;
+    if (synth.updated)
+    {
+        layer.flags |= FRAME_TRACE_LAYER_BUFFER_CHANGED;
+        layer.damage_num = 1;
+        layer.damage_bounds[0] = layer.display_frame[0];
+        layer.damage_bounds[1] = synth.damage_top;
+        layer.damage_bounds[2] = layer.display_frame[2];
+        layer.damage_bounds[3] = synth.damage_bottom;
+    }
+
+    if (hrt_query)
+    {
+        const hwc_rect_t& frame = synth.state.display_frame;
+        layer.hrt_dst_offset_x = frame.left;
+        layer.hrt_dst_offset_y = frame.top;
+        layer.hrt_dst_width = frame.right - frame.left;
+        layer.hrt_dst_height = frame.bottom - frame.top;
+        switch (synth.hwlayer_type)
+        {
+            case REPLAY_LAYER_TYPE_DIM:
+                layer.hrt_src_fmt = DISP_FORMAT_DIM;
+                layer.hrt_src_width = layer.hrt_dst_width;
+                layer.hrt_src_height = layer.hrt_dst_height;
+                break;
+
+            case REPLAY_LAYER_TYPE_MM:
+                // MDP scales the video into its mdp_dst_roi, the display frame here
+                layer.hrt_src_fmt = DISP_FORMAT_YUV422;
+                layer.hrt_src_width = layer.hrt_dst_width;
+                layer.hrt_src_height = layer.hrt_dst_height;
+                break;
+
+            default:
+                layer.hrt_src_fmt = DISP_FORMAT_RGBA8888;
+                layer.hrt_src_width = static_cast<uint32_t>(synth.state.source_crop.right - synth.state.source_crop.left);
+                layer.hrt_src_height = static_cast<uint32_t>(synth.state.source_crop.bottom - synth.state.source_crop.top);
+                break;
+        }
+    }
+    return layer;
+}
+
+// buildSynthFrame() builds frame n of four scenes, each of a quarter of frames,
+// and the GLES range which the display driver gives it for 4 ovl inputs:
+// the layers above the fourth go to the client target, from the top one down,
+// and a client range asked by SF grows to the top layer first
+static void buildSynthFrame(
+    const uint32_t& n, const uint32_t& frames, std::vector<SynthLayer>* layers,
+    int32_t* gles_head, int32_t* gles_tail)
+{
+    const uint32_t scene = n * 4 / frames;
+    layers->clear();
+    *gles_head = -1;
+    *gles_tail = -1;
+
+    // wallpaper or app, with the status bar and the navigation bar on top
+    switch (scene)
+    {
+        case 0: // home screen, the launcher is updated now and then; 4 layers fit
+            layers->push_back(makeLayer(1, 0, 0, DISP_WIDTH, DISP_HEIGHT, SYNTH_FORMAT_RGBA, REPLAY_LAYER_TYPE_UI));
+            layers->push_back(makeLayer(2, 0, 0, DISP_WIDTH, DISP_HEIGHT, SYNTH_FORMAT_RGBA, REPLAY_LAYER_TYPE_UI));
+            if (n % 30 == 0)
+                setUpdated(&(*layers)[1], 0, DISP_HEIGHT);
+            break;
+
+        case 1: // video playback with its controls; 4 layers fit
+            layers->push_back(makeLayer(3, 0, 600, DISP_WIDTH, 608, SYNTH_FORMAT_YV12, REPLAY_LAYER_TYPE_MM));
+            setUpdated(&layers->back(), 600, 1208);
+            layers->push_back(makeLayer(4, 0, 1208, DISP_WIDTH, 200, SYNTH_FORMAT_RGBA, REPLAY_LAYER_TYPE_UI));
+            if (n % 10 == 0)
+                setUpdated(&layers->back(), 1208, 1408);
+            break;
+
+        case 2: // scrolling list, a band of the app is damaged each frame; 3 layers fit
+        {
+            layers->push_back(makeLayer(5, 0, 0, DISP_WIDTH, DISP_HEIGHT, SYNTH_FORMAT_RGBA, REPLAY_LAYER_TYPE_UI));
+            const int32_t top = (n * 37) % (DISP_HEIGHT - 200);
+            setUpdated(&layers->back(), top, top + 200);
+            break;
+        }
+
+        default: // a popup over a dim layer is dragged, SF asks gles for a blurred layer now and then
+        {
+            layers->push_back(makeLayer(5, 0, 0, DISP_WIDTH, DISP_HEIGHT, SYNTH_FORMAT_RGBA, REPLAY_LAYER_TYPE_UI));
+            layers->push_back(makeLayer(6, 0, 0, DISP_WIDTH, DISP_HEIGHT, 0, REPLAY_LAYER_TYPE_DIM));
+            const int32_t y = (n * 7) % (DISP_HEIGHT - 800);
+            layers->push_back(makeLayer(7, 100, y, 880, 800, SYNTH_FORMAT_RGBA, REPLAY_LAYER_TYPE_UI));
+            if ((n / 50) % 4 == 3)
+            {
+                // the popup and the status bar above it go to the client target
+                layers->back().state.sf_comp_type = HWC2_COMPOSITION_CLIENT;
+                *gles_head = 2;
+                *gles_tail = 3;
+            }
+            else
+            {
+                // 5 layers, the status bar and the navigation bar go to the client target
+                *gles_head = 3;
+                *gles_tail = 4;
+            }
+            break;
+        }
+    }
+
+    layers->push_back(makeLayer(8, 0, 0, DISP_WIDTH, 72, SYNTH_FORMAT_RGBA, REPLAY_LAYER_TYPE_UI));
+    if (n % 60 == 0)
+        setUpdated(&layers->back(), 0, 72);
+    layers->push_back(makeLayer(9, 0, DISP_HEIGHT - 144, DISP_WIDTH, 144, SYNTH_FORMAT_RGBA, REPLAY_LAYER_TYPE_UI));
+}
+
+// writeSynthTrace() writes a synthetic trace, and reads it back to check
+// that each frame is the same as written
+static bool writeSynthTrace(const char* path, const uint32_t& frames)
+{
+    std::vector<FrameTraceFrame> written_frames;
+    std::vector<std::vector<FrameTraceLayer> > written_layers;
+    FrameTraceWriter writer;
+    if (!writer.open(path, frames))
+    {
+        printf("failed to create %s\n", path);
+        return false;
+    }
+
+    // the display states of a primary display without mirror or hdcp
+    ValiDisplayState disp_state;
+    memset(&disp_state, 0, sizeof(disp_state));
+    disp_state.mirror_src = -1;
+    disp_state.mdp_scale_percentage = 0.1;
+
+    uint64_t last_fingerprint = 0;
+    for (uint32_t n = 0; !writer.isFull(); ++n)
+    {
+        FrameTraceFrame frame;
+        std::vector<SynthLayer> synth_layers;
+        std::vector<FrameTraceLayer> layers;
+        int32_t gles_head = -1, gles_tail = -1;
+        memset(&frame, 0, sizeof(frame));
+        buildSynthFrame(n, frames, &synth_layers, &gles_head, &gles_tail);
+
+        // the fingerprint as HWCDisplay::updateValiFingerprint() builds it
+        // from the layers, not from the trace
+        ValiFingerprint fingerprint;
+        addValiDisplayState(&fingerprint, disp_state, synth_layers.size());
+        for (auto& synth : synth_layers)
+            addValiLayerState(&fingerprint, synth.state);
+
+        // the device reuses its plan without a query when nothing changed
+        const bool hit = n > 0 && fingerprint.get() == last_fingerprint;
+        last_fingerprint = fingerprint.get();
+
+        frame.sequence = writer.getFrameNum();
+        frame.layer_num = synth_layers.size();
+        frame.disp_width = DISP_WIDTH;
+        frame.disp_height = DISP_HEIGHT;
+        frame.gles_head = gles_head;
+        frame.gles_tail = gles_tail;
+        frame.vali_fingerprint = fingerprint.get();
+        setFrameTraceValiState(&frame, disp_state);
+        if (hit)
+        {
+            frame.flags |= FRAME_TRACE_VALI_CACHE_HIT;
+        }
+        else
+        {
+            // validate gives hrt the layers which SF asks for client composition
+            frame.flags |= FRAME_TRACE_HRT_QUERY;
+            frame.hrt_gles_head = -1;
+            frame.hrt_gles_tail = -1;
+            for (size_t i = 0; i < synth_layers.size(); ++i)
+            {
+                if (synth_layers[i].state.sf_comp_type != HWC2_COMPOSITION_CLIENT)
+                    continue;
+                if (frame.hrt_gles_head == -1)
+                    frame.hrt_gles_head = i;
+                frame.hrt_gles_tail = i;
+            }
+        }
+
+        for (size_t i = 0; i < synth_layers.size(); ++i)
+        {
+            layers.push_back(toTraceLayer(synth_layers[i], !hit));
+            layers.back().comp_type = isGles(i, gles_head, gles_tail) ?
+                HWC2_COMPOSITION_CLIENT : layers.back().sf_comp_type;
+        }
+        frame.validate_ns = 150000 + xorshift32() % 100000;
+        frame.present_ns = 300000 + xorshift32() % 200000;
+
+        if (!writer.write(frame, layers.data()))
+        {
+            printf("failed to write frame %u\n", n);
+            return false;
+        }
+        written_frames.push_back(frame);
+        written_layers.push_back(layers);
+    }
+    writer.close();
+
+    FrameTraceReader reader;
+    if (!reader.open(path))
+    {
+        printf("failed to open %s\n", path);
+        return false;
+    }
+
+    FrameTraceFrame frame;
+    std::vector<FrameTraceLayer> layers;
+    size_t n = 0;
+    size_t layer_num = 0;
+    for (; reader.read(&frame, &layers); ++n)
+    {
+        if (n >= written_frames.size() ||
+            memcmp(&frame, &written_frames[n], sizeof(frame)) != 0 ||
+            layers.size() != written_layers[n].size() ||
+            (!layers.empty() && memcmp(&layers[0], &written_layers[n][0], layers.size() * sizeof(layers[0])) != 0))
+        {
+            printf("frame %zu is not the same as written\n", n);
+            return false;
+        }
+        layer_num += layers.size();
+    }
+    if (n != written_frames.size())
+    {
+        printf("read %zu frames, written %zu\n", n, written_frames.size());
+        return false;
+    }
+
+    printf("synthetic trace: %u frames, %zu bytes\n", frames,
+        sizeof(FrameTraceHeader) + n * sizeof(FrameTraceFrame) + layer_num * sizeof(FrameTraceLayer));
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+
+static uint64_t percentile(std::vector<uint64_t> values, const uint32_t& percent)
+{
+    if (values.empty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, values.size() * percent / 100)];
+}
+
+static void printTiming(const char* name, const std::vector<uint64_t>& values)
+{
+    printf("  %-18s p50:%8.2f us p95:%8.2f us max:%8.2f us\n", name,
+        percentile(values, 50) / 1000.0, percentile(values, 95) / 1000.0,
+        percentile(values, 100) / 1000.0);
+}
+
+static bool replayTrace(
+    const char* path, const int32_t& max_ovl_layers, const bool& csv,
+    uint32_t* mismatch, uint32_t* fingerprint_mismatch)
+{
+    FrameTraceReader reader;
+    if (!reader.open(path))
+    {
+        printf("%s is not a frame trace of version %d\n", path, FRAME_TRACE_VERSION);
+        return false;
+    }
+
+    Replayer replayer(max_ovl_layers);
+    FrameTraceFrame frame;
+    std::vector<FrameTraceLayer> layers;
+    std::vector<uint64_t> validate_ns, present_ns, device_validate_ns, device_present_ns;
+    uint64_t comp_types[HWC2_COMPOSITION_SIDEBAND + 1] = { 0 };
+    uint64_t client = 0, device = 0, mdp = 0, dim = 0, fences = 0, pushed = 0;
+    uint64_t device_hit = 0, skip_validate = 0;
+    uint32_t frames = 0, compared = 0;
+
+    *mismatch = 0;
+    *fingerprint_mismatch = 0;
+    if (csv)
+        printf("seq,disp,layers,hit,gles,dev_gles,client,device,mdp,dim,fences,mdp_jobs,pushed,validate_ns,present_ns,dev_validate_ns,dev_present_ns\n");
+
+    while (reader.read(&frame, &layers))
+    {
+        ReplayFrame result;
+        replayer.replay(frame, layers, &result);
+        ++frames;
+
+        validate_ns.push_back(result.validate_ns);
+        present_ns.push_back(result.present_ns);
+        if (!(frame.flags & FRAME_TRACE_SKIP_VALIDATE))
+            device_validate_ns.push_back(frame.validate_ns);
+        device_present_ns.push_back(frame.present_ns);
+        for (auto& layer : layers)
+        {
+            if (layer.comp_type >= 0 && layer.comp_type <= HWC2_COMPOSITION_SIDEBAND)
+                ++comp_types[layer.comp_type];
+        }
+        client += result.client_num;
+        device += result.device_num;
+        mdp += result.mdp_num;
+        dim += result.dim_num;
+        fences += result.fence_num;
+        pushed += result.pushed_inputs;
+        if (frame.flags & FRAME_TRACE_VALI_CACHE_HIT)
+            ++device_hit;
+        if (frame.flags & FRAME_TRACE_SKIP_VALIDATE)
+            ++skip_validate;
+        if (!result.fingerprint_match)
+            ++*fingerprint_mismatch;
+        if (result.compared)
+        {
+            ++compared;
+            if (result.gles_head != frame.gles_head || result.gles_tail != frame.gles_tail)
+                ++*mismatch;
+        }
+
+        if (csv)
+        {
+            printf("%u,%u,%u,%d,%d:%d,%d:%d,%u,%u,%u,%u,%u,%u,%u,%llu,%llu,%u,%u\n",
+                frame.sequence, frame.disp_id, frame.layer_num, result.cache_hit,
+                result.gles_head, result.gles_tail, frame.gles_head, frame.gles_tail,
+                result.client_num, result.device_num, result.mdp_num, result.dim_num,
+                result.fence_num, result.mdp_jobs, result.pushed_inputs,
+                static_cast<unsigned long long>(result.validate_ns),
+                static_cast<unsigned long long>(result.present_ns),
+                frame.validate_ns, frame.present_ns);
+        }
+    }
+
+    if (frames == 0)
+    {
+        printf("%s has no frame\n", path);
+        return false;
+    }
+
+    const OvlConfigDiffStats diff_stats = replayer.getDiffStats();
+    printf("%s: %u frames\n", path, frames);
+    printf(" timing\n");
+    printTiming("replay validate", validate_ns);
+    printTiming("replay present", present_ns);
+    printTiming("device validate", device_validate_ns);
+    printTiming("device present", device_present_ns);
+    printf(" composition on device (layers)\n");
+    printf("  client:%llu device:%llu solid_color:%llu cursor:%llu sideband:%llu\n",
+        static_cast<unsigned long long>(comp_types[HWC2_COMPOSITION_CLIENT]),
+        static_cast<unsigned long long>(comp_types[HWC2_COMPOSITION_DEVICE]),
+        static_cast<unsigned long long>(comp_types[HWC2_COMPOSITION_SOLID_COLOR]),
+        static_cast<unsigned long long>(comp_types[HWC2_COMPOSITION_CURSOR]),
+        static_cast<unsigned long long>(comp_types[HWC2_COMPOSITION_SIDEBAND]));
+    printf("  vali cache hit:%.1f%% skip validate:%.1f%%\n",
+        100.0 * device_hit / frames, 100.0 * skip_validate / frames);
+    printf(" composition of replay (layers)\n");
+    printf("  client:%llu ovl:%llu mdp:%llu dim:%llu\n",
+        static_cast<unsigned long long>(client), static_cast<unsigned long long>(device),
+        static_cast<unsigned long long>(mdp), static_cast<unsigned long long>(dim));
+    printf("  plan cache hit:%.1f%% hrt queries:%u fingerprint differs from device:%u frames\n",
+        100.0 * replayer.getCacheHit() / frames, replayer.getQueryCount(), *fingerprint_mismatch);
+    printf("  gles range agrees with device:%.1f%% of %u frames decided by the model\n",
+        compared ? 100.0 * (compared - *mismatch) / compared : 0.0, compared);
+    printf("  acquire fences:%llu mdp jobs:%llu ovl inputs pushed:%llu of %llu (%.1f per frame)\n",
+        static_cast<unsigned long long>(fences),
+        static_cast<unsigned long long>(replayer.getMdpJobs()),
+        static_cast<unsigned long long>(diff_stats.pushed),
+        static_cast<unsigned long long>(diff_stats.inputs),
+        static_cast<double>(pushed) / frames);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    bool csv = false;
+    int32_t max_ovl_layers = HRT_MODEL_MAX_OVL_LAYERS;
+    uint32_t synth_frames = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "co:s:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'c':
+                csv = true;
+                break;
+            case 'o':
+                max_ovl_layers = atoi(optarg);
+                break;
+            case 's':
+                synth_frames = atoi(optarg);
+                break;
+            default:
+                printf("usage: %s [-c] [-o max_ovl_layers] [trace]\n"
+                       "       %s -s frames trace\n", argv[0], argv[0]);
+                return 1;
+        }
+    }
+    if (max_ovl_layers <= 0)
+        max_ovl_layers = HRT_MODEL_MAX_OVL_LAYERS;
+
+    // without a trace, replay a synthetic one
+    const bool synth = synth_frames > 0 || optind >= argc;
+    const char* path = optind < argc ? argv[optind] : DEFAULT_SYNTH_PATH;
+    if (synth)
+    {
+        if (synth_frames == 0)
+            synth_frames = DEFAULT_SYNTH_FRAMES;
+        if (!writeSynthTrace(path, synth_frames))
+        {
+            printf("FAIL\n");
+            return 1;
+        }
+    }
+
+    uint32_t mismatch = 0, fingerprint_mismatch = 0;
+    bool ok = replayTrace(path, max_ovl_layers, csv, &mismatch, &fingerprint_mismatch);
+
+    // the trace misses a state which the fingerprint of the device has
+    ok &= fingerprint_mismatch == 0;
+
+    // the GLES ranges of a synthetic trace are the ones of the driver
+    if (synth)
+        ok &= mismatch == 0;
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,202 @@
+// hrt_test: arbitration of HrtModel and HrtQueryCache without the display driver.
+//
+// A fake primary display runs frame sequences where
+//  - only buffers change (the layer configs are the same every frame)
+//  - a layer moves every frame (overlap changes)
+//  - the format of a layer changes from time to time
+// Each frame is queried with and without the cache; the results must be the
+// same, and the number of queries reaching the arbiter and the cpu time per
+// frame are reported.
+//
+// usage: hrt_test [frames]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include "../hrt_model.h"
+
+#define DEFAULT_FRAMES  (3000)
+#define DISP_WIDTH      (1080)
+#define DISP_HEIGHT     (2160)
+
+typedef void (*FrameUpdater)(std::vector<layer_config>* configs, const int frame);
+
+static uint64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+static layer_config makeConfig(int x, int y, int w, int h, unsigned int fmt)
+{
+    layer_config config;
+    memset(&config, 0, sizeof(config));
+    config.ovl_id = -1;
+    config.ext_sel_layer = -1;
+    config.src_fmt = fmt;
+    config.dst_offset_x = x;
+    config.dst_offset_y = y;
+    config.dst_width = w;
+    config.dst_height = h;
+    config.src_width = w;
+    config.src_height = h;
+    return config;
+}
+
+// wallpaper, app, popup, dim, status bar, navigation bar
+static std::vector<layer_config> buildLayers()
+{
+    std::vector<layer_config> configs;
+    configs.push_back(makeConfig(0, 0, DISP_WIDTH, DISP_HEIGHT, DISP_FORMAT_RGBA8888));
+    configs.push_back(makeConfig(0, 0, DISP_WIDTH, DISP_HEIGHT, DISP_FORMAT_RGBA8888));
+    configs.push_back(makeConfig(100, 600, 880, 800, DISP_FORMAT_RGBA8888));
+    configs.push_back(makeConfig(0, 0, DISP_WIDTH, DISP_HEIGHT, DISP_FORMAT_DIM));
+    configs.push_back(makeConfig(0, 0, DISP_WIDTH, 72, DISP_FORMAT_RGBA8888));
+    configs.push_back(makeConfig(0, DISP_HEIGHT - 144, DISP_WIDTH, 144, DISP_FORMAT_RGBA8888));
+    return configs;
+}
+
+static void updateBufferOnly(std::vector<layer_config>* /*configs*/, const int /*frame*/)
+{
+}
+
+static void updateMoving(std::vector<layer_config>* configs, const int frame)
+{
+    // the popup is dragged, it overlaps the status bar at the top
+    (*configs)[2].dst_offset_y = (frame * 7) % (DISP_HEIGHT - 800);
+}
+
+static void updateFormat(std::vector<layer_config>* configs, const int frame)
+{
+    // the popup is hidden by a dim layer every 100 frames
+    (*configs)[2].src_fmt = (frame / 100) % 2 ? DISP_FORMAT_DIM : DISP_FORMAT_RGBA8888;
+}
+
+static void fillDispLayer(disp_layer_info* disp_layer, std::vector<layer_config>* configs)
+{
+    memset(disp_layer, 0, sizeof(*disp_layer));
+    disp_layer->input_config[0] = &(*configs)[0];
+    disp_layer->layer_num[0] = configs->size();
+    disp_layer->disp_mode[0] = DISP_SESSION_DIRECT_LINK_MODE;
+    disp_layer->gles_head[0] = -1;
+    disp_layer->gles_tail[0] = -1;
+    disp_layer->gles_head[1] = -1;
+    disp_layer->gles_tail[1] = -1;
+    disp_layer->hrt_num = -1;
+}
+
+static bool isResultEqual(const disp_layer_info& lhs, const disp_layer_info& rhs)
+{
+    if (lhs.hrt_num != rhs.hrt_num ||
+        lhs.gles_head[0] != rhs.gles_head[0] ||
+        lhs.gles_tail[0] != rhs.gles_tail[0] ||
+        lhs.layer_num[0] != rhs.layer_num[0])
+        return false;
+
+    for (int i = 0; i < lhs.layer_num[0]; ++i)
+    {
+        if (lhs.input_config[0][i].ovl_id != rhs.input_config[0][i].ovl_id ||
+            lhs.input_config[0][i].ext_sel_layer != rhs.input_config[0][i].ext_sel_layer)
+            return false;
+    }
+    return true;
+}
+
+static bool runScenario(const char* name, FrameUpdater update, const int frames)
+{
+    HrtModel full_model(HRT_MODEL_MAX_OVL_LAYERS, HRT_MODEL_HRT_LIMIT);
+    HrtModel cached_model(HRT_MODEL_MAX_OVL_LAYERS, HRT_MODEL_HRT_LIMIT);
+    HrtQueryCache cache;
+    std::vector<layer_config> layers = buildLayers();
+    uint64_t full_ns = 0;
+    uint64_t cached_ns = 0;
+    int mismatch = 0;
+
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        update(&layers, frame);
+
+        // Hrt::fillLayerConfigList() refills the configs every frame
+        std::vector<layer_config> full_configs(layers);
+        std::vector<layer_config> cached_configs(layers);
+        disp_layer_info full;
+        disp_layer_info cached;
+        fillDispLayer(&full, &full_configs);
+        fillDispLayer(&cached, &cached_configs);
+
+        uint64_t start = nowNs();
+        const bool full_valid = full_model.queryValidLayer(&full);
+        full_ns += nowNs() - start;
+
+        start = nowNs();
+        bool cached_valid = true;
+        if (!cache.lookup(&cached))
+        {
+            cached_valid = cached_model.queryValidLayer(&cached);
+            cache.update(cached, cached_valid);
+        }
+        cached_ns += nowNs() - start;
+
+        if (full_valid != cached_valid || !isResultEqual(full, cached))
+            ++mismatch;
+    }
+
+    printf("%-8s frames:%d query full:%u cached:%u (hit:%u) cpu avg full:%6.2f us cached:%6.2f us mismatch:%d\n",
+        name, frames, full_model.getQueryCount(), cached_model.getQueryCount(), cache.getHitCount(),
+        full_ns / 1000.0 / frames, cached_ns / 1000.0 / frames, mismatch);
+
+    return mismatch == 0;
+}
+
+static bool checkArbitration()
+{
+    HrtModel model(HRT_MODEL_MAX_OVL_LAYERS, HRT_MODEL_HRT_LIMIT);
+    std::vector<layer_config> layers = buildLayers();
+    disp_layer_info disp_layer;
+    fillDispLayer(&disp_layer, &layers);
+
+    // at most 3 layers overlap (the dim layer costs nothing), but there are
+    // 6 layers for 4 ovl inputs: the top 3 layers go to gles
+    if (!model.queryValidLayer(&disp_layer) ||
+        disp_layer.gles_head[0] != 3 || disp_layer.gles_tail[0] != 5 ||
+        disp_layer.hrt_num > HRT_MODEL_HRT_LIMIT)
+    {
+        printf("unexpected arbitration: hrt:%d gles:%d,%d\n",
+            disp_layer.hrt_num, disp_layer.gles_head[0], disp_layer.gles_tail[0]);
+        return false;
+    }
+
+    // the layers in the gles range share the ovl input of the client target
+    const unsigned int expected_ovl_id[] = { 0, 1, 2, 3, 3, 3 };
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+        if (layers[i].ovl_id != expected_ovl_id[i])
+        {
+            printf("unexpected ovl_id of layer %zu: %u\n", i, layers[i].ovl_id);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    int frames = DEFAULT_FRAMES;
+    if (argc > 1)
+        frames = atoi(argv[1]);
+    if (frames <= 0)
+        frames = DEFAULT_FRAMES;
+
+    bool ok = checkArbitration();
+    ok &= runScenario("buffer", updateBufferOnly, frames);
+    ok &= runScenario("moving", updateMoving, frames);
+    ok &= runScenario("format", updateFormat, frames);
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
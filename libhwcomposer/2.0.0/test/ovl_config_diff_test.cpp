@@ -0,0 +1,421 @@
+// ovl_config_diff_test: OvlConfigDiff (ovl_config_diff.h) against a mock
+// display driver, and the bytes and ioctls per frame of some scenes.
+//
+// The mock driver keeps the config of each overlay input and applies the
+// inputs of a frame by layer_id, as DISP_IOCTL_FRAME_CONFIG and
+// DISP_IOCTL_SET_INPUT_BUFFER do. Each frame is sent to two drivers: one
+// gets all inputs, as before, and one only the changed inputs; both must
+// end up with the same config after every frame, also when an ioctl fails.
+// Like HWC, every enabled layer has a new buffer index each frame and the
+// unused inputs are disabled. Some frames are dropped after they are
+// diffed and before their ioctl, as OverlayEngine::loopHandler() does for
+// a virtual display without output.
+//
+// usage: ovl_config_diff_test [frames]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../ovl_config_diff.h"
+
+#define DEFAULT_FRAMES  (3000)
+#define OVL_INPUT_NUM   (12)
+#define MAX_DIRTY_NUM   (10)
+
+static int s_errors = 0;
+
+#define CHECK(cond, ...)                    \
+    do {                                    \
+        if (!(cond))                        \
+        {                                   \
+            printf("FAILED %s:%d: ", __func__, __LINE__); \
+            printf(__VA_ARGS__);            \
+            printf("\n");                   \
+            ++s_errors;                     \
+        }                                   \
+    } while (0)
+
+static uint32_t s_seed = 1;
+
+static uint32_t random32()
+{
+    // xorshift32, the scenes are the same on every run
+    s_seed ^= s_seed << 13;
+    s_seed ^= s_seed >> 17;
+    s_seed ^= s_seed << 5;
+    return s_seed;
+}
+
+static int64_t getNowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// the input config as the driver gets it, of about the size of disp_input_config
+struct MockInputConfig
+{
+    MockInputConfig() : layer_id(0) { memset(dirty, 0, sizeof(dirty)); }
+
+    uint32_t layer_id;
+    OvlInputKey cfg;
+    int32_t dirty[MAX_DIRTY_NUM * 4];
+};
+
+struct MockFrameConfig
+{
+    uint32_t input_layer_num;
+    MockInputConfig input_cfg[OVL_INPUT_NUM];
+};
+
+class MockDispDevice
+{
+public:
+    MockDispDevice()
+        : m_ioctls(0)
+        , m_bytes(0)
+        , m_fail_next(false)
+    {
+    }
+
+    // frameConfig() applies the inputs by layer_id, the others are kept
+    bool frameConfig(const MockFrameConfig& frame)
+    {
+        ++m_ioctls;
+        m_bytes += sizeof(uint32_t) + frame.input_layer_num * sizeof(MockInputConfig);
+        if (m_fail_next)
+        {
+            m_fail_next = false;
+            return false;
+        }
+
+        for (uint32_t i = 0; i < frame.input_layer_num; ++i)
+        {
+            const MockInputConfig& input = frame.input_cfg[i];
+            if (input.layer_id < OVL_INPUT_NUM)
+                m_state[input.layer_id] = input;
+        }
+        return true;
+    }
+
+    bool isSame(const MockDispDevice& rhs) const
+    {
+        for (int i = 0; i < OVL_INPUT_NUM; ++i)
+        {
+            if (m_state[i].cfg != rhs.m_state[i].cfg ||
+                memcmp(m_state[i].dirty, rhs.m_state[i].dirty, sizeof(m_state[i].dirty)) != 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    uint64_t m_ioctls;
+    uint64_t m_bytes;
+    bool m_fail_next;
+
+private:
+    MockInputConfig m_state[OVL_INPUT_NUM];
+};
+
+// encodeInput() is what DispDevice does with disp_input_config
+static void encodeInput(const MockInputConfig& input, OvlInputKey* key)
+{
+    *key = input.cfg;
+    key->dirty_hash = 0;
+    if (input.cfg.dirty_roi_num > 0)
+        key->dirty_hash = OvlInputKey::hashRects(input.dirty, input.cfg.dirty_roi_num * 4);
+}
+
+struct Scene
+{
+    const char* name;
+
+    // the number of layers is random in [min_layers, max_layers]
+    int min_layers;
+    int max_layers;
+
+    // the ratio of frames with a dirty rect change on the top layer
+    uint32_t dirty_percent;
+
+    // the ratio of frames with a failed ioctl
+    uint32_t fail_permil;
+
+    // the ratio of frames dropped between diff and ioctl
+    uint32_t drop_permil;
+};
+
+struct SceneResult
+{
+    uint64_t frames;
+    uint64_t full_bytes;
+    uint64_t diff_bytes;
+    uint64_t full_ioctls;
+    uint64_t diff_ioctls;
+    uint64_t inputs;
+    uint64_t pushed;
+    int64_t diff_ns;
+};
+
+static void fillFrame(const Scene& scene, const int& frame, MockFrameConfig* cfg)
+{
+    static uint32_t s_buff_idx[OVL_INPUT_NUM];
+    const int range = scene.max_layers - scene.min_layers + 1;
+    const int layers = scene.min_layers + (range > 1 ? static_cast<int>(random32() % range) : 0);
+
+    cfg->input_layer_num = OVL_INPUT_NUM;
+    for (int i = 0; i < OVL_INPUT_NUM; ++i)
+    {
+        MockInputConfig& input = cfg->input_cfg[i];
+        input = MockInputConfig();
+        input.layer_id = i;
+
+        if (i >= layers)
+        {
+            // a disabled input, as a reset OverlayPortParam
+            input.cfg.layer_enable = 0;
+            input.cfg.next_buff_idx = 0;
+            input.cfg.src_fence_fd = -1;
+            continue;
+        }
+
+        input.cfg.layer_enable = 1;
+        input.cfg.src_phy_addr = 0x10000000u + i * 0x1000000u;
+        input.cfg.src_fmt = 1;
+        input.cfg.src_pitch = 1080 * 4;
+        input.cfg.src_width = 1080;
+        input.cfg.src_height = 2160 / (i + 1);
+        input.cfg.tgt_width = 1080;
+        input.cfg.tgt_height = 2160 / (i + 1);
+        input.cfg.alpha = 0xff;
+        input.cfg.next_buff_idx = ++s_buff_idx[i];
+        input.cfg.src_fence_fd = (random32() & 1) ? 40 + i : -1;
+        input.cfg.frm_sequence = frame;
+
+        if (i == layers - 1 && random32() % 100 < scene.dirty_percent)
+        {
+            input.cfg.dirty_roi_num = 1;
+            input.dirty[0] = 0;
+            input.dirty[1] = static_cast<int32_t>(random32() % 2000);
+            input.dirty[2] = 1080;
+            input.dirty[3] = 100;
+        }
+    }
+}
+
+static void runScene(const Scene& scene, const int& frames, SceneResult* result)
+{
+    MockDispDevice full;
+    MockDispDevice diffed;
+    OvlConfigDiff diff;
+    MockFrameConfig cfg;
+    MockFrameConfig packed;
+    int mismatch = 0;
+
+    memset(result, 0, sizeof(*result));
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        fillFrame(scene, frame, &cfg);
+        const bool is_dropped = scene.drop_permil && random32() % 1000 < scene.drop_permil;
+
+        // all inputs, as before
+        if (!is_dropped)
+            full.frameConfig(cfg);
+
+        // only the changed inputs
+        const int64_t start = getNowNs();
+        diff.beginFrame();
+        for (uint32_t i = 0; i < cfg.input_layer_num; ++i)
+        {
+            OvlInputKey key;
+            encodeInput(cfg.input_cfg[i], &key);
+            diff.update(i, key);
+        }
+        packed.input_layer_num = diff.getChangedNum();
+        for (uint32_t i = 0; i < diff.getChangedNum(); ++i)
+        {
+            packed.input_cfg[i] = cfg.input_cfg[diff.getChangedId(i)];
+        }
+        result->diff_ns += getNowNs() - start;
+
+        // the frame never reaches the driver, and is not ended
+        if (is_dropped)
+            continue;
+
+        // DispDevice skips SET_INPUT_BUFFER when nothing changed
+        if (packed.input_layer_num == 0)
+        {
+            diff.endFrame();
+            continue;
+        }
+
+        if (scene.fail_permil && random32() % 1000 < scene.fail_permil)
+            diffed.m_fail_next = true;
+
+        if (!diffed.frameConfig(packed))
+        {
+            // the driver kept the old config, send all inputs next frame
+            diff.invalidate();
+            continue;
+        }
+        diff.endFrame();
+
+        if (!full.isSame(diffed))
+            ++mismatch;
+    }
+
+    result->frames = frames;
+    result->full_bytes = full.m_bytes;
+    result->diff_bytes = diffed.m_bytes;
+    result->full_ioctls = full.m_ioctls;
+    result->diff_ioctls = diffed.m_ioctls;
+    result->inputs = diff.getStats().inputs;
+    result->pushed = diff.getStats().pushed;
+
+    CHECK(mismatch == 0, "%s: driver config differs in %d frames", scene.name, mismatch);
+    CHECK(scene.fail_permil == 0 || diff.getStats().full_frames > 1, "%s: no ioctl failed", scene.name);
+    CHECK((scene.drop_permil != 0) == (diff.getStats().dropped_frames != 0), "%s: %llu frames dropped",
+        scene.name, static_cast<unsigned long long>(diff.getStats().dropped_frames));
+}
+
+static void testScenes(const int& frames)
+{
+    const Scene scenes[] =
+    {
+        { "game",      1, 1,  0, 0, 0 },
+        { "video",     2, 2,  0, 0, 0 },
+        { "home",      4, 4, 30, 0, 0 },
+        { "multiwin",  8, 8, 50, 0, 0 },
+        { "churn",     1, 8, 50, 0, 0 },
+        { "all",      12, 12, 50, 0, 0 },
+        { "failing",   1, 8, 50, 20, 0 },
+        { "dropping",  1, 8, 50, 0, 20 },
+    };
+
+    printf("%-9s %10s %10s %7s %11s %11s %8s\n",
+        "scene", "full B/f", "diff B/f", "saved", "inputs/f", "ioctls/f", "diff ns/f");
+    for (size_t i = 0; i < sizeof(scenes) / sizeof(scenes[0]); ++i)
+    {
+        SceneResult r;
+        runScene(scenes[i], frames, &r);
+        printf("%-9s %10.0f %10.0f %6.1f%% %5.2f/%5.2f %5.2f/%5.2f %8.0f\n", scenes[i].name,
+            static_cast<double>(r.full_bytes) / r.frames,
+            static_cast<double>(r.diff_bytes) / r.frames,
+            100.0 - 100.0 * r.diff_bytes / r.full_bytes,
+            static_cast<double>(r.inputs) / r.frames, static_cast<double>(r.pushed) / r.frames,
+            static_cast<double>(r.full_ioctls) / r.frames, static_cast<double>(r.diff_ioctls) / r.frames,
+            static_cast<double>(r.diff_ns) / r.frames);
+
+        if (scenes[i].min_layers == OVL_INPUT_NUM)
+        {
+            // every input has a new buffer each frame, nothing can be skipped
+            CHECK(r.pushed == r.inputs, "%s: skipped an enabled input", scenes[i].name);
+        }
+        else if (scenes[i].fail_permil == 0 && scenes[i].drop_permil == 0)
+        {
+            CHECK(r.diff_bytes < r.full_bytes, "%s: no bytes saved", scenes[i].name);
+        }
+    }
+}
+
+static void testDiff()
+{
+    OvlConfigDiff diff;
+    OvlInputKey key;
+    key.layer_enable = 1;
+    key.next_buff_idx = 3;
+
+    diff.beginFrame();
+    CHECK(diff.update(0, key), "first config not sent");
+    CHECK(diff.update(1, OvlInputKey()), "first disabled config not sent");
+    CHECK(diff.getChangedNum() == 2, "changed %u", diff.getChangedNum());
+    diff.endFrame();
+
+    diff.beginFrame();
+    CHECK(!diff.update(0, key), "same config sent again");
+    CHECK(!diff.update(1, OvlInputKey()), "same disabled config sent again");
+    CHECK(diff.getChangedNum() == 0, "changed %u", diff.getChangedNum());
+    diff.endFrame();
+
+    // a new buffer, a new release fence to signal
+    diff.beginFrame();
+    key.next_buff_idx = 4;
+    CHECK(diff.update(0, key), "new buffer index not sent");
+    diff.endFrame();
+
+    // only the dirty rect is different
+    diff.beginFrame();
+    int32_t rect[4] = { 0, 0, 100, 100 };
+    key.dirty_roi_num = 1;
+    key.dirty_hash = OvlInputKey::hashRects(rect, 4);
+    CHECK(diff.update(0, key), "dirty rect not sent");
+    diff.endFrame();
+    diff.beginFrame();
+    rect[1] = 50;
+    key.dirty_hash = OvlInputKey::hashRects(rect, 4);
+    CHECK(diff.update(0, key), "moved dirty rect not sent");
+    CHECK(diff.getChangedNum() == 1 && diff.getChangedId(0) == 0, "changed id");
+    diff.endFrame();
+
+    // everything is sent after invalidate()
+    diff.invalidate();
+    diff.beginFrame();
+    CHECK(diff.update(0, key) && diff.update(1, OvlInputKey()), "not sent after invalidate");
+    CHECK(diff.getStats().full_frames == 2, "full frames %llu",
+        static_cast<unsigned long long>(diff.getStats().full_frames));
+    diff.endFrame();
+    printf("diff ok\n");
+}
+
+static void testDropped()
+{
+    OvlConfigDiff diff;
+    OvlInputKey key;
+    key.layer_enable = 1;
+    key.next_buff_idx = 3;
+
+    diff.beginFrame();
+    diff.update(0, key);
+    diff.update(1, OvlInputKey());
+    diff.endFrame();
+
+    // diffed, then dropped before the ioctl: the driver still has index 3
+    diff.beginFrame();
+    key.next_buff_idx = 4;
+    CHECK(diff.update(0, key), "new buffer index not sent");
+
+    // the same config again, it has to be sent as the driver never got it
+    diff.beginFrame();
+    CHECK(diff.update(0, key), "config of a dropped frame skipped");
+    CHECK(diff.update(1, OvlInputKey()), "disabled input not sent after a dropped frame");
+    CHECK(diff.getStats().dropped_frames == 1, "dropped frames %llu",
+        static_cast<unsigned long long>(diff.getStats().dropped_frames));
+    diff.endFrame();
+
+    // back to diffing once a frame reached the driver
+    diff.beginFrame();
+    CHECK(!diff.update(0, key) && !diff.update(1, OvlInputKey()), "sent again after a full frame");
+    CHECK(diff.getChangedNum() == 0, "changed %u", diff.getChangedNum());
+    diff.endFrame();
+    printf("dropped ok\n");
+}
+
+int main(int argc, char** argv)
+{
+    int frames = DEFAULT_FRAMES;
+    if (argc > 1)
+        frames = atoi(argv[1]);
+    if (frames <= 0)
+        frames = DEFAULT_FRAMES;
+
+    testDiff();
+    testDropped();
+    testScenes(frames);
+
+    printf("%s\n", s_errors == 0 ? "PASS" : "FAIL");
+    return s_errors == 0 ? 0 : 1;
+}
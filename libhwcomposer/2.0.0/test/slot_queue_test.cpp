@@ -0,0 +1,392 @@
+// slot_queue_test: stress and throughput of the slot state machine of
+// DisplayBufferQueue (slot_queue.h) without gralloc and the display driver.
+//
+// A producer thread dequeues, fills, queues, and now and then cancels slots;
+// a consumer thread acquires and releases them, in sync mode, async mode,
+// and with the mode switched every few frames (drain() before async).
+// Every buffer carries its sequence number and fences carry unique tokens:
+//  - the consumer must see the filled data of a buffer, in queued order,
+//    and in sync mode every queued buffer
+//  - every fence token must come out exactly once, from acquire(), from
+//    dequeue() as a release fence, or be left in a free slot
+// Build it with -fsanitize=thread to check the memory ordering.
+//
+// Then the throughput of the old queue (a mutex and a condition shared by
+// both sides, as DisplayBufferQueue used to be) and of SlotQueue is compared
+// with the number of times the producer is blocked.
+//
+// usage: slot_queue_test [frames]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../slot_queue.h"
+
+#define DEFAULT_FRAMES  (200000)
+#define SLOT_NUM        (3)
+#define PAYLOAD_SIZE    (16)
+
+typedef SlotQueue<SLOT_NUM> Queue;
+
+static uint64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+// fence tokens are checked by sum and count, -1 is no fence
+struct FenceLedger
+{
+    FenceLedger() : in_sum(0), in_num(0), out_sum(0), out_num(0) { }
+
+    void in(const int& fence)
+    {
+        if (fence < 0)
+            return;
+        in_sum.fetch_add(fence);
+        in_num.fetch_add(1);
+    }
+
+    void out(const int& fence)
+    {
+        if (fence < 0)
+            return;
+        out_sum.fetch_add(fence);
+        out_num.fetch_add(1);
+    }
+
+    bool isBalanced() const
+    {
+        return in_sum.load() == out_sum.load() && in_num.load() == out_num.load();
+    }
+
+    std::atomic<uint64_t> in_sum;
+    std::atomic<uint64_t> in_num;
+    std::atomic<uint64_t> out_sum;
+    std::atomic<uint64_t> out_num;
+};
+
+enum MODE
+{
+    MODE_SYNC   = 0,
+    MODE_ASYNC  = 1,
+    MODE_SWITCH = 2,
+};
+
+static const char* getModeName(const MODE& mode)
+{
+    return mode == MODE_SYNC ? "sync" : (mode == MODE_ASYNC ? "async" : "switch");
+}
+
+static bool stress(const MODE& mode, const int& frames)
+{
+    Queue queue;
+    FenceLedger ledger;
+    // the data of the slots, owned by the owner of each slot
+    uint32_t payload[SLOT_NUM][PAYLOAD_SIZE];
+    memset(payload, 0, sizeof(payload));
+
+    std::atomic<bool> done(false);
+    std::atomic<int> errors(0);
+    std::atomic<uint32_t> consumed(0);
+    uint32_t queued = 0;
+    uint32_t dropped = 0;
+
+    std::thread consumer([&]() {
+        uint32_t last_seq = 0;
+        int token = 2;
+        while (true)
+        {
+            const bool exiting = done.load();
+            int acquire_fence = -1;
+            const int idx = queue.acquire(&acquire_fence);
+            if (idx == Queue::INVALID_SLOT)
+            {
+                if (exiting)
+                    break;
+                std::this_thread::yield();
+                continue;
+            }
+
+            ledger.out(acquire_fence);
+            const uint32_t seq = payload[idx][0];
+            for (int i = 1; i < PAYLOAD_SIZE; ++i)
+            {
+                if (payload[idx][i] != seq + i)
+                {
+                    ++errors;
+                    break;
+                }
+            }
+            if (seq <= last_seq)
+                ++errors;
+            // in sync mode no buffer is dropped
+            if (mode == MODE_SYNC && seq != last_seq + 1)
+                ++errors;
+            last_seq = seq;
+            consumed.fetch_add(1);
+
+            // the release fence tokens are even, the acquire ones odd
+            const int release_fence = (token += 2);
+            ledger.in(release_fence);
+            int stale_fence = -1;
+            if (!queue.release(idx, release_fence, &stale_fence))
+                ++errors;
+            ledger.out(stale_fence);
+        }
+    });
+
+    bool async = mode == MODE_ASYNC;
+    uint32_t seq = 0;
+    int token = 1;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        if (mode == MODE_SWITCH && frame % 97 == 0)
+        {
+            if (!async && !queue.drain(-1))
+                ++errors;
+            async = !async;
+        }
+
+        int release_fence = -1;
+        const int idx = queue.dequeue(-1, &release_fence);
+        if (idx < 0 || queue.getState(idx) != Queue::STATE_DEQUEUED)
+        {
+            ++errors;
+            continue;
+        }
+        ledger.out(release_fence);
+
+        // give up a buffer now and then
+        if (frame % 13 == 0)
+        {
+            if (!queue.cancel(idx))
+                ++errors;
+            continue;
+        }
+
+        ++seq;
+        for (int i = 0; i < PAYLOAD_SIZE; ++i)
+        {
+            payload[idx][i] = seq + i;
+        }
+
+        const int acquire_fence = (token += 2);
+        ledger.in(acquire_fence);
+        int dropped_idx = Queue::INVALID_SLOT;
+        if (!queue.queue(idx, acquire_fence, async, &dropped_idx))
+            ++errors;
+        ++queued;
+        if (dropped_idx != Queue::INVALID_SLOT)
+            ++dropped;
+
+        // the producer of async mode never blocks, let the consumer run,
+        // but not every frame, so some buffers are replaced
+        if (frame % 4 != 0)
+            std::this_thread::yield();
+    }
+
+    done.store(true);
+    consumer.join();
+
+    // the fences left in the free slots
+    for (int i = 0; i < SLOT_NUM; ++i)
+    {
+        if (queue.getState(i) != Queue::STATE_FREE)
+            ++errors;
+        ledger.out(queue.getReleaseFence(i));
+    }
+
+    const bool ok = errors.load() == 0 && ledger.isBalanced() && consumed.load() + dropped == queued;
+    printf("stress %-6s frames:%d queued:%u consumed:%u dropped:%u fences:%llu/%llu errors:%d %s\n",
+        getModeName(mode), frames, queued, consumed.load(), dropped,
+        static_cast<unsigned long long>(ledger.out_num.load()),
+        static_cast<unsigned long long>(ledger.in_num.load()),
+        errors.load(), ok ? "ok" : "FAILED");
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+
+// the old DisplayBufferQueue: every call of both sides takes the mutex,
+// and every state change broadcasts the condition
+class MutexQueue
+{
+public:
+    MutexQueue()
+        : m_frame_counter(0)
+        , m_wait_count(0)
+    {
+        for (int i = 0; i < SLOT_NUM; ++i)
+        {
+            m_states[i] = Queue::STATE_FREE;
+            m_frame_num[i] = 0;
+        }
+    }
+
+    int dequeue()
+    {
+        std::unique_lock<std::mutex> l(m_lock);
+        while (true)
+        {
+            int found = -1;
+            for (int i = 0; i < SLOT_NUM; ++i)
+            {
+                if (m_states[i] == Queue::STATE_FREE &&
+                    (found < 0 || m_frame_num[i] < m_frame_num[found]))
+                    found = i;
+            }
+            if (found >= 0)
+            {
+                m_states[found] = Queue::STATE_DEQUEUED;
+                return found;
+            }
+
+            ++m_wait_count;
+            m_condition.wait_for(l, std::chrono::milliseconds(16));
+        }
+    }
+
+    void queue(const int& idx)
+    {
+        std::lock_guard<std::mutex> l(m_lock);
+        m_fifo.push_back(idx);
+        m_states[idx] = Queue::STATE_QUEUED;
+        m_frame_num[idx] = ++m_frame_counter;
+        m_condition.notify_all();
+    }
+
+    int acquire()
+    {
+        std::lock_guard<std::mutex> l(m_lock);
+        if (m_fifo.empty())
+            return -1;
+
+        const int idx = m_fifo.front();
+        m_fifo.pop_front();
+        m_states[idx] = Queue::STATE_ACQUIRED;
+        m_condition.notify_all();
+        return idx;
+    }
+
+    void release(const int& idx)
+    {
+        std::lock_guard<std::mutex> l(m_lock);
+        m_states[idx] = Queue::STATE_FREE;
+        m_condition.notify_all();
+    }
+
+    uint32_t getWaitCount() const { return m_wait_count; }
+
+private:
+    std::mutex m_lock;
+    std::condition_variable m_condition;
+    int m_states[SLOT_NUM];
+    uint64_t m_frame_num[SLOT_NUM];
+    std::deque<int> m_fifo;
+    uint64_t m_frame_counter;
+    uint32_t m_wait_count;
+};
+
+static void benchmarkMutex(const int& frames)
+{
+    MutexQueue queue;
+    std::atomic<bool> done(false);
+
+    const uint64_t begin = nowNs();
+    std::thread consumer([&]() {
+        while (true)
+        {
+            const bool exiting = done.load();
+            const int idx = queue.acquire();
+            if (idx < 0)
+            {
+                if (exiting)
+                    break;
+                std::this_thread::yield();
+                continue;
+            }
+            queue.release(idx);
+        }
+    });
+
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        queue.queue(queue.dequeue());
+    }
+    done.store(true);
+    consumer.join();
+    const uint64_t ns = nowNs() - begin;
+
+    printf("bench  mutex  frames:%d %7.1f ns/frame %6.2f Mframes/s blocked:%u\n",
+        frames, static_cast<double>(ns) / frames, frames * 1e3 / ns, queue.getWaitCount());
+}
+
+static void benchmarkSlot(const int& frames)
+{
+    Queue queue;
+    std::atomic<bool> done(false);
+
+    const uint64_t begin = nowNs();
+    std::thread consumer([&]() {
+        while (true)
+        {
+            const bool exiting = done.load();
+            int fence = -1;
+            const int idx = queue.acquire(&fence);
+            if (idx < 0)
+            {
+                if (exiting)
+                    break;
+                std::this_thread::yield();
+                continue;
+            }
+            int stale_fence = -1;
+            queue.release(idx, -1, &stale_fence);
+        }
+    });
+
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        int fence = -1;
+        int dropped_idx = -1;
+        const int idx = queue.dequeue(-1, &fence);
+        queue.queue(idx, -1, false, &dropped_idx);
+    }
+    done.store(true);
+    consumer.join();
+    const uint64_t ns = nowNs() - begin;
+
+    printf("bench  slot   frames:%d %7.1f ns/frame %6.2f Mframes/s blocked:%u wakes:%u\n",
+        frames, static_cast<double>(ns) / frames, frames * 1e3 / ns,
+        queue.getWaitCount(), queue.getWakeCount());
+}
+
+int main(int argc, char** argv)
+{
+    int frames = DEFAULT_FRAMES;
+    if (argc > 1)
+        frames = atoi(argv[1]);
+    if (frames <= 0)
+        frames = DEFAULT_FRAMES;
+
+    bool ok = stress(MODE_SYNC, frames);
+    ok &= stress(MODE_ASYNC, frames);
+    ok &= stress(MODE_SWITCH, frames);
+
+    benchmarkMutex(frames);
+    benchmarkSlot(frames);
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
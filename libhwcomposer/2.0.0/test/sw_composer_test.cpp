@@ -0,0 +1,606 @@
+// sw_composer_test: golden images and throughput of SwComposer
+// (sw_composer.h), the CPU fallback of the MM path.
+//
+//  - golden pixels of every conversion and blending, by both kernel sets
+//  - the SIMD kernels against the scalar ones, bit exact, for all lengths
+//    which hit the SIMD body and the scalar tail
+//  - scenes of scaled, cropped and overlapped layers of every format, by
+//    1 to 4 threads, against a per-pixel reference renderer; the pixels
+//    outside the bounds must not be touched
+//  - the throughput per resolution of a video layer with two UI layers on
+//    top, by 1, 2 and 4 threads, with and without SIMD
+//
+// usage: sw_composer_test [frames]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include "../sw_composer.h"
+
+#define DEFAULT_FRAMES  (20)
+
+static int s_errors = 0;
+
+#define CHECK(cond, ...)                    \
+    do {                                    \
+        if (!(cond))                        \
+        {                                   \
+            printf("FAILED %s:%d: ", __func__, __LINE__); \
+            printf(__VA_ARGS__);            \
+            printf("\n");                   \
+            ++s_errors;                     \
+        }                                   \
+    } while (0)
+
+static uint64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t rgba(const uint32_t& r, const uint32_t& g, const uint32_t& b, const uint32_t& a)
+{
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+static hwc_rect_t makeRect(const int32_t& l, const int32_t& t, const int32_t& r, const int32_t& b)
+{
+    hwc_rect_t rect;
+    rect.left = l;
+    rect.top = t;
+    rect.right = r;
+    rect.bottom = b;
+    return rect;
+}
+
+static uint32_t s_seed = 1;
+
+static uint32_t random32()
+{
+    // xorshift32, the scenes are the same on every run
+    s_seed ^= s_seed << 13;
+    s_seed ^= s_seed >> 17;
+    s_seed ^= s_seed << 5;
+    return s_seed;
+}
+
+// ---------------------------------------------------------------------------
+
+// an image of any SW_FORMAT which owns its memory
+struct Image
+{
+    Image(const uint32_t& format, const uint32_t& width, const uint32_t& height,
+        const uint32_t& chroma_step = 1)
+    {
+        buf.format = format;
+        buf.width = width;
+        buf.height = height;
+        buf.chroma_step = chroma_step;
+
+        const uint32_t bpp = format == SW_FORMAT_RGB_565 ? 2 : (format == SW_FORMAT_YUV_420 ? 1 : 4);
+        // pad the pitch to catch a wrong one
+        buf.pitch[0] = width * bpp + 24;
+        size_t size[3] = { buf.pitch[0] * height, 0, 0 };
+        if (format == SW_FORMAT_YUV_420)
+        {
+            const uint32_t chroma_w = (width + 1) / 2;
+            const uint32_t chroma_h = (height + 1) / 2;
+            buf.pitch[1] = buf.pitch[2] = chroma_w * chroma_step + 8;
+            size[1] = size[2] = buf.pitch[1] * chroma_h;
+        }
+
+        for (int i = 0; i < 3; ++i)
+        {
+            data[i].resize(size[i] + 16);
+            buf.plane[i] = size[i] ? &data[i][0] : NULL;
+        }
+
+        // semi-planar: Cb and Cr are interleaved in one plane
+        if (format == SW_FORMAT_YUV_420 && chroma_step == 2)
+        {
+            buf.plane[2] = buf.plane[1] + 1;
+            data[2].clear();
+        }
+    }
+
+    void fillRandom()
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            for (size_t j = 0; j < data[i].size(); ++j)
+            {
+                data[i][j] = static_cast<uint8_t>(random32() >> 24);
+            }
+        }
+    }
+
+    void fill(const uint32_t& pixel)
+    {
+        for (uint32_t y = 0; y < buf.height; ++y)
+        {
+            for (uint32_t x = 0; x < buf.width; ++x)
+            {
+                at(x, y) = pixel;
+            }
+        }
+    }
+
+    uint32_t& at(const uint32_t& x, const uint32_t& y)
+    {
+        return reinterpret_cast<uint32_t*>(buf.plane[0] + y * buf.pitch[0])[x];
+    }
+
+    SwBuffer buf;
+    std::vector<uint8_t> data[3];
+};
+
+// the source pixel (sx, sy) converted by the scalar kernels
+static uint32_t fetchPixel(const SwBuffer& src, const uint32_t& sx, const uint32_t& sy)
+{
+    const SwKernels& c = getSwKernels(false);
+    const uint8_t* row = src.plane[0] + sy * src.pitch[0];
+    uint32_t out = 0;
+    switch (src.format)
+    {
+        case SW_FORMAT_RGBA_8888:
+            out = reinterpret_cast<const uint32_t*>(row)[sx];
+            break;
+
+        case SW_FORMAT_RGBX_8888:
+            c.convertRGBX(reinterpret_cast<const uint32_t*>(row) + sx, &out, 1);
+            break;
+
+        case SW_FORMAT_RGB_565:
+            c.convertRGB565(reinterpret_cast<const uint16_t*>(row) + sx, &out, 1);
+            break;
+
+        case SW_FORMAT_YUV_420:
+        {
+            const uint32_t offset = (sy / 2) * src.pitch[1] + (sx / 2) * src.chroma_step;
+            c.convertYUV420(row + sx, src.plane[1] + offset, src.plane[2] + offset, &out, 1);
+            break;
+        }
+    }
+    return out;
+}
+
+// renderReference() renders each pixel on its own with the scalar kernels
+static void renderReference(const std::vector<SwLayer>& layers, Image* dst, const hwc_rect_t& bounds)
+{
+    const SwKernels& c = getSwKernels(false);
+    for (int32_t y = bounds.top; y < bounds.bottom; ++y)
+    {
+        for (int32_t x = bounds.left; x < bounds.right; ++x)
+        {
+            uint32_t pixel = 0;
+            for (size_t i = 0; i < layers.size(); ++i)
+            {
+                const SwLayer& layer = layers[i];
+                const hwc_rect_t& f = layer.display_frame;
+                if (x < f.left || x >= f.right || y < f.top || y >= f.bottom)
+                    continue;
+
+                const hwc_rect_t& crop = layer.src_crop;
+                const int64_t crop_w = crop.right - crop.left;
+                const int64_t crop_h = crop.bottom - crop.top;
+                const int64_t frame_w = f.right - f.left;
+                const int64_t frame_h = f.bottom - f.top;
+                const uint32_t sx = crop.left + ((2 * (x - f.left) + 1) * crop_w) / (2 * frame_w);
+                const uint32_t sy = crop.top + ((2 * (y - f.top) + 1) * crop_h) / (2 * frame_h);
+                const uint32_t src = fetchPixel(layer.src, sx, sy);
+                c.blend(&src, &pixel, 1, layer.blending, layer.plane_alpha);
+            }
+            dst->at(x, y) = pixel;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+
+static void testGoldenPixels(const bool& use_simd)
+{
+    const SwKernels& k = getSwKernels(use_simd);
+
+    // the kernels are called with 9 pixels, so the SIMD body runs
+    const uint16_t rgb565[4] = { 0xF800, 0x07E0, 0x001F, 0x8410 };
+    const uint32_t rgb565_golden[4] =
+    {
+        rgba(255, 0, 0, 255), rgba(0, 255, 0, 255), rgba(0, 0, 255, 255), rgba(132, 130, 132, 255),
+    };
+    for (int i = 0; i < 4; ++i)
+    {
+        uint16_t src[9];
+        uint32_t out[9];
+        for (int j = 0; j < 9; ++j)
+        {
+            src[j] = rgb565[i];
+        }
+        k.convertRGB565(src, out, 9);
+        for (int j = 0; j < 9; ++j)
+        {
+            CHECK(out[j] == rgb565_golden[i], "%s 565 %04x[%d]: %08x != %08x",
+                k.name, rgb565[i], j, out[j], rgb565_golden[i]);
+        }
+    }
+
+    // black, white, and red, green, blue of BT.601 narrow range
+    const uint8_t yuv[5][3] = { {16, 128, 128}, {235, 128, 128}, {81, 90, 240}, {145, 54, 34}, {41, 240, 110} };
+    const uint32_t yuv_golden[5] =
+    {
+        rgba(0, 0, 0, 255), rgba(255, 255, 255, 255), rgba(254, 0, 0, 255),
+        rgba(0, 255, 1, 255), rgba(0, 0, 255, 255),
+    };
+    for (int i = 0; i < 5; ++i)
+    {
+        uint8_t y[9];
+        uint8_t cb[5];
+        uint8_t cr[5];
+        uint32_t out[9];
+        memset(y, yuv[i][0], sizeof(y));
+        memset(cb, yuv[i][1], sizeof(cb));
+        memset(cr, yuv[i][2], sizeof(cr));
+        k.convertYUV420(y, cb, cr, out, 9);
+        for (int j = 0; j < 9; ++j)
+        {
+            CHECK(out[j] == yuv_golden[i], "%s yuv(%d,%d,%d)[%d]: %08x != %08x",
+                k.name, yuv[i][0], yuv[i][1], yuv[i][2], j, out[j], yuv_golden[i]);
+        }
+    }
+
+    struct BlendCase
+    {
+        uint32_t src;
+        uint32_t dst;
+        uint32_t blending;
+        uint8_t plane_alpha;
+        uint32_t golden;
+    };
+    const BlendCase blend_cases[] =
+    {
+        // opaque copy, the alpha of the source is ignored
+        { rgba(10, 20, 30, 0), rgba(1, 2, 3, 4), SW_BLEND_NONE, 255, rgba(10, 20, 30, 255) },
+        // none with plane alpha over transparent black
+        { rgba(0, 255, 0, 0), 0, SW_BLEND_NONE, 128, rgba(0, 128, 0, 128) },
+        // half transparent red over blue
+        { rgba(128, 0, 0, 128), rgba(0, 0, 255, 255), SW_BLEND_PREMULT, 255, rgba(128, 0, 127, 255) },
+        { rgba(255, 0, 0, 128), rgba(0, 0, 255, 255), SW_BLEND_COVERAGE, 255, rgba(128, 0, 127, 255) },
+        // the plane alpha scales the alpha of the source
+        { rgba(255, 0, 0, 255), rgba(0, 0, 255, 255), SW_BLEND_PREMULT, 51, rgba(51, 0, 204, 255) },
+        { rgba(255, 0, 0, 255), rgba(0, 0, 255, 255), SW_BLEND_COVERAGE, 51, rgba(51, 0, 204, 255) },
+        // coverage over transparent black gives the premultiplied source
+        { rgba(200, 100, 50, 64), 0, SW_BLEND_COVERAGE, 255, rgba(50, 25, 13, 64) },
+        // premultiplied color over the limit saturates
+        { rgba(255, 255, 255, 0), rgba(255, 255, 255, 255), SW_BLEND_PREMULT, 255, rgba(255, 255, 255, 255) },
+        // fully transparent
+        { rgba(0, 0, 0, 0), rgba(7, 8, 9, 10), SW_BLEND_PREMULT, 255, rgba(7, 8, 9, 10) },
+        { rgba(9, 9, 9, 255), rgba(7, 8, 9, 10), SW_BLEND_COVERAGE, 0, rgba(7, 8, 9, 10) },
+    };
+    for (size_t i = 0; i < sizeof(blend_cases) / sizeof(blend_cases[0]); ++i)
+    {
+        const BlendCase& b = blend_cases[i];
+        uint32_t src[9];
+        uint32_t dst[9];
+        for (int j = 0; j < 9; ++j)
+        {
+            src[j] = b.src;
+            dst[j] = b.dst;
+        }
+        k.blend(src, dst, 9, b.blending, b.plane_alpha);
+        for (int j = 0; j < 9; ++j)
+        {
+            CHECK(dst[j] == b.golden, "%s blend case %zu[%d]: %08x != %08x",
+                k.name, i, j, dst[j], b.golden);
+        }
+    }
+}
+
+static void testKernelsBitExact()
+{
+    const SwKernels& c = getSwKernels(false);
+    const SwKernels& simd = getSwKernels(true);
+
+    const uint32_t blendings[3] = { SW_BLEND_NONE, SW_BLEND_PREMULT, SW_BLEND_COVERAGE };
+    const uint8_t plane_alphas[4] = { 255, 254, 128, 0 };
+
+    for (uint32_t n = 0; n <= 67; ++n)
+    {
+        for (int round = 0; round < 20; ++round)
+        {
+            uint32_t src32[68];
+            uint16_t src16[68];
+            uint8_t y[68];
+            uint8_t cb[34];
+            uint8_t cr[34];
+            uint32_t dst[68];
+            for (uint32_t i = 0; i < 68; ++i)
+            {
+                src32[i] = random32();
+                src16[i] = static_cast<uint16_t>(random32());
+                y[i] = static_cast<uint8_t>(random32());
+                dst[i] = random32();
+            }
+            for (uint32_t i = 0; i < 34; ++i)
+            {
+                cb[i] = static_cast<uint8_t>(random32());
+                cr[i] = static_cast<uint8_t>(random32());
+            }
+
+            uint32_t out_c[68];
+            uint32_t out_simd[68];
+
+            c.convertRGBX(src32, out_c, n);
+            simd.convertRGBX(src32, out_simd, n);
+            CHECK(memcmp(out_c, out_simd, n * 4) == 0, "rgbx n=%u", n);
+
+            c.convertRGB565(src16, out_c, n);
+            simd.convertRGB565(src16, out_simd, n);
+            CHECK(memcmp(out_c, out_simd, n * 4) == 0, "565 n=%u", n);
+
+            c.convertYUV420(y, cb, cr, out_c, n);
+            simd.convertYUV420(y, cb, cr, out_simd, n);
+            CHECK(memcmp(out_c, out_simd, n * 4) == 0, "yuv n=%u", n);
+
+            for (int b = 0; b < 3; ++b)
+            {
+                for (int a = 0; a < 4; ++a)
+                {
+                    memcpy(out_c, dst, sizeof(dst));
+                    memcpy(out_simd, dst, sizeof(dst));
+                    c.blend(src32, out_c, n, blendings[b], plane_alphas[a]);
+                    simd.blend(src32, out_simd, n, blendings[b], plane_alphas[a]);
+                    CHECK(memcmp(out_c, out_simd, sizeof(out_c)) == 0,
+                        "blend %u alpha %u n=%u", blendings[b], plane_alphas[a], n);
+                }
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+
+static SwLayer makeLayer(const Image& src, const hwc_rect_t& crop, const hwc_rect_t& frame,
+    const uint32_t& blending, const uint8_t& plane_alpha)
+{
+    SwLayer layer;
+    layer.src = src.buf;
+    layer.src_crop = crop;
+    layer.display_frame = frame;
+    layer.blending = blending;
+    layer.plane_alpha = plane_alpha;
+    return layer;
+}
+
+static void testScenes()
+{
+    const uint32_t width = 601;
+    const uint32_t height = 357;
+
+    Image video(SW_FORMAT_YUV_420, 333, 187);
+    Image camera(SW_FORMAT_YUV_420, 161, 93, 2);
+    Image ui(SW_FORMAT_RGBA_8888, 400, 90);
+    Image status(SW_FORMAT_RGB_565, 601, 24);
+    Image icon(SW_FORMAT_RGBX_8888, 37, 41);
+    video.fillRandom();
+    camera.fillRandom();
+    ui.fillRandom();
+    status.fillRandom();
+    icon.fillRandom();
+
+    struct Scene
+    {
+        const char* name;
+        std::vector<SwLayer> layers;
+        hwc_rect_t bounds;
+    };
+    std::vector<Scene> scenes(5);
+
+    // fullscreen video scaled up from an odd crop, and UI on top
+    scenes[0].name = "video+ui";
+    scenes[0].bounds = makeRect(0, 0, width, height);
+    scenes[0].layers.push_back(makeLayer(video, makeRect(3, 5, 330, 184), makeRect(0, 0, width, height), SW_BLEND_NONE, 255));
+    scenes[0].layers.push_back(makeLayer(ui, makeRect(0, 0, 400, 90), makeRect(100, 250, 500, 340), SW_BLEND_PREMULT, 255));
+    scenes[0].layers.push_back(makeLayer(status, makeRect(0, 0, 601, 24), makeRect(0, 0, 601, 24), SW_BLEND_NONE, 255));
+
+    // downscaled semi-planar camera, and layers partly outside the output
+    scenes[1].name = "camera";
+    scenes[1].bounds = makeRect(0, 0, width, height);
+    scenes[1].layers.push_back(makeLayer(camera, makeRect(1, 1, 160, 92), makeRect(-20, 30, 90, 80), SW_BLEND_NONE, 200));
+    scenes[1].layers.push_back(makeLayer(icon, makeRect(0, 0, 37, 41), makeRect(580, 340, 654, 422), SW_BLEND_COVERAGE, 255));
+    scenes[1].layers.push_back(makeLayer(ui, makeRect(7, 3, 399, 89), makeRect(13, 11, 211, 57), SW_BLEND_COVERAGE, 77));
+
+    // bounds which do not start at a tile boundary, unscaled odd crops
+    scenes[2].name = "bounds";
+    scenes[2].bounds = makeRect(37, 19, 555, 301);
+    scenes[2].layers.push_back(makeLayer(video, makeRect(1, 3, 332, 186), makeRect(40, 20, 371, 203), SW_BLEND_NONE, 255));
+    scenes[2].layers.push_back(makeLayer(camera, makeRect(3, 0, 160, 93), makeRect(300, 200, 457, 293), SW_BLEND_PREMULT, 128));
+    scenes[2].layers.push_back(makeLayer(icon, makeRect(1, 1, 36, 40), makeRect(500, 250, 535, 289), SW_BLEND_NONE, 255));
+
+    // many overlapped translucent layers, scaled in one direction only
+    scenes[3].name = "overlap";
+    scenes[3].bounds = makeRect(0, 0, width, height);
+    for (int i = 0; i < 8; ++i)
+    {
+        const int32_t l = i * 31;
+        const int32_t t = i * 17;
+        scenes[3].layers.push_back(makeLayer(ui, makeRect(0, 0, 400, 90),
+            makeRect(l, t, l + 300 + i, t + 90), i % 2 ? SW_BLEND_COVERAGE : SW_BLEND_PREMULT,
+            static_cast<uint8_t>(255 - i * 20)));
+    }
+
+    // no layer at all clears the bounds
+    scenes[4].name = "empty";
+    scenes[4].bounds = makeRect(5, 5, 100, 100);
+
+    const uint32_t thread_nums[3] = { 1, 2, 4 };
+    for (size_t s = 0; s < scenes.size(); ++s)
+    {
+        const Scene& scene = scenes[s];
+
+        Image golden(SW_FORMAT_RGBA_8888, width, height);
+        golden.fill(0xDEADBEEF);
+        renderReference(scene.layers, &golden, scene.bounds);
+
+        for (int simd = 0; simd < 2; ++simd)
+        {
+            for (int t = 0; t < 3; ++t)
+            {
+                SwComposer composer(thread_nums[t], simd != 0);
+                Image out(SW_FORMAT_RGBA_8888, width, height);
+                out.fill(0xDEADBEEF);
+
+                // twice, the second frame reuses the line buffers
+                for (int round = 0; round < 2; ++round)
+                {
+                    const bool ok = composer.compose(
+                        scene.layers.empty() ? NULL : &scene.layers[0], scene.layers.size(),
+                        out.buf, scene.bounds);
+                    CHECK(ok, "%s: compose failed", scene.name);
+                }
+
+                uint32_t diff = 0;
+                uint32_t first_x = 0;
+                uint32_t first_y = 0;
+                for (uint32_t y = 0; y < height; ++y)
+                {
+                    for (uint32_t x = 0; x < width; ++x)
+                    {
+                        if (out.at(x, y) != golden.at(x, y))
+                        {
+                            if (diff == 0)
+                            {
+                                first_x = x;
+                                first_y = y;
+                            }
+                            ++diff;
+                        }
+                    }
+                }
+                CHECK(diff == 0, "%s %s threads:%u: %u pixels differ, first (%u,%u) %08x != %08x",
+                    scene.name, composer.getKernelName(), composer.getThreadNum(), diff,
+                    first_x, first_y, out.at(first_x, first_y), golden.at(first_x, first_y));
+            }
+        }
+        printf("scene  %-9s layers:%zu ok\n", scene.name, scene.layers.size());
+    }
+}
+
+static void testInvalid()
+{
+    SwComposer composer(2);
+    Image src(SW_FORMAT_RGBA_8888, 64, 64);
+    Image out(SW_FORMAT_RGBA_8888, 64, 64);
+    src.fill(0xFFFFFFFF);
+    out.fill(0x12345678);
+
+    SwLayer layer = makeLayer(src, makeRect(0, 0, 64, 64), makeRect(0, 0, 64, 64), SW_BLEND_NONE, 255);
+    const hwc_rect_t full = makeRect(0, 0, 64, 64);
+
+    // the crop is out of the source
+    SwLayer bad = layer;
+    bad.src_crop = makeRect(0, 0, 65, 64);
+    CHECK(!composer.compose(&bad, 1, out.buf, full), "crop out of source");
+
+    // an empty display frame
+    bad = layer;
+    bad.display_frame = makeRect(10, 10, 10, 20);
+    CHECK(!composer.compose(&bad, 1, out.buf, full), "empty frame");
+
+    // YUV without chroma planes
+    bad = layer;
+    bad.src.format = SW_FORMAT_YUV_420;
+    CHECK(!composer.compose(&bad, 1, out.buf, full), "yuv without chroma");
+
+    // the bounds are out of the output
+    CHECK(!composer.compose(&layer, 1, out.buf, makeRect(0, 0, 65, 64)), "bounds out of output");
+
+    // the output is not RGBA_8888
+    SwBuffer dst = out.buf;
+    dst.format = SW_FORMAT_RGB_565;
+    CHECK(!composer.compose(&layer, 1, dst, full), "output format");
+
+    uint32_t changed = 0;
+    for (uint32_t y = 0; y < 64; ++y)
+    {
+        for (uint32_t x = 0; x < 64; ++x)
+        {
+            changed += out.at(x, y) != 0x12345678;
+        }
+    }
+    CHECK(changed == 0, "invalid frames changed %u pixels", changed);
+    printf("invalid ok\n");
+}
+
+// ---------------------------------------------------------------------------
+
+static void benchmark(const uint32_t& width, const uint32_t& height, const int& frames)
+{
+    // 720p video scaled to fullscreen, a translucent panel over the bottom
+    // third and an opaque status bar, as a video player with its controls
+    Image video(SW_FORMAT_YUV_420, 1280, 720);
+    Image panel(SW_FORMAT_RGBA_8888, width, height / 3);
+    Image status(SW_FORMAT_RGB_565, width, height / 20);
+    video.fillRandom();
+    panel.fillRandom();
+    status.fillRandom();
+
+    std::vector<SwLayer> layers;
+    layers.push_back(makeLayer(video, makeRect(0, 0, 1280, 720), makeRect(0, 0, width, height), SW_BLEND_NONE, 255));
+    layers.push_back(makeLayer(panel, makeRect(0, 0, width, height / 3),
+        makeRect(0, height - height / 3, width, height), SW_BLEND_COVERAGE, 255));
+    layers.push_back(makeLayer(status, makeRect(0, 0, width, height / 20),
+        makeRect(0, 0, width, height / 20), SW_BLEND_NONE, 255));
+
+    Image out(SW_FORMAT_RGBA_8888, width, height);
+    const hwc_rect_t bounds = makeRect(0, 0, width, height);
+
+    const uint32_t thread_nums[3] = { 1, 2, 4 };
+    for (int simd = 1; simd >= 0; --simd)
+    {
+        for (int t = 0; t < 3; ++t)
+        {
+            SwComposer composer(thread_nums[t], simd != 0);
+            composer.compose(&layers[0], layers.size(), out.buf, bounds);
+
+            const uint64_t begin = nowNs();
+            for (int i = 0; i < frames; ++i)
+            {
+                composer.compose(&layers[0], layers.size(), out.buf, bounds);
+            }
+            const double ms = (nowNs() - begin) / 1e6 / frames;
+            printf("bench  %4ux%-4u %-4s threads:%u %7.2f ms/frame %7.1f Mpix/s\n",
+                width, height, composer.getKernelName(), composer.getThreadNum(),
+                ms, width * height / ms / 1e3);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int frames = DEFAULT_FRAMES;
+    if (argc > 1)
+        frames = atoi(argv[1]);
+    if (frames <= 0)
+        frames = DEFAULT_FRAMES;
+
+    testGoldenPixels(false);
+    testGoldenPixels(true);
+    printf("golden pixels ok\n");
+
+    testKernelsBitExact();
+    printf("kernels %s == %s\n", getSwKernels(true).name, getSwKernels(false).name);
+
+    testScenes();
+    testInvalid();
+
+    benchmark(1280, 720, frames);
+    benchmark(1920, 1080, frames);
+    benchmark(2560, 1440, frames);
+
+    printf("%s\n", s_errors == 0 ? "PASS" : "FAIL");
+    return s_errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,258 @@
+// vali_cache_test: the validate result cache (vali_cache.h) on the HWCDisplay
+// and HWCLayer of the composer, with buffers allocated by gralloc.
+//
+// The fingerprint is built by HWCDisplay::updateValiFingerprint(), as in
+// presentDisplay, from the states the layers got through their setters.
+// After each change of the layers, the test checks whether the plan saved
+// by the last validate is reused (hit) or not (miss):
+//  - hit : a new buffer with the same properties, also on layer_0 which is
+//          handled as RGBX, the visible region, the surface damage
+//  - miss: transform, plane alpha, display frame, buffer format, the
+//          composition type asked by SF, a layer added or destroyed, the
+//          platform configs which the layer checks read
+// That a restored plan is the same as the one of a full validate is checked
+// at runtime by debug.hwc.vali_cache 2.
+// The cpu time of updateValiFingerprint() is reported too.
+//
+// usage: vali_cache_test [rounds]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include <ui/GraphicBuffer.h>
+
+#include "../hwc2.h"
+#include "platform.h"
+
+using namespace android;
+
+#define DEFAULT_ROUNDS  (10000)
+#define DISP_WIDTH      (1080)
+#define DISP_HEIGHT     (2160)
+
+static int s_errors = 0;
+
+#define CHECK(cond, ...)                    \
+    do {                                    \
+        if (!(cond))                        \
+        {                                   \
+            printf("FAILED %s:%d: ", __func__, __LINE__); \
+            printf(__VA_ARGS__);            \
+            printf("\n");                   \
+            ++s_errors;                     \
+        }                                   \
+    } while (0)
+
+static int64_t getNowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+static hwc_rect_t makeRect(int l, int t, int r, int b)
+{
+    hwc_rect_t rect = { l, t, r, b };
+    return rect;
+}
+
+static sp<GraphicBuffer> allocBuffer(const uint32_t& width, const uint32_t& height, const PixelFormat& format)
+{
+    sp<GraphicBuffer> buf = new GraphicBuffer(width, height, format,
+        GraphicBuffer::USAGE_HW_COMPOSER | GraphicBuffer::USAGE_HW_TEXTURE, "vali_cache_test");
+    if (buf == nullptr || buf->initCheck() != NO_ERROR)
+    {
+        printf("failed to allocate a %ux%u buffer of format %d\n", width, height, format);
+        exit(1);
+    }
+    return buf;
+}
+
+// the layer as SF sets it up before validateDisplay
+static void setLayer(const sp<HWCLayer>& layer, const hwc_rect_t& frame,
+                     const uint32_t& z, const sp<GraphicBuffer>& buf)
+{
+    hwc_frect_t crop = { 0.0f, 0.0f,
+        static_cast<float>(frame.right - frame.left), static_cast<float>(frame.bottom - frame.top) };
+    hwc_region_t visible = { 1, &frame };
+
+    layer->setSFCompositionType(HWC2_COMPOSITION_DEVICE, true);
+    layer->setDisplayFrame(frame);
+    layer->setSourceCrop(crop);
+    layer->setVisibleRegion(visible);
+    layer->setBlend(HWC2_BLEND_MODE_PREMULTIPLIED);
+    layer->setPlaneAlpha(1.0f);
+    layer->setZOrder(z);
+    layer->setHandle(buf->handle);
+}
+
+// the part of presentDisplay before validate, as buildVisibleLayerForAllDisplay()
+// does it: the visible layers, their private handles, and the fingerprint
+static bool isHit(const sp<HWCDisplay>& disp)
+{
+    disp->removePendingRemovedLayers();
+    disp->buildVisibleLayersSortedByZ();
+    disp->setupPrivateHandleOfLayers();
+    disp->updateValiFingerprint();
+
+    const bool hit = disp->isValiPlanReusable();
+
+    // a miss is validated again, and its plan saved for the next frame
+    if (!hit)
+        disp->saveValiPlan();
+    for (auto& layer : disp->getVisibleLayersSortedByZ())
+    {
+        layer->setStateChanged(false);
+        layer->setBufferChanged(false);
+    }
+    return hit;
+}
+
+static void testHitMiss()
+{
+    sp<HWCDisplay> disp = new HWCDisplay(HWC_DISPLAY_PRIMARY, HWC2_DISPLAY_TYPE_PHYSICAL);
+
+    // wallpaper, app, status bar, navigation bar
+    const hwc_rect_t frames[] = {
+        makeRect(0, 0, DISP_WIDTH, DISP_HEIGHT),
+        makeRect(0, 0, DISP_WIDTH, DISP_HEIGHT),
+        makeRect(0, 0, DISP_WIDTH, 72),
+        makeRect(0, DISP_HEIGHT - 144, DISP_WIDTH, DISP_HEIGHT),
+    };
+    std::vector<sp<HWCLayer> > layers;
+    std::vector<sp<GraphicBuffer> > bufs;
+    for (uint32_t i = 0; i < sizeof(frames) / sizeof(frames[0]); ++i)
+    {
+        hwc2_layer_t id = 0;
+        disp->createLayer(&id, false);
+        bufs.push_back(allocBuffer(frames[i].right - frames[i].left,
+                                   frames[i].bottom - frames[i].top, PIXEL_FORMAT_RGBA_8888));
+        layers.push_back(disp->getLayer(id));
+        setLayer(layers.back(), frames[i], i, bufs.back());
+    }
+    sp<HWCLayer> app = layers[1];
+
+    CHECK(!isHit(disp), "the first frame");
+    CHECK(isHit(disp), "nothing changed");
+
+    // the content of the layers is not part of the fingerprint
+    sp<GraphicBuffer> app_next = allocBuffer(DISP_WIDTH, DISP_HEIGHT, PIXEL_FORMAT_RGBA_8888);
+    app->setHandle(app_next->handle);
+    CHECK(isHit(disp), "a new buffer with the same properties");
+
+    // layer_0 is handled as RGBX, also on the frames its handle is set up again
+    sp<GraphicBuffer> wallpaper_next = allocBuffer(DISP_WIDTH, DISP_HEIGHT, PIXEL_FORMAT_RGBA_8888);
+    layers[0]->setHandle(wallpaper_next->handle);
+    CHECK(isHit(disp), "a new buffer of layer_0");
+
+    const hwc_rect_t half = makeRect(0, DISP_HEIGHT / 2, DISP_WIDTH, DISP_HEIGHT);
+    const hwc_region_t visible = { 1, &half };
+    app->setVisibleRegion(visible);
+    CHECK(isHit(disp), "visible region");
+
+    const hwc_rect_t line = makeRect(0, 100, DISP_WIDTH, 116);
+    const hwc_region_t damage = { 1, &line };
+    app->setDamage(damage);
+    CHECK(isHit(disp), "surface damage");
+
+    // the states validate depends on
+    app->setTransform(HWC_TRANSFORM_ROT_90);
+    CHECK(!isHit(disp), "transform");
+    CHECK(isHit(disp), "the same transform again");
+    app->setTransform(0);
+    CHECK(!isHit(disp), "transform back");
+
+    app->setPlaneAlpha(0.5f);
+    CHECK(!isHit(disp), "plane alpha");
+    app->setPlaneAlpha(1.0f);
+    CHECK(!isHit(disp), "plane alpha back");
+
+    app->setDisplayFrame(makeRect(0, 40, DISP_WIDTH, DISP_HEIGHT));
+    CHECK(!isHit(disp), "display frame");
+    app->setDisplayFrame(frames[1]);
+    CHECK(!isHit(disp), "display frame back");
+
+    sp<GraphicBuffer> app_yuv = allocBuffer(DISP_WIDTH, DISP_HEIGHT, HAL_PIXEL_FORMAT_YV12);
+    app->setHandle(app_yuv->handle);
+    CHECK(!isHit(disp), "a new buffer of another format");
+    app->setHandle(app_next->handle);
+    CHECK(!isHit(disp), "a new buffer of the format before");
+
+    app->setSFCompositionType(HWC2_COMPOSITION_CLIENT, true);
+    CHECK(!isHit(disp), "composition type asked by SF");
+    app->setSFCompositionType(HWC2_COMPOSITION_DEVICE, true);
+    CHECK(!isHit(disp), "composition type asked by SF back");
+
+    // a composition type set by validate itself does not change the plan
+    app->setSFCompositionType(HWC2_COMPOSITION_CLIENT, false);
+    CHECK(isHit(disp), "composition type set by HWC");
+    app->setSFCompositionType(HWC2_COMPOSITION_DEVICE, false);
+
+    // the configs of the debug properties which the layer checks read
+    PlatformCommon::PlatformConfig& config = Platform::getInstance().m_config;
+    config.enable_rgbx_scaling = !config.enable_rgbx_scaling;
+    CHECK(!isHit(disp), "rgbx scaling");
+    config.enable_rgbx_scaling = !config.enable_rgbx_scaling;
+    CHECK(!isHit(disp), "rgbx scaling back");
+
+    const int32_t prexform_ui = config.prexformUI;
+    config.prexformUI = !prexform_ui;
+    CHECK(!isHit(disp), "prexformUI");
+    config.prexformUI = prexform_ui;
+    CHECK(!isHit(disp), "prexformUI back");
+
+    hwc2_layer_t id = 0;
+    disp->createLayer(&id, false);
+    sp<GraphicBuffer> dialog = allocBuffer(DISP_WIDTH / 2, DISP_HEIGHT / 4, PIXEL_FORMAT_RGBA_8888);
+    setLayer(disp->getLayer(id), makeRect(DISP_WIDTH / 4, DISP_HEIGHT / 4, DISP_WIDTH * 3 / 4, DISP_HEIGHT / 2), 10, dialog);
+    CHECK(!isHit(disp), "a layer added");
+    disp->destroyLayer(id);
+    CHECK(!isHit(disp), "a layer destroyed");
+    CHECK(isHit(disp), "nothing changed after a layer destroyed");
+}
+
+static void benchmark(const int rounds)
+{
+    sp<HWCDisplay> disp = new HWCDisplay(HWC_DISPLAY_PRIMARY, HWC2_DISPLAY_TYPE_PHYSICAL);
+    std::vector<sp<GraphicBuffer> > bufs;
+
+    for (uint32_t layer_num = 1; layer_num <= 16; layer_num *= 2)
+    {
+        while (bufs.size() < layer_num)
+        {
+            hwc2_layer_t id = 0;
+            disp->createLayer(&id, false);
+            bufs.push_back(allocBuffer(DISP_WIDTH, 256, PIXEL_FORMAT_RGBA_8888));
+            const int32_t top = (bufs.size() - 1) * 128 % (DISP_HEIGHT - 256);
+            setLayer(disp->getLayer(id), makeRect(0, top, DISP_WIDTH, top + 256), bufs.size(), bufs.back());
+        }
+        disp->buildVisibleLayersSortedByZ();
+        disp->setupPrivateHandleOfLayers();
+
+        const int64_t start = getNowNs();
+        for (int i = 0; i < rounds; ++i)
+            disp->updateValiFingerprint();
+        const int64_t ns = getNowNs() - start;
+
+        printf("layers:%2u updateValiFingerprint:%7.2f us\n", layer_num, ns / 1000.0 / rounds);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int rounds = DEFAULT_ROUNDS;
+    if (argc > 1)
+        rounds = atoi(argv[1]);
+    if (rounds <= 0)
+        rounds = DEFAULT_ROUNDS;
+
+    testHitMiss();
+    benchmark(rounds);
+
+    printf("%s\n", s_errors == 0 ? "PASS" : "FAIL");
+    return s_errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,322 @@
+// vsync_model_test: simulation of VSyncModel (vsync_model.h) with noisy
+// hw vsync traces, and the wakeup latency of VSyncTimer.
+//
+// Each trace is a true vsync grid; the timestamps given to the model carry
+// gaussian jitter, late interrupts, missed vsyncs, a drift from the nominal
+// period, a refresh rate switch or a long blank. For each trace:
+//  - the fitted period against the true one
+//  - the error of the predicted vsync one second ahead, which is what a
+//    sw vsync gets when hw vsync stops, against the old way: the last
+//    timestamp plus the nominal period
+//  - how many timestamps it takes to lock again after the timing changes
+// Then the scheduling of computeNextWakeup() is checked, and VSyncTimer
+// wakes up on a model grid with an offset to measure the latency.
+//
+// usage: vsync_model_test [wakeups]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../vsync_model.h"
+
+#define DEFAULT_WAKEUPS (120)
+#define NOMINAL_PERIOD  (16666667LL)
+#define SECOND          (1000000000LL)
+
+static int s_errors = 0;
+
+#define CHECK(cond, ...)                    \
+    do {                                    \
+        if (!(cond))                        \
+        {                                   \
+            printf("FAILED %s:%d: ", __func__, __LINE__); \
+            printf(__VA_ARGS__);            \
+            printf("\n");                   \
+            ++s_errors;                     \
+        }                                   \
+    } while (0)
+
+static uint32_t s_seed = 1;
+
+static double random01()
+{
+    // xorshift32, the traces are the same on every run
+    s_seed ^= s_seed << 13;
+    s_seed ^= s_seed >> 17;
+    s_seed ^= s_seed << 5;
+    return (s_seed >> 8) / 16777216.0;
+}
+
+static double gaussian()
+{
+    const double u = random01() + 1e-12;
+    const double v = random01();
+    return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+struct Trace
+{
+    Trace()
+        : name(NULL), frames(600), period(NOMINAL_PERIOD), jitter(30000)
+        , late_ratio(0.0), miss_ratio(0.0)
+        , switch_frame(-1), switch_period(0)
+        , gap_frame(-1), gap(0)
+    {
+    }
+
+    const char* name;
+    int frames;
+    int64_t period;
+    double jitter;
+
+    // late interrupts, 1.5 to 6 ms late
+    double late_ratio;
+    double miss_ratio;
+
+    // the period changes at switch_frame
+    int switch_frame;
+    int64_t switch_period;
+
+    // the timestamps stop for gap ns at gap_frame
+    int gap_frame;
+    int64_t gap;
+};
+
+static void runTrace(const Trace& trace)
+{
+    VSyncModel model(NOMINAL_PERIOD);
+
+    int64_t true_vsync = SECOND;
+    int64_t period = trace.period;
+    int64_t last_timestamp = 0;
+
+    // the sample index after which the model must be locked to the new timing
+    int change_frame = -1;
+    int relocked_after = -1;
+    int good_frames = 0;
+
+    JitterStat model_ahead;
+    JitterStat naive_ahead;
+
+    for (int frame = 0; frame < trace.frames; ++frame)
+    {
+        if (frame == trace.switch_frame)
+        {
+            period = trace.switch_period;
+            change_frame = frame;
+        }
+        if (frame == trace.gap_frame)
+        {
+            true_vsync += trace.gap;
+            change_frame = frame;
+        }
+        true_vsync += period;
+
+        if (random01() < trace.miss_ratio)
+            continue;
+
+        int64_t timestamp = true_vsync + static_cast<int64_t>(gaussian() * trace.jitter);
+        if (random01() < trace.late_ratio)
+            timestamp += 1500000 + static_cast<int64_t>(random01() * 4500000);
+
+        model.addSample(timestamp);
+        last_timestamp = timestamp;
+
+        // locked to the new timing when the next vsync is predicted within
+        // a tenth of a ms, for 10 frames in a row
+        if (change_frame >= 0 && relocked_after < 0)
+        {
+            const int64_t err = model.predictVSync(true_vsync + period) - (true_vsync + period);
+            good_frames = (model.isLocked() && llabs(err) < 100000) ? good_frames + 1 : 0;
+            if (good_frames >= 10)
+                relocked_after = frame - change_frame - 9;
+        }
+
+        // extrapolate one second ahead, after the timing is stable
+        const bool stable = frame > 60 && (change_frame < 0 || frame > change_frame + 60);
+        if (stable && model.isLocked())
+        {
+            const int64_t ahead = true_vsync + 60 * period;
+            model_ahead.add(model.predictVSync(ahead) - ahead);
+
+            const int64_t n = (ahead - last_timestamp + NOMINAL_PERIOD / 2) / NOMINAL_PERIOD;
+            naive_ahead.add(last_timestamp + n * NOMINAL_PERIOD - ahead);
+        }
+    }
+
+    const VSyncStats& stats = model.getStats();
+    const int64_t period_err = model.getPeriod() - period;
+    printf("trace  %-9s period err:%6lld ns  1s ahead rms model:%7.1f us naive:%8.1f us  "
+        "jitter sd:%5.1f us  acc:%u rej:%u relock:%u",
+        trace.name, static_cast<long long>(period_err),
+        sqrt(model_ahead.sum_sq / (model_ahead.count ? model_ahead.count : 1)) / 1e3,
+        sqrt(naive_ahead.sum_sq / (naive_ahead.count ? naive_ahead.count : 1)) / 1e3,
+        stats.sample_error.getStdDev() / 1e3, stats.accepted, stats.rejected, stats.relocks);
+    if (change_frame >= 0)
+        printf("  locked after:%d", relocked_after);
+    printf("\n");
+
+    CHECK(model.isLocked(), "%s: not locked", trace.name);
+    CHECK(llabs(period_err) < 3000, "%s: period error %lld ns", trace.name,
+        static_cast<long long>(period_err));
+    CHECK(model_ahead.count > 0 && model_ahead.max_abs < 500000,
+        "%s: 1s ahead error up to %lld ns", trace.name, static_cast<long long>(model_ahead.max_abs));
+    if (change_frame >= 0)
+    {
+        CHECK(relocked_after >= 0 && relocked_after <= 20,
+            "%s: locked again after %d timestamps", trace.name, relocked_after);
+    }
+}
+
+static void testTraces()
+{
+    Trace clean;
+    clean.name = "clean";
+    runTrace(clean);
+
+    Trace late;
+    late.name = "late";
+    late.late_ratio = 0.08;
+    runTrace(late);
+
+    Trace missed;
+    missed.name = "missed";
+    missed.miss_ratio = 0.15;
+    runTrace(missed);
+
+    Trace drift;
+    drift.name = "drift";
+    drift.period = 16700000;
+    drift.late_ratio = 0.03;
+    runTrace(drift);
+
+    Trace rate;
+    rate.name = "60to90";
+    rate.frames = 900;
+    rate.switch_frame = 300;
+    rate.switch_period = 11111111;
+    runTrace(rate);
+
+    Trace blank;
+    blank.name = "blank";
+    blank.gap_frame = 300;
+    blank.gap = 5 * SECOND + 7000000;
+    runTrace(blank);
+
+    Trace noisy;
+    noisy.name = "noisy";
+    noisy.jitter = 150000;
+    noisy.late_ratio = 0.05;
+    noisy.miss_ratio = 0.05;
+    runTrace(noisy);
+}
+
+static void testSchedule()
+{
+    VSyncModel model(NOMINAL_PERIOD);
+    for (int i = 1; i <= 10; ++i)
+    {
+        model.addSample(SECOND + i * NOMINAL_PERIOD);
+    }
+    CHECK(model.isLocked() && model.getPeriod() == NOMINAL_PERIOD,
+        "period %lld", static_cast<long long>(model.getPeriod()));
+
+    const int64_t grid = SECOND + 10 * NOMINAL_PERIOD;
+    int64_t vsync = 0;
+
+    // right after a vsync, the next one
+    int64_t wakeup = model.computeNextWakeup(grid + 1000, 0, grid, &vsync);
+    CHECK(vsync == grid + NOMINAL_PERIOD && wakeup == vsync, "next vsync %lld", static_cast<long long>(vsync));
+
+    // 2 ms early: the wakeup is before the vsync it delivers
+    wakeup = model.computeNextWakeup(grid + 1000, -2000000, grid, &vsync);
+    CHECK(vsync == grid + NOMINAL_PERIOD && wakeup == vsync - 2000000, "early wakeup %lld", static_cast<long long>(wakeup));
+
+    // too late for the early wakeup of the next vsync, take the one after
+    wakeup = model.computeNextWakeup(grid + NOMINAL_PERIOD - 1000000, -2000000, grid, &vsync);
+    CHECK(vsync == grid + 2 * NOMINAL_PERIOD, "late for early wakeup %lld", static_cast<long long>(vsync));
+
+    // a vsync is never delivered twice, even when the thread wakes up early
+    wakeup = model.computeNextWakeup(grid - 100000, 0, grid, &vsync);
+    CHECK(vsync == grid + NOMINAL_PERIOD, "delivered twice %lld", static_cast<long long>(vsync));
+
+    // 1 ms after: the wakeup is after the vsync
+    wakeup = model.computeNextWakeup(grid + 1000, 1000000, grid, &vsync);
+    CHECK(vsync == grid + NOMINAL_PERIOD && wakeup == vsync + 1000000, "late wakeup %lld", static_cast<long long>(wakeup));
+
+    // the thread was blocked for a while, skip to the future
+    wakeup = model.computeNextWakeup(grid + 5 * NOMINAL_PERIOD + 10, 0, grid, &vsync);
+    CHECK(vsync == grid + 6 * NOMINAL_PERIOD, "skip %lld", static_cast<long long>(vsync));
+
+    // no hw timestamp at all: the grid of the last sw vsync
+    VSyncModel empty(NOMINAL_PERIOD);
+    wakeup = empty.computeNextWakeup(grid + 1000, 0, grid, &vsync);
+    CHECK(vsync == grid + NOMINAL_PERIOD, "no sample %lld", static_cast<long long>(vsync));
+    wakeup = empty.computeNextWakeup(grid, 0, 0, &vsync);
+    CHECK(vsync == grid && wakeup == grid, "first sw vsync %lld", static_cast<long long>(vsync));
+
+    // duplicated and spurious timestamps are rejected
+    CHECK(!model.addSample(grid), "duplicate accepted");
+    CHECK(!model.addSample(grid + 3000000), "spurious accepted");
+    printf("schedule ok\n");
+}
+
+static void testWakeups(const int& wakeups)
+{
+    VSyncTimer timer;
+    CHECK(timer.isValid(), "timerfd");
+    if (!timer.isValid())
+        return;
+
+    // a model locked to a grid starting now, with a 2 ms early wakeup
+    VSyncModel model(NOMINAL_PERIOD);
+    const int64_t start = VSyncTimer::getNow();
+    for (int i = -10; i <= 0; ++i)
+    {
+        model.addSample(start + i * NOMINAL_PERIOD);
+    }
+
+    const int64_t offset = -2000000;
+    int64_t last_vsync = start;
+    int drifted = 0;
+    for (int i = 0; i < wakeups; ++i)
+    {
+        int64_t vsync = 0;
+        const int64_t wakeup = model.computeNextWakeup(VSyncTimer::getNow(), offset, last_vsync, &vsync);
+        if (!timer.waitUntil(wakeup))
+        {
+            CHECK(false, "waitUntil failed");
+            return;
+        }
+        model.addWakeup(wakeup, VSyncTimer::getNow());
+
+        // the delivered vsyncs stay on the grid
+        if ((vsync - start) % NOMINAL_PERIOD != 0)
+            ++drifted;
+        last_vsync = vsync;
+    }
+
+    const JitterStat& latency = model.getStats().wakeup_latency;
+    printf("timerfd wakeups:%u latency mean:%.1f us sd:%.1f us max:%.1f us off grid:%d\n",
+        latency.count, latency.getMean() / 1e3, latency.getStdDev() / 1e3,
+        latency.max_abs / 1e3, drifted);
+    CHECK(drifted == 0, "%d vsyncs off the grid", drifted);
+    CHECK(latency.getMean() >= 0.0, "woke up before the timer");
+}
+
+int main(int argc, char** argv)
+{
+    int wakeups = DEFAULT_WAKEUPS;
+    if (argc > 1)
+        wakeups = atoi(argv[1]);
+    if (wakeups <= 0)
+        wakeups = DEFAULT_WAKEUPS;
+
+    testTraces();
+    testSchedule();
+    testWakeups(wakeups);
+
+    printf("%s\n", s_errors == 0 ? "PASS" : "FAIL");
+    return s_errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,203 @@
+#ifndef HWC_VALI_CACHE_H_
+#define HWC_VALI_CACHE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include <hardware/hwcomposer_defs.h>
+
+// ---------------------------------------------------------------------------
+
+// ValiFingerprint accumulates the states which the composition decision of a
+// display depends on (64-bit FNV-1a).
+// Buffer handles and damage regions are NOT part of the fingerprint, so a
+// frame which only updates the content of its layers (video playback,
+// scrolling) has the same fingerprint as the frame validated before.
+class ValiFingerprint
+{
+public:
+    ValiFingerprint() : m_hash(FNV_OFFSET_BASIS) { }
+
+    template <typename T>
+    ValiFingerprint& add(const T& val)
+    {
+        return addBytes(&val, sizeof(T));
+    }
+
+    ValiFingerprint& addBytes(const void* data, const size_t& size)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            m_hash ^= bytes[i];
+            m_hash *= FNV_PRIME;
+        }
+        return *this;
+    }
+
+    uint64_t get() const { return m_hash; }
+
+private:
+    static const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+    static const uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+    uint64_t m_hash;
+};
+
+// the states of a display which validate depends on
+struct ValiDisplayState
+{
+    int32_t mirror_src;
+    bool force_gpu;
+    int32_t compose_level;
+    double mdp_scale_percentage;
+    bool sw_compose;
+    uint32_t video_hdcp;
+    uint32_t hdcp_version;
+    bool secure;
+
+    // the platform configs which the layer checks read, they can change at
+    // runtime through the debug properties
+    int32_t prexform_ui;
+    bool rgba_rotate;
+    bool rgbx_scaling;
+    bool global_pq;
+    bool uipq_debug;
+    bool disp_decompress;
+    bool mdp_decompress;
+};
+
+// the states of a layer which validate depends on
+struct ValiLayerState
+{
+    int64_t id;
+    int32_t sf_comp_type;
+    hwc_rect_t display_frame;
+    hwc_frect_t source_crop;
+    int32_t blend;
+    int32_t dataspace;
+    float plane_alpha;
+    int32_t transform;
+    bool has_handle;
+
+    // the properties of the buffer, only when has_handle
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    int32_t usage;
+    uint32_t prexform;
+    uint32_t ext_status;
+    uint32_t ext_status2;
+    bool secure;
+};
+
+// addValiDisplayState() and addValiLayerState() are the only places which
+// decide what goes into the fingerprint; HWCDisplay::updateValiFingerprint()
+// and the frame replay tool both build the fingerprint with them.
+// The states are added field by field, the padding of the structs is not.
+inline void addValiDisplayState(ValiFingerprint* fingerprint,
+                                const ValiDisplayState& state, const size_t& layer_num)
+{
+    fingerprint->add(state.mirror_src)
+                .add(state.force_gpu)
+                .add(state.compose_level)
+                .add(state.mdp_scale_percentage)
+                .add(state.sw_compose)
+                .add(state.video_hdcp)
+                .add(state.hdcp_version)
+                .add(state.secure)
+                .add(state.prexform_ui)
+                .add(state.rgba_rotate)
+                .add(state.rgbx_scaling)
+                .add(state.global_pq)
+                .add(state.uipq_debug)
+                .add(state.disp_decompress)
+                .add(state.mdp_decompress)
+                .add(layer_num);
+}
+
+inline void addValiLayerState(ValiFingerprint* fingerprint, const ValiLayerState& state)
+{
+    fingerprint->add(state.id)
+                .add(state.sf_comp_type)
+                .add(state.display_frame)
+                .add(state.source_crop)
+                .add(state.blend)
+                .add(state.dataspace)
+                .add(state.plane_alpha)
+                .add(state.transform)
+                .add(state.has_handle);
+
+    // the buffer itself is not part of the fingerprint, but its properties are
+    if (state.has_handle)
+    {
+        fingerprint->add(state.format)
+                    .add(state.width)
+                    .add(state.height)
+                    .add(state.usage)
+                    .add(state.prexform)
+                    .add(state.ext_status)
+                    .add(state.ext_status2)
+                    .add(state.secure);
+    }
+}
+
+// the result of validate for one layer
+struct ValiPlanLayer
+{
+    int32_t hwlayer_type;
+    int32_t hwlayer_type_line;
+    int32_t layer_caps;
+    hwc_rect_t mdp_dst_roi;
+    bool sw_compose;
+
+    bool operator==(const ValiPlanLayer& rhs) const
+    {
+        // hwlayer_type_line is only for debugging
+        return hwlayer_type == rhs.hwlayer_type &&
+               layer_caps == rhs.layer_caps &&
+               sw_compose == rhs.sw_compose &&
+               mdp_dst_roi.left == rhs.mdp_dst_roi.left &&
+               mdp_dst_roi.top == rhs.mdp_dst_roi.top &&
+               mdp_dst_roi.right == rhs.mdp_dst_roi.right &&
+               mdp_dst_roi.bottom == rhs.mdp_dst_roi.bottom;
+    }
+
+    bool operator!=(const ValiPlanLayer& rhs) const { return !(*this == rhs); }
+};
+
+// ValiPlan is the composition plan of a display produced by the last full
+// validate, keyed by the fingerprint of the states it was produced from.
+// When the fingerprint of the next frame is the same, the plan is restored
+// instead of running validate again.
+struct ValiPlan
+{
+    ValiPlan()
+        : valid(false)
+        , fingerprint(0)
+        , gles_head(-1)
+        , gles_tail(-1)
+    { }
+
+    void invalidate()
+    {
+        valid = false;
+        layers.clear();
+    }
+
+    bool isEquivalent(const ValiPlan& rhs) const
+    {
+        return gles_head == rhs.gles_head &&
+               gles_tail == rhs.gles_tail &&
+               layers == rhs.layers;
+    }
+
+    bool valid;
+    uint64_t fingerprint;
+    int32_t gles_head;
+    int32_t gles_tail;
+    std::vector<ValiPlanLayer> layers;
+};
+
+#endif // HWC_VALI_CACHE_H_
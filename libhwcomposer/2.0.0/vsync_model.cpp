@@ -0,0 +1,306 @@
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include "vsync_model.h"
+
+// ---------------------------------------------------------------------------
+
+// division rounding toward negative infinity and positive infinity
+static int64_t floorDiv(const int64_t& a, const int64_t& b)
+{
+    const int64_t q = a / b;
+    return (a % b != 0 && ((a < 0) != (b < 0))) ? q - 1 : q;
+}
+
+static int64_t ceilDiv(const int64_t& a, const int64_t& b)
+{
+    return -floorDiv(-a, b);
+}
+
+static uint32_t countBits(uint32_t bits)
+{
+    uint32_t count = 0;
+    for (; bits; bits &= bits - 1)
+    {
+        ++count;
+    }
+    return count;
+}
+
+void JitterStat::add(const int64_t& err)
+{
+    ++count;
+    sum += static_cast<double>(err);
+    sum_sq += static_cast<double>(err) * static_cast<double>(err);
+    const int64_t abs_err = err < 0 ? -err : err;
+    if (abs_err > max_abs)
+        max_abs = abs_err;
+}
+
+double JitterStat::getStdDev() const
+{
+    if (count == 0)
+        return 0.0;
+
+    const double mean = getMean();
+    const double var = sum_sq / count - mean * mean;
+    return var > 0.0 ? sqrt(var) : 0.0;
+}
+
+// ---------------------------------------------------------------------------
+
+VSyncModel::VSyncModel(const int64_t& nominal_period)
+    : m_nominal_period(0)
+    , m_period(0)
+    , m_reference(0)
+    , m_sample_head(0)
+    , m_sample_num(0)
+    , m_raw_num(0)
+    , m_reject_bits(0)
+{
+    reset(nominal_period);
+}
+
+void VSyncModel::reset(const int64_t& nominal_period)
+{
+    m_nominal_period = nominal_period > 0 ? nominal_period : 16666667;
+    m_period = m_nominal_period;
+    m_reference = 0;
+    m_sample_head = 0;
+    m_sample_num = 0;
+    m_raw_num = 0;
+    m_reject_bits = 0;
+}
+
+void VSyncModel::setReference(const int64_t& reference)
+{
+    if (m_sample_num == 0)
+        m_reference = reference;
+}
+
+void VSyncModel::pushRaw(const int64_t& timestamp)
+{
+    const uint32_t size = sizeof(m_raw) / sizeof(m_raw[0]);
+    if (m_raw_num == size)
+    {
+        for (uint32_t i = 1; i < size; ++i)
+        {
+            m_raw[i - 1] = m_raw[i];
+        }
+        --m_raw_num;
+    }
+    m_raw[m_raw_num++] = timestamp;
+}
+
+bool VSyncModel::addSample(const int64_t& timestamp)
+{
+    if (m_sample_num > 0)
+    {
+        const int64_t last = m_samples[(m_sample_head + SAMPLE_NUM - 1) % SAMPLE_NUM];
+
+        // the same vsync twice, or a spurious one
+        if (timestamp <= last + m_period / 2)
+        {
+            ++m_stats.rejected;
+            return false;
+        }
+
+        if (timestamp - last > m_period * MAX_GAP_PERIODS)
+        {
+            // the phase after a long gap is not known, keep the period
+            m_sample_num = 0;
+            m_reject_bits = 0;
+            m_raw_num = 0;
+            ++m_stats.relocks;
+        }
+    }
+
+    pushRaw(timestamp);
+    m_reject_bits = (m_reject_bits << 1) & ((1u << REJECT_WINDOW) - 1);
+
+    if (m_sample_num > 0)
+    {
+        const int64_t err = timestamp - predictVSync(timestamp);
+        const int64_t limit = m_period / (isLocked() ? LOCKED_OUTLIER_DIV : OUTLIER_DIV);
+        if ((err < 0 ? -err : err) > limit)
+        {
+            ++m_stats.rejected;
+            m_reject_bits |= 1;
+            if (countBits(m_reject_bits) >= REJECT_LIMIT)
+            {
+                relock();
+            }
+            return false;
+        }
+
+        if (isLocked())
+            m_stats.sample_error.add(err);
+    }
+
+    m_samples[m_sample_head] = timestamp;
+    m_sample_head = (m_sample_head + 1) % SAMPLE_NUM;
+    if (m_sample_num < SAMPLE_NUM)
+        ++m_sample_num;
+    ++m_stats.accepted;
+
+    fit();
+    return true;
+}
+
+void VSyncModel::relock()
+{
+    // the median of the latest intervals, one interval is taken as it is
+    int64_t deltas[3];
+    uint32_t delta_num = 0;
+    for (uint32_t i = 1; i < m_raw_num; ++i)
+    {
+        deltas[delta_num++] = m_raw[i] - m_raw[i - 1];
+    }
+
+    int64_t period = m_period;
+    if (delta_num == 1 || delta_num == 2)
+    {
+        period = deltas[0] < deltas[delta_num - 1] ? deltas[0] : deltas[delta_num - 1];
+    }
+    else if (delta_num == 3)
+    {
+        const int64_t a = deltas[0];
+        const int64_t b = deltas[1];
+        const int64_t c = deltas[2];
+        period = a > b ? (b > c ? b : (a > c ? c : a)) : (a > c ? a : (b > c ? c : b));
+    }
+
+    // a period of 4x the nominal one or more is a missed vsync, not a mode
+    if (period > m_nominal_period / 4 && period < m_nominal_period * 4)
+        m_period = period;
+
+    const int64_t latest = m_raw[m_raw_num - 1];
+    m_samples[0] = latest;
+    m_sample_head = 1 % SAMPLE_NUM;
+    m_sample_num = 1;
+    m_reference = latest;
+    m_reject_bits = 0;
+    ++m_stats.relocks;
+}
+
+void VSyncModel::fit()
+{
+    const uint32_t oldest = (m_sample_head + SAMPLE_NUM - m_sample_num) % SAMPLE_NUM;
+    const int64_t base = m_samples[oldest];
+    const int64_t newest = m_samples[(m_sample_head + SAMPLE_NUM - 1) % SAMPLE_NUM];
+
+    if (!isLocked())
+    {
+        m_reference = newest;
+        return;
+    }
+
+    // t = a + b * n on the grid of the current period, relative to base
+    const double period = static_cast<double>(m_period);
+    double sum_n = 0.0;
+    double sum_t = 0.0;
+    double sum_nn = 0.0;
+    double sum_nt = 0.0;
+    double last_n = 0.0;
+    for (uint32_t i = 0; i < m_sample_num; ++i)
+    {
+        const double t = static_cast<double>(m_samples[(oldest + i) % SAMPLE_NUM] - base);
+        const double n = floor(t / period + 0.5);
+        sum_n += n;
+        sum_t += t;
+        sum_nn += n * n;
+        sum_nt += n * t;
+        last_n = n;
+    }
+
+    const double count = static_cast<double>(m_sample_num);
+    const double sxx = sum_nn - sum_n * sum_n / count;
+    if (sxx <= 0.0)
+    {
+        m_reference = newest;
+        return;
+    }
+
+    const double b = (sum_nt - sum_n * sum_t / count) / sxx;
+    const double a = (sum_t - b * sum_n) / count;
+
+    m_period = static_cast<int64_t>(floor(b + 0.5));
+    m_reference = base + static_cast<int64_t>(floor(a + b * last_n + 0.5));
+}
+
+int64_t VSyncModel::predictVSync(const int64_t& time) const
+{
+    if (m_reference == 0)
+        return time;
+
+    const int64_t n = floorDiv(time - m_reference + m_period / 2, m_period);
+    return m_reference + n * m_period;
+}
+
+int64_t VSyncModel::computeNextWakeup(const int64_t& now, const int64_t& offset,
+    const int64_t& last_vsync, int64_t* vsync) const
+{
+    int64_t reference = m_reference;
+    if (reference == 0)
+        reference = last_vsync > 0 ? last_vsync : now;
+
+    int64_t lower = now - offset;
+    if (last_vsync > 0 && last_vsync + m_period / 2 + 1 > lower)
+        lower = last_vsync + m_period / 2 + 1;
+
+    *vsync = reference + ceilDiv(lower - reference, m_period) * m_period;
+    return *vsync + offset;
+}
+
+void VSyncModel::addWakeup(const int64_t& scheduled, const int64_t& actual)
+{
+    m_stats.wakeup_latency.add(actual - scheduled);
+}
+
+// ---------------------------------------------------------------------------
+
+VSyncTimer::VSyncTimer()
+    : m_fd(timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC))
+{
+}
+
+VSyncTimer::~VSyncTimer()
+{
+    if (m_fd >= 0)
+        close(m_fd);
+}
+
+bool VSyncTimer::waitUntil(const int64_t& time)
+{
+    if (m_fd < 0)
+        return false;
+
+    // zero disarms the timer
+    const int64_t when = time > 0 ? time : 1;
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = 0;
+    spec.it_interval.tv_nsec = 0;
+    spec.it_value.tv_sec = when / 1000000000LL;
+    spec.it_value.tv_nsec = when % 1000000000LL;
+    if (timerfd_settime(m_fd, TFD_TIMER_ABSTIME, &spec, NULL) != 0)
+        return false;
+
+    uint64_t expirations = 0;
+    ssize_t ret;
+    do
+    {
+        ret = read(m_fd, &expirations, sizeof(expirations));
+    } while (ret < 0 && errno == EINTR);
+
+    return ret == sizeof(expirations);
+}
+
+int64_t VSyncTimer::getNow()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
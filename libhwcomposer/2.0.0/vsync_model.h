@@ -0,0 +1,164 @@
+#ifndef HWC_VSYNC_MODEL_H_
+#define HWC_VSYNC_MODEL_H_
+
+#include <stdint.h>
+
+// ---------------------------------------------------------------------------
+
+// JitterStat accumulates the mean, deviation and the largest magnitude of
+// a series of errors in ns
+struct JitterStat
+{
+    JitterStat() { reset(); }
+
+    void reset()
+    {
+        count = 0;
+        sum = 0.0;
+        sum_sq = 0.0;
+        max_abs = 0;
+    }
+
+    void add(const int64_t& err);
+
+    double getMean() const { return count ? sum / count : 0.0; }
+    double getStdDev() const;
+
+    uint32_t count;
+    double sum;
+    double sum_sq;
+    int64_t max_abs;
+};
+
+struct VSyncStats
+{
+    VSyncStats() : accepted(0), rejected(0), relocks(0) { }
+
+    // hw timestamp minus the vsync predicted before it is added
+    JitterStat sample_error;
+
+    // actual wakeup time minus the scheduled one
+    JitterStat wakeup_latency;
+
+    uint32_t accepted;
+    uint32_t rejected;
+    uint32_t relocks;
+};
+
+// VSyncModel is a phase-locked model of the vsync of a display:
+//   vsync(n) = reference + n * period
+// It is fitted by least squares to the last SAMPLE_NUM hw vsync timestamps,
+// each of them placed on the grid by rounding, so missed vsyncs are fine.
+// A timestamp more than period / OUTLIER_DIV from the predicted vsync
+// (period / LOCKED_OUTLIER_DIV once locked), e.g. from a late interrupt,
+// is rejected. When most of the recent timestamps are rejected, the timing
+// has changed (refresh rate, a long blank), and the model is locked again
+// from the latest timestamps.
+// Until MIN_SAMPLE_NUM timestamps are fitted, the nominal period is used.
+// VSyncModel is not thread-safe.
+class VSyncModel
+{
+public:
+    enum
+    {
+        SAMPLE_NUM          = 64,
+        MIN_SAMPLE_NUM      = 6,
+
+        OUTLIER_DIV         = 5,
+        LOCKED_OUTLIER_DIV  = 16,
+
+        // relock when REJECT_LIMIT of the last REJECT_WINDOW are rejected
+        REJECT_WINDOW       = 8,
+        REJECT_LIMIT        = 4,
+
+        // start over after a gap of so many periods, e.g. the screen is off
+        MAX_GAP_PERIODS     = 120,
+    };
+
+    explicit VSyncModel(const int64_t& nominal_period = 16666667);
+
+    // reset() drops the fitted timestamps and sets the nominal period
+    void reset(const int64_t& nominal_period);
+
+    // addSample() adds a hw vsync timestamp; return false if it is rejected
+    bool addSample(const int64_t& timestamp);
+
+    // isLocked() is true when the period and the phase are fitted
+    bool isLocked() const { return m_sample_num >= MIN_SAMPLE_NUM; }
+
+    int64_t getPeriod() const { return m_period; }
+    int64_t getNominalPeriod() const { return m_nominal_period; }
+
+    // getReference() returns a vsync on the grid, or 0 if there is none yet
+    int64_t getReference() const { return m_reference; }
+
+    // setReference() puts the grid on a vsync when there is no hw timestamp,
+    // e.g. the first sw vsync
+    void setReference(const int64_t& reference);
+
+    // predictVSync() returns the vsync on the grid nearest to time
+    int64_t predictVSync(const int64_t& time) const;
+
+    // computeNextWakeup() schedules the next vsync to deliver: the first one
+    // after last_vsync (by half a period) whose wakeup, vsync + offset, is
+    // not earlier than now; return the wakeup time and the vsync in vsync
+    int64_t computeNextWakeup(const int64_t& now, const int64_t& offset,
+        const int64_t& last_vsync, int64_t* vsync) const;
+
+    // addWakeup() records how late a scheduled wakeup happened
+    void addWakeup(const int64_t& scheduled, const int64_t& actual);
+
+    const VSyncStats& getStats() const { return m_stats; }
+    void resetStats() { m_stats = VSyncStats(); }
+
+private:
+    // fit() fits period and reference to the samples
+    void fit();
+
+    // relock() starts over from the latest timestamps
+    void relock();
+
+    void pushRaw(const int64_t& timestamp);
+
+    int64_t m_nominal_period;
+    int64_t m_period;
+    int64_t m_reference;
+
+    // m_samples is a ring of the accepted timestamps
+    int64_t m_samples[SAMPLE_NUM];
+    uint32_t m_sample_head;
+    uint32_t m_sample_num;
+
+    // m_raw is a ring of the latest timestamps, accepted or not
+    int64_t m_raw[4];
+    uint32_t m_raw_num;
+
+    // a bit for each of the last REJECT_WINDOW timestamps, 1 for rejected
+    uint32_t m_reject_bits;
+
+    VSyncStats m_stats;
+};
+
+// VSyncTimer sleeps until an absolute CLOCK_MONOTONIC time with a timerfd,
+// which is not shifted by signals like a relative sleep
+class VSyncTimer
+{
+public:
+    VSyncTimer();
+    ~VSyncTimer();
+
+    bool isValid() const { return m_fd >= 0; }
+
+    // waitUntil() returns false if the timer cannot be armed
+    bool waitUntil(const int64_t& time);
+
+    static int64_t getNow();
+
+private:
+    VSyncTimer(const VSyncTimer&);
+    VSyncTimer& operator=(const VSyncTimer&);
+
+    int m_fd;
+};
+
+#endif // HWC_VSYNC_MODEL_H_